@@ -43,6 +43,9 @@
 #endif
 #include "tcg/tcg-ldst.h"
 #include "tcg/oversized-guest.h"
+#ifdef EMSCRIPTEN
+#include "sysemu/ram-cold.h"
+#endif
 
 /* DEBUG defines, enable DEBUG_TLB_LOG to log to the CPU_LOG_MMU target */
 /* #define DEBUG_TLB */
@@ -122,7 +125,8 @@ static void tb_jmp_cache_clear_page(CPUState *cpu, vaddr page_addr)
  * @desc: The CPUTLBDesc portion of the TLB
  * @fast: The CPUTLBDescFast portion of the same TLB
  *
- * Called with tlb_lock_held.
+ * Called with tlb_lock_held.  Returns true if the TLB was resized, its
+ * entries are then garbage and must be flushed.
  *
  * We have two main constraints when resizing a TLB: (1) we only resize it
  * on a TLB flush (otherwise we'd have to take a perf hit by either rehashing
@@ -157,7 +161,7 @@ static void tb_jmp_cache_clear_page(CPUState *cpu, vaddr page_addr)
  * high), since otherwise we are likely to have a significant amount of
  * conflict misses.
  */
-static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
+static bool tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
                                   int64_t now)
 {
     size_t old_size = tlb_n_entries(fast);
@@ -198,7 +202,7 @@ static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
         if (window_expired) {
             tlb_window_reset(desc, now, desc->n_used_entries);
         }
-        return;
+        return false;
     }
 
     g_free(fast->table);
@@ -230,13 +234,13 @@ static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
         fast->table = g_try_new(CPUTLBEntry, new_size);
         desc->fulltlb = g_try_new(CPUTLBEntryFull, new_size);
     }
+    return true;
 }
 
 static void tlb_mmu_flush_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast)
 {
     desc->n_used_entries = 0;
-    desc->large_page_addr = -1;
-    desc->large_page_mask = -1;
+    desc->n_large_pages = 0;
     desc->vindex = 0;
     memset(fast->table, -1, sizeof_tlb(fast));
     memset(desc->vtable, -1, sizeof(desc->vtable));
@@ -473,23 +477,178 @@ static inline void tlb_flush_vtlb_page_locked(CPUState *cpu, int mmu_idx,
     tlb_flush_vtlb_page_mask_locked(cpu, mmu_idx, page, -1);
 }
 
+static void tlb_add_large_page(CPUState *cpu, int mmu_idx,
+                               vaddr addr, uint64_t size);
+
+/*
+ * Track again the large page of an entry that a partial flush keeps.
+ * Called with tlb_c.lock held.
+ */
+static void tlb_keep_large_page(CPUState *cpu, int mmu_idx,
+                                const CPUTLBEntry *te,
+                                const CPUTLBEntryFull *full)
+{
+    uint64_t addr = te->addr_read;
+
+    if (full->lg_page_size <= TARGET_PAGE_BITS) {
+        return;
+    }
+    if (addr == -1) {
+        addr = te->addr_write;
+    }
+    if (addr == -1) {
+        addr = te->addr_code;
+    }
+    tlb_add_large_page(cpu, mmu_idx, addr & TARGET_PAGE_MASK,
+                       (uint64_t)1 << full->lg_page_size);
+}
+
+static void tlb_flush_nonglobal_by_mmuidx_async_work(CPUState *cpu,
+                                                     run_on_cpu_data data)
+{
+    uint16_t to_clean = data.host_int;
+    uint16_t work;
+    int64_t now = get_clock_realtime();
+
+    assert_cpu_is_self(cpu);
+
+    tlb_debug("mmu_idx:0x%04" PRIx16 "\n", to_clean);
+
+    qemu_spin_lock(&cpu->neg.tlb.c.lock);
+
+    to_clean &= cpu->neg.tlb.c.dirty;
+    for (work = to_clean; work != 0; work &= work - 1) {
+        int mmu_idx = ctz32(work);
+        CPUTLBDesc *desc = &cpu->neg.tlb.d[mmu_idx];
+        CPUTLBDescFast *fast = &cpu->neg.tlb.f[mmu_idx];
+        size_t n;
+        bool kept = false;
+
+        /* As in a full flush, a resize drops the global entries too */
+        if (tlb_mmu_resize_locked(desc, fast, now)) {
+            tlb_mmu_flush_locked(desc, fast);
+            cpu->neg.tlb.c.dirty &= ~(1 << mmu_idx);
+            continue;
+        }
+
+        /*
+         * Walk the entries instead of clearing them all, the large page
+         * regions are rebuilt from the entries kept.
+         */
+        desc->n_large_pages = 0;
+        n = tlb_n_entries(fast);
+        for (size_t i = 0; i < n; i++) {
+            if (tlb_entry_is_empty(&fast->table[i])) {
+                continue;
+            }
+            if (desc->fulltlb[i].global) {
+                tlb_keep_large_page(cpu, mmu_idx, &fast->table[i],
+                                    &desc->fulltlb[i]);
+                kept = true;
+                continue;
+            }
+            memset(&fast->table[i], -1, sizeof(fast->table[i]));
+            tlb_n_used_entries_dec(cpu, mmu_idx);
+        }
+        for (size_t k = 0; k < CPU_VTLB_SIZE; k++) {
+            if (tlb_entry_is_empty(&desc->vtable[k])) {
+                continue;
+            }
+            if (desc->vfulltlb[k].global) {
+                tlb_keep_large_page(cpu, mmu_idx, &desc->vtable[k],
+                                    &desc->vfulltlb[k]);
+                kept = true;
+                continue;
+            }
+            memset(&desc->vtable[k], -1, sizeof(desc->vtable[k]));
+            tlb_n_used_entries_dec(cpu, mmu_idx);
+        }
+        if (!kept) {
+            tlb_mmu_flush_locked(desc, fast);
+            cpu->neg.tlb.c.dirty &= ~(1 << mmu_idx);
+        }
+    }
+
+    qemu_spin_unlock(&cpu->neg.tlb.c.lock);
+
+    tcg_flush_jmp_cache(cpu);
+
+    qatomic_set(&cpu->neg.tlb.c.part_flush_count,
+                cpu->neg.tlb.c.part_flush_count + ctpop16(to_clean));
+}
+
+void tlb_flush_nonglobal_by_mmuidx(CPUState *cpu, uint16_t idxmap)
+{
+    tlb_debug("mmu_idx: 0x%" PRIx16 "\n", idxmap);
+
+    if (cpu->created && !qemu_cpu_is_self(cpu)) {
+        async_run_on_cpu(cpu, tlb_flush_nonglobal_by_mmuidx_async_work,
+                         RUN_ON_CPU_HOST_INT(idxmap));
+    } else {
+        tlb_flush_nonglobal_by_mmuidx_async_work(cpu,
+                                                 RUN_ON_CPU_HOST_INT(idxmap));
+    }
+}
+
+/*
+ * Flush every entry of large page region @i of @midx and forget the
+ * region.  Called with tlb_c.lock held.
+ */
+static void tlb_flush_large_page_locked(CPUState *cpu, int midx, unsigned i)
+{
+    CPUTLBDesc *d = &cpu->neg.tlb.d[midx];
+    CPUTLBDescFast *f = &cpu->neg.tlb.f[midx];
+    vaddr lp_addr = d->large_page[i].addr;
+    vaddr lp_mask = d->large_page[i].mask;
+    vaddr n_pages = (~lp_mask >> TARGET_PAGE_BITS) + 1;
+    size_t n = tlb_n_entries(f);
+
+    tlb_debug("flushing large pages midx %d (%016"
+              VADDR_PRIx "/%016" VADDR_PRIx ")\n",
+              midx, lp_addr, lp_mask);
+
+    /*
+     * Visit the entries the region's pages map to if there are fewer
+     * of them than entries in the tlb, otherwise test every entry.
+     * Either way, the entries outside of the region are kept.
+     */
+    if (n_pages && n_pages <= n) {
+        for (vaddr p = 0; p < n_pages; p++) {
+            vaddr page = lp_addr + (p << TARGET_PAGE_BITS);
+
+            if (tlb_flush_entry_locked(tlb_entry(cpu, midx, page), page)) {
+                tlb_n_used_entries_dec(cpu, midx);
+            }
+        }
+    } else {
+        for (size_t k = 0; k < n; k++) {
+            if (tlb_flush_entry_mask_locked(&f->table[k], lp_addr, lp_mask)) {
+                tlb_n_used_entries_dec(cpu, midx);
+            }
+        }
+    }
+    tlb_flush_vtlb_page_mask_locked(cpu, midx, lp_addr, lp_mask);
+
+    d->large_page[i] = d->large_page[--d->n_large_pages];
+}
+
 static void tlb_flush_page_locked(CPUState *cpu, int midx, vaddr page)
 {
-    vaddr lp_addr = cpu->neg.tlb.d[midx].large_page_addr;
-    vaddr lp_mask = cpu->neg.tlb.d[midx].large_page_mask;
+    CPUTLBDesc *d = &cpu->neg.tlb.d[midx];
 
     /* Check if we need to flush due to large pages.  */
-    if ((page & lp_mask) == lp_addr) {
-        tlb_debug("forcing full flush midx %d (%016"
-                  VADDR_PRIx "/%016" VADDR_PRIx ")\n",
-                  midx, lp_addr, lp_mask);
-        tlb_flush_one_mmuidx_locked(cpu, midx, get_clock_realtime());
-    } else {
-        if (tlb_flush_entry_locked(tlb_entry(cpu, midx, page), page)) {
-            tlb_n_used_entries_dec(cpu, midx);
+    for (unsigned i = 0; i < d->n_large_pages; i++) {
+        if ((page & d->large_page[i].mask) == d->large_page[i].addr) {
+            /* The regions are disjoint, no other one can match.  */
+            tlb_flush_large_page_locked(cpu, midx, i);
+            return;
         }
-        tlb_flush_vtlb_page_locked(cpu, midx, page);
     }
+
+    if (tlb_flush_entry_locked(tlb_entry(cpu, midx, page), page)) {
+        tlb_n_used_entries_dec(cpu, midx);
+    }
+    tlb_flush_vtlb_page_locked(cpu, midx, page);
 }
 
 /**
@@ -717,16 +876,16 @@ static void tlb_flush_range_locked(CPUState *cpu, int midx,
     }
 
     /*
-     * Check if we need to flush due to large pages.
-     * Because large_page_mask contains all 1's from the msb,
-     * we only need to test the end of the range.
+     * Check if we need to flush due to large pages.  Flushing a region
+     * moves the last one into its slot, so walk them from the end.
      */
-    if (((addr + len - 1) & d->large_page_mask) == d->large_page_addr) {
-        tlb_debug("forcing full flush midx %d ("
-                  "%016" VADDR_PRIx "/%016" VADDR_PRIx ")\n",
-                  midx, d->large_page_addr, d->large_page_mask);
-        tlb_flush_one_mmuidx_locked(cpu, midx, get_clock_realtime());
-        return;
+    for (unsigned i = d->n_large_pages; i-- > 0; ) {
+        vaddr lp_addr = d->large_page[i].addr;
+        vaddr lp_last = lp_addr | ~d->large_page[i].mask;
+
+        if (addr <= lp_last && lp_addr <= addr + len - 1) {
+            tlb_flush_large_page_locked(cpu, midx, i);
+        }
     }
 
     for (vaddr i = 0; i < len; i += TARGET_PAGE_SIZE) {
@@ -1060,28 +1219,55 @@ void tlb_set_dirty(CPUState *cpu, vaddr addr)
     qemu_spin_unlock(&cpu->neg.tlb.c.lock);
 }
 
-/* Our TLB does not support large pages, so remember the area covered by
-   large pages and trigger a full TLB flush if these are invalidated.  */
+/* Our TLB does not support large pages, so remember the areas covered by
+   large pages and flush all of an area if a page in it is invalidated.  */
 static void tlb_add_large_page(CPUState *cpu, int mmu_idx,
                                vaddr addr, uint64_t size)
 {
-    vaddr lp_addr = cpu->neg.tlb.d[mmu_idx].large_page_addr;
+    CPUTLBDesc *d = &cpu->neg.tlb.d[mmu_idx];
     vaddr lp_mask = ~(size - 1);
+    vaddr lp_addr = addr & lp_mask;
 
-    if (lp_addr == (vaddr)-1) {
-        /* No previous large page.  */
-        lp_addr = addr;
-    } else {
-        /* Extend the existing region to include the new page.
+    for (;;) {
+        vaddr best_mask = 0;
+
+        /*
+         * Absorb the regions overlapping the new one.  Both are aligned
+         * to their power of 2 size, so one contains the other.
+         */
+        for (unsigned i = 0; i < d->n_large_pages; ) {
+            vaddr mask = d->large_page[i].mask & lp_mask;
+
+            if (((d->large_page[i].addr ^ lp_addr) & mask) == 0) {
+                lp_mask = mask;
+                lp_addr &= mask;
+                d->large_page[i] = d->large_page[--d->n_large_pages];
+            } else {
+                i++;
+            }
+        }
+        if (d->n_large_pages < CPU_TLB_LARGE_PAGES) {
+            break;
+        }
+
+        /* Out of regions: extend the new one to its closest neighbour.
            This is a compromise between unnecessary flushes and
            the cost of maintaining a full variable size TLB.  */
-        lp_mask &= cpu->neg.tlb.d[mmu_idx].large_page_mask;
-        while (((lp_addr ^ addr) & lp_mask) != 0) {
-            lp_mask <<= 1;
+        for (unsigned i = 0; i < d->n_large_pages; i++) {
+            vaddr mask = d->large_page[i].mask & lp_mask;
+
+            while (((d->large_page[i].addr ^ lp_addr) & mask) != 0) {
+                mask <<= 1;
+            }
+            best_mask = MAX(best_mask, mask);
         }
+        lp_mask = best_mask;
+        lp_addr &= lp_mask;
     }
-    cpu->neg.tlb.d[mmu_idx].large_page_addr = lp_addr & lp_mask;
-    cpu->neg.tlb.d[mmu_idx].large_page_mask = lp_mask;
+
+    d->large_page[d->n_large_pages].addr = lp_addr;
+    d->large_page[d->n_large_pages].mask = lp_mask;
+    d->n_large_pages++;
 }
 
 static inline void tlb_set_compare(CPUTLBEntryFull *full, CPUTLBEntry *ent,
@@ -1160,6 +1346,10 @@ void tlb_set_page_full(CPUState *cpu, int mmu_idx,
     if (is_ram || is_romd) {
         /* RAM and ROMD both have associated host memory. */
         addend = (uintptr_t)memory_region_get_ram_ptr(section->mr) + xlat;
+#ifdef EMSCRIPTEN
+        /* Inflate the page if it was compressed, and count the access */
+        ram_cold_access((void *)addend, TARGET_PAGE_SIZE, false);
+#endif
     } else {
         /* I/O does not; force the host address to NULL. */
         addend = 0;
@@ -1383,9 +1573,17 @@ static bool victim_tlb_hit(CPUState *cpu, size_t mmu_idx, size_t index,
             CPUTLBEntryFull *f2 = &cpu->neg.tlb.d[mmu_idx].vfulltlb[vidx];
             CPUTLBEntryFull tmpf;
             tmpf = *f1; *f1 = *f2; *f2 = tmpf;
+#ifdef EMSCRIPTEN
+            qatomic_set(&cpu->neg.tlb.d[mmu_idx].n_victim_hits,
+                        cpu->neg.tlb.d[mmu_idx].n_victim_hits + 1);
+#endif
             return true;
         }
     }
+#ifdef EMSCRIPTEN
+    qatomic_set(&cpu->neg.tlb.d[mmu_idx].n_victim_misses,
+                cpu->neg.tlb.d[mmu_idx].n_victim_misses + 1);
+#endif
     return false;
 }
 
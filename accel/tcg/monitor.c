@@ -19,6 +19,10 @@
 #include "tcg/tcg.h"
 #include "internal-common.h"
 #include "tb-context.h"
+#include "qemu/coroutine_int.h"
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+#include "../../tcg/wasm32.h"
+#endif
 
 
 static void dump_drift_info(GString *buf)
@@ -48,8 +52,22 @@ static void dump_accel_info(GString *buf)
                                                     &error_fatal);
 
     g_string_append_printf(buf, "Accelerator settings:\n");
-    g_string_append_printf(buf, "one-insn-per-tb: %s\n\n",
+    g_string_append_printf(buf, "one-insn-per-tb: %s\n",
                            one_insn_per_tb ? "on" : "off");
+    if (mttcg_auto) {
+        unsigned slots = qatomic_read(&mttcg_auto_slots);
+
+        if (slots) {
+            g_string_append_printf(buf, "thread: auto, %u run slots\n",
+                                   slots);
+        } else {
+            g_string_append_printf(buf, "thread: auto, measuring\n");
+        }
+    } else {
+        g_string_append_printf(buf, "thread: %s\n",
+                               mttcg_enabled ? "multi" : "single");
+    }
+    g_string_append_printf(buf, "\n");
 }
 
 static void print_qht_statistics(struct qht_stats hst, GString *buf)
@@ -141,6 +159,28 @@ static void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
     *pelide = elide;
 }
 
+#ifdef EMSCRIPTEN
+/* Misses of the main tlb per MMU index, the fast path hits aren't counted */
+static void tlb_miss_counts(GString *buf)
+{
+    CPUState *cpu;
+
+    g_string_append_printf(buf, "TLB misses          victim hit / refilled\n");
+    for (int i = 0; i < NB_MMU_MODES; i++) {
+        size_t hits = 0, misses = 0;
+
+        CPU_FOREACH(cpu) {
+            hits += qatomic_read(&cpu->neg.tlb.d[i].n_victim_hits);
+            misses += qatomic_read(&cpu->neg.tlb.d[i].n_victim_misses);
+        }
+        if (hits || misses) {
+            g_string_append_printf(buf, "  mmu_idx %-2d        %zu / %zu\n",
+                                   i, hits, misses);
+        }
+    }
+}
+#endif
+
 static void tcg_dump_info(GString *buf)
 {
     g_string_append_printf(buf, "[TCG profiler not compiled]\n");
@@ -189,6 +229,8 @@ static void dump_exec_info(GString *buf)
     g_string_append_printf(buf, "\nStatistics:\n");
     g_string_append_printf(buf, "TB flush count      %u\n",
                            qatomic_read(&tb_ctx.tb_flush_count));
+    g_string_append_printf(buf, "TB retire count     %u\n",
+                           qatomic_read(&tb_ctx.tb_retire_count));
     g_string_append_printf(buf, "TB invalidate count %u\n",
                            qatomic_read(&tb_ctx.tb_phys_invalidate_count));
 
@@ -196,6 +238,15 @@ static void dump_exec_info(GString *buf)
     g_string_append_printf(buf, "TLB full flushes    %zu\n", flush_full);
     g_string_append_printf(buf, "TLB partial flushes %zu\n", flush_part);
     g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
+#ifdef EMSCRIPTEN
+    tlb_miss_counts(buf);
+#endif
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    wasm32_dump_info(buf);
+#endif
+#ifdef EMSCRIPTEN
+    qemu_coroutine_stack_dump_info(buf);
+#endif
     tcg_dump_info(buf);
 }
 
@@ -215,6 +266,20 @@ HumanReadableText *qmp_x_query_jit(Error **errp)
     return human_readable_text_from_str(buf);
 }
 
+void qmp_x_jit_profile_save(const char *filename, Error **errp)
+{
+    if (!tcg_enabled()) {
+        error_setg(errp, "JIT profile is only available with accel=tcg");
+        return;
+    }
+
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    wasm32_warm_profile_save(filename ?: wasm32_warm_profile, errp);
+#else
+    error_setg(errp, "JIT profile only available with wasm32");
+#endif
+}
+
 static void tcg_dump_op_count(GString *buf)
 {
     g_string_append_printf(buf, "[TCG profiler not compiled]\n");
@@ -235,9 +300,28 @@ HumanReadableText *qmp_x_query_opcount(Error **errp)
     return human_readable_text_from_str(buf);
 }
 
+static HumanReadableText *tcg_query_jit_profile(Error **errp)
+{
+    g_autoptr(GString) buf = g_string_new("");
+
+    if (!tcg_enabled()) {
+        error_setg(errp, "JIT profile is only available with accel=tcg");
+        return NULL;
+    }
+
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    wasm32_dump_profile(buf);
+#else
+    g_string_append_printf(buf, "[JIT profile only available with wasm32]\n");
+#endif
+
+    return human_readable_text_from_str(buf);
+}
+
 static void hmp_tcg_register(void)
 {
     monitor_register_hmp_info_hrt("jit", qmp_x_query_jit);
+    monitor_register_hmp_info_hrt("jit-profile", tcg_query_jit_profile);
     monitor_register_hmp_info_hrt("opcount", qmp_x_query_opcount);
 }
 
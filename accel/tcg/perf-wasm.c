@@ -0,0 +1,80 @@
+/*
+ * Names of TB modules for browser profilers, the -perfmap of wasm hosts.
+ *
+ * Chrome and Firefox DevTools name wasm functions after the name custom
+ * section of their module [1]. Without one, every TB is an anonymous
+ * function of an anonymous module in their flame graphs. With -perfmap,
+ * tcg_gen_code appends a name section calling the function of the TB
+ * tb_<guest pc>_<flags>, and the modules of TB regions keep those names.
+ *
+ * [1] https://webassembly.github.io/spec/core/appendix/custom.html#name-section
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "exec/exec-all.h"
+
+#include "perf.h"
+
+#define PERF_WASM_MODULE_NAME "qemu-tb"
+
+bool perf_wasm_names;
+
+void perf_enable_perfmap(void)
+{
+    perf_wasm_names = true;
+}
+
+static uint8_t *perf_wasm_leb128(uint8_t *p, uint32_t v)
+{
+    do {
+        uint8_t b = v & 0x7f;
+
+        v >>= 7;
+        *p++ = b | (v ? 0x80 : 0);
+    } while (v);
+    return p;
+}
+
+static uint8_t *perf_wasm_name(uint8_t *p, const char *name, size_t len)
+{
+    p = perf_wasm_leb128(p, len);
+    memcpy(p, name, len);
+    return p + len;
+}
+
+int perf_wasm_name_section(uint8_t *buf, size_t size, uint64_t guest_pc,
+                           const TranslationBlock *tb, uint32_t func_idx)
+{
+    uint8_t body[128], *p, *sub;
+    char name[48];
+    int len, total;
+
+    len = snprintf(name, sizeof(name), "tb_%" PRIx64 "_%" PRIx32,
+                   guest_pc, tb->flags);
+
+    /* the subsections are short, their sizes take one byte */
+    p = perf_wasm_name(body, "name", 4);
+    *p++ = 0x00;                            /* module name */
+    sub = p++;
+    p = perf_wasm_name(p, PERF_WASM_MODULE_NAME,
+                       strlen(PERF_WASM_MODULE_NAME));
+    *sub = p - sub - 1;
+    *p++ = 0x01;                            /* function names */
+    sub = p++;
+    p = perf_wasm_leb128(p, 1);
+    p = perf_wasm_leb128(p, func_idx);
+    p = perf_wasm_name(p, name, len);
+    *sub = p - sub - 1;
+    total = p - body;
+
+    if (total + 2 > size) {
+        return -1;
+    }
+    p = buf;
+    *p++ = 0x00;                            /* custom section */
+    p = perf_wasm_leb128(p, total);
+    memcpy(p, body, total);
+    return p + total - buf;
+}
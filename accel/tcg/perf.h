@@ -23,6 +23,41 @@ void perf_report_code(uint64_t guest_pc, TranslationBlock *tb,
 
 /* Stop writing perf-<pid>.map and/or jit-<pid>.dump. */
 void perf_exit(void);
+#elif defined(CONFIG_TCG) && defined(EMSCRIPTEN)
+/*
+ * Browser profilers can't read map files, but they show the names of the
+ * wasm name section. With -perfmap, each TB module gets one naming its
+ * function after the guest code.
+ */
+void perf_enable_perfmap(void);
+
+extern bool perf_wasm_names;
+
+/*
+ * Write the name section of the TB module of tb, starting at guest_pc,
+ * whose code is function func_idx, to buf.
+ * Returns its size, or -1 if it doesn't fit in size bytes.
+ */
+int perf_wasm_name_section(uint8_t *buf, size_t size, uint64_t guest_pc,
+                           const TranslationBlock *tb, uint32_t func_idx);
+
+static inline void perf_enable_jitdump(void)
+{
+}
+
+static inline void perf_report_prologue(const void *start, size_t size)
+{
+}
+
+/* The name is already part of the module, see perf_wasm_name_section() */
+static inline void perf_report_code(uint64_t guest_pc, TranslationBlock *tb,
+                                    const void *start)
+{
+}
+
+static inline void perf_exit(void)
+{
+}
 #else
 static inline void perf_enable_perfmap(void)
 {
@@ -182,8 +182,45 @@ struct PageDesc {
     QemuSpin lock;
     /* list of TBs intersecting this ram page */
     uintptr_t first_tb;
+    /* granules of the page overlapped by these TBs, see code_granules() */
+    uint64_t code_bitmap;
 };
 
+/*
+ * Pages with code are split into 64 granules, 64 bytes each for 4K pages.
+ * A write to such a page only walks its TBs if it hits a granule with
+ * code, so that stores to data next to code, as in JITs, trampolines and
+ * older binaries, don't take the page_collection path on every access.
+ * Bits are set as TBs are added and recomputed as they are invalidated.
+ */
+#define CODE_GRANULE_BITS (TARGET_PAGE_BITS - 6)
+
+static uint64_t code_granules(tb_page_addr_t start, tb_page_addr_t last)
+{
+    unsigned first = (start & ~TARGET_PAGE_MASK) >> CODE_GRANULE_BITS;
+    unsigned end = (last & ~TARGET_PAGE_MASK) >> CODE_GRANULE_BITS;
+
+    return MAKE_64BIT_MASK(first, end - first + 1);
+}
+
+/* The part [*start, *last] of @tb on its page @n */
+static void tb_page_range(const TranslationBlock *tb, unsigned int n,
+                          tb_page_addr_t *start, tb_page_addr_t *last)
+{
+    /* NOTE: this is subtle as a TB may span two physical pages */
+    tb_page_addr_t tb_start = tb_page_addr0(tb);
+    tb_page_addr_t tb_last = tb_start + tb->size - 1;
+
+    if (n == 0) {
+        tb_last = MIN(tb_last, tb_start | ~TARGET_PAGE_MASK);
+    } else {
+        tb_start = tb_page_addr1(tb);
+        tb_last = tb_start + (tb_last & ~TARGET_PAGE_MASK);
+    }
+    *start = tb_start;
+    *last = tb_last;
+}
+
 void page_table_config_init(void)
 {
     uint32_t v_l1_bits;
@@ -378,7 +415,22 @@ static inline void assert_page_locked(const PageDesc *pd) { }
 static void page_lock(PageDesc *pd)
 {
     page_lock__debug(pd);
+#ifdef EMSCRIPTEN
+    /*
+     * vCPUs translating the same code at SMP boot wait here. With the
+     * sync profiler on, the waits show up in it as "spin" entries; the
+     * acquisitions that didn't wait aren't counted.
+     */
+    if (unlikely(qemu_spin_trylock(&pd->lock))) {
+        if (qsp_is_enabled()) {
+            qsp_spin_lock(&pd->lock, __FILE__, __LINE__);
+        } else {
+            qemu_spin_lock(&pd->lock);
+        }
+    }
+#else
     qemu_spin_lock(&pd->lock);
+#endif
 }
 
 /* Like qemu_spin_trylock, returns false on success */
@@ -663,6 +715,7 @@ static void tb_remove_all_1(int level, void **lp)
         for (i = 0; i < V_L2_SIZE; ++i) {
             page_lock(&pd[i]);
             pd[i].first_tb = (uintptr_t)NULL;
+            pd[i].code_bitmap = 0;
             page_unlock(&pd[i]);
         }
     } else {
@@ -690,12 +743,15 @@ static void tb_remove_all(void)
 static void tb_page_add(PageDesc *p, TranslationBlock *tb, unsigned int n)
 {
     bool page_already_protected;
+    tb_page_addr_t start, last;
 
     assert_page_locked(p);
 
     tb->page_next[n] = p->first_tb;
     page_already_protected = p->first_tb != 0;
     p->first_tb = (uintptr_t)tb | n;
+    tb_page_range(tb, n, &start, &last);
+    p->code_bitmap |= code_granules(start, last);
 
     /*
      * If some code is already present, then the pages are already
@@ -732,6 +788,9 @@ static void tb_page_remove(PageDesc *pd, TranslationBlock *tb)
     PAGE_FOR_EACH_TB(unused, unused, pd, tb1, n1) {
         if (tb1 == tb) {
             *pprev = tb1->page_next[n1];
+            if (!pd->first_tb) {
+                pd->code_bitmap = 0;
+            }
             return;
         }
         pprev = &tb1->page_next[n1];
@@ -909,7 +968,8 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
  * In !user-mode, if @rm_from_page_list is set, call with the TB's pages'
  * locks held.
  */
-static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
+static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list,
+                                  bool jmp_cache)
 {
     uint32_t h;
     tb_page_addr_t phys_pc;
@@ -936,7 +996,9 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
     }
 
     /* remove the TB from the hash list */
-    tb_jmp_cache_inval_tb(tb);
+    if (jmp_cache) {
+        tb_jmp_cache_inval_tb(tb);
+    }
 
     /* suppress this TB from the two jump lists */
     tb_remove_from_jmp_list(tb, 0);
@@ -945,6 +1007,10 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
     /* suppress any remaining jumps to this TB */
     tb_jmp_unlink(tb);
 
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    wasm32_tb_invalidate(tb);
+#endif
+
     qatomic_set(&tb_ctx.tb_phys_invalidate_count,
                 tb_ctx.tb_phys_invalidate_count + 1);
 }
@@ -952,7 +1018,7 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
 static void tb_phys_invalidate__locked(TranslationBlock *tb)
 {
     qemu_thread_jit_write();
-    do_tb_phys_invalidate(tb, true);
+    do_tb_phys_invalidate(tb, true, true);
     qemu_thread_jit_execute();
 }
 
@@ -964,13 +1030,64 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
 {
     if (page_addr == -1 && tb_page_addr0(tb) != -1) {
         tb_lock_pages(tb);
-        do_tb_phys_invalidate(tb, true);
+        do_tb_phys_invalidate(tb, true, true);
+        tb_unlock_pages(tb);
+    } else {
+        do_tb_phys_invalidate(tb, false, true);
+    }
+}
+
+/* Like tb_phys_invalidate(tb, -1), but leaves the jump caches as they are */
+static void tb_phys_invalidate_keep_jmp_cache(TranslationBlock *tb)
+{
+    if (tb_page_addr0(tb) != -1) {
+        tb_lock_pages(tb);
+        do_tb_phys_invalidate(tb, true, false);
         tb_unlock_pages(tb);
     } else {
-        do_tb_phys_invalidate(tb, false);
+        do_tb_phys_invalidate(tb, false, false);
     }
 }
 
+void tb_retire_oldest(void)
+{
+    g_autoptr(GPtrArray) tbs = g_ptr_array_new();
+    ssize_t region = tcg_region_retire_begin(tbs);
+    bool pcrel = false;
+    CPUState *cpu;
+
+    if (region < 0) {
+        return;
+    }
+    /*
+     * Once invalidated, a TB is neither found by a lookup nor reached by
+     * a chained jump, but a vCPU may still be in its code or about to
+     * enter it. tcg_region_retire_end waits until they all have left
+     * cpu_exec, which they do under rcu_read_lock.
+     *
+     * A CF_PCREL TB can be in any entry of the jump caches, which are
+     * flushed once for all of them instead of once per TB.
+     */
+    for (guint i = 0; i < tbs->len; i++) {
+        TranslationBlock *tb = g_ptr_array_index(tbs, i);
+
+        if (tb_cflags(tb) & CF_PCREL) {
+            tb_phys_invalidate_keep_jmp_cache(tb);
+            pcrel = true;
+        } else {
+            tb_phys_invalidate(tb, -1);
+        }
+    }
+    if (pcrel) {
+        CPU_FOREACH(cpu) {
+            tcg_flush_jmp_cache(cpu);
+        }
+    }
+    tcg_region_retire_end(region);
+    qatomic_inc(&tb_ctx.tb_retire_count);
+}
+
+
 /*
  * Add a new TB and link it to the physical page tables.
  * Called with mmap_lock held for user-mode emulation.
@@ -1109,6 +1226,7 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
 {
     TranslationBlock *tb;
     PageForEachNext n;
+    bool invalidated = false;
 #ifdef TARGET_HAS_PRECISE_SMC
     bool current_tb_modified = false;
     TranslationBlock *current_tb = retaddr ? tcg_tb_lookup(retaddr) : NULL;
@@ -1124,15 +1242,7 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
     PAGE_FOR_EACH_TB(start, last, p, tb, n) {
         tb_page_addr_t tb_start, tb_last;
 
-        /* NOTE: this is subtle as a TB may span two physical pages */
-        tb_start = tb_page_addr0(tb);
-        tb_last = tb_start + tb->size - 1;
-        if (n == 0) {
-            tb_last = MIN(tb_last, tb_start | ~TARGET_PAGE_MASK);
-        } else {
-            tb_start = tb_page_addr1(tb);
-            tb_last = tb_start + (tb_last & ~TARGET_PAGE_MASK);
-        }
+        tb_page_range(tb, n, &tb_start, &tb_last);
         if (!(tb_last < start || tb_start > last)) {
 #ifdef TARGET_HAS_PRECISE_SMC
             if (current_tb == tb &&
@@ -1148,13 +1258,30 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
                 cpu_restore_state_from_tb(current_cpu, current_tb, retaddr);
             }
 #endif /* TARGET_HAS_PRECISE_SMC */
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+            /* a store of translated code, e.g. a guest JIT */
+            if (retaddr) {
+                wasm32_tb_written(tb);
+            }
+#endif
             tb_phys_invalidate__locked(tb);
+            invalidated = true;
         }
     }
 
     /* if no code remaining, no need to continue to use slow writes */
     if (!p->first_tb) {
         tlb_unprotect_code(start);
+    } else if (invalidated) {
+        uint64_t bitmap = 0;
+
+        PAGE_FOR_EACH_TB(start, last, p, tb, n) {
+            tb_page_addr_t tb_start, tb_last;
+
+            tb_page_range(tb, n, &tb_start, &tb_last);
+            bitmap |= code_granules(tb_start, tb_last);
+        }
+        p->code_bitmap = bitmap;
     }
 
 #ifdef TARGET_HAS_PRECISE_SMC
@@ -1250,6 +1377,20 @@ void tb_invalidate_phys_range_fast(ram_addr_t ram_addr,
                                    uintptr_t retaddr)
 {
     struct page_collection *pages;
+    PageDesc *p = page_find(ram_addr >> TARGET_PAGE_BITS);
+    bool miss;
+
+    if (!p) {
+        return;
+    }
+    /* TBs are added under the same lock, so none is missed */
+    page_lock(p);
+    miss = p->first_tb &&
+           !(p->code_bitmap & code_granules(ram_addr, ram_addr + size - 1));
+    page_unlock(p);
+    if (miss) {
+        return;
+    }
 
     pages = page_collection_lock(ram_addr, ram_addr + size - 1);
     tb_invalidate_phys_page_fast__locked(pages, ram_addr, size, retaddr);
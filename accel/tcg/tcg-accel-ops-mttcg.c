@@ -30,11 +30,19 @@
 #include "qemu/main-loop.h"
 #include "qemu/notify.h"
 #include "qemu/guest-random.h"
+#include "qemu/timer.h"
 #include "exec/exec-all.h"
 #include "hw/boards.h"
 #include "tcg/startup.h"
 #include "tcg-accel-ops.h"
 #include "tcg-accel-ops-mttcg.h"
+#include "trace.h"
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+#include "../../tcg/wasm32.h"
+#endif
+#ifdef EMSCRIPTEN
+#include <emscripten/threading.h>
+#endif
 
 typedef struct MttcgForceRcuNotifier {
     Notifier notifier;
@@ -56,14 +64,195 @@ static void mttcg_force_rcu(Notifier *notify, void *data)
     async_run_on_cpu(cpu, do_nothing, RUN_ON_CPU_NULL);
 }
 
+/*
+ * thread=auto: each vCPU still has its own thread, but a vCPU has to hold
+ * one of mttcg_auto_slots run slots while it executes guest code. With a
+ * single slot the vCPUs take turns as with the round-robin thread, if
+ * not at the same points. Slots are handed out in FIFO order, and a vCPU
+ * that waited a whole slice kicks the holders out of cpu_exec, so that
+ * they queue behind it. A waiting vCPU that is kicked or has work queued
+ * leaves the queue to process it.
+ *
+ * The vCPUs start with as many slots as there are host cores to spare.
+ * After MTTCG_AUTO_WINDOW_MS, the host time they spent in cpu_exec is
+ * compared to the time lost waiting for exclusive sections and for the
+ * BQL. Guests that lose much of it to contention, and those that keep
+ * fewer than MTTCG_AUTO_MIN_BUSY / 100 vCPUs busy on average, get one
+ * slot; the others get enough for the vCPUs that were busy.
+ */
+#define MTTCG_AUTO_WINDOW_MS    5000
+#define MTTCG_AUTO_SLICE_MS     10
+/* Fractions in percent */
+#define MTTCG_AUTO_MAX_LOST     25
+#define MTTCG_AUTO_MIN_BUSY     125
+
+typedef struct MttcgSlotWaiter {
+    CPUState *cpu;
+    QTAILQ_ENTRY(MttcgSlotWaiter) next;
+} MttcgSlotWaiter;
+
+static QemuMutex slot_lock;
+static QemuCond slot_cond;
+static unsigned slot_cap;
+static unsigned slots_running;
+static QTAILQ_HEAD(, MttcgSlotWaiter) slot_waiters =
+    QTAILQ_HEAD_INITIALIZER(slot_waiters);
+/* vCPUs holding a slot, by cpu_index */
+static CPUState **slot_holders;
+
+/* The measurement, under slot_lock until mttcg_auto_slots is set */
+static int64_t measure_start;
+static uint64_t measure_exclusive_ns;
+static uint64_t measure_exec_ns;
+static uint64_t measure_bql_ns;
+static uint64_t measure_instantiated;
+
+static unsigned host_cores(void)
+{
+#ifdef EMSCRIPTEN
+    return emscripten_num_logical_cores();
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? n : 1;
+#endif
+}
+
+static uint64_t instantiated(void)
+{
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    return wasm32_instantiated();
+#else
+    return 0;
+#endif
+}
+
+static void mttcg_auto_init(void)
+{
+    unsigned max_cpus = current_machine->smp.max_cpus;
+    unsigned cores = host_cores();
+
+    qemu_mutex_init(&slot_lock);
+    qemu_cond_init(&slot_cond);
+    slot_holders = g_new0(CPUState *, max_cpus);
+    /* leave a core to the main loop and the I/O threads */
+    slot_cap = MIN(max_cpus, cores > 1 ? cores - 1 : 1);
+}
+
+/* Called with slot_lock held, once the window has passed */
+static void mttcg_auto_decide(int64_t now)
+{
+    uint64_t wall = now - measure_start;
+    uint64_t lost = cpu_exclusive_wait_ns() - measure_exclusive_ns +
+                    measure_bql_ns;
+    uint64_t dups = instantiated() - measure_instantiated;
+    unsigned slots;
+
+    if (lost * 100 > measure_exec_ns * MTTCG_AUTO_MAX_LOST ||
+        measure_exec_ns * 100 < wall * MTTCG_AUTO_MIN_BUSY) {
+        slots = 1;
+    } else {
+        slots = MIN(DIV_ROUND_UP(measure_exec_ns, wall), slot_cap);
+    }
+
+    trace_mttcg_auto_decide(wall / SCALE_MS, measure_exec_ns / SCALE_MS,
+                            lost / SCALE_MS, dups, slots);
+    qatomic_set(&mttcg_auto_slots, slots);
+    slot_cap = slots;
+    qemu_cond_broadcast(&slot_cond);
+}
+
+/* Returns false if the vCPU was kicked, or got work, before it had a slot */
+static bool mttcg_slot_enter(CPUState *cpu)
+{
+    MttcgSlotWaiter w = { .cpu = cpu };
+    bool admitted = true;
+
+    qemu_mutex_lock(&slot_lock);
+    if (!measure_start) {
+        measure_start = get_clock();
+        measure_exclusive_ns = cpu_exclusive_wait_ns();
+        measure_instantiated = instantiated();
+    }
+    QTAILQ_INSERT_TAIL(&slot_waiters, &w, next);
+    while (QTAILQ_FIRST(&slot_waiters) != &w || slots_running >= slot_cap) {
+        if (qatomic_read(&cpu->exit_request) || !cpu_work_list_empty(cpu)) {
+            admitted = false;
+            break;
+        }
+        if (!qemu_cond_timedwait(&slot_cond, &slot_lock, MTTCG_AUTO_SLICE_MS) &&
+            QTAILQ_FIRST(&slot_waiters) == &w) {
+            for (unsigned i = 0; i < current_machine->smp.max_cpus; i++) {
+                if (slot_holders[i]) {
+                    cpu_exit(slot_holders[i]);
+                }
+            }
+        }
+    }
+    QTAILQ_REMOVE(&slot_waiters, &w, next);
+    if (admitted) {
+        slots_running++;
+        slot_holders[cpu->cpu_index] = cpu;
+    }
+    /* the next waiter may be admitted, or be the one to kick */
+    qemu_cond_broadcast(&slot_cond);
+    qemu_mutex_unlock(&slot_lock);
+    return admitted;
+}
+
+static void mttcg_slot_leave(CPUState *cpu, int64_t exec_ns)
+{
+    qemu_mutex_lock(&slot_lock);
+    slots_running--;
+    slot_holders[cpu->cpu_index] = NULL;
+    if (!qatomic_read(&mttcg_auto_slots)) {
+        int64_t now = get_clock();
+
+        measure_exec_ns += exec_ns;
+        if (now - measure_start >= MTTCG_AUTO_WINDOW_MS * SCALE_MS) {
+            mttcg_auto_decide(now);
+        }
+    }
+    qemu_cond_broadcast(&slot_cond);
+    qemu_mutex_unlock(&slot_lock);
+}
+
+/* Host time spent in cpu_exec by the vCPU, with its slot held */
+static int mttcg_auto_exec(CPUState *cpu)
+{
+    int64_t start;
+    int r;
+
+    if (!mttcg_slot_enter(cpu)) {
+        return EXCP_INTERRUPT;
+    }
+    start = get_clock();
+    r = tcg_cpus_exec(cpu);
+    mttcg_slot_leave(cpu, get_clock() - start);
+    return r;
+}
+
+/* Take the BQL back after cpu_exec, counting the wait before the decision */
+static void mttcg_auto_lock_iothread(void)
+{
+    int64_t start;
+
+    if (qatomic_read(&mttcg_auto_slots)) {
+        qemu_mutex_lock_iothread();
+        return;
+    }
+    start = get_clock();
+    qemu_mutex_lock_iothread();
+    qemu_mutex_lock(&slot_lock);
+    measure_bql_ns += get_clock() - start;
+    qemu_mutex_unlock(&slot_lock);
+}
+
 /*
  * In the multi-threaded case each vCPU has its own thread. The TLS
  * variable current_cpu can be used deep in the code to find the
  * current CPUState for a given thread.
  */
-#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
-#include "../../tcg/wasm32.h"
-#endif
 static void *mttcg_cpu_thread_fn(void *arg)
 {
     MttcgForceRcuNotifier force_rcu;
@@ -98,8 +287,13 @@ static void *mttcg_cpu_thread_fn(void *arg)
         if (cpu_can_run(cpu)) {
             int r;
             qemu_mutex_unlock_iothread();
-            r = tcg_cpus_exec(cpu);
-            qemu_mutex_lock_iothread();
+            if (mttcg_auto) {
+                r = mttcg_auto_exec(cpu);
+                mttcg_auto_lock_iothread();
+            } else {
+                r = tcg_cpus_exec(cpu);
+                qemu_mutex_lock_iothread();
+            }
             switch (r) {
             case EXCP_DEBUG:
                 cpu_handle_guest_debug(cpu);
@@ -143,6 +337,10 @@ void mttcg_start_vcpu_thread(CPUState *cpu)
     g_assert(tcg_enabled());
     tcg_cpu_init_cflags(cpu, current_machine->smp.max_cpus > 1);
 
+    if (mttcg_auto && !slot_holders) {
+        mttcg_auto_init();
+    }
+
     cpu->thread = g_new0(QemuThread, 1);
     cpu->halt_cond = g_malloc0(sizeof(QemuCond));
     qemu_cond_init(cpu->halt_cond);
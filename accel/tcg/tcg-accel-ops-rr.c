@@ -110,8 +110,17 @@ static void rr_wait_io_event(void)
     CPUState *cpu;
 
     while (all_cpu_threads_idle()) {
+#ifdef EMSCRIPTEN
+        int64_t start = get_clock();
+#endif
+
         rr_stop_kick_timer();
         qemu_cond_wait_iothread(first_cpu->halt_cond);
+#ifdef EMSCRIPTEN
+        CPU_FOREACH(cpu) {
+            cpu_account_halt(cpu, get_clock() - start);
+        }
+#endif
     }
 
     rr_start_kick_timer();
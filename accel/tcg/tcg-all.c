@@ -39,11 +39,15 @@
 #include "hw/boards.h"
 #endif
 #include "internal-target.h"
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+#include "../../tcg/wasm32.h"
+#endif
 
 struct TCGState {
     AccelState parent_obj;
 
     bool mttcg_enabled;
+    bool mttcg_auto;
     bool one_insn_per_tb;
     int splitwx_enabled;
     unsigned long tb_size;
@@ -98,6 +102,8 @@ static void tcg_accel_instance_init(Object *obj)
 }
 
 bool mttcg_enabled;
+bool mttcg_auto;
+unsigned mttcg_auto_slots;
 bool one_insn_per_tb;
 
 static int tcg_init_machine(MachineState *ms)
@@ -111,6 +117,14 @@ static int tcg_init_machine(MachineState *ms)
 
     tcg_allowed = true;
     mttcg_enabled = s->mttcg_enabled;
+    /* a single vCPU has nothing to choose between */
+    mttcg_auto = mttcg_enabled && s->mttcg_auto && max_cpus > 1;
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    /* each TB header has a slot per TCG thread */
+    set_core_nums(mttcg_enabled ? max_cpus : 1);
+    wasm32_stats_init(max_cpus);
+    wasm32_warm_profile_init();
+#endif
 
     page_init();
     tb_htable_init();
@@ -131,6 +145,9 @@ static char *tcg_get_thread(Object *obj, Error **errp)
 {
     TCGState *s = TCG_STATE(obj);
 
+    if (s->mttcg_auto) {
+        return g_strdup("auto");
+    }
     return g_strdup(s->mttcg_enabled ? "multi" : "single");
 }
 
@@ -149,9 +166,14 @@ static void tcg_set_thread(Object *obj, const char *value, Error **errp)
                         "you may get unexpected results");
 #endif
             s->mttcg_enabled = true;
+            s->mttcg_auto = false;
         }
     } else if (strcmp(value, "single") == 0) {
         s->mttcg_enabled = false;
+        s->mttcg_auto = false;
+    } else if (strcmp(value, "auto") == 0) {
+        /* guests that can't use MTTCG run single-threaded */
+        s->mttcg_enabled = s->mttcg_auto = default_mttcg_enabled();
     } else {
         error_setg(errp, "Invalid 'thread' setting %s", value);
     }
@@ -181,6 +203,160 @@ static void tcg_set_tb_size(Object *obj, Visitor *v,
     s->tb_size = value;
 }
 
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+static void tcg_get_wasm_threshold(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    uint32_t value = wasm32_threshold;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_wasm_threshold(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value < 1 || value > WASM_THRESHOLD_MAX) {
+        error_setg(errp, "wasm-threshold must be between 1 and %d",
+                   WASM_THRESHOLD_MAX);
+        return;
+    }
+
+    wasm32_threshold = value;
+}
+
+static void tcg_get_wasm_instance_max(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    uint32_t value = wasm32_instance_max;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_wasm_instance_max(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value < 256 || value > WASM_INSTANCE_MAX_LIMIT) {
+        error_setg(errp, "wasm-instance-max must be between 256 and %d",
+                   WASM_INSTANCE_MAX_LIMIT);
+        return;
+    }
+
+    wasm32_instance_max = value;
+}
+
+static void tcg_get_wasm_instance_cache(Object *obj, Visitor *v,
+                                        const char *name, void *opaque,
+                                        Error **errp)
+{
+    uint32_t value = wasm32_instance_bytes / MiB;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_wasm_instance_cache(Object *obj, Visitor *v,
+                                        const char *name, void *opaque,
+                                        Error **errp)
+{
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value < 1 || value > WASM_INSTANCE_BYTES_LIMIT / MiB) {
+        error_setg(errp, "wasm-instance-cache must be between 1 and %d MiB",
+                   (int)(WASM_INSTANCE_BYTES_LIMIT / MiB));
+        return;
+    }
+
+    wasm32_instance_bytes = value * MiB;
+}
+
+static bool tcg_get_wasm_cache(Object *obj, Error **errp)
+{
+    return wasm32_persist_cache;
+}
+
+static void tcg_set_wasm_cache(Object *obj, bool value, Error **errp)
+{
+    wasm32_persist_cache = value;
+}
+
+static char *tcg_get_wasm_profile(Object *obj, Error **errp)
+{
+    return g_strdup(wasm32_warm_profile);
+}
+
+static void tcg_set_wasm_profile(Object *obj, const char *value, Error **errp)
+{
+    g_free(wasm32_warm_profile);
+    wasm32_warm_profile = g_strdup(value);
+}
+
+static bool tcg_get_wasm_profile_update(Object *obj, Error **errp)
+{
+    return wasm32_warm_profile_update;
+}
+
+static void tcg_set_wasm_profile_update(Object *obj, bool value, Error **errp)
+{
+    wasm32_warm_profile_update = value;
+}
+
+static bool tcg_get_wasm_tail_call(Object *obj, Error **errp)
+{
+    return wasm32_tail_call;
+}
+
+static void tcg_set_wasm_tail_call(Object *obj, bool value, Error **errp)
+{
+    if (value && !wasm32_tail_call_supported()) {
+        error_setg(errp, "wasm-tail-call is not supported by this engine");
+        return;
+    }
+    wasm32_tail_call = value;
+}
+
+static void tcg_get_wasm_diff(Object *obj, Visitor *v,
+                              const char *name, void *opaque,
+                              Error **errp)
+{
+    uint32_t value = wasm32_diff_period;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_wasm_diff(Object *obj, Visitor *v,
+                              const char *name, void *opaque,
+                              Error **errp)
+{
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value > INT_MAX) {
+        error_setg(errp, "wasm-diff must be at most %d", INT_MAX);
+        return;
+    }
+
+    wasm32_diff_period = value;
+}
+#endif
+
 static bool tcg_get_splitwx(Object *obj, Error **errp)
 {
     TCGState *s = TCG_STATE(obj);
@@ -242,6 +418,52 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
     object_class_property_set_description(oc, "tb-size",
         "TCG translation block cache size");
 
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    object_class_property_add(oc, "wasm-threshold", "uint32",
+        tcg_get_wasm_threshold, tcg_set_wasm_threshold,
+        NULL, NULL);
+    object_class_property_set_description(oc, "wasm-threshold",
+        "TCI executions before a TB is compiled to wasm");
+
+    object_class_property_add(oc, "wasm-instance-max", "uint32",
+        tcg_get_wasm_instance_max, tcg_set_wasm_instance_max,
+        NULL, NULL);
+    object_class_property_set_description(oc, "wasm-instance-max",
+        "Compiled TB instances alive at most");
+
+    object_class_property_add(oc, "wasm-instance-cache", "uint32",
+        tcg_get_wasm_instance_cache, tcg_set_wasm_instance_cache,
+        NULL, NULL);
+    object_class_property_set_description(oc, "wasm-instance-cache",
+        "Wasm bytes of the compiled TB instances alive at most, in MiB");
+
+    object_class_property_add_bool(oc, "wasm-cache",
+        tcg_get_wasm_cache, tcg_set_wasm_cache);
+    object_class_property_set_description(oc, "wasm-cache",
+        "Keep compiled wasm TBs in Cache Storage across page loads");
+
+    object_class_property_add_str(oc, "wasm-profile",
+        tcg_get_wasm_profile, tcg_set_wasm_profile);
+    object_class_property_set_description(oc, "wasm-profile",
+        "File listing the hot TBs of earlier runs, to compile them early");
+
+    object_class_property_add_bool(oc, "wasm-profile-update",
+        tcg_get_wasm_profile_update, tcg_set_wasm_profile_update);
+    object_class_property_set_description(oc, "wasm-profile-update",
+        "Write the TBs of this run to the wasm-profile file at exit");
+
+    object_class_property_add_bool(oc, "wasm-tail-call",
+        tcg_get_wasm_tail_call, tcg_set_wasm_tail_call);
+    object_class_property_set_description(oc, "wasm-tail-call",
+        "Jump between compiled wasm TBs with tail calls");
+
+    object_class_property_add(oc, "wasm-diff", "uint32",
+        tcg_get_wasm_diff, tcg_set_wasm_diff,
+        NULL, NULL);
+    object_class_property_set_description(oc, "wasm-diff",
+        "Compare every Nth run of a compiled TB against TCI (0 is off)");
+#endif
+
     object_class_property_add_bool(oc, "split-wx",
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
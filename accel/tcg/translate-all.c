@@ -65,6 +65,9 @@
 #include "internal-target.h"
 #include "perf.h"
 #include "tcg/insn-start-words.h"
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+#include "../../tcg/wasm32.h"
+#endif
 
 TBContext tb_ctx;
 
@@ -276,7 +279,13 @@ static int setjmp_gen_code(CPUArchState *env, TranslationBlock *tb,
     tcg_func_start(tcg_ctx);
 
     tcg_ctx->cpu = env_cpu(env);
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    int64_t start = get_clock();
+    gen_intermediate_code(env_cpu(env), tb, max_insns, pc, host_pc);
+    wasm32_xlate_time(WASM32_XLATE_FRONTEND, get_clock() - start);
+#else
     gen_intermediate_code(env_cpu(env), tb, max_insns, pc, host_pc);
+#endif
     assert(tb->size != 0);
     tcg_ctx->cpu = NULL;
     *max_insns = tb->icount;
@@ -313,6 +322,11 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     }
     QEMU_BUILD_BUG_ON(CF_COUNT_MASK + 1 != TCG_MAX_INSNS);
 
+    /* make room before running out of regions, no flush needed then */
+    if (unlikely(tcg_region_want_retire())) {
+        tb_retire_oldest();
+    }
+
  buffer_overflow:
     assert_no_pages_locked();
     tb = tcg_tb_alloc(tcg_ctx);
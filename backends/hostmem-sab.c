@@ -0,0 +1,164 @@
+/*
+ * QEMU memory backend with the contents of a SABFS file
+ *
+ * Exposes a file of the SABFS region (sabfs/sabfs_qemu.c) as read-only
+ * guest memory, for a virtio-pmem device whose guest mounts it with DAX:
+ *
+ *   -m 512M,slots=2,maxmem=2G
+ *   -object memory-backend-sab,id=tc,filename=/pack/toolchain.erofs,size=256M
+ *   -device virtio-pmem-pci,memdev=tc
+ *
+ * The guest then reads and maps the files of the image straight from this
+ * memory, without 9p requests or copies into its page cache. SABFS blocks
+ * are scattered over the region, so the file is copied once into the
+ * backend when it is created; later changes to the file are not seen.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "sysemu/hostmem.h"
+#include "qapi/error.h"
+#include "qemu/module.h"
+#include "qom/object_interfaces.h"
+#include "qom/object.h"
+#include "sabfs/sabfs_qemu.h"
+
+#define TYPE_MEMORY_BACKEND_SAB "memory-backend-sab"
+
+OBJECT_DECLARE_SIMPLE_TYPE(HostMemoryBackendSab, MEMORY_BACKEND_SAB)
+
+struct HostMemoryBackendSab {
+    HostMemoryBackend parent_obj;
+
+    char *filename;
+};
+
+static bool sab_backend_load(HostMemoryBackendSab *sb, uint8_t *dst,
+                             uint64_t size, Error **errp)
+{
+    sabfs_stat_t st;
+    uint64_t done = 0;
+    int fd;
+
+    if (sabfs_attach() < 0) {
+        error_setg(errp, "SABFS not available");
+        return false;
+    }
+    fd = sabfs_open(sb->filename, SABFS_O_RDONLY, 0);
+    if (fd < 0) {
+        error_setg(errp, "Could not open '%s' in SABFS", sb->filename);
+        return false;
+    }
+    if (sabfs_fstat(fd, &st) < 0 || !st.is_file) {
+        error_setg(errp, "'%s' is not a regular file", sb->filename);
+        goto fail;
+    }
+    if (st.size > size) {
+        error_setg(errp, "'%s' is larger than the backend size", sb->filename);
+        goto fail;
+    }
+    while (done < st.size) {
+        ssize_t ret = sabfs_pread(fd, dst + done, st.size - done, done);
+
+        if (ret <= 0) {
+            error_setg(errp, "Could not read '%s' from SABFS", sb->filename);
+            goto fail;
+        }
+        done += ret;
+    }
+    sabfs_close(fd);
+    return true;
+
+fail:
+    sabfs_close(fd);
+    return false;
+}
+
+static void
+sab_backend_memory_alloc(HostMemoryBackend *backend, Error **errp)
+{
+    ERRP_GUARD();
+    HostMemoryBackendSab *sb = MEMORY_BACKEND_SAB(backend);
+    char *name;
+
+    if (!sb->filename) {
+        error_setg(errp, "filename property is not set");
+        return;
+    }
+    if (!backend->size) {
+        error_setg(errp, "can't create backend with size 0");
+        return;
+    }
+
+    name = host_memory_backend_get_name(backend);
+    memory_region_init_ram_flags_nomigrate(&backend->mr, OBJECT(backend), name,
+                                           backend->size, 0, errp);
+    g_free(name);
+    if (*errp) {
+        return;
+    }
+
+    if (!sab_backend_load(sb, memory_region_get_ram_ptr(&backend->mr),
+                          backend->size, errp)) {
+        return;
+    }
+    /* The guest sees a read-only image, writes to it are dropped */
+    memory_region_set_readonly(&backend->mr, true);
+}
+
+static char *get_filename(Object *o, Error **errp)
+{
+    HostMemoryBackendSab *sb = MEMORY_BACKEND_SAB(o);
+
+    return g_strdup(sb->filename);
+}
+
+static void set_filename(Object *o, const char *str, Error **errp)
+{
+    HostMemoryBackend *backend = MEMORY_BACKEND(o);
+    HostMemoryBackendSab *sb = MEMORY_BACKEND_SAB(o);
+
+    if (host_memory_backend_mr_inited(backend)) {
+        error_setg(errp, "cannot change property 'filename' of %s",
+                   object_get_typename(o));
+        return;
+    }
+    g_free(sb->filename);
+    sb->filename = g_strdup(str);
+}
+
+static void sab_backend_instance_finalize(Object *o)
+{
+    HostMemoryBackendSab *sb = MEMORY_BACKEND_SAB(o);
+
+    g_free(sb->filename);
+}
+
+static void
+sab_backend_class_init(ObjectClass *oc, void *data)
+{
+    HostMemoryBackendClass *bc = MEMORY_BACKEND_CLASS(oc);
+
+    bc->alloc = sab_backend_memory_alloc;
+
+    object_class_property_add_str(oc, "filename", get_filename, set_filename);
+    object_class_property_set_description(oc, "filename",
+        "Path of the file in SABFS");
+}
+
+static const TypeInfo sab_backend_info = {
+    .name = TYPE_MEMORY_BACKEND_SAB,
+    .parent = TYPE_MEMORY_BACKEND,
+    .class_init = sab_backend_class_init,
+    .instance_finalize = sab_backend_instance_finalize,
+    .instance_size = sizeof(HostMemoryBackendSab),
+};
+
+static void register_types(void)
+{
+    type_register_static(&sab_backend_info);
+}
+
+type_init(register_types);
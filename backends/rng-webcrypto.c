@@ -0,0 +1,127 @@
+/*
+ * Entropy from the browser's crypto.getRandomValues()
+ *
+ * rng-random reads a file, and on Emscripten every read of /dev/urandom
+ * is a synchronous hop to the browser main thread, one request at a time.
+ * The thread serving requests here asks Web Crypto itself, which every
+ * worker has, and keeps a pool of 64 KiB of entropy in the wasm memory,
+ * the most one getRandomValues() call returns. A guest draining entropy
+ * at boot is then served with copies out of the pool and one refill in
+ * sixteen 4 KiB requests.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "sysemu/rng.h"
+#include "qemu/main-loop.h"
+#include "qom/object.h"
+#include "sysemu/replay.h"
+
+#include <emscripten.h>
+
+#define RNG_WEBCRYPTO_POOL_SIZE 65536
+
+OBJECT_DECLARE_SIMPLE_TYPE(RngWebCrypto, RNG_WEBCRYPTO)
+
+struct RngWebCrypto {
+    RngBackend parent;
+    QEMUBH *bh;
+    uint8_t *pool;
+    /* Unused bytes at the end of pool */
+    size_t avail;
+};
+
+/*
+ * getRandomValues() rejects views of a SharedArrayBuffer, so the bytes
+ * go through an array of the calling worker first.
+ */
+EM_JS(void, rng_webcrypto_fill, (uint8_t *buf, size_t len), {
+    if (!Module.rngWebCryptoScratch) {
+        Module.rngWebCryptoScratch = new Uint8Array(65536);
+    }
+    const scratch = Module.rngWebCryptoScratch.subarray(0, len);
+    crypto.getRandomValues(scratch);
+    HEAPU8.set(scratch, buf >>> 0);
+});
+
+static void rng_webcrypto_read(RngWebCrypto *s, uint8_t *buf, size_t len)
+{
+    while (len) {
+        size_t n;
+
+        if (!s->avail) {
+            rng_webcrypto_fill(s->pool, RNG_WEBCRYPTO_POOL_SIZE);
+            s->avail = RNG_WEBCRYPTO_POOL_SIZE;
+        }
+        n = MIN(len, s->avail);
+        memcpy(buf, s->pool + RNG_WEBCRYPTO_POOL_SIZE - s->avail, n);
+        /* bytes handed out are not kept around */
+        memset(s->pool + RNG_WEBCRYPTO_POOL_SIZE - s->avail, 0, n);
+        s->avail -= n;
+        buf += n;
+        len -= n;
+    }
+}
+
+static void rng_webcrypto_receive_entropy_bh(void *opaque)
+{
+    RngWebCrypto *s = opaque;
+
+    while (!QSIMPLEQ_EMPTY(&s->parent.requests)) {
+        RngRequest *req = QSIMPLEQ_FIRST(&s->parent.requests);
+
+        rng_webcrypto_read(s, req->data, req->size);
+
+        req->receive_entropy(req->opaque, req->data, req->size);
+
+        rng_backend_finalize_request(&s->parent, req);
+    }
+}
+
+static void rng_webcrypto_request_entropy(RngBackend *b, RngRequest *req)
+{
+    RngWebCrypto *s = RNG_WEBCRYPTO(b);
+
+    replay_bh_schedule_event(s->bh);
+}
+
+static void rng_webcrypto_init(Object *obj)
+{
+    RngWebCrypto *s = RNG_WEBCRYPTO(obj);
+
+    s->bh = qemu_bh_new(rng_webcrypto_receive_entropy_bh, s);
+    s->pool = g_malloc(RNG_WEBCRYPTO_POOL_SIZE);
+}
+
+static void rng_webcrypto_finalize(Object *obj)
+{
+    RngWebCrypto *s = RNG_WEBCRYPTO(obj);
+
+    qemu_bh_delete(s->bh);
+    g_free(s->pool);
+}
+
+static void rng_webcrypto_class_init(ObjectClass *klass, void *data)
+{
+    RngBackendClass *rbc = RNG_BACKEND_CLASS(klass);
+
+    rbc->request_entropy = rng_webcrypto_request_entropy;
+}
+
+static const TypeInfo rng_webcrypto_info = {
+    .name = TYPE_RNG_WEBCRYPTO,
+    .parent = TYPE_RNG_BACKEND,
+    .instance_size = sizeof(RngWebCrypto),
+    .instance_init = rng_webcrypto_init,
+    .instance_finalize = rng_webcrypto_finalize,
+    .class_init = rng_webcrypto_class_init,
+};
+
+static void register_types(void)
+{
+    type_register_static(&rng_webcrypto_info);
+}
+
+type_init(register_types);
@@ -296,3 +296,12 @@ double block_acct_queue_depth(BlockAcctTimedStats *stats,
 
     return (double) sum / elapsed;
 }
+
+void block_acct_cache_event(BlockAcctCacheStats *stats,
+                            enum BlockAcctCacheEvent event, int64_t bytes)
+{
+    assert(event < BLOCK_MAX_CACHE_EVENT);
+
+    stats->nr_ops[event]++;
+    stats->nr_bytes[event] += bytes;
+}
@@ -1014,6 +1014,11 @@ static void curl_refresh_filename(BlockDriverState *bs)
     pstrcpy(bs->exact_filename, sizeof(bs->exact_filename), s->url);
 }
 
+static void curl_refresh_limits(BlockDriverState *bs, Error **errp)
+{
+    /* Every read is an HTTP range request */
+    bs->bl.high_latency = true;
+}
 
 static const char *const curl_strong_runtime_opts[] = {
     CURL_BLOCK_OPT_URL,
@@ -1037,6 +1042,7 @@ static BlockDriver bdrv_http = {
     .bdrv_file_open             = curl_open,
     .bdrv_close                 = curl_close,
     .bdrv_co_getlength          = curl_co_getlength,
+    .bdrv_refresh_limits        = curl_refresh_limits,
 
     .bdrv_co_preadv             = curl_co_preadv,
 
@@ -1056,6 +1062,7 @@ static BlockDriver bdrv_https = {
     .bdrv_file_open             = curl_open,
     .bdrv_close                 = curl_close,
     .bdrv_co_getlength          = curl_co_getlength,
+    .bdrv_refresh_limits        = curl_refresh_limits,
 
     .bdrv_co_preadv             = curl_co_preadv,
 
@@ -1075,6 +1082,7 @@ static BlockDriver bdrv_ftp = {
     .bdrv_file_open             = curl_open,
     .bdrv_close                 = curl_close,
     .bdrv_co_getlength          = curl_co_getlength,
+    .bdrv_refresh_limits        = curl_refresh_limits,
 
     .bdrv_co_preadv             = curl_co_preadv,
 
@@ -1094,6 +1102,7 @@ static BlockDriver bdrv_ftps = {
     .bdrv_file_open             = curl_open,
     .bdrv_close                 = curl_close,
     .bdrv_co_getlength          = curl_co_getlength,
+    .bdrv_refresh_limits        = curl_refresh_limits,
 
     .bdrv_co_preadv             = curl_co_preadv,
 
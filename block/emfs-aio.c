@@ -0,0 +1,210 @@
+/*
+ * Batched I/O on Emscripten's proxied filesystem
+ *
+ * Files outside SABFS live in Emscripten's MEMFS, which is JavaScript on
+ * the browser main thread: every pread() or fstat() from a QEMU thread is
+ * a synchronous hop to the main thread and back, and a thread pool full of
+ * small reads mostly waits for its turn there.
+ *
+ * Instead, requests are queued here and the main thread is asked once to
+ * serve the whole queue within one turn, where each syscall goes straight
+ * into the filesystem. Requests submitted together, e.g. all those of a
+ * virtqueue kick, are handed over with a single kick by way of
+ * defer_call(). Completions go back to the AioContext of each request.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "block/aio.h"
+#include "block/raw-aio.h"
+#include "qemu/coroutine.h"
+#include "qemu/defer-call.h"
+#include "qemu/queue.h"
+#include "qemu/thread.h"
+#include "trace.h"
+
+#include <emscripten.h>
+#include <emscripten/proxying.h>
+#include <emscripten/threading.h>
+
+/* not a QEMU_AIO_* type, fstat() for the length of the file */
+#define EMFS_AIO_GETLENGTH 0x10000
+
+/* requests served per turn of the main thread before the page runs again */
+#define EMFS_AIO_BATCH_MAX 64
+
+typedef struct EmfsAIOCB {
+    Coroutine *co;
+    AioContext *ctx;
+    int fd;
+    int type;
+    uint64_t offset;
+    QEMUIOVector *qiov;
+    int64_t ret;
+    QSIMPLEQ_ENTRY(EmfsAIOCB) next;
+} EmfsAIOCB;
+
+static QemuMutex emfs_aio_lock;
+static QSIMPLEQ_HEAD(, EmfsAIOCB) emfs_aio_queue =
+    QSIMPLEQ_HEAD_INITIALIZER(emfs_aio_queue);
+/* a run of emfs_aio_run() is pending on the main thread */
+static bool emfs_aio_kicked;
+
+static void __attribute__((constructor)) emfs_aio_init(void)
+{
+    qemu_mutex_init(&emfs_aio_lock);
+}
+
+static int64_t emfs_aio_rw(EmfsAIOCB *cb)
+{
+    QEMUIOVector *qiov = cb->qiov;
+    bool is_write = cb->type == QEMU_AIO_WRITE;
+    uint64_t offset = cb->offset;
+    size_t done = 0;
+    int i;
+
+    for (i = 0; i < qiov->niov; i++) {
+        char *buf = qiov->iov[i].iov_base;
+        size_t len = qiov->iov[i].iov_len;
+
+        while (len > 0) {
+            ssize_t n = is_write ? pwrite(cb->fd, buf, len, offset)
+                                 : pread(cb->fd, buf, len, offset);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -errno;
+            }
+            if (n == 0) {
+                if (is_write) {
+                    return -ENOSPC;
+                }
+                /* past the end of the file, as in handle_aiocb_rw() */
+                qemu_iovec_memset(qiov, done, 0, qiov->size - done);
+                return 0;
+            }
+            buf += n;
+            len -= n;
+            offset += n;
+            done += n;
+        }
+    }
+    return 0;
+}
+
+static int64_t emfs_aio_do(EmfsAIOCB *cb)
+{
+    struct stat st;
+
+    switch (cb->type) {
+    case QEMU_AIO_READ:
+    case QEMU_AIO_WRITE:
+        return emfs_aio_rw(cb);
+    case QEMU_AIO_FLUSH:
+        return qemu_fdatasync(cb->fd) < 0 ? -errno : 0;
+    case EMFS_AIO_GETLENGTH:
+        return fstat(cb->fd, &st) < 0 ? -errno : st.st_size;
+    default:
+        fprintf(stderr, "%s: invalid AIO request type, aborting 0x%x.\n",
+                        __func__, cb->type);
+        abort();
+    }
+}
+
+/* Runs on the browser main thread */
+static void emfs_aio_run(void *opaque)
+{
+    QSIMPLEQ_HEAD(, EmfsAIOCB) batch = QSIMPLEQ_HEAD_INITIALIZER(batch);
+    EmfsAIOCB *cb;
+    bool more;
+    int n = 0;
+
+    qemu_mutex_lock(&emfs_aio_lock);
+    while (n < EMFS_AIO_BATCH_MAX &&
+           (cb = QSIMPLEQ_FIRST(&emfs_aio_queue)) != NULL) {
+        QSIMPLEQ_REMOVE_HEAD(&emfs_aio_queue, next);
+        QSIMPLEQ_INSERT_TAIL(&batch, cb, next);
+        n++;
+    }
+    qemu_mutex_unlock(&emfs_aio_lock);
+
+    trace_emfs_aio_run(n);
+    while ((cb = QSIMPLEQ_FIRST(&batch)) != NULL) {
+        QSIMPLEQ_REMOVE_HEAD(&batch, next);
+        cb->ret = emfs_aio_do(cb);
+        /* cb lives on the stack of the coroutine, don't touch it after this */
+        aio_co_schedule(cb->ctx, cb->co);
+    }
+
+    qemu_mutex_lock(&emfs_aio_lock);
+    more = !QSIMPLEQ_EMPTY(&emfs_aio_queue);
+    emfs_aio_kicked = more;
+    qemu_mutex_unlock(&emfs_aio_lock);
+
+    if (more) {
+        /* the rest in the next turn, so that the page stays responsive */
+        emscripten_async_call(emfs_aio_run, NULL, 0);
+    }
+}
+
+static void emfs_aio_kick(void *opaque)
+{
+    bool kick;
+
+    qemu_mutex_lock(&emfs_aio_lock);
+    kick = !emfs_aio_kicked && !QSIMPLEQ_EMPTY(&emfs_aio_queue);
+    emfs_aio_kicked |= kick;
+    qemu_mutex_unlock(&emfs_aio_lock);
+
+    if (!kick) {
+        return;
+    }
+    if (emscripten_is_main_runtime_thread()) {
+        /* nothing to proxy, completions still wait for the yield below */
+        emfs_aio_run(NULL);
+    } else {
+        emscripten_proxy_async(emscripten_proxy_get_system_queue(),
+                               emscripten_main_runtime_thread_id(),
+                               emfs_aio_run, NULL);
+    }
+}
+
+static int64_t coroutine_fn emfs_aio_co_do(int fd, uint64_t offset,
+                                           QEMUIOVector *qiov, int type)
+{
+    EmfsAIOCB cb = {
+        .co     = qemu_coroutine_self(),
+        .ctx    = qemu_get_current_aio_context(),
+        .fd     = fd,
+        .type   = type,
+        .offset = offset,
+        .qiov   = qiov,
+        .ret    = -EINPROGRESS,
+    };
+
+    trace_emfs_aio_co_submit(fd, offset, qiov ? qiov->size : 0, type);
+
+    qemu_mutex_lock(&emfs_aio_lock);
+    QSIMPLEQ_INSERT_TAIL(&emfs_aio_queue, &cb, next);
+    qemu_mutex_unlock(&emfs_aio_lock);
+
+    defer_call(emfs_aio_kick, NULL);
+
+    /* always completes through aio_co_schedule() */
+    qemu_coroutine_yield();
+    return cb.ret;
+}
+
+int coroutine_fn emfs_aio_co_submit(int fd, uint64_t offset,
+                                    QEMUIOVector *qiov, int type)
+{
+    return emfs_aio_co_do(fd, offset, qiov, type);
+}
+
+int64_t coroutine_fn emfs_aio_co_getlength(int fd)
+{
+    return emfs_aio_co_do(fd, 0, NULL, EMFS_AIO_GETLENGTH);
+}
@@ -164,6 +164,7 @@ typedef struct BDRVRawState {
     bool has_write_zeroes:1;
     bool use_linux_aio:1;
     bool use_linux_io_uring:1;
+    bool use_emfs_aio:1;
     int page_cache_inconsistent; /* errno from fdatasync failure */
     bool has_fallocate;
     bool needs_alignment;
@@ -626,7 +627,12 @@ static int raw_open_common(BlockDriverState *bs, QDict *options,
         aio_default = BLOCKDEV_AIO_OPTIONS_IO_URING;
 #endif
     } else {
+#ifdef EMSCRIPTEN
+        /* each syscall is a hop to the browser main thread, batch them */
+        aio_default = BLOCKDEV_AIO_OPTIONS_NATIVE;
+#else
         aio_default = BLOCKDEV_AIO_OPTIONS_THREADS;
+#endif
     }
 
     aio = qapi_enum_parse(&BlockdevAioOptions_lookup,
@@ -638,7 +644,11 @@ static int raw_open_common(BlockDriverState *bs, QDict *options,
         goto fail;
     }
 
+#ifdef EMSCRIPTEN
+    s->use_emfs_aio = (aio == BLOCKDEV_AIO_OPTIONS_NATIVE);
+#else
     s->use_linux_aio = (aio == BLOCKDEV_AIO_OPTIONS_NATIVE);
+#endif
 #ifdef CONFIG_LINUX_IO_URING
     s->use_linux_io_uring = (aio == BLOCKDEV_AIO_OPTIONS_IO_URING);
 #endif
@@ -2497,6 +2507,12 @@ static int coroutine_fn raw_co_prw(BlockDriverState *bs, int64_t *offset_ptr,
         ret = laio_co_submit(s->fd, offset, qiov, type,
                               s->aio_max_batch);
         goto out;
+#endif
+#ifdef EMSCRIPTEN
+    } else if (s->use_emfs_aio) {
+        assert(qiov->size == bytes);
+        ret = emfs_aio_co_submit(s->fd, offset, qiov, type);
+        goto out;
 #endif
     }
 
@@ -2582,6 +2598,11 @@ static int coroutine_fn raw_co_flush_to_disk(BlockDriverState *bs)
     if (s->use_linux_io_uring) {
         return luring_co_submit(bs, s->fd, 0, NULL, QEMU_AIO_FLUSH);
     }
+#endif
+#ifdef EMSCRIPTEN
+    if (s->use_emfs_aio) {
+        return emfs_aio_co_submit(s->fd, 0, NULL, QEMU_AIO_FLUSH);
+    }
 #endif
     return raw_thread_pool_submit(handle_aiocb_flush, &acb);
 }
@@ -2863,6 +2884,13 @@ static int64_t raw_getlength(BlockDriverState *bs)
 
 static int64_t coroutine_fn raw_co_getlength(BlockDriverState *bs)
 {
+#ifdef EMSCRIPTEN
+    BDRVRawState *s = bs->opaque;
+
+    if (s->use_emfs_aio && fd_open(bs) == 0) {
+        return emfs_aio_co_getlength(s->fd);
+    }
+#endif
     return raw_getlength(bs);
 }
 
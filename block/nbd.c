@@ -98,6 +98,7 @@ typedef struct BDRVNBDState {
     /* Connection parameters */
     uint32_t reconnect_delay;
     uint32_t open_timeout;
+    bool websocket;
     SocketAddress *saddr;
     char *export;
     char *tlscredsid;
@@ -1841,6 +1842,12 @@ static QemuOptsList nbd_runtime_opts = {
                     "attempts until successful or until @open-timeout seconds "
                     "have elapsed. Default 0",
         },
+        {
+            .name = "websocket",
+            .type = QEMU_OPT_BOOL,
+            .help = "Connect through a WebSocket opened by an I/O worker "
+                    "of the page, wasm builds only. Default off",
+        },
         { /* end of list */ }
     },
 };
@@ -1897,6 +1904,14 @@ static int nbd_process_options(BlockDriverState *bs, QDict *options,
     s->reconnect_delay = qemu_opt_get_number(opts, "reconnect-delay", 0);
     s->open_timeout = qemu_opt_get_number(opts, "open-timeout", 0);
 
+    s->websocket = qemu_opt_get_bool(opts, "websocket", false);
+#ifndef EMSCRIPTEN
+    if (s->websocket) {
+        error_setg(errp, "websocket is only supported by wasm builds");
+        goto error;
+    }
+#endif
+
     ret = 0;
 
  error:
@@ -1928,6 +1943,9 @@ static int nbd_open(BlockDriverState *bs, QDict *options, int flags,
     s->conn = nbd_client_connection_new(s->saddr, true, s->export,
                                         s->x_dirty_bitmap, s->tlscreds,
                                         s->tlshostname);
+    if (s->websocket) {
+        nbd_client_connection_enable_websocket(s->conn);
+    }
 
     if (s->open_timeout) {
         nbd_client_connection_enable_retry(s->conn);
@@ -1985,6 +2003,7 @@ static void nbd_refresh_limits(BlockDriverState *bs, Error **errp)
     bs->bl.max_pdiscard = QEMU_ALIGN_DOWN(INT_MAX, min);
     bs->bl.max_pwrite_zeroes = max;
     bs->bl.max_transfer = max;
+    bs->bl.high_latency = s->websocket;
 
     /*
      * Assume that if the server supports extended headers, it also
@@ -2093,6 +2112,7 @@ static const char *const nbd_strong_runtime_opts[] = {
     "tls-creds",
     "tls-hostname",
     "server.",
+    "websocket",
 
     NULL
 };
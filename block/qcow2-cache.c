@@ -448,6 +448,46 @@ void *qcow2_cache_is_table_offset(Qcow2Cache *c, uint64_t offset)
     return NULL;
 }
 
+/*
+ * Copy the tables in @buf, which were read from @offset of the image file,
+ * into free entries of the cache. Tables that are cached already are
+ * skipped, and nothing is evicted to make room.
+ *
+ * Returns the number of bytes of @buf that were looked at, which is less
+ * than @bytes if the cache is full.
+ */
+int64_t qcow2_cache_prefill(Qcow2Cache *c, uint64_t offset, const void *buf,
+                            int64_t bytes)
+{
+    int64_t done;
+
+    assert(QEMU_IS_ALIGNED(offset, c->table_size));
+
+    for (done = 0; done + c->table_size <= bytes; done += c->table_size) {
+        int i, lookup_index;
+
+        if (qcow2_cache_is_table_offset(c, offset + done)) {
+            continue;
+        }
+
+        i = lookup_index = ((offset + done) / c->table_size * 4) % c->size;
+        while (c->entries[i].offset != 0 || c->entries[i].ref != 0) {
+            if (++i == c->size) {
+                i = 0;
+            }
+            if (i == lookup_index) {
+                return done;
+            }
+        }
+
+        memcpy(qcow2_cache_get_table_addr(c, i), (const uint8_t *)buf + done,
+               c->table_size);
+        c->entries[i].offset = offset + done;
+        c->entries[i].lru_counter = ++c->lru_counter;
+    }
+    return done;
+}
+
 void qcow2_cache_discard(Qcow2Cache *c, void *table)
 {
     int i = qcow2_cache_get_table_idx(c, table);
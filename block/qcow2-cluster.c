@@ -379,6 +379,38 @@ fail:
     return ret;
 }
 
+/*
+ * Allocate the L2 tables for a virtual disk of @size bytes that don't exist
+ * yet, growing the L1 table as needed. On an image without data clusters
+ * they end up one after another, right after the metadata allocated before.
+ *
+ * Returns 0 on success, -errno in failure case
+ */
+int qcow2_alloc_l2_tables(BlockDriverState *bs, uint64_t size)
+{
+    BDRVQcow2State *s = bs->opaque;
+    int64_t l1_size = size_to_l1(s, size);
+    int l1_index;
+    int ret;
+
+    ret = qcow2_grow_l1_table(bs, l1_size, true);
+    if (ret < 0) {
+        return ret;
+    }
+
+    for (l1_index = 0; l1_index < l1_size; l1_index++) {
+        if (s->l1_table[l1_index] & L1E_OFFSET_MASK) {
+            continue;
+        }
+        ret = l2_allocate(bs, l1_index);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
 /*
  * For a given L2 entry, count the number of contiguous subclusters of
  * the same type starting from @sc_from. Compressed clusters are
@@ -81,6 +81,8 @@ qcow2_co_preadv_compressed(BlockDriverState *bs,
                            uint64_t bytes,
                            QEMUIOVector *qiov,
                            size_t qiov_offset);
+static void qcow2_decompress_cache_init(BlockDriverState *bs);
+static void qcow2_decompress_cache_destroy(BlockDriverState *bs);
 
 static int qcow2_probe(const uint8_t *buf, int buf_size, const char *filename)
 {
@@ -878,10 +880,19 @@ static void qcow2_attach_aio_context(BlockDriverState *bs,
     cache_clean_timer_init(bs, new_context);
 }
 
-static bool read_cache_sizes(BlockDriverState *bs, QemuOpts *opts,
-                             uint64_t *l2_cache_size,
-                             uint64_t *l2_cache_entry_size,
-                             uint64_t *refcount_cache_size, Error **errp)
+/*
+ * True if the image file is fetched lazily over the network, where every
+ * L2 cache miss is a round trip
+ */
+static bool GRAPH_RDLOCK qcow2_high_latency(BlockDriverState *bs)
+{
+    return bs->file && bs->file->bs->bl.high_latency;
+}
+
+static bool GRAPH_RDLOCK
+read_cache_sizes(BlockDriverState *bs, QemuOpts *opts,
+                 uint64_t *l2_cache_size, uint64_t *l2_cache_entry_size,
+                 uint64_t *refcount_cache_size, Error **errp)
 {
     BDRVQcow2State *s = bs->opaque;
     uint64_t combined_cache_size, l2_cache_max_setting;
@@ -894,6 +905,8 @@ static bool read_cache_sizes(BlockDriverState *bs, QemuOpts *opts,
      * should be a multiple of the cluster size. */
     uint64_t max_l2_cache = ROUND_UP(max_l2_entries * l2_entry_size(s),
                                      s->cluster_size);
+    uint64_t l2_cache_max_default = qcow2_high_latency(bs) ?
+        DEFAULT_L2_CACHE_HIGH_LATENCY_MAX_SIZE : DEFAULT_L2_CACHE_MAX_SIZE;
 
     combined_cache_size_set = qemu_opt_get(opts, QCOW2_OPT_CACHE_SIZE);
     l2_cache_size_set = qemu_opt_get(opts, QCOW2_OPT_L2_CACHE_SIZE);
@@ -902,7 +915,7 @@ static bool read_cache_sizes(BlockDriverState *bs, QemuOpts *opts,
 
     combined_cache_size = qemu_opt_get_size(opts, QCOW2_OPT_CACHE_SIZE, 0);
     l2_cache_max_setting = qemu_opt_get_size(opts, QCOW2_OPT_L2_CACHE_SIZE,
-                                             DEFAULT_L2_CACHE_MAX_SIZE);
+                                             l2_cache_max_default);
     *refcount_cache_size = qemu_opt_get_size(opts,
                                              QCOW2_OPT_REFCOUNT_CACHE_SIZE, 0);
 
@@ -1064,6 +1077,7 @@ qcow2_update_options_prepare(BlockDriverState *bs, Qcow2ReopenState *r,
     /* New interval for cache cleanup timer */
     r->cache_clean_interval =
         qemu_opt_get_number(opts, QCOW2_OPT_CACHE_CLEAN_INTERVAL,
+                            qcow2_high_latency(bs) ? 0 :
                             DEFAULT_CACHE_CLEAN_INTERVAL);
 #ifndef CONFIG_LINUX
     if (r->cache_clean_interval != 0) {
@@ -1315,6 +1329,105 @@ static int validate_compression_type(BDRVQcow2State *s, Error **errp)
 }
 
 /* Called with s->lock held.  */
+typedef struct Qcow2PrefetchTask {
+    AioTask task;
+    BlockDriverState *bs;
+    uint64_t offset;
+    uint64_t bytes;
+} Qcow2PrefetchTask;
+
+static coroutine_fn GRAPH_RDLOCK int qcow2_prefetch_task_entry(AioTask *task)
+{
+    Qcow2PrefetchTask *t = container_of(task, Qcow2PrefetchTask, task);
+    BDRVQcow2State *s = t->bs->opaque;
+    void *buf;
+    int ret;
+
+    buf = qemu_try_blockalign(t->bs->file->bs, t->bytes);
+    if (buf == NULL) {
+        return -ENOMEM;
+    }
+
+    BLKDBG_EVENT(t->bs->file, BLKDBG_L2_LOAD);
+    ret = bdrv_co_pread(t->bs->file, t->offset, t->bytes, buf, 0);
+    if (ret == 0 &&
+        qcow2_cache_prefill(s->l2_table_cache, t->offset, buf,
+                            t->bytes) < t->bytes) {
+        /* The cache is full, don't read any further */
+        ret = -ENOSPC;
+    }
+
+    qemu_vfree(buf);
+    return ret;
+}
+
+static int uint64_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Read the L2 tables that the active L1 table refers to into the L2 cache,
+ * merging adjacent tables into large requests that run in parallel. With
+ * the cache covering the whole image and no cache cleaning, which is the
+ * default on high-latency protocols, the tables then stay in memory and no
+ * guest request waits for metadata.
+ *
+ * This is only an optimization, tables that could not be read are loaded
+ * on demand as usual.
+ */
+static void coroutine_fn GRAPH_RDLOCK
+qcow2_prefetch_l2_tables(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+    g_autofree uint64_t *offsets = g_new(uint64_t, s->l1_size);
+    AioTaskPool *aio;
+    int nb_tables = 0, nb_requests = 0;
+    int i, ret;
+
+    for (i = 0; i < s->l1_size; i++) {
+        uint64_t l2_offset = s->l1_table[i] & L1E_OFFSET_MASK;
+
+        /* Leave broken entries to the usual checks */
+        if (l2_offset && !offset_into_cluster(s, l2_offset)) {
+            offsets[nb_tables++] = l2_offset;
+        }
+    }
+    qsort(offsets, nb_tables, sizeof(offsets[0]), uint64_cmp);
+
+    aio = aio_task_pool_new(QCOW2_MAX_WORKERS);
+    for (i = 0; i < nb_tables && aio_task_pool_status(aio) == 0; ) {
+        Qcow2PrefetchTask *task = g_new(Qcow2PrefetchTask, 1);
+        uint64_t start = offsets[i];
+        uint64_t end = start + s->cluster_size;
+
+        /* Tables shared by several L1 entries are read once */
+        while (++i < nb_tables && offsets[i] <= end &&
+               (offsets[i] < end ||
+                end - start < QCOW2_L2_PREFETCH_MAX_BYTES)) {
+            end = offsets[i] + s->cluster_size;
+        }
+
+        *task = (Qcow2PrefetchTask) {
+            .task.func = qcow2_prefetch_task_entry,
+            .bs = bs,
+            .offset = start,
+            .bytes = end - start,
+        };
+        aio_task_pool_start_task(aio, &task->task);
+        nb_requests++;
+    }
+
+    aio_task_pool_wait_all(aio);
+    ret = aio_task_pool_status(aio);
+    aio_task_pool_free(aio);
+
+    trace_qcow2_prefetch_l2_tables(bs, nb_tables, nb_requests, ret);
+}
+
 static int coroutine_fn GRAPH_RDLOCK
 qcow2_do_open(BlockDriverState *bs, QDict *options, int flags,
               bool open_data_file, Error **errp)
@@ -1873,7 +1986,12 @@ qcow2_do_open(BlockDriverState *bs, QDict *options, int flags,
     }
 #endif
 
+    if (qcow2_high_latency(bs) && !(flags & (BDRV_O_CHECK | BDRV_O_INACTIVE))) {
+        qcow2_prefetch_l2_tables(bs);
+    }
+
     qemu_co_queue_init(&s->thread_task_queue);
+    qcow2_decompress_cache_init(bs);
 
     return ret;
 
@@ -2792,6 +2910,7 @@ qcow2_do_close(BlockDriverState *bs, bool close_data_file)
     cache_clean_timer_del(bs);
     qcow2_cache_destroy(s->l2_table_cache);
     qcow2_cache_destroy(s->refcount_block_cache);
+    qcow2_decompress_cache_destroy(bs);
 
     qcrypto_block_free(s->crypto);
     s->crypto = NULL;
@@ -3806,6 +3925,21 @@ qcow2_co_create(BlockdevCreateOptions *create_options, Error **errp)
         goto out;
     }
 
+    /*
+     * Put the L2 tables in place before resizing, so that preallocated
+     * data clusters don't end up in between
+     */
+    if (qcow2_opts->metadata_front) {
+        bdrv_graph_co_rdlock();
+        ret = qcow2_alloc_l2_tables(blk_bs(blk), qcow2_opts->size);
+        bdrv_graph_co_rdunlock();
+
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "Could not allocate L2 tables");
+            goto out;
+        }
+    }
+
     /* Okay, now that we have a valid image, let's give it the right size */
     ret = blk_co_truncate(blk, qcow2_opts->size, false,
                           qcow2_opts->preallocation, 0, errp);
@@ -3930,6 +4064,7 @@ qcow2_co_create_opts(BlockDriver *drv, const char *filename, QemuOpts *opts,
         { BLOCK_OPT_COMPAT_LEVEL,       "version" },
         { BLOCK_OPT_DATA_FILE_RAW,      "data-file-raw" },
         { BLOCK_OPT_COMPRESSION_TYPE,   "compression-type" },
+        { BLOCK_OPT_METADATA_FRONT,     "metadata-front" },
         { NULL, NULL },
     };
 
@@ -4802,47 +4937,235 @@ qcow2_co_pwritev_compressed_part(BlockDriverState *bs,
     return ret;
 }
 
+/*
+ * Compressed clusters are read in full and decompressed even for a single
+ * sector, so the decompressed ones are kept in a small LRU for the reads
+ * that follow, e.g. a guest reading a 64k cluster in 4k requests. Entries
+ * are keyed by the host offset of the compressed data, which can't change
+ * under them until its host cluster is freed: update_refcount() drops them
+ * then through qcow2_decompress_cache_discard().
+ */
+static void qcow2_decompress_cache_init(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+
+    qemu_mutex_init(&s->decompress_lock);
+    qemu_co_queue_init(&s->decompress_queue);
+    memset(s->decompress_cache, 0, sizeof(s->decompress_cache));
+    s->decompress_cache_size =
+        MAX(1, MIN(QCOW2_DECOMPRESS_CACHE_SIZE,
+                   QCOW2_DECOMPRESS_CACHE_BYTES / s->cluster_size));
+    s->decompress_next = 0;
+}
+
+static void qcow2_decompress_cache_destroy(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+
+    if (!s->decompress_cache_size) {
+        return;
+    }
+    for (int i = 0; i < s->decompress_cache_size; i++) {
+        qemu_vfree(s->decompress_cache[i].data);
+        s->decompress_cache[i].data = NULL;
+    }
+    s->decompress_cache_size = 0;
+    qemu_mutex_destroy(&s->decompress_lock);
+}
+
+void qcow2_decompress_cache_discard(BlockDriverState *bs, uint64_t offset,
+                                    uint64_t length)
+{
+    BDRVQcow2State *s = bs->opaque;
+
+    if (!s->decompress_cache_size) {
+        return;
+    }
+    qemu_mutex_lock(&s->decompress_lock);
+    for (int i = 0; i < s->decompress_cache_size; i++) {
+        Qcow2DecompressedCluster *c = &s->decompress_cache[i];
+
+        if (c->coffset && c->coffset < offset + length &&
+            offset < c->coffset + c->csize) {
+            if (c->pending) {
+                c->stale = true;
+            } else {
+                c->coffset = 0;
+            }
+        }
+    }
+    qemu_mutex_unlock(&s->decompress_lock);
+}
+
+/*
+ * Copies bytes at offset_in_cluster of the compressed cluster that l2_entry
+ * points to into qiov, decompressing it into the cache unless it is there
+ * already or another request is at it. A NULL qiov only fills the cache.
+ */
 static int coroutine_fn GRAPH_RDLOCK
-qcow2_co_preadv_compressed(BlockDriverState *bs,
-                           uint64_t l2_entry,
-                           uint64_t offset,
-                           uint64_t bytes,
-                           QEMUIOVector *qiov,
-                           size_t qiov_offset)
+qcow2_co_read_decompressed(BlockDriverState *bs, uint64_t l2_entry,
+                           int offset_in_cluster, uint64_t bytes,
+                           QEMUIOVector *qiov, size_t qiov_offset)
 {
     BDRVQcow2State *s = bs->opaque;
-    int ret = 0, csize;
+    Qcow2DecompressedCluster *e, *victim;
     uint64_t coffset;
-    uint8_t *buf, *out_buf;
-    int offset_in_cluster = offset_into_cluster(s, offset);
+    uint8_t *buf;
+    int ret = 0, csize;
 
     qcow2_parse_compressed_l2_entry(bs, l2_entry, &coffset, &csize);
 
+    qemu_mutex_lock(&s->decompress_lock);
+    for (;;) {
+        e = victim = NULL;
+        for (int i = 0; i < s->decompress_cache_size; i++) {
+            Qcow2DecompressedCluster *c = &s->decompress_cache[i];
+
+            if (c->coffset == coffset && c->csize == csize && !c->stale) {
+                e = c;
+                break;
+            }
+            if (!c->pending && (!victim || c->lru < victim->lru)) {
+                victim = c;
+            }
+        }
+        if (e ? !e->pending : victim != NULL) {
+            break;
+        }
+        /* Wait for the cluster, or for a slot if all of them are filling */
+        qemu_co_queue_wait(&s->decompress_queue, &s->decompress_lock);
+    }
+
+    if (e) {
+        e->lru = ++s->decompress_clock;
+        if (qiov) {
+            qemu_iovec_from_buf(qiov, qiov_offset, e->data + offset_in_cluster,
+                                bytes);
+        }
+        qemu_mutex_unlock(&s->decompress_lock);
+        return 0;
+    }
+
+    e = victim;
+    e->coffset = coffset;
+    e->csize = csize;
+    e->pending = true;
+    e->stale = false;
+    if (!e->data) {
+        e->data = qemu_blockalign(bs, s->cluster_size);
+    }
+    qemu_mutex_unlock(&s->decompress_lock);
+
     buf = g_try_malloc(csize);
     if (!buf) {
-        return -ENOMEM;
+        ret = -ENOMEM;
+    } else {
+        BLKDBG_CO_EVENT(bs->file, BLKDBG_READ_COMPRESSED);
+        ret = bdrv_co_pread(bs->file, coffset, csize, buf, 0);
+        if (ret >= 0 &&
+            qcow2_co_decompress(bs, e->data, s->cluster_size, buf, csize) < 0) {
+            ret = -EIO;
+        }
+        g_free(buf);
+    }
+
+    qemu_mutex_lock(&s->decompress_lock);
+    if (ret >= 0 && qiov) {
+        qemu_iovec_from_buf(qiov, qiov_offset, e->data + offset_in_cluster,
+                            bytes);
+    }
+    e->pending = false;
+    if (ret < 0 || e->stale) {
+        e->coffset = 0;
+        e->stale = false;
     }
+    e->lru = ++s->decompress_clock;
+    qemu_co_queue_restart_all(&s->decompress_queue);
+    qemu_mutex_unlock(&s->decompress_lock);
 
-    out_buf = qemu_blockalign(bs, s->cluster_size);
+    return ret < 0 ? ret : 0;
+}
 
-    BLKDBG_CO_EVENT(bs->file, BLKDBG_READ_COMPRESSED);
-    ret = bdrv_co_pread(bs->file, coffset, csize, buf, 0);
-    if (ret < 0) {
-        goto fail;
+typedef struct Qcow2DecompressAhead {
+    BlockDriverState *bs;
+    uint64_t offset;
+} Qcow2DecompressAhead;
+
+static void coroutine_fn qcow2_co_decompress_ahead_entry(void *opaque)
+{
+    Qcow2DecompressAhead *ra = opaque;
+    BlockDriverState *bs = ra->bs;
+    BDRVQcow2State *s = bs->opaque;
+    unsigned int bytes = s->cluster_size;
+    QCow2SubclusterType type;
+    uint64_t l2_entry;
+    int ret;
+
+    GRAPH_RDLOCK_GUARD();
+
+    qemu_co_mutex_lock(&s->lock);
+    ret = qcow2_get_host_offset(bs, ra->offset, &bytes, &l2_entry, &type);
+    qemu_co_mutex_unlock(&s->lock);
+    if (ret == 0 && type == QCOW2_SUBCLUSTER_COMPRESSED) {
+        qcow2_co_read_decompressed(bs, l2_entry, 0, 0, NULL, 0);
     }
 
-    if (qcow2_co_decompress(bs, out_buf, s->cluster_size, buf, csize) < 0) {
-        ret = -EIO;
-        goto fail;
+    bdrv_dec_in_flight(bs);
+    g_free(ra);
+}
+
+/*
+ * A reader that starts a cluster where its last compressed read ended is
+ * going through the image in order: have the following clusters
+ * decompressed in parallel with it, on other thread pool workers.
+ */
+static void coroutine_fn
+qcow2_decompress_ahead(BlockDriverState *bs, uint64_t offset, uint64_t bytes)
+{
+    BDRVQcow2State *s = bs->opaque;
+    int64_t end = bs->total_sectors * BDRV_SECTOR_SIZE;
+    int ahead = MIN(QCOW2_DECOMPRESS_AHEAD, s->decompress_cache_size / 2);
+    bool sequential;
+
+    qemu_mutex_lock(&s->decompress_lock);
+    sequential = offset == s->decompress_next &&
+                 offset_into_cluster(s, offset) == 0;
+    s->decompress_next = offset + bytes;
+    qemu_mutex_unlock(&s->decompress_lock);
+    if (!sequential) {
+        return;
     }
 
-    qemu_iovec_from_buf(qiov, qiov_offset, out_buf + offset_in_cluster, bytes);
+    for (int i = 1; i <= ahead; i++) {
+        uint64_t next = start_of_cluster(s, offset) + i * s->cluster_size;
+        Qcow2DecompressAhead *ra;
 
-fail:
-    qemu_vfree(out_buf);
-    g_free(buf);
+        if (next >= end) {
+            break;
+        }
+        ra = g_new(Qcow2DecompressAhead, 1);
+        *ra = (Qcow2DecompressAhead) { .bs = bs, .offset = next };
+        bdrv_inc_in_flight(bs);
+        aio_co_enter(bdrv_get_aio_context(bs),
+                     qemu_coroutine_create(qcow2_co_decompress_ahead_entry,
+                                           ra));
+    }
+}
 
-    return ret;
+static int coroutine_fn GRAPH_RDLOCK
+qcow2_co_preadv_compressed(BlockDriverState *bs,
+                           uint64_t l2_entry,
+                           uint64_t offset,
+                           uint64_t bytes,
+                           QEMUIOVector *qiov,
+                           size_t qiov_offset)
+{
+    BDRVQcow2State *s = bs->opaque;
+
+    qcow2_decompress_ahead(bs, offset, bytes);
+    return qcow2_co_read_decompressed(bs, l2_entry,
+                                      offset_into_cluster(s, offset), bytes,
+                                      qiov, qiov_offset);
 }
 
 static int GRAPH_RDLOCK make_completely_empty(BlockDriverState *bs)
@@ -6097,6 +6420,11 @@ static QemuOptsList qcow2_create_opts = {
             .help = "Compression method used for image cluster "        \
                     "compression",                                      \
             .def_value_str = "zlib"                                     \
+        },                                                              \
+        {                                                               \
+            .name = BLOCK_OPT_METADATA_FRONT,                           \
+            .type = QEMU_OPT_BOOL,                                      \
+            .help = "Allocate all L2 tables at the front of the image", \
         },
         QCOW_COMMON_OPTIONS,
         { /* end of list */ }
@@ -126,6 +126,16 @@
 #define DEFAULT_CACHE_CLEAN_INTERVAL 0
 #endif
 
+/*
+ * Default maximum L2 cache size for images on high-latency protocols,
+ * where it is worth keeping all tables in memory (2 TB of guest disk with
+ * the default cluster size)
+ */
+#define DEFAULT_L2_CACHE_HIGH_LATENCY_MAX_SIZE (256 * MiB)
+
+/* Maximum size of a single read when prefetching L2 tables */
+#define QCOW2_L2_PREFETCH_MAX_BYTES (4 * MiB)
+
 #define DEFAULT_CLUSTER_SIZE 65536
 
 #define QCOW2_OPT_DATA_FILE "data-file"
@@ -324,6 +334,24 @@ typedef struct Qcow2BitmapHeaderExt {
 
 #define QCOW2_MAX_THREADS 4
 
+/*
+ * Decompressed clusters kept for the reads that follow, at most this many
+ * and QCOW2_DECOMPRESS_CACHE_BYTES of them, and how many compressed
+ * clusters are decompressed ahead of a sequential reader
+ */
+#define QCOW2_DECOMPRESS_CACHE_SIZE 16
+#define QCOW2_DECOMPRESS_CACHE_BYTES (4 * MiB)
+#define QCOW2_DECOMPRESS_AHEAD 4
+
+typedef struct Qcow2DecompressedCluster {
+    uint64_t coffset; /* of the compressed data, 0 for a free slot */
+    int csize;
+    bool pending;     /* being read and decompressed */
+    bool stale;       /* its host clusters were freed while pending */
+    uint64_t lru;
+    uint8_t *data;
+} Qcow2DecompressedCluster;
+
 typedef struct BDRVQcow2State {
     int cluster_bits;
     int cluster_size;
@@ -411,6 +439,15 @@ typedef struct BDRVQcow2State {
     CoQueue thread_task_queue;
     int nb_threads;
 
+    /* Protects the decompressed cluster cache, which may be used from
+     * outside coroutines to drop freed clusters */
+    QemuMutex decompress_lock;
+    CoQueue decompress_queue; /* requests waiting for a pending cluster */
+    Qcow2DecompressedCluster decompress_cache[QCOW2_DECOMPRESS_CACHE_SIZE];
+    int decompress_cache_size; /* slots in use, 0 before the image is open */
+    uint64_t decompress_clock;
+    uint64_t decompress_next;  /* guest offset after the last compressed read */
+
     BdrvChild *data_file;
 
     bool metadata_preallocation_checked;
@@ -924,6 +961,7 @@ int coroutine_fn GRAPH_RDLOCK
 qcow2_shrink_l1_table(BlockDriverState *bs, uint64_t max_size);
 
 int GRAPH_RDLOCK qcow2_write_l1_entry(BlockDriverState *bs, int l1_index);
+int GRAPH_RDLOCK qcow2_alloc_l2_tables(BlockDriverState *bs, uint64_t size);
 int qcow2_encrypt_sectors(BDRVQcow2State *s, int64_t sector_num,
                           uint8_t *buf, int nb_sectors, bool enc, Error **errp);
 
@@ -1020,6 +1058,8 @@ qcow2_cache_get_empty(BlockDriverState *bs, Qcow2Cache *c, uint64_t offset,
 
 void qcow2_cache_put(Qcow2Cache *c, void **table);
 void *qcow2_cache_is_table_offset(Qcow2Cache *c, uint64_t offset);
+int64_t qcow2_cache_prefill(Qcow2Cache *c, uint64_t offset, const void *buf,
+                            int64_t bytes);
 void qcow2_cache_discard(Qcow2Cache *c, void *table);
 
 /* qcow2-bitmap.c functions */
@@ -1058,6 +1098,9 @@ bool qcow2_supports_persistent_dirty_bitmap(BlockDriverState *bs);
 uint64_t qcow2_get_persistent_dirty_bitmap_size(BlockDriverState *bs,
                                                 uint32_t cluster_size);
 
+void qcow2_decompress_cache_discard(BlockDriverState *bs, uint64_t offset,
+                                    uint64_t length);
+
 ssize_t coroutine_fn
 qcow2_co_compress(BlockDriverState *bs, void *dest, size_t dest_size,
                   const void *src, size_t src_size);
@@ -0,0 +1,866 @@
+/*
+ * Readahead filter block driver
+ *
+ * Caches the data of its child in memory for children with a high
+ * latency, such as images fetched over the network by the browser or
+ * read through OPFS or NBD, where every request that reaches the child
+ * costs a round trip:
+ *
+ *   -blockdev driver=nbd,node-name=remote,...
+ *   -blockdev driver=readahead,node-name=cache,file=remote,cache-size=64M
+ *
+ * The cache holds chunks of chunk-size bytes, which are read from the
+ * child in one request per run of missing chunks. Reads that continue
+ * where the previous one ended start a read-ahead window in the
+ * background, which doubles up to max-readahead with each further
+ * sequential read and is refilled once the guest used half of it; a read
+ * elsewhere ends it.
+ *
+ * Writes smaller than a chunk that land in cached chunks only dirty them,
+ * until a flush or until writeback-size bytes are dirty: then runs of
+ * adjacent dirty chunks are written back with one request each. Other
+ * writes update the cached chunks and go to the child right away.
+ *
+ * The counters are reported with the driver specific statistics of
+ * query-blockstats.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include "block/accounting.h"
+#include "block/block-io.h"
+#include "block/block_int.h"
+#include "qapi/error.h"
+#include "qemu/coroutine.h"
+#include "qemu/module.h"
+#include "qemu/option.h"
+#include "qemu/units.h"
+
+#define READAHEAD_OPT_CACHE_SIZE        "cache-size"
+#define READAHEAD_OPT_CHUNK_SIZE        "chunk-size"
+#define READAHEAD_OPT_MAX_READAHEAD     "max-readahead"
+#define READAHEAD_OPT_WRITEBACK_SIZE    "writeback-size"
+
+typedef struct ReadaheadChunk {
+    int64_t index;
+    uint8_t *data;
+    int pins;           /* requests that yield while they use data */
+    bool loading;       /* data is being read from the child */
+    bool detached;      /* out of the cache, freed once unused */
+    bool dirty;
+    CoQueue waiters;    /* for the end of loading */
+    QTAILQ_ENTRY(ReadaheadChunk) lru;
+} ReadaheadChunk;
+
+typedef struct BDRVReadaheadState {
+    GHashTable *chunks;     /* index -> ReadaheadChunk in the cache */
+    QTAILQ_HEAD(, ReadaheadChunk) lru;  /* least recently used first */
+    int64_t chunk_size;
+    int chunk_bits;
+    int64_t max_chunks;
+    int64_t max_readahead;
+    int64_t max_dirty;      /* in chunks, 0 to write through */
+    int64_t nr_chunks;      /* including detached ones still in use */
+    int64_t nr_dirty;
+
+    /* sequential reads */
+    int64_t next_offset;    /* where the next one would start */
+    int64_t window;         /* current read-ahead, 0 for random reads */
+    int64_t readahead_end;  /* read ahead up to there */
+
+    /*
+     * Writes that go to the child while chunks are loaded: the loads may
+     * read old data, so their chunks aren't kept.
+     */
+    int writes_in_flight;
+    uint64_t write_seq;
+
+    CoMutex writeback_lock;
+    BlockAcctCacheStats stats;
+} BDRVReadaheadState;
+
+typedef struct ReadaheadTask {
+    BlockDriverState *bs;
+    int64_t first;
+    int64_t last;
+} ReadaheadTask;
+
+static QemuOptsList runtime_opts = {
+    .name = "readahead",
+    .head = QTAILQ_HEAD_INITIALIZER(runtime_opts.head),
+    .desc = {
+        {
+            .name = READAHEAD_OPT_CACHE_SIZE,
+            .type = QEMU_OPT_SIZE,
+            .help = "memory for cached chunks, default 32M",
+        },
+        {
+            .name = READAHEAD_OPT_CHUNK_SIZE,
+            .type = QEMU_OPT_SIZE,
+            .help = "unit of caching, a power of two, default 64K",
+        },
+        {
+            .name = READAHEAD_OPT_MAX_READAHEAD,
+            .type = QEMU_OPT_SIZE,
+            .help = "largest read-ahead window, default 2M",
+        },
+        {
+            .name = READAHEAD_OPT_WRITEBACK_SIZE,
+            .type = QEMU_OPT_SIZE,
+            .help = "dirty chunks kept before writing them back, 0 to "
+                    "write through, default 4M",
+        },
+        { /* end of list */ }
+    },
+};
+
+static bool readahead_absorb_opts(BDRVReadaheadState *s, QDict *options,
+                                  BlockDriverState *child_bs, Error **errp)
+{
+    QemuOpts *opts = qemu_opts_create(&runtime_opts, NULL, 0, &error_abort);
+    uint64_t cache_size, chunk_size, max_readahead, writeback_size;
+
+    if (!qemu_opts_absorb_qdict(opts, options, errp)) {
+        qemu_opts_del(opts);
+        return false;
+    }
+
+    cache_size = qemu_opt_get_size(opts, READAHEAD_OPT_CACHE_SIZE, 32 * MiB);
+    chunk_size = qemu_opt_get_size(opts, READAHEAD_OPT_CHUNK_SIZE, 64 * KiB);
+    max_readahead = qemu_opt_get_size(opts, READAHEAD_OPT_MAX_READAHEAD,
+                                      2 * MiB);
+    writeback_size = qemu_opt_get_size(opts, READAHEAD_OPT_WRITEBACK_SIZE,
+                                       4 * MiB);
+    qemu_opts_del(opts);
+
+    if (!is_power_of_2(chunk_size) || chunk_size < BDRV_SECTOR_SIZE ||
+        chunk_size > 16 * MiB) {
+        error_setg(errp, "chunk-size of readahead filter must be a power of "
+                   "two between 512 and 16M");
+        return false;
+    }
+    if (!QEMU_IS_ALIGNED(chunk_size, child_bs->bl.request_alignment)) {
+        error_setg(errp, "chunk-size of readahead filter is not aligned to "
+                   "underlying node request alignment (%" PRIi32 ")",
+                   child_bs->bl.request_alignment);
+        return false;
+    }
+    if (cache_size < 4 * chunk_size) {
+        error_setg(errp, "cache-size of readahead filter must hold at least "
+                   "4 chunks");
+        return false;
+    }
+
+    s->chunk_size = chunk_size;
+    s->chunk_bits = ctz64(chunk_size);
+    s->max_chunks = cache_size >> s->chunk_bits;
+    /* leave most of the cache to what the guest reads */
+    s->max_readahead = MIN(max_readahead, cache_size / 4);
+    s->max_dirty = MIN(writeback_size, cache_size / 2) >> s->chunk_bits;
+    return true;
+}
+
+static ReadaheadChunk *readahead_chunk_find(BDRVReadaheadState *s,
+                                            int64_t index)
+{
+    return g_hash_table_lookup(s->chunks, &index);
+}
+
+static void readahead_chunk_free(BDRVReadaheadState *s, ReadaheadChunk *c)
+{
+    qemu_vfree(c->data);
+    g_free(c);
+    s->nr_chunks--;
+}
+
+/* Drops c from the cache, its data goes with it if nobody uses it */
+static void readahead_chunk_detach(BDRVReadaheadState *s, ReadaheadChunk *c)
+{
+    if (c->detached) {
+        return;
+    }
+    g_hash_table_remove(s->chunks, &c->index);
+    QTAILQ_REMOVE(&s->lru, c, lru);
+    c->detached = true;
+    if (c->dirty) {
+        c->dirty = false;
+        s->nr_dirty--;
+    }
+    if (!c->pins && !c->loading) {
+        readahead_chunk_free(s, c);
+    }
+}
+
+static void readahead_chunk_unpin(BDRVReadaheadState *s, ReadaheadChunk *c)
+{
+    assert(c->pins > 0);
+    if (--c->pins == 0 && c->detached && !c->loading) {
+        readahead_chunk_free(s, c);
+    }
+}
+
+static void readahead_chunk_touch(BDRVReadaheadState *s, ReadaheadChunk *c)
+{
+    QTAILQ_REMOVE(&s->lru, c, lru);
+    QTAILQ_INSERT_TAIL(&s->lru, c, lru);
+}
+
+/* Makes room for a chunk, the cache may outgrow its size while in use */
+static void readahead_evict(BDRVReadaheadState *s)
+{
+    ReadaheadChunk *c, *next;
+
+    QTAILQ_FOREACH_SAFE(c, &s->lru, lru, next) {
+        if (s->nr_chunks < s->max_chunks) {
+            return;
+        }
+        if (!c->pins && !c->loading && !c->dirty) {
+            readahead_chunk_detach(s, c);
+        }
+    }
+}
+
+static ReadaheadChunk *readahead_chunk_new(BlockDriverState *bs,
+                                           int64_t index)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    ReadaheadChunk *c;
+
+    readahead_evict(s);
+
+    c = g_new0(ReadaheadChunk, 1);
+    c->index = index;
+    c->data = qemu_blockalign(bs, s->chunk_size);
+    c->loading = true;
+    qemu_co_queue_init(&c->waiters);
+    g_hash_table_insert(s->chunks, &c->index, c);
+    QTAILQ_INSERT_TAIL(&s->lru, c, lru);
+    s->nr_chunks++;
+    return c;
+}
+
+/*
+ * Reads the missing chunks first..last from the child in one request.
+ * With @out, the chunks are left pinned there; without, they are only
+ * cached.
+ */
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_load(BlockDriverState *bs, int64_t first, int64_t last,
+                  ReadaheadChunk **out)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    int64_t n = last - first + 1;
+    g_autofree ReadaheadChunk **chunks = g_new(ReadaheadChunk *, n);
+    uint64_t write_seq = s->write_seq;
+    bool raced;
+    QEMUIOVector qiov;
+    int ret;
+
+    qemu_iovec_init(&qiov, n);
+    for (int64_t i = 0; i < n; i++) {
+        chunks[i] = readahead_chunk_new(bs, first + i);
+        chunks[i]->pins++;
+        qemu_iovec_add(&qiov, chunks[i]->data, s->chunk_size);
+    }
+
+    ret = bdrv_co_preadv(bs->file, first << s->chunk_bits, qiov.size, &qiov,
+                         0);
+    qemu_iovec_destroy(&qiov);
+    raced = s->writes_in_flight || s->write_seq != write_seq;
+
+    for (int64_t i = 0; i < n; i++) {
+        ReadaheadChunk *c = chunks[i];
+
+        c->loading = false;
+        qemu_co_queue_restart_all(&c->waiters);
+        if (ret < 0 || raced) {
+            readahead_chunk_detach(s, c);
+        }
+        if (ret < 0 || !out) {
+            readahead_chunk_unpin(s, c);
+        } else {
+            out[i] = c;
+        }
+    }
+    return ret;
+}
+
+/*
+ * Pins the chunks first..last in @chunks, reading the missing ones and
+ * waiting for those that other requests read. Sets *missed if it had
+ * to wait for the child.
+ */
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_get(BlockDriverState *bs, int64_t first, int64_t last,
+                 ReadaheadChunk **chunks, bool *missed)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    int64_t i = first;
+
+    while (i <= last) {
+        ReadaheadChunk *c = readahead_chunk_find(s, i);
+        int64_t j = i;
+        int ret;
+
+        if (c && !c->loading) {
+            c->pins++;
+            readahead_chunk_touch(s, c);
+            chunks[i++ - first] = c;
+            continue;
+        }
+        *missed = true;
+        if (c) {
+            c->pins++;
+            qemu_co_queue_wait(&c->waiters, NULL);
+            readahead_chunk_unpin(s, c);
+            continue;
+        }
+
+        while (j < last && !readahead_chunk_find(s, j + 1)) {
+            j++;
+        }
+        ret = readahead_co_load(bs, i, j, chunks + (i - first));
+        if (ret < 0) {
+            while (i-- > first) {
+                readahead_chunk_unpin(s, chunks[i - first]);
+            }
+            return ret;
+        }
+        i = j + 1;
+    }
+    return 0;
+}
+
+static void coroutine_fn readahead_co_entry(void *opaque)
+{
+    ReadaheadTask *task = opaque;
+    BlockDriverState *bs = task->bs;
+    BDRVReadaheadState *s = bs->opaque;
+
+    GRAPH_RDLOCK_GUARD();
+
+    for (int64_t i = task->first; i <= task->last; i++) {
+        int64_t j = i;
+
+        if (readahead_chunk_find(s, i)) {
+            continue;
+        }
+        while (j < task->last && !readahead_chunk_find(s, j + 1)) {
+            j++;
+        }
+        if (readahead_co_load(bs, i, j, NULL) < 0) {
+            break;
+        }
+        block_acct_cache_event(&s->stats, BLOCK_ACCT_CACHE_READAHEAD,
+                               (j - i + 1) << s->chunk_bits);
+        i = j;
+    }
+
+    bdrv_dec_in_flight(bs);
+    g_free(task);
+}
+
+/*
+ * Follows the read of @bytes at @offset: a read that starts where the
+ * previous one ended grows the window, and the chunks after the read are
+ * read in the background once the guest used half of what was read
+ * ahead, as the asynchronous read-ahead of Linux does.
+ */
+static void readahead_start(BlockDriverState *bs, int64_t offset,
+                            int64_t bytes)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    int64_t end = offset + bytes;
+    int64_t length = bs->total_sectors * BDRV_SECTOR_SIZE;
+    int64_t start, stop;
+    ReadaheadTask *task;
+    Coroutine *co;
+
+    if (offset != s->next_offset) {
+        s->window = 0;
+        s->readahead_end = 0;
+    } else if (s->window) {
+        s->window = MIN(s->window * 2, s->max_readahead);
+    } else {
+        s->window = MIN(MAX(bytes, s->chunk_size) * 2, s->max_readahead);
+    }
+    s->next_offset = end;
+
+    if (!s->window || s->readahead_end - end > s->window / 2) {
+        return;
+    }
+    start = MAX(end, s->readahead_end);
+    stop = MIN(end + s->window, length);
+    if (start >= stop) {
+        return;
+    }
+
+    task = g_new(ReadaheadTask, 1);
+    *task = (ReadaheadTask) {
+        .bs = bs,
+        .first = start >> s->chunk_bits,
+        .last = (stop - 1) >> s->chunk_bits,
+    };
+    s->readahead_end = (task->last + 1) << s->chunk_bits;
+
+    bdrv_inc_in_flight(bs);
+    co = qemu_coroutine_create(readahead_co_entry, task);
+    aio_co_enter(bdrv_get_aio_context(bs), co);
+}
+
+static gint readahead_index_cmp(gconstpointer a, gconstpointer b)
+{
+    const ReadaheadChunk *ca = *(ReadaheadChunk * const *)a;
+    const ReadaheadChunk *cb = *(ReadaheadChunk * const *)b;
+
+    return ca->index < cb->index ? -1 : ca->index > cb->index;
+}
+
+/*
+ * Writes back the dirty chunks among first..last, each run of adjacent
+ * ones with a single request. A chunk dirtied again while it is written
+ * stays dirty.
+ */
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_writeback(BlockDriverState *bs, int64_t first, int64_t last)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    g_autoptr(GPtrArray) dirty = NULL;
+    ReadaheadChunk *c;
+    int64_t length;
+    int ret = 0;
+
+    if (!s->nr_dirty) {
+        return 0;
+    }
+
+    qemu_co_mutex_lock(&s->writeback_lock);
+    dirty = g_ptr_array_new();
+    QTAILQ_FOREACH(c, &s->lru, lru) {
+        if (c->dirty && c->index >= first && c->index <= last) {
+            c->dirty = false;
+            s->nr_dirty--;
+            c->pins++;
+            g_ptr_array_add(dirty, c);
+        }
+    }
+    g_ptr_array_sort(dirty, readahead_index_cmp);
+
+    length = bdrv_co_getlength(bs->file->bs);
+    if (length < 0) {
+        ret = length;
+    }
+
+    for (guint i = 0; i < dirty->len && ret >= 0; ) {
+        ReadaheadChunk *head = g_ptr_array_index(dirty, i);
+        int64_t offset = head->index << s->chunk_bits;
+        QEMUIOVector qiov;
+        guint j = i;
+
+        qemu_iovec_init(&qiov, 16);
+        do {
+            int64_t start;
+
+            c = g_ptr_array_index(dirty, j);
+            start = c->index << s->chunk_bits;
+            if (start < length) {
+                qemu_iovec_add(&qiov, c->data,
+                               MIN(s->chunk_size, length - start));
+            }
+            j++;
+        } while (j < dirty->len && qiov.niov < IOV_MAX &&
+                 ((ReadaheadChunk *)g_ptr_array_index(dirty, j))->index ==
+                 c->index + 1);
+
+        if (qiov.size) {
+            ret = bdrv_co_pwritev(bs->file, offset, qiov.size, &qiov, 0);
+            if (ret >= 0) {
+                block_acct_cache_event(&s->stats, BLOCK_ACCT_CACHE_WRITEBACK,
+                                       qiov.size);
+            }
+        }
+        qemu_iovec_destroy(&qiov);
+        if (ret >= 0) {
+            i = j;
+        }
+    }
+
+    for (guint i = 0; i < dirty->len; i++) {
+        c = g_ptr_array_index(dirty, i);
+        /* keep what couldn't be written, for the next flush */
+        if (ret < 0 && !c->dirty && !c->detached) {
+            c->dirty = true;
+            s->nr_dirty++;
+        }
+        readahead_chunk_unpin(s, c);
+    }
+    qemu_co_mutex_unlock(&s->writeback_lock);
+    return ret < 0 ? ret : 0;
+}
+
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_writeback_all(BlockDriverState *bs)
+{
+    return readahead_co_writeback(bs, 0, INT64_MAX);
+}
+
+/*
+ * Drops the clean chunks among first..last, whose data the child may
+ * have changed. Dirty ones hold data the child is yet to get.
+ */
+static void readahead_drop(BDRVReadaheadState *s, int64_t first, int64_t last)
+{
+    ReadaheadChunk *c, *next;
+
+    QTAILQ_FOREACH_SAFE(c, &s->lru, lru, next) {
+        if (c->index >= first && c->index <= last && !c->dirty) {
+            readahead_chunk_detach(s, c);
+        }
+    }
+}
+
+static void readahead_write_begin(BDRVReadaheadState *s)
+{
+    s->writes_in_flight++;
+    s->write_seq++;
+}
+
+static void readahead_write_end(BDRVReadaheadState *s)
+{
+    s->writes_in_flight--;
+    s->write_seq++;
+}
+
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_preadv_part(BlockDriverState *bs, int64_t offset, int64_t bytes,
+                         QEMUIOVector *qiov, size_t qiov_offset,
+                         BdrvRequestFlags flags)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    int64_t first = offset >> s->chunk_bits;
+    int64_t last = (offset + bytes - 1) >> s->chunk_bits;
+    int64_t n = last - first + 1;
+    g_autofree ReadaheadChunk **chunks = NULL;
+    bool missed = false;
+    int64_t pos;
+    int ret;
+
+    if (!bytes) {
+        return 0;
+    }
+    if (n > s->max_chunks / 4) {
+        /* would push everything else out */
+        ret = readahead_co_writeback(bs, first, last);
+        if (ret < 0) {
+            return ret;
+        }
+        return bdrv_co_preadv_part(bs->file, offset, bytes, qiov, qiov_offset,
+                                   flags);
+    }
+
+    readahead_start(bs, offset, bytes);
+
+    chunks = g_new(ReadaheadChunk *, n);
+    ret = readahead_co_get(bs, first, last, chunks, &missed);
+    if (ret < 0) {
+        return ret;
+    }
+
+    pos = offset;
+    for (int64_t i = 0; i < n; i++) {
+        int64_t in_chunk = pos & (s->chunk_size - 1);
+        int64_t len = MIN(s->chunk_size - in_chunk, offset + bytes - pos);
+
+        qemu_iovec_from_buf(qiov, qiov_offset + (pos - offset),
+                            chunks[i]->data + in_chunk, len);
+        readahead_chunk_unpin(s, chunks[i]);
+        pos += len;
+    }
+
+    block_acct_cache_event(&s->stats, missed ? BLOCK_ACCT_CACHE_MISS :
+                           BLOCK_ACCT_CACHE_HIT, bytes);
+    return 0;
+}
+
+/*
+ * Copies a write into the cached chunks it covers. Returns whether all
+ * of them were cached, as a write must be to stay in the cache only.
+ * Chunks being loaded would miss the write and are dropped.
+ */
+static bool readahead_update(BDRVReadaheadState *s, int64_t offset,
+                             int64_t bytes, QEMUIOVector *qiov,
+                             size_t qiov_offset, bool dirty)
+{
+    int64_t pos = offset;
+    bool all = true;
+
+    while (pos < offset + bytes) {
+        ReadaheadChunk *c = readahead_chunk_find(s, pos >> s->chunk_bits);
+        int64_t in_chunk = pos & (s->chunk_size - 1);
+        int64_t len = MIN(s->chunk_size - in_chunk, offset + bytes - pos);
+
+        if (!c || c->loading) {
+            if (c) {
+                readahead_chunk_detach(s, c);
+            }
+            all = false;
+        } else {
+            qemu_iovec_to_buf(qiov, qiov_offset + (pos - offset),
+                              c->data + in_chunk, len);
+            if (dirty && !c->dirty) {
+                c->dirty = true;
+                s->nr_dirty++;
+            }
+            readahead_chunk_touch(s, c);
+        }
+        pos += len;
+    }
+    return all;
+}
+
+static bool readahead_all_cached(BDRVReadaheadState *s, int64_t offset,
+                                 int64_t bytes)
+{
+    for (int64_t i = offset >> s->chunk_bits;
+         i <= (offset + bytes - 1) >> s->chunk_bits; i++) {
+        ReadaheadChunk *c = readahead_chunk_find(s, i);
+
+        if (!c || c->loading) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_pwritev_part(BlockDriverState *bs, int64_t offset, int64_t bytes,
+                          QEMUIOVector *qiov, size_t qiov_offset,
+                          BdrvRequestFlags flags)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    int ret;
+
+    if (!bytes) {
+        return 0;
+    }
+
+    if (s->max_dirty && bytes < s->chunk_size && !(flags & BDRV_REQ_FUA) &&
+        readahead_all_cached(s, offset, bytes)) {
+        readahead_update(s, offset, bytes, qiov, qiov_offset, true);
+        block_acct_cache_event(&s->stats, BLOCK_ACCT_CACHE_COALESCE, bytes);
+        if (s->nr_dirty >= s->max_dirty) {
+            return readahead_co_writeback_all(bs);
+        }
+        return 0;
+    }
+
+    readahead_update(s, offset, bytes, qiov, qiov_offset, false);
+    readahead_write_begin(s);
+    ret = bdrv_co_pwritev_part(bs->file, offset, bytes, qiov, qiov_offset,
+                               flags);
+    readahead_write_end(s);
+    if (ret < 0) {
+        /* the child may hold either data now */
+        readahead_drop(s, offset >> s->chunk_bits,
+                       (offset + bytes - 1) >> s->chunk_bits);
+    }
+    return ret;
+}
+
+/*
+ * For requests that change data without a buffer: dirty data in the
+ * range goes to the child first, then the chunks are dropped.
+ */
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_invalidate(BlockDriverState *bs, int64_t offset, int64_t bytes)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    int64_t first = offset >> s->chunk_bits;
+    int64_t last = (offset + bytes - 1) >> s->chunk_bits;
+    int ret;
+
+    ret = readahead_co_writeback(bs, first, last);
+    readahead_drop(s, first, last);
+    return ret;
+}
+
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_pwrite_zeroes(BlockDriverState *bs, int64_t offset,
+                           int64_t bytes, BdrvRequestFlags flags)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    int ret = readahead_co_invalidate(bs, offset, bytes);
+
+    if (ret < 0) {
+        return ret;
+    }
+    readahead_write_begin(s);
+    ret = bdrv_co_pwrite_zeroes(bs->file, offset, bytes, flags);
+    readahead_write_end(s);
+    return ret;
+}
+
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_pdiscard(BlockDriverState *bs, int64_t offset, int64_t bytes)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    int ret = readahead_co_invalidate(bs, offset, bytes);
+
+    if (ret < 0) {
+        return ret;
+    }
+    readahead_write_begin(s);
+    ret = bdrv_co_pdiscard(bs->file, offset, bytes);
+    readahead_write_end(s);
+    return ret;
+}
+
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_flush_to_os(BlockDriverState *bs)
+{
+    return readahead_co_writeback_all(bs);
+}
+
+static int coroutine_fn GRAPH_RDLOCK
+readahead_co_truncate(BlockDriverState *bs, int64_t offset, bool exact,
+                      PreallocMode prealloc, BdrvRequestFlags flags,
+                      Error **errp)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    int ret;
+
+    ret = readahead_co_writeback_all(bs);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to write back cached data");
+        return ret;
+    }
+    readahead_drop(s, 0, INT64_MAX);
+    s->next_offset = s->window = s->readahead_end = 0;
+    readahead_write_begin(s);
+    ret = bdrv_co_truncate(bs->file, offset, exact, prealloc, flags, errp);
+    readahead_write_end(s);
+    return ret;
+}
+
+static int64_t coroutine_fn GRAPH_RDLOCK
+readahead_co_getlength(BlockDriverState *bs)
+{
+    return bdrv_co_getlength(bs->file->bs);
+}
+
+static BlockStatsSpecific *readahead_get_specific_stats(BlockDriverState *bs)
+{
+    BlockStatsSpecific *stats = g_new(BlockStatsSpecific, 1);
+    BDRVReadaheadState *s = bs->opaque;
+    BlockAcctCacheStats *cs = &s->stats;
+
+    stats->driver = BLOCKDEV_DRIVER_READAHEAD;
+    stats->u.readahead = (BlockStatsSpecificReadahead) {
+        .hits = cs->nr_ops[BLOCK_ACCT_CACHE_HIT],
+        .hit_bytes = cs->nr_bytes[BLOCK_ACCT_CACHE_HIT],
+        .misses = cs->nr_ops[BLOCK_ACCT_CACHE_MISS],
+        .miss_bytes = cs->nr_bytes[BLOCK_ACCT_CACHE_MISS],
+        .readahead_bytes = cs->nr_bytes[BLOCK_ACCT_CACHE_READAHEAD],
+        .coalesced_writes = cs->nr_ops[BLOCK_ACCT_CACHE_COALESCE],
+        .writeback_bytes = cs->nr_bytes[BLOCK_ACCT_CACHE_WRITEBACK],
+        .cached_bytes = s->nr_chunks << s->chunk_bits,
+        .dirty_bytes = s->nr_dirty << s->chunk_bits,
+    };
+
+    return stats;
+}
+
+static int readahead_open(BlockDriverState *bs, QDict *options, int flags,
+                          Error **errp)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    int ret;
+
+    GLOBAL_STATE_CODE();
+
+    ret = bdrv_open_file_child(NULL, options, "file", bs, errp);
+    if (ret < 0) {
+        return ret;
+    }
+
+    GRAPH_RDLOCK_GUARD_MAINLOOP();
+
+    if (!readahead_absorb_opts(s, options, bs->file->bs, errp)) {
+        return -EINVAL;
+    }
+
+    s->chunks = g_hash_table_new(g_int64_hash, g_int64_equal);
+    QTAILQ_INIT(&s->lru);
+    qemu_co_mutex_init(&s->writeback_lock);
+
+    bs->supported_write_flags = BDRV_REQ_WRITE_UNCHANGED |
+        (BDRV_REQ_FUA & bs->file->bs->supported_write_flags);
+
+    bs->supported_zero_flags = BDRV_REQ_WRITE_UNCHANGED |
+        ((BDRV_REQ_FUA | BDRV_REQ_MAY_UNMAP | BDRV_REQ_NO_FALLBACK) &
+            bs->file->bs->supported_zero_flags);
+
+    return 0;
+}
+
+static void readahead_close(BlockDriverState *bs)
+{
+    BDRVReadaheadState *s = bs->opaque;
+    ReadaheadChunk *c, *next;
+
+    /* bdrv_close() flushed and drained the node before */
+    QTAILQ_FOREACH_SAFE(c, &s->lru, lru, next) {
+        readahead_chunk_detach(s, c);
+    }
+    assert(!s->nr_chunks);
+    g_hash_table_destroy(s->chunks);
+}
+
+static void readahead_child_perm(BlockDriverState *bs, BdrvChild *c,
+    BdrvChildRole role, BlockReopenQueue *reopen_queue,
+    uint64_t perm, uint64_t shared, uint64_t *nperm, uint64_t *nshared)
+{
+    bdrv_default_perms(bs, c, role, reopen_queue, perm, shared, nperm, nshared);
+
+    /* writes of others would bypass the cache */
+    *nshared &= ~(BLK_PERM_WRITE | BLK_PERM_RESIZE);
+}
+
+static const char *const readahead_strong_runtime_opts[] = {
+    READAHEAD_OPT_CHUNK_SIZE,
+
+    NULL
+};
+
+static BlockDriver bdrv_readahead_filter = {
+    .format_name = "readahead",
+    .instance_size = sizeof(BDRVReadaheadState),
+
+    .bdrv_open            = readahead_open,
+    .bdrv_close           = readahead_close,
+    .bdrv_child_perm      = readahead_child_perm,
+
+    .bdrv_co_getlength    = readahead_co_getlength,
+
+    .bdrv_co_preadv_part  = readahead_co_preadv_part,
+    .bdrv_co_pwritev_part = readahead_co_pwritev_part,
+    .bdrv_co_pwrite_zeroes = readahead_co_pwrite_zeroes,
+    .bdrv_co_pdiscard     = readahead_co_pdiscard,
+    .bdrv_co_flush_to_os  = readahead_co_flush_to_os,
+    .bdrv_co_truncate     = readahead_co_truncate,
+
+    .bdrv_get_specific_stats = readahead_get_specific_stats,
+
+    .strong_runtime_opts  = readahead_strong_runtime_opts,
+    .is_filter            = true,
+};
+
+static void bdrv_readahead_init(void)
+{
+    bdrv_register(&bdrv_readahead_filter);
+}
+
+block_init(bdrv_readahead_init);
@@ -0,0 +1,377 @@
+/*
+ * Block protocol driver for images in SABFS
+ *
+ * Serves a raw image, or the file below a format driver such as qcow2,
+ * straight from the SABFS region of the wasm memory (sabfs/sabfs_qemu.c)
+ * instead of Emscripten's proxied POSIX filesystem. Requests are copied
+ * between SABFS and the request's buffers, which for guest devices are
+ * guest RAM, without alignment or bounce buffers, and zeroed or discarded
+ * ranges give their blocks back to SABFS. With SABFS persisted to OPFS
+ * (SABFS.persist()) images survive page reloads and flushes are durable.
+ *
+ *   -drive if=virtio,format=raw,file=sab:/pack/rootfs.bin
+ *
+ * A plain filename that names a file in SABFS picks this driver too.
+ * qemu-img can create and resize images in SABFS with it as well:
+ *
+ *   qemu-img convert -p -m 16 -O qcow2 -c sab:/in.raw sab:/out.qcow2
+ *
+ * Small requests are copied right away in the thread of the AioContext.
+ * Larger ones and flushes run in the thread pool, so that the requests the
+ * guest has in flight on all its queues are served by several workers at
+ * once, and a read that waits for SABFS to fetch its range on demand or a
+ * flush that waits for the write-back doesn't hold up the others.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qapi/qmp/qdict.h"
+#include "qemu/cutils.h"
+#include "qemu/module.h"
+#include "qemu/option.h"
+#include "qemu/units.h"
+#include "block/block-io.h"
+#include "block/block_int.h"
+#include "block/thread-pool.h"
+#include "sabfs/sabfs_qemu.h"
+
+/* larger requests go to the thread pool */
+#define SAB_INLINE_MAX (64 * KiB)
+
+typedef struct BDRVSabState {
+    int fd;
+} BDRVSabState;
+
+typedef struct SabRequest {
+    int fd;
+    int64_t offset;
+    int64_t bytes;
+    QEMUIOVector *qiov;
+    bool is_write;
+} SabRequest;
+
+static QemuOptsList runtime_opts = {
+    .name = "sab",
+    .head = QTAILQ_HEAD_INITIALIZER(runtime_opts.head),
+    .desc = {
+        {
+            .name = "filename",
+            .type = QEMU_OPT_STRING,
+            .help = "path of the image in SABFS",
+        },
+        { /* end of list */ }
+    },
+};
+
+static void sab_parse_filename(const char *filename, QDict *options,
+                               Error **errp)
+{
+    bdrv_parse_filename_strip_prefix(filename, "sab:", options);
+}
+
+static int sab_probe_device(const char *filename)
+{
+    sabfs_stat_t st;
+
+    if (sabfs_stat(filename, &st) == 0 && st.is_file) {
+        return 50;
+    }
+    return 0;
+}
+
+static int sab_file_open(BlockDriverState *bs, QDict *options, int flags,
+                         Error **errp)
+{
+    BDRVSabState *s = bs->opaque;
+    QemuOpts *opts;
+    const char *filename;
+    int ret = 0;
+
+    opts = qemu_opts_create(&runtime_opts, NULL, 0, &error_abort);
+    if (!qemu_opts_absorb_qdict(opts, options, errp)) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    filename = qemu_opt_get(opts, "filename");
+    if (!filename) {
+        error_setg(errp, "sab driver requires a filename");
+        ret = -EINVAL;
+        goto out;
+    }
+    if (sabfs_attach() < 0) {
+        error_setg(errp, "SABFS not available");
+        ret = -ENODEV;
+        goto out;
+    }
+
+    s->fd = sabfs_open(filename,
+                       (flags & BDRV_O_RDWR) ? SABFS_O_RDWR : SABFS_O_RDONLY,
+                       0);
+    if (s->fd < 0) {
+        error_setg(errp, "Could not open '%s' in SABFS", filename);
+        ret = -ENOENT;
+        goto out;
+    }
+
+    bs->supported_zero_flags = BDRV_REQ_MAY_UNMAP | BDRV_REQ_NO_FALLBACK;
+    bs->supported_truncate_flags = BDRV_REQ_ZERO_WRITE;
+out:
+    qemu_opts_del(opts);
+    return ret;
+}
+
+static void sab_close(BlockDriverState *bs)
+{
+    BDRVSabState *s = bs->opaque;
+
+    sabfs_close(s->fd);
+}
+
+static void sab_refresh_limits(BlockDriverState *bs, Error **errp)
+{
+    /* Any byte range is a plain copy, let requests through as they are */
+    bs->bl.request_alignment = 1;
+    bs->bl.pdiscard_alignment = SABFS_BLOCK_SIZE;
+}
+
+static int64_t coroutine_fn sab_co_getlength(BlockDriverState *bs)
+{
+    BDRVSabState *s = bs->opaque;
+    sabfs_stat_t st;
+
+    if (sabfs_fstat(s->fd, &st) < 0) {
+        return -EIO;
+    }
+    return st.size;
+}
+
+static int64_t coroutine_fn
+sab_co_get_allocated_file_size(BlockDriverState *bs)
+{
+    BDRVSabState *s = bs->opaque;
+    sabfs_stat_t st;
+
+    if (sabfs_fstat(s->fd, &st) < 0) {
+        return -EIO;
+    }
+    return (int64_t)st.blocks * SABFS_BLOCK_SIZE;
+}
+
+static int sab_readv(SabRequest *req)
+{
+    QEMUIOVector *qiov = req->qiov;
+    int64_t done = 0;
+
+    for (int i = 0; i < qiov->niov; i++) {
+        size_t len = qiov->iov[i].iov_len;
+        ssize_t ret = sabfs_pread(req->fd, qiov->iov[i].iov_base, len,
+                                  req->offset + done);
+
+        if (ret < 0) {
+            return -EIO;
+        }
+        if (ret < len) {
+            /* past the end of the image, like file-posix */
+            qemu_iovec_memset(qiov, done + ret, 0, req->bytes - done - ret);
+            break;
+        }
+        done += len;
+    }
+    return 0;
+}
+
+static int sab_writev(SabRequest *req)
+{
+    QEMUIOVector *qiov = req->qiov;
+    int64_t offset = req->offset;
+
+    for (int i = 0; i < qiov->niov; i++) {
+        ssize_t len = qiov->iov[i].iov_len;
+
+        if (sabfs_pwrite(req->fd, qiov->iov[i].iov_base, len, offset) != len) {
+            return -ENOSPC;
+        }
+        offset += len;
+    }
+    return 0;
+}
+
+static int sab_rw_worker(void *opaque)
+{
+    SabRequest *req = opaque;
+
+    return req->is_write ? sab_writev(req) : sab_readv(req);
+}
+
+static coroutine_fn int sab_co_rw(BlockDriverState *bs, int64_t offset,
+                                  int64_t bytes, QEMUIOVector *qiov,
+                                  bool is_write)
+{
+    BDRVSabState *s = bs->opaque;
+    SabRequest req = {
+        .fd = s->fd,
+        .offset = offset,
+        .bytes = bytes,
+        .qiov = qiov,
+        .is_write = is_write,
+    };
+
+    if (bytes <= SAB_INLINE_MAX) {
+        return sab_rw_worker(&req);
+    }
+    return thread_pool_submit_co(sab_rw_worker, &req);
+}
+
+static coroutine_fn int sab_co_preadv(BlockDriverState *bs,
+                                      int64_t offset, int64_t bytes,
+                                      QEMUIOVector *qiov,
+                                      BdrvRequestFlags flags)
+{
+    return sab_co_rw(bs, offset, bytes, qiov, false);
+}
+
+static coroutine_fn int sab_co_pwritev(BlockDriverState *bs,
+                                       int64_t offset, int64_t bytes,
+                                       QEMUIOVector *qiov,
+                                       BdrvRequestFlags flags)
+{
+    return sab_co_rw(bs, offset, bytes, qiov, true);
+}
+
+static coroutine_fn int sab_co_pwrite_zeroes(BlockDriverState *bs,
+                                             int64_t offset, int64_t bytes,
+                                             BdrvRequestFlags flags)
+{
+    BDRVSabState *s = bs->opaque;
+
+    return sabfs_punch(s->fd, offset, bytes) < 0 ? -ENOSPC : 0;
+}
+
+static coroutine_fn int sab_co_pdiscard(BlockDriverState *bs,
+                                        int64_t offset, int64_t bytes)
+{
+    BDRVSabState *s = bs->opaque;
+
+    return sabfs_punch(s->fd, offset, bytes) < 0 ? -EIO : 0;
+}
+
+static int sab_flush_worker(void *opaque)
+{
+    return sabfs_sync() < 0 ? -EIO : 0;
+}
+
+static coroutine_fn int sab_co_flush(BlockDriverState *bs)
+{
+    /* With SABFS persisted to OPFS, a guest flush waits for the write-back */
+    return thread_pool_submit_co(sab_flush_worker, NULL);
+}
+
+static int coroutine_fn sab_co_truncate(BlockDriverState *bs, int64_t offset,
+                                        bool exact, PreallocMode prealloc,
+                                        BdrvRequestFlags flags, Error **errp)
+{
+    BDRVSabState *s = bs->opaque;
+
+    if (prealloc != PREALLOC_MODE_OFF) {
+        error_setg(errp, "Unsupported preallocation mode '%s'",
+                   PreallocMode_str(prealloc));
+        return -ENOTSUP;
+    }
+    if (sabfs_ftruncate(s->fd, offset) < 0) {
+        error_setg(errp, "Could not resize the image in SABFS");
+        return -ENOSPC;
+    }
+    return 0;
+}
+
+static int coroutine_fn sab_co_create_opts(BlockDriver *drv,
+                                           const char *filename,
+                                           QemuOpts *opts, Error **errp)
+{
+    int64_t size;
+    int fd, ret = 0;
+
+    size = ROUND_UP(qemu_opt_get_size_del(opts, BLOCK_OPT_SIZE, 0),
+                    BDRV_SECTOR_SIZE);
+    strstart(filename, "sab:", &filename);
+    if (sabfs_attach() < 0) {
+        error_setg(errp, "SABFS not available");
+        return -ENODEV;
+    }
+
+    fd = sabfs_open(filename, SABFS_O_RDWR | SABFS_O_CREAT | SABFS_O_TRUNC,
+                    0644);
+    if (fd < 0) {
+        error_setg(errp, "Could not create '%s' in SABFS", filename);
+        return -EIO;
+    }
+    if (sabfs_ftruncate(fd, size) < 0) {
+        error_setg(errp, "Could not resize '%s' in SABFS", filename);
+        ret = -ENOSPC;
+    }
+    sabfs_close(fd);
+    return ret;
+}
+
+static QemuOptsList sab_create_opts = {
+    .name = "sab-create-opts",
+    .head = QTAILQ_HEAD_INITIALIZER(sab_create_opts.head),
+    .desc = {
+        {
+            .name = BLOCK_OPT_SIZE,
+            .type = QEMU_OPT_SIZE,
+            .help = "Virtual disk size"
+        },
+        { /* end of list */ }
+    }
+};
+
+static int sab_reopen_prepare(BDRVReopenState *reopen_state,
+                              BlockReopenQueue *queue, Error **errp)
+{
+    return 0;
+}
+
+static const char *const sab_strong_runtime_opts[] = {
+    "filename",
+
+    NULL
+};
+
+static BlockDriver bdrv_sab = {
+    .format_name            = "sab",
+    .protocol_name          = "sab",
+    .instance_size          = sizeof(BDRVSabState),
+
+    .bdrv_file_open         = sab_file_open,
+    .bdrv_parse_filename    = sab_parse_filename,
+    .bdrv_probe_device      = sab_probe_device,
+    .bdrv_close             = sab_close,
+    .bdrv_refresh_limits    = sab_refresh_limits,
+    .bdrv_reopen_prepare    = sab_reopen_prepare,
+    .bdrv_co_create_opts    = sab_co_create_opts,
+    .bdrv_has_zero_init     = bdrv_has_zero_init_1,
+    .bdrv_co_truncate       = sab_co_truncate,
+    .bdrv_co_getlength      = sab_co_getlength,
+    .bdrv_co_get_allocated_file_size = sab_co_get_allocated_file_size,
+
+    .bdrv_co_preadv         = sab_co_preadv,
+    .bdrv_co_pwritev        = sab_co_pwritev,
+    .bdrv_co_pwrite_zeroes  = sab_co_pwrite_zeroes,
+    .bdrv_co_pdiscard       = sab_co_pdiscard,
+    .bdrv_co_flush_to_disk  = sab_co_flush,
+
+    .create_opts            = &sab_create_opts,
+    .strong_runtime_opts    = sab_strong_runtime_opts,
+};
+
+static void bdrv_sab_init(void)
+{
+    bdrv_register(&bdrv_sab);
+}
+
+block_init(bdrv_sab_init);
@@ -0,0 +1,419 @@
+/*
+ * Chardev serving the guest agent's bulk file transfers from SABFS
+ *
+ * The host end of the channel described in qemu/file-xfer.h. Give it a
+ * virtio-serial port of that name and the guest agent's guest-file-push
+ * and guest-file-pull commands move files between the guest and SABFS:
+ *
+ *   -chardev sabfs-xfer,id=xfer0,root=/shared
+ *   -device virtio-serial-pci
+ *   -device virtserialport,chardev=xfer0,name=org.qemu.guest_agent.xfer
+ *
+ * Data written by the guest goes from the virtqueue buffers in guest RAM
+ * straight into SABFS with sabfs_pwrite(), and reads are passed to the
+ * port from the SABFS blocks in place, so a transfer costs one copy per
+ * byte and is bounded by memory bandwidth rather than by 9p round trips.
+ * Paths of the guest are resolved below root and can't leave it.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include "chardev/char.h"
+#include "chardev/char-fe.h"
+#include "qapi/error.h"
+#include "qemu/bswap.h"
+#include "qemu/file-xfer.h"
+#include "qemu/module.h"
+#include "qemu/option.h"
+#include "qom/object.h"
+#include "sabfs/sabfs_qemu.h"
+
+struct SabfsXferChardev {
+    Chardev parent;
+    char *root;
+
+    /* request being received */
+    FileXferHdr req;
+    uint32_t req_got;
+    char path[PATH_MAX];
+    uint32_t path_got;
+    uint32_t path_left;
+    uint64_t wr_off;
+    uint32_t wr_left;
+
+    /* open file */
+    int fd;
+    uint64_t ino;
+    uint64_t size;
+    int err;
+
+    /* reply being sent, followed by rd_left bytes of the file */
+    FileXferHdr reply;
+    uint32_t reply_sent;
+    bool reply_pending;
+    uint64_t rd_off;
+    uint64_t rd_left;
+};
+typedef struct SabfsXferChardev SabfsXferChardev;
+
+DECLARE_INSTANCE_CHECKER(SabfsXferChardev, SABFS_XFER_CHARDEV,
+                         TYPE_CHARDEV_SABFS_XFER)
+
+static const uint8_t sabfs_xfer_zero_block[SABFS_BLOCK_SIZE];
+
+static void sabfs_xfer_close_file(SabfsXferChardev *d)
+{
+    if (d->fd >= 0) {
+        sabfs_close(d->fd);
+        d->fd = -1;
+    }
+}
+
+/* Passes the reply and the data after it on as far as the port takes it */
+static void sabfs_xfer_pump(SabfsXferChardev *d)
+{
+    Chardev *chr = CHARDEV(d);
+
+    while (d->reply_pending) {
+        int room = qemu_chr_be_can_write(chr);
+        const uint8_t *blk;
+        uint64_t boff;
+        int n;
+
+        if (room <= 0) {
+            /* go on in sabfs_xfer_chr_accept_input() */
+            return;
+        }
+        if (d->reply_sent < sizeof(d->reply)) {
+            n = MIN(room, sizeof(d->reply) - d->reply_sent);
+            qemu_chr_be_write(chr, (uint8_t *)&d->reply + d->reply_sent, n);
+            d->reply_sent += n;
+            continue;
+        }
+        if (!d->rd_left) {
+            d->reply_pending = false;
+            break;
+        }
+        boff = d->rd_off % SABFS_BLOCK_SIZE;
+        n = MIN(room, MIN(d->rd_left, SABFS_BLOCK_SIZE - boff));
+        blk = sabfs_map_block(d->ino, d->rd_off / SABFS_BLOCK_SIZE);
+        qemu_chr_be_write(chr, (blk ? blk : sabfs_xfer_zero_block) + boff, n);
+        d->rd_off += n;
+        d->rd_left -= n;
+    }
+}
+
+static void sabfs_xfer_reply(SabfsXferChardev *d, int status, uint32_t len,
+                             uint64_t offset)
+{
+    d->reply = (FileXferHdr) {
+        .magic = cpu_to_le32(FILE_XFER_MAGIC),
+        .op = d->req.op,
+        .len = cpu_to_le32(len),
+        .status = cpu_to_le32(status),
+        .offset = cpu_to_le64(offset),
+    };
+    d->reply_sent = 0;
+    d->reply_pending = true;
+}
+
+/* Creates the directories above path, for pushes of whole trees */
+static void sabfs_xfer_mkdir_parents(const char *path)
+{
+    g_autofree char *dir = g_strdup(path);
+    char *p;
+
+    for (p = strchr(dir + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        sabfs_mkdir(dir, 0755);
+        *p = '/';
+    }
+}
+
+static int sabfs_xfer_open(SabfsXferChardev *d, bool write)
+{
+    g_autofree char *path = NULL;
+    g_auto(GStrv) parts = NULL;
+    sabfs_stat_t st;
+    char **p;
+
+    sabfs_xfer_close_file(d);
+    d->err = 0;
+
+    if (d->path_got == sizeof(d->path)) {
+        return -ENAMETOOLONG;
+    }
+    d->path[d->path_got] = '\0';
+    parts = g_strsplit(d->path, "/", -1);
+    for (p = parts; *p; p++) {
+        if (!strcmp(*p, "..")) {
+            return -EACCES;
+        }
+    }
+    path = g_build_filename(d->root, d->path, NULL);
+
+    if (write) {
+        sabfs_xfer_mkdir_parents(path);
+        d->fd = sabfs_open(path, SABFS_O_WRONLY | SABFS_O_CREAT |
+                           SABFS_O_TRUNC, 0644);
+    } else {
+        d->fd = sabfs_open(path, SABFS_O_RDONLY, 0);
+    }
+    if (d->fd < 0) {
+        return -ENOENT;
+    }
+    if (sabfs_fstat(d->fd, &st) < 0 || !st.is_file) {
+        sabfs_xfer_close_file(d);
+        return -EISDIR;
+    }
+    d->ino = st.ino;
+    d->size = st.size;
+    return 0;
+}
+
+/* Called once the header, and the path of an OPEN, are in */
+static void sabfs_xfer_request(SabfsXferChardev *d)
+{
+    uint32_t len = le32_to_cpu(d->req.len);
+    uint64_t offset = le64_to_cpu(d->req.offset);
+    int ret;
+
+    switch (le16_to_cpu(d->req.op)) {
+    case FILE_XFER_OP_OPEN:
+        ret = sabfs_xfer_open(d, le16_to_cpu(d->req.flags) &
+                                 FILE_XFER_F_WRITE);
+        sabfs_xfer_reply(d, ret, 0, ret ? 0 : d->size);
+        break;
+    case FILE_XFER_OP_READ:
+        if (d->fd < 0) {
+            sabfs_xfer_reply(d, -EBADF, 0, offset);
+            break;
+        }
+        d->rd_off = offset;
+        d->rd_left = offset < d->size ? MIN(len, d->size - offset) : 0;
+        sabfs_xfer_reply(d, 0, d->rd_left, offset);
+        break;
+    case FILE_XFER_OP_CLOSE:
+        ret = d->fd < 0 ? -EBADF : d->err;
+        sabfs_xfer_close_file(d);
+        sabfs_xfer_reply(d, ret, 0, 0);
+        break;
+    default:
+        sabfs_xfer_reply(d, -EINVAL, 0, 0);
+        break;
+    }
+    sabfs_xfer_pump(d);
+}
+
+/* Takes the bytes the guest writes to the port */
+static int sabfs_xfer_chr_write(Chardev *chr, const uint8_t *buf, int len)
+{
+    SabfsXferChardev *d = SABFS_XFER_CHARDEV(chr);
+    int done = 0;
+
+    while (done < len) {
+        uint32_t n;
+
+        if (d->wr_left) {
+            n = MIN(d->wr_left, len - done);
+            if (!d->err &&
+                sabfs_pwrite(d->fd, buf + done, n, d->wr_off) != n) {
+                d->err = -EIO;
+            }
+            d->wr_off += n;
+            d->wr_left -= n;
+            done += n;
+            continue;
+        }
+        if (d->path_left) {
+            n = MIN(d->path_left, len - done);
+            memcpy(d->path + d->path_got, buf + done,
+                   MIN(n, sizeof(d->path) - d->path_got));
+            d->path_got = MIN(d->path_got + n, sizeof(d->path));
+            d->path_left -= n;
+            done += n;
+            if (!d->path_left) {
+                sabfs_xfer_request(d);
+            }
+            continue;
+        }
+        if (d->reply_pending) {
+            /* one request at a time, the watch fires once it's answered */
+            break;
+        }
+
+        n = MIN(sizeof(d->req) - d->req_got, len - done);
+        memcpy((uint8_t *)&d->req + d->req_got, buf + done, n);
+        d->req_got += n;
+        done += n;
+        if (d->req_got < sizeof(d->req)) {
+            continue;
+        }
+        d->req_got = 0;
+
+        if (le32_to_cpu(d->req.magic) != FILE_XFER_MAGIC) {
+            /* out of step, e.g. after an agent died mid-request */
+            sabfs_xfer_reply(d, -EPROTO, 0, 0);
+            sabfs_xfer_pump(d);
+            continue;
+        }
+        switch (le16_to_cpu(d->req.op)) {
+        case FILE_XFER_OP_WRITE:
+            d->wr_off = le64_to_cpu(d->req.offset);
+            d->wr_left = le32_to_cpu(d->req.len);
+            if (d->fd < 0) {
+                d->err = -EBADF;
+            }
+            break;
+        case FILE_XFER_OP_OPEN:
+            d->path_got = 0;
+            d->path_left = le32_to_cpu(d->req.len);
+            if (!d->path_left) {
+                sabfs_xfer_request(d);
+            }
+            break;
+        default:
+            sabfs_xfer_request(d);
+            break;
+        }
+    }
+
+    if (!done && len) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return done;
+}
+
+static void sabfs_xfer_chr_accept_input(Chardev *chr)
+{
+    sabfs_xfer_pump(SABFS_XFER_CHARDEV(chr));
+}
+
+/*
+ * The agent opened or closed the port, anything in flight belongs to a
+ * previous agent
+ */
+static void sabfs_xfer_chr_set_fe_open(Chardev *chr, int fe_open)
+{
+    SabfsXferChardev *d = SABFS_XFER_CHARDEV(chr);
+
+    sabfs_xfer_close_file(d);
+    d->req_got = 0;
+    d->path_left = 0;
+    d->wr_left = 0;
+    d->rd_left = 0;
+    d->reply_pending = false;
+}
+
+typedef struct SabfsXferWatch {
+    GSource source;
+    SabfsXferChardev *d;
+} SabfsXferWatch;
+
+/*
+ * Replies are only sent from the main loop, so the next iteration after
+ * the one that finished a reply sees it done
+ */
+static gboolean sabfs_xfer_watch_prepare(GSource *source, gint *timeout)
+{
+    SabfsXferWatch *w = (SabfsXferWatch *)source;
+
+    *timeout = -1;
+    return !w->d->reply_pending;
+}
+
+static gboolean sabfs_xfer_watch_check(GSource *source)
+{
+    SabfsXferWatch *w = (SabfsXferWatch *)source;
+
+    return !w->d->reply_pending;
+}
+
+static gboolean sabfs_xfer_watch_dispatch(GSource *source,
+                                          GSourceFunc callback,
+                                          gpointer user_data)
+{
+    return ((FEWatchFunc)callback)(NULL, G_IO_OUT, user_data);
+}
+
+static GSourceFuncs sabfs_xfer_watch_funcs = {
+    .prepare = sabfs_xfer_watch_prepare,
+    .check = sabfs_xfer_watch_check,
+    .dispatch = sabfs_xfer_watch_dispatch,
+};
+
+static GSource *sabfs_xfer_chr_add_watch(Chardev *chr, GIOCondition cond)
+{
+    SabfsXferWatch *w;
+
+    w = (SabfsXferWatch *)g_source_new(&sabfs_xfer_watch_funcs,
+                                       sizeof(SabfsXferWatch));
+    w->d = SABFS_XFER_CHARDEV(chr);
+    return &w->source;
+}
+
+static void char_sabfs_xfer_finalize(Object *obj)
+{
+    SabfsXferChardev *d = SABFS_XFER_CHARDEV(obj);
+
+    sabfs_xfer_close_file(d);
+    g_free(d->root);
+}
+
+static void qemu_chr_open_sabfs_xfer(Chardev *chr,
+                                     ChardevBackend *backend,
+                                     bool *be_opened,
+                                     Error **errp)
+{
+    ChardevSabfsXfer *opts = backend->u.sabfs_xfer.data;
+    SabfsXferChardev *d = SABFS_XFER_CHARDEV(chr);
+
+    if (!sabfs_is_available()) {
+        error_setg(errp, "sabfs-xfer chardev needs SABFS to be initialized");
+        return;
+    }
+    d->root = g_strdup(opts->root ?: "/");
+    d->fd = -1;
+}
+
+static void qemu_chr_parse_sabfs_xfer(QemuOpts *opts, ChardevBackend *backend,
+                                      Error **errp)
+{
+    ChardevSabfsXfer *xfer;
+
+    backend->type = CHARDEV_BACKEND_KIND_SABFS_XFER;
+    xfer = backend->u.sabfs_xfer.data = g_new0(ChardevSabfsXfer, 1);
+    qemu_chr_parse_common(opts, qapi_ChardevSabfsXfer_base(xfer));
+    xfer->root = g_strdup(qemu_opt_get(opts, "root"));
+}
+
+static void char_sabfs_xfer_class_init(ObjectClass *oc, void *data)
+{
+    ChardevClass *cc = CHARDEV_CLASS(oc);
+
+    cc->parse = qemu_chr_parse_sabfs_xfer;
+    cc->open = qemu_chr_open_sabfs_xfer;
+    cc->chr_write = sabfs_xfer_chr_write;
+    cc->chr_add_watch = sabfs_xfer_chr_add_watch;
+    cc->chr_accept_input = sabfs_xfer_chr_accept_input;
+    cc->chr_set_fe_open = sabfs_xfer_chr_set_fe_open;
+}
+
+static const TypeInfo char_sabfs_xfer_type_info = {
+    .name = TYPE_CHARDEV_SABFS_XFER,
+    .parent = TYPE_CHARDEV,
+    .class_init = char_sabfs_xfer_class_init,
+    .instance_size = sizeof(SabfsXferChardev),
+    .instance_finalize = char_sabfs_xfer_finalize,
+};
+
+static void register_types(void)
+{
+    type_register_static(&char_sabfs_xfer_type_info);
+}
+
+type_init(register_types);
@@ -0,0 +1,274 @@
+/*
+ * Chardev exchanging bytes through rings in shared wasm memory
+ *
+ * Connects a serial port or console to a terminal on the page, such as
+ * xterm.js on the main thread, without write() calls proxied to the main
+ * thread for every few bytes of guest output: output goes into a ring in
+ * the SharedArrayBuffer of the wasm memory that the terminal drains once
+ * per animation frame, and input comes back through a second ring.
+ *
+ *   -chardev sabring,id=con0,size=256K -serial chardev:con0
+ *
+ * When the output ring is full, writes return EAGAIN and the device waits
+ * for room with a watch instead of blocking its vCPU. The page finds the
+ * rings with sabring_chr_lookup("con0"); sabring-console.js in the x86_64
+ * example connects them to xterm.js.
+ *
+ * Writes notify the head of the output ring, so that a reader may also
+ * sleep on it with Atomics.wait/waitAsync, as sabring-qmp.js does for a
+ * QMP monitor:
+ *
+ *   -chardev sabring,id=qmp0 -mon chardev=qmp0,mode=control
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include <emscripten.h>
+#include <emscripten/threading.h>
+
+#include "chardev/char.h"
+#include "chardev/char-fe.h"
+#include "qapi/error.h"
+#include "qemu/atomic.h"
+#include "qemu/main-loop.h"
+#include "qemu/memalign.h"
+#include "qemu/module.h"
+#include "qemu/option.h"
+#include "qemu/queue.h"
+#include "qemu/sabring.h"
+#include "qemu/units.h"
+#include "qom/object.h"
+
+/* the terminal doesn't notify when it drains, look again after this */
+#define SABRING_CHR_POLL_MS 10
+
+struct SabRingChardev {
+    Chardev parent;
+    SabRing *out;       /* guest output, consumed by the terminal */
+    SabRing *in;        /* terminal input, consumed here */
+    QEMUBH *bh;
+    SabRingWaiter waiter;
+    QLIST_ENTRY(SabRingChardev) next;
+};
+typedef struct SabRingChardev SabRingChardev;
+
+DECLARE_INSTANCE_CHECKER(SabRingChardev, SABRING_CHARDEV,
+                         TYPE_CHARDEV_SABRING)
+
+static QLIST_HEAD(, SabRingChardev) sabring_chardevs =
+    QLIST_HEAD_INITIALIZER(sabring_chardevs);
+
+/* Called with chr_write_lock held, so there is one producer */
+static int sabring_chr_write(Chardev *chr, const uint8_t *buf, int len)
+{
+    SabRingChardev *d = SABRING_CHARDEV(chr);
+    SabRing *r = d->out;
+    uint32_t head = r->head;
+    uint32_t n = MIN(len, sab_ring_room(r));
+
+    if (!n) {
+        errno = EAGAIN;
+        return -1;
+    }
+    sab_ring_copy_in(r, head, buf, n);
+    qatomic_store_release(&r->head, head + n);
+    emscripten_futex_wake(&r->head, INT_MAX);
+    return n;
+}
+
+typedef struct SabRingWatch {
+    GSource source;
+    SabRingChardev *d;
+} SabRingWatch;
+
+static gboolean sabring_watch_prepare(GSource *source, gint *timeout)
+{
+    SabRingWatch *w = (SabRingWatch *)source;
+
+    if (sab_ring_room(w->d->out)) {
+        return TRUE;
+    }
+    *timeout = SABRING_CHR_POLL_MS;
+    return FALSE;
+}
+
+static gboolean sabring_watch_check(GSource *source)
+{
+    SabRingWatch *w = (SabRingWatch *)source;
+
+    return sab_ring_room(w->d->out) != 0;
+}
+
+static gboolean sabring_watch_dispatch(GSource *source, GSourceFunc callback,
+                                       gpointer user_data)
+{
+    return ((FEWatchFunc)callback)(NULL, G_IO_OUT, user_data);
+}
+
+static GSourceFuncs sabring_watch_funcs = {
+    .prepare = sabring_watch_prepare,
+    .check = sabring_watch_check,
+    .dispatch = sabring_watch_dispatch,
+};
+
+static GSource *sabring_chr_add_watch(Chardev *chr, GIOCondition cond)
+{
+    SabRingWatch *w;
+
+    w = (SabRingWatch *)g_source_new(&sabring_watch_funcs,
+                                     sizeof(SabRingWatch));
+    w->d = SABRING_CHARDEV(chr);
+    return &w->source;
+}
+
+/* Passes terminal input on as far as the frontend takes it */
+static void sabring_chr_bh(void *opaque)
+{
+    SabRingChardev *d = opaque;
+    Chardev *chr = CHARDEV(d);
+    SabRing *r = d->in;
+    uint32_t tail = r->tail;
+
+    for (;;) {
+        uint32_t head = qatomic_load_acquire(&r->head);
+        uint32_t off = tail & (r->size - 1);
+        uint32_t n;
+
+        if (head == tail) {
+            /* pairs with the terminal's check before it notifies */
+            smp_mb();
+            if (qatomic_read(&r->head) == tail) {
+                break;
+            }
+            continue;
+        }
+        n = MIN(head - tail, r->size - off);
+        n = MIN(n, qemu_chr_be_can_write(chr));
+        if (!n) {
+            /* go on in sabring_chr_accept_input() */
+            break;
+        }
+        qemu_chr_be_write(chr, r->data + off, n);
+        tail += n;
+        qatomic_store_release(&r->tail, tail);
+    }
+}
+
+static void sabring_chr_accept_input(Chardev *chr)
+{
+    SabRingChardev *d = SABRING_CHARDEV(chr);
+
+    qemu_bh_schedule(d->bh);
+}
+
+/* The terminal moved the input ring, leave the bytes to sabring_chr_bh() */
+static void sabring_chr_notify(void *opaque)
+{
+    SabRingChardev *d = opaque;
+
+    qemu_bh_schedule(d->bh);
+}
+
+/*
+ * Address of the output ring of the chardev, the input ring follows it.
+ * Returns 0 if there is no sabring chardev with that id.
+ */
+EMSCRIPTEN_KEEPALIVE uintptr_t sabring_chr_lookup(const char *id)
+{
+    SabRingChardev *d;
+
+    QLIST_FOREACH(d, &sabring_chardevs, next) {
+        if (!strcmp(CHARDEV(d)->label, id)) {
+            return (uintptr_t)d->out;
+        }
+    }
+    return 0;
+}
+
+static void char_sabring_finalize(Object *obj)
+{
+    SabRingChardev *d = SABRING_CHARDEV(obj);
+
+    if (!d->out) {
+        return;
+    }
+    sab_ring_waiter_stop(&d->waiter);
+    qemu_bh_delete(d->bh);
+
+    QLIST_REMOVE(d, next);
+    qemu_vfree(d->out);
+}
+
+static void qemu_chr_open_sabring(Chardev *chr,
+                                  ChardevBackend *backend,
+                                  bool *be_opened,
+                                  Error **errp)
+{
+    ChardevSabring *opts = backend->u.sabring.data;
+    SabRingChardev *d = SABRING_CHARDEV(chr);
+    int64_t size = opts->has_size ? opts->size : 256 * KiB;
+    void *rings;
+
+    if (size < 4 * KiB || size > 1 * GiB || (size & (size - 1))) {
+        error_setg(errp, "size of sabring chardev must be a power of two "
+                   "between 4K and 1G");
+        return;
+    }
+
+    rings = qemu_memalign(64, 2 * sab_ring_footprint(size));
+    d->out = rings;
+    sab_ring_init(d->out, size);
+    d->in = sab_ring_next(d->out);
+    sab_ring_init(d->in, size);
+    d->bh = qemu_bh_new(sabring_chr_bh, d);
+    QLIST_INSERT_HEAD(&sabring_chardevs, d, next);
+
+    sab_ring_waiter_start(&d->waiter, "sabring-chr", &d->in->head,
+                          sabring_chr_notify, d);
+}
+
+static void qemu_chr_parse_sabring(QemuOpts *opts, ChardevBackend *backend,
+                                   Error **errp)
+{
+    ChardevSabring *sabring;
+    uint64_t val;
+
+    backend->type = CHARDEV_BACKEND_KIND_SABRING;
+    sabring = backend->u.sabring.data = g_new0(ChardevSabring, 1);
+    qemu_chr_parse_common(opts, qapi_ChardevSabring_base(sabring));
+
+    val = qemu_opt_get_size(opts, "size", 0);
+    if (val != 0) {
+        sabring->has_size = true;
+        sabring->size = val;
+    }
+}
+
+static void char_sabring_class_init(ObjectClass *oc, void *data)
+{
+    ChardevClass *cc = CHARDEV_CLASS(oc);
+
+    cc->parse = qemu_chr_parse_sabring;
+    cc->open = qemu_chr_open_sabring;
+    cc->chr_write = sabring_chr_write;
+    cc->chr_add_watch = sabring_chr_add_watch;
+    cc->chr_accept_input = sabring_chr_accept_input;
+}
+
+static const TypeInfo char_sabring_type_info = {
+    .name = TYPE_CHARDEV_SABRING,
+    .parent = TYPE_CHARDEV,
+    .class_init = char_sabring_class_init,
+    .instance_size = sizeof(SabRingChardev),
+    .instance_finalize = char_sabring_finalize,
+};
+
+static void register_types(void)
+{
+    type_register_static(&char_sabring_type_info);
+}
+
+type_init(register_types);
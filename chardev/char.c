@@ -907,6 +907,9 @@ QemuOptsList qemu_chardev_opts = {
         },{
             .name = "clipboard",
             .type = QEMU_OPT_BOOL,
+        },{
+            .name = "root",
+            .type = QEMU_OPT_STRING,
 #ifdef CONFIG_LINUX
         },{
             .name = "tight",
@@ -23,6 +23,8 @@
 #include "hw/core/cpu.h"
 #include "sysemu/cpus.h"
 #include "qemu/lockable.h"
+#include "qemu/stats64.h"
+#include "qemu/timer.h"
 #include "trace/trace-root.h"
 
 QemuMutex qemu_cpu_list_lock;
@@ -35,6 +37,14 @@ static QemuCond qemu_work_cond;
  */
 static int pending_cpus;
 
+/* Host time threads waited for exclusive sections, see cpu_exclusive_wait_ns */
+static Stat64 exclusive_wait_ns;
+
+uint64_t cpu_exclusive_wait_ns(void)
+{
+    return stat64_get(&exclusive_wait_ns);
+}
+
 void qemu_init_cpu_list(void)
 {
     /* This is needed because qemu_init_cpu_list is also called by the
@@ -181,9 +191,16 @@ void async_run_on_cpu(CPUState *cpu, run_on_cpu_func func, run_on_cpu_data data)
    must be held.  */
 static inline void exclusive_idle(void)
 {
+    int64_t start;
+
+    if (likely(!pending_cpus)) {
+        return;
+    }
+    start = get_clock();
     while (pending_cpus) {
         qemu_cond_wait(&exclusive_resume, &qemu_cpu_list_lock);
     }
+    stat64_add(&exclusive_wait_ns, get_clock() - start);
 }
 
 /* Start an exclusive operation.
@@ -216,8 +233,13 @@ void start_exclusive(void)
     }
 
     qatomic_set(&pending_cpus, running_cpus + 1);
-    while (pending_cpus > 1) {
-        qemu_cond_wait(&exclusive_cond, &qemu_cpu_list_lock);
+    if (pending_cpus > 1) {
+        int64_t start = get_clock();
+
+        while (pending_cpus > 1) {
+            qemu_cond_wait(&exclusive_cond, &qemu_cpu_list_lock);
+        }
+        stat64_add(&exclusive_wait_ns, get_clock() - start);
     }
 
     /* Can release mutex, no one will enter another exclusive
@@ -0,0 +1,126 @@
+// Shared by the benchmark page and the Node runner: QEMU arguments and
+// parsing of the markers printed by the guest's /usr/local/bin/wasm-bench.
+
+export const MARKER_READY = 'WASM-BENCH-READY';
+export const MARKER_BEGIN = 'WASM-BENCH-BEGIN ';
+export const MARKER_END = 'WASM-BENCH-END ';
+export const MARKER_DONE = 'WASM-BENCH-DONE';
+
+// rr is { mode: 'record' or 'replay', file } for a record/replay run
+export function qemuArgs(accel, rr) {
+    const disk = 'file=/pack-rootfs/disk-rootfs.img,format=raw,if=none';
+    const args = [
+        '-nographic', '-M', 'pc', '-m', '512M', '-accel', accel,
+        '-L', '/pack-rom/',
+        '-nic', 'none',
+        '-kernel', '/pack-kernel/vmlinuz-virt',
+        '-initrd', '/pack-initramfs/initramfs-virt',
+        '-append', 'console=ttyS0 noautodetect hostname=bench wasm_bench' +
+            (rr ? ' wasm_bench_poweroff' : ''),
+    ];
+    if (!rr) {
+        return args.concat([
+            '-drive', `id=test,${disk}`,
+            '-device', 'virtio-blk-pci,drive=test',
+        ]);
+    }
+    // disk requests go through blkreplay so that their completions are logged
+    return args.concat([
+        '-icount', `shift=auto,rr=${rr.mode},rrfile=${rr.file}`,
+        '-drive', `id=test-direct,${disk}`,
+        '-drive', 'id=test,driver=blkreplay,if=none,image=test-direct',
+        '-device', 'virtio-blk-pci,drive=test',
+    ]);
+}
+
+export class BenchRecorder {
+    constructor(runner, accel) {
+        this.start = performance.now();
+        this.result = {
+            runner: runner,
+            accel: accel,
+            time_to_ready_ms: null,
+            benchmarks: {},
+            jit: null,
+        };
+        this.open = {};
+        this.rrOpen = null;
+        this.done = false;
+    }
+
+    // Feed one line of guest console output, returns true on WASM-BENCH-DONE
+    line(text) {
+        const now = performance.now();
+        text = text.trim();
+        if (text === MARKER_READY) {
+            this.result.time_to_ready_ms = now - this.start;
+        } else if (text.startsWith(MARKER_BEGIN)) {
+            this.open[text.slice(MARKER_BEGIN.length)] = now;
+        } else if (text.startsWith(MARKER_END)) {
+            const name = text.slice(MARKER_END.length);
+            if (name in this.open) {
+                (this.result.benchmarks[name] ??= []).push(now - this.open[name]);
+                delete this.open[name];
+            }
+        } else if (text === MARKER_DONE) {
+            this.done = true;
+        }
+        return this.done;
+    }
+
+    // Take the counters of qemu_replay_stats_json() at a marker line
+    replay(stats_json, name) {
+        const stats = JSON.parse(stats_json);
+        const now = performance.now();
+        const rr = (this.result.replay ??= { mode: stats.mode, benchmarks: {} });
+        if (name === MARKER_READY) {
+            rr.ready = { icount: stats.icount, ms: now - this.start };
+        } else if (name.startsWith(MARKER_BEGIN)) {
+            this.rrOpen = { icount: stats.icount, ms: now };
+        } else if (name.startsWith(MARKER_END) && this.rrOpen) {
+            const icount = stats.icount - this.rrOpen.icount;
+            const ms = now - this.rrOpen.ms;
+            (rr.benchmarks[name.slice(MARKER_END.length)] ??= []).push({
+                icount: icount, mips: icount / ms / 1000,
+            });
+            this.rrOpen = null;
+        } else if (name === MARKER_DONE) {
+            rr.done = stats;
+        }
+    }
+
+    // Summarise the JSON returned by wasm32_profile_json()
+    jit(profile_json) {
+        const prof = JSON.parse(profile_json);
+        const jit = {
+            period: prof.period, tbs: prof.tbs.length,
+            tci_samples: 0, wasm_samples: 0, unwinds: 0, compiles: 0, compile_ms: 0,
+        };
+        for (const tb of prof.tbs) {
+            jit.tci_samples += tb.tci;
+            jit.wasm_samples += tb.wasm;
+            jit.unwinds += tb.unwinds;
+            jit.compiles += tb.compiles;
+            jit.compile_ms += tb.compile_us / 1000;
+        }
+        this.result.jit = jit;
+    }
+
+    finish() {
+        this.result.total_ms = performance.now() - this.start;
+        return this.result;
+    }
+}
+
+// Read the record/replay counters out of a running QEMU instance
+export function readReplayStats(mod) {
+    return mod.UTF8ToString(mod._qemu_replay_stats_json());
+}
+
+// Read the profile out of a running QEMU instance (main thread only)
+export function readProfile(mod) {
+    const ptr = mod._wasm32_profile_json();
+    const json = mod.UTF8ToString(ptr);
+    mod._free(ptr);
+    return json;
+}
@@ -0,0 +1,51 @@
+// Compare two result files written by run-node.mjs or run-browser.mjs.
+//
+//   node compare.mjs base.json new.json
+
+import fs from 'node:fs';
+
+if (process.argv.length != 4) {
+    console.error('usage: compare.mjs base.json new.json');
+    process.exit(2);
+}
+const [base, cur] = process.argv.slice(2).map((f) => JSON.parse(fs.readFileSync(f)));
+
+const median = (xs) => {
+    const s = [...xs].sort((a, b) => a - b);
+    return s[Math.floor(s.length / 2)];
+};
+const row = (name, a, b) => {
+    const delta = a ? ((b - a) / a * 100).toFixed(1) + '%' : '-';
+    console.log(`${name.padEnd(16)} ${a.toFixed(0).padStart(10)} ${b.toFixed(0).padStart(10)} ${delta.padStart(8)}`);
+};
+
+console.log(`${'ms'.padEnd(16)} ${'base'.padStart(10)} ${'new'.padStart(10)} ${'delta'.padStart(8)}`);
+row('time-to-ready', base.time_to_ready_ms, cur.time_to_ready_ms);
+for (const name of Object.keys(base.benchmarks)) {
+    if (name in cur.benchmarks) {
+        row(name, median(base.benchmarks[name]), median(cur.benchmarks[name]));
+    }
+}
+if (base.jit && cur.jit) {
+    row('compile', base.jit.compile_ms, cur.jit.compile_ms);
+    for (const k of ['compiles', 'tci_samples', 'wasm_samples', 'unwinds']) {
+        console.log(`${k.padEnd(16)} ${String(base.jit[k]).padStart(10)} ${String(cur.jit[k]).padStart(10)}`);
+    }
+}
+if (base.replay && cur.replay) {
+    // replays of one log execute the same instructions, so MIPS compare
+    // exactly what the host did with them
+    console.log(`${'guest MIPS'.padEnd(16)} ${'base'.padStart(10)} ${'new'.padStart(10)} ${'delta'.padStart(8)}`);
+    for (const name of Object.keys(base.replay.benchmarks)) {
+        if (name in cur.replay.benchmarks) {
+            const mips = (runs) => median(runs.map((r) => r.mips));
+            row(name, mips(base.replay.benchmarks[name]), mips(cur.replay.benchmarks[name]));
+        }
+    }
+    const a = base.replay.done, b = cur.replay.done;
+    if (a && b) {
+        for (const k of Object.keys(a).filter((k) => k !== 'mode')) {
+            console.log(`${k.padEnd(16)} ${String(a[k]).padStart(10)} ${String(b[k]).padStart(10)}`);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+// Run the benchmark under Node.
+//
+//   node run-node.mjs --qemu /tmp/test-node/out.mjs --packs /tmp \
+//       [--accel tcg,tb-size=500] [--out result.json]
+//
+// --packs is the directory holding the pack-{kernel,initramfs,rootfs,rom}
+// directories, they are copied into MEMFS before QEMU starts.
+//
+// --record log.rr runs the workload with icount and writes the record/replay
+// log, --replay log.rr replays one, which executes the same guest
+// instructions however fast the host runs them.
+
+import fs from 'node:fs';
+import path from 'node:path';
+import { parseArgs } from 'node:util';
+import { pathToFileURL } from 'node:url';
+import { qemuArgs, BenchRecorder, readProfile, readReplayStats } from './bench-core.mjs';
+
+const { values: opts } = parseArgs({
+    options: {
+        qemu: { type: 'string' },
+        packs: { type: 'string', default: '/tmp' },
+        accel: { type: 'string', default: 'tcg,tb-size=500' },
+        out: { type: 'string' },
+        record: { type: 'string' },
+        replay: { type: 'string' },
+    },
+});
+if (!opts.qemu || (opts.record && opts.replay)) {
+    console.error('usage: run-node.mjs --qemu out.mjs [--packs dir] [--accel opts] [--out file]\n' +
+                  '                   [--record log.rr | --replay log.rr]');
+    process.exit(2);
+}
+const RR_FILE = '/bench.rr';
+const rr = opts.record ? { mode: 'record', file: RR_FILE } :
+           opts.replay ? { mode: 'replay', file: RR_FILE } : null;
+
+const rec = new BenchRecorder(`node ${process.version}`, opts.accel);
+const { default: initEmscriptenModule } = await import(pathToFileURL(path.resolve(opts.qemu)));
+let instance = null;
+
+const Module = {
+    arguments: qemuArgs(opts.accel, rr),
+    stdin: () => null,
+    preRun: [(mod) => {
+        for (const pack of ['kernel', 'initramfs', 'rootfs', 'rom']) {
+            const dir = path.join(opts.packs, `pack-${pack}`);
+            mod.FS.mkdir(`/pack-${pack}`);
+            for (const f of fs.readdirSync(dir)) {
+                mod.FS.writeFile(`/pack-${pack}/${f}`, fs.readFileSync(path.join(dir, f)));
+            }
+        }
+        if (opts.replay) {
+            mod.FS.writeFile(RR_FILE, fs.readFileSync(opts.replay));
+        }
+    }],
+    print: (text) => {
+        console.log(text);
+        if (rr && text.trim().startsWith('WASM-BENCH-')) {
+            rec.replay(readReplayStats(instance), text.trim());
+        }
+        if (rec.line(text)) {
+            rec.jit(readProfile(instance));
+            const json = JSON.stringify(rec.finish(), null, 2);
+            if (opts.out) {
+                fs.writeFileSync(opts.out, json + '\n');
+            } else {
+                console.log(json);
+            }
+            // a recording is complete once the guest powered QEMU off
+            if (!opts.record) {
+                process.exit(0);
+            }
+        }
+    },
+    printErr: (text) => console.error(text),
+};
+if (opts.record) {
+    process.on('exit', () => {
+        fs.writeFileSync(opts.record, instance.FS.readFile(RR_FILE));
+    });
+}
+instance = await initEmscriptenModule(Module);
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Relay live migration from a native QEMU to a QEMU Wasm page.
+
+The page can't accept connections, so both sides connect to this relay:
+the source with "migrate tcp:HOST:PORT" and the destination in the page
+with "-incoming tcp:HOST:WSPORT", which Emscripten opens as a WebSocket.
+Every connection of the source is paired with the next WebSocket of the
+page, one pair per multifd channel:
+
+    ws-relay.py --listen 127.0.0.1:4444 --ws-listen 127.0.0.1:8889
+"""
+
+import argparse
+import asyncio
+import base64
+import hashlib
+import struct
+
+WS_GUID = b'258EAFA5-E914-47DA-95CA-C5AB0DC85B11'
+OP_BINARY, OP_CLOSE, OP_PING, OP_PONG = 0x2, 0x8, 0x9, 0xa
+
+
+async def ws_handshake(reader, writer):
+    headers = {}
+    request = await reader.readuntil(b'\r\n\r\n')
+    for line in request.decode('latin-1').split('\r\n')[1:]:
+        name, sep, value = line.partition(':')
+        if sep:
+            headers[name.strip().lower()] = value.strip()
+    key = headers['sec-websocket-key'].encode()
+    accept = base64.b64encode(hashlib.sha1(key + WS_GUID).digest())
+    response = [b'HTTP/1.1 101 Switching Protocols', b'Upgrade: websocket',
+                b'Connection: Upgrade', b'Sec-WebSocket-Accept: ' + accept]
+    # Emscripten asks for the "binary" subprotocol
+    if 'binary' in headers.get('sec-websocket-protocol', ''):
+        response.append(b'Sec-WebSocket-Protocol: binary')
+    writer.write(b'\r\n'.join(response) + b'\r\n\r\n')
+    await writer.drain()
+
+
+def ws_frame(opcode, data):
+    size = len(data)
+    if size < 126:
+        header = struct.pack('!BB', 0x80 | opcode, size)
+    elif size < 1 << 16:
+        header = struct.pack('!BBH', 0x80 | opcode, 126, size)
+    else:
+        header = struct.pack('!BBQ', 0x80 | opcode, 127, size)
+    return header + data
+
+
+async def ws_to_tcp(ws_reader, ws_writer, tcp_writer):
+    while True:
+        b0, b1 = await ws_reader.readexactly(2)
+        size = b1 & 0x7f
+        if size == 126:
+            size, = struct.unpack('!H', await ws_reader.readexactly(2))
+        elif size == 127:
+            size, = struct.unpack('!Q', await ws_reader.readexactly(8))
+        mask = await ws_reader.readexactly(4) if b1 & 0x80 else b''
+        data = await ws_reader.readexactly(size)
+        if b1 & 0x80:
+            keys = (mask * (size // 4 + 1))[:size]
+            data = (int.from_bytes(data, 'big') ^
+                    int.from_bytes(keys, 'big')).to_bytes(size, 'big')
+        opcode = b0 & 0xf
+        if opcode == OP_CLOSE:
+            break
+        if opcode == OP_PING:
+            ws_writer.write(ws_frame(OP_PONG, data))
+        elif opcode != OP_PONG:
+            tcp_writer.write(data)
+            await tcp_writer.drain()
+
+
+async def tcp_to_ws(tcp_reader, ws_writer):
+    while data := await tcp_reader.read(256 * 1024):
+        ws_writer.write(ws_frame(OP_BINARY, data))
+        await ws_writer.drain()
+    ws_writer.write(ws_frame(OP_CLOSE, b''))
+
+
+async def relay(source, page):
+    tcp_reader, tcp_writer = source
+    ws_reader, ws_writer = page
+    tasks = [asyncio.ensure_future(ws_to_tcp(ws_reader, ws_writer,
+                                             tcp_writer)),
+             asyncio.ensure_future(tcp_to_ws(tcp_reader, ws_writer))]
+    try:
+        await asyncio.wait(tasks, return_when=asyncio.FIRST_COMPLETED)
+    finally:
+        for task in tasks:
+            task.cancel()
+        tcp_writer.close()
+        ws_writer.close()
+
+
+def host_port(spec):
+    host, _, port = spec.rpartition(':')
+    return host, int(port)
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--listen', type=host_port, required=True,
+                        metavar='HOST:PORT',
+                        help='address for "migrate tcp:" of the source')
+    parser.add_argument('--ws-listen', type=host_port, required=True,
+                        metavar='HOST:PORT',
+                        help='address for "-incoming tcp:" of the page')
+    args = parser.parse_args()
+
+    pages = asyncio.Queue()
+
+    async def on_source(reader, writer):
+        await relay((reader, writer), await pages.get())
+
+    async def on_page(reader, writer):
+        await ws_handshake(reader, writer)
+        await pages.put((reader, writer))
+
+    await asyncio.start_server(on_page, *args.ws_listen)
+    server = await asyncio.start_server(on_source, *args.listen)
+    await server.serve_forever()
+
+
+if __name__ == '__main__':
+    asyncio.run(main())
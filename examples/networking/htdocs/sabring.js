@@ -0,0 +1,128 @@
+// Stack side of "-netdev sabring" (net/sabring.c).
+//
+// The page gets the address with Module._sabring_lookup() and passes it,
+// along with the wasm memory (wasmMemory.buffer, a SharedArrayBuffer), to
+// the worker running the network stack:
+//
+//   const ring = new SabRing(buffer, base);
+//   ring.send(frame);                 // Uint8Array, to the guest
+//   for (const f of ring.receive()) { ... }   // from the guest
+//   await ring.wait();                // until receive() has frames
+//
+// Each ring is { u32 head, tail, size, dropped, vnetHdrLen, offloads,
+// reserved[2]; u8 data[size] } with free-running head/tail byte counters
+// and frames stored as a u32 length followed by the data padded to 4
+// bytes. QEMU writes the first ring and reads the second, which follows
+// it. With "vnet-hdr=on", frames in both directions start with a
+// virtio-net header of vnetHdrLen() bytes once the guest driver is up.
+
+const HDR = 32;
+
+// offloads() bits, the frames the guest takes (set_offload of net/net.h)
+export const OFFLOAD_CSUM = 1 << 0;
+export const OFFLOAD_TSO4 = 1 << 1;
+export const OFFLOAD_TSO6 = 1 << 2;
+export const OFFLOAD_ECN = 1 << 3;
+export const OFFLOAD_UFO = 1 << 4;
+export const OFFLOAD_USO4 = 1 << 5;
+export const OFFLOAD_USO6 = 1 << 6;
+
+class Ring {
+    constructor(buffer, base) {
+        this.u32 = new Uint32Array(buffer, base, HDR / 4);
+        this.i32 = new Int32Array(buffer, base, HDR / 4);   // for wait/notify
+        this.size = this.u32[2];
+        this.data = new Uint8Array(buffer, base + HDR, this.size);
+        this.view = new DataView(buffer, base + HDR, this.size);
+        this.end = base + HDR + this.size;
+    }
+
+    copyOut(pos, dst) {
+        const off = pos & (this.size - 1);
+        const first = Math.min(dst.length, this.size - off);
+        dst.set(this.data.subarray(off, off + first));
+        dst.set(this.data.subarray(0, dst.length - first), first);
+    }
+
+    copyIn(pos, src) {
+        const off = pos & (this.size - 1);
+        const first = Math.min(src.length, this.size - off);
+        this.data.set(src.subarray(0, first), off);
+        this.data.set(src.subarray(first), 0);
+    }
+}
+
+export class SabRing {
+    constructor(buffer, base) {
+        this.out = new Ring(buffer, base);      // from the guest
+        this.in = new Ring(buffer, this.out.end);   // to the guest
+    }
+
+    // Length of the virtio-net header before every frame, 0 for none
+    vnetHdrLen() {
+        return Atomics.load(this.out.u32, 4);
+    }
+
+    // OFFLOAD_* of the frames the guest takes
+    offloads() {
+        return Atomics.load(this.out.u32, 5);
+    }
+
+    // Queues a frame for the guest, returns false if the ring is full
+    send(frame) {
+        const r = this.in;
+        const head = Atomics.load(r.u32, 0);
+        const tail = Atomics.load(r.u32, 1);
+        const need = 4 + ((frame.length + 3) & ~3);
+        if (need > r.size - ((head - tail) >>> 0)) {
+            Atomics.add(r.u32, 3, 1);
+            return false;
+        }
+        r.view.setUint32(head & (r.size - 1), frame.length, true);
+        r.copyIn(head + 4, frame);
+        Atomics.store(r.u32, 0, (head + need) >>> 0);
+        // QEMU only sleeps on an empty ring, see sabring_bh()
+        if (Atomics.load(r.u32, 1) === head) {
+            Atomics.notify(r.i32, 0);
+        }
+        return true;
+    }
+
+    // Takes the frames the guest sent so far
+    receive() {
+        const r = this.out;
+        const frames = [];
+        let tail = Atomics.load(r.u32, 1);
+        let head = Atomics.load(r.u32, 0);
+        while (head !== tail) {
+            const len = r.view.getUint32(tail & (r.size - 1), true);
+            const frame = new Uint8Array(len);
+            r.copyOut(tail + 4, frame);
+            frames.push(frame);
+            tail = (tail + 4 + ((len + 3) & ~3)) >>> 0;
+            Atomics.store(r.u32, 1, tail);
+            head = Atomics.load(r.u32, 0);
+        }
+        return frames;
+    }
+
+    // Resolves once the guest has sent a frame receive() hasn't taken, or
+    // after a while
+    wait() {
+        const r = this.out;
+        const tail = Atomics.load(r.u32, 1);
+        if (Atomics.load(r.u32, 0) !== tail) {
+            return Promise.resolve();
+        }
+        if (Atomics.waitAsync) {
+            const res = Atomics.waitAsync(r.i32, 0, tail | 0);
+            return res.async ? res.value.then(() => {}) : Promise.resolve();
+        }
+        // without waitAsync, block briefly and go back to the event loop
+        // so that timers and fetch() of the stack keep running
+        return new Promise((resolve) => {
+            Atomics.wait(r.i32, 0, tail | 0, 20);
+            setTimeout(resolve, 0);
+        });
+    }
+}
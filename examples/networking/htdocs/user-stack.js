@@ -0,0 +1,586 @@
+// User-mode network stack for "-netdev sabring", run in a worker of the
+// page, with the addresses of QEMU's "-netdev user":
+//
+//   10.0.2.0/24, gateway 10.0.2.2, DNS 10.0.2.3, guest 10.0.2.15
+//
+// It answers ARP, DHCP and pings, resolves DNS queries with DNS over
+// HTTPS, and terminates the guest's TCP connections to port 80: plain
+// HTTP requests, proxy requests to 10.0.2.2:80, and requests for
+// http://10.0.2.2/https://... are made with fetch() and the response is
+// streamed back. Raw TCP, CONNECT and UDP other than DNS are not
+// possible from a page and are refused.
+//
+// With "vnet-hdr=on" it takes the guest's TSO frames and unchecksummed
+// frames as they are, and sends the guest segments of up to 64 KiB with
+// the checksum left to it, when the guest driver takes them.
+//
+//   new UserStack(new SabRing(buffer, base)).run();
+
+import { OFFLOAD_CSUM, OFFLOAD_TSO4 } from './sabring.js';
+
+const GW_MAC = [0x52, 0x55, 0x0a, 0x00, 0x02, 0x02];
+const BCAST_MAC = [0xff, 0xff, 0xff, 0xff, 0xff, 0xff];
+const NET_IP = [10, 0, 2, 0];
+const GW_IP = [10, 0, 2, 2];
+const DNS_IP = [10, 0, 2, 3];
+const GUEST_IP = [10, 0, 2, 15];
+const BCAST_IP = [255, 255, 255, 255];
+
+const ETH_HLEN = 14;
+const IP_HLEN = 20;
+const TCP_HLEN = 20;
+const MSS = 1460;
+const GSO_MAX = 44 * MSS;       // fits in an IPv4 packet with the headers
+const VNET_F_NEEDS_CSUM = 1;
+const VNET_GSO_TCPV4 = 1;
+const TCP_FIN = 0x01, TCP_SYN = 0x02, TCP_RST = 0x04, TCP_PSH = 0x08,
+      TCP_ACK = 0x10;
+const RTO_MS = 300;
+const SEND_BUFFER = 1 << 20;    // fetched bytes buffered per connection
+
+const te = new TextEncoder();
+const td = new TextDecoder('latin1');
+
+function csum(buf, sum = 0) {
+    for (let i = 0; i + 1 < buf.length; i += 2) {
+        sum += (buf[i] << 8) | buf[i + 1];
+    }
+    if (buf.length & 1) {
+        sum += buf[buf.length - 1] << 8;
+    }
+    while (sum > 0xffff) {
+        sum = (sum & 0xffff) + (sum >>> 16);
+    }
+    return sum;
+}
+
+function pseudoSum(src, dst, proto, len) {
+    return csum(Uint8Array.of(...src, ...dst, 0, proto, len >> 8, len & 0xff));
+}
+
+function sameIP(a, b) {
+    return a[0] === b[0] && a[1] === b[1] && a[2] === b[2] && a[3] === b[3];
+}
+
+function inSubnet(ip) {
+    return ip[0] === NET_IP[0] && ip[1] === NET_IP[1] && ip[2] === NET_IP[2];
+}
+
+// sequence number comparisons modulo 2^32
+function seqLE(a, b) {
+    return ((b - a) | 0) >= 0;
+}
+
+function concat(chunks, len) {
+    const out = new Uint8Array(len);
+    let off = 0;
+    for (const c of chunks) {
+        out.set(c, off);
+        off += c.length;
+    }
+    return out;
+}
+
+export class UserStack {
+    constructor(ring, opts = {}) {
+        this.ring = ring;
+        this.dohURL = opts.dohURL || 'https://cloudflare-dns.com/dns-query';
+        this.guestMac = BCAST_MAC;
+        this.ipId = 0;
+        this.conns = new Map();
+        setInterval(() => this.retransmit(), RTO_MS);
+    }
+
+    async run() {
+        for (;;) {
+            await this.ring.wait();
+            // checksums are not checked and TSO frames are just long
+            // segments, so the virtio-net header can be skipped
+            const hdrLen = this.ring.vnetHdrLen();
+            for (const frame of this.ring.receive()) {
+                this.input(frame.subarray(hdrLen));
+            }
+        }
+    }
+
+    input(f) {
+        if (f.length < ETH_HLEN) {
+            return;
+        }
+        const type = (f[12] << 8) | f[13];
+        if (type === 0x0806 && f.length >= ETH_HLEN + 28) {
+            this.inputARP(f, f.subarray(ETH_HLEN));
+        } else if (type === 0x0800 && f.length >= ETH_HLEN + IP_HLEN) {
+            this.guestMac = Array.from(f.subarray(6, 12));
+            this.inputIP(f.subarray(ETH_HLEN));
+        }
+    }
+
+    inputARP(f, a) {
+        const tpa = a.subarray(24, 28);
+        // everything on the subnet but the guest is us
+        if (((a[6] << 8) | a[7]) !== 1 || !inSubnet(tpa) ||
+            sameIP(tpa, GUEST_IP)) {
+            return;
+        }
+        const reply = Uint8Array.of(0, 1, 8, 0, 6, 4, 0, 2, ...GW_MAC, ...tpa,
+                                    ...a.subarray(8, 18));
+        this.sendEth(Array.from(f.subarray(6, 12)), 0x0806, reply);
+    }
+
+    inputIP(p) {
+        const ihl = (p[0] & 0xf) * 4;
+        const len = (p[2] << 8) | p[3];
+        if ((p[0] >> 4) !== 4 || ihl < IP_HLEN || len > p.length || len < ihl ||
+            ((p[6] & 0x3f) | p[7])) {
+            return;     // not IPv4, truncated or a fragment
+        }
+        const src = p.slice(12, 16), dst = p.slice(16, 20);
+        const data = p.subarray(ihl, len);
+        switch (p[9]) {
+        case 1:
+            this.inputICMP(src, dst, data);
+            break;
+        case 6:
+            this.inputTCP(src, dst, data);
+            break;
+        case 17:
+            this.inputUDP(src, dst, data);
+            break;
+        }
+    }
+
+    inputICMP(src, dst, d) {
+        if (d.length < 8 || d[0] !== 8 || !inSubnet(dst)) {
+            return;
+        }
+        const reply = d.slice();
+        reply[0] = 0;
+        reply[2] = reply[3] = 0;
+        const sum = ~csum(reply) & 0xffff;
+        reply[2] = sum >> 8;
+        reply[3] = sum & 0xff;
+        this.sendIP(1, dst, src, reply);
+    }
+
+    inputUDP(src, dst, d) {
+        if (d.length < 8) {
+            return;
+        }
+        const sport = (d[0] << 8) | d[1], dport = (d[2] << 8) | d[3];
+        const data = d.subarray(8, (d[4] << 8) | d[5]);
+        if (dport === 67) {
+            this.inputDHCP(data);
+        } else if (dport === 53 && sameIP(dst, DNS_IP)) {
+            fetch(this.dohURL, {
+                method: 'POST',
+                headers: { 'content-type': 'application/dns-message',
+                           'accept': 'application/dns-message' },
+                body: data.slice(),
+            }).then((resp) => resp.arrayBuffer()).then((buf) => {
+                this.sendUDP(DNS_IP, 53, src, sport, new Uint8Array(buf));
+            }).catch(() => {});
+        }
+    }
+
+    inputDHCP(d) {
+        if (d.length < 240 || d[0] !== 1) {
+            return;
+        }
+        let type = 0;
+        for (let i = 240; i + 1 < d.length && d[i] !== 255; ) {
+            if (d[i] === 0) {
+                i++;
+                continue;
+            }
+            if (d[i] === 53) {
+                type = d[i + 2];
+            }
+            i += 2 + d[i + 1];
+        }
+        // DISCOVER gets an OFFER, REQUEST an ACK
+        const reply = { 1: 2, 3: 5 }[type];
+        if (!reply) {
+            return;
+        }
+        const r = new Uint8Array(300);
+        r.set([2, 1, 6, 0]);
+        r.set(d.subarray(4, 8), 4);             // xid
+        r.set(GUEST_IP, 16);                    // yiaddr
+        r.set(GW_IP, 20);                       // siaddr
+        r.set(d.subarray(28, 44), 28);          // chaddr
+        r.set([99, 130, 83, 99,                 // magic cookie
+               53, 1, reply,
+               54, 4, ...GW_IP,
+               51, 4, 0, 1, 0x51, 0x80,         // lease: 1 day
+               1, 4, 255, 255, 255, 0,
+               3, 4, ...GW_IP,
+               6, 4, ...DNS_IP,
+               255], 236);
+        this.sendUDP(GW_IP, 67, BCAST_IP, 68, r, BCAST_MAC);
+    }
+
+    inputTCP(src, dst, d) {
+        if (d.length < TCP_HLEN) {
+            return;
+        }
+        const sport = (d[0] << 8) | d[1], dport = (d[2] << 8) | d[3];
+        const seq = ((d[4] << 24) | (d[5] << 16) | (d[6] << 8) | d[7]) >>> 0;
+        const ack = ((d[8] << 24) | (d[9] << 16) | (d[10] << 8) | d[11]) >>> 0;
+        const flags = d[13];
+        const data = d.subarray((d[12] >> 4) * 4);
+        const key = `${src.join('.')}:${sport}-${dst.join('.')}:${dport}`;
+        const c = this.conns.get(key);
+
+        if (flags & TCP_RST) {
+            if (c) {
+                this.drop(c);
+            }
+            return;
+        }
+        if (!c) {
+            if ((flags & (TCP_SYN | TCP_ACK)) !== TCP_SYN || dport !== 80) {
+                // refuse, the way a closed port does
+                const rseq = (flags & TCP_ACK) ? ack : 0;
+                const rack = (seq + data.length + ((flags & TCP_SYN) ? 1 : 0)) >>> 0;
+                this.sendTCP({ lip: dst, lport: dport, rip: src, rport: sport,
+                               sndNxt: rseq, rcvNxt: rack },
+                             TCP_RST | TCP_ACK, null, rseq);
+                return;
+            }
+            this.newConn(key, src, sport, dst, dport, seq);
+            return;
+        }
+
+        if (flags & TCP_ACK) {
+            this.ackConn(c, ack, (d[14] << 8) | d[15]);
+            if (!this.conns.has(key)) {
+                return;
+            }
+        }
+        if (data.length || (flags & TCP_FIN)) {
+            if (seq === c.rcvNxt && !c.peerClosed) {
+                c.rcvNxt = (c.rcvNxt + data.length) >>> 0;
+                if (data.length) {
+                    this.onData(c, data);
+                }
+                if (flags & TCP_FIN) {
+                    c.rcvNxt = (c.rcvNxt + 1) >>> 0;
+                    c.peerClosed = true;
+                }
+            }
+            // also acks retransmits and asks again for what is missing
+            this.sendTCP(c, TCP_ACK);
+        }
+        this.pump(c);
+        if (c.peerClosed && c.finSent && c.sndUna === c.sndNxt) {
+            this.drop(c);
+        }
+    }
+
+    drop(c) {
+        this.conns.delete(c.key);
+        c.waiters.splice(0).forEach((resolve) => resolve());
+    }
+
+    newConn(key, rip, rport, lip, lport, seq) {
+        const iss = (Math.random() * 0x100000000) >>> 0;
+        const c = {
+            key, rip, rport, lip, lport,
+            iss, sndUna: iss, sndNxt: (iss + 1) >>> 0, sndWnd: 0,
+            rcvNxt: (seq + 1) >>> 0,
+            established: false, chunks: [], bufLen: 0, closing: false,
+            finSent: false, peerClosed: false, lastSend: Date.now(),
+            req: [], reqLen: 0, started: false, waiters: [],
+        };
+        this.conns.set(key, c);
+        this.sendTCP(c, TCP_SYN | TCP_ACK, null, iss);
+        return c;
+    }
+
+    ackConn(c, ack, wnd) {
+        c.sndWnd = wnd;
+        if (!seqLE(ack, c.sndNxt) || !seqLE(c.sndUna, ack)) {
+            return;
+        }
+        let n = (ack - c.sndUna) >>> 0;
+        if (!c.established) {
+            if (n === 0) {
+                return;
+            }
+            c.established = true;
+            n--;
+        }
+        c.sndUna = ack;
+        // drop the acked bytes, the FIN takes no room in the buffer
+        n = Math.min(n, c.bufLen);
+        c.bufLen -= n;
+        while (n > 0) {
+            const head = c.chunks[0];
+            if (head.length <= n) {
+                n -= head.length;
+                c.chunks.shift();
+            } else {
+                c.chunks[0] = head.subarray(n);
+                n = 0;
+            }
+        }
+        if (c.bufLen < SEND_BUFFER) {
+            c.waiters.splice(0).forEach((resolve) => resolve());
+        }
+    }
+
+    // sends what the window allows of the buffer, then the FIN
+    pump(c) {
+        if (!c.established) {
+            return;
+        }
+        const seg = this.offloadTCP() && (this.ring.offloads() & OFFLOAD_TSO4)
+                    ? GSO_MAX : MSS;
+        for (;;) {
+            const off = (c.sndNxt - c.sndUna) >>> 0;
+            const room = Math.min(c.sndWnd, 1 << 16) - off;
+            const len = Math.min(seg, c.bufLen - off, room);
+            if (len <= 0) {
+                break;
+            }
+            this.sendTCP(c, TCP_ACK | TCP_PSH, this.peek(c, off, len));
+            c.sndNxt = (c.sndNxt + len) >>> 0;
+        }
+        if (c.closing && !c.finSent &&
+            ((c.sndNxt - c.sndUna) >>> 0) === c.bufLen) {
+            this.sendTCP(c, TCP_FIN | TCP_ACK);
+            c.sndNxt = (c.sndNxt + 1) >>> 0;
+            c.finSent = true;
+        }
+    }
+
+    peek(c, off, len) {
+        const out = new Uint8Array(len);
+        let pos = 0;
+        for (const chunk of c.chunks) {
+            if (off >= chunk.length) {
+                off -= chunk.length;
+                continue;
+            }
+            const part = chunk.subarray(off, off + len - pos);
+            out.set(part, pos);
+            pos += part.length;
+            off = 0;
+            if (pos === len) {
+                break;
+            }
+        }
+        return out;
+    }
+
+    // go-back-N for segments the guest hasn't acked, e.g. dropped in a
+    // full ring
+    retransmit() {
+        const now = Date.now();
+        for (const c of this.conns.values()) {
+            if (c.sndUna === c.sndNxt || now - c.lastSend < RTO_MS) {
+                continue;
+            }
+            if (!c.established) {
+                this.sendTCP(c, TCP_SYN | TCP_ACK, null, c.iss);
+                continue;
+            }
+            c.sndNxt = c.sndUna;
+            c.finSent = false;
+            this.pump(c);
+        }
+    }
+
+    write(c, data) {
+        if (data.length) {
+            c.chunks.push(data);
+            c.bufLen += data.length;
+            this.pump(c);
+        }
+        if (c.bufLen < SEND_BUFFER || !this.conns.has(c.key)) {
+            return Promise.resolve();
+        }
+        return new Promise((resolve) => c.waiters.push(resolve));
+    }
+
+    close(c) {
+        c.closing = true;
+        this.pump(c);
+    }
+
+    onData(c, data) {
+        if (c.started) {
+            return;     // one request per connection
+        }
+        c.req.push(data.slice());
+        c.reqLen += data.length;
+        const buf = concat(c.req, c.reqLen);
+        const text = td.decode(buf);
+        const end = text.indexOf('\r\n\r\n');
+        if (end < 0) {
+            return;
+        }
+        const lines = text.substring(0, end).split('\r\n');
+        const [method, target] = lines[0].split(' ');
+        const headers = new Headers();
+        let host = c.lip.join('.');
+        let bodyLen = 0;
+        for (const line of lines.slice(1)) {
+            const i = line.indexOf(':');
+            const name = line.substring(0, i).trim().toLowerCase();
+            const value = line.substring(i + 1).trim();
+            if (name === 'host') {
+                host = value;
+            } else if (name === 'content-length') {
+                bodyLen = parseInt(value, 10) || 0;
+            } else if (!['connection', 'proxy-connection', 'keep-alive',
+                         'transfer-encoding', 'upgrade'].includes(name)) {
+                try {
+                    headers.append(name, value);
+                } catch (e) {
+                    // forbidden for fetch(), leave it out
+                }
+            }
+        }
+        if (buf.length < end + 4 + bodyLen) {
+            return;
+        }
+        c.started = true;
+        const body = buf.subarray(end + 4, end + 4 + bodyLen);
+        // proxy requests, and "GET /https://..." for https:// URLs that
+        // the guest can't send through the proxy without a tunnel
+        const url = /^\/?https?:\/\//.test(target) ? target.replace(/^\//, '')
+                                                  : `http://${host}${target}`;
+        this.fetchFor(c, method, url, headers, body);
+    }
+
+    async fetchFor(c, method, url, headers, body) {
+        let resp;
+        try {
+            if (method === 'CONNECT') {
+                throw new Error('CONNECT');
+            }
+            resp = await fetch(url, {
+                method, headers, redirect: 'manual',
+                body: ['GET', 'HEAD'].includes(method) ? undefined : body,
+            });
+        } catch (e) {
+            const status = method === 'CONNECT' ? '501 Not Implemented'
+                                                : '502 Bad Gateway';
+            await this.write(c, te.encode(
+                `HTTP/1.1 ${status}\r\nContent-Length: 0\r\n` +
+                'Connection: close\r\n\r\n'));
+            this.close(c);
+            return;
+        }
+        // fetch() has decoded the body, so its length and encoding changed
+        let head = `HTTP/1.1 ${resp.status} ${resp.statusText}\r\n`;
+        resp.headers.forEach((value, name) => {
+            if (!['content-encoding', 'content-length', 'transfer-encoding',
+                  'connection', 'keep-alive'].includes(name)) {
+                head += `${name}: ${value}\r\n`;
+            }
+        });
+        await this.write(c, te.encode(head + 'Connection: close\r\n\r\n'));
+        if (resp.body && method !== 'HEAD') {
+            const reader = resp.body.getReader();
+            for (;;) {
+                const { done, value } = await reader.read().catch(() => ({ done: true }));
+                if (done || !this.conns.has(c.key)) {
+                    break;
+                }
+                await this.write(c, value);
+            }
+        }
+        this.close(c);
+    }
+
+    // whether the guest completes the checksums of our TCP segments
+    offloadTCP() {
+        return this.ring.vnetHdrLen() > 0 &&
+               (this.ring.offloads() & OFFLOAD_CSUM) !== 0;
+    }
+
+    sendTCP(c, flags, data = null, seq = c.sndNxt) {
+        const opts = (flags & TCP_SYN) ? [2, 4, MSS >> 8, MSS & 0xff] : [];
+        const hlen = TCP_HLEN + opts.length;
+        const len = hlen + (data ? data.length : 0);
+        const t = new Uint8Array(len);
+        t.set([c.lport >> 8, c.lport & 0xff, c.rport >> 8, c.rport & 0xff,
+               seq >>> 24, (seq >> 16) & 0xff, (seq >> 8) & 0xff, seq & 0xff,
+               c.rcvNxt >>> 24, (c.rcvNxt >> 16) & 0xff,
+               (c.rcvNxt >> 8) & 0xff, c.rcvNxt & 0xff,
+               (hlen / 4) << 4, flags, 0xff, 0xff, 0, 0, 0, 0, ...opts]);
+        if (data) {
+            t.set(data, hlen);
+        }
+        let vnet = null;
+        if (this.offloadTCP()) {
+            // partial checksum: the pseudo-header sum, the guest adds the rest
+            const sum = pseudoSum(c.lip, c.rip, 6, len);
+            t[16] = sum >> 8;
+            t[17] = sum & 0xff;
+            vnet = {
+                flags: VNET_F_NEEDS_CSUM,
+                gsoType: len - hlen > MSS ? VNET_GSO_TCPV4 : 0,
+                hdrLen: ETH_HLEN + IP_HLEN + hlen,
+                gsoSize: MSS,
+                csumStart: ETH_HLEN + IP_HLEN,
+                csumOffset: 16,
+            };
+        } else {
+            const sum = ~csum(t, pseudoSum(c.lip, c.rip, 6, len)) & 0xffff;
+            t[16] = sum >> 8;
+            t[17] = sum & 0xff;
+        }
+        c.lastSend = Date.now();
+        this.sendIP(6, c.lip, c.rip, t, this.guestMac, vnet);
+    }
+
+    sendUDP(src, sport, dst, dport, data, mac) {
+        const len = 8 + data.length;
+        const u = new Uint8Array(len);
+        u.set([sport >> 8, sport & 0xff, dport >> 8, dport & 0xff,
+               len >> 8, len & 0xff]);
+        u.set(data, 8);
+        const sum = ~csum(u, pseudoSum(src, dst, 17, len)) & 0xffff;
+        // 0 means no checksum for UDP
+        u[6] = (sum || 0xffff) >> 8;
+        u[7] = (sum || 0xffff) & 0xff;
+        this.sendIP(17, src, dst, u, mac);
+    }
+
+    sendIP(proto, src, dst, data, mac = this.guestMac, vnet = null) {
+        const len = IP_HLEN + data.length;
+        const p = new Uint8Array(len);
+        const id = this.ipId++ & 0xffff;
+        p.set([0x45, 0, len >> 8, len & 0xff, id >> 8, id & 0xff, 0x40, 0,
+               64, proto, 0, 0, ...src, ...dst]);
+        const sum = ~csum(p.subarray(0, IP_HLEN)) & 0xffff;
+        p[10] = sum >> 8;
+        p[11] = sum & 0xff;
+        p.set(data, IP_HLEN);
+        this.sendEth(mac, 0x0800, p, vnet);
+    }
+
+    sendEth(dst, type, payload, vnet = null) {
+        const h = this.ring.vnetHdrLen();
+        const f = new Uint8Array(h + Math.max(ETH_HLEN + payload.length, 60));
+        if (vnet) {
+            const v = new DataView(f.buffer);
+            v.setUint8(0, vnet.flags);
+            v.setUint8(1, vnet.gsoType);
+            v.setUint16(2, vnet.hdrLen, true);
+            v.setUint16(4, vnet.gsoSize, true);
+            v.setUint16(6, vnet.csumStart, true);
+            v.setUint16(8, vnet.csumOffset, true);
+        }
+        f.set(dst, h);
+        f.set(GW_MAC, h + 6);
+        f[h + 12] = type >> 8;
+        f[h + 13] = type & 0xff;
+        f.set(payload, h + ETH_HLEN);
+        this.ring.send(f);
+    }
+}
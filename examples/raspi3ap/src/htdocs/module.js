@@ -10,3 +10,14 @@ Module['arguments'] = [
     '-drive', 'file=/pack/rootfs.bin,format=raw,if=sd',
     '-append', 'earlycon=pl011,0x3f201000 console=ttyAMA0,115200 loglevel=8 initcall_blacklist=bcm2835_pm_driver_init root=/dev/mmcblk0 rootfstype=ext4 rootwait no_console_suspend'
 ];
+// Workers started along with QEMU, see "Prewarming threads" in README.md
+Module['pthreadPoolSize'] = 7; // 10 with the MTTCG arguments above
+// Compile the module while out.js and the rest download, see "Faster startup"
+// in README.md
+const wasmModule = WebAssembly.compileStreaming(fetch('qemu-system-aarch64.wasm'));
+Module['instantiateWasm'] = (imports, receiveInstance) => {
+    wasmModule.then(async (module) => {
+        receiveInstance(await WebAssembly.instantiate(module, imports), module);
+    });
+    return {};
+};
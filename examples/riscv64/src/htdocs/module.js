@@ -9,3 +9,14 @@ Module['arguments'] = [
     '-kernel', '/pack/Image',
     '-append', 'earlyprintk=ttyS0 console=ttyS0 root=/dev/vda rootwait ro quiet virtio_net.napi_tx=false loglevel=7',
 ];
+// Workers started along with QEMU, see "Prewarming threads" in README.md
+Module['pthreadPoolSize'] = 7; // 10 with the MTTCG arguments above
+// Compile the module while out.js and the rest download, see "Faster startup"
+// in README.md
+const wasmModule = WebAssembly.compileStreaming(fetch('qemu-system-riscv64.wasm'));
+Module['instantiateWasm'] = (imports, receiveInstance) => {
+    wasmModule.then(async (module) => {
+        receiveInstance(await WebAssembly.instantiate(module, imports), module);
+    });
+    return {};
+};
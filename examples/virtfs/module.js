@@ -9,6 +9,17 @@ Module['arguments'] = [
     '-append', 'earlyprintk=ttyS0,115200n8 console=ttyS0,115200n8 root=/dev/vda rootwait ro loglevel=7',
     '-virtfs', 'local,path=/share,mount_tag=share0,security_model=passthrough,id=share0',
 ];
+// Workers started along with QEMU, see "Prewarming threads" in README.md
+Module['pthreadPoolSize'] = 7; // 10 with the MTTCG arguments above
+// Compile the module while out.js and the rest download, see "Faster startup"
+// in README.md
+const wasmModule = WebAssembly.compileStreaming(fetch('qemu-system-x86_64.wasm'));
+Module['instantiateWasm'] = (imports, receiveInstance) => {
+    wasmModule.then(async (module) => {
+        receiveInstance(await WebAssembly.instantiate(module, imports), module);
+    });
+    return {};
+};
 Module['preRun'].push((mod) => {
     mod.FS.mkdir('/share');
     mod.FS.writeFile('/share/file', 'test\n');
@@ -35,6 +35,12 @@ EOF
 chroot /mnt/sdb/ rc-update add setup-wasm-networking additional
 cp /mnt/sdc1/root-profile /mnt/sdb/root/.profile
 chmod 644 /mnt/sdb/root/.profile
+cp /mnt/sdc1/wasm-bench /mnt/sdb/usr/local/bin/wasm-bench
+chmod 755 /mnt/sdb/usr/local/bin/wasm-bench
+cat <<'EOF' >> /mnt/sdb/etc/inittab
+# Benchmark run, no-op unless "wasm_bench" is on the kernel command line
+::once:/usr/local/bin/wasm-bench
+EOF
 
 apk add --no-progress --no-cache mkinitfs
 cp /mnt/sdc1/init.sh /mnt/sdb/sbin/init.sh
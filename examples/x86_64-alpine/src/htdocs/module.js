@@ -10,3 +10,14 @@ Module['arguments'] = [
     '-virtfs', 'local,path=/.wasmenv,mount_tag=wasm0,security_model=passthrough,id=wasm0',
     '-netdev', 'socket,id=vmnic,connect=localhost:8888', '-device', 'virtio-net-pci,netdev=vmnic'
 ];
+// Workers started along with QEMU, see "Prewarming threads" in README.md
+Module['pthreadPoolSize'] = 7;
+// Compile the module while out.js and the rest download, see "Faster startup"
+// in README.md
+const wasmModule = WebAssembly.compileStreaming(fetch('qemu-system-x86_64.wasm'));
+Module['instantiateWasm'] = (imports, receiveInstance) => {
+    wasmModule.then(async (module) => {
+        receiveInstance(await WebAssembly.instantiate(module, imports), module);
+    });
+    return {};
+};
@@ -0,0 +1,316 @@
+// Page side of "-display canvas" (ui/canvas.c), run on the main thread:
+//
+//   Module['arguments'] = ['-display', 'canvas', '-vga', 'std', ...];
+//   attachCanvasDisplay(Module, document.querySelector('canvas'));
+//
+// QEMU publishes the display surface, which lives in the wasm memory, and
+// the rectangle of it that changed. Once per animation frame the page
+// uploads that rectangle to a WebGL2 texture or, without WebGL2, copies it
+// into a 2D canvas, and hands the surface back.
+//
+// The shared state is { u32 update, generation, data, width, height,
+// stride, x0, y0, x1, y1, bpp, input, absolute }. The pixels are x8r8g8b8 (B, G, R,
+// X bytes) with bpp 32 or r5g6b5 with bpp 16.
+//
+// Keyboard and mouse events of the canvas go to the guest through the
+// ring at input, { u32 head, tail, size, dropped; events[size] } with
+// events of { u32 type, code; i32 x, y }. Unless the guest has an
+// absolute pointing device such as usb-tablet, clicking the canvas locks
+// the pointer so that it gets relative motion.
+
+const UPDATE = 0;
+const GENERATION = 1;
+const DATA = 2;
+const WIDTH = 3;
+const HEIGHT = 4;
+const STRIDE = 5;
+const X0 = 6;
+const Y0 = 7;
+const X1 = 8;
+const Y1 = 9;
+const BPP = 10;
+const INPUT = 11;
+const ABSOLUTE = 12;
+
+const INPUT_KEY = 1;
+const INPUT_BTN = 2;
+const INPUT_ABS = 3;
+const INPUT_REL = 4;
+
+// InputButton of qapi/ui.json for MouseEvent.button
+const BUTTONS = [0, 1, 2, 5, 6];
+const BUTTON_WHEEL_UP = 3;
+const BUTTON_WHEEL_DOWN = 4;
+const BUTTON_WHEEL_LEFT = 7;
+const BUTTON_WHEEL_RIGHT = 8;
+
+// Linux key codes (input-event-codes.h) for KeyboardEvent.code
+const KEYS = {
+    Escape: 1, Digit1: 2, Digit2: 3, Digit3: 4, Digit4: 5, Digit5: 6,
+    Digit6: 7, Digit7: 8, Digit8: 9, Digit9: 10, Digit0: 11, Minus: 12,
+    Equal: 13, Backspace: 14, Tab: 15, KeyQ: 16, KeyW: 17, KeyE: 18,
+    KeyR: 19, KeyT: 20, KeyY: 21, KeyU: 22, KeyI: 23, KeyO: 24, KeyP: 25,
+    BracketLeft: 26, BracketRight: 27, Enter: 28, ControlLeft: 29,
+    KeyA: 30, KeyS: 31, KeyD: 32, KeyF: 33, KeyG: 34, KeyH: 35, KeyJ: 36,
+    KeyK: 37, KeyL: 38, Semicolon: 39, Quote: 40, Backquote: 41,
+    ShiftLeft: 42, Backslash: 43, KeyZ: 44, KeyX: 45, KeyC: 46, KeyV: 47,
+    KeyB: 48, KeyN: 49, KeyM: 50, Comma: 51, Period: 52, Slash: 53,
+    ShiftRight: 54, NumpadMultiply: 55, AltLeft: 56, Space: 57,
+    CapsLock: 58, F1: 59, F2: 60, F3: 61, F4: 62, F5: 63, F6: 64, F7: 65,
+    F8: 66, F9: 67, F10: 68, NumLock: 69, ScrollLock: 70, Numpad7: 71,
+    Numpad8: 72, Numpad9: 73, NumpadSubtract: 74, Numpad4: 75,
+    Numpad5: 76, Numpad6: 77, NumpadAdd: 78, Numpad1: 79, Numpad2: 80,
+    Numpad3: 81, Numpad0: 82, NumpadDecimal: 83, IntlBackslash: 86,
+    F11: 87, F12: 88, IntlRo: 89, NumpadEnter: 96, ControlRight: 97,
+    NumpadDivide: 98, PrintScreen: 99, AltRight: 100, Home: 102,
+    ArrowUp: 103, PageUp: 104, ArrowLeft: 105, ArrowRight: 106, End: 107,
+    ArrowDown: 108, PageDown: 109, Insert: 110, Delete: 111,
+    NumpadEqual: 117, Pause: 119, IntlYen: 124, MetaLeft: 125,
+    MetaRight: 126, ContextMenu: 127,
+};
+
+const VERTEX_SHADER = `#version 300 es
+in vec2 pos;
+out vec2 uv;
+void main() {
+    uv = vec2(pos.x, 1.0 - pos.y) * 0.5 + 0.5;
+    gl_Position = vec4(pos, 0.0, 1.0);
+}`;
+
+// x8r8g8b8 is uploaded as RGBA bytes, so R and B are swapped
+const FRAGMENT_SHADER = `#version 300 es
+precision mediump float;
+uniform sampler2D tex;
+uniform bool bgr;
+in vec2 uv;
+out vec4 color;
+void main() {
+    vec3 c = texture(tex, uv).rgb;
+    color = vec4(bgr ? c.bgr : c, 1.0);
+}`;
+
+class GLPainter {
+    constructor(gl) {
+        this.gl = gl;
+        const prog = gl.createProgram();
+        for (const [type, src] of [[gl.VERTEX_SHADER, VERTEX_SHADER],
+                                   [gl.FRAGMENT_SHADER, FRAGMENT_SHADER]]) {
+            const shader = gl.createShader(type);
+            gl.shaderSource(shader, src);
+            gl.compileShader(shader);
+            gl.attachShader(prog, shader);
+        }
+        gl.bindAttribLocation(prog, 0, 'pos');
+        gl.linkProgram(prog);
+        gl.useProgram(prog);
+        this.bgr = gl.getUniformLocation(prog, 'bgr');
+
+        gl.bindBuffer(gl.ARRAY_BUFFER, gl.createBuffer());
+        gl.bufferData(gl.ARRAY_BUFFER,
+                      new Float32Array([-1, -1, 1, -1, -1, 1, 1, 1]),
+                      gl.STATIC_DRAW);
+        gl.enableVertexAttribArray(0);
+        gl.vertexAttribPointer(0, 2, gl.FLOAT, false, 0, 0);
+    }
+
+    resize(width, height, bpp) {
+        const gl = this.gl;
+        // texture storage is immutable, a new size needs a new texture
+        gl.deleteTexture(this.tex);
+        this.tex = gl.createTexture();
+        gl.bindTexture(gl.TEXTURE_2D, this.tex);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, gl.NEAREST);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MAG_FILTER, gl.NEAREST);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_S, gl.CLAMP_TO_EDGE);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_T, gl.CLAMP_TO_EDGE);
+        gl.texStorage2D(gl.TEXTURE_2D, 1, bpp === 16 ? gl.RGB565 : gl.RGBA8,
+                        width, height);
+        gl.uniform1i(this.bgr, bpp !== 16);
+        gl.viewport(0, 0, width, height);
+    }
+
+    paint(heap, s) {
+        const gl = this.gl;
+        const w = s.x1 - s.x0;
+        const h = s.y1 - s.y0;
+        const bytes = s.bpp / 8;
+        const start = s.data + s.y0 * s.stride + s.x0 * bytes;
+        const len = (h - 1) * s.stride + w * bytes;
+
+        // reads the rectangle straight out of the wasm memory
+        gl.pixelStorei(gl.UNPACK_ROW_LENGTH, s.stride / bytes);
+        if (s.bpp === 16) {
+            gl.texSubImage2D(gl.TEXTURE_2D, 0, s.x0, s.y0, w, h, gl.RGB,
+                             gl.UNSIGNED_SHORT_5_6_5,
+                             new Uint16Array(heap.buffer, start, len / 2));
+        } else {
+            gl.texSubImage2D(gl.TEXTURE_2D, 0, s.x0, s.y0, w, h, gl.RGBA,
+                             gl.UNSIGNED_BYTE, heap.subarray(start, start + len));
+        }
+        gl.drawArrays(gl.TRIANGLE_STRIP, 0, 4);
+    }
+}
+
+class CanvasPainter {
+    constructor(ctx) {
+        this.ctx = ctx;
+    }
+
+    resize(width, height, bpp) {
+    }
+
+    paint(heap, s) {
+        const w = s.x1 - s.x0;
+        const h = s.y1 - s.y0;
+        // ImageData can't be made from shared memory, so this copies
+        const img = new ImageData(w, h);
+        const dst = img.data;
+        for (let y = 0; y < h; y++) {
+            let src = s.data + (s.y0 + y) * s.stride + s.x0 * s.bpp / 8;
+            let d = y * w * 4;
+            if (s.bpp === 16) {
+                for (let x = 0; x < w; x++, src += 2, d += 4) {
+                    const v = heap[src] | (heap[src + 1] << 8);
+                    dst[d] = (v >> 8) & 0xf8;
+                    dst[d + 1] = (v >> 3) & 0xfc;
+                    dst[d + 2] = (v << 3) & 0xf8;
+                    dst[d + 3] = 255;
+                }
+                continue;
+            }
+            for (let x = 0; x < w; x++, src += 4, d += 4) {
+                dst[d] = heap[src + 2];
+                dst[d + 1] = heap[src + 1];
+                dst[d + 2] = heap[src];
+                dst[d + 3] = 255;
+            }
+        }
+        this.ctx.putImageData(img, s.x0, s.y0);
+    }
+}
+
+class InputRing {
+    constructor(buffer, base) {
+        this.u32 = new Uint32Array(buffer, base, 4);
+        this.i32 = new Int32Array(buffer, base, 4);     // for notify
+        this.size = this.u32[2];
+        this.ev = new Int32Array(buffer, base + 16, this.size * 4);
+    }
+
+    push(type, code, x, y) {
+        const head = Atomics.load(this.u32, 0);
+        const tail = Atomics.load(this.u32, 1);
+        if (((head - tail) >>> 0) >= this.size) {
+            Atomics.add(this.u32, 3, 1);
+            return;
+        }
+        const i = (head % this.size) * 4;
+        this.ev[i] = type;
+        this.ev[i + 1] = code;
+        this.ev[i + 2] = x;
+        this.ev[i + 3] = y;
+        Atomics.store(this.u32, 0, (head + 1) >>> 0);
+        // QEMU only sleeps on an empty ring, see canvas_input_bh()
+        if (Atomics.load(this.u32, 1) === head) {
+            Atomics.notify(this.i32, 0);
+        }
+    }
+}
+
+function attachInput(canvas, ring, shared) {
+    canvas.tabIndex = 0;
+    const key = (e, down) => {
+        const code = KEYS[e.code];
+        if (code) {
+            ring.push(INPUT_KEY, code, down ? 1 : 0, 0);
+            e.preventDefault();
+        }
+    };
+    canvas.addEventListener('keydown', (e) => key(e, true));
+    canvas.addEventListener('keyup', (e) => key(e, false));
+
+    canvas.addEventListener('mousemove', (e) => {
+        if (document.pointerLockElement === canvas) {
+            ring.push(INPUT_REL, 0, e.movementX, e.movementY);
+            return;
+        }
+        const rect = canvas.getBoundingClientRect();
+        ring.push(INPUT_ABS, 0,
+                  Math.round((e.clientX - rect.left) * canvas.width / rect.width),
+                  Math.round((e.clientY - rect.top) * canvas.height / rect.height));
+    });
+    const button = (e, down) => {
+        if (e.button < BUTTONS.length) {
+            ring.push(INPUT_BTN, BUTTONS[e.button], down ? 1 : 0, 0);
+        }
+        e.preventDefault();
+    };
+    canvas.addEventListener('mousedown', (e) => {
+        canvas.focus();
+        if (document.pointerLockElement !== canvas &&
+            !Atomics.load(shared, ABSOLUTE)) {
+            canvas.requestPointerLock();
+        }
+        button(e, true);
+    });
+    canvas.addEventListener('mouseup', (e) => button(e, false));
+    canvas.addEventListener('contextmenu', (e) => e.preventDefault());
+    canvas.addEventListener('wheel', (e) => {
+        const click = (btn) => {
+            ring.push(INPUT_BTN, btn, 1, 0);
+            ring.push(INPUT_BTN, btn, 0, 0);
+        };
+        if (e.deltaY) {
+            click(e.deltaY < 0 ? BUTTON_WHEEL_UP : BUTTON_WHEEL_DOWN);
+        }
+        if (e.deltaX) {
+            click(e.deltaX < 0 ? BUTTON_WHEEL_LEFT : BUTTON_WHEEL_RIGHT);
+        }
+        e.preventDefault();
+    }, { passive: false });
+}
+
+export function attachCanvasDisplay(Module, canvas) {
+    const gl = canvas.getContext('webgl2', { antialias: false, alpha: false });
+    const painter = gl ? new GLPainter(gl)
+                       : new CanvasPainter(canvas.getContext('2d'));
+    let shared = null;
+    let generation = -1;
+    let input = null;
+
+    const tick = () => {
+        requestAnimationFrame(tick);
+        if (!shared) {
+            const base = Module.calledRun && Module._canvas_display_info();
+            if (!base) {
+                return;
+            }
+            shared = new Uint32Array(Module.HEAPU8.buffer, base, 13);
+        }
+        if (!Atomics.load(shared, UPDATE)) {
+            return;
+        }
+        if (!input) {
+            // set up along with the display, before the first update
+            input = new InputRing(Module.HEAPU8.buffer, shared[INPUT]);
+            attachInput(canvas, input, shared);
+        }
+        const s = {
+            data: shared[DATA], stride: shared[STRIDE],
+            width: shared[WIDTH], height: shared[HEIGHT],
+            x0: shared[X0], y0: shared[Y0], x1: shared[X1], y1: shared[Y1],
+            bpp: shared[BPP],
+        };
+        if (shared[GENERATION] !== generation) {
+            generation = shared[GENERATION];
+            canvas.width = s.width;
+            canvas.height = s.height;
+            painter.resize(s.width, s.height, s.bpp);
+        }
+        if (s.x1 > s.x0 && s.y1 > s.y0) {
+            painter.paint(Module.HEAPU8, s);
+        }
+        Atomics.store(shared, UPDATE, 0);
+    };
+    requestAnimationFrame(tick);
+}
@@ -2,9 +2,37 @@ Module['arguments'] = [
     '-nographic', '-m', '512M', '-accel', 'tcg,tb-size=500',
     //Use the following to enable MTTCG
     //'-nographic', '-m', '512M', '-accel', 'tcg,tb-size=500,thread=multi', '-smp', '4,sockets=4',
+    //Use the following for a virtio console on "-chardev sabring" (see README.md),
+    //with console=hvc0 instead of console=ttyS0,115200n8 in -append
+    //'-display', 'none', '-m', '512M', '-accel', 'tcg,tb-size=500',
+    //'-device', 'virtio-serial-pci', '-chardev', 'sabring,id=con0,size=1M', '-device', 'virtconsole,chardev=con0',
+    //Use the following instead of the lines below for the fast-boot microvm profile
+    //(see README.md of the example), built with linux_x86_microvm_config
+    //'-M', 'microvm,acpi=off,pic=off,pit=off,rtc=off,x-option-roms=off', '-nodefaults',
+    //'-L', '/pack/', '-nic', 'none', '-serial', 'stdio',
+    //'-drive', 'if=none,id=hd0,format=raw,file=/pack/rootfs.bin', '-device', 'virtio-blk-device,drive=hd0',
+    //'-kernel', '/pack/bzImage-microvm', '-append', 'console=ttyS0 root=/dev/vda rootwait ro quiet',
     '-L', '/pack/',
     '-nic', 'none',
     '-drive', 'if=virtio,format=raw,file=/pack/rootfs.bin',
     '-kernel', '/pack/bzImage',
     '-append', 'earlyprintk=ttyS0,115200n8 console=ttyS0,115200n8 root=/dev/vda rootwait ro loglevel=7',
 ];
+// Workers started along with QEMU, see "Prewarming threads" in README.md
+Module['pthreadPoolSize'] = 7; // 10 with the MTTCG arguments above
+// Compile the module while out.js and the rest download, see "Faster startup"
+// in README.md
+const wasmModule = WebAssembly.compileStreaming(fetch('qemu-system-x86_64.wasm'));
+Module['instantiateWasm'] = (imports, receiveInstance) => {
+    wasmModule.then(async (module) => {
+        receiveInstance(await WebAssembly.instantiate(module, imports), module);
+    });
+    return {};
+};
+// Let QEMU wait longer for stdio while the page is hidden, see "Idle guests"
+// in README.md
+document.addEventListener('visibilitychange', () => {
+    if (Module.calledRun) {
+        Module.ccall('fdmon_wasm_set_hidden', null, ['number'], [document.hidden ? 1 : 0]);
+    }
+});
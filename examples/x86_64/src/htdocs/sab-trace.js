@@ -0,0 +1,87 @@
+// Consumer of the sab trace backend (trace/sab.c), for QEMU configured with
+// --enable-trace-backends=sab and run with e.g. '-trace', 'virtio_blk_*':
+//
+//   const trace = await openSabTrace(Module);
+//   setInterval(() => trace.drain(), 500);
+//   ...
+//   download(trace.blob());       // a "trace-<pid>" file of simpletrace.py
+//
+// Each QEMU thread logs into a ring of its own, so drain() doesn't stop
+// any of them; a ring that fills up before the next drain() drops events,
+// and simpletrace.py shows how many as a "dropped" event.
+//
+// sab_trace_lookup() returns { u32 meta, meta_len, rings } with the file
+// header and event ID mappings at meta. Each ring is
+// { u32 head, tail, size, next, pid, dropped, reserved[2]; u8 data[size] }
+// with free-running head/tail byte counters.
+
+const RING_HDR = 32;
+
+export class SabTrace {
+    constructor(Module, info) {
+        this.Module = Module;
+        this.info = info;
+        this.metaDone = 0;
+        this.chunks = [];
+    }
+
+    // Moves what QEMU logged so far out of the wasm memory
+    drain() {
+        const heap = this.Module.HEAPU8;
+        const u32 = new Uint32Array(heap.buffer);
+        const info = this.info >>> 2;
+
+        // take the heads before the mappings, which precede their events
+        const rings = [];
+        for (let p = Atomics.load(u32, info + 2); p; p = Atomics.load(u32, (p >>> 2) + 3)) {
+            rings.push([p, Atomics.load(u32, p >>> 2)]);
+        }
+
+        const metaLen = Atomics.load(u32, info + 1);
+        if (metaLen > this.metaDone) {
+            const meta = Atomics.load(u32, info);
+            this.chunks.push(heap.slice(meta + this.metaDone, meta + metaLen));
+            this.metaDone = metaLen;
+        }
+
+        for (const [p, head] of rings) {
+            const ring = p >>> 2;
+            const tail = Atomics.load(u32, ring + 1);
+            const size = u32[ring + 2];
+            const len = (head - tail) >>> 0;
+            if (!len) {
+                continue;
+            }
+            const data = p + RING_HDR;
+            const off = tail & (size - 1);
+            const first = Math.min(len, size - off);
+            this.chunks.push(heap.slice(data + off, data + off + first));
+            if (len > first) {
+                this.chunks.push(heap.slice(data, data + len - first));
+            }
+            Atomics.store(u32, ring + 1, head);
+        }
+    }
+
+    // The trace file so far
+    blob() {
+        this.drain();
+        return new Blob(this.chunks, { type: 'application/octet-stream' });
+    }
+}
+
+// Resolves to the SabTrace of QEMU once it has started
+export function openSabTrace(Module) {
+    return new Promise((resolve) => {
+        const poll = () => {
+            const info = Module.calledRun &&
+                         Module.ccall('sab_trace_lookup', 'number', [], []);
+            if (!info) {
+                setTimeout(poll, 100);
+                return;
+            }
+            resolve(new SabTrace(Module, info));
+        };
+        poll();
+    });
+}
@@ -0,0 +1,114 @@
+// Terminal side of "-chardev sabring" (chardev/char-sabring.c), run on
+// the main thread of the page:
+//
+//   Module['arguments'] = [... '-chardev', 'sabring,id=con0',
+//                          '-serial', 'chardev:con0' ...];
+//   attachSabringConsole(Module, 'con0', xterm);
+//
+// Guest output is drained once per animation frame into a single write
+// to xterm.js. While xterm.js is still busy with earlier output the ring
+// is left alone, so that it fills up and the guest waits instead of the
+// page. Input typed into the terminal goes back through the second ring.
+// Other chardevs, e.g. of virtserialport devices, can be read and written
+// directly with openSabringChardev().
+//
+// Each ring is { u32 head, tail, size, dropped, user[4]; u8 data[size] }
+// with free-running head/tail byte counters. The input ring follows the
+// output ring.
+
+const HDR = 32;
+const MAX_PENDING_WRITES = 2;
+
+class ByteRing {
+    constructor(buffer, base) {
+        this.u32 = new Uint32Array(buffer, base, HDR / 4);
+        this.i32 = new Int32Array(buffer, base, HDR / 4);   // for notify
+        this.size = this.u32[2];
+        this.data = new Uint8Array(buffer, base + HDR, this.size);
+        this.end = base + HDR + this.size;
+    }
+}
+
+// Reads and writes the rings of a chardev
+export class SabringChardev {
+    constructor(buffer, base) {
+        this.out = new ByteRing(buffer, base);
+        this.in = new ByteRing(buffer, this.out.end);
+    }
+
+    // Takes the output the guest wrote so far, null if there is none
+    read() {
+        const out = this.out;
+        const head = Atomics.load(out.u32, 0);
+        const tail = Atomics.load(out.u32, 1);
+        const len = (head - tail) >>> 0;
+        if (!len) {
+            return null;
+        }
+        const chunk = new Uint8Array(len);
+        const off = tail & (out.size - 1);
+        const first = Math.min(len, out.size - off);
+        chunk.set(out.data.subarray(off, off + first));
+        chunk.set(out.data.subarray(0, len - first), first);
+        Atomics.store(out.u32, 1, head);
+        return chunk;
+    }
+
+    // Queues input for the guest, returns how many bytes fit
+    write(bytes) {
+        const inp = this.in;
+        const head = Atomics.load(inp.u32, 0);
+        const tail = Atomics.load(inp.u32, 1);
+        const n = Math.min(bytes.length, inp.size - ((head - tail) >>> 0));
+        for (let i = 0; i < n; i++) {
+            inp.data[(head + i) & (inp.size - 1)] = bytes[i];
+        }
+        Atomics.store(inp.u32, 0, (head + n) >>> 0);
+        // QEMU only sleeps on an empty ring, see sabring_chr_bh()
+        if (n && Atomics.load(inp.u32, 1) === head) {
+            Atomics.notify(inp.i32, 0);
+        }
+        return n;
+    }
+}
+
+// Resolves to the SabringChardev of id once QEMU has created it
+export function openSabringChardev(Module, id) {
+    return new Promise((resolve) => {
+        const poll = () => {
+            const base = Module.calledRun &&
+                         Module.ccall('sabring_chr_lookup', 'number',
+                                      ['string'], [id]);
+            if (!base) {
+                setTimeout(poll, 100);
+                return;
+            }
+            resolve(new SabringChardev(Module.HEAPU8.buffer, base));
+        };
+        poll();
+    });
+}
+
+// Connects the chardev id to term, an xterm.js Terminal
+export async function attachSabringConsole(Module, id, term) {
+    const chr = await openSabringChardev(Module, id);
+    const encoder = new TextEncoder();
+    let pending = 0;
+
+    const tick = () => {
+        requestAnimationFrame(tick);
+        if (pending >= MAX_PENDING_WRITES) {
+            return;
+        }
+        const chunk = chr.read();
+        if (chunk) {
+            pending++;
+            term.write(chunk, () => pending--);
+        }
+    };
+    requestAnimationFrame(tick);
+
+    // the rest of a paste that doesn't fit is lost
+    term.onData((data) => chr.write(encoder.encode(data)));
+    term.onBinary((data) => chr.write(Uint8Array.from(data, (c) => c.charCodeAt(0))));
+}
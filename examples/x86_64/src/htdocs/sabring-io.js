@@ -0,0 +1,198 @@
+// I/O worker side of io/channel-sabring.c, e.g. for NBD disks served over
+// WebSocket:
+//
+//   -blockdev driver=nbd,node-name=disk0,server.type=inet,
+//             server.host=example.com,server.port=8080,export=disk0,
+//             websocket=on
+//
+// Run it in a dedicated worker, with the wasm memory (wasmMemory.buffer,
+// a SharedArrayBuffer) and the address Module._qio_channel_sabring_lookup()
+// returns posted by the page:
+//
+//   serveSabringIO(buffer, table, { url: (addr) => `wss://${addr}/nbd` });
+//
+// qemu-storage-daemon doesn't speak WebSocket itself, put a bridge such as
+// websockify in front of its "--export nbd" socket. Binary messages carry
+// the byte stream as is, their boundaries don't matter.
+//
+// The table is { u32 gen, nrSlots; u32 slots[nrSlots] } with the addresses
+// of the shared blocks of the channels. A block is { u32 state, qemuBell,
+// workerBell, orphan; char addr[256] } followed by the ring QEMU writes
+// and then the ring it reads, each { u32 head, tail, size, dropped,
+// user[4]; u8 data[size] } with free-running head/tail byte counters.
+
+const STATE_CONNECT = 1;
+const STATE_OPEN = 2;
+const STATE_EOF = 3;
+const STATE_CLOSE = 4;
+const STATE_DONE = 5;
+
+const ADDR_LEN = 256;
+const BLOCK_HDR = 16 + ADDR_LEN;
+const RING_HDR = 32;
+// stop draining QEMU's ring while the WebSocket has this much unsent
+const MAX_BUFFERED = 4 << 20;
+
+class Ring {
+    constructor(buffer, base) {
+        this.u32 = new Uint32Array(buffer, base, RING_HDR / 4);
+        this.size = this.u32[2];
+        this.data = new Uint8Array(buffer, base + RING_HDR, this.size);
+        this.end = base + RING_HDR + this.size;
+    }
+}
+
+function wait(i32, index, value, ms) {
+    if (Atomics.waitAsync) {
+        const r = Atomics.waitAsync(i32, index, value, ms);
+        return r.async ? r.value : Promise.resolve(r.value);
+    }
+    return new Promise((resolve) => setTimeout(resolve, Math.min(ms, 10)));
+}
+
+class Connection {
+    constructor(buffer, base, url) {
+        this.i32 = new Int32Array(buffer, base, 4);
+        const addr = new Uint8Array(buffer, base + 16, ADDR_LEN);
+        // TextDecoder doesn't take views of a SharedArrayBuffer
+        this.addr = new TextDecoder().decode(addr.slice(0, addr.indexOf(0)));
+        this.out = new Ring(buffer, base + BLOCK_HDR);
+        this.in = new Ring(buffer, this.out.end);
+        this.pending = [];      // received, not in the ring yet
+        this.done = false;
+
+        this.ws = new WebSocket(url(this.addr));
+        this.ws.binaryType = 'arraybuffer';
+        this.ws.onopen = () => {
+            if (Atomics.compareExchange(this.i32, 0, STATE_CONNECT,
+                                        STATE_OPEN) === STATE_CONNECT) {
+                this.ring();
+                this.pump();
+            } else {
+                // QEMU gave up waiting
+                this.ws.close();
+                this.finish();
+            }
+        };
+        this.ws.onmessage = (e) => {
+            this.pending.push(new Uint8Array(e.data));
+            this.fill();
+        };
+        this.ws.onclose = () => this.finish();
+        this.ws.onerror = () => this.finish();
+    }
+
+    ring() {
+        Atomics.add(this.i32, 2, 1);
+        Atomics.notify(this.i32, 2);
+    }
+
+    // Copies received data into QEMU's ring as far as it fits
+    fill() {
+        const r = this.in;
+        let head = Atomics.load(r.u32, 0);
+        const tail = Atomics.load(r.u32, 1);
+        let room = r.size - ((head - tail) >>> 0);
+        const start = head;
+
+        while (this.pending.length && room) {
+            const chunk = this.pending[0];
+            const n = Math.min(chunk.length, room);
+            const off = head & (r.size - 1);
+            const first = Math.min(n, r.size - off);
+            r.data.set(chunk.subarray(0, first), off);
+            r.data.set(chunk.subarray(first, n), 0);
+            head = (head + n) >>> 0;
+            room -= n;
+            if (n < chunk.length) {
+                this.pending[0] = chunk.subarray(n);
+            } else {
+                this.pending.shift();
+            }
+        }
+        if (head !== start) {
+            Atomics.store(r.u32, 0, head);
+            this.ring();
+        }
+    }
+
+    // Sends what QEMU wrote
+    drain() {
+        const r = this.out;
+        const head = Atomics.load(r.u32, 0);
+        const tail = Atomics.load(r.u32, 1);
+        const len = (head - tail) >>> 0;
+        if (!len || this.ws.bufferedAmount > MAX_BUFFERED) {
+            return;
+        }
+        // WebSocket.send() doesn't take views of a SharedArrayBuffer
+        const chunk = new Uint8Array(len);
+        const off = tail & (r.size - 1);
+        const first = Math.min(len, r.size - off);
+        chunk.set(r.data.subarray(off, off + first));
+        chunk.set(r.data.subarray(0, len - first), first);
+        this.ws.send(chunk);
+        Atomics.store(r.u32, 1, head);
+        this.ring();
+    }
+
+    // Follows QEMU's bell until one side closes
+    async pump() {
+        while (!this.done) {
+            const bell = Atomics.load(this.i32, 1);
+            if (Atomics.load(this.i32, 0) === STATE_CLOSE) {
+                this.ws.close();
+                this.finish();
+                return;
+            }
+            this.drain();
+            this.fill();
+            // short while the WebSocket holds back QEMU's data
+            const ms = this.ws.bufferedAmount > MAX_BUFFERED ? 5 : 1000;
+            await wait(this.i32, 1, bell, ms);
+        }
+    }
+
+    finish() {
+        if (this.done) {
+            return;
+        }
+        this.done = true;
+        for (;;) {
+            const state = Atomics.load(this.i32, 0);
+            const next = state === STATE_CLOSE ? STATE_DONE : STATE_EOF;
+            if (state === STATE_EOF || state === STATE_DONE ||
+                Atomics.compareExchange(this.i32, 0, state, next) === state) {
+                break;
+            }
+        }
+        this.ring();
+    }
+}
+
+export async function serveSabringIO(buffer, table, opts = {}) {
+    const url = opts.url || ((addr) => `ws://${addr}/`);
+    const i32 = new Int32Array(buffer, table, 2);
+    const nrSlots = i32[1];
+    const slots = new Uint32Array(buffer, table + 8, nrSlots);
+    const conns = new Map();
+
+    for (;;) {
+        const gen = Atomics.load(i32, 0);
+        for (let i = 0; i < nrSlots; i++) {
+            const base = Atomics.load(slots, i);
+            const conn = conns.get(base);
+            if (conn && conn.done) {
+                conns.delete(base);
+            }
+            if (!base || conns.has(base)) {
+                continue;
+            }
+            const state = new Int32Array(buffer, base, 1);
+            if (Atomics.load(state, 0) === STATE_CONNECT) {
+                conns.set(base, new Connection(buffer, base, url));
+            }
+        }
+        await wait(i32, 0, gen, 1000);
+    }
+}
@@ -0,0 +1,139 @@
+// QMP client for a monitor on "-chardev sabring" (chardev/char-sabring.c):
+//
+//   Module['arguments'] = [... '-chardev', 'sabring,id=qmp0',
+//                          '-mon', 'chardev=qmp0,mode=control' ...];
+//   const qmp = await openSabringQmp(Module, 'qmp0');
+//   const status = await qmp.execute('query-status');
+//   qmp.onEvent = (ev) => console.log(ev.event, ev.data);
+//
+// Commands and replies go through the rings of the chardev in the wasm
+// memory, not through a socket or stdio, so nothing is proxied to the
+// main thread and no fd is involved. Replies are awaited with
+// Atomics.waitAsync on the head of the output ring, which QEMU notifies
+// on every write, so that polling query-stats many times a second
+// costs little more than the commands themselves.
+//
+// The client also works in a worker, given the wasm memory and the
+// address Module._sabring_chr_lookup() returns:
+//
+//   const qmp = new SabringQmp(new SabringChardev(buffer, base));
+//   await qmp.ready;
+
+import { SabringChardev, openSabringChardev } from './sabring-console.js';
+
+// poll interval where Atomics.waitAsync is missing
+const POLL_MS = 10;
+
+export class SabringQmp {
+    constructor(chr) {
+        this.chr = chr;
+        this.decoder = new TextDecoder();
+        this.encoder = new TextEncoder();
+        this.text = '';
+        this.nextId = 1;
+        this.pending = new Map();   // id => { resolve, reject }
+        this.queued = [];           // encoded commands that didn't fit yet
+        this.onEvent = null;
+        this.closed = false;
+        this.ready = new Promise((resolve, reject) => {
+            this.greeted = () => {
+                this.execute('qmp_capabilities').then(resolve, reject);
+            };
+        });
+        this.pump();
+    }
+
+    // Resolves to the "return" of the command, rejects with its "error"
+    execute(command, args) {
+        const id = this.nextId++;
+        const msg = { execute: command, id: id };
+        if (args !== undefined) {
+            msg.arguments = args;
+        }
+        return new Promise((resolve, reject) => {
+            this.pending.set(id, { resolve, reject });
+            this.queued.push(this.encoder.encode(JSON.stringify(msg) + '\n'));
+            this.flush();
+        });
+    }
+
+    close() {
+        this.closed = true;
+    }
+
+    flush() {
+        while (this.queued.length) {
+            const bytes = this.queued[0];
+            const n = this.chr.write(bytes);
+            if (n < bytes.length) {
+                // the rest goes once QEMU made room, see pump()
+                this.queued[0] = bytes.subarray(n);
+                return;
+            }
+            this.queued.shift();
+        }
+    }
+
+    dispatch(msg) {
+        if ('QMP' in msg) {
+            this.greeted();
+        } else if ('event' in msg) {
+            if (this.onEvent) {
+                this.onEvent(msg);
+            }
+        } else if (this.pending.has(msg.id)) {
+            const p = this.pending.get(msg.id);
+            this.pending.delete(msg.id);
+            if ('error' in msg) {
+                p.reject(new Error(`${msg.error.class}: ${msg.error.desc}`));
+            } else {
+                p.resolve(msg.return);
+            }
+        }
+    }
+
+    // QMP sends one JSON object per line
+    receive(chunk) {
+        this.text += this.decoder.decode(chunk, { stream: true });
+        let nl;
+        while ((nl = this.text.indexOf('\n')) >= 0) {
+            const line = this.text.slice(0, nl).trim();
+            this.text = this.text.slice(nl + 1);
+            if (line) {
+                this.dispatch(JSON.parse(line));
+            }
+        }
+    }
+
+    async pump() {
+        const head = this.chr.out.i32;
+        while (!this.closed) {
+            const seen = Atomics.load(head, 0);
+            const chunk = this.chr.read();
+            if (chunk) {
+                this.receive(chunk);
+                this.flush();
+                continue;
+            }
+            if (this.queued.length || !Atomics.waitAsync) {
+                await new Promise((resolve) => setTimeout(resolve, POLL_MS));
+                this.flush();
+                continue;
+            }
+            const r = Atomics.waitAsync(head, 0, seen);
+            if (r.async) {
+                await r.value;
+            }
+        }
+    }
+}
+
+// Resolves to a SabringQmp for the monitor on chardev id once QEMU
+// accepted qmp_capabilities
+export async function openSabringQmp(Module, id) {
+    const qmp = new SabringQmp(await openSabringChardev(Module, id));
+    await qmp.ready;
+    return qmp;
+}
+
+export { SabringChardev };
@@ -269,6 +269,40 @@ SRST
     Show dynamic compiler info.
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "jit-profile",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show the sampled per-TB profile of the wasm32 tiers",
+    },
+#endif
+
+SRST
+  ``info jit-profile``
+    Show the TBs the guest spends the most time in, sampled per tier
+    (wasm32 hosts only). The full profile is exported to the page as
+    JSON by ``wasm32_profile_json()``.
+ERST
+
+#if defined(CONFIG_TCG)
+    {
+        .name       = "syscall-offload",
+        .args_type  = "reset:-r",
+        .params     = "[-r]",
+        .help       = "show the guest syscalls served from SABFS "
+                      "(-r: reset the counters afterwards)",
+    },
+#endif
+
+SRST
+  ``info syscall-offload [-r]``
+    Show per syscall how many calls of guest user mode SABFS served, how
+    many of them failed, how many it handed to the guest kernel after all,
+    the bytes read or written and the time spent on them (wasm32 hosts
+    only). With ``-r``, the counters are reset afterwards.
+ERST
+
 #if defined(CONFIG_TCG)
     {
         .name       = "opcount",
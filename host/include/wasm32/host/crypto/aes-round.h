@@ -0,0 +1,217 @@
+/*
+ * wasm32 specific aes acceleration.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef WASM32_HOST_CRYPTO_AES_ROUND_H
+#define WASM32_HOST_CRYPTO_AES_ROUND_H
+
+#ifndef __wasm_simd128__
+#include "host/include/generic/host/crypto/aes-round.h"
+#else
+
+#include <wasm_simd128.h>
+#include "crypto/aes.h"
+
+/*
+ * Always on in a -msimd128 build, as on x86 built with -maes.  There
+ * are no AES instructions, but i8x16.swizzle looks up 16 bytes at once
+ * in a 16-byte table, and yields 0 for indices past it.  SubBytes
+ * is done with the sixteen 16-byte slices of the S-box, all other steps
+ * are byte shuffles and GF(2^8) doublings.
+ */
+#define HAVE_AES_ACCEL  true
+#define ATTR_AES_ACCEL
+
+static inline v128_t aes_accel_bswap(v128_t x)
+{
+    return wasm_i8x16_shuffle(x, x, 15, 14, 13, 12, 11, 10, 9, 8,
+                              7, 6, 5, 4, 3, 2, 1, 0);
+}
+
+static inline v128_t aes_accel_sub_bytes(v128_t x, const uint8_t *sbox)
+{
+    v128_t r = wasm_i8x16_swizzle(wasm_v128_load(sbox), x);
+    v128_t sixteen = wasm_i8x16_splat(16);
+
+    for (int i = 1; i < 16; i++) {
+        x = wasm_i8x16_sub(x, sixteen);
+        r = wasm_v128_or(r, wasm_i8x16_swizzle(wasm_v128_load(sbox + i * 16),
+                                               x));
+    }
+    return r;
+}
+
+static inline v128_t aes_accel_shift_rows(v128_t x)
+{
+    /* byte i comes from byte AES_SH(i) */
+    return wasm_i8x16_shuffle(x, x, 0, 5, 10, 15, 4, 9, 14, 3,
+                              8, 13, 2, 7, 12, 1, 6, 11);
+}
+
+static inline v128_t aes_accel_inv_shift_rows(v128_t x)
+{
+    /* byte i comes from byte AES_ISH(i) */
+    return wasm_i8x16_shuffle(x, x, 0, 13, 10, 7, 4, 1, 14, 11,
+                              8, 5, 2, 15, 12, 9, 6, 3);
+}
+
+/* Multiply each byte by x in GF(2^8) */
+static inline v128_t aes_accel_xtime(v128_t x)
+{
+    v128_t carry = wasm_i8x16_lt(x, wasm_i8x16_splat(0));
+
+    return wasm_v128_xor(wasm_i8x16_shl(x, 1),
+                         wasm_v128_and(carry, wasm_i8x16_splat(0x1b)));
+}
+
+/* Rotate the bytes of each column (32-bit lane) down by one row */
+static inline v128_t aes_accel_rot1(v128_t x)
+{
+    return wasm_i8x16_shuffle(x, x, 1, 2, 3, 0, 5, 6, 7, 4,
+                              9, 10, 11, 8, 13, 14, 15, 12);
+}
+
+static inline v128_t aes_accel_rot2(v128_t x)
+{
+    return wasm_i8x16_shuffle(x, x, 2, 3, 0, 1, 6, 7, 4, 5,
+                              10, 11, 8, 9, 14, 15, 12, 13);
+}
+
+static inline v128_t aes_accel_mix_columns(v128_t x)
+{
+    /* 2 * a[r] + 3 * a[r + 1] + a[r + 2] + a[r + 3] */
+    v128_t r1 = aes_accel_rot1(x);
+    v128_t r2 = aes_accel_rot2(x);
+    v128_t r3 = aes_accel_rot1(r2);
+
+    return wasm_v128_xor(wasm_v128_xor(aes_accel_xtime(wasm_v128_xor(x, r1)),
+                                       r1),
+                         wasm_v128_xor(r2, r3));
+}
+
+static inline v128_t aes_accel_inv_mix_columns(v128_t x)
+{
+    /*
+     * InvMixColumns is MixColumns of 5 * a[r] + 4 * a[r + 2], see
+     * "The Design of Rijndael", section 4.1.3.
+     */
+    v128_t t = aes_accel_xtime(aes_accel_xtime(wasm_v128_xor(x,
+                                                  aes_accel_rot2(x))));
+
+    return aes_accel_mix_columns(wasm_v128_xor(x, t));
+}
+
+static inline void ATTR_AES_ACCEL
+aesenc_MC_accel(AESState *ret, const AESState *st, bool be)
+{
+    v128_t t = wasm_v128_load(st);
+
+    if (be) {
+        t = aes_accel_bswap(aes_accel_mix_columns(aes_accel_bswap(t)));
+    } else {
+        t = aes_accel_mix_columns(t);
+    }
+    wasm_v128_store(ret, t);
+}
+
+static inline void ATTR_AES_ACCEL
+aesenc_SB_SR_AK_accel(AESState *ret, const AESState *st,
+                      const AESState *rk, bool be)
+{
+    v128_t t = wasm_v128_load(st);
+
+    if (be) {
+        t = aes_accel_bswap(t);
+    }
+    t = aes_accel_shift_rows(aes_accel_sub_bytes(t, AES_sbox));
+    if (be) {
+        t = aes_accel_bswap(t);
+    }
+    wasm_v128_store(ret, wasm_v128_xor(t, wasm_v128_load(rk)));
+}
+
+static inline void ATTR_AES_ACCEL
+aesenc_SB_SR_MC_AK_accel(AESState *ret, const AESState *st,
+                         const AESState *rk, bool be)
+{
+    v128_t t = wasm_v128_load(st);
+
+    if (be) {
+        t = aes_accel_bswap(t);
+    }
+    t = aes_accel_shift_rows(aes_accel_sub_bytes(t, AES_sbox));
+    t = aes_accel_mix_columns(t);
+    if (be) {
+        t = aes_accel_bswap(t);
+    }
+    wasm_v128_store(ret, wasm_v128_xor(t, wasm_v128_load(rk)));
+}
+
+static inline void ATTR_AES_ACCEL
+aesdec_IMC_accel(AESState *ret, const AESState *st, bool be)
+{
+    v128_t t = wasm_v128_load(st);
+
+    if (be) {
+        t = aes_accel_bswap(aes_accel_inv_mix_columns(aes_accel_bswap(t)));
+    } else {
+        t = aes_accel_inv_mix_columns(t);
+    }
+    wasm_v128_store(ret, t);
+}
+
+static inline void ATTR_AES_ACCEL
+aesdec_ISB_ISR_AK_accel(AESState *ret, const AESState *st,
+                        const AESState *rk, bool be)
+{
+    v128_t t = wasm_v128_load(st);
+
+    if (be) {
+        t = aes_accel_bswap(t);
+    }
+    t = aes_accel_inv_shift_rows(aes_accel_sub_bytes(t, AES_isbox));
+    if (be) {
+        t = aes_accel_bswap(t);
+    }
+    wasm_v128_store(ret, wasm_v128_xor(t, wasm_v128_load(rk)));
+}
+
+static inline void ATTR_AES_ACCEL
+aesdec_ISB_ISR_AK_IMC_accel(AESState *ret, const AESState *st,
+                            const AESState *rk, bool be)
+{
+    v128_t t = wasm_v128_load(st);
+    v128_t k = wasm_v128_load(rk);
+
+    if (be) {
+        t = aes_accel_bswap(t);
+        k = aes_accel_bswap(k);
+    }
+    t = aes_accel_inv_shift_rows(aes_accel_sub_bytes(t, AES_isbox));
+    t = aes_accel_inv_mix_columns(wasm_v128_xor(t, k));
+    if (be) {
+        t = aes_accel_bswap(t);
+    }
+    wasm_v128_store(ret, t);
+}
+
+static inline void ATTR_AES_ACCEL
+aesdec_ISB_ISR_IMC_AK_accel(AESState *ret, const AESState *st,
+                            const AESState *rk, bool be)
+{
+    v128_t t = wasm_v128_load(st);
+
+    if (be) {
+        t = aes_accel_bswap(t);
+    }
+    t = aes_accel_inv_shift_rows(aes_accel_sub_bytes(t, AES_isbox));
+    t = aes_accel_inv_mix_columns(t);
+    if (be) {
+        t = aes_accel_bswap(t);
+    }
+    wasm_v128_store(ret, wasm_v128_xor(t, wasm_v128_load(rk)));
+}
+
+#endif /* __wasm_simd128__ */
+#endif /* WASM32_HOST_CRYPTO_AES_ROUND_H */
@@ -0,0 +1,54 @@
+/*
+ * wasm32 specific clmul acceleration.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef WASM32_HOST_CRYPTO_CLMUL_H
+#define WASM32_HOST_CRYPTO_CLMUL_H
+
+#ifndef __wasm_simd128__
+#include "host/include/generic/host/crypto/clmul.h"
+#else
+
+#include <wasm_simd128.h>
+
+/*
+ * There is no carry-less multiply in SIMD128.  Instead of a shift and
+ * xor per bit of @n, look up the products of @m with each nibble of @n
+ * in a table of 16 and accumulate them, 128 bits at a time.
+ */
+#define HAVE_CLMUL_ACCEL  true
+#define ATTR_CLMUL_ACCEL
+
+/* Shift the 128-bit value @x left by @s, 0 < @s < 64 */
+static inline v128_t clmul_accel_shl(v128_t x, int s)
+{
+    v128_t carry = wasm_u64x2_shr(x, 64 - s);
+
+    return wasm_v128_or(wasm_i64x2_shl(x, s),
+                        wasm_i64x2_shuffle(wasm_i64x2_splat(0), carry, 0, 2));
+}
+
+static inline Int128 ATTR_CLMUL_ACCEL
+clmul_64_accel(uint64_t n, uint64_t m)
+{
+    v128_t t[16], r;
+    int i;
+
+    t[0] = wasm_i64x2_splat(0);
+    t[1] = wasm_i64x2_make(m, 0);
+    for (i = 2; i < 16; i += 2) {
+        t[i] = clmul_accel_shl(t[i / 2], 1);
+        t[i + 1] = wasm_v128_xor(t[i], t[1]);
+    }
+
+    r = t[n >> 60];
+    for (i = 56; i >= 0; i -= 4) {
+        r = wasm_v128_xor(clmul_accel_shl(r, 4), t[(n >> i) & 15]);
+    }
+    return int128_make128(wasm_i64x2_extract_lane(r, 0),
+                          wasm_i64x2_extract_lane(r, 1));
+}
+
+#endif /* __wasm_simd128__ */
+#endif /* WASM32_HOST_CRYPTO_CLMUL_H */
@@ -1,9 +1,13 @@
 /*
  * 9p SABFS backend - SharedArrayBuffer Filesystem
  *
- * This backend serves files from JavaScript's SABFS instead of the host
- * filesystem. All operations are synchronous memory accesses without
- * syscall proxying overhead.
+ * This backend serves files from SABFS instead of the host filesystem.
+ * Lookups, stat, open, I/O and readdir use the C implementation on the
+ * wasm memory (sabfs_qemu.c) without crossing into JS; open fids keep
+ * their SABFS fd or directory inode, so they are never resolved again.
+ * Reads go through the shared block map cache (sabfs_cache.c), which
+ * executables opened for reading are preloaded into for execve.
+ * The remaining namespace operations go to the JS SABFS object.
  *
  * For Emscripten/browser builds only.
  */
@@ -14,102 +18,16 @@
 #include "9p.h"
 #include "9p-local.h"
 #include "qapi/error.h"
+#include "qemu/stats64.h"
+#include "qemu/timer.h"
+#include "sabfs/sabfs_cache.h"
+#include "sabfs/sabfs_qemu.h"
 #include <emscripten.h>
 #include <errno.h>
 #include <string.h>
 
 /* ========== JavaScript SABFS bindings ========== */
 
-EM_JS(int, sabfs_be_js_stat, (const char *path,
-                           uint32_t *mode, uint32_t *nlink,
-                           uint32_t *uid, uint32_t *gid,
-                           uint32_t *size_lo, uint32_t *size_hi,
-                           uint32_t *atime, uint32_t *mtime, uint32_t *ctime,
-                           uint32_t *ino, uint32_t *blocks), {
-    const SABFS = globalThis.SABFS;
-    if (!SABFS) return -1;
-    const pathStr = UTF8ToString(path);
-    const st = SABFS.stat(pathStr);
-    if (!st) return -1;
-
-    HEAPU32[mode >> 2] = st.mode;
-    HEAPU32[nlink >> 2] = st.nlink || 1;
-    HEAPU32[uid >> 2] = st.uid || 0;
-    HEAPU32[gid >> 2] = st.gid || 0;
-    HEAPU32[size_lo >> 2] = st.size & 0xFFFFFFFF;
-    HEAPU32[size_hi >> 2] = Math.floor(st.size / 0x100000000);
-    HEAPU32[atime >> 2] = st.atime || 0;
-    HEAPU32[mtime >> 2] = st.mtime || 0;
-    HEAPU32[ctime >> 2] = st.ctime || 0;
-    HEAPU32[ino >> 2] = st.ino;
-    HEAPU32[blocks >> 2] = st.blocks || 0;
-    return 0;
-});
-
-EM_JS(int, sabfs_be_js_lstat, (const char *path,
-                            uint32_t *mode, uint32_t *nlink,
-                            uint32_t *uid, uint32_t *gid,
-                            uint32_t *size_lo, uint32_t *size_hi,
-                            uint32_t *atime, uint32_t *mtime, uint32_t *ctime,
-                            uint32_t *ino, uint32_t *blocks), {
-    const SABFS = globalThis.SABFS;
-    if (!SABFS) return -1;
-    const pathStr = UTF8ToString(path);
-    const st = SABFS.lstat ? SABFS.lstat(pathStr) : SABFS.stat(pathStr);
-    if (!st) return -1;
-
-    HEAPU32[mode >> 2] = st.mode;
-    HEAPU32[nlink >> 2] = st.nlink || 1;
-    HEAPU32[uid >> 2] = st.uid || 0;
-    HEAPU32[gid >> 2] = st.gid || 0;
-    HEAPU32[size_lo >> 2] = st.size & 0xFFFFFFFF;
-    HEAPU32[size_hi >> 2] = Math.floor(st.size / 0x100000000);
-    HEAPU32[atime >> 2] = st.atime || 0;
-    HEAPU32[mtime >> 2] = st.mtime || 0;
-    HEAPU32[ctime >> 2] = st.ctime || 0;
-    HEAPU32[ino >> 2] = st.ino;
-    HEAPU32[blocks >> 2] = st.blocks || 0;
-    return 0;
-});
-
-EM_JS(int, sabfs_be_js_open, (const char *path, int flags, int mode), {
-    const SABFS = globalThis.SABFS;
-    if (!SABFS) return -1;
-    const pathStr = UTF8ToString(path);
-    return SABFS.open(pathStr, flags, mode);
-});
-
-EM_JS(int, sabfs_be_js_close, (int fd), {
-    const SABFS = globalThis.SABFS;
-    if (!SABFS) return -1;
-    return SABFS.close(fd);
-});
-
-EM_JS(ssize_t, sabfs_be_js_pread, (int fd, void *buf, size_t count, double offset), {
-    const SABFS = globalThis.SABFS;
-    if (!SABFS) return -1;
-    const buffer = new Uint8Array(count);
-    const ret = SABFS.pread(fd, buffer, count, offset);
-    if (ret > 0) {
-        HEAPU8.set(buffer.subarray(0, ret), buf);
-    }
-    return ret;
-});
-
-EM_JS(ssize_t, sabfs_be_js_pwrite, (int fd, const void *buf, size_t count, double offset), {
-    const SABFS = globalThis.SABFS;
-    if (!SABFS) return -1;
-    const buffer = new Uint8Array(HEAPU8.buffer, buf, count);
-    return SABFS.pwrite(fd, buffer, count, offset);
-});
-
-EM_JS(int, sabfs_be_js_mkdir, (const char *path, int mode), {
-    const SABFS = globalThis.SABFS;
-    if (!SABFS) return -1;
-    const pathStr = UTF8ToString(path);
-    return SABFS.mkdir(pathStr, mode);
-});
-
 EM_JS(int, sabfs_be_js_rmdir, (const char *path), {
     const SABFS = globalThis.SABFS;
     if (!SABFS) return -1;
@@ -149,7 +67,7 @@ EM_JS(int, sabfs_be_js_readlink, (const char *path, char *buf, size_t bufsiz), {
 
     const bytes = new TextEncoder().encode(target);
     const len = Math.min(bytes.length, bufsiz);
-    HEAPU8.set(bytes.subarray(0, len), buf);
+    HEAPU8.set(bytes.subarray(0, len), buf >>> 0);
     return len;
 });
 
@@ -189,32 +107,6 @@ EM_JS(int, sabfs_be_js_utimes, (const char *path, double atime, double mtime), {
     return SABFS.utimes(pathStr, atime, mtime);
 });
 
-/* Directory reading - returns JSON array of entries */
-EM_JS(int, sabfs_be_js_readdir_count, (const char *path), {
-    const SABFS = globalThis.SABFS;
-    if (!SABFS) return -1;
-    const pathStr = UTF8ToString(path);
-    const entries = SABFS.readdir(pathStr);
-    if (!entries) return -1;
-    // Store entries for subsequent calls
-    globalThis._sabfs_readdir_entries = entries;
-    return entries.length;
-});
-
-EM_JS(int, sabfs_be_js_readdir_entry, (int idx, char *name, size_t name_size, uint32_t *ino, uint32_t *type), {
-    const entries = globalThis._sabfs_readdir_entries;
-    if (!entries || idx >= entries.length) return -1;
-
-    const entry = entries[idx];
-    const nameBytes = new TextEncoder().encode(entry.name);
-    const len = Math.min(nameBytes.length, name_size - 1);
-    HEAPU8.set(nameBytes.subarray(0, len), name);
-    HEAPU8[name + len] = 0;
-    HEAPU32[ino >> 2] = entry.ino;
-    HEAPU32[type >> 2] = entry.type || 0;
-    return 0;
-});
-
 EM_JS(int, sabfs_be_js_statfs, (uint32_t *bsize, uint32_t *blocks, uint32_t *bfree,
                              uint32_t *files, uint32_t *ffree), {
     const SABFS = globalThis.SABFS;
@@ -222,77 +114,69 @@ EM_JS(int, sabfs_be_js_statfs, (uint32_t *bsize, uint32_t *blocks, uint32_t *bfr
     const st = SABFS.statfs();
     if (!st) return -1;
 
-    HEAPU32[bsize >> 2] = st.bsize || 4096;
-    HEAPU32[blocks >> 2] = st.blocks || 0;
-    HEAPU32[bfree >> 2] = st.bfree || 0;
-    HEAPU32[files >> 2] = st.files || 0;
-    HEAPU32[ffree >> 2] = st.ffree || 0;
+    HEAPU32[bsize >>> 2] = st.bsize || 4096;
+    HEAPU32[blocks >>> 2] = st.blocks || 0;
+    HEAPU32[bfree >>> 2] = st.bfree || 0;
+    HEAPU32[files >>> 2] = st.files || 0;
+    HEAPU32[ffree >>> 2] = st.ffree || 0;
     return 0;
 });
 
-EM_JS(int, sabfs_be_js_is_available, (void), {
-    const SABFS = globalThis.SABFS;
-    return (SABFS && SABFS.stat) ? 1 : 0;
-});
-
 /* ========== 9p Backend Implementation ========== */
 
 typedef struct SabfsFileState {
     int fd;
-    char path[PATH_MAX];
+    uint64_t ino;
 } SabfsFileState;
 
+/* The entries are read in one go at opendir and rewinddir */
 typedef struct SabfsDirState {
-    char path[PATH_MAX];
+    uint64_t ino;
+    sabfs_dirent_t *entries;
     int count;
     int pos;
+    struct dirent dirent;
 } SabfsDirState;
 
-static int sabfs_init(FsContext *ctx, Error **errp)
+static void sabfs_be_fill_stat(const sabfs_stat_t *st, struct stat *stbuf)
+{
+    memset(stbuf, 0, sizeof(*stbuf));
+    stbuf->st_mode = st->mode;
+    stbuf->st_nlink = 1;
+    stbuf->st_size = st->size;
+    stbuf->st_ino = st->ino;
+    stbuf->st_blocks = st->blocks * (4096 / 512);
+    stbuf->st_blksize = 4096;
+}
+
+static int sabfs_be_init(FsContext *ctx, Error **errp)
 {
-    if (!sabfs_be_js_is_available()) {
+    if (sabfs_attach() < 0) {
         error_setg(errp, "SABFS not available");
         return -1;
     }
     return 0;
 }
 
-static void sabfs_cleanup(FsContext *ctx)
+static void sabfs_be_cleanup(FsContext *ctx)
 {
     /* Nothing to clean up */
 }
 
-static int sabfs_lstat(FsContext *ctx, V9fsPath *fs_path, struct stat *stbuf)
+static int sabfs_be_lstat(FsContext *ctx, V9fsPath *fs_path, struct stat *stbuf)
 {
-    uint32_t mode, nlink, uid, gid, size_lo, size_hi;
-    uint32_t atime, mtime, ctime, ino, blocks;
+    sabfs_stat_t st;
 
-    int ret = sabfs_be_js_lstat(fs_path->data, &mode, &nlink, &uid, &gid,
-                              &size_lo, &size_hi, &atime, &mtime, &ctime,
-                              &ino, &blocks);
-    if (ret < 0) {
+    if (sabfs_stat(fs_path->data, &st) < 0) {
         errno = ENOENT;
         return -1;
     }
-
-    memset(stbuf, 0, sizeof(*stbuf));
-    stbuf->st_mode = mode;
-    stbuf->st_nlink = nlink;
-    stbuf->st_uid = uid;
-    stbuf->st_gid = gid;
-    stbuf->st_size = size_lo + ((uint64_t)size_hi << 32);
-    stbuf->st_atime = atime;
-    stbuf->st_mtime = mtime;
-    stbuf->st_ctime = ctime;
-    stbuf->st_ino = ino;
-    stbuf->st_blocks = blocks;
-    stbuf->st_blksize = 4096;
-
+    sabfs_be_fill_stat(&st, stbuf);
     return 0;
 }
 
-static ssize_t sabfs_readlink(FsContext *ctx, V9fsPath *fs_path,
-                              char *buf, size_t bufsz)
+static ssize_t sabfs_be_readlink(FsContext *ctx, V9fsPath *fs_path,
+                                 char *buf, size_t bufsz)
 {
     int ret = sabfs_be_js_readlink(fs_path->data, buf, bufsz);
     if (ret < 0) {
@@ -302,101 +186,113 @@ static ssize_t sabfs_readlink(FsContext *ctx, V9fsPath *fs_path,
     return ret;
 }
 
-static int sabfs_close(FsContext *ctx, V9fsFidOpenState *fs)
+static int sabfs_be_close(FsContext *ctx, V9fsFidOpenState *fs)
 {
     SabfsFileState *state = (SabfsFileState *)fs->private;
     if (state) {
-        sabfs_be_js_close(state->fd);
+        sabfs_close(state->fd);
         g_free(state);
         fs->private = NULL;
     }
     return 0;
 }
 
-static int sabfs_closedir(FsContext *ctx, V9fsFidOpenState *fs)
+static int sabfs_be_closedir(FsContext *ctx, V9fsFidOpenState *fs)
 {
     SabfsDirState *state = (SabfsDirState *)fs->private;
     if (state) {
+        sabfs_free_dirents(state->entries);
         g_free(state);
         fs->private = NULL;
     }
     return 0;
 }
 
-static int sabfs_open(FsContext *ctx, V9fsPath *fs_path,
-                      int flags, V9fsFidOpenState *fs)
+static SabfsFileState *sabfs_be_file_state(int fd, sabfs_stat_t *st)
+{
+    SabfsFileState *state = g_new0(SabfsFileState, 1);
+
+    sabfs_fstat(fd, st);
+    state->fd = fd;
+    state->ino = st->ino;
+    return state;
+}
+
+static int sabfs_be_open(FsContext *ctx, V9fsPath *fs_path,
+                         int flags, V9fsFidOpenState *fs)
 {
-    int fd = sabfs_be_js_open(fs_path->data, flags, 0);
+    sabfs_stat_t st;
+    int fd = sabfs_open(fs_path->data, flags, 0);
     if (fd < 0) {
         errno = ENOENT;
         return -1;
     }
 
-    SabfsFileState *state = g_new0(SabfsFileState, 1);
-    state->fd = fd;
-    strncpy(state->path, fs_path->data, sizeof(state->path) - 1);
-    fs->private = state;
+    fs->private = sabfs_be_file_state(fd, &st);
+    /* The kernel reads an executable in full at execve, map it up front */
+    if ((flags & O_ACCMODE) == O_RDONLY && st.is_file && (st.mode & 0111)) {
+        sabfs_cache_preload(st.ino);
+    }
 
     return 0;
 }
 
-static int sabfs_opendir(FsContext *ctx, V9fsPath *fs_path,
-                         V9fsFidOpenState *fs)
+static int sabfs_be_opendir(FsContext *ctx, V9fsPath *fs_path,
+                            V9fsFidOpenState *fs)
 {
-    int count = sabfs_be_js_readdir_count(fs_path->data);
-    if (count < 0) {
+    sabfs_stat_t st;
+
+    if (sabfs_stat(fs_path->data, &st) < 0 || !st.is_directory) {
         errno = ENOENT;
         return -1;
     }
 
     SabfsDirState *state = g_new0(SabfsDirState, 1);
-    strncpy(state->path, fs_path->data, sizeof(state->path) - 1);
-    state->count = count;
+    state->ino = st.ino;
+    state->count = sabfs_readdir_ino(st.ino, &state->entries);
     state->pos = 0;
     fs->private = state;
 
     return 0;
 }
 
-static void sabfs_rewinddir(FsContext *ctx, V9fsFidOpenState *fs)
+static void sabfs_be_rewinddir(FsContext *ctx, V9fsFidOpenState *fs)
 {
     SabfsDirState *state = (SabfsDirState *)fs->private;
     if (state) {
         state->pos = 0;
         /* Refresh entries */
-        state->count = sabfs_be_js_readdir_count(state->path);
+        sabfs_free_dirents(state->entries);
+        state->count = sabfs_readdir_ino(state->ino, &state->entries);
     }
 }
 
-static off_t sabfs_telldir(FsContext *ctx, V9fsFidOpenState *fs)
+static off_t sabfs_be_telldir(FsContext *ctx, V9fsFidOpenState *fs)
 {
     SabfsDirState *state = (SabfsDirState *)fs->private;
     return state ? state->pos : 0;
 }
 
-static struct dirent *sabfs_readdir(FsContext *ctx, V9fsFidOpenState *fs)
+static struct dirent *sabfs_be_readdir(FsContext *ctx, V9fsFidOpenState *fs)
 {
-    static struct dirent entry;
     SabfsDirState *state = (SabfsDirState *)fs->private;
+    struct dirent *entry;
 
-    if (!state || state->pos >= state->count) {
-        return NULL;
-    }
-
-    uint32_t ino, type;
-    if (sabfs_be_js_readdir_entry(state->pos, entry.d_name, sizeof(entry.d_name),
-                                &ino, &type) < 0) {
+    if (!state || state->pos < 0 || state->pos >= state->count) {
         return NULL;
     }
 
-    entry.d_ino = ino;
-    entry.d_type = type;
-    state->pos++;
+    entry = &state->dirent;
+    pstrcpy(entry->d_name, sizeof(entry->d_name),
+            state->entries[state->pos].name);
+    entry->d_ino = state->entries[state->pos].ino;
+    entry->d_type = state->entries[state->pos].type;
+    entry->d_off = ++state->pos;
 
-    return &entry;
+    return entry;
 }
 
-static void sabfs_seekdir(FsContext *ctx, V9fsFidOpenState *fs, off_t off)
+static void sabfs_be_seekdir(FsContext *ctx, V9fsFidOpenState *fs, off_t off)
 {
     SabfsDirState *state = (SabfsDirState *)fs->private;
     if (state) {
@@ -404,8 +300,9 @@ static void sabfs_seekdir(FsContext *ctx, V9fsFidOpenState *fs, off_t off)
     }
 }
 
-static ssize_t sabfs_preadv(FsContext *ctx, V9fsFidOpenState *fs,
-                            const struct iovec *iov, int iovcnt, off_t offset)
+static ssize_t sabfs_be_preadv(FsContext *ctx, V9fsFidOpenState *fs,
+                               const struct iovec *iov, int iovcnt,
+                               off_t offset)
 {
     SabfsFileState *state = (SabfsFileState *)fs->private;
     if (!state) {
@@ -413,10 +310,15 @@ static ssize_t sabfs_preadv(FsContext *ctx, V9fsFidOpenState *fs,
         return -1;
     }
 
-    ssize_t total = 0;
+    ssize_t total = sabfs_cache_preadv(state->ino, iov, iovcnt, offset);
+    if (total >= 0) {
+        return total;
+    }
+
+    total = 0;
     for (int i = 0; i < iovcnt; i++) {
-        ssize_t ret = sabfs_be_js_pread(state->fd, iov[i].iov_base,
-                                      iov[i].iov_len, offset + total);
+        ssize_t ret = sabfs_pread(state->fd, iov[i].iov_base,
+                                  iov[i].iov_len, offset + total);
         if (ret < 0) {
             if (total == 0) return -1;
             break;
@@ -429,8 +331,9 @@ static ssize_t sabfs_preadv(FsContext *ctx, V9fsFidOpenState *fs,
     return total;
 }
 
-static ssize_t sabfs_pwritev(FsContext *ctx, V9fsFidOpenState *fs,
-                             const struct iovec *iov, int iovcnt, off_t offset)
+static ssize_t sabfs_be_pwritev(FsContext *ctx, V9fsFidOpenState *fs,
+                                const struct iovec *iov, int iovcnt,
+                                off_t offset)
 {
     SabfsFileState *state = (SabfsFileState *)fs->private;
     if (!state) {
@@ -440,8 +343,8 @@ static ssize_t sabfs_pwritev(FsContext *ctx, V9fsFidOpenState *fs,
 
     ssize_t total = 0;
     for (int i = 0; i < iovcnt; i++) {
-        ssize_t ret = sabfs_be_js_pwrite(state->fd, iov[i].iov_base,
-                                       iov[i].iov_len, offset + total);
+        ssize_t ret = sabfs_pwrite(state->fd, iov[i].iov_base,
+                                   iov[i].iov_len, offset + total);
         if (ret < 0) {
             if (total == 0) return -1;
             break;
@@ -453,173 +356,132 @@ static ssize_t sabfs_pwritev(FsContext *ctx, V9fsFidOpenState *fs,
     return total;
 }
 
-static int sabfs_chmod(FsContext *ctx, V9fsPath *fs_path, FsCred *credp)
+static int sabfs_be_chmod(FsContext *ctx, V9fsPath *fs_path, FsCred *credp)
 {
     return sabfs_be_js_chmod(fs_path->data, credp->fc_mode);
 }
 
-static int sabfs_mknod(FsContext *ctx, V9fsPath *fs_path, const char *name,
-                       FsCred *credp)
+static int sabfs_be_mknod(FsContext *ctx, V9fsPath *fs_path, const char *name,
+                          FsCred *credp)
 {
     /* SABFS doesn't support device nodes, create regular file instead */
     char path[PATH_MAX];
     snprintf(path, sizeof(path), "%s/%s", fs_path->data, name);
 
-    int fd = sabfs_be_js_open(path, 0x40 | 0x200, credp->fc_mode); /* O_CREAT | O_TRUNC */
+    int fd = sabfs_open(path, SABFS_O_CREAT | SABFS_O_TRUNC, credp->fc_mode);
     if (fd < 0) {
         errno = EPERM;
         return -1;
     }
-    sabfs_be_js_close(fd);
+    sabfs_close(fd);
     return 0;
 }
 
-static int sabfs_mkdir(FsContext *ctx, V9fsPath *fs_path, const char *name,
-                       FsCred *credp)
+static int sabfs_be_mkdir(FsContext *ctx, V9fsPath *fs_path, const char *name,
+                          FsCred *credp)
 {
     char path[PATH_MAX];
     snprintf(path, sizeof(path), "%s/%s", fs_path->data, name);
-    return sabfs_be_js_mkdir(path, credp->fc_mode);
+    return sabfs_mkdir(path, credp->fc_mode);
 }
 
-static int sabfs_fstat(FsContext *ctx, int fid_type,
-                       V9fsFidOpenState *fs, struct stat *stbuf)
+static int sabfs_be_fstat(FsContext *ctx, int fid_type,
+                          V9fsFidOpenState *fs, struct stat *stbuf)
 {
-    if (fid_type == P9_FID_DIR) {
-        SabfsDirState *state = (SabfsDirState *)fs->private;
-        if (!state) {
-            errno = EBADF;
-            return -1;
-        }
-        uint32_t mode, nlink, uid, gid, size_lo, size_hi;
-        uint32_t atime, mtime, ctime, ino, blocks;
-
-        if (sabfs_be_js_stat(state->path, &mode, &nlink, &uid, &gid,
-                          &size_lo, &size_hi, &atime, &mtime, &ctime,
-                          &ino, &blocks) < 0) {
-            errno = ENOENT;
-            return -1;
-        }
+    sabfs_stat_t st;
+    int ret;
 
-        memset(stbuf, 0, sizeof(*stbuf));
-        stbuf->st_mode = mode;
-        stbuf->st_nlink = nlink;
-        stbuf->st_uid = uid;
-        stbuf->st_gid = gid;
-        stbuf->st_size = size_lo + ((uint64_t)size_hi << 32);
-        stbuf->st_atime = atime;
-        stbuf->st_mtime = mtime;
-        stbuf->st_ctime = ctime;
-        stbuf->st_ino = ino;
-        stbuf->st_blocks = blocks;
-        stbuf->st_blksize = 4096;
-        return 0;
+    if (!fs->private) {
+        errno = EBADF;
+        return -1;
+    }
+    if (fid_type == P9_FID_DIR) {
+        ret = sabfs_stat_ino(((SabfsDirState *)fs->private)->ino, &st);
     } else {
-        SabfsFileState *state = (SabfsFileState *)fs->private;
-        if (!state) {
-            errno = EBADF;
-            return -1;
-        }
-        uint32_t mode, nlink, uid, gid, size_lo, size_hi;
-        uint32_t atime, mtime, ctime, ino, blocks;
-
-        if (sabfs_be_js_stat(state->path, &mode, &nlink, &uid, &gid,
-                          &size_lo, &size_hi, &atime, &mtime, &ctime,
-                          &ino, &blocks) < 0) {
-            errno = ENOENT;
-            return -1;
-        }
-
-        memset(stbuf, 0, sizeof(*stbuf));
-        stbuf->st_mode = mode;
-        stbuf->st_nlink = nlink;
-        stbuf->st_uid = uid;
-        stbuf->st_gid = gid;
-        stbuf->st_size = size_lo + ((uint64_t)size_hi << 32);
-        stbuf->st_atime = atime;
-        stbuf->st_mtime = mtime;
-        stbuf->st_ctime = ctime;
-        stbuf->st_ino = ino;
-        stbuf->st_blocks = blocks;
-        stbuf->st_blksize = 4096;
-        return 0;
+        ret = sabfs_fstat(((SabfsFileState *)fs->private)->fd, &st);
     }
+    if (ret < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    sabfs_be_fill_stat(&st, stbuf);
+    return 0;
 }
 
-static int sabfs_open2(FsContext *ctx, V9fsPath *fs_path, const char *name,
-                       int flags, FsCred *credp, V9fsFidOpenState *fs)
+static int sabfs_be_open2(FsContext *ctx, V9fsPath *fs_path, const char *name,
+                          int flags, FsCred *credp, V9fsFidOpenState *fs)
 {
     char path[PATH_MAX];
     snprintf(path, sizeof(path), "%s/%s", fs_path->data, name);
 
-    int fd = sabfs_be_js_open(path, flags | 0x40, credp->fc_mode); /* O_CREAT */
+    sabfs_stat_t st;
+    int fd = sabfs_open(path, flags | SABFS_O_CREAT, credp->fc_mode);
     if (fd < 0) {
         errno = ENOENT;
         return -1;
     }
 
-    SabfsFileState *state = g_new0(SabfsFileState, 1);
-    state->fd = fd;
-    strncpy(state->path, path, sizeof(state->path) - 1);
-    fs->private = state;
+    fs->private = sabfs_be_file_state(fd, &st);
 
     return 0;
 }
 
-static int sabfs_symlink(FsContext *ctx, const char *oldpath,
-                         V9fsPath *fs_path, const char *name, FsCred *credp)
+static int sabfs_be_symlink(FsContext *ctx, const char *oldpath,
+                            V9fsPath *fs_path, const char *name, FsCred *credp)
 {
     char path[PATH_MAX];
     snprintf(path, sizeof(path), "%s/%s", fs_path->data, name);
     return sabfs_be_js_symlink(oldpath, path);
 }
 
-static int sabfs_link(FsContext *ctx, V9fsPath *oldpath,
-                      V9fsPath *newpath, const char *name)
+static int sabfs_be_link(FsContext *ctx, V9fsPath *oldpath,
+                         V9fsPath *newpath, const char *name)
 {
     char path[PATH_MAX];
     snprintf(path, sizeof(path), "%s/%s", newpath->data, name);
     return sabfs_be_js_link(oldpath->data, path);
 }
 
-static int sabfs_truncate(FsContext *ctx, V9fsPath *fs_path, off_t size)
+static int sabfs_be_truncate(FsContext *ctx, V9fsPath *fs_path, off_t size)
 {
     return sabfs_be_js_truncate(fs_path->data, (double)size);
 }
 
-static int sabfs_rename(FsContext *ctx, const char *oldpath, const char *newpath)
+static int sabfs_be_rename(FsContext *ctx, const char *oldpath,
+                           const char *newpath)
 {
     return sabfs_be_js_rename(oldpath, newpath);
 }
 
-static int sabfs_chown(FsContext *ctx, V9fsPath *fs_path, FsCred *credp)
+static int sabfs_be_chown(FsContext *ctx, V9fsPath *fs_path, FsCred *credp)
 {
     return sabfs_be_js_chown(fs_path->data, credp->fc_uid, credp->fc_gid);
 }
 
-static int sabfs_utimensat(FsContext *ctx, V9fsPath *fs_path,
-                           const struct timespec *ts)
+static int sabfs_be_utimensat(FsContext *ctx, V9fsPath *fs_path,
+                              const struct timespec *ts)
 {
     double atime = ts[0].tv_sec + ts[0].tv_nsec / 1e9;
     double mtime = ts[1].tv_sec + ts[1].tv_nsec / 1e9;
     return sabfs_be_js_utimes(fs_path->data, atime, mtime);
 }
 
-static int sabfs_remove(FsContext *ctx, const char *path)
+static int sabfs_be_remove(FsContext *ctx, const char *path)
 {
     /* Try unlink first, then rmdir */
     if (sabfs_be_js_unlink(path) == 0) return 0;
     return sabfs_be_js_rmdir(path);
 }
 
-static int sabfs_fsync(FsContext *ctx, int fid_type,
-                       V9fsFidOpenState *fs, int datasync)
+static int sabfs_be_fsync(FsContext *ctx, int fid_type,
+                          V9fsFidOpenState *fs, int datasync)
 {
-    /* SABFS is in-memory, fsync is a no-op */
-    return 0;
+    /* A no-op unless SABFS is persisted to OPFS, then it waits for it */
+    return sabfs_sync();
 }
 
-static int sabfs_statfs(FsContext *ctx, V9fsPath *fs_path, struct statfs *stbuf)
+static int sabfs_be_statfs(FsContext *ctx, V9fsPath *fs_path,
+                           struct statfs *stbuf)
 {
     uint32_t bsize, blocks, bfree, files, ffree;
 
@@ -646,36 +508,37 @@ static int sabfs_statfs(FsContext *ctx, V9fsPath *fs_path, struct statfs *stbuf)
 }
 
 /* xattr stubs - SABFS doesn't support xattrs */
-static ssize_t sabfs_lgetxattr(FsContext *ctx, V9fsPath *fs_path,
-                               const char *name, void *value, size_t size)
+static ssize_t sabfs_be_lgetxattr(FsContext *ctx, V9fsPath *fs_path,
+                                  const char *name, void *value, size_t size)
 {
     errno = ENOTSUP;
     return -1;
 }
 
-static ssize_t sabfs_llistxattr(FsContext *ctx, V9fsPath *fs_path,
-                                void *value, size_t size)
+static ssize_t sabfs_be_llistxattr(FsContext *ctx, V9fsPath *fs_path,
+                                   void *value, size_t size)
 {
     errno = ENOTSUP;
     return -1;
 }
 
-static int sabfs_lsetxattr(FsContext *ctx, V9fsPath *fs_path,
-                           const char *name, void *value, size_t size, int flags)
+static int sabfs_be_lsetxattr(FsContext *ctx, V9fsPath *fs_path,
+                              const char *name, void *value, size_t size,
+                              int flags)
 {
     errno = ENOTSUP;
     return -1;
 }
 
-static int sabfs_lremovexattr(FsContext *ctx, V9fsPath *fs_path,
-                              const char *name)
+static int sabfs_be_lremovexattr(FsContext *ctx, V9fsPath *fs_path,
+                                 const char *name)
 {
     errno = ENOTSUP;
     return -1;
 }
 
-static int sabfs_name_to_path(FsContext *ctx, V9fsPath *dir_path,
-                              const char *name, V9fsPath *target)
+static int sabfs_be_name_to_path(FsContext *ctx, V9fsPath *dir_path,
+                                 const char *name, V9fsPath *target)
 {
     if (dir_path) {
         if (strcmp(name, ".") == 0) {
@@ -698,9 +561,9 @@ static int sabfs_name_to_path(FsContext *ctx, V9fsPath *dir_path,
     return 0;
 }
 
-static int sabfs_renameat(FsContext *ctx, V9fsPath *olddir,
-                          const char *old_name, V9fsPath *newdir,
-                          const char *new_name)
+static int sabfs_be_renameat(FsContext *ctx, V9fsPath *olddir,
+                             const char *old_name, V9fsPath *newdir,
+                             const char *new_name)
 {
     char oldpath[PATH_MAX], newpath[PATH_MAX];
     snprintf(oldpath, sizeof(oldpath), "%s/%s", olddir->data, old_name);
@@ -708,8 +571,8 @@ static int sabfs_renameat(FsContext *ctx, V9fsPath *olddir,
     return sabfs_be_js_rename(oldpath, newpath);
 }
 
-static int sabfs_unlinkat(FsContext *ctx, V9fsPath *dir,
-                          const char *name, int flags)
+static int sabfs_be_unlinkat(FsContext *ctx, V9fsPath *dir,
+                             const char *name, int flags)
 {
     char path[PATH_MAX];
     snprintf(path, sizeof(path), "%s/%s", dir->data, name);
@@ -720,43 +583,208 @@ static int sabfs_unlinkat(FsContext *ctx, V9fsPath *dir,
     return sabfs_be_js_unlink(path);
 }
 
+/* ========== Timings ========== */
+
+/*
+ * Calls, time and bytes of the operations guests do most, read by the
+ * page with sabfs_9p_stats_json() to compare SABFS layouts on a real
+ * workload (sabfs/bench/compare.mjs).
+ */
+typedef enum {
+    SABFS_OP_LSTAT,
+    SABFS_OP_OPEN,
+    SABFS_OP_OPEN2,
+    SABFS_OP_OPENDIR,
+    SABFS_OP_READDIR,
+    SABFS_OP_PREADV,
+    SABFS_OP_PWRITEV,
+    SABFS_OP_MKDIR,
+    SABFS_OP_UNLINKAT,
+    SABFS_OP__MAX
+} SabfsOp;
+
+static const char *const sabfs_op_names[SABFS_OP__MAX] = {
+    [SABFS_OP_LSTAT] = "lstat",
+    [SABFS_OP_OPEN] = "open",
+    [SABFS_OP_OPEN2] = "open2",
+    [SABFS_OP_OPENDIR] = "opendir",
+    [SABFS_OP_READDIR] = "readdir",
+    [SABFS_OP_PREADV] = "preadv",
+    [SABFS_OP_PWRITEV] = "pwritev",
+    [SABFS_OP_MKDIR] = "mkdir",
+    [SABFS_OP_UNLINKAT] = "unlinkat",
+};
+
+static struct {
+    Stat64 calls;
+    Stat64 ns;
+    Stat64 bytes;
+} sabfs_op_stats[SABFS_OP__MAX];
+
+static void sabfs_op_done(SabfsOp op, int64_t start, ssize_t bytes)
+{
+    stat64_inc(&sabfs_op_stats[op].calls);
+    stat64_add(&sabfs_op_stats[op].ns, get_clock() - start);
+    if (bytes > 0) {
+        stat64_add(&sabfs_op_stats[op].bytes, bytes);
+    }
+}
+
+static int sabfs_be_lstat_timed(FsContext *ctx, V9fsPath *fs_path,
+                                struct stat *stbuf)
+{
+    int64_t start = get_clock();
+    int ret = sabfs_be_lstat(ctx, fs_path, stbuf);
+
+    sabfs_op_done(SABFS_OP_LSTAT, start, 0);
+    return ret;
+}
+
+static int sabfs_be_open_timed(FsContext *ctx, V9fsPath *fs_path,
+                               int flags, V9fsFidOpenState *fs)
+{
+    int64_t start = get_clock();
+    int ret = sabfs_be_open(ctx, fs_path, flags, fs);
+
+    sabfs_op_done(SABFS_OP_OPEN, start, 0);
+    return ret;
+}
+
+static int sabfs_be_open2_timed(FsContext *ctx, V9fsPath *fs_path,
+                                const char *name, int flags, FsCred *credp,
+                                V9fsFidOpenState *fs)
+{
+    int64_t start = get_clock();
+    int ret = sabfs_be_open2(ctx, fs_path, name, flags, credp, fs);
+
+    sabfs_op_done(SABFS_OP_OPEN2, start, 0);
+    return ret;
+}
+
+static int sabfs_be_opendir_timed(FsContext *ctx, V9fsPath *fs_path,
+                                  V9fsFidOpenState *fs)
+{
+    int64_t start = get_clock();
+    int ret = sabfs_be_opendir(ctx, fs_path, fs);
+
+    sabfs_op_done(SABFS_OP_OPENDIR, start, 0);
+    return ret;
+}
+
+static struct dirent *sabfs_be_readdir_timed(FsContext *ctx,
+                                             V9fsFidOpenState *fs)
+{
+    int64_t start = get_clock();
+    struct dirent *entry = sabfs_be_readdir(ctx, fs);
+
+    sabfs_op_done(SABFS_OP_READDIR, start, 0);
+    return entry;
+}
+
+static ssize_t sabfs_be_preadv_timed(FsContext *ctx, V9fsFidOpenState *fs,
+                                     const struct iovec *iov, int iovcnt,
+                                     off_t offset)
+{
+    int64_t start = get_clock();
+    ssize_t ret = sabfs_be_preadv(ctx, fs, iov, iovcnt, offset);
+
+    sabfs_op_done(SABFS_OP_PREADV, start, ret);
+    return ret;
+}
+
+static ssize_t sabfs_be_pwritev_timed(FsContext *ctx, V9fsFidOpenState *fs,
+                                      const struct iovec *iov, int iovcnt,
+                                      off_t offset)
+{
+    int64_t start = get_clock();
+    ssize_t ret = sabfs_be_pwritev(ctx, fs, iov, iovcnt, offset);
+
+    sabfs_op_done(SABFS_OP_PWRITEV, start, ret);
+    return ret;
+}
+
+static int sabfs_be_mkdir_timed(FsContext *ctx, V9fsPath *fs_path,
+                                const char *name, FsCred *credp)
+{
+    int64_t start = get_clock();
+    int ret = sabfs_be_mkdir(ctx, fs_path, name, credp);
+
+    sabfs_op_done(SABFS_OP_MKDIR, start, 0);
+    return ret;
+}
+
+static int sabfs_be_unlinkat_timed(FsContext *ctx, V9fsPath *dir,
+                                   const char *name, int flags)
+{
+    int64_t start = get_clock();
+    int ret = sabfs_be_unlinkat(ctx, dir, name, flags);
+
+    sabfs_op_done(SABFS_OP_UNLINKAT, start, 0);
+    return ret;
+}
+
+/*
+ * Counters since startup, per operation: calls, nanoseconds spent in
+ * them and bytes read or written. The string stays valid until the next
+ * call.
+ */
+EMSCRIPTEN_KEEPALIVE const char *sabfs_9p_stats_json(void)
+{
+    static char *json;
+    GString *s = g_string_new("{\"ops\":{");
+
+    for (int i = 0; i < SABFS_OP__MAX; i++) {
+        g_string_append_printf(s, "%s\"%s\":{\"calls\":%" PRIu64
+                               ",\"ns\":%" PRIu64 ",\"bytes\":%" PRIu64 "}",
+                               i ? "," : "", sabfs_op_names[i],
+                               stat64_get(&sabfs_op_stats[i].calls),
+                               stat64_get(&sabfs_op_stats[i].ns),
+                               stat64_get(&sabfs_op_stats[i].bytes));
+    }
+    g_string_append(s, "}}");
+
+    g_free(json);
+    json = g_string_free(s, FALSE);
+    return json;
+}
+
 FileOperations sabfs_ops = {
     .parse_opts = NULL,
-    .init = sabfs_init,
-    .cleanup = sabfs_cleanup,
-    .lstat = sabfs_lstat,
-    .readlink = sabfs_readlink,
-    .close = sabfs_close,
-    .closedir = sabfs_closedir,
-    .open = sabfs_open,
-    .opendir = sabfs_opendir,
-    .rewinddir = sabfs_rewinddir,
-    .telldir = sabfs_telldir,
-    .readdir = sabfs_readdir,
-    .seekdir = sabfs_seekdir,
-    .preadv = sabfs_preadv,
-    .pwritev = sabfs_pwritev,
-    .chmod = sabfs_chmod,
-    .mknod = sabfs_mknod,
-    .mkdir = sabfs_mkdir,
-    .fstat = sabfs_fstat,
-    .open2 = sabfs_open2,
-    .symlink = sabfs_symlink,
-    .link = sabfs_link,
-    .truncate = sabfs_truncate,
-    .rename = sabfs_rename,
-    .chown = sabfs_chown,
-    .utimensat = sabfs_utimensat,
-    .remove = sabfs_remove,
-    .fsync = sabfs_fsync,
-    .statfs = sabfs_statfs,
-    .lgetxattr = sabfs_lgetxattr,
-    .llistxattr = sabfs_llistxattr,
-    .lsetxattr = sabfs_lsetxattr,
-    .lremovexattr = sabfs_lremovexattr,
-    .name_to_path = sabfs_name_to_path,
-    .renameat = sabfs_renameat,
-    .unlinkat = sabfs_unlinkat,
+    .init = sabfs_be_init,
+    .cleanup = sabfs_be_cleanup,
+    .lstat = sabfs_be_lstat_timed,
+    .readlink = sabfs_be_readlink,
+    .close = sabfs_be_close,
+    .closedir = sabfs_be_closedir,
+    .open = sabfs_be_open_timed,
+    .opendir = sabfs_be_opendir_timed,
+    .rewinddir = sabfs_be_rewinddir,
+    .telldir = sabfs_be_telldir,
+    .readdir = sabfs_be_readdir_timed,
+    .seekdir = sabfs_be_seekdir,
+    .preadv = sabfs_be_preadv_timed,
+    .pwritev = sabfs_be_pwritev_timed,
+    .chmod = sabfs_be_chmod,
+    .mknod = sabfs_be_mknod,
+    .mkdir = sabfs_be_mkdir_timed,
+    .fstat = sabfs_be_fstat,
+    .open2 = sabfs_be_open2_timed,
+    .symlink = sabfs_be_symlink,
+    .link = sabfs_be_link,
+    .truncate = sabfs_be_truncate,
+    .rename = sabfs_be_rename,
+    .chown = sabfs_be_chown,
+    .utimensat = sabfs_be_utimensat,
+    .remove = sabfs_be_remove,
+    .fsync = sabfs_be_fsync,
+    .statfs = sabfs_be_statfs,
+    .lgetxattr = sabfs_be_lgetxattr,
+    .llistxattr = sabfs_be_llistxattr,
+    .lsetxattr = sabfs_be_lsetxattr,
+    .lremovexattr = sabfs_be_lremovexattr,
+    .name_to_path = sabfs_be_name_to_path,
+    .renameat = sabfs_be_renameat,
+    .unlinkat = sabfs_be_unlinkat_timed,
 };
 
 #endif /* __EMSCRIPTEN__ */
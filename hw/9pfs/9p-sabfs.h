@@ -43,43 +43,15 @@ int sabfs_init(void);
 int sabfs_is_ready(void);
 
 /*
- * FD mapping functions - map POSIX fd to SABFS fd
+ * Vectored I/O - these handle the iovec conversion. fd is a SABFS fd from
+ * sabfs_open(); the fd table is shared by every thread, so it can be used
+ * from any of them without mapping.
  */
-void sabfs_fd_map_add(int posix_fd, int sabfs_fd);
-void sabfs_fd_map_remove(int posix_fd);
-int sabfs_fd_map_get(int posix_fd);
+ssize_t sabfs_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+ssize_t sabfs_pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset);
 
-/*
- * Vectored I/O - these handle the iovec conversion
- */
-ssize_t sabfs_preadv(int posix_fd, const struct iovec *iov, int iovcnt, off_t offset);
-ssize_t sabfs_pwritev(int posix_fd, const struct iovec *iov, int iovcnt, off_t offset);
-
-/*
- * Virtual FD ranges for SABFS and ELF cache
- * SABFS-only FDs: 20000-29999 (files only in SharedArrayBuffer)
- * ELF Cache FDs: 30000+ (cached executables for fast execve)
- */
+/* SABFS-only FDs: 20000-29999 (files only in SharedArrayBuffer) */
 #define SABFS_FD_BASE 20000
-#define ELF_CACHE_FD_BASE 30000
-
-/*
- * ELF Cache - for fast execve optimization
- *
- * When execve is detected, call elf_cache_preload() to cache the file.
- * The 9p layer will then use the cache for subsequent reads.
- */
-int elf_cache_preload(const char *path);
-int elf_cache_is_cached(const char *path);
-int elf_cache_is_cache_fd(int fd);
-int elf_cache_open(const char *path);
-ssize_t elf_cache_pread(int fd, void *buf, size_t count, off_t offset);
-ssize_t elf_cache_read(int fd, void *buf, size_t count);
-off_t elf_cache_lseek(int fd, off_t offset, int whence);
-int elf_cache_fstat(int fd, struct stat *st);
-int elf_cache_stat(const char *path, struct stat *st);
-int elf_cache_close(int fd);
-ssize_t elf_cache_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset);
 
 #else /* !__EMSCRIPTEN__ */
 
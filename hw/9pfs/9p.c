@@ -2200,6 +2200,20 @@ out_nofid:
     pdu_complete(pdu, err);
 }
 
+/*
+ * Makes room for @niov entries in the iovec array the PDU keeps across
+ * requests. The first use sizes it for a payload of msize in 4 KiB pages,
+ * the way guests scatter it, so that later requests don't allocate.
+ */
+static void v9fs_pdu_reserve_iov(V9fsPDU *pdu, unsigned int niov)
+{
+    if (niov > pdu->niov_alloc) {
+        niov = MAX(niov, DIV_ROUND_UP(pdu->s->msize, 4096) + 2);
+        pdu->iov = g_renew(struct iovec, pdu->iov, niov);
+        pdu->niov_alloc = niov;
+    }
+}
+
 /*
  * Create a QEMUIOVector for a sub-region of PDU iovecs
  *
@@ -2208,14 +2222,14 @@ out_nofid:
  * @size:       number of bytes to include
  * @is_write:   true - write, false - read
  *
- * The resulting QEMUIOVector has heap-allocated iovecs and must be cleaned up
- * with qemu_iovec_destroy().
+ * The resulting QEMUIOVector points at guest memory through the PDU's own
+ * iovec array, which stays valid until the PDU is reused. The caller may
+ * advance it in place; qemu_iovec_destroy() is not needed.
  */
 static void v9fs_init_qiov_from_pdu(QEMUIOVector *qiov, V9fsPDU *pdu,
                                     size_t skip, size_t size,
                                     bool is_write)
 {
-    QEMUIOVector elem;
     struct iovec *iov;
     unsigned int niov;
 
@@ -2225,9 +2239,9 @@ static void v9fs_init_qiov_from_pdu(QEMUIOVector *qiov, V9fsPDU *pdu,
         pdu->s->transport->init_in_iov_from_pdu(pdu, &iov, &niov, size + skip);
     }
 
-    qemu_iovec_init_external(&elem, iov, niov);
-    qemu_iovec_init(qiov, niov);
-    qemu_iovec_concat(qiov, &elem, skip, size);
+    v9fs_pdu_reserve_iov(pdu, niov);
+    niov = iov_copy(pdu->iov, niov, iov, niov, skip, size);
+    qemu_iovec_init_external(qiov, pdu->iov, niov);
 }
 
 static int v9fs_xattr_read(V9fsState *s, V9fsPDU *pdu, V9fsFidState *fidp,
@@ -2256,7 +2270,6 @@ static int v9fs_xattr_read(V9fsState *s, V9fsPDU *pdu, V9fsFidState *fidp,
     err = v9fs_pack(qiov_full.iov, qiov_full.niov, 0,
                     ((char *)fidp->fs.xattr.value) + off,
                     read_count);
-    qemu_iovec_destroy(&qiov_full);
     if (err < 0) {
         return err;
     }
@@ -2385,21 +2398,22 @@ static void coroutine_fn v9fs_read(void *opaque)
         }
         err += offset + count;
     } else if (fidp->fid_type == P9_FID_FILE) {
-        QEMUIOVector qiov_full;
         QEMUIOVector qiov;
+        struct iovec *iov;
+        unsigned int niov;
         int32_t len;
 
-        v9fs_init_qiov_from_pdu(&qiov_full, pdu, offset + 4, max_count, false);
-        qemu_iovec_init(&qiov, qiov_full.niov);
+        /* The data goes straight into the guest's buffers of the reply */
+        v9fs_init_qiov_from_pdu(&qiov, pdu, offset + 4, max_count, false);
+        iov = qiov.iov;
+        niov = qiov.niov;
         do {
-            qemu_iovec_reset(&qiov);
-            qemu_iovec_concat(&qiov, &qiov_full, count, qiov_full.size - count);
             if (0) {
-                print_sg(qiov.iov, qiov.niov);
+                print_sg(iov, niov);
             }
             /* Loop in case of EINTR */
             do {
-                len = v9fs_co_preadv(pdu, fidp, qiov.iov, qiov.niov, off);
+                len = v9fs_co_preadv(pdu, fidp, iov, niov, off);
                 if (len >= 0) {
                     off   += len;
                     count += len;
@@ -2408,17 +2422,15 @@ static void coroutine_fn v9fs_read(void *opaque)
             if (len < 0) {
                 /* IO error return the error */
                 err = len;
-                goto out_free_iovec;
+                goto out;
             }
+            iov_discard_front(&iov, &niov, len);
         } while (count < max_count && len > 0);
         err = pdu_marshal(pdu, offset, "d", count);
         if (err < 0) {
-            goto out_free_iovec;
+            goto out;
         }
         err += offset + count;
-out_free_iovec:
-        qemu_iovec_destroy(&qiov);
-        qemu_iovec_destroy(&qiov_full);
     } else if (fidp->fid_type == P9_FID_XATTR) {
         err = v9fs_xattr_read(s, pdu, fidp, off, max_count);
     } else {
@@ -2670,7 +2682,8 @@ static void coroutine_fn v9fs_write(void *opaque)
     V9fsPDU *pdu = opaque;
     V9fsState *s = pdu->s;
     QEMUIOVector qiov_full;
-    QEMUIOVector qiov;
+    struct iovec *iov;
+    unsigned int niov;
 
     err = pdu_unmarshal(pdu, offset, "dqd", &fid, &off, &count);
     if (err < 0) {
@@ -2702,16 +2715,15 @@ static void coroutine_fn v9fs_write(void *opaque)
         err = -EINVAL;
         goto out;
     }
-    qemu_iovec_init(&qiov, qiov_full.niov);
+    iov = qiov_full.iov;
+    niov = qiov_full.niov;
     do {
-        qemu_iovec_reset(&qiov);
-        qemu_iovec_concat(&qiov, &qiov_full, total, qiov_full.size - total);
         if (0) {
-            print_sg(qiov.iov, qiov.niov);
+            print_sg(iov, niov);
         }
         /* Loop in case of EINTR */
         do {
-            len = v9fs_co_pwritev(pdu, fidp, qiov.iov, qiov.niov, off);
+            len = v9fs_co_pwritev(pdu, fidp, iov, niov, off);
             if (len >= 0) {
                 off   += len;
                 total += len;
@@ -2720,23 +2732,21 @@ static void coroutine_fn v9fs_write(void *opaque)
         if (len < 0) {
             /* IO error return the error */
             err = len;
-            goto out_qiov;
+            goto out;
         }
+        iov_discard_front(&iov, &niov, len);
     } while (total < count && len > 0);
 
     offset = 7;
     err = pdu_marshal(pdu, offset, "d", total);
     if (err < 0) {
-        goto out_qiov;
+        goto out;
     }
     err += offset;
     trace_v9fs_write_return(pdu->tag, pdu->id, total, err);
-out_qiov:
-    qemu_iovec_destroy(&qiov);
 out:
     put_fid(pdu, fidp);
 out_nofid:
-    qemu_iovec_destroy(&qiov_full);
     pdu_complete(pdu, err);
 }
 
@@ -4308,6 +4318,11 @@ void v9fs_device_unrealize_common(V9fsState *s)
         g_hash_table_destroy(s->fids);
         s->fids = NULL;
     }
+    for (int i = 0; i < MAX_REQ; i++) {
+        g_free(s->pdus[i].iov);
+        s->pdus[i].iov = NULL;
+        s->pdus[i].niov_alloc = 0;
+    }
     g_free(s->tag);
     qp_table_destroy(&s->qpd_table);
     qp_table_destroy(&s->qpp_table);
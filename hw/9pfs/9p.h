@@ -152,6 +152,9 @@ struct V9fsPDU {
     V9fsState *s;
     QLIST_ENTRY(V9fsPDU) next;
     uint32_t idx;
+    /* the payload of Tread and Twrite in guest memory, kept across requests */
+    struct iovec *iov;
+    unsigned int niov_alloc;
 };
 
 
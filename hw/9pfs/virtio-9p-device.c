@@ -36,14 +36,17 @@ static void virtio_9p_push_and_notify(V9fsPDU *pdu)
 
     /* push onto queue and notify */
     virtqueue_push(v->vq, elem, pdu->size);
-    g_free(elem);
+    virtqueue_free_element(v->vq, elem);
     v->elems[pdu->idx] = NULL;
 
-    /* FIXME: we should batch these completions */
-    virtio_notify(VIRTIO_DEVICE(v), v->vq);
+    if (v->in_kick) {
+        v->notify_pending = true;
+    } else {
+        virtio_notify(VIRTIO_DEVICE(v), v->vq);
+    }
 }
 
-static void handle_9p_output(VirtIODevice *vdev, VirtQueue *vq)
+static void handle_9p_requests(VirtIODevice *vdev, VirtQueue *vq)
 {
     V9fsVirtioState *v = (V9fsVirtioState *)vdev;
     V9fsState *s = &v->state;
@@ -82,11 +85,30 @@ static void handle_9p_output(VirtIODevice *vdev, VirtQueue *vq)
 
 out_free_req:
     virtqueue_detach_element(vq, elem, 0);
-    g_free(elem);
+    virtqueue_free_element(vq, elem);
 out_free_pdu:
     pdu_free(pdu);
 }
 
+/*
+ * Requests that complete before the kick has been handled are notified
+ * together. With the fs driver running inline (see coth.h on EMSCRIPTEN)
+ * that is every request that doesn't wait for another one, so a batch of
+ * Treads queued by the guest costs a single interrupt.
+ */
+static void handle_9p_output(VirtIODevice *vdev, VirtQueue *vq)
+{
+    V9fsVirtioState *v = (V9fsVirtioState *)vdev;
+
+    v->in_kick = true;
+    handle_9p_requests(vdev, vq);
+    v->in_kick = false;
+    if (v->notify_pending) {
+        v->notify_pending = false;
+        virtio_notify(vdev, vq);
+    }
+}
+
 static uint64_t virtio_9p_get_features(VirtIODevice *vdev, uint64_t features,
                                        Error **errp)
 {
@@ -218,6 +240,8 @@ static void virtio_9p_device_realize(DeviceState *dev, Error **errp)
     v->config_size = sizeof(struct virtio_9p_config) + strlen(s->fsconf.tag);
     virtio_init(vdev, VIRTIO_ID_9P, v->config_size);
     v->vq = virtio_add_queue(vdev, MAX_REQ, handle_9p_output);
+    /* one element per PDU, reused like the PDUs themselves */
+    virtio_queue_enable_element_pool(v->vq, sizeof(VirtQueueElement));
 }
 
 static void virtio_9p_device_unrealize(DeviceState *dev)
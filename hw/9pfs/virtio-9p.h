@@ -11,6 +11,9 @@ struct V9fsVirtioState {
     VirtQueue *vq;
     size_t config_size;
     VirtQueueElement *elems[MAX_REQ];
+    /* set while a kick is handled, completions then share a notification */
+    bool in_kick;
+    bool notify_pending;
     V9fsState state;
 };
 
@@ -61,18 +61,98 @@
 #include "exec/memory.h"
 #include "hw/boards.h"
 #include "qemu/cutils.h"
+#include "qemu/units.h"
 #include "sysemu/runstate.h"
 #include "accel/tcg/debuginfo.h"
 
 #include <zlib.h>
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef EMSCRIPTEN
+#include "sabfs/sabfs_qemu.h"
+#endif
 
 static int roms_loaded;
 
+#ifdef EMSCRIPTEN
+/*
+ * Files of a lazy SABFS mount are fetched only as far as they are read,
+ * so reading them here directly instead of through Emscripten's
+ * filesystem keeps images that are never loaded off the network.
+ */
+bool image_in_sabfs(const char *filename)
+{
+    sabfs_stat_t st;
+
+    return sabfs_attach() == 0 && sabfs_stat(filename, &st) == 0 &&
+           st.is_file;
+}
+
+static ssize_t sabfs_load_image_size(const char *filename, void *addr,
+                                     size_t size)
+{
+    ssize_t actsize = 0, l = 0;
+    int fd;
+
+    fd = sabfs_open(filename, SABFS_O_RDONLY, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    while (l < size &&
+           (actsize = sabfs_pread(fd, addr + l, size - l, l)) > 0) {
+        l += actsize;
+    }
+
+    sabfs_close(fd);
+
+    return actsize < 0 ? -1 : l;
+}
+#endif
+
+bool load_file_contents(const char *filename, char **contents,
+                        gsize *length, GError **error)
+{
+#ifdef EMSCRIPTEN
+    sabfs_stat_t st;
+
+    if (sabfs_attach() == 0 && sabfs_stat(filename, &st) == 0 &&
+        st.is_file) {
+        char *data = g_malloc(st.size + 1);
+        ssize_t l = sabfs_load_image_size(filename, data, st.size);
+
+        if (l < 0) {
+            g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO,
+                        "Failed to read file \"%s\" from SABFS", filename);
+            g_free(data);
+            return false;
+        }
+        data[l] = 0;
+        *contents = data;
+        if (length) {
+            *length = l;
+        }
+        return true;
+    }
+#endif
+    return g_file_get_contents(filename, contents, length, error);
+}
+
 /* return the size or -1 if error */
 int64_t get_image_size(const char *filename)
 {
     int fd;
     int64_t size;
+#ifdef EMSCRIPTEN
+    sabfs_stat_t st;
+
+    if (sabfs_attach() == 0 && sabfs_stat(filename, &st) == 0 &&
+        st.is_file) {
+        return st.size;
+    }
+#endif
     fd = open(filename, O_RDONLY | O_BINARY);
     if (fd < 0)
         return -1;
@@ -87,6 +167,11 @@ ssize_t load_image_size(const char *filename, void *addr, size_t size)
     int fd;
     ssize_t actsize, l = 0;
 
+#ifdef EMSCRIPTEN
+    if (image_in_sabfs(filename)) {
+        return sabfs_load_image_size(filename, addr, size);
+    }
+#endif
     fd = open(filename, O_RDONLY | O_BINARY);
     if (fd < 0) {
         return -1;
@@ -808,8 +893,8 @@ ssize_t load_image_gzipped_buffer(const char *filename, uint64_t max_sz,
     ssize_t bytes;
     int ret = -1;
 
-    if (!g_file_get_contents(filename, (char **) &compressed_data, &len,
-                             NULL)) {
+    if (!load_file_contents(filename, (char **) &compressed_data, &len,
+                            NULL)) {
         goto out;
     }
 
@@ -858,6 +943,149 @@ ssize_t load_image_gzipped(const char *filename, hwaddr addr, uint64_t max_sz)
     return bytes;
 }
 
+static uint8_t *inflate_gzip(const uint8_t *src, size_t srclen,
+                             size_t *size, Error **errp)
+{
+    z_stream s = {
+        .zalloc = zalloc,
+        .zfree = zfree,
+    };
+    size_t cap, len = 0;
+    uint8_t *dst;
+    int r;
+
+    /* ISIZE, the size modulo 4 GiB, is the last word of the member */
+    cap = MAX((uint32_t)ldl_le_p(src + srclen - 4), srclen);
+    cap = MIN(cap, LOAD_IMAGE_MAX_GUNZIP_BYTES);
+    dst = g_malloc(cap);
+
+    if (inflateInit2(&s, 16 + MAX_WBITS) != Z_OK) {
+        error_setg(errp, "inflateInit2() failed");
+        g_free(dst);
+        return NULL;
+    }
+    s.next_in = (uint8_t *)src;
+    s.avail_in = srclen;
+    do {
+        if (len == cap) {
+            if (cap == LOAD_IMAGE_MAX_GUNZIP_BYTES) {
+                error_setg(errp, "more than %d bytes once decompressed",
+                           LOAD_IMAGE_MAX_GUNZIP_BYTES);
+                goto fail;
+            }
+            cap = MIN(cap * 2, LOAD_IMAGE_MAX_GUNZIP_BYTES);
+            dst = g_realloc(dst, cap);
+        }
+        s.next_out = dst + len;
+        s.avail_out = cap - len;
+        r = inflate(&s, Z_NO_FLUSH);
+        len = s.next_out - dst;
+        if (r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR) {
+            error_setg(errp, "bad gzip data (inflate() returned %d)", r);
+            goto fail;
+        }
+        if (r == Z_BUF_ERROR && s.avail_out) {
+            error_setg(errp, "truncated gzip data");
+            goto fail;
+        }
+    } while (r != Z_STREAM_END);
+    inflateEnd(&s);
+
+    *size = len;
+    return g_realloc(dst, len);
+
+fail:
+    inflateEnd(&s);
+    g_free(dst);
+    return NULL;
+}
+
+#ifdef CONFIG_ZSTD
+static uint8_t *inflate_zstd(const uint8_t *src, size_t srclen,
+                             size_t *size, Error **errp)
+{
+    ZSTD_inBuffer in = { src, srclen, 0 };
+    ZSTD_outBuffer out = {};
+    unsigned long long content = ZSTD_getFrameContentSize(src, srclen);
+    ZSTD_DStream *ds;
+    size_t r;
+
+    if (content == ZSTD_CONTENTSIZE_ERROR) {
+        error_setg(errp, "bad zstd frame header");
+        return NULL;
+    }
+    if (content == ZSTD_CONTENTSIZE_UNKNOWN) {
+        content = srclen * 4;
+    }
+    /* one byte more than announced is what tells the end was reached */
+    out.size = MIN(content + 1, LOAD_IMAGE_MAX_GUNZIP_BYTES);
+    out.dst = g_malloc(out.size);
+
+    ds = ZSTD_createDStream();
+    ZSTD_initDStream(ds);
+    do {
+        if (out.pos == out.size) {
+            if (out.size == LOAD_IMAGE_MAX_GUNZIP_BYTES) {
+                error_setg(errp, "more than %d bytes once decompressed",
+                           LOAD_IMAGE_MAX_GUNZIP_BYTES);
+                goto fail;
+            }
+            out.size = MIN(out.size * 2, LOAD_IMAGE_MAX_GUNZIP_BYTES);
+            out.dst = g_realloc(out.dst, out.size);
+        }
+        r = ZSTD_decompressStream(ds, &out, &in);
+        if (ZSTD_isError(r)) {
+            error_setg(errp, "bad zstd data: %s", ZSTD_getErrorName(r));
+            goto fail;
+        }
+        if (r && in.pos == in.size && out.pos < out.size) {
+            error_setg(errp, "truncated zstd data");
+            goto fail;
+        }
+    } while (r);
+    ZSTD_freeDStream(ds);
+
+    *size = out.pos;
+    return g_realloc(out.dst, out.pos);
+
+fail:
+    ZSTD_freeDStream(ds);
+    g_free(out.dst);
+    return NULL;
+}
+#endif
+
+uint8_t *load_file_inflated(const char *filename, size_t *size, Error **errp)
+{
+    g_autoptr(GError) gerr = NULL;
+    uint8_t *data, *ret;
+    gsize len;
+
+    if (!load_file_contents(filename, (char **)&data, &len, &gerr)) {
+        error_setg(errp, "%s: %s", filename, gerr->message);
+        return NULL;
+    }
+
+    if (len >= 18 && data[0] == 0x1f && data[1] == 0x8b) {
+        ret = inflate_gzip(data, len, size, errp);
+    } else if (len >= 4 && (uint32_t)ldl_le_p(data) == 0xfd2fb528) {
+#ifdef CONFIG_ZSTD
+        ret = inflate_zstd(data, len, size, errp);
+#else
+        error_setg(errp, "zstd support is not built in");
+        ret = NULL;
+#endif
+    } else {
+        *size = len;
+        return data;
+    }
+    g_free(data);
+    if (!ret) {
+        error_prepend(errp, "%s: ", filename);
+    }
+    return ret;
+}
+
 /* The PE/COFF MS-DOS stub magic number */
 #define EFI_PE_MSDOS_MAGIC        "MZ"
 
@@ -976,6 +1204,15 @@ struct Rom {
     char *fw_file;
     GMappedFile *mapped_file;
 
+    /* data is not kept but read from the file, see rom_open_streamed() */
+    bool streamed;
+    int fd;
+#ifdef EMSCRIPTEN
+    /* fd is -1 for a file of SABFS, which is read by blocks */
+    uint64_t sabfs_ino;
+    uint32_t sabfs_generation;
+#endif
+
     bool committed;
 
     hwaddr addr;
@@ -985,12 +1222,165 @@ struct Rom {
 static FWCfgState *fw_cfg;
 static QTAILQ_HEAD(, Rom) roms = QTAILQ_HEAD_INITIALIZER(roms);
 
+/*
+ * ROMs of at least ROM_STREAM_MIN bytes loaded from a file into RAM, such
+ * as -initrd of most boards, keep no copy of the file: every
+ * reset reads it again straight into guest memory, from the blocks of
+ * SABFS for files there. The data is only read into a buffer once some
+ * code asks for a pointer to it with rom_ptr().
+ */
+#define ROM_STREAM_MIN   (1 * MiB)
+#define ROM_STREAM_CHUNK (1 * MiB)
+
+static bool rom_open_streamed(Rom *rom)
+{
+    struct stat st;
+    int fd;
+
+#ifdef EMSCRIPTEN
+    if (image_in_sabfs(rom->path)) {
+        sabfs_stat_t sst;
+
+        if (sabfs_stat(rom->path, &sst) < 0 || sst.size < ROM_STREAM_MIN) {
+            return false;
+        }
+        rom->sabfs_ino = sst.ino;
+        rom->sabfs_generation = sabfs_generation_ino(sst.ino);
+        rom->fd = -1;
+        rom->romsize = rom->datasize = sst.size;
+        rom->streamed = true;
+        return true;
+    }
+#endif
+
+    fd = open(rom->path, O_RDONLY | O_BINARY);
+    if (fd == -1) {
+        return false;
+    }
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+        st.st_size < ROM_STREAM_MIN) {
+        close(fd);
+        return false;
+    }
+    rom->fd = fd;
+    rom->romsize = rom->datasize = st.st_size;
+    rom->streamed = true;
+    return true;
+}
+
+/* Copy @n bytes at @offset of the ROM to @dest or, if NULL, guest memory */
+static void rom_stream_out(Rom *rom, size_t offset, const uint8_t *src,
+                           size_t n, uint8_t *dest)
+{
+    if (dest && src) {
+        memcpy(dest, src, n);
+    } else if (dest) {
+        memset(dest, 0, n);
+    } else if (src) {
+        address_space_write_rom(rom->as, rom->addr + offset,
+                                MEMTXATTRS_UNSPECIFIED, src, n);
+    } else {
+        address_space_set(rom->as, rom->addr + offset, 0, n,
+                          MEMTXATTRS_UNSPECIFIED);
+    }
+}
+
+/*
+ * Read @len bytes at @offset of a streamed ROM into @dest, or into guest
+ * memory at the address of the ROM if @dest is NULL. What the file lacks
+ * by now reads as zeros.
+ */
+static void rom_stream(Rom *rom, size_t offset, size_t len, uint8_t *dest)
+{
+    g_autofree uint8_t *bounce = NULL;
+    size_t end = offset + len;
+
+#ifdef EMSCRIPTEN
+    if (rom->fd == -1) {
+        sabfs_stat_t st = {};
+        uint32_t generation = sabfs_generation_ino(rom->sabfs_ino);
+
+        if (generation != rom->sabfs_generation) {
+            warn_report("rom: %s changed since it was loaded", rom->name);
+            rom->sabfs_generation = generation;
+        }
+        sabfs_stat_ino(rom->sabfs_ino, &st);
+        while (offset < end) {
+            size_t in = offset % SABFS_BLOCK_SIZE;
+            size_t n = MIN(end - offset, SABFS_BLOCK_SIZE - in);
+            const uint8_t *blk = NULL;
+
+            if (offset < st.size) {
+                n = MIN(n, st.size - offset);
+                blk = sabfs_map_block(rom->sabfs_ino,
+                                      offset / SABFS_BLOCK_SIZE);
+            }
+            rom_stream_out(rom, offset, blk ? blk + in : NULL, n, dest);
+            offset += n;
+            if (dest) {
+                dest += n;
+            }
+        }
+        return;
+    }
+#endif
+
+    if (!dest) {
+        bounce = g_malloc(MIN(len, ROM_STREAM_CHUNK));
+    }
+    while (offset < end) {
+        size_t n = MIN(end - offset, ROM_STREAM_CHUNK);
+        uint8_t *buf = dest ? dest : bounce;
+        ssize_t r = pread(rom->fd, buf, n, offset);
+
+        if (r < 0) {
+            warn_report("rom: file %s: read error: %s", rom->name,
+                        strerror(errno));
+            r = 0;
+        }
+        if (r > 0) {
+            rom_stream_out(rom, offset, buf, r, dest);
+        }
+        if (r < n) {
+            /* the file was truncated, or could not be read */
+            rom_stream_out(rom, offset + r, NULL, end - offset - r,
+                           dest ? dest + r : NULL);
+            return;
+        }
+        offset += n;
+        if (dest) {
+            dest += n;
+        }
+    }
+}
+
+/* Turn a streamed ROM into one whose data is in memory */
+static void rom_materialize(Rom *rom)
+{
+    uint8_t *data = g_malloc(rom->datasize);
+
+    rom_stream(rom, 0, rom->datasize, data);
+    if (rom->fd != -1) {
+        close(rom->fd);
+        rom->fd = -1;
+    }
+    rom->streamed = false;
+    rom->data = data;
+}
+
 /*
  * rom->data can be heap-allocated or memory-mapped (e.g. when added with
  * rom_add_elf_program())
  */
 static void rom_free_data(Rom *rom)
 {
+    if (rom->streamed) {
+        if (rom->fd != -1) {
+            close(rom->fd);
+            rom->fd = -1;
+        }
+        rom->streamed = false;
+    }
     if (rom->mapped_file) {
         g_mapped_file_unref(rom->mapped_file);
         rom->mapped_file = NULL;
@@ -1094,6 +1484,33 @@ ssize_t rom_add_file(const char *file, const char *fw_dir,
         rom->path = g_strdup(file);
     }
 
+    if (fw_dir) {
+        rom->fw_dir  = g_strdup(fw_dir);
+        rom->fw_file = g_strdup(file);
+    }
+    rom->addr     = addr;
+
+    if (!fw_dir && !mr && rom_open_streamed(rom)) {
+        goto loaded;
+    }
+
+#ifdef EMSCRIPTEN
+    if (image_in_sabfs(rom->path)) {
+        g_autoptr(GError) gerr = NULL;
+        gsize len;
+
+        if (!load_file_contents(rom->path, (char **)&rom->data, &len,
+                                &gerr)) {
+            fprintf(stderr, "rom: file %-20s: read error: %s\n",
+                    rom->name, gerr->message);
+            goto err;
+        }
+        rom->romsize  = len;
+        rom->datasize = len;
+        goto loaded;
+    }
+#endif
+
     fd = open(rom->path, O_RDONLY | O_BINARY);
     if (fd == -1) {
         fprintf(stderr, "Could not open option rom '%s': %s\n",
@@ -1101,11 +1518,6 @@ ssize_t rom_add_file(const char *file, const char *fw_dir,
         goto err;
     }
 
-    if (fw_dir) {
-        rom->fw_dir  = g_strdup(fw_dir);
-        rom->fw_file = g_strdup(file);
-    }
-    rom->addr     = addr;
     rom->romsize  = lseek(fd, 0, SEEK_END);
     if (rom->romsize == -1) {
         fprintf(stderr, "rom: file %-20s: get size error: %s\n",
@@ -1123,6 +1535,7 @@ ssize_t rom_add_file(const char *file, const char *fw_dir,
         goto err;
     }
     close(fd);
+loaded:
     rom_insert(rom);
     if (rom->fw_file && fw_cfg) {
         const char *basename;
@@ -1261,7 +1674,7 @@ static void rom_reset(void *unused)
          * that some of those RAMs can actually be modified by the guest.
          */
         if (runstate_check(RUN_STATE_INMIGRATE)) {
-            if (rom->data && rom->isrom) {
+            if ((rom->data || rom->streamed) && rom->isrom) {
                 /*
                  * Free it so that a rom_reset after migration doesn't
                  * overwrite a potentially modified 'rom'.
@@ -1271,10 +1684,12 @@ static void rom_reset(void *unused)
             continue;
         }
 
-        if (rom->data == NULL) {
+        if (rom->data == NULL && !rom->streamed) {
             continue;
         }
-        if (rom->mr) {
+        if (rom->streamed) {
+            rom_stream(rom, 0, rom->datasize, NULL);
+        } else if (rom->mr) {
             void *host = memory_region_get_ram_ptr(rom->mr);
             memcpy(host, rom->data, rom->datasize);
             memset(host + rom->datasize, 0, rom->romsize - rom->datasize);
@@ -1567,7 +1982,11 @@ int rom_copy(uint8_t *dest, hwaddr addr, size_t size)
         }
 
         if (l > 0) {
-            memcpy(d, s, l);
+            if (rom->streamed) {
+                rom_stream(rom, 0, l, d);
+            } else {
+                memcpy(d, s, l);
+            }
         }
 
         if (rom->romsize > rom->datasize) {
@@ -1599,6 +2018,9 @@ void *rom_ptr(hwaddr addr, size_t size)
     Rom *rom;
 
     rom = find_rom(addr, size);
+    if (rom && rom->streamed) {
+        rom_materialize(rom);
+    }
     if (!rom || !rom->data)
         return NULL;
     return rom->data + (addr - rom->addr);
@@ -1952,7 +2374,7 @@ ssize_t load_targphys_hex_as(const char *filename, hwaddr *entry,
     gchar *hex_blob;
     ssize_t total_size = 0;
 
-    if (!g_file_get_contents(filename, &hex_blob, &hex_blob_size, NULL)) {
+    if (!load_file_contents(filename, &hex_blob, &hex_blob_size, NULL)) {
         return -1;
     }
 
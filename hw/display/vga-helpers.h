@@ -278,6 +278,35 @@ static void vga_draw_line8(VGACommonState *vga, uint8_t *d,
     }
 }
 
+#ifdef __wasm_simd128__
+/*
+ * Lines of the 15 to 32 bit modes that don't wrap around the end of video
+ * memory are converted 4 or 8 pixels at a time, straight from vram_ptr.
+ */
+static inline const uint8_t *vga_line_ptr(VGACommonState *vga, uint32_t addr,
+                                          int bytes, int align)
+{
+    uint32_t offset = addr & vga->vbe_size_mask;
+
+    if ((addr & (align - 1)) ||
+        (uint64_t)offset + bytes > (uint64_t)vga->vbe_size_mask + 1) {
+        return NULL;
+    }
+    return vga->vram_ptr + offset;
+}
+
+/* Stores 8 pixels from 16 bit lanes of 8 bit r, g and b */
+static inline void vga_put_pixels8_simd(uint8_t *d, v128_t r, v128_t g,
+                                        v128_t b)
+{
+    v128_t bg = wasm_v128_or(b, wasm_i16x8_shl(g, 8));
+
+    wasm_v128_store(d, wasm_i16x8_shuffle(bg, r, 0, 8, 1, 9, 2, 10, 3, 11));
+    wasm_v128_store(d + 16,
+                    wasm_i16x8_shuffle(bg, r, 4, 12, 5, 13, 6, 14, 7, 15));
+}
+#endif
+
 /*
  * 15 bit color
  */
@@ -288,6 +317,29 @@ static void vga_draw_line15_le(VGACommonState *vga, uint8_t *d,
     uint32_t v, r, g, b;
 
     w = width;
+#ifdef __wasm_simd128__
+    {
+        const uint8_t *s = vga_line_ptr(vga, addr, width * 2, 2);
+
+        if (s) {
+            v128_t m = wasm_i16x8_splat(0xf8);
+
+            for (; w >= 8; w -= 8) {
+                v128_t p = wasm_v128_load(s);
+                vga_put_pixels8_simd(d,
+                                     wasm_v128_and(wasm_u16x8_shr(p, 7), m),
+                                     wasm_v128_and(wasm_u16x8_shr(p, 2), m),
+                                     wasm_v128_and(wasm_i16x8_shl(p, 3), m));
+                s += 16;
+                addr += 16;
+                d += 32;
+            }
+            if (!w) {
+                return;
+            }
+        }
+    }
+#endif
     do {
         v = vga_read_word_le(vga, addr);
         r = (v >> 7) & 0xf8;
@@ -327,6 +379,30 @@ static void vga_draw_line16_le(VGACommonState *vga, uint8_t *d,
     uint32_t v, r, g, b;
 
     w = width;
+#ifdef __wasm_simd128__
+    {
+        const uint8_t *s = vga_line_ptr(vga, addr, width * 2, 2);
+
+        if (s) {
+            v128_t m = wasm_i16x8_splat(0xf8);
+
+            for (; w >= 8; w -= 8) {
+                v128_t p = wasm_v128_load(s);
+                vga_put_pixels8_simd(d,
+                                     wasm_v128_and(wasm_u16x8_shr(p, 8), m),
+                                     wasm_v128_and(wasm_u16x8_shr(p, 3),
+                                                   wasm_i16x8_splat(0xfc)),
+                                     wasm_v128_and(wasm_i16x8_shl(p, 3), m));
+                s += 16;
+                addr += 16;
+                d += 32;
+            }
+            if (!w) {
+                return;
+            }
+        }
+    }
+#endif
     do {
         v = vga_read_word_le(vga, addr);
         r = (v >> 8) & 0xf8;
@@ -366,6 +442,25 @@ static void vga_draw_line24_le(VGACommonState *vga, uint8_t *d,
     uint32_t r, g, b;
 
     w = width;
+#ifdef __wasm_simd128__
+    {
+        const uint8_t *s = vga_line_ptr(vga, addr, width * 3, 1);
+
+        if (s) {
+            /* B, G, R of 4 pixels out of 12 bytes, the top byte cleared */
+            const v128_t idx = wasm_i8x16_make(0, 1, 2, 16, 3, 4, 5, 16,
+                                               6, 7, 8, 16, 9, 10, 11, 16);
+
+            /* the loads take 16 bytes each, so keep them within the line */
+            for (; w >= 6; w -= 4) {
+                wasm_v128_store(d, wasm_i8x16_swizzle(wasm_v128_load(s), idx));
+                s += 12;
+                addr += 12;
+                d += 16;
+            }
+        }
+    }
+#endif
     do {
         b = vga_read_byte(vga, addr + 0);
         g = vga_read_byte(vga, addr + 1);
@@ -403,6 +498,25 @@ static void vga_draw_line32_le(VGACommonState *vga, uint8_t *d,
     uint32_t r, g, b;
 
     w = width;
+#ifdef __wasm_simd128__
+    {
+        const uint8_t *s = vga_line_ptr(vga, addr, width * 4, 1);
+
+        if (s) {
+            v128_t m = wasm_i32x4_splat(0x00ffffff);
+
+            for (; w >= 4; w -= 4) {
+                wasm_v128_store(d, wasm_v128_and(wasm_v128_load(s), m));
+                s += 16;
+                addr += 16;
+                d += 16;
+            }
+            if (!w) {
+                return;
+            }
+        }
+    }
+#endif
     do {
         b = vga_read_byte(vga, addr + 0);
         g = vga_read_byte(vga, addr + 1);
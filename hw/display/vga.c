@@ -23,6 +23,9 @@
  */
 
 #include "qemu/osdep.h"
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
 #include "qemu/units.h"
 #include "sysemu/reset.h"
 #include "qapi/error.h"
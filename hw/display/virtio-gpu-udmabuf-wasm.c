@@ -0,0 +1,94 @@
+/*
+ * Virtio GPU blob resources on wasm
+ *
+ * There are no dmabufs in the browser, but none are needed to show a
+ * blob: guest RAM is part of the wasm memory the page reads the display
+ * surface from. When the guest pages backing a blob are contiguous there,
+ * the blob is scanned out straight from guest RAM and the canvas display
+ * uploads the flushed rectangles from it, without a copy in QEMU.
+ *
+ * Blobs scattered over guest RAM get a shadow instead (the counterpart of
+ * the remapped udmabuf on Linux), and each RESOURCE_FLUSH copies only the
+ * flushed rectangle into it.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/iov.h"
+#include "hw/virtio/virtio-gpu.h"
+
+bool virtio_gpu_have_udmabuf(void)
+{
+    return true;
+}
+
+static bool virtio_gpu_blob_contiguous(struct virtio_gpu_simple_resource *res)
+{
+    uint8_t *end = res->iov[0].iov_base;
+    uint64_t size = 0;
+    int i;
+
+    for (i = 0; i < res->iov_cnt; i++) {
+        if (res->iov[i].iov_base != end) {
+            return false;
+        }
+        end += res->iov[i].iov_len;
+        size += res->iov[i].iov_len;
+    }
+    return size >= res->blob_size;
+}
+
+void virtio_gpu_init_udmabuf(struct virtio_gpu_simple_resource *res)
+{
+    res->dmabuf_fd = -1;
+    if (!res->iov_cnt) {
+        return;
+    }
+    if (virtio_gpu_blob_contiguous(res)) {
+        res->blob = res->iov[0].iov_base;
+        return;
+    }
+
+    res->remapped = g_try_malloc0(res->blob_size);
+    if (!res->remapped) {
+        return;
+    }
+    iov_to_buf(res->iov, res->iov_cnt, 0, res->remapped, res->blob_size);
+    res->blob = res->remapped;
+}
+
+void virtio_gpu_fini_udmabuf(struct virtio_gpu_simple_resource *res)
+{
+    g_free(res->remapped);
+    res->remapped = NULL;
+}
+
+void virtio_gpu_sync_blob(struct virtio_gpu_simple_resource *res,
+                          uint64_t offset, uint32_t stride,
+                          uint32_t bytes, uint32_t rows)
+{
+    uint32_t y;
+
+    if (!res->remapped) {
+        return;
+    }
+    for (y = 0; y < rows; y++, offset += stride) {
+        if (offset + bytes > res->blob_size) {
+            break;
+        }
+        iov_to_buf(res->iov, res->iov_cnt, offset,
+                   res->remapped + offset, bytes);
+    }
+}
+
+int virtio_gpu_update_dmabuf(VirtIOGPU *g,
+                             uint32_t scanout_id,
+                             struct virtio_gpu_simple_resource *res,
+                             struct virtio_gpu_framebuffer *fb,
+                             struct virtio_gpu_rect *r)
+{
+    /* only used with GL consoles, which wasm builds don't have */
+    return 0;
+}
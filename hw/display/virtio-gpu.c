@@ -60,6 +60,10 @@ void virtio_gpu_update_cursor_data(VirtIOGPU *g,
                               s->current_cursor->height * 4)) {
             return;
         }
+#ifdef EMSCRIPTEN
+        virtio_gpu_sync_blob(res, 0, 0, s->current_cursor->width *
+                             s->current_cursor->height * 4, 1);
+#endif
         data = res->blob;
     } else {
         if (pixman_image_get_width(res->image)  != s->current_cursor->width ||
@@ -581,6 +585,17 @@ static void virtio_gpu_resource_flush(VirtIOGPU *g,
         /* work out the area we need to update for each console */
         if (qemu_rect_intersect(&flush_rect, &rect, &rect)) {
             qemu_rect_translate(&rect, -scanout->x, -scanout->y);
+#ifdef EMSCRIPTEN
+            if (res->blob) {
+                /* a shadowed blob only gets the flushed rectangle */
+                virtio_gpu_sync_blob(res, scanout->fb.offset +
+                                     rect.y * scanout->fb.stride +
+                                     rect.x * scanout->fb.bytes_pp,
+                                     scanout->fb.stride,
+                                     rect.width * scanout->fb.bytes_pp,
+                                     rect.height);
+            }
+#endif
             dpy_gfx_update(g->parent_obj.scanout[i].con,
                            rect.x, rect.y, rect.width, rect.height);
         }
@@ -595,6 +610,7 @@ static void virtio_unref_resource(pixman_image_t *image, void *data)
 static void virtio_gpu_update_scanout(VirtIOGPU *g,
                                       uint32_t scanout_id,
                                       struct virtio_gpu_simple_resource *res,
+                                      struct virtio_gpu_framebuffer *fb,
                                       struct virtio_gpu_rect *r)
 {
     struct virtio_gpu_simple_resource *ores;
@@ -608,6 +624,7 @@ static void virtio_gpu_update_scanout(VirtIOGPU *g,
 
     res->scanout_bitmask |= (1 << scanout_id);
     scanout->resource_id = res->resource_id;
+    scanout->fb = *fb;
     scanout->x = r->x;
     scanout->y = r->y;
     scanout->width = r->width;
@@ -648,7 +665,7 @@ static void virtio_gpu_do_set_scanout(VirtIOGPU *g,
     if (res->blob) {
         if (console_has_gl(scanout->con)) {
             if (!virtio_gpu_update_dmabuf(g, scanout_id, res, fb, r)) {
-                virtio_gpu_update_scanout(g, scanout_id, res, r);
+                virtio_gpu_update_scanout(g, scanout_id, res, fb, r);
             } else {
                 *error = VIRTIO_GPU_RESP_ERR_OUT_OF_MEMORY;
             }
@@ -692,7 +709,7 @@ static void virtio_gpu_do_set_scanout(VirtIOGPU *g,
                                 scanout->ds);
     }
 
-    virtio_gpu_update_scanout(g, scanout_id, res, r);
+    virtio_gpu_update_scanout(g, scanout_id, res, fb, r);
 }
 
 static void virtio_gpu_set_scanout(VirtIOGPU *g,
@@ -24,9 +24,11 @@
 #include "qapi/qapi-visit-common.h"
 #include "sysemu/sysemu.h"
 #include "sysemu/cpus.h"
+#include "sysemu/cpu-timers.h"
 #include "sysemu/numa.h"
 #include "sysemu/reset.h"
 #include "sysemu/runstate.h"
+#include "sysemu/tcg.h"
 #include "acpi-microvm.h"
 #include "microvm-dt.h"
 
@@ -410,6 +412,22 @@ static void microvm_fix_kernel_cmdline(MachineState *machine)
         }
     }
 
+#ifdef EMSCRIPTEN
+    /*
+     * cpu_get_host_ticks() counts nanoseconds on wasm hosts, so the TSC of
+     * TCG guests runs at exactly 1 GHz. Tell the guest, which then neither
+     * calibrates the TSC and the delay loop against the PIT, slow under
+     * TCI, nor lets the clocksource watchdog give up on the TSC when its
+     * vCPU thread falls behind.
+     */
+    if (tcg_enabled() && !icount_enabled()) {
+        char *newcmd = g_strjoin(NULL, cmdline,
+                                 " tsc_early_khz=1000000 tsc=reliable", NULL);
+        g_free(cmdline);
+        cmdline = newcmd;
+    }
+#endif
+
     fw_cfg_modify_i32(x86ms->fw_cfg, FW_CFG_CMDLINE_SIZE, strlen(cmdline) + 1);
     fw_cfg_modify_string(x86ms->fw_cfg, FW_CFG_CMDLINE_DATA, cmdline);
 
@@ -738,9 +738,162 @@ static uint64_t read_pvh_start_addr(void *arg1, void *arg2, bool is64)
     return pvh_start_addr;
 }
 
+/*
+ * The PVH entry point in the XEN_ELFNOTE_PHYS32_ENTRY note among the
+ * @len bytes of notes at @note, or 0 if there is none.
+ */
+static uint64_t elfboot_note_entry(const uint8_t *note, uint64_t len,
+                                   uint64_t align)
+{
+    while (len >= 12) {
+        uint32_t namesz = ldl_le_p(note);
+        uint32_t descsz = ldl_le_p(note + 4);
+        uint64_t desc = 12 + QEMU_ALIGN_UP((uint64_t)namesz, align);
+        uint64_t next = desc + QEMU_ALIGN_UP((uint64_t)descsz, align);
+
+        if (desc + descsz > len) {
+            return 0;
+        }
+        if (ldl_le_p(note + 8) == XEN_ELFNOTE_PHYS32_ENTRY &&
+            namesz == 4 && !memcmp(note + 12, "Xen", 4)) {
+            if (descsz == 4) {
+                return (uint32_t)ldl_le_p(note + desc);
+            } else if (descsz == 8) {
+                return ldq_le_p(note + desc);
+            }
+        }
+        next = MIN(next, len);
+        note += next;
+        len -= next;
+    }
+    return 0;
+}
+
+/*
+ * PVH boot of an ELF kernel out of a buffer: a vmlinux compressed with
+ * gzip or zstd is decompressed here once, rather than booting a bzImage
+ * whose decompressor runs in the guest, under TCG. On wasm hosts this is
+ * also how kernels of SABFS are loaded, as load_elf() wants a file
+ * descriptor. Everything read from the image is bounds checked, since
+ * the headers come straight from the file.
+ */
+static bool load_elfboot_image(const char *kernel_filename,
+                               uint8_t *header, size_t header_size,
+                               FWCfgState *fw_cfg)
+{
+    Error *err = NULL;
+    uint64_t entry = 0, low = UINT64_MAX, high = 0;
+    uint64_t phoff, phentsize, phnum;
+    uint32_t flags;
+    uint8_t *elf;
+    size_t size;
+    bool is64;
+    unsigned i;
+
+    elf = load_file_inflated(kernel_filename, &size, &err);
+    if (!elf) {
+        error_report_err(err);
+        exit(1);
+    }
+    if (size < sizeof(Elf64_Ehdr) || ldl_p(elf) != 0x464c457f) {
+        error_report("%s: not an ELF kernel", kernel_filename);
+        exit(1);
+    }
+
+    is64 = elf[EI_CLASS] == ELFCLASS64;
+    if (is64) {
+        flags = ldl_le_p(elf + offsetof(Elf64_Ehdr, e_flags));
+        phoff = ldq_le_p(elf + offsetof(Elf64_Ehdr, e_phoff));
+        phentsize = lduw_le_p(elf + offsetof(Elf64_Ehdr, e_phentsize));
+        phnum = lduw_le_p(elf + offsetof(Elf64_Ehdr, e_phnum));
+    } else {
+        flags = ldl_le_p(elf + offsetof(Elf32_Ehdr, e_flags));
+        phoff = (uint32_t)ldl_le_p(elf + offsetof(Elf32_Ehdr, e_phoff));
+        phentsize = lduw_le_p(elf + offsetof(Elf32_Ehdr, e_phentsize));
+        phnum = lduw_le_p(elf + offsetof(Elf32_Ehdr, e_phnum));
+    }
+    if (flags & 0x00010004) { /* LOAD_ELF_HEADER_HAS_ADDR */
+        error_report("elfboot unsupported flags = %x", flags);
+        exit(1);
+    }
+    if (phentsize < (is64 ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr)) ||
+        phoff > size || phnum > (size - phoff) / phentsize) {
+        error_report("%s: bad ELF program headers", kernel_filename);
+        exit(1);
+    }
+
+    for (i = 0; i < phnum; i++) {
+        const uint8_t *ph = elf + phoff + i * phentsize;
+        uint64_t type, offset, paddr, filesz, memsz, align;
+
+        if (is64) {
+            type = ldl_le_p(ph + offsetof(Elf64_Phdr, p_type));
+            offset = ldq_le_p(ph + offsetof(Elf64_Phdr, p_offset));
+            paddr = ldq_le_p(ph + offsetof(Elf64_Phdr, p_paddr));
+            filesz = ldq_le_p(ph + offsetof(Elf64_Phdr, p_filesz));
+            memsz = ldq_le_p(ph + offsetof(Elf64_Phdr, p_memsz));
+            align = ldq_le_p(ph + offsetof(Elf64_Phdr, p_align));
+        } else {
+            type = ldl_le_p(ph + offsetof(Elf32_Phdr, p_type));
+            offset = (uint32_t)ldl_le_p(ph + offsetof(Elf32_Phdr, p_offset));
+            paddr = (uint32_t)ldl_le_p(ph + offsetof(Elf32_Phdr, p_paddr));
+            filesz = (uint32_t)ldl_le_p(ph + offsetof(Elf32_Phdr, p_filesz));
+            memsz = (uint32_t)ldl_le_p(ph + offsetof(Elf32_Phdr, p_memsz));
+            align = (uint32_t)ldl_le_p(ph + offsetof(Elf32_Phdr, p_align));
+        }
+        if (type != PT_LOAD && type != PT_NOTE) {
+            continue;
+        }
+        if (offset > size || filesz > size - offset) {
+            error_report("%s: ELF segment %u is past the end of the file",
+                         kernel_filename, i);
+            exit(1);
+        }
+        if (type == PT_NOTE) {
+            if (!entry) {
+                entry = elfboot_note_entry(elf + offset, filesz,
+                                           align == 8 ? 8 : 4);
+            }
+            continue;
+        }
+        if (!memsz) {
+            continue;
+        }
+        if (filesz > memsz || paddr + memsz < paddr ||
+            paddr + memsz > 4 * GiB) {
+            error_report("%s: bad ELF segment %u", kernel_filename, i);
+            exit(1);
+        }
+        rom_add_blob(kernel_filename, elf + offset, filesz, memsz, paddr,
+                     NULL, NULL, NULL, NULL, true);
+        low = MIN(low, paddr);
+        high = MAX(high, paddr + memsz);
+    }
+
+    if (low >= high) {
+        error_report("%s: no ELF segment to load", kernel_filename);
+        exit(1);
+    }
+    if (entry == 0) {
+        error_report("Error loading uncompressed kernel without PVH ELF Note");
+        exit(1);
+    }
+    pvh_start_addr = entry;
+    fw_cfg_add_i32(fw_cfg, FW_CFG_KERNEL_ENTRY, pvh_start_addr);
+    fw_cfg_add_i32(fw_cfg, FW_CFG_KERNEL_ADDR, low);
+    fw_cfg_add_i32(fw_cfg, FW_CFG_KERNEL_SIZE, high - low);
+
+    /* the setup data handed to the option ROM is that of the ELF file */
+    memset(header, 0, header_size);
+    memcpy(header, elf, MIN(size, header_size));
+    g_free(elf);
+
+    return true;
+}
+
 static bool load_elfboot(const char *kernel_filename,
                          int kernel_file_size,
-                         uint8_t *header,
+                         uint8_t *header, size_t header_size,
                          size_t pvh_xen_start_addr,
                          FWCfgState *fw_cfg)
 {
@@ -752,8 +905,20 @@ static bool load_elfboot(const char *kernel_filename,
     int kernel_size;
 
     if (ldl_p(header) != 0x464c457f) {
+        /* a vmlinux compressed with gzip or zstd */
+        if (lduw_be_p(header) == 0x1f8b ||
+            (uint32_t)ldl_le_p(header) == 0xfd2fb528) {
+            return load_elfboot_image(kernel_filename, header,
+                                      header_size, fw_cfg);
+        }
         return false; /* no elfboot */
     }
+#ifdef EMSCRIPTEN
+    if (image_in_sabfs(kernel_filename)) {
+        return load_elfboot_image(kernel_filename, header, header_size,
+                                  fw_cfg);
+    }
+#endif
 
     bool elf_is64 = header[EI_CLASS] == ELFCLASS64;
     flags = elf_is64 ?
@@ -788,6 +953,39 @@ static bool load_elfboot(const char *kernel_filename,
     return true;
 }
 
+/* Returns the contents of the initrd, which stay around for fw_cfg */
+static gchar *x86_map_initrd(X86MachineState *x86ms, const char *filename,
+                             gsize *size)
+{
+    GMappedFile *mapped_file;
+    GError *gerr = NULL;
+
+#ifdef EMSCRIPTEN
+    /* there is no file to map in SABFS, read it */
+    if (image_in_sabfs(filename)) {
+        gchar *data;
+
+        if (!load_file_contents(filename, &data, size, &gerr)) {
+            fprintf(stderr, "qemu: error reading initrd %s: %s\n",
+                    filename, gerr->message);
+            exit(1);
+        }
+        return data;
+    }
+#endif
+
+    mapped_file = g_mapped_file_new(filename, false, &gerr);
+    if (!mapped_file) {
+        fprintf(stderr, "qemu: error reading initrd %s: %s\n",
+                filename, gerr->message);
+        exit(1);
+    }
+    x86ms->initrd_mapped_file = mapped_file;
+
+    *size = g_mapped_file_get_length(mapped_file);
+    return g_mapped_file_get_contents(mapped_file);
+}
+
 void x86_load_linux(X86MachineState *x86ms,
                     FWCfgState *fw_cfg,
                     int acpi_data_size,
@@ -814,6 +1012,21 @@ void x86_load_linux(X86MachineState *x86ms,
     cmdline_size = (strlen(kernel_cmdline) + 16) & ~15;
 
     /* load the kernel header */
+#ifdef EMSCRIPTEN
+    if (image_in_sabfs(kernel_filename)) {
+        gchar *kernel_image;
+        gsize kernel_image_size;
+
+        /* stays allocated for the FILE, like the kernel copy below */
+        if (load_file_contents(kernel_filename, &kernel_image,
+                               &kernel_image_size, NULL)) {
+            f = fmemopen(kernel_image, kernel_image_size, "rb");
+        } else {
+            errno = EIO;
+            f = NULL;
+        }
+    } else
+#endif
     f = fopen(kernel_filename, "rb");
     if (!f) {
         fprintf(stderr, "qemu: could not open kernel file '%s': %s\n",
@@ -846,13 +1059,14 @@ void x86_load_linux(X86MachineState *x86ms,
             return;
         }
         /*
-         * Check if the file is an uncompressed kernel file (ELF) and load it,
-         * saving the PVH entry point used by the x86/HVM direct boot ABI.
+         * Check if the file is an uncompressed kernel file (ELF), or one
+         * compressed with gzip or zstd, and load it, saving the PVH entry
+         * point used by the x86/HVM direct boot ABI.
          * If load_elfboot() is successful, populate the fw_cfg info.
          */
         if (pvh_enabled &&
             load_elfboot(kernel_filename, kernel_size,
-                         header, pvh_start_addr, fw_cfg)) {
+                         header, sizeof(header), pvh_start_addr, fw_cfg)) {
             fclose(f);
 
             fw_cfg_add_i32(fw_cfg, FW_CFG_CMDLINE_SIZE,
@@ -865,21 +1079,11 @@ void x86_load_linux(X86MachineState *x86ms,
 
             /* load initrd */
             if (initrd_filename) {
-                GMappedFile *mapped_file;
                 gsize initrd_size;
                 gchar *initrd_data;
-                GError *gerr = NULL;
-
-                mapped_file = g_mapped_file_new(initrd_filename, false, &gerr);
-                if (!mapped_file) {
-                    fprintf(stderr, "qemu: error reading initrd %s: %s\n",
-                            initrd_filename, gerr->message);
-                    exit(1);
-                }
-                x86ms->initrd_mapped_file = mapped_file;
 
-                initrd_data = g_mapped_file_get_contents(mapped_file);
-                initrd_size = g_mapped_file_get_length(mapped_file);
+                initrd_data = x86_map_initrd(x86ms, initrd_filename,
+                                             &initrd_size);
                 initrd_max = x86ms->below_4g_mem_size - acpi_data_size - 1;
                 if (initrd_size >= initrd_max) {
                     fprintf(stderr, "qemu: initrd is too large, cannot support."
@@ -1006,26 +1210,15 @@ void x86_load_linux(X86MachineState *x86ms,
 
     /* load initrd */
     if (initrd_filename) {
-        GMappedFile *mapped_file;
         gsize initrd_size;
         gchar *initrd_data;
-        GError *gerr = NULL;
 
         if (protocol < 0x200) {
             fprintf(stderr, "qemu: linux kernel too old to load a ram disk\n");
             exit(1);
         }
 
-        mapped_file = g_mapped_file_new(initrd_filename, false, &gerr);
-        if (!mapped_file) {
-            fprintf(stderr, "qemu: error reading initrd %s: %s\n",
-                    initrd_filename, gerr->message);
-            exit(1);
-        }
-        x86ms->initrd_mapped_file = mapped_file;
-
-        initrd_data = g_mapped_file_get_contents(mapped_file);
-        initrd_size = g_mapped_file_get_length(mapped_file);
+        initrd_data = x86_map_initrd(x86ms, initrd_filename, &initrd_size);
         if (initrd_size >= initrd_max) {
             fprintf(stderr, "qemu: initrd is too large, cannot support."
                     "(max: %"PRIu32", need %"PRId64")\n",
@@ -135,7 +135,7 @@ static char *read_splashfile(char *filename, gsize *file_sizep,
     unsigned int filehead;
     int bmp_bpp;
 
-    if (!g_file_get_contents(filename, &content, file_sizep, &err)) {
+    if (!load_file_contents(filename, &content, file_sizep, &err)) {
         error_report("failed to read splash file '%s': %s",
                      filename, err->message);
         g_error_free(err);
@@ -1242,7 +1242,7 @@ void load_image_to_fw_cfg(FWCfgState *fw_cfg, uint16_t size_key,
         gchar *contents;
         gsize length;
 
-        if (!g_file_get_contents(image_name, &contents, &length, NULL)) {
+        if (!load_file_contents(image_name, &contents, &length, NULL)) {
             error_report("failed to load \"%s\"", image_name);
             exit(1);
         }
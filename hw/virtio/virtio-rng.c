@@ -191,7 +191,12 @@ static void virtio_rng_device_realize(DeviceState *dev, Error **errp)
     }
 
     if (vrng->conf.rng == NULL) {
+#ifdef EMSCRIPTEN
+        /* entropy without a trip through Emscripten's file system */
+        Object *default_backend = object_new(TYPE_RNG_WEBCRYPTO);
+#else
         Object *default_backend = object_new(TYPE_RNG_BUILTIN);
+#endif
 
         if (!user_creatable_complete(USER_CREATABLE(default_backend),
                                      errp)) {
@@ -14,6 +14,7 @@
 #include "qemu/osdep.h"
 #include "qapi/error.h"
 #include "qapi/qapi-commands-virtio.h"
+#include "qapi/visitor.h"
 #include "trace.h"
 #include "qemu/defer-call.h"
 #include "qemu/error-report.h"
@@ -31,6 +32,7 @@
 #include "hw/virtio/virtio-access.h"
 #include "sysemu/dma.h"
 #include "sysemu/runstate.h"
+#include "sysemu/xen.h"
 #include "virtio-qmp.h"
 
 #include "standard-headers/linux/virtio_ids.h"
@@ -152,6 +154,12 @@ struct VirtQueue
     EventNotifier host_notifier;
     bool host_notifier_enabled;
     QLIST_ENTRY(VirtQueue) node;
+
+    /* See virtio_queue_enable_element_pool(), used by the popping thread */
+    VirtQueueElement **elem_pool;
+    unsigned int elem_pool_len;
+    unsigned int elem_pool_num;
+    size_t elem_pool_sz;
 };
 
 const char *virtio_device_names[] = {
@@ -1377,6 +1385,134 @@ int virtqueue_avail_bytes(VirtQueue *vq, unsigned int in_bytes,
     return in_bytes <= in_total && out_bytes <= out_total;
 }
 
+/*
+ * Without an IOMMU, the buffers of a device are almost always in the same
+ * guest RAM range, so remember it and turn guest-physical addresses in it
+ * into host pointers with a range check.  Mapping takes a reference to the
+ * memory region exactly like dma_memory_map() does, so the buffers are
+ * unmapped the usual way.
+ */
+struct VirtIORAMRange {
+    struct rcu_head rcu;
+    MemoryRegion *mr;
+    unsigned gen;
+    bool writable;
+    hwaddr start;
+    hwaddr size;
+    uint8_t *host;
+};
+
+/* Called within call_rcu().  */
+static void virtio_free_ram_range(VirtIORAMRange *range)
+{
+    memory_region_unref(range->mr);
+    g_free(range);
+}
+
+static void virtio_reset_ram_range(VirtIODevice *vdev)
+{
+    VirtIORAMRange *old;
+
+    qatomic_inc(&vdev->ram_range_gen);
+    old = qatomic_xchg(&vdev->ram_range, NULL);
+    if (old) {
+        call_rcu(old, virtio_free_ram_range, rcu);
+    }
+}
+
+static bool virtio_ram_range_usable(VirtIODevice *vdev)
+{
+    return vdev->dma_as == &address_space_memory && !xen_enabled();
+}
+
+/*
+ * Remember the RAM range around @pa, after it was mapped the slow way.
+ * Nothing to do if that is the current range, e.g. for a buffer that
+ * runs past its end.
+ */
+static void virtio_update_ram_range(VirtIODevice *vdev, hwaddr pa)
+{
+    unsigned gen = qatomic_read(&vdev->ram_range_gen);
+    VirtIORAMRange *range, *old;
+    MemoryRegionSection section;
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        range = qatomic_rcu_read(&vdev->ram_range);
+        if (range && range->gen == gen &&
+            pa >= range->start && pa - range->start < range->size) {
+            return;
+        }
+    }
+
+    /* Read the memory map after the generation it belongs to */
+    smp_rmb();
+    section = memory_region_find_flat_range(vdev->dma_as->root, pa);
+    if (!section.mr) {
+        return;
+    }
+    if (!memory_access_is_direct(section.mr, false)) {
+        memory_region_unref(section.mr);
+        return;
+    }
+
+    range = g_new(VirtIORAMRange, 1);
+    *range = (VirtIORAMRange) {
+        .mr = section.mr,
+        .gen = gen,
+        .writable = !section.readonly &&
+                    memory_access_is_direct(section.mr, true),
+        .start = section.offset_within_address_space,
+        .size = int128_get64(section.size),
+        .host = (uint8_t *)memory_region_get_ram_ptr(section.mr) +
+                section.offset_within_region,
+    };
+
+    old = qatomic_xchg(&vdev->ram_range, range);
+    if (old) {
+        call_rcu(old, virtio_free_ram_range, rcu);
+    }
+}
+
+static void *virtqueue_dma_map(VirtIODevice *vdev, hwaddr pa, hwaddr *plen,
+                               bool is_write)
+{
+    VirtIORAMRange *range;
+    void *ptr;
+
+    if (!virtio_ram_range_usable(vdev)) {
+        return dma_memory_map(vdev->dma_as, pa, plen,
+                              is_write ? DMA_DIRECTION_FROM_DEVICE :
+                              DMA_DIRECTION_TO_DEVICE,
+                              MEMTXATTRS_UNSPECIFIED);
+    }
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        range = qatomic_rcu_read(&vdev->ram_range);
+        if (range && range->gen == qatomic_read(&vdev->ram_range_gen) &&
+            pa >= range->start && pa - range->start < range->size &&
+            *plen <= range->size - (pa - range->start) &&
+            (range->writable || !is_write)) {
+            memory_region_ref(range->mr);
+            qatomic_inc(&vdev->ram_range_hits);
+            ptr = range->host + (pa - range->start);
+#ifdef EMSCRIPTEN
+            /* The device keeps the buffer until it pushes the element */
+            ram_cold_access(ptr, *plen, true);
+#endif
+            return ptr;
+        }
+    }
+
+    ptr = dma_memory_map(vdev->dma_as, pa, plen,
+                         is_write ? DMA_DIRECTION_FROM_DEVICE :
+                         DMA_DIRECTION_TO_DEVICE,
+                         MEMTXATTRS_UNSPECIFIED);
+    if (ptr) {
+        virtio_update_ram_range(vdev, pa);
+    }
+    return ptr;
+}
+
 static bool virtqueue_map_desc(VirtIODevice *vdev, unsigned int *p_num_sg,
                                hwaddr *addr, struct iovec *iov,
                                unsigned int max_num_sg, bool is_write,
@@ -1400,11 +1536,7 @@ static bool virtqueue_map_desc(VirtIODevice *vdev, unsigned int *p_num_sg,
             goto out;
         }
 
-        iov[num_sg].iov_base = dma_memory_map(vdev->dma_as, pa, &len,
-                                              is_write ?
-                                              DMA_DIRECTION_FROM_DEVICE :
-                                              DMA_DIRECTION_TO_DEVICE,
-                                              MEMTXATTRS_UNSPECIFIED);
+        iov[num_sg].iov_base = virtqueue_dma_map(vdev, pa, &len, is_write);
         if (!iov[num_sg].iov_base) {
             virtio_error(vdev, "virtio: bogus descriptor or out of resources");
             goto out;
@@ -1450,11 +1582,7 @@ static void virtqueue_map_iovec(VirtIODevice *vdev, struct iovec *sg,
 
     for (i = 0; i < num_sg; i++) {
         len = sg[i].iov_len;
-        sg[i].iov_base = dma_memory_map(vdev->dma_as,
-                                        addr[i], &len, is_write ?
-                                        DMA_DIRECTION_FROM_DEVICE :
-                                        DMA_DIRECTION_TO_DEVICE,
-                                        MEMTXATTRS_UNSPECIFIED);
+        sg[i].iov_base = virtqueue_dma_map(vdev, addr[i], &len, is_write);
         if (!sg[i].iov_base) {
             error_report("virtio: error trying to map MMIO memory");
             exit(1);
@@ -1473,7 +1601,13 @@ void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem)
                                                                         false);
 }
 
-static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_num)
+/*
+ * Elements of the pool of @vq have room for as many descriptors as the
+ * queue, and the layout below puts the arrays of any split of them into
+ * that room. NULL @vq allocates one of the exact size.
+ */
+static void *virtqueue_alloc_element(VirtQueue *vq, size_t sz,
+                                     unsigned out_num, unsigned in_num)
 {
     VirtQueueElement *elem;
     size_t in_addr_ofs = QEMU_ALIGN_UP(sz, __alignof__(elem->in_addr[0]));
@@ -1482,10 +1616,24 @@ static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_nu
     size_t in_sg_ofs = QEMU_ALIGN_UP(out_addr_end, __alignof__(elem->in_sg[0]));
     size_t out_sg_ofs = in_sg_ofs + in_num * sizeof(elem->in_sg[0]);
     size_t out_sg_end = out_sg_ofs + out_num * sizeof(elem->out_sg[0]);
+    bool pooled = vq && vq->elem_pool && sz == vq->elem_pool_sz &&
+                  out_num + in_num <= vq->elem_pool_num;
 
     assert(sz >= sizeof(VirtQueueElement));
-    elem = g_malloc(out_sg_end);
+    if (pooled && vq->elem_pool_len) {
+        elem = vq->elem_pool[--vq->elem_pool_len];
+    } else if (pooled) {
+        size_t room = QEMU_ALIGN_UP(in_addr_ofs +
+                                    vq->elem_pool_num * sizeof(hwaddr),
+                                    __alignof__(struct iovec)) +
+                      vq->elem_pool_num * sizeof(struct iovec);
+
+        elem = g_malloc(room);
+    } else {
+        elem = g_malloc(out_sg_end);
+    }
     trace_virtqueue_alloc_element(elem, sz, in_num, out_num);
+    elem->pooled = pooled;
     elem->out_num = out_num;
     elem->in_num = in_num;
     elem->in_addr = (void *)elem + in_addr_ofs;
@@ -1609,7 +1757,7 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
     }
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_alloc_element(vq, sz, out_num, in_num);
     elem->index = head;
     elem->ndescs = 1;
     for (i = 0; i < out_num; i++) {
@@ -1737,7 +1885,7 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
     } while (rc == VIRTQUEUE_READ_DESC_MORE);
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_alloc_element(vq, sz, out_num, in_num);
     for (i = 0; i < out_num; i++) {
         elem->out_addr[i] = addr[i];
         elem->out_sg[i] = iov[i];
@@ -1919,7 +2067,7 @@ void *qemu_get_virtqueue_element(VirtIODevice *vdev, QEMUFile *f, size_t sz)
     assert(ARRAY_SIZE(data.in_addr) >= data.in_num);
     assert(ARRAY_SIZE(data.out_addr) >= data.out_num);
 
-    elem = virtqueue_alloc_element(sz, data.out_num, data.in_num);
+    elem = virtqueue_alloc_element(NULL, sz, data.out_num, data.in_num);
     elem->index = data.index;
 
     for (i = 0; i < elem->in_num; i++) {
@@ -2338,8 +2486,34 @@ VirtQueue *virtio_add_queue(VirtIODevice *vdev, int queue_size,
     return &vdev->vq[i];
 }
 
+void virtio_queue_enable_element_pool(VirtQueue *vq, size_t sz)
+{
+    assert(!vq->elem_pool && sz >= sizeof(VirtQueueElement));
+    vq->elem_pool_num = vq->vring.num_default;
+    vq->elem_pool_sz = sz;
+    vq->elem_pool = g_new(VirtQueueElement *, vq->elem_pool_num);
+}
+
+void virtqueue_free_element(VirtQueue *vq, void *elem)
+{
+    VirtQueueElement *e = elem;
+
+    if (e && e->pooled && vq->elem_pool &&
+        vq->elem_pool_len < vq->elem_pool_num) {
+        vq->elem_pool[vq->elem_pool_len++] = e;
+    } else {
+        g_free(e);
+    }
+}
+
 void virtio_delete_queue(VirtQueue *vq)
 {
+    while (vq->elem_pool_len) {
+        g_free(vq->elem_pool[--vq->elem_pool_len]);
+    }
+    g_free(vq->elem_pool);
+    vq->elem_pool = NULL;
+    vq->elem_pool_num = 0;
     vq->vring.num = 0;
     vq->vring.num_default = 0;
     vq->handle_output = NULL;
@@ -3646,6 +3820,8 @@ static void virtio_memory_listener_commit(MemoryListener *listener)
     VirtIODevice *vdev = container_of(listener, VirtIODevice, listener);
     int i;
 
+    virtio_reset_ram_range(vdev);
+
     for (i = 0; i < VIRTIO_QUEUE_MAX; i++) {
         if (vdev->vq[i].vring.num == 0) {
             break;
@@ -3689,6 +3865,7 @@ static void virtio_device_unrealize(DeviceState *dev)
     VirtioDeviceClass *vdc = VIRTIO_DEVICE_GET_CLASS(dev);
 
     memory_listener_unregister(&vdev->listener);
+    virtio_reset_ram_range(vdev);
     virtio_bus_device_unplugged(vdev);
 
     if (vdc->unrealize != NULL) {
@@ -3854,6 +4031,16 @@ void virtio_device_release_ioeventfd(VirtIODevice *vdev)
     virtio_bus_release_ioeventfd(vbus);
 }
 
+static void virtio_device_get_ram_range_hits(Object *obj, Visitor *v,
+                                             const char *name, void *opaque,
+                                             Error **errp)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(obj);
+    uint32_t value = qatomic_read(&vdev->ram_range_hits);
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
 static void virtio_device_class_init(ObjectClass *klass, void *data)
 {
     /* Set the default value here. */
@@ -3864,6 +4051,9 @@ static void virtio_device_class_init(ObjectClass *klass, void *data)
     dc->unrealize = virtio_device_unrealize;
     dc->bus_type = TYPE_VIRTIO_BUS;
     device_class_set_props(dc, virtio_properties);
+    object_class_property_add(klass, "x-ram-range-hits", "uint32",
+                              virtio_device_get_ram_range_hits,
+                              NULL, NULL, NULL);
     vdc->start_ioeventfd = virtio_device_start_ioeventfd_impl;
     vdc->stop_ioeventfd = virtio_device_stop_ioeventfd_impl;
 
@@ -94,6 +94,21 @@ struct BlockAcctStats {
     BlockLatencyHistogram latency_histogram[BLOCK_MAX_IOTYPE];
 };
 
+enum BlockAcctCacheEvent {
+    BLOCK_ACCT_CACHE_HIT,           /* read served from the cache */
+    BLOCK_ACCT_CACHE_MISS,          /* read that waited for the child */
+    BLOCK_ACCT_CACHE_READAHEAD,     /* read ahead of the guest */
+    BLOCK_ACCT_CACHE_COALESCE,      /* write kept in the cache */
+    BLOCK_ACCT_CACHE_WRITEBACK,     /* cached data written back */
+    BLOCK_MAX_CACHE_EVENT,
+};
+
+/* What the cache of a caching filter driver did, in its AioContext */
+typedef struct BlockAcctCacheStats {
+    uint64_t nr_ops[BLOCK_MAX_CACHE_EVENT];
+    uint64_t nr_bytes[BLOCK_MAX_CACHE_EVENT];
+} BlockAcctCacheStats;
+
 typedef struct BlockAcctCookie {
     int64_t bytes;
     int64_t start_time_ns;
@@ -120,5 +135,7 @@ double block_acct_queue_depth(BlockAcctTimedStats *stats,
 int block_latency_histogram_set(BlockAcctStats *stats, enum BlockAcctType type,
                                 uint64List *boundaries);
 void block_latency_histograms_clear(BlockAcctStats *stats);
+void block_acct_cache_event(BlockAcctCacheStats *stats,
+                            enum BlockAcctCacheEvent event, int64_t bytes);
 
 #endif
@@ -380,6 +380,16 @@ void aio_notify(AioContext *ctx);
  */
 void aio_notify_accept(AioContext *ctx);
 
+#ifdef EMSCRIPTEN
+/**
+ * fdmon_wasm_notify: Wake up threads sleeping in aio_poll().
+ *
+ * Called by event_notifier_set() and exported so that I/O sources outside
+ * of QEMU can signal that one of their file descriptors became ready.
+ */
+void fdmon_wasm_notify(void);
+#endif
+
 /**
  * aio_bh_call: Executes callback function of the specified BH.
  */
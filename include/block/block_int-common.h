@@ -57,6 +57,7 @@
 #define BLOCK_OPT_DATA_FILE_RAW     "data_file_raw"
 #define BLOCK_OPT_COMPRESSION_TYPE  "compression_type"
 #define BLOCK_OPT_EXTL2             "extended_l2"
+#define BLOCK_OPT_METADATA_FRONT    "metadata_front"
 
 #define BLOCK_PROBE_BUF_SIZE        512
 
@@ -880,6 +881,13 @@ typedef struct BlockLimits {
      */
     bool has_variable_length;
 
+    /*
+     * true if every request is a round trip over the network, e.g. for
+     * images fetched lazily over HTTP or a WebSocket.  Format drivers may
+     * keep more metadata in memory when reading it costs this much.
+     */
+    bool high_latency;
+
     /* device zone model */
     BlockZoneModel zoned;
 
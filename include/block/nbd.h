@@ -475,6 +475,7 @@ const char *nbd_mode_lookup(NBDMode mode);
 
 /* nbd/client-connection.c */
 void nbd_client_connection_enable_retry(NBDClientConnection *conn);
+void nbd_client_connection_enable_websocket(NBDClientConnection *conn);
 
 NBDClientConnection *nbd_client_connection_new(const SocketAddress *saddr,
                                                bool do_negotiation,
@@ -76,6 +76,13 @@ void luring_detach_aio_context(LuringState *s, AioContext *old_context);
 void luring_attach_aio_context(LuringState *s, AioContext *new_context);
 #endif
 
+/* emfs-aio.c - Emscripten filesystem, batched on the browser main thread */
+#ifdef EMSCRIPTEN
+int coroutine_fn emfs_aio_co_submit(int fd, uint64_t offset,
+                                    QEMUIOVector *qiov, int type);
+int64_t coroutine_fn emfs_aio_co_getlength(int fd);
+#endif
+
 #ifdef _WIN32
 typedef struct QEMUWin32AIOState QEMUWin32AIOState;
 QEMUWin32AIOState *win32_aio_init(void);
@@ -238,6 +238,8 @@ OBJECT_DECLARE_TYPE(Chardev, ChardevClass, CHARDEV)
 #define TYPE_CHARDEV_STDIO "chardev-stdio"
 #define TYPE_CHARDEV_PIPE "chardev-pipe"
 #define TYPE_CHARDEV_MEMORY "chardev-memory"
+#define TYPE_CHARDEV_SABRING "chardev-sabring"
+#define TYPE_CHARDEV_SABFS_XFER "chardev-sabfs-xfer"
 #define TYPE_CHARDEV_PARALLEL "chardev-parallel"
 #define TYPE_CHARDEV_FILE "chardev-file"
 #define TYPE_CHARDEV_SERIAL "chardev-serial"
@@ -55,8 +55,14 @@
 #include "exec/target_long.h"
 
 #if defined(CONFIG_SOFTMMU) && defined(CONFIG_TCG)
+#ifdef EMSCRIPTEN
+/* A miss costs a helper call out of the wasm code, keep more entries */
+#define CPU_TLB_DYN_MIN_BITS 8
+#define CPU_TLB_DYN_DEFAULT_BITS 10
+#else
 #define CPU_TLB_DYN_MIN_BITS 6
 #define CPU_TLB_DYN_DEFAULT_BITS 8
+#endif
 
 # if HOST_LONG_BITS == 32
 /* Make sure we do not require a double-word shift for the TLB load */
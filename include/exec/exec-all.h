@@ -157,6 +157,16 @@ void tlb_flush_page_by_mmuidx_all_cpus_synced(CPUState *cpu, vaddr addr,
  * MMU indexes.
  */
 void tlb_flush_by_mmuidx(CPUState *cpu, uint16_t idxmap);
+/**
+ * tlb_flush_nonglobal_by_mmuidx:
+ * @cpu: CPU whose TLB should be flushed
+ * @idxmap: bitmap of MMU indexes to flush
+ *
+ * Flush the entries of the specified CPU, for the specified MMU indexes,
+ * except for those installed with CPUTLBEntryFull.global set, as a guest
+ * TLB does on an address space switch.
+ */
+void tlb_flush_nonglobal_by_mmuidx(CPUState *cpu, uint16_t idxmap);
 /**
  * tlb_flush_by_mmuidx_all_cpus:
  * @cpu: Originating CPU of the flush
@@ -311,6 +321,10 @@ static inline void tlb_flush_page_by_mmuidx(CPUState *cpu,
 static inline void tlb_flush_by_mmuidx(CPUState *cpu, uint16_t idxmap)
 {
 }
+static inline void tlb_flush_nonglobal_by_mmuidx(CPUState *cpu,
+                                                 uint16_t idxmap)
+{
+}
 static inline void tlb_flush_page_by_mmuidx_all_cpus(CPUState *cpu,
                                                      vaddr addr,
                                                      uint16_t idxmap)
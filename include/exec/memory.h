@@ -28,6 +28,9 @@
 #include "qemu/notify.h"
 #include "qom/object.h"
 #include "qemu/rcu.h"
+#ifdef EMSCRIPTEN
+#include "sysemu/ram-cold.h"
+#endif
 
 #define RAM_ADDR_INVALID (~(ram_addr_t)0)
 
@@ -2492,6 +2495,20 @@ void memory_region_set_ram_discard_manager(MemoryRegion *mr,
 MemoryRegionSection memory_region_find(MemoryRegion *mr,
                                        hwaddr addr, uint64_t size);
 
+/**
+ * memory_region_find_flat_range: find the flat range containing an address
+ *
+ * Like memory_region_find() with a @size of 1, except that the section
+ * returned is not clipped to @addr: it covers the whole range of the
+ * flattened memory map that @addr falls in, with the same #MemoryRegion
+ * at contiguous offsets.
+ *
+ * @mr: the root of an address space
+ * @addr: address within the address space
+ */
+MemoryRegionSection memory_region_find_flat_range(MemoryRegion *mr,
+                                                  hwaddr addr);
+
 /**
  * memory_global_dirty_log_sync: synchronize the dirty log for all memory
  *
@@ -2996,6 +3013,9 @@ MemTxResult address_space_read(AddressSpace *as, hwaddr addr,
             mr = flatview_translate(fv, addr, &addr1, &l, false, attrs);
             if (len == l && memory_access_is_direct(mr, false)) {
                 ptr = qemu_map_ram_ptr(mr->ram_block, addr1);
+#ifdef EMSCRIPTEN
+                ram_cold_access(ptr, len, false);
+#endif
                 memcpy(buf, ptr, len);
             } else {
                 result = flatview_read_continue(fv, addr, attrs, buf, len,
@@ -23,6 +23,18 @@
  */
 void tb_flush(CPUState *cs);
 
+/**
+ * tb_retire_oldest() - drop the translation blocks of the oldest region
+ *
+ * Invalidates the translation blocks in the region of code_gen_buffer
+ * that filled up first, and hands the region back to the allocator once
+ * no vCPU can be running them any more. Unlike tb_flush() this runs in
+ * the calling thread and leaves the other vCPUs and the rest of the code
+ * alone; only for CF_PCREL translation blocks are the jump caches of all
+ * vCPUs flushed, once. Called with mmap_lock held for user-mode emulation.
+ */
+void tb_retire_oldest(void);
+
 void tcg_flush_jmp_cache(CPUState *cs);
 
 #endif /* _TB_FLUSH_H_ */
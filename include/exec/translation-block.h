@@ -140,6 +140,11 @@ struct TranslationBlock {
     uintptr_t jmp_list_head;
     uintptr_t jmp_list_next[2];
     uintptr_t jmp_dest[2];
+
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    /* When the TB was translated, for wasm32 tier-up statistics */
+    int64_t wasm_gen_time;
+#endif
 };
 
 /* The alignment given to TranslationBlock during allocation. */
@@ -30,6 +30,7 @@
 #include "qemu/bitmap.h"
 #include "qemu/rcu_queue.h"
 #include "qemu/queue.h"
+#include "qemu/stats64.h"
 #include "qemu/thread.h"
 #include "qemu/plugin-event.h"
 #include "qom/object.h"
@@ -199,8 +200,22 @@ struct CPUClass {
  */
 #define NB_MMU_MODES 16
 
-/* Use a fully associative victim tlb of 8 entries. */
+/*
+ * Use a fully associative victim tlb of 8 entries, or 32 on wasm where
+ * refilling an entry through tlb_fill costs much more than the search.
+ */
+#ifdef EMSCRIPTEN
+#define CPU_VTLB_SIZE 32
+#else
 #define CPU_VTLB_SIZE 8
+#endif
+
+/*
+ * Track the large pages of each mmu_idx as a few separate regions, so
+ * that a kernel mapping itself and its direct map with large pages does
+ * not lose the whole tlb on every flush of a page in either.
+ */
+#define CPU_TLB_LARGE_PAGES 4
 
 /*
  * The full TLB entry, which is not accessed by generated TCG code,
@@ -234,6 +249,9 @@ typedef struct CPUTLBEntryFull {
     /* @lg_page_size contains the log2 of the page size. */
     uint8_t lg_page_size;
 
+    /* @global is set for pages kept by tlb_flush_nonglobal_by_mmuidx. */
+    bool global;
+
     /*
      * Additional tlb flags for use by the slow path. If non-zero,
      * the corresponding CPUTLBEntry comparator must have TLB_FORCE_SLOW.
@@ -268,13 +286,16 @@ typedef struct CPUTLBEntryFull {
  */
 typedef struct CPUTLBDesc {
     /*
-     * Describe a region covering all of the large pages allocated
-     * into the tlb.  When any page within this region is flushed,
-     * we must flush the entire tlb.  The region is matched if
-     * (addr & large_page_mask) == large_page_addr.
+     * Describe up to CPU_TLB_LARGE_PAGES disjoint regions covering all
+     * of the large pages allocated into the tlb.  When any page within
+     * a region is flushed, we must flush every entry of that region.
+     * A region is matched if (page & mask) == addr.
      */
-    vaddr large_page_addr;
-    vaddr large_page_mask;
+    struct {
+        vaddr addr;
+        vaddr mask;
+    } large_page[CPU_TLB_LARGE_PAGES];
+    unsigned n_large_pages;
     /* host time (in ns) at the beginning of the time window */
     int64_t window_begin_ns;
     /* maximum number of entries observed in the window */
@@ -282,6 +303,11 @@ typedef struct CPUTLBDesc {
     size_t n_used_entries;
     /* The next index to use in the tlb victim table.  */
     size_t vindex;
+#ifdef EMSCRIPTEN
+    /* Misses of the main tlb found in the victim tlb, and the others */
+    size_t n_victim_hits;
+    size_t n_victim_misses;
+#endif
     /* The tlb victim table, in two parts.  */
     CPUTLBEntry vtable[CPU_VTLB_SIZE];
     CPUTLBEntryFull vfulltlb[CPU_VTLB_SIZE];
@@ -415,6 +441,10 @@ struct qemu_work_item;
  * @created: Indicates whether the CPU thread has been successfully created.
  * @interrupt_request: Indicates a pending interrupt request.
  * @halted: Nonzero if the CPU is in suspended state.
+ * @halt_futex: Bumped by qemu_cpu_kick(), halted vCPU threads sleep on it
+ *   with Atomics.wait (emscripten only).
+ * @halted_ns: Time the vCPU thread slept while the vCPU was idle, and
+ * @halt_wakeups: how often it woke up from that (emscripten only).
  * @stop: Indicates a pending stop request.
  * @stopped: Indicates the CPU has been artificially stopped.
  * @unplug: Indicates a pending CPU unplug request.
@@ -471,6 +501,11 @@ struct CPUState {
     int thread_id;
     bool running, has_waiter;
     struct QemuCond *halt_cond;
+#ifdef EMSCRIPTEN
+    uint32_t halt_futex;
+    Stat64 halted_ns;
+    Stat64 halt_wakeups;
+#endif
     bool thread_kicked;
     bool created;
     bool stop;
@@ -605,6 +640,14 @@ extern __thread CPUState *current_cpu;
 extern bool mttcg_enabled;
 #define qemu_tcg_mttcg_enabled() (mttcg_enabled)
 
+/*
+ * With -accel tcg,thread=auto, vCPUs have a thread each as with MTTCG,
+ * but only mttcg_auto_slots of them run guest code at once. That is 0
+ * until it is decided, a few seconds after the vCPUs start.
+ */
+extern bool mttcg_auto;
+extern unsigned mttcg_auto_slots;
+
 /**
  * cpu_paging_enabled:
  * @cpu: The CPU whose state is to be inspected.
@@ -1026,6 +1069,14 @@ void cpu_exec_end(CPUState *cpu);
  */
 void start_exclusive(void);
 
+/**
+ * cpu_exclusive_wait_ns:
+ *
+ * Returns the host time, in nanoseconds, that threads spent waiting to
+ * start an exclusive section or for one to end.
+ */
+uint64_t cpu_exclusive_wait_ns(void);
+
 /**
  * end_exclusive:
  *
@@ -28,6 +28,26 @@ int64_t get_image_size(const char *filename);
  * errno is also set as appropriate.
  */
 ssize_t load_image_size(const char *filename, void *addr, size_t size);
+/**
+ * load_file_contents: read a whole file into a new buffer
+ * @filename: Path to the file
+ * @contents: Set to the contents, NUL-terminated, to be freed with g_free()
+ * @length: Set to the length of the contents if not NULL
+ * @error: Set on failure
+ *
+ * Like g_file_get_contents(), but files of SABFS are read directly on wasm
+ * hosts, which fetches the files of lazy mounts only when they are loaded.
+ *
+ * Returns true on success.
+ */
+bool load_file_contents(const char *filename, char **contents,
+                        gsize *length, GError **error);
+#ifdef EMSCRIPTEN
+/**
+ * image_in_sabfs: whether @filename names a regular file of SABFS
+ */
+bool image_in_sabfs(const char *filename);
+#endif
 
 /**load_image_targphys_as:
  * @filename: Path to the image file
@@ -86,6 +106,21 @@ ssize_t load_image_gzipped_buffer(const char *filename, uint64_t max_sz,
                                   uint8_t **buffer);
 ssize_t load_image_gzipped(const char *filename, hwaddr addr, uint64_t max_sz);
 
+/**
+ * load_file_inflated: read a whole file, decompressing it if needed
+ * @filename: Path to the file
+ * @size: Set to the size of the returned data
+ * @errp: Set on failure
+ *
+ * Reads @filename with load_file_contents(). Files compressed with gzip,
+ * or with zstd when QEMU is built with it, are recognized by their magic
+ * number and returned decompressed, up to LOAD_IMAGE_MAX_GUNZIP_BYTES.
+ * Other files are returned as they are.
+ *
+ * Returns the data, to be freed with g_free(), or NULL on failure.
+ */
+uint8_t *load_file_inflated(const char *filename, size_t *size, Error **errp);
+
 /**
  * unpack_efi_zboot_image:
  * @buffer: pointer to a variable holding the address of a buffer containing the
@@ -79,6 +79,7 @@ struct virtio_gpu_scanout {
     int x, y;
     int invalidate;
     uint32_t resource_id;
+    struct virtio_gpu_framebuffer fb;
     struct virtio_gpu_update_cursor cursor;
     QEMUCursor *current_cursor;
 };
@@ -324,6 +325,11 @@ int virtio_gpu_update_dmabuf(VirtIOGPU *g,
                              struct virtio_gpu_simple_resource *res,
                              struct virtio_gpu_framebuffer *fb,
                              struct virtio_gpu_rect *r);
+#ifdef EMSCRIPTEN
+void virtio_gpu_sync_blob(struct virtio_gpu_simple_resource *res,
+                          uint64_t offset, uint32_t stride,
+                          uint32_t bytes, uint32_t rows);
+#endif
 
 /* virtio-gpu-3d.c */
 void virtio_gpu_virgl_process_cmd(VirtIOGPU *g,
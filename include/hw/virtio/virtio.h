@@ -58,6 +58,7 @@ size_t virtio_get_config_size(const VirtIOConfigSizeParams *params,
                               uint64_t host_features);
 
 typedef struct VirtQueue VirtQueue;
+typedef struct VirtIORAMRange VirtIORAMRange;
 
 #define VIRTQUEUE_MAX_SIZE 1024
 
@@ -68,6 +69,8 @@ typedef struct VirtQueueElement
     unsigned int ndescs;
     unsigned int out_num;
     unsigned int in_num;
+    /* allocated for the queue's element pool */
+    bool pooled;
     hwaddr *in_addr;
     hwaddr *out_addr;
     struct iovec *in_sg;
@@ -157,6 +160,14 @@ struct VirtIODevice
      */
     bool use_guest_notifier_mask;
     AddressSpace *dma_as;
+    /**
+     * @ram_range: guest RAM range that buffers were last mapped from,
+     * valid while @ram_range_gen is unchanged (RCU)
+     */
+    VirtIORAMRange *ram_range;
+    unsigned ram_range_gen;
+    /* buffers mapped in @ram_range, for the x-ram-range-hits property */
+    uint32_t ram_range_hits;
     QLIST_HEAD(, VirtQueue) *vector_queues;
     QTAILQ_ENTRY(VirtIODevice) next;
     /**
@@ -264,6 +275,29 @@ void virtqueue_fill(VirtQueue *vq, const VirtQueueElement *elem,
 
 void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem);
 void *virtqueue_pop(VirtQueue *vq, size_t sz);
+
+/**
+ * virtio_queue_enable_element_pool:
+ * @vq: the queue
+ * @sz: size of the elements the device pops, as passed to virtqueue_pop()
+ *
+ * Keep the elements of @vq given back with virtqueue_free_element() for
+ * the next pops, up to one per descriptor of the queue, so that a device
+ * with requests in flight all the time stops allocating them. Elements
+ * with more descriptors than the queue has, through indirect tables, are
+ * allocated as usual.
+ */
+void virtio_queue_enable_element_pool(VirtQueue *vq, size_t sz);
+
+/**
+ * virtqueue_free_element:
+ * @vq: the queue @elem was popped from
+ * @elem: the element, after it was pushed or detached
+ *
+ * Frees @elem, or keeps it for reuse if @vq has an element pool. Same as
+ * g_free() otherwise.
+ */
+void virtqueue_free_element(VirtQueue *vq, void *elem);
 unsigned int virtqueue_drop_all(VirtQueue *vq);
 void *qemu_get_virtqueue_element(VirtIODevice *vdev, QEMUFile *f, size_t sz);
 void qemu_put_virtqueue_element(VirtIODevice *vdev, QEMUFile *f,
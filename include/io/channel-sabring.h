@@ -0,0 +1,68 @@
+/*
+ * QEMU I/O channel over rings in shared wasm memory
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QIO_CHANNEL_SABRING_H
+#define QIO_CHANNEL_SABRING_H
+
+#include "io/channel.h"
+#include "qapi/qapi-types-sockets.h"
+#include "qemu/sabring.h"
+#include "qemu/thread.h"
+#include "qom/object.h"
+
+#define TYPE_QIO_CHANNEL_SABRING "qio-channel-sabring"
+OBJECT_DECLARE_SIMPLE_TYPE(QIOChannelSabring, QIO_CHANNEL_SABRING)
+
+typedef struct QIOChannelSabringShared QIOChannelSabringShared;
+
+/**
+ * QIOChannelSabring:
+ *
+ * A byte stream whose far end is a WebSocket opened by an I/O worker of
+ * the page. The bytes go through a pair of rings in the SharedArrayBuffer
+ * of the wasm memory, so reads and writes neither call into JavaScript
+ * nor are proxied to the browser main thread.
+ */
+struct QIOChannelSabring {
+    QIOChannel parent;
+    QIOChannelSabringShared *shared;
+    QemuMutex lock;
+    SabRingWaiter waiter;
+    bool blocking;
+    AioContext *read_ctx;
+    IOHandler *io_read;
+    AioContext *write_ctx;
+    IOHandler *io_write;
+    void *handler_opaque;
+};
+
+/**
+ * qio_channel_sabring_new:
+ *
+ * Create a channel that isn't connected yet.
+ *
+ * Returns: the new channel object
+ */
+QIOChannelSabring *qio_channel_sabring_new(void);
+
+/**
+ * qio_channel_sabring_connect_sync:
+ * @ioc: the channel
+ * @addr: the address of the WebSocket endpoint, of type inet
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Ask the I/O worker to open a WebSocket to @addr and wait until it
+ * did or gave up. Call it from a thread other than the main thread, as
+ * the worker may need the main thread to start.
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int qio_channel_sabring_connect_sync(QIOChannelSabring *ioc,
+                                     SocketAddress *addr,
+                                     Error **errp);
+
+#endif /* QIO_CHANNEL_SABRING_H */
@@ -74,4 +74,15 @@ void qemu_coroutine_delete(Coroutine *co);
 CoroutineAction qemu_coroutine_switch(Coroutine *from, Coroutine *to,
                                       CoroutineAction action);
 
+#ifdef EMSCRIPTEN
+/*
+ * COROUTINE_STACK_SIZE buffers for the C and asyncify stacks of the
+ * emscripten backends, freed ones are reused.
+ */
+void *qemu_coroutine_stack_alloc(void);
+void qemu_coroutine_stack_free(void *stack);
+/* Usage and high-water mark of the buffers, for "info jit" */
+void qemu_coroutine_stack_dump_info(GString *buf);
+#endif
+
 #endif
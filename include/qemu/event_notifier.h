@@ -25,6 +25,10 @@ struct EventNotifier {
     int rfd;
     int wfd;
     bool initialized;
+#ifdef EMSCRIPTEN
+    uint32_t pending; /* set but not yet cleared, see event_notifier_set() */
+    bool doorbell;    /* the pipe is never written, see event_notifier_init() */
+#endif
 #endif
 };
 
@@ -35,6 +39,11 @@ void event_notifier_cleanup(EventNotifier *);
 int event_notifier_set(EventNotifier *);
 int event_notifier_test_and_clear(EventNotifier *);
 
+#ifdef EMSCRIPTEN
+bool event_notifier_doorbell_fd(int fd);
+bool event_notifier_doorbell_rung(int fd);
+#endif
+
 #ifdef CONFIG_POSIX
 void event_notifier_init_fd(EventNotifier *, int fd);
 int event_notifier_get_fd(const EventNotifier *);
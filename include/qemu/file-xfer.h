@@ -0,0 +1,64 @@
+/*
+ * Wire format of the bulk file transfer channel
+ *
+ * Spoken over a virtio-serial port between the guest agent, which runs
+ * the guest-file-push and guest-file-pull commands, and the sabfs-xfer
+ * chardev on the host, which serves the files from SABFS. File data goes
+ * through the port as raw bytes, not base64 in JSON as with
+ * guest-file-read/write, and the host end copies it between the virtqueue
+ * buffers and the SABFS blocks without staging it.
+ *
+ * Every request starts with a FileXferHdr, all fields little-endian:
+ *
+ * OPEN   len bytes of host path follow. flags FILE_XFER_F_WRITE creates or
+ *        truncates the file, otherwise it is opened for reading. The reply
+ *        has the size of the file in offset.
+ * WRITE  len bytes of data follow, for offset. There is no reply, so the
+ *        guest streams writes back to back; an error is latched and
+ *        returned by CLOSE.
+ * READ   asks for len bytes from offset. The reply has the number of bytes
+ *        that follow it in len, fewer only at the end of the file.
+ * CLOSE  closes the file. The reply has the first error of the writes.
+ *
+ * There is one open file per port, and at most one request waiting for
+ * its reply. status of a reply is 0 or a negative errno.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_FILE_XFER_H
+#define QEMU_FILE_XFER_H
+
+#define FILE_XFER_MAGIC         0x52465851  /* "QXFR" */
+
+/* Name of the port, found in /dev/virtio-ports/ of a Linux guest */
+#define FILE_XFER_PORT_NAME     "org.qemu.guest_agent.xfer"
+
+/* Size of the WRITEs of the agent, and of its buffer for READs */
+#define FILE_XFER_CHUNK         (1024 * 1024)
+
+/* Largest READ of the agent, it streams whole files of up to that size */
+#define FILE_XFER_READ_MAX      (1024 * 1024 * 1024)
+
+enum {
+    FILE_XFER_OP_OPEN = 1,
+    FILE_XFER_OP_WRITE = 2,
+    FILE_XFER_OP_READ = 3,
+    FILE_XFER_OP_CLOSE = 4,
+};
+
+#define FILE_XFER_F_WRITE       0x0001
+
+typedef struct QEMU_PACKED FileXferHdr {
+    uint32_t magic;
+    uint16_t op;
+    uint16_t flags;
+    uint32_t len;
+    int32_t status;
+    uint64_t offset;
+} FileXferHdr;
+
+QEMU_BUILD_BUG_ON(sizeof(FileXferHdr) != 24);
+
+#endif /* QEMU_FILE_XFER_H */
@@ -36,6 +36,8 @@ OBJECT_DECLARE_TYPE(MainLoop, MainLoopClass, MAIN_LOOP)
 
 struct MainLoop {
     EventLoopBase parent_obj;
+
+    int64_t timer_slack;
 };
 typedef struct MainLoop MainLoop;
 
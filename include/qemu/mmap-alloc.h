@@ -40,6 +40,24 @@ void *qemu_ram_mmap(int fd,
 
 void qemu_ram_munmap(int fd, void *ptr, size_t size);
 
+#ifdef EMSCRIPTEN
+/*
+ * qemu_ram_discard: make anonymous RAM from qemu_ram_mmap() read as zeroes,
+ * giving it back to the browser where the engine allows it
+ */
+void qemu_ram_discard(void *ptr, size_t size);
+
+/* Granule of WebAssembly.Memory.prototype.discard() */
+#define WASM_PAGE_SIZE (64 * KiB)
+
+/*
+ * qemu_ram_decommit: hand whole wasm pages, @ptr and @size aligned to
+ * WASM_PAGE_SIZE, back to the browser; they read as zeroes afterwards.
+ * Returns false, leaving them alone, if the engine can't take them.
+ */
+bool qemu_ram_decommit(void *ptr, size_t size);
+#endif
+
 /*
  * Abstraction of PROT_ and MAP_ flags as passed to mmap(), for example,
  * consumed by qemu_ram_mmap().
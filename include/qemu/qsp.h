@@ -19,6 +19,8 @@ enum QSPSortBy {
 void qsp_report(size_t max, enum QSPSortBy sort_by,
                 bool callsite_coalesce);
 
+void qsp_spin_lock(QemuSpin *spin, const char *file, int line);
+
 bool qsp_is_enabled(void);
 void qsp_enable(void);
 void qsp_disable(void);
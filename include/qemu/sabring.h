@@ -0,0 +1,81 @@
+/*
+ * Rings in shared wasm memory
+ *
+ * A SabRing carries bytes in one direction between QEMU and a worker of
+ * the page: it lives in the SharedArrayBuffer of the wasm memory, and the
+ * side that moves it wakes the other with a futex (Atomics.notify in JS).
+ * The netdev, the chardev and the I/O channel called sabring all use it,
+ * each with its own framing of the bytes.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_SABRING_H
+#define QEMU_SABRING_H
+
+#include "qemu/thread.h"
+
+/*
+ * One direction. head and tail are free-running byte counters, written
+ * only by the producer and the consumer respectively. user[] is for the
+ * fields a particular use of the ring shares with the other side.
+ */
+typedef struct SabRing {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t size;      /* of data[], a power of 2 */
+    uint32_t dropped;   /* records the producer found no room for */
+    uint32_t user[4];
+    uint8_t data[];
+} SabRing;
+
+/* Bytes taken by a ring with @size bytes of data */
+static inline size_t sab_ring_footprint(uint32_t size)
+{
+    return sizeof(SabRing) + size;
+}
+
+/* Clears the header of a ring at @r with @size bytes of data */
+void sab_ring_init(SabRing *r, uint32_t size);
+
+/* The ring that follows @r in memory, as the rings of a pair are laid out */
+static inline SabRing *sab_ring_next(SabRing *r)
+{
+    return (SabRing *)(r->data + r->size);
+}
+
+/* Free bytes, for the producer */
+static inline uint32_t sab_ring_room(SabRing *r)
+{
+    return r->size - (r->head - qatomic_load_acquire(&r->tail));
+}
+
+/* Copy @len bytes in at byte counter @pos, wrapping around the end */
+void sab_ring_copy_in(SabRing *r, uint32_t pos, const void *buf, size_t len);
+
+/* Copy @len bytes out from byte counter @pos, wrapping around the end */
+void sab_ring_copy_out(SabRing *r, uint32_t pos, void *buf, size_t len);
+
+/*
+ * A thread sleeping on a futex word that the other side wakes, such as
+ * the head of a ring it produces into, and calling notify() from there
+ * each time the word changed, as well as once at start.
+ */
+typedef struct SabRingWaiter {
+    QemuThread thread;
+    uint32_t *word;
+    void (*notify)(void *opaque);
+    void *opaque;
+    bool running;
+    bool stop;
+    bool exited;
+} SabRingWaiter;
+
+void sab_ring_waiter_start(SabRingWaiter *w, const char *name, uint32_t *word,
+                           void (*notify)(void *opaque), void *opaque);
+
+/* Stops and joins the thread, if it was started */
+void sab_ring_waiter_stop(SabRingWaiter *w);
+
+#endif /* QEMU_SABRING_H */
@@ -762,6 +762,17 @@ int qemu_timeout_ns_to_ms(int64_t ns);
  */
 int qemu_poll_ns(GPollFD *fds, guint nfds, int64_t timeout);
 
+#ifdef EMSCRIPTEN
+/*
+ * qemu_poll_ns() on wasm hosts, which sleeps in a futex wait that
+ * fdmon_wasm_notify() ends (util/fdmon-wasm.c)
+ */
+int qemu_poll_ns_wasm(GPollFD *fds, guint nfds, int64_t timeout);
+
+/* How often threads woke up in qemu_poll_ns() and aio_poll() so far */
+uint64_t fdmon_wasm_wakeups(void);
+#endif
+
 /**
  * qemu_soonest_timeout:
  * @timeout1: first timeout in nanoseconds (or -1 for infinite)
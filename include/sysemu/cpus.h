@@ -26,6 +26,10 @@ bool all_cpu_threads_idle(void);
 bool cpu_can_run(CPUState *cpu);
 void qemu_wait_io_event_common(CPUState *cpu);
 void qemu_wait_io_event(CPUState *cpu);
+#ifdef EMSCRIPTEN
+/* Counts a wakeup after the vCPU thread slept ns while @cpu was idle */
+void cpu_account_halt(CPUState *cpu, int64_t ns);
+#endif
 void cpu_thread_signal_created(CPUState *cpu);
 void cpu_thread_signal_destroyed(CPUState *cpu);
 void cpu_handle_guest_debug(CPUState *cpu);
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Compression of cold guest RAM in the wasm memory
+ */
+
+#ifndef SYSEMU_RAM_COLD_H
+#define SYSEMU_RAM_COLD_H
+
+#ifdef EMSCRIPTEN
+/**
+ * ram_cold_init:
+ *
+ * Start tracking the RAM of memory backends, so that the pages devices
+ * hold pointers to are known once compression is enabled.
+ */
+void ram_cold_init(void);
+
+/**
+ * ram_cold_access:
+ * @host: host address in guest RAM
+ * @len: length of the access
+ * @pin: whether the caller may keep the pointer after returning
+ *
+ * Call before using a host pointer to guest RAM. Brings back the pages
+ * of the range that were compressed and counts them as accessed. With
+ * @pin, typically because a device mapped the range for DMA, its pages
+ * are not compressed until ram_cold_unpin() is called for the range.
+ */
+void ram_cold_access(void *host, size_t len, bool pin);
+
+/**
+ * ram_cold_unpin:
+ * @host: host address in guest RAM
+ * @len: length of the range
+ *
+ * Drop a pin that ram_cold_access() took for the same range, once the
+ * mapping is no longer used.
+ */
+void ram_cold_unpin(void *host, size_t len);
+
+/**
+ * ram_cold_drop:
+ * @host: host address in guest RAM
+ * @len: length of the range
+ *
+ * Forget the compressed copies of pages in the range, whose contents are
+ * being discarded.
+ */
+void ram_cold_drop(void *host, size_t len);
+
+/**
+ * ram_cold_unpack_all:
+ *
+ * Bring back all compressed pages, for code that reads or writes RAM
+ * blocks directly, such as migration.
+ */
+void ram_cold_unpack_all(void);
+#endif
+
+#endif /* SYSEMU_RAM_COLD_H */
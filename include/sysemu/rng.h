@@ -21,6 +21,7 @@ OBJECT_DECLARE_TYPE(RngBackend, RngBackendClass,
                     RNG_BACKEND)
 
 #define TYPE_RNG_BUILTIN "rng-builtin"
+#define TYPE_RNG_WEBCRYPTO "rng-webcrypto"
 
 typedef struct RngRequest RngRequest;
 
@@ -319,6 +319,13 @@ void tcg_gen_qemu_st_i64_chk(TCGv_i64, TCGTemp *, TCGArg, MemOp, TCGType);
 void tcg_gen_qemu_ld_i128_chk(TCGv_i128, TCGTemp *, TCGArg, MemOp, TCGType);
 void tcg_gen_qemu_st_i128_chk(TCGv_i128, TCGTemp *, TCGArg, MemOp, TCGType);
 
+/*
+ * Zero the naturally aligned block of 1 << log2_len bytes, at most a page,
+ * that contains the address. For guest idioms like DC ZVA: the wasm32
+ * backend turns it into a TLB check and a memory.fill.
+ */
+void tcg_gen_qemu_zero_block_chk(TCGTemp *, TCGArg, unsigned, TCGType);
+
 /* Atomic ops */
 
 void tcg_gen_atomic_cmpxchg_i32_chk(TCGv_i32, TCGTemp *, TCGv_i32, TCGv_i32,
@@ -102,6 +102,12 @@ tcg_gen_qemu_st_i128(TCGv_i128 v, TCGv a, TCGArg i, MemOp m)
     tcg_gen_qemu_st_i128_chk(v, tcgv_tl_temp(a), i, m, TCG_TYPE_TL);
 }
 
+static inline void
+tcg_gen_qemu_zero_block(TCGv a, TCGArg i, unsigned log2_len)
+{
+    tcg_gen_qemu_zero_block_chk(tcgv_tl_temp(a), i, log2_len, TCG_TYPE_TL);
+}
+
 #define DEF_ATOMIC2(N, S)                                               \
     static inline void N##_##S(TCGv_##S r, TCGv a, TCGv_##S v,          \
                                TCGArg i, MemOp m)                       \
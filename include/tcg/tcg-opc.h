@@ -310,6 +310,11 @@ DEF(last_generic, 0, 0, 0, TCG_OPF_NOT_PRESENT)
 DEF(tci_movi, 1, 0, 1, TCG_OPF_NOT_PRESENT)
 DEF(tci_movl, 1, 0, 1, TCG_OPF_NOT_PRESENT)
 #endif
+#if defined(EMSCRIPTEN)
+/* Compare and branch, replaces setcond and brcond on the TCI tier. */
+DEF(tci_brcond_i32, 0, 2, 1, TCG_OPF_NOT_PRESENT)
+DEF(tci_brcond_i64, 0, 2, 1, TCG_OPF_NOT_PRESENT)
+#endif
 
 #undef DATA64_ARGS
 #undef IMPL
@@ -357,6 +357,8 @@ typedef TCGv_ptr TCGv_env;
 #define TCG_CALL_NO_RETURN          0x0008
 /* Helper is part of Plugins.  */
 #define TCG_CALL_PLUGIN             0x0010
+/* Helper never yields (no coroutine switch or sleep), used by wasm32. */
+#define TCG_CALL_NO_YIELD           0x0020
 
 /* convenience version of most used call flags */
 #define TCG_CALL_NO_RWG         TCG_CALL_NO_READ_GLOBALS
@@ -756,6 +758,25 @@ TranslationBlock *tcg_tb_alloc(TCGContext *s);
 
 void tcg_region_reset_all(void);
 
+/*
+ * Retiring code a region at a time, see tb_retire_oldest.
+ * tcg_region_want_retire() returns true once few regions are left free.
+ * tcg_region_retire_begin() takes the oldest full region out of use and
+ * adds its TBs to @tbs, returning the region or -1 if none is full.
+ * tcg_region_retire_end() frees the region after an RCU grace period,
+ * call it once the TBs are invalidated.
+ */
+bool tcg_region_want_retire(void);
+ssize_t tcg_region_retire_begin(GPtrArray *tbs);
+void tcg_region_retire_end(size_t region);
+
+/*
+ * The generation of the code at @p, which changes once its region is
+ * retired or reused. tcg_region_gen_changes counts the changes.
+ */
+uint32_t tcg_region_gen(const void *p);
+extern unsigned tcg_region_gen_changes;
+
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
 
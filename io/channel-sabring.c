@@ -0,0 +1,598 @@
+/*
+ * QEMU I/O channel over rings in shared wasm memory
+ *
+ * In the browser, sockets are emulated by Emscripten on the main thread:
+ * every send() and recv() is proxied to it, which costs a round trip per
+ * call and serializes all I/O of QEMU with the page. This channel is a
+ * byte stream whose far end is a WebSocket opened by an I/O worker of the
+ * page instead, see examples/x86_64/src/htdocs/sabring-io.js: the bytes go
+ * through a ring in each direction in the SharedArrayBuffer of the wasm
+ * memory, and the side that moves a ring wakes the other with a futex.
+ *
+ * A read copies straight from the ring into the buffers of the caller,
+ * e.g. the guest pages of an NBD read request, and a writer can queue as
+ * much as fits in the ring without waiting for the worker, so that a
+ * protocol such as NBD keeps many requests in flight.
+ *
+ * The worker finds the channels in qio_channel_sabring_lookup(), a table
+ * of the shared blocks of live channels, and waits for the generation
+ * counter of the table to change.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include <emscripten.h>
+#include <emscripten/threading.h>
+
+#include "io/channel-sabring.h"
+#include "qapi/error.h"
+#include "qemu/atomic.h"
+#include "qemu/iov.h"
+#include "qemu/main-loop.h"
+#include "qemu/memalign.h"
+#include "qemu/module.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "qemu/units.h"
+
+/* state of a channel, written as said with cmpxchg by whoever moves it */
+enum {
+    SABRING_IO_CONNECT = 1, /* QEMU: open a WebSocket to addr */
+    SABRING_IO_OPEN,        /* worker: the WebSocket is open */
+    SABRING_IO_EOF,         /* worker: it closed or failed to open */
+    SABRING_IO_CLOSE,       /* QEMU: close the WebSocket */
+    SABRING_IO_DONE,        /* worker: closed after SABRING_IO_CLOSE */
+};
+
+#define SABRING_IO_ADDR_LEN     256
+#define SABRING_IO_RING_SIZE    (1 * MiB)
+#define SABRING_IO_SLOTS        64
+#define SABRING_IO_CONNECT_MS   30000
+/* the watch of qio_channel_wait() looks for room this often */
+#define SABRING_IO_POLL_MS      10
+
+/*
+ * Shared with the worker. Each side bumps its bell and wakes the other
+ * after it moves a ring or the state; the out ring and then the in ring
+ * follow this header.
+ */
+struct QIOChannelSabringShared {
+    uint32_t state;
+    uint32_t qemu_bell;
+    uint32_t worker_bell;
+    uint32_t orphan;        /* set by QEMU once the channel is gone */
+    char addr[SABRING_IO_ADDR_LEN];     /* "host:port" */
+};
+
+/*
+ * Blocks stay in their slot until both sides let go of them. A block
+ * whose channel is gone but whose WebSocket the worker still closes is
+ * freed by a later connect.
+ */
+typedef struct SabIOTable {
+    uint32_t gen;
+    uint32_t nr_slots;
+    QIOChannelSabringShared *slots[SABRING_IO_SLOTS];
+} SabIOTable;
+
+static SabIOTable sabring_io_table = { .nr_slots = SABRING_IO_SLOTS };
+static QemuMutex sabring_io_table_lock;
+
+static SabRing *sabring_io_out(QIOChannelSabringShared *sh)
+{
+    return (SabRing *)(sh + 1);
+}
+
+static SabRing *sabring_io_in(QIOChannelSabringShared *sh)
+{
+    return sab_ring_next(sabring_io_out(sh));
+}
+
+static void sabring_io_ring(QIOChannelSabringShared *sh)
+{
+    qatomic_inc(&sh->qemu_bell);
+    emscripten_futex_wake(&sh->qemu_bell, INT_MAX);
+}
+
+static bool sabring_io_released(QIOChannelSabringShared *sh)
+{
+    uint32_t state = qatomic_load_acquire(&sh->state);
+
+    return state == SABRING_IO_EOF || state == SABRING_IO_DONE;
+}
+
+/* Takes a slot for sh, freeing the blocks nobody uses anymore */
+static bool sabring_io_table_add(QIOChannelSabringShared *sh)
+{
+    SabIOTable *t = &sabring_io_table;
+    int free_slot = -1;
+
+    qemu_mutex_lock(&sabring_io_table_lock);
+    for (int i = 0; i < SABRING_IO_SLOTS; i++) {
+        QIOChannelSabringShared *old = t->slots[i];
+
+        if (old && qatomic_read(&old->orphan) && sabring_io_released(old)) {
+            qatomic_set(&t->slots[i], NULL);
+            qemu_vfree(old);
+            old = NULL;
+        }
+        if (!old && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    if (free_slot >= 0) {
+        qatomic_store_release(&t->slots[free_slot], sh);
+        qatomic_inc(&t->gen);
+        emscripten_futex_wake(&t->gen, INT_MAX);
+    }
+    qemu_mutex_unlock(&sabring_io_table_lock);
+    return free_slot >= 0;
+}
+
+static void sabring_io_table_remove(QIOChannelSabringShared *sh)
+{
+    SabIOTable *t = &sabring_io_table;
+
+    qemu_mutex_lock(&sabring_io_table_lock);
+    for (int i = 0; i < SABRING_IO_SLOTS; i++) {
+        if (t->slots[i] == sh) {
+            qatomic_set(&t->slots[i], NULL);
+            break;
+        }
+    }
+    qemu_mutex_unlock(&sabring_io_table_lock);
+    qemu_vfree(sh);
+}
+
+/*
+ * Address of the table of channels: u32 gen, u32 nr_slots and then the
+ * addresses of the shared blocks, 0 for free slots.
+ */
+EMSCRIPTEN_KEEPALIVE uintptr_t qio_channel_sabring_lookup(void)
+{
+    return (uintptr_t)&sabring_io_table;
+}
+
+/* Moves the state to CLOSE, unless the worker already let go */
+static void sabring_io_close(QIOChannelSabringShared *sh)
+{
+    uint32_t state = qatomic_read(&sh->state);
+
+    while (state == SABRING_IO_CONNECT || state == SABRING_IO_OPEN) {
+        uint32_t old = qatomic_cmpxchg(&sh->state, state, SABRING_IO_CLOSE);
+
+        if (old == state) {
+            break;
+        }
+        state = old;
+    }
+    sabring_io_ring(sh);
+    /* wake our own waiters as well */
+    emscripten_futex_wake(&sh->worker_bell, INT_MAX);
+}
+
+static bool sabring_io_can_read(QIOChannelSabringShared *sh)
+{
+    SabRing *r = sabring_io_in(sh);
+
+    return qatomic_load_acquire(&r->head) != r->tail ||
+           qatomic_read(&sh->state) != SABRING_IO_OPEN;
+}
+
+static bool sabring_io_can_write(QIOChannelSabringShared *sh)
+{
+    return sab_ring_room(sabring_io_out(sh)) ||
+           qatomic_read(&sh->state) != SABRING_IO_OPEN;
+}
+
+static void sabring_io_read_bh(void *opaque)
+{
+    QIOChannelSabring *sioc = opaque;
+    IOHandler *io_read;
+    void *handler_opaque;
+
+    qemu_mutex_lock(&sioc->lock);
+    io_read = sioc->io_read;
+    handler_opaque = sioc->handler_opaque;
+    qemu_mutex_unlock(&sioc->lock);
+    if (io_read) {
+        io_read(handler_opaque);
+    }
+    object_unref(OBJECT(sioc));
+}
+
+static void sabring_io_write_bh(void *opaque)
+{
+    QIOChannelSabring *sioc = opaque;
+    IOHandler *io_write;
+    void *handler_opaque;
+
+    qemu_mutex_lock(&sioc->lock);
+    io_write = sioc->io_write;
+    handler_opaque = sioc->handler_opaque;
+    qemu_mutex_unlock(&sioc->lock);
+    if (io_write) {
+        io_write(handler_opaque);
+    }
+    object_unref(OBJECT(sioc));
+}
+
+/* Called with sioc->lock held */
+static void sabring_io_kick(QIOChannelSabring *sioc)
+{
+    QIOChannelSabringShared *sh = sioc->shared;
+
+    if (sioc->io_read && sabring_io_can_read(sh)) {
+        object_ref(OBJECT(sioc));
+        aio_bh_schedule_oneshot(sioc->read_ctx, sabring_io_read_bh, sioc);
+    }
+    if (sioc->io_write && sabring_io_can_write(sh)) {
+        object_ref(OBJECT(sioc));
+        aio_bh_schedule_oneshot(sioc->write_ctx, sabring_io_write_bh, sioc);
+    }
+}
+
+/*
+ * The worker moved a ring or the state, run the handlers that became
+ * ready in their AioContext.
+ */
+static void sabring_io_notify(void *opaque)
+{
+    QIOChannelSabring *sioc = opaque;
+
+    qemu_mutex_lock(&sioc->lock);
+    sabring_io_kick(sioc);
+    qemu_mutex_unlock(&sioc->lock);
+}
+
+QIOChannelSabring *qio_channel_sabring_new(void)
+{
+    return QIO_CHANNEL_SABRING(object_new(TYPE_QIO_CHANNEL_SABRING));
+}
+
+int qio_channel_sabring_connect_sync(QIOChannelSabring *sioc,
+                                     SocketAddress *addr,
+                                     Error **errp)
+{
+    QIOChannelSabringShared *sh;
+    int64_t deadline;
+    uint32_t state;
+
+    if (addr->type != SOCKET_ADDRESS_TYPE_INET) {
+        error_setg(errp, "WebSocket connections need an inet address");
+        return -1;
+    }
+    assert(!sioc->shared);
+
+    sh = qemu_memalign(64, sizeof(*sh) +
+                       2 * sab_ring_footprint(SABRING_IO_RING_SIZE));
+    memset(sh, 0, sizeof(*sh));
+    sab_ring_init(sabring_io_out(sh), SABRING_IO_RING_SIZE);
+    sab_ring_init(sabring_io_in(sh), SABRING_IO_RING_SIZE);
+    snprintf(sh->addr, sizeof(sh->addr), "%s:%s",
+             addr->u.inet.host, addr->u.inet.port);
+    sh->state = SABRING_IO_CONNECT;
+
+    if (!sabring_io_table_add(sh)) {
+        qemu_vfree(sh);
+        error_setg(errp, "Too many WebSocket connections");
+        return -1;
+    }
+    sioc->shared = sh;
+
+    deadline = qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + SABRING_IO_CONNECT_MS;
+    for (;;) {
+        uint32_t bell = qatomic_load_acquire(&sh->worker_bell);
+        int64_t left;
+
+        state = qatomic_load_acquire(&sh->state);
+        if (state != SABRING_IO_CONNECT) {
+            break;
+        }
+        left = deadline - qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
+        if (left < 0) {
+            sabring_io_close(sh);
+            error_setg(errp, "No I/O worker connected to %s", sh->addr);
+            return -1;
+        }
+        emscripten_futex_wait(&sh->worker_bell, bell, left);
+    }
+    if (state != SABRING_IO_OPEN) {
+        error_setg(errp, "Failed to connect to WebSocket at %s", sh->addr);
+        return -1;
+    }
+
+    sab_ring_waiter_start(&sioc->waiter, "sabring-io", &sh->worker_bell,
+                          sabring_io_notify, sioc);
+    return 0;
+}
+
+static void qio_channel_sabring_init(Object *obj)
+{
+    QIOChannelSabring *sioc = QIO_CHANNEL_SABRING(obj);
+
+    qemu_mutex_init(&sioc->lock);
+    sioc->blocking = true;
+}
+
+static void qio_channel_sabring_finalize(Object *obj)
+{
+    QIOChannelSabring *sioc = QIO_CHANNEL_SABRING(obj);
+    QIOChannelSabringShared *sh = sioc->shared;
+
+    sab_ring_waiter_stop(&sioc->waiter);
+    if (sh) {
+        sabring_io_close(sh);
+        qatomic_set(&sh->orphan, 1);
+        if (sabring_io_released(sh)) {
+            sabring_io_table_remove(sh);
+        }
+    }
+    qemu_mutex_destroy(&sioc->lock);
+}
+
+/*
+ * Waits for the worker in blocking mode, returns false right away in
+ * non-blocking mode. The caller reads the bell before it looks at the
+ * rings, so that a move it missed ends the wait; closing the channel
+ * rings the bell too.
+ */
+static bool sabring_io_wait(QIOChannelSabring *sioc, uint32_t bell)
+{
+    if (!sioc->blocking) {
+        return false;
+    }
+    emscripten_futex_wait(&sioc->shared->worker_bell, bell, INFINITY);
+    return true;
+}
+
+static ssize_t qio_channel_sabring_readv(QIOChannel *ioc,
+                                         const struct iovec *iov,
+                                         size_t niov,
+                                         int **fds,
+                                         size_t *nfds,
+                                         int flags,
+                                         Error **errp)
+{
+    QIOChannelSabring *sioc = QIO_CHANNEL_SABRING(ioc);
+    QIOChannelSabringShared *sh = sioc->shared;
+    SabRing *r;
+    uint32_t tail;
+    size_t done = 0;
+
+    if (!sh) {
+        error_setg_errno(errp, ENOTCONN, "Channel is not connected");
+        return -1;
+    }
+    r = sabring_io_in(sh);
+    tail = r->tail;
+
+    for (;;) {
+        uint32_t bell = qatomic_load_acquire(&sh->worker_bell);
+        uint32_t head = qatomic_load_acquire(&r->head);
+
+        if (head != tail) {
+            for (size_t i = 0; i < niov && head != tail; i++) {
+                size_t n = MIN(iov[i].iov_len, head - tail);
+
+                sab_ring_copy_out(r, tail, iov[i].iov_base, n);
+                tail += n;
+                done += n;
+                if (n < iov[i].iov_len) {
+                    break;
+                }
+            }
+            qatomic_store_release(&r->tail, tail);
+            sabring_io_ring(sh);
+            return done;
+        }
+        if (qatomic_read(&sh->state) != SABRING_IO_OPEN) {
+            return 0;
+        }
+        if (!sabring_io_wait(sioc, bell)) {
+            return QIO_CHANNEL_ERR_BLOCK;
+        }
+    }
+}
+
+static ssize_t qio_channel_sabring_writev(QIOChannel *ioc,
+                                          const struct iovec *iov,
+                                          size_t niov,
+                                          int *fds,
+                                          size_t nfds,
+                                          int flags,
+                                          Error **errp)
+{
+    QIOChannelSabring *sioc = QIO_CHANNEL_SABRING(ioc);
+    QIOChannelSabringShared *sh = sioc->shared;
+    SabRing *r;
+    uint32_t head;
+    size_t done = 0;
+
+    if (!sh) {
+        error_setg_errno(errp, ENOTCONN, "Channel is not connected");
+        return -1;
+    }
+    r = sabring_io_out(sh);
+    head = r->head;
+
+    for (;;) {
+        uint32_t bell = qatomic_load_acquire(&sh->worker_bell);
+        uint32_t room = sab_ring_room(r);
+
+        if (qatomic_read(&sh->state) != SABRING_IO_OPEN) {
+            error_setg_errno(errp, EPIPE, "WebSocket to %s is closed",
+                             sh->addr);
+            return -1;
+        }
+        if (room) {
+            for (size_t i = 0; i < niov && room; i++) {
+                size_t n = MIN(iov[i].iov_len, room);
+
+                sab_ring_copy_in(r, head, iov[i].iov_base, n);
+                head += n;
+                room -= n;
+                done += n;
+                if (n < iov[i].iov_len) {
+                    break;
+                }
+            }
+            qatomic_store_release(&r->head, head);
+            sabring_io_ring(sh);
+            return done;
+        }
+        if (!sabring_io_wait(sioc, bell)) {
+            return QIO_CHANNEL_ERR_BLOCK;
+        }
+    }
+}
+
+static int qio_channel_sabring_set_blocking(QIOChannel *ioc, bool enabled,
+                                            Error **errp)
+{
+    QIO_CHANNEL_SABRING(ioc)->blocking = enabled;
+    return 0;
+}
+
+static int qio_channel_sabring_close(QIOChannel *ioc, Error **errp)
+{
+    QIOChannelSabring *sioc = QIO_CHANNEL_SABRING(ioc);
+
+    if (sioc->shared) {
+        sabring_io_close(sioc->shared);
+    }
+    return 0;
+}
+
+static int qio_channel_sabring_shutdown(QIOChannel *ioc,
+                                        QIOChannelShutdown how,
+                                        Error **errp)
+{
+    /* a WebSocket can't be half closed */
+    return qio_channel_sabring_close(ioc, errp);
+}
+
+static void qio_channel_sabring_set_aio_fd_handler(QIOChannel *ioc,
+                                                   AioContext *read_ctx,
+                                                   IOHandler *io_read,
+                                                   AioContext *write_ctx,
+                                                   IOHandler *io_write,
+                                                   void *opaque)
+{
+    QIOChannelSabring *sioc = QIO_CHANNEL_SABRING(ioc);
+
+    qemu_mutex_lock(&sioc->lock);
+    sioc->read_ctx = read_ctx;
+    sioc->io_read = io_read;
+    sioc->write_ctx = write_ctx;
+    sioc->io_write = io_write;
+    sioc->handler_opaque = opaque;
+    /* the worker may have moved the rings before the handlers were set */
+    if (sioc->shared) {
+        sabring_io_kick(sioc);
+    }
+    qemu_mutex_unlock(&sioc->lock);
+}
+
+typedef struct SabIOSource {
+    GSource parent;
+    QIOChannelSabring *sioc;
+    GIOCondition condition;
+} SabIOSource;
+
+static GIOCondition sabring_io_source_revents(SabIOSource *ssource)
+{
+    QIOChannelSabringShared *sh = ssource->sioc->shared;
+    GIOCondition revents = 0;
+
+    if (!sh) {
+        return ssource->condition & G_IO_HUP;
+    }
+    if (sabring_io_can_read(sh)) {
+        revents |= G_IO_IN;
+    }
+    if (sabring_io_can_write(sh)) {
+        revents |= G_IO_OUT;
+    }
+    return revents & ssource->condition;
+}
+
+static gboolean sabring_io_source_prepare(GSource *source, gint *timeout)
+{
+    *timeout = SABRING_IO_POLL_MS;
+    return sabring_io_source_revents((SabIOSource *)source) != 0;
+}
+
+static gboolean sabring_io_source_check(GSource *source)
+{
+    return sabring_io_source_revents((SabIOSource *)source) != 0;
+}
+
+static gboolean sabring_io_source_dispatch(GSource *source,
+                                           GSourceFunc callback,
+                                           gpointer user_data)
+{
+    SabIOSource *ssource = (SabIOSource *)source;
+
+    return ((QIOChannelFunc)callback)(QIO_CHANNEL(ssource->sioc),
+                                      sabring_io_source_revents(ssource),
+                                      user_data);
+}
+
+static void sabring_io_source_finalize(GSource *source)
+{
+    object_unref(OBJECT(((SabIOSource *)source)->sioc));
+}
+
+static GSourceFuncs sabring_io_source_funcs = {
+    .prepare = sabring_io_source_prepare,
+    .check = sabring_io_source_check,
+    .dispatch = sabring_io_source_dispatch,
+    .finalize = sabring_io_source_finalize,
+};
+
+static GSource *qio_channel_sabring_create_watch(QIOChannel *ioc,
+                                                 GIOCondition condition)
+{
+    SabIOSource *ssource;
+
+    ssource = (SabIOSource *)g_source_new(&sabring_io_source_funcs,
+                                          sizeof(SabIOSource));
+    ssource->sioc = QIO_CHANNEL_SABRING(ioc);
+    object_ref(OBJECT(ioc));
+    ssource->condition = condition;
+    return &ssource->parent;
+}
+
+static void qio_channel_sabring_class_init(ObjectClass *klass, void *data)
+{
+    QIOChannelClass *ioc_klass = QIO_CHANNEL_CLASS(klass);
+
+    ioc_klass->io_writev = qio_channel_sabring_writev;
+    ioc_klass->io_readv = qio_channel_sabring_readv;
+    ioc_klass->io_set_blocking = qio_channel_sabring_set_blocking;
+    ioc_klass->io_close = qio_channel_sabring_close;
+    ioc_klass->io_shutdown = qio_channel_sabring_shutdown;
+    ioc_klass->io_create_watch = qio_channel_sabring_create_watch;
+    ioc_klass->io_set_aio_fd_handler = qio_channel_sabring_set_aio_fd_handler;
+}
+
+static const TypeInfo qio_channel_sabring_info = {
+    .parent = TYPE_QIO_CHANNEL,
+    .name = TYPE_QIO_CHANNEL_SABRING,
+    .instance_size = sizeof(QIOChannelSabring),
+    .instance_init = qio_channel_sabring_init,
+    .instance_finalize = qio_channel_sabring_finalize,
+    .class_init = qio_channel_sabring_class_init,
+};
+
+static void qio_channel_sabring_register_types(void)
+{
+    qemu_mutex_init(&sabring_io_table_lock);
+    type_register_static(&qio_channel_sabring_info);
+}
+
+type_init(qio_channel_sabring_register_types);
@@ -0,0 +1,286 @@
+/*
+ * QEMU I/O channel on a file in SABFS
+ *
+ * Lets "-incoming file:" restore VM state straight from SABFS instead of
+ * a copy in Emscripten's MEMFS. With the state file mounted lazily
+ * (SABFS.mountLazy() in sabfs.js) QEMU starts loading it right away and
+ * the blocks are downloaded as the load reaches them, so the download
+ * overlaps with the restore instead of preceding QEMU's start.
+ *
+ * "migrate file:" saves to SABFS the same way, so with SABFS persisted to
+ * OPFS a checkpoint of the running VM survives a reload of the page.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "migration/channel-sab.h"
+#include "qapi/error.h"
+#include "qemu/module.h"
+#include "sabfs/sabfs_qemu.h"
+
+QIOChannelSab *
+qio_channel_sab_new_path(const char *path, int flags, Error **errp)
+{
+    QIOChannelSab *ioc;
+    int fd;
+
+    if (sabfs_attach() < 0) {
+        error_setg(errp, "SABFS not available");
+        return NULL;
+    }
+    fd = sabfs_open(path, flags, 0600);
+    if (fd < 0) {
+        error_setg(errp, "Could not open '%s' in SABFS", path);
+        return NULL;
+    }
+
+    ioc = QIO_CHANNEL_SAB(object_new(TYPE_QIO_CHANNEL_SAB));
+    ioc->fd = fd;
+
+    return ioc;
+}
+
+
+static void
+qio_channel_sab_init(Object *obj)
+{
+    QIOChannelSab *ioc = QIO_CHANNEL_SAB(obj);
+
+    ioc->fd = -1;
+}
+
+
+static void
+qio_channel_sab_finalize(Object *obj)
+{
+    QIOChannelSab *ioc = QIO_CHANNEL_SAB(obj);
+
+    if (ioc->fd != -1) {
+        sabfs_close(ioc->fd);
+        ioc->fd = -1;
+    }
+}
+
+
+static ssize_t
+qio_channel_sab_readv(QIOChannel *ioc,
+                      const struct iovec *iov,
+                      size_t niov,
+                      int **fds,
+                      size_t *nfds,
+                      int flags,
+                      Error **errp)
+{
+    QIOChannelSab *sioc = QIO_CHANNEL_SAB(ioc);
+    ssize_t done = 0;
+
+    for (size_t i = 0; i < niov; i++) {
+        ssize_t ret = sabfs_pread(sioc->fd, iov[i].iov_base, iov[i].iov_len,
+                                  sioc->offset);
+
+        if (ret < 0) {
+            error_setg(errp, "Unable to read from SABFS");
+            return -1;
+        }
+        sioc->offset += ret;
+        done += ret;
+        if (ret < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return done;
+}
+
+
+static ssize_t
+qio_channel_sab_writev(QIOChannel *ioc,
+                       const struct iovec *iov,
+                       size_t niov,
+                       int *fds,
+                       size_t nfds,
+                       int flags,
+                       Error **errp)
+{
+    QIOChannelSab *sioc = QIO_CHANNEL_SAB(ioc);
+    ssize_t done = 0;
+
+    for (size_t i = 0; i < niov; i++) {
+        ssize_t ret = sabfs_pwrite(sioc->fd, iov[i].iov_base, iov[i].iov_len,
+                                   sioc->offset);
+
+        if (ret != iov[i].iov_len) {
+            error_setg(errp, "Unable to write to SABFS, out of space");
+            return -1;
+        }
+        sioc->offset += ret;
+        done += ret;
+    }
+
+    return done;
+}
+
+
+static int
+qio_channel_sab_set_blocking(QIOChannel *ioc,
+                             bool enabled,
+                             Error **errp)
+{
+    /* I/O only waits for blocks still being fetched */
+    return 0;
+}
+
+
+static off_t
+qio_channel_sab_seek(QIOChannel *ioc,
+                     off_t offset,
+                     int whence,
+                     Error **errp)
+{
+    QIOChannelSab *sioc = QIO_CHANNEL_SAB(ioc);
+    sabfs_stat_t st;
+
+    switch (whence) {
+    case SEEK_SET:
+        sioc->offset = offset;
+        break;
+    case SEEK_CUR:
+        sioc->offset += offset;
+        break;
+    case SEEK_END:
+        if (sabfs_fstat(sioc->fd, &st) < 0) {
+            error_setg(errp, "Unable to get the size of the SABFS file");
+            return (off_t)-1;
+        }
+        sioc->offset = st.size + offset;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    return sioc->offset;
+}
+
+
+static int
+qio_channel_sab_close(QIOChannel *ioc,
+                      Error **errp)
+{
+    QIOChannelSab *sioc = QIO_CHANNEL_SAB(ioc);
+
+    if (sioc->fd != -1) {
+        sabfs_close(sioc->fd);
+        sioc->fd = -1;
+    }
+    return 0;
+}
+
+
+typedef struct QIOChannelSabSource QIOChannelSabSource;
+struct QIOChannelSabSource {
+    GSource parent;
+    QIOChannelSab *sioc;
+    GIOCondition condition;
+};
+
+/* A file is always ready, reads wait for pending blocks themselves */
+static gboolean
+qio_channel_sab_source_prepare(GSource *source,
+                               gint *timeout)
+{
+    QIOChannelSabSource *ssource = (QIOChannelSabSource *)source;
+
+    *timeout = -1;
+
+    return (G_IO_IN | G_IO_OUT) & ssource->condition;
+}
+
+static gboolean
+qio_channel_sab_source_check(GSource *source)
+{
+    QIOChannelSabSource *ssource = (QIOChannelSabSource *)source;
+
+    return (G_IO_IN | G_IO_OUT) & ssource->condition;
+}
+
+static gboolean
+qio_channel_sab_source_dispatch(GSource *source,
+                                GSourceFunc callback,
+                                gpointer user_data)
+{
+    QIOChannelFunc func = (QIOChannelFunc)callback;
+    QIOChannelSabSource *ssource = (QIOChannelSabSource *)source;
+
+    return (*func)(QIO_CHANNEL(ssource->sioc),
+                   (G_IO_IN | G_IO_OUT) & ssource->condition,
+                   user_data);
+}
+
+static void
+qio_channel_sab_source_finalize(GSource *source)
+{
+    QIOChannelSabSource *ssource = (QIOChannelSabSource *)source;
+
+    object_unref(OBJECT(ssource->sioc));
+}
+
+static GSourceFuncs qio_channel_sab_source_funcs = {
+    qio_channel_sab_source_prepare,
+    qio_channel_sab_source_check,
+    qio_channel_sab_source_dispatch,
+    qio_channel_sab_source_finalize
+};
+
+static GSource *
+qio_channel_sab_create_watch(QIOChannel *ioc,
+                             GIOCondition condition)
+{
+    QIOChannelSab *sioc = QIO_CHANNEL_SAB(ioc);
+    QIOChannelSabSource *ssource;
+    GSource *source;
+
+    source = g_source_new(&qio_channel_sab_source_funcs,
+                          sizeof(QIOChannelSabSource));
+    ssource = (QIOChannelSabSource *)source;
+
+    ssource->sioc = sioc;
+    object_ref(OBJECT(sioc));
+
+    ssource->condition = condition;
+
+    return source;
+}
+
+
+static void
+qio_channel_sab_class_init(ObjectClass *klass,
+                           void *class_data G_GNUC_UNUSED)
+{
+    QIOChannelClass *ioc_klass = QIO_CHANNEL_CLASS(klass);
+
+    ioc_klass->io_writev = qio_channel_sab_writev;
+    ioc_klass->io_readv = qio_channel_sab_readv;
+    ioc_klass->io_set_blocking = qio_channel_sab_set_blocking;
+    ioc_klass->io_seek = qio_channel_sab_seek;
+    ioc_klass->io_close = qio_channel_sab_close;
+    ioc_klass->io_create_watch = qio_channel_sab_create_watch;
+}
+
+static const TypeInfo qio_channel_sab_info = {
+    .parent = TYPE_QIO_CHANNEL,
+    .name = TYPE_QIO_CHANNEL_SAB,
+    .instance_size = sizeof(QIOChannelSab),
+    .instance_init = qio_channel_sab_init,
+    .instance_finalize = qio_channel_sab_finalize,
+    .class_init = qio_channel_sab_class_init,
+};
+
+static void
+qio_channel_sab_register_types(void)
+{
+    type_register_static(&qio_channel_sab_info);
+}
+
+type_init(qio_channel_sab_register_types);
@@ -0,0 +1,47 @@
+/*
+ * QEMU I/O channel on a file in SABFS
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QIO_CHANNEL_SAB_H
+#define QIO_CHANNEL_SAB_H
+
+#include "io/channel.h"
+#include "qom/object.h"
+
+#define TYPE_QIO_CHANNEL_SAB "qio-channel-sab"
+OBJECT_DECLARE_SIMPLE_TYPE(QIOChannelSab, QIO_CHANNEL_SAB)
+
+
+/**
+ * QIOChannelSab:
+ *
+ * The QIOChannelSab object provides a channel over a file in
+ * SABFS (sabfs/sabfs_qemu.c), for saving VM state to it and
+ * restoring it. Blocks of lazily mounted files are fetched as
+ * they are read.
+ */
+
+struct QIOChannelSab {
+    QIOChannel parent;
+    int fd;
+    off_t offset;
+};
+
+
+/**
+ * qio_channel_sab_new_path:
+ * @path: the path of the file in SABFS
+ * @flags: the SABFS_O_* open flags
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Open the file at @path in SABFS
+ *
+ * Returns: the new channel object, or NULL on error
+ */
+QIOChannelSab *
+qio_channel_sab_new_path(const char *path, int flags, Error **errp);
+
+#endif /* QIO_CHANNEL_SAB_H */
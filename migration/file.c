@@ -14,6 +14,10 @@
 #include "io/channel-file.h"
 #include "io/channel-util.h"
 #include "trace.h"
+#ifdef EMSCRIPTEN
+#include "channel-sab.h"
+#include "sabfs/sabfs_qemu.h"
+#endif
 
 #define OFFSET_OPTION ",offset="
 
@@ -36,23 +40,58 @@ int file_parse_offset(char *filespec, uint64_t *offsetp, Error **errp)
     return 0;
 }
 
+#ifdef EMSCRIPTEN
+/*
+ * Whether filename names a file in SABFS, or a new file in a directory of
+ * SABFS other than its root, which Emscripten's filesystem has as well
+ */
+static bool file_in_sabfs(const char *filename)
+{
+    g_autofree char *dir = g_path_get_dirname(filename);
+    sabfs_stat_t st;
+
+    if (sabfs_attach() < 0) {
+        return false;
+    }
+    if (sabfs_stat(filename, &st) == 0) {
+        return st.is_file;
+    }
+    return strcmp(dir, "/") && sabfs_stat(dir, &st) == 0 && st.is_directory;
+}
+#endif
+
+static QIOChannel *file_open_outgoing(const char *filename, Error **errp)
+{
+    QIOChannelFile *fioc;
+
+#ifdef EMSCRIPTEN
+    if (file_in_sabfs(filename)) {
+        QIOChannelSab *sioc = qio_channel_sab_new_path(filename,
+            SABFS_O_CREAT | SABFS_O_WRONLY | SABFS_O_TRUNC, errp);
+
+        return sioc ? QIO_CHANNEL(sioc) : NULL;
+    }
+#endif
+
+    fioc = qio_channel_file_new_path(filename, O_CREAT | O_WRONLY | O_TRUNC,
+                                     0600, errp);
+    return fioc ? QIO_CHANNEL(fioc) : NULL;
+}
+
 void file_start_outgoing_migration(MigrationState *s,
                                    FileMigrationArgs *file_args, Error **errp)
 {
-    g_autoptr(QIOChannelFile) fioc = NULL;
+    g_autoptr(QIOChannel) ioc = NULL;
     g_autofree char *filename = g_strdup(file_args->filename);
     uint64_t offset = file_args->offset;
-    QIOChannel *ioc;
 
     trace_migration_file_outgoing(filename);
 
-    fioc = qio_channel_file_new_path(filename, O_CREAT | O_WRONLY | O_TRUNC,
-                                     0600, errp);
-    if (!fioc) {
+    ioc = file_open_outgoing(filename, errp);
+    if (!ioc) {
         return;
     }
 
-    ioc = QIO_CHANNEL(fioc);
     if (offset && qio_channel_io_seek(ioc, offset, SEEK_SET, errp) < 0) {
         return;
     }
@@ -69,21 +108,39 @@ static gboolean file_accept_incoming_migration(QIOChannel *ioc,
     return G_SOURCE_REMOVE;
 }
 
+static QIOChannel *file_open_incoming(const char *filename, Error **errp)
+{
+    QIOChannelFile *fioc;
+
+#ifdef EMSCRIPTEN
+    sabfs_stat_t st;
+
+    /* A file in SABFS is read from there, streaming it if mounted lazily */
+    if (sabfs_attach() == 0 && sabfs_stat(filename, &st) == 0 && st.is_file) {
+        QIOChannelSab *sioc = qio_channel_sab_new_path(filename,
+                                                       SABFS_O_RDONLY, errp);
+
+        return sioc ? QIO_CHANNEL(sioc) : NULL;
+    }
+#endif
+
+    fioc = qio_channel_file_new_path(filename, O_RDONLY, 0, errp);
+    return fioc ? QIO_CHANNEL(fioc) : NULL;
+}
+
 void file_start_incoming_migration(FileMigrationArgs *file_args, Error **errp)
 {
     g_autofree char *filename = g_strdup(file_args->filename);
-    QIOChannelFile *fioc = NULL;
     uint64_t offset = file_args->offset;
     QIOChannel *ioc;
 
     trace_migration_file_incoming(filename);
 
-    fioc = qio_channel_file_new_path(filename, O_RDONLY, 0, errp);
-    if (!fioc) {
+    ioc = file_open_incoming(filename, errp);
+    if (!ioc) {
         return;
     }
 
-    ioc = QIO_CHANNEL(fioc);
     if (offset && qio_channel_io_seek(ioc, offset, SEEK_SET, errp) < 0) {
         return;
     }
@@ -204,6 +204,7 @@ Property migration_properties[] = {
     DEFINE_PROP_MIG_CAP("x-switchover-ack",
                         MIGRATION_CAPABILITY_SWITCHOVER_ACK),
     DEFINE_PROP_MIG_CAP("x-dirty-limit", MIGRATION_CAPABILITY_DIRTY_LIMIT),
+    DEFINE_PROP_MIG_CAP("x-dedup-pages", MIGRATION_CAPABILITY_DEDUP_PAGES),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -242,6 +243,13 @@ bool migrate_compress(void)
     return s->capabilities[MIGRATION_CAPABILITY_COMPRESS];
 }
 
+bool migrate_dedup_pages(void)
+{
+    MigrationState *s = migrate_get_current();
+
+    return s->capabilities[MIGRATION_CAPABILITY_DEDUP_PAGES];
+}
+
 bool migrate_dirty_bitmaps(void)
 {
     MigrationState *s = migrate_get_current();
@@ -575,6 +583,22 @@ bool migrate_caps_check(bool *old_caps, bool *new_caps, Error **errp)
     }
 #endif
 
+    if (new_caps[MIGRATION_CAPABILITY_DEDUP_PAGES]) {
+        /*
+         * Duplicates are copied from pages loaded earlier, so the page
+         * they refer to must be in place when they are loaded
+         */
+        if (new_caps[MIGRATION_CAPABILITY_POSTCOPY_RAM] ||
+            new_caps[MIGRATION_CAPABILITY_MULTIFD] ||
+            new_caps[MIGRATION_CAPABILITY_COMPRESS] ||
+            new_caps[MIGRATION_CAPABILITY_XBZRLE] ||
+            new_caps[MIGRATION_CAPABILITY_X_COLO]) {
+            error_setg(errp, "dedup-pages is not compatible with "
+                       "postcopy-ram, multifd, compress, xbzrle and x-colo");
+            return false;
+        }
+    }
+
     if (new_caps[MIGRATION_CAPABILITY_POSTCOPY_PREEMPT]) {
         if (!new_caps[MIGRATION_CAPABILITY_POSTCOPY_RAM]) {
             error_setg(errp, "Postcopy preempt requires postcopy-ram");
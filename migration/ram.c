@@ -68,6 +68,9 @@
 
 #if defined(__linux__)
 #include "qemu/userfaultfd.h"
+#ifdef EMSCRIPTEN
+#include "sysemu/ram-cold.h"
+#endif
 #endif /* defined(__linux__) */
 
 /***********************************************************/
@@ -80,9 +83,12 @@
  * RAM_SAVE_FLAG_COMPRESS_PAGE just rename it.
  */
 /*
- * RAM_SAVE_FLAG_FULL was obsoleted in 2009, it can be reused now
+ * RAM_SAVE_FLAG_FULL was obsoleted in 2009, its value is reused for
+ * RAM_SAVE_FLAG_DUP: the page is a copy of one sent before, which follows
+ * as its offset and, unless RAM_SAVE_FLAG_CONTINUE is set in the offset,
+ * its block id
  */
-#define RAM_SAVE_FLAG_FULL     0x01
+#define RAM_SAVE_FLAG_DUP      0x01
 #define RAM_SAVE_FLAG_ZERO     0x02
 #define RAM_SAVE_FLAG_MEM_SIZE 0x04
 #define RAM_SAVE_FLAG_PAGE     0x08
@@ -394,9 +400,24 @@ struct RAMState {
      * RAM migration.
      */
     unsigned int postcopy_bmap_sync_requested;
+
+    /*
+     * With dedup-pages, the last page sent with each content hash.
+     * Protected by the bitmap_mutex.
+     */
+    GHashTable *dedup_pages;
+    /* The VM hasn't run since the last bitmap sync */
+    bool dedup_clean;
+    VMChangeStateEntry *dedup_vmstate;
 };
 typedef struct RAMState RAMState;
 
+typedef struct RAMDedupPage {
+    uint64_t hash;
+    RAMBlock *block;
+    ram_addr_t offset;
+} RAMDedupPage;
+
 static RAMState *ram_state;
 
 static NotifierWithReturnList precopy_notifier_list;
@@ -1057,6 +1078,9 @@ static void migration_bitmap_sync(RAMState *rs, bool last_stage)
     memory_global_after_dirty_log_sync();
     trace_migration_bitmap_sync_end(rs->num_dirty_pages_period);
 
+    /* With the VM stopped, pages sent and not dirty are the ones loaded */
+    rs->dedup_clean = !runstate_is_running();
+
     end_time = qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
 
     /* more than 1 second = 1000 millisecons */
@@ -1148,6 +1172,75 @@ static int save_zero_page(RAMState *rs, PageSearchStatus *pss,
     return len;
 }
 
+static uint64_t ram_page_hash(const uint8_t *p)
+{
+    const uint64_t *w = (const uint64_t *)p;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < TARGET_PAGE_SIZE / sizeof(uint64_t); i++) {
+        h = (h ^ w[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * save_dup_page: send the page as a copy of an identical one sent before
+ *
+ * Only while the VM is stopped since the last bitmap sync, when a page
+ * sent earlier that isn't dirty again still holds what the destination
+ * loaded for it. Otherwise the page is recorded for later duplicates.
+ *
+ * Returns the number of bytes written, 0 if the page must still be sent.
+ *
+ * @rs: current RAM state
+ * @pss: current PSS channel
+ * @offset: offset inside the block for the page
+ */
+static int save_dup_page(RAMState *rs, PageSearchStatus *pss,
+                         ram_addr_t offset)
+{
+    RAMBlock *block = pss->block;
+    uint8_t *p = block->host + offset;
+    QEMUFile *file = pss->pss_channel;
+    uint64_t hash = ram_page_hash(p);
+    RAMDedupPage *dup = g_hash_table_lookup(rs->dedup_pages, &hash);
+    RAMBlock *ref_block;
+    ram_addr_t ref_offset;
+    int len, idlen;
+
+    if (!dup || (dup->block == block && dup->offset == offset) ||
+        !qatomic_read(&rs->dedup_clean) || runstate_is_running() ||
+        test_bit(dup->offset >> TARGET_PAGE_BITS, dup->block->bmap) ||
+        memcmp(dup->block->host + dup->offset, p, TARGET_PAGE_SIZE)) {
+        if (!dup) {
+            dup = g_new(RAMDedupPage, 1);
+            dup->hash = hash;
+            g_hash_table_insert(rs->dedup_pages, &dup->hash, dup);
+        }
+        /* the page is sent in full now, refer to it from now on */
+        dup->block = block;
+        dup->offset = offset;
+        return 0;
+    }
+
+    ref_block = dup->block;
+    ref_offset = dup->offset;
+    len = save_page_header(pss, file, block, offset | RAM_SAVE_FLAG_DUP);
+    if (ref_block == block) {
+        qemu_put_be64(file, ref_offset | RAM_SAVE_FLAG_CONTINUE);
+        len += 8;
+    } else {
+        idlen = strlen(ref_block->idstr);
+        qemu_put_be64(file, ref_offset);
+        qemu_put_byte(file, idlen);
+        qemu_put_buffer(file, (uint8_t *)ref_block->idstr, idlen);
+        len += 8 + 1 + idlen;
+    }
+    stat64_add(&mig_stats.normal_pages, 1);
+    ram_transferred_add(len);
+    return len;
+}
+
 /*
  * @pages: the number of pages written by the control path,
  *        < 0 - error
@@ -2060,6 +2153,10 @@ static int ram_save_target_page_legacy(RAMState *rs, PageSearchStatus *pss)
         return 1;
     }
 
+    if (rs->dedup_pages && save_dup_page(rs, pss, offset)) {
+        return 1;
+    }
+
     /*
      * Do not use multifd in postcopy as one whole host page should be
      * placed.  Meanwhile postcopy requires atomic update of pages, so even
@@ -2364,6 +2461,12 @@ static void xbzrle_load_cleanup(void)
 static void ram_state_cleanup(RAMState **rsp)
 {
     if (*rsp) {
+        if ((*rsp)->dedup_vmstate) {
+            qemu_del_vm_change_state_handler((*rsp)->dedup_vmstate);
+        }
+        if ((*rsp)->dedup_pages) {
+            g_hash_table_destroy((*rsp)->dedup_pages);
+        }
         migration_page_queue_free(*rsp);
         qemu_mutex_destroy(&(*rsp)->bitmap_mutex);
         qemu_mutex_destroy(&(*rsp)->src_page_req_mutex);
@@ -2722,6 +2825,17 @@ err_out:
     return -ENOMEM;
 }
 
+static void ram_dedup_vm_state_change(void *opaque, bool running,
+                                      RunState state)
+{
+    RAMState *rs = opaque;
+
+    if (running) {
+        /* pages that were sent may change before the next bitmap sync */
+        qatomic_set(&rs->dedup_clean, false);
+    }
+}
+
 static int ram_state_init(RAMState **rsp)
 {
     *rsp = g_try_new0(RAMState, 1);
@@ -2744,6 +2858,14 @@ static int ram_state_init(RAMState **rsp)
     (*rsp)->migration_dirty_pages = (*rsp)->ram_bytes_total >> TARGET_PAGE_BITS;
     ram_state_reset(*rsp);
 
+    if (migrate_dedup_pages()) {
+        (*rsp)->dedup_pages = g_hash_table_new_full(g_int64_hash,
+                                                    g_int64_equal,
+                                                    NULL, g_free);
+        (*rsp)->dedup_vmstate =
+            qemu_add_vm_change_state_handler(ram_dedup_vm_state_change, *rsp);
+    }
+
     return 0;
 }
 
@@ -2913,6 +3035,13 @@ void qemu_guest_free_page_hint(void *addr, size_t len)
         ram_state->migration_dirty_pages -=
                       bitmap_count_one_with_offset(block->bmap, start, npages);
         bitmap_clear(block->bmap, start, npages);
+        /*
+         * Free pages may have changed since they were sent and won't be
+         * sent again, so they can't be the source of duplicates
+         */
+        if (ram_state->dedup_pages) {
+            g_hash_table_remove_all(ram_state->dedup_pages);
+        }
         qemu_mutex_unlock(&ram_state->bitmap_mutex);
     }
 }
@@ -2941,6 +3070,10 @@ static int ram_save_setup(QEMUFile *f, void *opaque)
     if (compress_threads_save_setup()) {
         return -1;
     }
+#ifdef EMSCRIPTEN
+    /* Pages are read and written through block->host from now on */
+    ram_cold_unpack_all();
+#endif
 
     /* migration has already setup the bitmap, reuse it. */
     if (!migration_in_colo_state()) {
@@ -3502,6 +3635,9 @@ void colo_release_ram_cache(void)
  */
 static int ram_load_setup(QEMUFile *f, void *opaque)
 {
+#ifdef EMSCRIPTEN
+    ram_cold_unpack_all();
+#endif
     xbzrle_load_setup();
     ramblock_recv_map_init();
 
@@ -3879,6 +4015,39 @@ static int parse_ramblocks(QEMUFile *f, ram_addr_t total_ram_bytes)
  *
  * @f: QEMUFile where to send the data
  */
+/*
+ * Copy the page that a RAM_SAVE_FLAG_DUP page refers to, it was loaded
+ * earlier in the stream
+ */
+static int load_dup_page(QEMUFile *f, RAMBlock *block, void *host)
+{
+    uint64_t ref = qemu_get_be64(f);
+    ram_addr_t ref_offset = ref & TARGET_PAGE_MASK;
+    void *src;
+
+    if (!(ref & RAM_SAVE_FLAG_CONTINUE)) {
+        char id[256];
+        uint8_t len = qemu_get_byte(f);
+
+        qemu_get_buffer(f, (uint8_t *)id, len);
+        id[len] = 0;
+        block = qemu_ram_block_by_name(id);
+        if (!block || migrate_ram_is_ignored(block)) {
+            error_report("Duplicate of a page in unknown block %s", id);
+            return -EINVAL;
+        }
+    }
+
+    src = host_from_ram_block_offset(block, ref_offset);
+    if (!src) {
+        error_report("Duplicate of illegal RAM offset " RAM_ADDR_FMT,
+                     ref_offset);
+        return -EINVAL;
+    }
+    memcpy(host, src, TARGET_PAGE_SIZE);
+    return 0;
+}
+
 static int ram_load_precopy(QEMUFile *f)
 {
     MigrationIncomingState *mis = migration_incoming_get_current();
@@ -3918,7 +4087,8 @@ static int ram_load_precopy(QEMUFile *f)
         }
 
         if (flags & (RAM_SAVE_FLAG_ZERO | RAM_SAVE_FLAG_PAGE |
-                     RAM_SAVE_FLAG_COMPRESS_PAGE | RAM_SAVE_FLAG_XBZRLE)) {
+                     RAM_SAVE_FLAG_COMPRESS_PAGE | RAM_SAVE_FLAG_XBZRLE |
+                     RAM_SAVE_FLAG_DUP)) {
             RAMBlock *block = ram_block_from_stream(mis, f, flags,
                                                     RAM_CHANNEL_PRECOPY);
 
@@ -3995,6 +4165,12 @@ static int ram_load_precopy(QEMUFile *f)
                 break;
             }
             break;
+        case RAM_SAVE_FLAG_DUP:
+            if (load_dup_page(f, mis->last_recv_block[RAM_CHANNEL_PRECOPY],
+                              host) < 0) {
+                ret = -EINVAL;
+            }
+            break;
         case RAM_SAVE_FLAG_MULTIFD_FLUSH:
             multifd_recv_sync_main();
             break;
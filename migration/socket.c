@@ -162,22 +162,103 @@ socket_incoming_migration_end(void *opaque)
     object_unref(OBJECT(listener));
 }
 
+#ifdef EMSCRIPTEN
+/*
+ * A page can't accept connections, so in the browser the destination dials
+ * out to host:port instead, and Emscripten carries each socket over a
+ * WebSocket to ws://host:port/. A relay there pairs every WebSocket with a
+ * connection from the source (examples/migration/ws-relay.py), so multifd
+ * channels arrive as separate WebSockets and their pages are decompressed
+ * by the receive threads in parallel.
+ */
+static gboolean socket_incoming_connected(QIOChannel *ioc,
+                                          GIOCondition condition,
+                                          gpointer opaque)
+{
+    if (condition & (G_IO_ERR | G_IO_HUP)) {
+        error_report("%s: Could not connect to the migration source",
+                     __func__);
+        return G_SOURCE_REMOVE;
+    }
+
+    trace_migration_socket_incoming_accepted();
+    qio_channel_set_name(ioc, "migration-socket-incoming");
+    migration_channel_process_incoming(ioc);
+    return G_SOURCE_REMOVE;
+}
+
+static void socket_connect_incoming_migration(SocketAddress *saddr, int num,
+                                              Error **errp)
+{
+    struct addrinfo ai = { .ai_socktype = SOCK_STREAM }, *res;
+
+    if (saddr->type != SOCKET_ADDRESS_TYPE_INET) {
+        error_setg(errp, "Only TCP can be used for incoming migration "
+                   "in the browser");
+        return;
+    }
+    if (getaddrinfo(saddr->u.inet.host, saddr->u.inet.port, &ai, &res)) {
+        error_setg(errp, "address resolution failed for %s:%s",
+                   saddr->u.inet.host, saddr->u.inet.port);
+        return;
+    }
+
+    for (int i = 0; i < num; i++) {
+        QIOChannelSocket *sioc;
+        int fd = qemu_socket(res->ai_family, res->ai_socktype,
+                             res->ai_protocol);
+
+        if (fd < 0) {
+            error_setg_errno(errp, errno, "Failed to create socket");
+            break;
+        }
+        /* The WebSocket opens asynchronously, wait for it to be writable */
+        qemu_socket_set_nonblock(fd);
+        if (connect(fd, res->ai_addr, res->ai_addrlen) < 0 &&
+            errno != EINPROGRESS) {
+            error_setg_errno(errp, errno, "Failed to connect to '%s:%s'",
+                             saddr->u.inet.host, saddr->u.inet.port);
+            close(fd);
+            break;
+        }
+        sioc = qio_channel_socket_new_fd(fd, errp);
+        if (!sioc) {
+            close(fd);
+            break;
+        }
+        /* The watch holds the channel until it is connected */
+        qio_channel_add_watch_full(QIO_CHANNEL(sioc), G_IO_OUT,
+                                   socket_incoming_connected, NULL,
+                                   (GDestroyNotify)object_unref,
+                                   g_main_context_get_thread_default());
+    }
+
+    freeaddrinfo(res);
+}
+#endif
+
 void socket_start_incoming_migration(SocketAddress *saddr,
                                      Error **errp)
 {
-    QIONetListener *listener = qio_net_listener_new();
+    QIONetListener *listener;
     MigrationIncomingState *mis = migration_incoming_get_current();
     size_t i;
     int num = 1;
 
-    qio_net_listener_set_name(listener, "migration-socket-listener");
-
     if (migrate_multifd()) {
         num = migrate_multifd_channels();
     } else if (migrate_postcopy_preempt()) {
         num = RAM_CHANNEL_MAX;
     }
 
+#ifdef EMSCRIPTEN
+    socket_connect_incoming_migration(saddr, num, errp);
+    return;
+#endif
+
+    listener = qio_net_listener_new();
+    qio_net_listener_set_name(listener, "migration-socket-listener");
+
     if (qio_net_listener_open_sync(listener, saddr, num, errp) < 0) {
         object_unref(OBJECT(listener));
         return;
@@ -158,6 +158,99 @@ int xbzrle_encode_buffer(uint8_t *old_buf, uint8_t *new_buf, int slen,
     return accel_func(old_buf, new_buf, slen, dst, dlen);
 }
 
+#define xbzrle_encode_buffer xbzrle_encode_buffer_int
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+
+/*
+ * Return the end of the run of bytes starting at @i that are equal in
+ * both buffers if @same, or that differ if not.
+ */
+static int xbzrle_run_end_simd128(const uint8_t *old_buf,
+                                  const uint8_t *new_buf,
+                                  int i, int slen, bool same)
+{
+    while (i + 16 <= slen) {
+        v128_t eq = wasm_i8x16_eq(wasm_v128_load(old_buf + i),
+                                  wasm_v128_load(new_buf + i));
+        uint32_t run = wasm_i8x16_bitmask(eq) ^ (same ? 0 : 0xffff);
+
+        if (run != 0xffff) {
+            return i + ctz32(~run);
+        }
+        i += 16;
+    }
+    while (i < slen && (old_buf[i] == new_buf[i]) == same) {
+        i++;
+    }
+    return i;
+}
+
+/* Produces the same encoding as xbzrle_encode_buffer_int() */
+static int xbzrle_encode_buffer_simd128(uint8_t *old_buf, uint8_t *new_buf,
+                                        int slen, uint8_t *dst, int dlen)
+{
+    int d = 0, i = 0;
+
+    while (i < slen) {
+        int start = i;
+
+        /* overflow */
+        if (d + 2 > dlen) {
+            return -1;
+        }
+
+        i = xbzrle_run_end_simd128(old_buf, new_buf, i, slen, true);
+
+        /* buffer unchanged */
+        if (i - start == slen) {
+            return 0;
+        }
+
+        /* skip last zero run */
+        if (i == slen) {
+            return d;
+        }
+
+        d += uleb128_encode_small(dst + d, i - start);
+        start = i;
+
+        /* overflow */
+        if (d + 2 > dlen) {
+            return -1;
+        }
+
+        i = xbzrle_run_end_simd128(old_buf, new_buf, i, slen, false);
+
+        d += uleb128_encode_small(dst + d, i - start);
+        /* overflow */
+        if (d + i - start > dlen) {
+            return -1;
+        }
+        memcpy(dst + d, new_buf + start, i - start);
+        d += i - start;
+    }
+
+    return d;
+}
+
+static int xbzrle_encode_buffer_int(uint8_t *old_buf, uint8_t *new_buf,
+                                    int slen, uint8_t *dst, int dlen);
+
+/*
+ * Unlike the AVX512 version, chosen when built with -msimd128 rather
+ * than through cpuinfo.  Buffers shorter than a vector take the integer
+ * version.
+ */
+int xbzrle_encode_buffer(uint8_t *old_buf, uint8_t *new_buf, int slen,
+                         uint8_t *dst, int dlen)
+{
+    if (slen < 16) {
+        return xbzrle_encode_buffer_int(old_buf, new_buf, slen, dst, dlen);
+    }
+    return xbzrle_encode_buffer_simd128(old_buf, new_buf, slen, dst, dlen);
+}
+
 #define xbzrle_encode_buffer xbzrle_encode_buffer_int
 #endif
 
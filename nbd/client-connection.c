@@ -31,6 +31,10 @@
 #include "qapi/clone-visitor.h"
 #include "qemu/coroutine.h"
 
+#ifdef EMSCRIPTEN
+#include "io/channel-sabring.h"
+#endif
+
 struct NBDClientConnection {
     /* Initialization constants, never change */
     SocketAddress *saddr; /* address to connect to */
@@ -39,6 +43,7 @@ struct NBDClientConnection {
     NBDExportInfo initial_info;
     bool do_negotiation;
     bool do_retry;
+    bool websocket;
 
     QemuMutex mutex;
 
@@ -48,7 +53,7 @@ struct NBDClientConnection {
      * used only by thread and not protected by mutex. When thread is not
      * running, @sioc is stolen by nbd_co_establish_connection() under mutex.
      */
-    QIOChannelSocket *sioc;
+    QIOChannel *sioc;
     QIOChannel *ioc;
     /*
      * @err represents previous attempt. It may be copied by
@@ -76,6 +81,16 @@ void nbd_client_connection_enable_retry(NBDClientConnection *conn)
     conn->do_retry = true;
 }
 
+/*
+ * Like nbd_client_connection_enable_retry(), only call it before the first
+ * connection attempt. The address is then that of a WebSocket that an I/O
+ * worker of the page opens, see io/channel-sabring.c.
+ */
+void nbd_client_connection_enable_websocket(NBDClientConnection *conn)
+{
+    conn->websocket = true;
+}
+
 NBDClientConnection *nbd_client_connection_new(const SocketAddress *saddr,
                                                bool do_negotiation,
                                                const char *export_name,
@@ -107,7 +122,7 @@ NBDClientConnection *nbd_client_connection_new(const SocketAddress *saddr,
 static void nbd_client_connection_do_free(NBDClientConnection *conn)
 {
     if (conn->sioc) {
-        qio_channel_close(QIO_CHANNEL(conn->sioc), NULL);
+        qio_channel_close(conn->sioc, NULL);
         object_unref(OBJECT(conn->sioc));
     }
     error_free(conn->err);
@@ -124,7 +139,7 @@ static void nbd_client_connection_do_free(NBDClientConnection *conn)
  * are given @outioc is returned. @outioc is provided only on success.  The call
  * may be cancelled from other thread by simply qio_channel_shutdown(sioc).
  */
-static int nbd_connect(QIOChannelSocket *sioc, SocketAddress *addr,
+static int nbd_connect(QIOChannel *sioc, SocketAddress *addr,
                        NBDExportInfo *info, QCryptoTLSCreds *tlscreds,
                        const char *tlshostname,
                        QIOChannel **outioc, Error **errp)
@@ -135,18 +150,27 @@ static int nbd_connect(QIOChannelSocket *sioc, SocketAddress *addr,
         *outioc = NULL;
     }
 
-    ret = qio_channel_socket_connect_sync(sioc, addr, errp);
+#ifdef EMSCRIPTEN
+    if (object_dynamic_cast(OBJECT(sioc), TYPE_QIO_CHANNEL_SABRING)) {
+        ret = qio_channel_sabring_connect_sync(QIO_CHANNEL_SABRING(sioc),
+                                               addr, errp);
+    } else
+#endif
+    {
+        ret = qio_channel_socket_connect_sync(QIO_CHANNEL_SOCKET(sioc), addr,
+                                              errp);
+    }
     if (ret < 0) {
         return ret;
     }
 
-    qio_channel_set_delay(QIO_CHANNEL(sioc), false);
+    qio_channel_set_delay(sioc, false);
 
     if (!info) {
         return 0;
     }
 
-    ret = nbd_receive_negotiate(QIO_CHANNEL(sioc), tlscreds, tlshostname,
+    ret = nbd_receive_negotiate(sioc, tlscreds, tlshostname,
                                 outioc, info, errp);
     if (ret < 0) {
         /*
@@ -159,7 +183,7 @@ static int nbd_connect(QIOChannelSocket *sioc, SocketAddress *addr,
             object_unref(OBJECT(*outioc));
             *outioc = NULL;
         } else {
-            qio_channel_close(QIO_CHANNEL(sioc), NULL);
+            qio_channel_close(sioc, NULL);
         }
 
         return ret;
@@ -181,7 +205,14 @@ static void *connect_thread_func(void *opaque)
         Error *local_err = NULL;
 
         assert(!conn->sioc);
-        conn->sioc = qio_channel_socket_new();
+#ifdef EMSCRIPTEN
+        if (conn->websocket) {
+            conn->sioc = QIO_CHANNEL(qio_channel_sabring_new());
+        } else
+#endif
+        {
+            conn->sioc = QIO_CHANNEL(qio_channel_socket_new());
+        }
 
         qemu_mutex_unlock(&conn->mutex);
 
@@ -262,8 +293,7 @@ void nbd_client_connection_release(NBDClientConnection *conn)
             do_free = true;
         }
         if (conn->sioc) {
-            qio_channel_shutdown(QIO_CHANNEL(conn->sioc),
-                                 QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
+            qio_channel_shutdown(conn->sioc, QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
         }
     }
 
@@ -321,7 +351,7 @@ nbd_co_establish_connection(NBDClientConnection *conn, NBDExportInfo *info,
 
                 assert(!conn->ioc);
 
-                return QIO_CHANNEL(g_steal_pointer(&conn->sioc));
+                return g_steal_pointer(&conn->sioc);
             }
 
             conn->running = true;
@@ -393,7 +423,7 @@ nbd_co_establish_connection(NBDClientConnection *conn, NBDExportInfo *info,
 
             assert(!conn->ioc);
 
-            return QIO_CHANNEL(g_steal_pointer(&conn->sioc));
+            return g_steal_pointer(&conn->sioc);
         }
     }
 
@@ -1122,6 +1122,9 @@ static int (* const net_client_init_fun[NET_CLIENT_DRIVER__MAX])(
 #ifdef CONFIG_L2TPV3
         [NET_CLIENT_DRIVER_L2TPV3]    = net_init_l2tpv3,
 #endif
+#ifdef EMSCRIPTEN
+        [NET_CLIENT_DRIVER_SABRING]   = net_init_sabring,
+#endif
 #ifdef CONFIG_VMNET
         [NET_CLIENT_DRIVER_VMNET_HOST] = net_init_vmnet_host,
         [NET_CLIENT_DRIVER_VMNET_SHARED] = net_init_vmnet_shared,
@@ -0,0 +1,364 @@
+/*
+ * Network backend exchanging frames through rings in shared wasm memory
+ *
+ * Connects the guest to a network stack in another worker of the page,
+ * such as c2w-net-proxy, without going through sockets: each direction is
+ * a single-producer single-consumer ring in the SharedArrayBuffer of the
+ * wasm memory, and the side that makes a ring non-empty wakes the other
+ * with a futex (Atomics.notify in JS). Frames are copied once into a ring
+ * and once out of it, without JS calls or proxying to the main thread.
+ *
+ *   -netdev sabring,id=vmnic,size=1M -device virtio-net-pci,netdev=vmnic
+ *
+ * With vnet-hdr=on frames carry a virtio-net header, so that virtio-net
+ * hands over checksums and TSO/UFO frames of up to 64 KiB for the stack to
+ * complete or use as they are, and the stack may send such frames too;
+ * the ring headers say which offloads the guest accepts.
+ *
+ * With queues=N there are N pairs of rings, one per queue pair of a
+ * virtio-net device with mq=on, each with its own waiting thread, and the
+ * guest spreads its flows over them.
+ *
+ * The page finds the rings with sabring_lookup("vmnic", queue) and hands
+ * the wasm memory and that address to the stack's worker, which accesses
+ * them with examples/networking/htdocs/sabring.js.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include <emscripten.h>
+#include <emscripten/threading.h>
+
+#include "net/net.h"
+#include "clients.h"
+#include "qapi/error.h"
+#include "qemu/atomic.h"
+#include "qemu/host-utils.h"
+#include "qemu/iov.h"
+#include "qemu/main-loop.h"
+#include "qemu/memalign.h"
+#include "qemu/queue.h"
+#include "qemu/sabring.h"
+#include "qemu/units.h"
+#include "standard-headers/linux/virtio_net.h"
+
+/*
+ * Each frame in a ring is a 32-bit length followed by the data, padded
+ * to 4 bytes, and may wrap around the end of data[]. The user[] fields:
+ */
+#define SABRING_VNET_HDR_LEN    0   /* of the header before each frame, or 0 */
+#define SABRING_OFFLOADS        1   /* SABRING_OFFLOAD_* the guest takes */
+
+#define SABRING_OFFLOAD_CSUM    (1 << 0)
+#define SABRING_OFFLOAD_TSO4    (1 << 1)
+#define SABRING_OFFLOAD_TSO6    (1 << 2)
+#define SABRING_OFFLOAD_ECN     (1 << 3)
+#define SABRING_OFFLOAD_UFO     (1 << 4)
+#define SABRING_OFFLOAD_USO4    (1 << 5)
+#define SABRING_OFFLOAD_USO6    (1 << 6)
+
+#define SABRING_HDR_SIZE    4
+/* room for two TSO frames */
+#define SABRING_MIN_SIZE    (256 * KiB)
+#define SABRING_DEFAULT_SIZE (1 * MiB)
+
+typedef struct SabRingState {
+    NetClientState nc;
+    SabRing *out;       /* frames from the guest, consumed by the stack */
+    SabRing *in;        /* frames from the stack, consumed here */
+    QEMUBH *bh;
+    SabRingWaiter waiter;
+    uint8_t *buf;       /* for incoming frames that wrap around */
+    unsigned queue;
+    int vnet_hdr_len;   /* 0 without vnet-hdr=on */
+    bool using_vnet_hdr;
+    QLIST_ENTRY(SabRingState) next;
+} SabRingState;
+
+static QLIST_HEAD(, SabRingState) sabrings = QLIST_HEAD_INITIALIZER(sabrings);
+
+static ssize_t sabring_receive_iov(NetClientState *nc,
+                                   const struct iovec *iov, int iovcnt)
+{
+    SabRingState *s = DO_UPCAST(SabRingState, nc, nc);
+    SabRing *r = s->out;
+    size_t size = iov_size(iov, iovcnt);
+    uint32_t len = size;
+    uint32_t head = r->head;
+    uint32_t pos;
+
+    if (SABRING_HDR_SIZE + ROUND_UP(size, 4) > sab_ring_room(r)) {
+        /* like a full link, the guest's stack retransmits */
+        qatomic_inc(&r->dropped);
+        return size;
+    }
+
+    sab_ring_copy_in(r, head, &len, SABRING_HDR_SIZE);
+    pos = head + SABRING_HDR_SIZE;
+    for (int i = 0; i < iovcnt; i++) {
+        sab_ring_copy_in(r, pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+    qatomic_store_release(&r->head, head + SABRING_HDR_SIZE + ROUND_UP(size, 4));
+
+    /*
+     * The consumer only sleeps on an empty ring, and re-reads head after
+     * publishing its tail, so one of us sees the other's update.
+     */
+    smp_mb();
+    if (qatomic_read(&r->tail) == head) {
+        emscripten_futex_wake(&r->head, 1);
+    }
+    return size;
+}
+
+static void sabring_send_completed(NetClientState *nc, ssize_t len)
+{
+    SabRingState *s = DO_UPCAST(SabRingState, nc, nc);
+
+    qemu_bh_schedule(s->bh);
+}
+
+static void sabring_bh(void *opaque)
+{
+    SabRingState *s = opaque;
+    SabRing *r = s->in;
+    uint32_t tail = r->tail;
+
+    for (;;) {
+        uint32_t head = qatomic_load_acquire(&r->head);
+        uint32_t off = (tail + SABRING_HDR_SIZE) & (r->size - 1);
+        const uint8_t *data;
+        uint32_t len;
+        ssize_t ret;
+
+        if (head == tail) {
+            /* pairs with the producer's check before it notifies */
+            smp_mb();
+            if (qatomic_read(&r->head) == tail) {
+                break;
+            }
+            continue;
+        }
+
+        sab_ring_copy_out(r, tail, &len, SABRING_HDR_SIZE);
+        if (len > NET_BUFSIZE ||
+            SABRING_HDR_SIZE + ROUND_UP(len, 4) > head - tail) {
+            /* not a frame the stack wrote, drop what is there */
+            qatomic_store_release(&r->tail, head);
+            tail = head;
+            continue;
+        }
+        if (off + len <= r->size) {
+            data = r->data + off;
+        } else {
+            sab_ring_copy_out(r, tail + SABRING_HDR_SIZE, s->buf, len);
+            data = s->buf;
+        }
+
+        /* the net queue copies what it can't deliver now */
+        ret = qemu_send_packet_async(&s->nc, data, len,
+                                     sabring_send_completed);
+        tail += SABRING_HDR_SIZE + ROUND_UP(len, 4);
+        qatomic_store_release(&r->tail, tail);
+        if (ret == 0) {
+            /* the peer is full, go on in sabring_send_completed() */
+            return;
+        }
+    }
+}
+
+/* The stack moved the incoming ring, leave the frames to sabring_bh() */
+static void sabring_notify(void *opaque)
+{
+    SabRingState *s = opaque;
+
+    qemu_bh_schedule(s->bh);
+}
+
+static void sabring_cleanup(NetClientState *nc)
+{
+    SabRingState *s = DO_UPCAST(SabRingState, nc, nc);
+
+    sab_ring_waiter_stop(&s->waiter);
+    qemu_bh_delete(s->bh);
+
+    QLIST_REMOVE(s, next);
+    qemu_vfree(s->out);
+    g_free(s->buf);
+}
+
+/* Tells the stack what the frames in both directions start with */
+static void sabring_publish_vnet_hdr(SabRingState *s)
+{
+    uint32_t len = s->using_vnet_hdr ? s->vnet_hdr_len : 0;
+
+    qatomic_set(&s->out->user[SABRING_VNET_HDR_LEN], len);
+    qatomic_set(&s->in->user[SABRING_VNET_HDR_LEN], len);
+}
+
+static bool sabring_has_ufo(NetClientState *nc)
+{
+    SabRingState *s = DO_UPCAST(SabRingState, nc, nc);
+
+    return !!s->vnet_hdr_len;
+}
+
+static bool sabring_has_vnet_hdr(NetClientState *nc)
+{
+    SabRingState *s = DO_UPCAST(SabRingState, nc, nc);
+
+    return !!s->vnet_hdr_len;
+}
+
+static bool sabring_has_vnet_hdr_len(NetClientState *nc, int len)
+{
+    return len == sizeof(struct virtio_net_hdr_mrg_rxbuf) ||
+           len == sizeof(struct virtio_net_hdr) ||
+           len == sizeof(struct virtio_net_hdr_v1_hash);
+}
+
+static int sabring_get_vnet_hdr_len(NetClientState *nc)
+{
+    SabRingState *s = DO_UPCAST(SabRingState, nc, nc);
+
+    return s->vnet_hdr_len;
+}
+
+static void sabring_set_vnet_hdr_len(NetClientState *nc, int len)
+{
+    SabRingState *s = DO_UPCAST(SabRingState, nc, nc);
+
+    assert(sabring_has_vnet_hdr_len(nc, len));
+    s->vnet_hdr_len = len;
+    sabring_publish_vnet_hdr(s);
+}
+
+static bool sabring_get_using_vnet_hdr(NetClientState *nc)
+{
+    SabRingState *s = DO_UPCAST(SabRingState, nc, nc);
+
+    return s->using_vnet_hdr;
+}
+
+static void sabring_using_vnet_hdr(NetClientState *nc, bool using_vnet_hdr)
+{
+    SabRingState *s = DO_UPCAST(SabRingState, nc, nc);
+
+    assert(!!s->vnet_hdr_len == using_vnet_hdr);
+    s->using_vnet_hdr = using_vnet_hdr;
+    sabring_publish_vnet_hdr(s);
+}
+
+static void sabring_set_offload(NetClientState *nc, int csum, int tso4,
+                                int tso6, int ecn, int ufo, int uso4, int uso6)
+{
+    SabRingState *s = DO_UPCAST(SabRingState, nc, nc);
+
+    qatomic_set(&s->out->user[SABRING_OFFLOADS],
+                (csum ? SABRING_OFFLOAD_CSUM : 0) |
+                (tso4 ? SABRING_OFFLOAD_TSO4 : 0) |
+                (tso6 ? SABRING_OFFLOAD_TSO6 : 0) |
+                (ecn ? SABRING_OFFLOAD_ECN : 0) |
+                (ufo ? SABRING_OFFLOAD_UFO : 0) |
+                (uso4 ? SABRING_OFFLOAD_USO4 : 0) |
+                (uso6 ? SABRING_OFFLOAD_USO6 : 0));
+}
+
+static NetClientInfo net_sabring_info = {
+    .type = NET_CLIENT_DRIVER_SABRING,
+    .size = sizeof(SabRingState),
+    .receive_iov = sabring_receive_iov,
+    .cleanup = sabring_cleanup,
+    .has_ufo = sabring_has_ufo,
+    .has_vnet_hdr = sabring_has_vnet_hdr,
+    .has_vnet_hdr_len = sabring_has_vnet_hdr_len,
+    .get_using_vnet_hdr = sabring_get_using_vnet_hdr,
+    .using_vnet_hdr = sabring_using_vnet_hdr,
+    .set_offload = sabring_set_offload,
+    .get_vnet_hdr_len = sabring_get_vnet_hdr_len,
+    .set_vnet_hdr_len = sabring_set_vnet_hdr_len,
+};
+
+/*
+ * Address of the outgoing ring of a queue of the netdev, the incoming ring
+ * follows it. Returns 0 if there is no sabring netdev with that id or it
+ * has no such queue.
+ */
+EMSCRIPTEN_KEEPALIVE uintptr_t sabring_lookup(const char *id, unsigned queue)
+{
+    SabRingState *s;
+
+    QLIST_FOREACH(s, &sabrings, next) {
+        if (!strcmp(s->nc.name, id) && s->queue == queue) {
+            return (uintptr_t)s->out;
+        }
+    }
+    return 0;
+}
+
+static void net_sabring_init_one(NetClientState *peer, const char *name,
+                                 uint64_t size, unsigned queue, bool vnet_hdr)
+{
+    NetClientState *nc;
+    SabRingState *s;
+    void *rings;
+
+    rings = qemu_memalign(64, 2 * sab_ring_footprint(size));
+
+    nc = qemu_new_net_client(&net_sabring_info, peer, "sabring", name);
+    qemu_set_info_str(nc, "queue=%u,size=%" PRIu64, queue, size);
+
+    s = DO_UPCAST(SabRingState, nc, nc);
+    s->queue = queue;
+    s->vnet_hdr_len = vnet_hdr ? sizeof(struct virtio_net_hdr) : 0;
+    s->out = rings;
+    sab_ring_init(s->out, size);
+    s->in = sab_ring_next(s->out);
+    sab_ring_init(s->in, size);
+    s->buf = g_malloc(NET_BUFSIZE);
+    s->bh = qemu_bh_new(sabring_bh, s);
+    QLIST_INSERT_HEAD(&sabrings, s, next);
+
+    sab_ring_waiter_start(&s->waiter, "sabring", &s->in->head,
+                          sabring_notify, s);
+}
+
+int net_init_sabring(const Netdev *netdev, const char *name,
+                     NetClientState *peer, Error **errp)
+{
+    const NetdevSabringOptions *opts;
+    uint64_t size = SABRING_DEFAULT_SIZE;
+    unsigned queues;
+
+    assert(netdev->type == NET_CLIENT_DRIVER_SABRING);
+    opts = &netdev->u.sabring;
+
+    if (opts->has_size) {
+        size = opts->size;
+    }
+    if (size < SABRING_MIN_SIZE || size > 1 * GiB || !is_power_of_2(size)) {
+        error_setg(errp,
+                   "sabring size must be a power of 2 between 256K and 1G");
+        return -1;
+    }
+    queues = opts->has_queues ? opts->queues : 1;
+    if (queues < 1 || queues > MAX_QUEUE_NUM) {
+        error_setg(errp, "sabring queues must be between 1 and %d",
+                   MAX_QUEUE_NUM);
+        return -1;
+    }
+    if (queues > 1 && peer) {
+        error_setg(errp, "Multiqueue sabring cannot be used with hubs");
+        return -1;
+    }
+
+    for (unsigned i = 0; i < queues; i++) {
+        net_sabring_init_one(peer, name, size, i,
+                             opts->has_vnet_hdr && opts->vnet_hdr);
+    }
+    return 0;
+}
@@ -69,6 +69,113 @@ typedef int (*qemu_plugin_install_func_t)(qemu_plugin_id_t, const qemu_info_t *,
 
 extern struct qemu_plugin_state plugin;
 
+#ifdef EMSCRIPTEN
+/*
+ * The browser can't load shared objects, so some of contrib/plugins are
+ * linked in with their entry points renamed (see plugins/meson.build) and
+ * selected with -plugin builtin:NAME.
+ */
+#define BUILTIN_PLUGIN_PREFIX "builtin:"
+
+#define DECLARE_BUILTIN_PLUGIN(name)                                    \
+    extern int qemu_plugin_##name##_version;                           \
+    int qemu_plugin_##name##_install(qemu_plugin_id_t id,               \
+                                     const qemu_info_t *info,           \
+                                     int argc, char **argv);
+
+DECLARE_BUILTIN_PLUGIN(hotblocks)
+DECLARE_BUILTIN_PLUGIN(hotpages)
+
+#define BUILTIN_PLUGIN(name) \
+    { #name, qemu_plugin_##name##_install, &qemu_plugin_##name##_version }
+
+static const struct {
+    const char *name;
+    qemu_plugin_install_func_t install;
+    int *version;
+} builtin_plugins[] = {
+    BUILTIN_PLUGIN(hotblocks),
+    BUILTIN_PLUGIN(hotpages),
+};
+
+static bool plugin_find_entry(struct qemu_plugin_ctx *ctx,
+                              qemu_plugin_install_func_t *install,
+                              int *version, Error **errp)
+{
+    const char *path = ctx->desc->path;
+
+    if (g_str_has_prefix(path, BUILTIN_PLUGIN_PREFIX)) {
+        const char *name = path + strlen(BUILTIN_PLUGIN_PREFIX);
+
+        for (int i = 0; i < ARRAY_SIZE(builtin_plugins); i++) {
+            if (strcmp(builtin_plugins[i].name, name) == 0) {
+                *install = builtin_plugins[i].install;
+                *version = *builtin_plugins[i].version;
+                return true;
+            }
+        }
+    }
+    error_setg(errp, "Could not load plugin %s: only builtin plugins can be "
+               "loaded on this host", path);
+    error_append_hint(errp, "Builtin plugins:");
+    for (int i = 0; i < ARRAY_SIZE(builtin_plugins); i++) {
+        error_append_hint(errp, " " BUILTIN_PLUGIN_PREFIX "%s",
+                          builtin_plugins[i].name);
+    }
+    error_append_hint(errp, "\n");
+    return false;
+}
+
+static void plugin_close(struct qemu_plugin_ctx *ctx)
+{
+}
+#else
+static bool plugin_find_entry(struct qemu_plugin_ctx *ctx,
+                              qemu_plugin_install_func_t *install,
+                              int *version, Error **errp)
+{
+    struct qemu_plugin_desc *desc = ctx->desc;
+    gpointer sym;
+
+    ctx->handle = g_module_open(desc->path, G_MODULE_BIND_LOCAL);
+    if (ctx->handle == NULL) {
+        error_setg(errp, "Could not load plugin %s: %s", desc->path, g_module_error());
+        return false;
+    }
+
+    if (!g_module_symbol(ctx->handle, "qemu_plugin_install", &sym)) {
+        error_setg(errp, "Could not load plugin %s: %s", desc->path, g_module_error());
+        goto err_symbol;
+    }
+    *install = (qemu_plugin_install_func_t) sym;
+    /* symbol was found; it could be NULL though */
+    if (*install == NULL) {
+        error_setg(errp, "Could not load plugin %s: qemu_plugin_install is NULL",
+                   desc->path);
+        goto err_symbol;
+    }
+
+    if (!g_module_symbol(ctx->handle, "qemu_plugin_version", &sym)) {
+        error_setg(errp, "Could not load plugin %s: plugin does not declare API version %s",
+                   desc->path, g_module_error());
+        goto err_symbol;
+    }
+    *version = *(int *)sym;
+    return true;
+
+ err_symbol:
+    g_module_close(ctx->handle);
+    return false;
+}
+
+static void plugin_close(struct qemu_plugin_ctx *ctx)
+{
+    if (!g_module_close(ctx->handle)) {
+        warn_report("%s: %s", __func__, g_module_error());
+    }
+}
+#endif
+
 void qemu_plugin_add_dyn_cb_arr(GArray *arr)
 {
     uint32_t hash = qemu_xxhash2((uint64_t)(uintptr_t)arr);
@@ -178,50 +285,29 @@ static int plugin_load(struct qemu_plugin_desc *desc, const qemu_info_t *info, E
 {
     qemu_plugin_install_func_t install;
     struct qemu_plugin_ctx *ctx;
-    gpointer sym;
+    int version;
     int rc;
 
     ctx = qemu_memalign(qemu_dcache_linesize, sizeof(*ctx));
     memset(ctx, 0, sizeof(*ctx));
     ctx->desc = desc;
 
-    ctx->handle = g_module_open(desc->path, G_MODULE_BIND_LOCAL);
-    if (ctx->handle == NULL) {
-        error_setg(errp, "Could not load plugin %s: %s", desc->path, g_module_error());
+    if (!plugin_find_entry(ctx, &install, &version, errp)) {
         goto err_dlopen;
     }
 
-    if (!g_module_symbol(ctx->handle, "qemu_plugin_install", &sym)) {
-        error_setg(errp, "Could not load plugin %s: %s", desc->path, g_module_error());
+    if (version < QEMU_PLUGIN_MIN_VERSION) {
+        error_setg(errp, "Could not load plugin %s: plugin requires API version %d, but "
+                   "this QEMU supports only a minimum version of %d",
+                   desc->path, version, QEMU_PLUGIN_MIN_VERSION);
         goto err_symbol;
-    }
-    install = (qemu_plugin_install_func_t) sym;
-    /* symbol was found; it could be NULL though */
-    if (install == NULL) {
-        error_setg(errp, "Could not load plugin %s: qemu_plugin_install is NULL",
-                   desc->path);
+    } else if (version > QEMU_PLUGIN_VERSION) {
+        error_setg(errp, "Could not load plugin %s: plugin requires API version %d, but "
+                   "this QEMU supports only up to version %d",
+                   desc->path, version, QEMU_PLUGIN_VERSION);
         goto err_symbol;
     }
 
-    if (!g_module_symbol(ctx->handle, "qemu_plugin_version", &sym)) {
-        error_setg(errp, "Could not load plugin %s: plugin does not declare API version %s",
-                   desc->path, g_module_error());
-        goto err_symbol;
-    } else {
-        int version = *(int *)sym;
-        if (version < QEMU_PLUGIN_MIN_VERSION) {
-            error_setg(errp, "Could not load plugin %s: plugin requires API version %d, but "
-                       "this QEMU supports only a minimum version of %d",
-                       desc->path, version, QEMU_PLUGIN_MIN_VERSION);
-            goto err_symbol;
-        } else if (version > QEMU_PLUGIN_VERSION) {
-            error_setg(errp, "Could not load plugin %s: plugin requires API version %d, but "
-                       "this QEMU supports only up to version %d",
-                       desc->path, version, QEMU_PLUGIN_VERSION);
-            goto err_symbol;
-        }
-    }
-
     qemu_rec_mutex_lock(&plugin.lock);
 
     /* find an unused random id with &ctx as the seed */
@@ -259,7 +345,7 @@ static int plugin_load(struct qemu_plugin_desc *desc, const qemu_info_t *info, E
     return rc;
 
  err_symbol:
-    g_module_close(ctx->handle);
+    plugin_close(ctx);
  err_dlopen:
     qemu_vfree(ctx);
     return 1;
@@ -362,9 +448,7 @@ static void plugin_reset_destroy__locked(struct qemu_plugin_reset_data *data)
     if (data->cb) {
         data->cb(ctx->id);
     }
-    if (!g_module_close(ctx->handle)) {
-        warn_report("%s: %s", __func__, g_module_error());
-    }
+    plugin_close(ctx);
     plugin_desc_free(ctx->desc);
     qemu_vfree(ctx);
     g_free(data);
@@ -188,7 +188,7 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                eager-split-size=n (KVM Eager Page Split chunk size, default 0, disabled. ARM only)\n"
     "                notify-vmexit=run|internal-error|disable,notify-window=n (enable notify VM exit and set notify window, x86 only)\n"
-    "                thread=single|multi (enable multi-threaded TCG)\n", QEMU_ARCH_ALL)
+    "                thread=single|multi|auto (enable multi-threaded TCG)\n", QEMU_ARCH_ALL)
 SRST
 ``-accel name[,prop=value[,...]]``
     This is used to enable an accelerator. Depending on the target
@@ -227,7 +227,7 @@ SRST
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
-    ``thread=single|multi``
+    ``thread=single|multi|auto``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
         additional host cores. The default is to enable multi-threading
@@ -235,6 +235,13 @@ SRST
         incompatible TCG features have been enabled (e.g.
         icount/replay).
 
+        With ``auto``, there is one thread per vCPU as with ``multi``,
+        but the vCPUs first run as many at once as there are host cores
+        to spare, for a few seconds. If they lost much of that time
+        waiting for each other, or few were busy, they then run one at a
+        time; otherwise as many at once as were busy. ``info jit`` shows
+        the choice.
+
     ``dirty-ring-size=n``
         When the KVM accelerator is used, it controls the size of the per-vCPU
         dirty page ring buffer (number of entries for each vCPU). It should
@@ -5059,6 +5066,10 @@ SRST
 ``-perfmap``
     Generate a map file for Linux perf tools that will allow basic profiling
     information to be broken down into basic blocks.
+
+    On wasm hosts, add a name section to the module of each compiled TB
+    instead, so that browser profilers show its function as
+    ``tb_<guest pc>_<flags>``.
 ERST
 
 DEF("jitdump", 0, QEMU_OPTION_jitdump,
@@ -5069,6 +5080,10 @@ SRST
     Generate a dump file for Linux perf tools that maps basic blocks to symbol
     names, line numbers and JITted code.
 ERST
+#elif defined(CONFIG_TCG) && defined(EMSCRIPTEN)
+DEF("perfmap", 0, QEMU_OPTION_perfmap,
+    "-perfmap        name the wasm modules of TBs for browser profilers\n",
+    QEMU_ARCH_ALL)
 #endif
 
 DEFHEADING()
@@ -0,0 +1,259 @@
+/*
+ * QEMU Guest Agent bulk file transfers
+ *
+ * guest-file-push and guest-file-pull move a whole file between the guest
+ * and the host over a virtio-serial port of its own, with the protocol in
+ * qemu/file-xfer.h. Only the command and its result go through the agent
+ * channel; the data is streamed through the port as raw bytes.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+
+#include "qapi/error.h"
+#include "qemu/bswap.h"
+#include "qemu/file-xfer.h"
+#include "qga-qapi-commands.h"
+#include "guest-agent-core.h"
+
+#define XFER_DEFAULT_PORT "/dev/virtio-ports/" FILE_XFER_PORT_NAME
+
+static ssize_t xfer_read_full(int fd, void *buf, size_t count)
+{
+    size_t done = 0;
+
+    while (done < count) {
+        ssize_t ret = read(fd, (uint8_t *)buf + done, count - done);
+
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return done ? done : ret;
+        }
+        done += ret;
+    }
+    return done;
+}
+
+/*
+ * Sends a request. len bytes of payload follow the header, unless payload
+ * is NULL, as for READs
+ */
+static bool xfer_send(int port, uint16_t op, uint16_t flags, uint64_t offset,
+                      const void *payload, uint32_t len, Error **errp)
+{
+    FileXferHdr hdr = {
+        .magic = cpu_to_le32(FILE_XFER_MAGIC),
+        .op = cpu_to_le16(op),
+        .flags = cpu_to_le16(flags),
+        .len = cpu_to_le32(len),
+        .offset = cpu_to_le64(offset),
+    };
+    struct iovec iov[2] = {
+        { .iov_base = &hdr, .iov_len = sizeof(hdr) },
+        { .iov_base = (void *)payload, .iov_len = payload ? len : 0 },
+    };
+    size_t total = sizeof(hdr) + iov[1].iov_len;
+    ssize_t ret;
+
+    do {
+        ret = writev(port, iov, payload ? 2 : 1);
+    } while (ret < 0 && errno == EINTR);
+    if (ret >= 0 && ret < total) {
+        /* the port took part of it, send the rest in order */
+        size_t skip = ret;
+        size_t n;
+
+        if (skip < sizeof(hdr)) {
+            n = sizeof(hdr) - skip;
+            if (qemu_write_full(port, (uint8_t *)&hdr + skip, n) != n) {
+                goto fail;
+            }
+            skip = sizeof(hdr);
+        }
+        n = total - skip;
+        if (n && qemu_write_full(port, (const uint8_t *)payload +
+                                 (skip - sizeof(hdr)), n) != n) {
+            goto fail;
+        }
+        return true;
+    }
+    if (ret >= 0) {
+        return true;
+    }
+fail:
+    error_setg_errno(errp, errno, "failed to write to transfer port");
+    return false;
+}
+
+/* Waits for the reply to the request with op, len and offset are out */
+static bool xfer_reply(int port, uint16_t op, uint32_t *len,
+                       uint64_t *offset, Error **errp)
+{
+    FileXferHdr hdr;
+    int status;
+
+    if (xfer_read_full(port, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+        error_setg_errno(errp, errno, "failed to read from transfer port");
+        return false;
+    }
+    if (le32_to_cpu(hdr.magic) != FILE_XFER_MAGIC ||
+        le16_to_cpu(hdr.op) != op) {
+        error_setg(errp, "unexpected reply on transfer port");
+        return false;
+    }
+    status = (int32_t)le32_to_cpu(hdr.status);
+    if (status < 0) {
+        error_setg_errno(errp, -status, "host failed transfer request");
+        return false;
+    }
+    if (len) {
+        *len = le32_to_cpu(hdr.len);
+    }
+    if (offset) {
+        *offset = le64_to_cpu(hdr.offset);
+    }
+    return true;
+}
+
+static int xfer_open_port(const char *port, Error **errp)
+{
+    int fd = qemu_open_old(port ?: XFER_DEFAULT_PORT, O_RDWR);
+
+    if (fd < 0) {
+        error_setg_errno(errp, errno, "failed to open transfer port '%s'",
+                         port ?: XFER_DEFAULT_PORT);
+    }
+    return fd;
+}
+
+static bool xfer_open_host(int port, const char *host_path, bool write,
+                           uint64_t *size, Error **errp)
+{
+    return xfer_send(port, FILE_XFER_OP_OPEN, write ? FILE_XFER_F_WRITE : 0,
+                     0, host_path, strlen(host_path), errp) &&
+           xfer_reply(port, FILE_XFER_OP_OPEN, NULL, size, errp);
+}
+
+GuestFileTransfer *qmp_guest_file_push(const char *path, const char *host_path,
+                                       const char *port, Error **errp)
+{
+    GuestFileTransfer *xfer = NULL;
+    g_autofree uint8_t *buf = NULL;
+    uint64_t count = 0;
+    int pfd, fd;
+
+    slog("guest-file-push called, path: %s, host-path: %s", path, host_path);
+    fd = qemu_open_old(path, O_RDONLY);
+    if (fd < 0) {
+        error_setg_errno(errp, errno, "failed to open file '%s'", path);
+        return NULL;
+    }
+    pfd = xfer_open_port(port, errp);
+    if (pfd < 0) {
+        close(fd);
+        return NULL;
+    }
+    if (!xfer_open_host(pfd, host_path, true, NULL, errp)) {
+        goto out;
+    }
+
+    buf = g_malloc(FILE_XFER_CHUNK);
+    for (;;) {
+        ssize_t n = xfer_read_full(fd, buf, FILE_XFER_CHUNK);
+
+        if (n < 0) {
+            error_setg_errno(errp, errno, "failed to read file '%s'", path);
+            goto out;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (!xfer_send(pfd, FILE_XFER_OP_WRITE, 0, count, buf, n, errp)) {
+            goto out;
+        }
+        count += n;
+    }
+
+    if (xfer_send(pfd, FILE_XFER_OP_CLOSE, 0, 0, NULL, 0, errp) &&
+        xfer_reply(pfd, FILE_XFER_OP_CLOSE, NULL, NULL, errp)) {
+        xfer = g_new0(GuestFileTransfer, 1);
+        xfer->count = count;
+    }
+
+out:
+    close(pfd);
+    close(fd);
+    return xfer;
+}
+
+GuestFileTransfer *qmp_guest_file_pull(const char *host_path, const char *path,
+                                       const char *port, Error **errp)
+{
+    GuestFileTransfer *xfer = NULL;
+    g_autofree uint8_t *buf = NULL;
+    uint64_t size, count = 0;
+    int pfd, fd = -1;
+
+    slog("guest-file-pull called, host-path: %s, path: %s", host_path, path);
+    pfd = xfer_open_port(port, errp);
+    if (pfd < 0) {
+        return NULL;
+    }
+    if (!xfer_open_host(pfd, host_path, false, &size, errp)) {
+        goto out;
+    }
+    fd = qemu_open_old(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error_setg_errno(errp, errno, "failed to open file '%s'", path);
+        goto out;
+    }
+
+    buf = g_malloc(FILE_XFER_CHUNK);
+    while (count < size) {
+        uint32_t len;
+
+        if (!xfer_send(pfd, FILE_XFER_OP_READ, 0, count, NULL,
+                       MIN(size - count, FILE_XFER_READ_MAX), errp)) {
+            goto out;
+        }
+        if (!xfer_reply(pfd, FILE_XFER_OP_READ, &len, NULL, errp)) {
+            goto out;
+        }
+        if (!len) {
+            /* the file shrank on the host */
+            break;
+        }
+        while (len) {
+            ssize_t n = xfer_read_full(pfd, buf, MIN(len, FILE_XFER_CHUNK));
+
+            if (n <= 0) {
+                error_setg_errno(errp, errno,
+                                 "failed to read from transfer port");
+                goto out;
+            }
+            if (qemu_write_full(fd, buf, n) != n) {
+                error_setg_errno(errp, errno, "failed to write file '%s'",
+                                 path);
+                goto out;
+            }
+            len -= n;
+            count += n;
+        }
+    }
+
+    if (xfer_send(pfd, FILE_XFER_OP_CLOSE, 0, 0, NULL, 0, errp) &&
+        xfer_reply(pfd, FILE_XFER_OP_CLOSE, NULL, NULL, errp)) {
+        xfer = g_new0(GuestFileTransfer, 1);
+        xfer->count = count;
+    }
+
+out:
+    if (fd >= 0) {
+        close(fd);
+    }
+    close(pfd);
+    return xfer;
+}
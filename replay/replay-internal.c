@@ -53,10 +53,13 @@ void replay_put_byte(uint8_t byte)
     }
 }
 
+unsigned int replay_event_count[EVENT_COUNT];
+
 void replay_put_event(uint8_t event)
 {
     assert(event < EVENT_COUNT);
     replay_put_byte(event);
+    qatomic_set(&replay_event_count[event], replay_event_count[event] + 1);
 }
 
 
@@ -185,6 +188,8 @@ void replay_fetch_data_kind(void)
                              replay_state.data_kind);
                 exit(1);
             }
+            qatomic_set(&replay_event_count[replay_state.data_kind],
+                        replay_event_count[replay_state.data_kind] + 1);
         }
     }
 }
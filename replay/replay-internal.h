@@ -87,6 +87,9 @@ typedef struct ReplayState {
 } ReplayState;
 extern ReplayState replay_state;
 
+/* Events written to or read from the log so far, by kind */
+extern unsigned int replay_event_count[EVENT_COUNT];
+
 /* File for replay writing */
 extern FILE *replay_file;
 /* Instruction count of the replay breakpoint */
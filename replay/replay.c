@@ -19,6 +19,9 @@
 #include "qemu/option.h"
 #include "sysemu/cpus.h"
 #include "qemu/error-report.h"
+#ifdef EMSCRIPTEN
+#include <emscripten.h>
+#endif
 
 /* Current version of the replay mechanism.
    Increase it when file format changes. */
@@ -388,3 +391,56 @@ const char *replay_get_filename(void)
 {
     return replay_filename;
 }
+
+#ifdef EMSCRIPTEN
+static unsigned int replay_event_sum(int first, int last)
+{
+    unsigned int sum = 0;
+
+    for (int i = first; i <= last; i++) {
+        sum += qatomic_read(&replay_event_count[i]);
+    }
+    return sum;
+}
+
+/*
+ * Counters for deterministic benchmarks: the guest instructions executed
+ * and the events of the log written or replayed so far. Two replays of a
+ * log that report different counts at the same point have diverged.
+ * The string stays valid until the next call.
+ */
+EMSCRIPTEN_KEEPALIVE const char *qemu_replay_stats_json(void)
+{
+    static const char *const modes[] = {
+        [REPLAY_MODE_NONE] = "none",
+        [REPLAY_MODE_RECORD] = "record",
+        [REPLAY_MODE_PLAY] = "play",
+    };
+    static char *json;
+
+    g_free(json);
+    json = g_strdup_printf(
+        "{\"mode\":\"%s\",\"icount\":%" PRId64 ",\"interrupts\":%u"
+        ",\"exceptions\":%u,\"bh\":%u,\"input\":%u,\"char_read\":%u"
+        ",\"char_write\":%u,\"block\":%u,\"net\":%u,\"clock\":%u"
+        ",\"checkpoints\":%u}",
+        modes[replay_mode], icount_enabled() ? icount_get_raw() : 0,
+        replay_event_sum(EVENT_INTERRUPT, EVENT_INTERRUPT),
+        replay_event_sum(EVENT_EXCEPTION, EVENT_EXCEPTION),
+        replay_event_sum(EVENT_ASYNC + REPLAY_ASYNC_EVENT_BH,
+                         EVENT_ASYNC + REPLAY_ASYNC_EVENT_BH_ONESHOT),
+        replay_event_sum(EVENT_ASYNC + REPLAY_ASYNC_EVENT_INPUT,
+                         EVENT_ASYNC + REPLAY_ASYNC_EVENT_INPUT_SYNC),
+        replay_event_sum(EVENT_ASYNC + REPLAY_ASYNC_EVENT_CHAR_READ,
+                         EVENT_ASYNC + REPLAY_ASYNC_EVENT_CHAR_READ) +
+        replay_event_sum(EVENT_CHAR_READ_ALL, EVENT_CHAR_READ_ALL_ERROR),
+        replay_event_sum(EVENT_CHAR_WRITE, EVENT_CHAR_WRITE),
+        replay_event_sum(EVENT_ASYNC + REPLAY_ASYNC_EVENT_BLOCK,
+                         EVENT_ASYNC + REPLAY_ASYNC_EVENT_BLOCK),
+        replay_event_sum(EVENT_ASYNC + REPLAY_ASYNC_EVENT_NET,
+                         EVENT_ASYNC + REPLAY_ASYNC_EVENT_NET),
+        replay_event_sum(EVENT_CLOCK, EVENT_CLOCK_LAST),
+        replay_event_sum(EVENT_CHECKPOINT, EVENT_CHECKPOINT_LAST));
+    return json;
+}
+#endif
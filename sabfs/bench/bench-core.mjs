@@ -0,0 +1,251 @@
+// Shared by the SABFS benchmark page, its workers and the Node runner: the
+// workloads, run against the SABFS object of the calling thread, and the
+// shape of the result.
+
+export const MiB = 1024 * 1024;
+
+export const DEFAULTS = {
+    size: 512 * MiB,        // size of the filesystem
+    inodes: 131072,
+    fileSize: 64 * MiB,     // file of the sequential and random I/O
+    sizes: [512, 4096, 65536, MiB],
+    randomOps: 4096,
+    files: 100000,          // files created, stat'd and listed in one directory
+    depth: 64,              // directories in the deep path
+    stats: 20000,
+    writers: 4,
+    writerSize: 16 * MiB,
+    writerChunk: 65536,
+};
+
+// xorshift32, so that each run does the same random I/O
+export function prng(seed) {
+    let x = seed | 0 || 1;
+    return () => {
+        x ^= x << 13;
+        x ^= x >>> 17;
+        x ^= x << 5;
+        return (x >>> 0) / 4294967296;
+    };
+}
+
+// Contents of byte i of the data written by writer id, checked afterwards
+export function pattern(buf, start, id) {
+    for (let i = 0; i < buf.length; i++) {
+        buf[i] = ((start + i) * 31 + id) & 0xff;
+    }
+}
+
+function checkPattern(buf, start, id) {
+    for (let i = 0; i < buf.length; i++) {
+        if (buf[i] !== (((start + i) * 31 + id) & 0xff)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+function fail(what) {
+    throw new Error(`sabfs bench: ${what}`);
+}
+
+export class BenchRecorder {
+    constructor(runner, opts) {
+        this.result = {
+            runner: runner,
+            options: opts,
+            results: {},
+        };
+    }
+
+    // Time fn(), which returns the number of operations and bytes it did
+    run(name, fn) {
+        const start = performance.now();
+        const { ops, bytes = 0 } = fn();
+        this.add(name, performance.now() - start, ops, bytes);
+    }
+
+    add(name, ms, ops, bytes = 0) {
+        const r = { ms: ms, ops: ops, us_per_op: ms * 1000 / ops };
+        if (bytes) {
+            r.bytes = bytes;
+            r.mb_s = bytes / MiB / (ms / 1000);
+        }
+        this.result.results[name] = r;
+    }
+
+    finish() {
+        return this.result;
+    }
+}
+
+// Sequential and random pread/pwrite of one file at each of opts.sizes
+export function runIO(SABFS, rec, opts) {
+    const path = '/bench/io.bin';
+
+    for (const size of opts.sizes) {
+        const buf = new Uint8Array(size);
+        const count = Math.floor(opts.fileSize / size);
+        pattern(buf, 0, 0);
+
+        const fd = SABFS.open(path, SABFS.O_CREAT | SABFS.O_TRUNC | SABFS.O_RDWR, 0o644);
+        if (fd < 0) fail(`open ${path}`);
+        rec.run(`seq-write-${size}`, () => {
+            for (let i = 0; i < count; i++) {
+                if (SABFS.pwrite(fd, buf, size, i * size) !== size) fail('pwrite');
+            }
+            return { ops: count, bytes: count * size };
+        });
+        rec.run(`seq-read-${size}`, () => {
+            for (let i = 0; i < count; i++) {
+                if (SABFS.pread(fd, buf, size, i * size) !== size) fail('pread');
+            }
+            return { ops: count, bytes: count * size };
+        });
+
+        const n = Math.min(opts.randomOps, count);
+        let rand = prng(size);
+        rec.run(`rand-read-${size}`, () => {
+            for (let i = 0; i < n; i++) {
+                const off = Math.floor(rand() * count) * size;
+                if (SABFS.pread(fd, buf, size, off) !== size) fail('pread');
+            }
+            return { ops: n, bytes: n * size };
+        });
+        rand = prng(size + 1);
+        rec.run(`rand-write-${size}`, () => {
+            for (let i = 0; i < n; i++) {
+                const off = Math.floor(rand() * count) * size;
+                if (SABFS.pwrite(fd, buf, size, off) !== size) fail('pwrite');
+            }
+            return { ops: n, bytes: n * size };
+        });
+        SABFS.close(fd);
+    }
+}
+
+// Many files in one directory, then a deep path
+export function runMetadata(SABFS, rec, opts) {
+    const dir = '/bench/many';
+    if (SABFS.mkdir(dir) !== 0) fail(`mkdir ${dir}`);
+
+    rec.run('create', () => {
+        for (let i = 0; i < opts.files; i++) {
+            const fd = SABFS.open(`${dir}/f${i}`, SABFS.O_CREAT | SABFS.O_WRONLY, 0o644);
+            if (fd < 0) fail(`create ${dir}/f${i}`);
+            SABFS.close(fd);
+        }
+        return { ops: opts.files };
+    });
+    // path lookups of other threads start without the path cache
+    SABFS.clearCache();
+    rec.run('stat', () => {
+        for (let i = 0; i < opts.files; i++) {
+            if (!SABFS.stat(`${dir}/f${i}`)) fail(`stat ${dir}/f${i}`);
+        }
+        return { ops: opts.files };
+    });
+    rec.run('readdir', () => {
+        const entries = SABFS.readdir(dir);
+        if (!entries || entries.length < opts.files) fail(`readdir ${dir}`);
+        return { ops: entries.length };
+    });
+
+    let path = '/bench/deep';
+    if (SABFS.mkdir(path) !== 0) fail(`mkdir ${path}`);
+    rec.run('mkdir-deep', () => {
+        for (let i = 0; i < opts.depth; i++) {
+            path += `/d${i}`;
+            if (SABFS.mkdir(path) !== 0) fail(`mkdir ${path}`);
+        }
+        return { ops: opts.depth };
+    });
+    const leaf = `${path}/leaf`;
+    if (!SABFS.importFile(leaf, new Uint8Array(1))) fail(`create ${leaf}`);
+    rec.run('stat-deep', () => {
+        for (let i = 0; i < opts.stats; i++) {
+            if (!SABFS.stat(leaf)) fail(`stat ${leaf}`);
+        }
+        return { ops: opts.stats };
+    });
+    rec.run('stat-deep-uncached', () => {
+        for (let i = 0; i < opts.stats; i++) {
+            SABFS.clearCache();
+            if (!SABFS.stat(leaf)) fail(`stat ${leaf}`);
+        }
+        return { ops: opts.stats };
+    });
+}
+
+// The file writer id writes, its own or its range of a shared one
+export function writerPath(job) {
+    return job.shared ? '/bench/shared.bin' : `/bench/writer${job.id}.bin`;
+}
+
+// Run in each writer worker once SABFS is attached
+export function writerJob(SABFS, job) {
+    const buf = new Uint8Array(job.chunk);
+    const base = job.shared ? job.id * job.size : 0;
+    const fd = SABFS.open(writerPath(job), SABFS.O_CREAT | SABFS.O_WRONLY, 0o644);
+    if (fd < 0) fail(`open ${writerPath(job)}`);
+
+    const start = performance.now();
+    for (let off = 0; off < job.size; off += job.chunk) {
+        pattern(buf, off, job.id);
+        if (SABFS.pwrite(fd, buf, job.chunk, base + off) !== job.chunk) fail('pwrite');
+    }
+    const ms = performance.now() - start;
+    SABFS.close(fd);
+    return ms;
+}
+
+// Read back what the writers wrote
+export function checkWriters(SABFS, jobs) {
+    for (const job of jobs) {
+        const buf = new Uint8Array(job.chunk);
+        const base = job.shared ? job.id * job.size : 0;
+        const fd = SABFS.open(writerPath(job), SABFS.O_RDONLY);
+        if (fd < 0) fail(`open ${writerPath(job)}`);
+        for (let off = 0; off < job.size; off += job.chunk) {
+            if (SABFS.pread(fd, buf, job.chunk, base + off) !== job.chunk ||
+                !checkPattern(buf, off, job.id)) {
+                fail(`data of writer ${job.id} at ${off} in ${writerPath(job)}`);
+            }
+        }
+        SABFS.close(fd);
+    }
+}
+
+export function writerJobs(opts, shared) {
+    const jobs = [];
+    for (let id = 0; id < opts.writers; id++) {
+        jobs.push({ id: id, shared: shared, size: opts.writerSize, chunk: opts.writerChunk });
+    }
+    return jobs;
+}
+
+// Runs the writers of jobs at once. spawn(job) starts a worker and returns
+// { ready, start, done }: promises of its startup and of its time writing,
+// and the function letting it write.
+export async function runWriters(SABFS, rec, name, jobs, spawn) {
+    const workers = jobs.map(spawn);
+    await Promise.all(workers.map((w) => w.ready));
+    const start = performance.now();
+    workers.forEach((w) => w.start());
+    const times = await Promise.all(workers.map((w) => w.done));
+    const ms = performance.now() - start;
+    const bytes = jobs.reduce((n, job) => n + job.size, 0);
+    rec.add(name, ms, jobs.reduce((n, job) => n + job.size / job.chunk, 0), bytes);
+    rec.result.results[name].writer_ms = times;
+    checkWriters(SABFS, jobs);
+}
+
+// Everything, in order; SABFS must have been initialized with opts
+export async function runSuite(SABFS, rec, opts, spawn) {
+    if (SABFS.mkdir('/bench') !== 0) fail('mkdir /bench');
+    runIO(SABFS, rec, opts);
+    runMetadata(SABFS, rec, opts);
+    await runWriters(SABFS, rec, 'writers-files', writerJobs(opts, false), spawn);
+    await runWriters(SABFS, rec, 'writers-shared', writerJobs(opts, true), spawn);
+    return rec.finish();
+}
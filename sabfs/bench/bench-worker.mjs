@@ -0,0 +1,40 @@
+// A writer of the concurrent write benchmarks, as a module worker of the
+// page or a worker_threads worker of run-node.mjs. It attaches to the
+// filesystem, says it's ready, and writes its job once told to start.
+
+import { writerJob } from './bench-core.mjs';
+
+let SABFS, post, listen;
+if (typeof process !== 'undefined' && process.versions?.node) {
+    const { parentPort, workerData } = await import('node:worker_threads');
+    const { createRequire } = await import('node:module');
+    SABFS = createRequire(import.meta.url)('../sabfs.js');
+    post = (msg) => parentPort.postMessage(msg);
+    listen = (fn) => parentPort.on('message', fn);
+    serve(workerData);
+} else {
+    await import('../sabfs.js');
+    SABFS = globalThis.SABFS;
+    post = (msg) => self.postMessage(msg);
+    listen = (fn) => { self.onmessage = (e) => fn(e.data); };
+    listen((msg) => {
+        if (msg.cmd === 'job') {
+            serve(msg);
+        }
+    });
+}
+
+function serve({ sab, job }) {
+    SABFS.attach(sab);
+    listen((msg) => {
+        if (msg !== 'start') {
+            return;
+        }
+        try {
+            post({ ms: writerJob(SABFS, job) });
+        } catch (e) {
+            post({ error: e.message });
+        }
+    });
+    post('ready');
+}
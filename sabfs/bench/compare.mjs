@@ -0,0 +1,36 @@
+// Compare two result files written by run-node.mjs or run-browser.mjs, or
+// two snapshots of sabfs_9p_stats_json() taken after the same guest work.
+//
+//   node compare.mjs base.json new.json
+
+import fs from 'node:fs';
+
+if (process.argv.length != 4) {
+    console.error('usage: compare.mjs base.json new.json');
+    process.exit(2);
+}
+const [base, cur] = process.argv.slice(2).map((f) => JSON.parse(fs.readFileSync(f)));
+
+const row = (name, a, b) => {
+    const delta = a ? ((b - a) / a * 100).toFixed(1) + '%' : '-';
+    console.log(`${name.padEnd(20)} ${a.toFixed(2).padStart(12)} ${b.toFixed(2).padStart(12)} ${delta.padStart(8)}`);
+};
+
+if (base.results && cur.results) {
+    console.log(`${'us per op'.padEnd(20)} ${'base'.padStart(12)} ${'new'.padStart(12)} ${'delta'.padStart(8)}`);
+    for (const name of Object.keys(base.results)) {
+        if (name in cur.results) {
+            row(name, base.results[name].us_per_op, cur.results[name].us_per_op);
+        }
+    }
+}
+if (base.ops && cur.ops) {
+    // 9p backend operations, only those both runs made
+    const usPerCall = (op) => op.ns / op.calls / 1000;
+    console.log(`${'9p us per call'.padEnd(20)} ${'base'.padStart(12)} ${'new'.padStart(12)} ${'delta'.padStart(8)}`);
+    for (const name of Object.keys(base.ops)) {
+        if (base.ops[name].calls && cur.ops[name]?.calls) {
+            row(name, usPerCall(base.ops[name]), usPerCall(cur.ops[name]));
+        }
+    }
+}
@@ -0,0 +1,54 @@
+// Run the SABFS benchmark page in a headless browser through Playwright.
+//
+//   node run-browser.mjs [--browser chromium|firefox] \
+//       [--url http://localhost:8002/bench/bench.html] [--files 100000] \
+//       [--writers 4] [--timeout 1800] [--out result.json]
+
+import fs from 'node:fs';
+import { parseArgs } from 'node:util';
+import { chromium, firefox } from 'playwright';
+
+const { values: opts } = parseArgs({
+    options: {
+        browser: { type: 'string', default: 'chromium' },
+        url: { type: 'string', default: 'http://localhost:8002/bench/bench.html' },
+        files: { type: 'string' },
+        writers: { type: 'string' },
+        timeout: { type: 'string', default: '1800' },
+        out: { type: 'string' },
+    },
+});
+
+const engines = { chromium, firefox };
+if (!(opts.browser in engines)) {
+    console.error(`unknown browser: ${opts.browser}`);
+    process.exit(2);
+}
+
+const browser = await engines[opts.browser].launch({ headless: true });
+const page = await browser.newPage();
+page.on('console', (msg) => console.error(`[${opts.browser}] ${msg.text()}`));
+
+const url = new URL(opts.url);
+for (const k of ['files', 'writers']) {
+    if (opts[k]) {
+        url.searchParams.set(k, opts[k]);
+    }
+}
+await page.goto(url.href);
+await page.waitForFunction(() => window.benchResult !== undefined, null,
+                           { timeout: parseInt(opts.timeout) * 1000, polling: 1000 });
+const result = await page.evaluate(() => window.benchResult);
+result.runner = `${opts.browser} ${browser.version()}`;
+await browser.close();
+if (result.error) {
+    console.error(result.error);
+    process.exit(1);
+}
+
+const json = JSON.stringify(result, null, 2);
+if (opts.out) {
+    fs.writeFileSync(opts.out, json + '\n');
+} else {
+    console.log(json);
+}
@@ -0,0 +1,56 @@
+// Run the SABFS benchmark under Node, the writers in worker_threads.
+//
+//   node run-node.mjs [--files 100000] [--writers 4] [--out result.json]
+
+import fs from 'node:fs';
+import { createRequire } from 'node:module';
+import { parseArgs } from 'node:util';
+import { Worker } from 'node:worker_threads';
+import { DEFAULTS, BenchRecorder, runSuite } from './bench-core.mjs';
+
+const { values: args } = parseArgs({
+    options: {
+        files: { type: 'string' },
+        writers: { type: 'string' },
+        out: { type: 'string' },
+    },
+});
+const opts = { ...DEFAULTS };
+if (args.files) opts.files = parseInt(args.files);
+if (args.writers) opts.writers = parseInt(args.writers);
+
+const SABFS = createRequire(import.meta.url)('../sabfs.js');
+const sab = SABFS.init(opts.size, { inodeCount: opts.inodes });
+
+function spawn(job) {
+    const worker = new Worker(new URL('./bench-worker.mjs', import.meta.url),
+                              { workerData: { sab: sab, job: job } });
+    let ready, done;
+    const w = {
+        ready: new Promise((resolve) => { ready = resolve; }),
+        done: new Promise((resolve, reject) => { done = { resolve, reject }; }),
+        start: () => worker.postMessage('start'),
+    };
+    worker.on('message', (msg) => {
+        if (msg === 'ready') {
+            ready();
+        } else if (msg.error) {
+            done.reject(new Error(msg.error));
+        } else if ('ms' in msg) {
+            done.resolve(msg.ms);
+            worker.terminate();
+        }
+    });
+    worker.on('error', (e) => done.reject(e));
+    return w;
+}
+
+const rec = new BenchRecorder(`node ${process.version}`, opts);
+const result = await runSuite(SABFS, rec, opts, spawn);
+
+const json = JSON.stringify(result, null, 2);
+if (args.out) {
+    fs.writeFileSync(args.out, json + '\n');
+} else {
+    console.log(json);
+}
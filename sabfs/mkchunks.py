@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Split images into content-addressed chunks for SABFS.mountLazy().
+
+Each chunk is stored gzip-compressed in the store directory under the
+SHA-256 of its data, so chunks repeated within an image or across image
+versions are stored and downloaded once. Chunks of zeroes are not stored.
+The manifest entries are printed as JSON, or merged into --manifest:
+
+    mkchunks.py --store chunks --manifest manifest.json \\
+        rootfs.bin=/pack/rootfs.bin
+"""
+
+import argparse
+import gzip
+import hashlib
+import json
+import os
+
+BLOCK_SIZE = 4096
+
+
+def chunk_image(image, path, store, chunk_size, url_prefix):
+    chunks = []
+    zero = bytes(chunk_size)
+    size = os.path.getsize(image)
+
+    with open(image, 'rb') as f:
+        while True:
+            data = f.read(chunk_size)
+            if not data:
+                break
+            if data == zero[:len(data)]:
+                chunks.append(None)
+                continue
+            name = hashlib.sha256(data).hexdigest()
+            out = os.path.join(store, name)
+            if not os.path.exists(out):
+                with open(out + '.tmp', 'wb') as o:
+                    o.write(gzip.compress(data, mtime=0))
+                os.replace(out + '.tmp', out)
+            chunks.append(name)
+
+    return {
+        'path': path,
+        'size': size,
+        'store': url_prefix,
+        'chunkSize': chunk_size,
+        'compression': 'gzip',
+        'chunks': chunks,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('images', nargs='+', metavar='IMAGE=PATH',
+                        help='image file and its path in SABFS')
+    parser.add_argument('--store', required=True,
+                        help='directory of the chunks, shared by all images')
+    parser.add_argument('--url-prefix',
+                        help='URL of the store as seen from the page '
+                             '(default: the store directory followed by /)')
+    parser.add_argument('--chunk-size', type=int, default=64 * 1024,
+                        help='bytes per chunk, a multiple of 4096 '
+                             '(default: 65536)')
+    parser.add_argument('--manifest',
+                        help='manifest to add the entries to, replacing '
+                             'entries of the same path')
+    args = parser.parse_args()
+
+    if args.chunk_size <= 0 or args.chunk_size % BLOCK_SIZE:
+        parser.error('--chunk-size must be a multiple of 4096')
+    url_prefix = args.url_prefix or args.store.rstrip('/') + '/'
+    os.makedirs(args.store, exist_ok=True)
+
+    entries = []
+    for spec in args.images:
+        image, sep, path = spec.partition('=')
+        if not sep:
+            parser.error(f'{spec}: expected IMAGE=PATH')
+        entries.append(chunk_image(image, path, args.store, args.chunk_size,
+                                   url_prefix))
+
+    if not args.manifest:
+        print(json.dumps({'files': entries}, indent=1))
+        return
+
+    manifest = {'files': []}
+    if os.path.exists(args.manifest):
+        with open(args.manifest) as f:
+            manifest = json.load(f)
+    paths = {e['path'] for e in entries}
+    manifest['files'] = [e for e in manifest['files']
+                         if e['path'] not in paths] + entries
+    with open(args.manifest, 'w') as f:
+        json.dump(manifest, f, indent=1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,56 @@
+/**
+ * SABFS Import Worker - streams tar archives into SABFS
+ *
+ * Fetching, decompressing and unpacking a large image layer on the main
+ * thread would jank the page, so SABFS.importTar() runs here on the
+ * shared buffer. Started by SABFSLoader.importTar().
+ *
+ * Messages:
+ *   in:  { cmd: 'SABFS_IMPORT', id, buffer, base, size, dest, compression,
+ *          url or stream }
+ *   out: { cmd: 'SABFS_IMPORT_PROGRESS', id, stats },
+ *        { cmd: 'SABFS_IMPORT_DONE', id, stats } or
+ *        { cmd: 'SABFS_IMPORT_ERROR', id, error }
+ */
+
+importScripts('sabfs.js');
+
+const PROGRESS_INTERVAL = 100; // ms between progress messages
+
+let attached = false;
+
+self.addEventListener('message', async function(e) {
+    if (!e.data || e.data.cmd !== 'SABFS_IMPORT') {
+        return;
+    }
+
+    const id = e.data.id;
+    let last = 0;
+    try {
+        if (!attached) {
+            SABFS.attach(e.data.buffer, e.data.base, e.data.size);
+            attached = true;
+        }
+        let source = e.data.stream;
+        if (!source) {
+            const resp = await fetch(e.data.url);
+            if (!resp.ok) {
+                throw new Error(`HTTP ${resp.status} for ${e.data.url}`);
+            }
+            source = resp.body;
+        }
+        const stats = await SABFS.importTar(source, e.data.dest, {
+            compression: e.data.compression,
+            onProgress(stats) {
+                const now = performance.now();
+                if (now - last >= PROGRESS_INTERVAL) {
+                    last = now;
+                    self.postMessage({ cmd: 'SABFS_IMPORT_PROGRESS', id, stats });
+                }
+            },
+        });
+        self.postMessage({ cmd: 'SABFS_IMPORT_DONE', id, stats });
+    } catch (err) {
+        self.postMessage({ cmd: 'SABFS_IMPORT_ERROR', id, error: String(err) });
+    }
+});
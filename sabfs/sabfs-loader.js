@@ -19,12 +19,24 @@ const SABFSLoader = (function() {
 
     let initialized = false;
     let sabBuffer = null;
+    let importWorker = null;
+    let importId = 0;
 
     /**
      * Initialize SABFS and create directory structure
      * @param {Object} options
      * @param {number} options.size - Filesystem size in bytes (default 256MB)
      * @param {string} options.rootPath - Path prefix for Docker data (default /docker)
+     * @param {Object} options.module - Emscripten module of QEMU. The filesystem
+     *     is then created in its memory with sabfs_init() so that QEMU can
+     *     access it without calling into JS.
+     * @param {string} options.persist - Name of an OPFS image to keep the
+     *     filesystem in across page loads, restored before anything else
+     * @param {string} options.persistWorker - URL of sabfs-persist-worker.js
+     * @param {number} options.persistInterval - Milliseconds between flushes
+     * @param {string} options.offloadPrefixes - Guest paths whose syscalls
+     *     QEMU serves from SABFS, as guest=sabfs pairs separated by commas
+     *     (default "/mnt/wasi1/=/pack/"). Needs options.module.
      * @returns {Promise<SharedArrayBuffer>}
      */
     async function init(options = {}) {
@@ -39,7 +51,24 @@ const SABFSLoader = (function() {
         console.log(`SABFSLoader: Initializing ${(size / 1024 / 1024).toFixed(0)}MB filesystem...`);
 
         // Initialize SABFS
-        sabBuffer = SABFS.init(size);
+        const mod = options.module;
+        if (mod) {
+            if (mod._sabfs_init(size) < 0) {
+                throw new Error('SABFSLoader: sabfs_init failed');
+            }
+            sabBuffer = mod.HEAPU8.buffer;
+            // unsigned, the region may be above 2 GiB
+            SABFS.attach(sabBuffer, mod._sabfs_region_base() >>> 0, mod._sabfs_region_size() >>> 0);
+            if (options.offloadPrefixes !== undefined) {
+                setOffloadPrefixes(mod, options.offloadPrefixes);
+            }
+        } else {
+            sabBuffer = SABFS.init(size);
+        }
+
+        if (options.persist) {
+            await startPersistence(options);
+        }
 
         // Create Docker directory structure
         const dirs = [
@@ -73,6 +102,54 @@ const SABFSLoader = (function() {
         return sabBuffer;
     }
 
+    /**
+     * Configure the paths of which QEMU serves file syscalls from SABFS
+     * @param {Object} mod - Emscripten module of QEMU
+     * @param {string} spec - guest=sabfs pairs separated by commas
+     */
+    function setOffloadPrefixes(mod, spec) {
+        const bytes = new TextEncoder().encode(spec + '\0');
+        const buf = mod._syscall_offload_spec_buffer();
+
+        if (bytes.length > 8 * 2 * 512) {
+            throw new Error('SABFSLoader: offloadPrefixes is too long');
+        }
+        mod.HEAPU8.set(bytes, buf);
+        if (mod._syscall_offload_set_prefixes(buf) < 0) {
+            throw new Error(`SABFSLoader: Invalid offloadPrefixes "${spec}"`);
+        }
+    }
+
+    /**
+     * Start the worker that keeps SABFS in OPFS and wait for it to restore
+     * the saved image
+     * @param {Object} options - Options of init()
+     * @returns {Promise<boolean>} true if a saved image was restored
+     */
+    function startPersistence(options) {
+        const worker = new Worker(options.persistWorker || 'sabfs-persist-worker.js');
+
+        return new Promise((resolve, reject) => {
+            worker.addEventListener('message', function(e) {
+                if (e.data.cmd === 'SABFS_PERSIST_READY') {
+                    console.log(`SABFSLoader: ${e.data.restored ? 'Restored' : 'Created'} OPFS image ${options.persist}`);
+                    SABFS.clearCache();
+                    resolve(e.data.restored);
+                } else if (e.data.cmd === 'SABFS_PERSIST_ERROR') {
+                    reject(new Error(`SABFSLoader: Persistence failed: ${e.data.error}`));
+                }
+            });
+            worker.postMessage({
+                cmd: 'SABFS_PERSIST',
+                buffer: sabBuffer,
+                base: SABFS.getBase(),
+                size: new DataView(sabBuffer, SABFS.getBase()).getUint32(12, true) * 4096,
+                name: options.persist,
+                interval: options.persistInterval,
+            });
+        });
+    }
+
     /**
      * Import files from Emscripten's MEMFS into SABFS
      * @param {string} memfsPath - Path in MEMFS (e.g., /pack)
@@ -170,6 +247,68 @@ const SABFSLoader = (function() {
         return SABFS.importFile(path, bytes);
     }
 
+    /**
+     * Unpack a tar archive, such as an OCI image layer, into SABFS while it
+     * downloads. Fetching, decompressing and writing happen in
+     * sabfs-import-worker.js, so the page stays responsive and the archive
+     * is never held in memory as a whole. See SABFS.importTar().
+     * @param {string|Response|ReadableStream} source - URL of the archive,
+     *     or its response or byte stream
+     * @param {string} dest - Directory to unpack into
+     * @param {Object} options
+     * @param {string} options.compression - 'gzip', 'zstd', 'none', or
+     *     detected from the data if left out
+     * @param {Function} options.onProgress - Called with the import stats
+     * @param {string} options.importWorker - URL of sabfs-import-worker.js
+     * @returns {Promise<Object>} Stats of the import
+     */
+    function importTar(source, dest, options = {}) {
+        if (!initialized) {
+            throw new Error('SABFSLoader not initialized');
+        }
+
+        if (!importWorker) {
+            importWorker = new Worker(options.importWorker || 'sabfs-import-worker.js');
+        }
+        const id = ++importId;
+        const msg = {
+            cmd: 'SABFS_IMPORT',
+            id,
+            buffer: sabBuffer,
+            base: SABFS.getBase(),
+            size: new DataView(sabBuffer, SABFS.getBase()).getUint32(12, true) * 4096,
+            dest,
+            compression: options.compression,
+        };
+        const transfer = [];
+        if (typeof source === 'string') {
+            msg.url = new URL(source, location.href).href;
+        } else {
+            msg.stream = source.body || source;
+            transfer.push(msg.stream);
+        }
+
+        return new Promise((resolve, reject) => {
+            const onMessage = function(e) {
+                if (e.data.id !== id) return;
+                if (e.data.cmd === 'SABFS_IMPORT_PROGRESS') {
+                    if (options.onProgress) options.onProgress(e.data.stats);
+                    return;
+                }
+                importWorker.removeEventListener('message', onMessage);
+                if (e.data.cmd === 'SABFS_IMPORT_DONE') {
+                    // Other realms pick the new files up through the generation
+                    console.log(`SABFSLoader: Imported ${e.data.stats.files} files into ${dest}`);
+                    resolve(e.data.stats);
+                } else {
+                    reject(new Error(`SABFSLoader: Import into ${dest} failed: ${e.data.error}`));
+                }
+            };
+            importWorker.addEventListener('message', onMessage);
+            importWorker.postMessage(msg, transfer);
+        });
+    }
+
     /**
      * Pre-populate SABFS with container image layers
      * @param {Object} image - Image manifest
@@ -200,6 +339,30 @@ const SABFSLoader = (function() {
         }
     }
 
+    /**
+     * Mount the files listed in a manifest on demand, their blocks being
+     * fetched with HTTP range requests when first read
+     * @param {string|Object} manifest - Manifest or URL of a JSON manifest
+     * @returns {Promise<void>} Resolves once the files exist
+     */
+    async function mountManifest(manifest) {
+        if (!initialized) {
+            throw new Error('SABFSLoader not initialized');
+        }
+
+        if (typeof manifest === 'string') {
+            const resp = await fetch(manifest);
+            if (!resp.ok) {
+                throw new Error(`SABFSLoader: Failed to fetch manifest: ${resp.status}`);
+            }
+            manifest = await resp.json();
+        }
+
+        // The blocks are served in the background of this realm from now on
+        await SABFS.mountLazy(manifest);
+        console.log(`SABFSLoader: Mounted ${manifest.files.length} files on demand`);
+    }
+
     /**
      * Get filesystem statistics
      * @returns {Object}
@@ -211,16 +374,16 @@ const SABFSLoader = (function() {
 
         // Read from superblock
         const buffer = SABFS.getBuffer();
-        const view = new DataView(buffer);
+        const view = new DataView(buffer, SABFS.getBase());
 
         return {
             initialized: true,
-            totalSize: buffer.byteLength,
+            totalSize: view.getUint32(12, true) * view.getUint32(8, true),
             blockSize: view.getUint32(8, true),
             totalBlocks: view.getUint32(12, true),
             inodeCount: view.getUint32(16, true),
-            freeBlockPtr: view.getUint32(20, true),
             freeInodePtr: view.getUint32(24, true),
+            allocGroups: view.getUint32(56, true),
         };
     }
 
@@ -245,6 +408,8 @@ const SABFSLoader = (function() {
         importFromMEMFS,
         importFile,
         importImage,
+        importTar,
+        mountManifest,
         getStats,
         getBuffer,
         isInitialized,
@@ -0,0 +1,29 @@
+/**
+ * SABFS Persist Worker - keeps SABFS in the Origin Private File System
+ *
+ * FileSystemSyncAccessHandle is only available in dedicated workers, so
+ * SABFS.persist() runs here. The worker restores a saved image, serves the
+ * file data that is read in on demand and writes changed blocks back.
+ * Started by SABFSLoader.init() with the persist option.
+ *
+ * Messages:
+ *   in:  { cmd: 'SABFS_PERSIST', buffer, base, size, name, interval }
+ *   out: { cmd: 'SABFS_PERSIST_READY', restored } or
+ *        { cmd: 'SABFS_PERSIST_ERROR', error }
+ */
+
+importScripts('sabfs.js');
+
+self.addEventListener('message', async function(e) {
+    if (!e.data || e.data.cmd !== 'SABFS_PERSIST') {
+        return;
+    }
+
+    try {
+        SABFS.attach(e.data.buffer, e.data.base, e.data.size);
+        const restored = await SABFS.persist(e.data.name, { interval: e.data.interval });
+        self.postMessage({ cmd: 'SABFS_PERSIST_READY', restored });
+    } catch (err) {
+        self.postMessage({ cmd: 'SABFS_PERSIST_ERROR', error: String(err) });
+    }
+});
@@ -19,11 +19,33 @@
  *   8-11:  block_size
  *   12-15: total_blocks
  *   16-19: inode_count
- *   20-23: free_block_ptr (next free block)
- *   24-27: free_inode_ptr (next free inode)
+ *   20-23: unused (was the free block list, see group_free)
+ *   24-27: free_inode_ptr (where the next inode search starts)
  *   28-31: root_inode
+ *   32-35: index_block (first block of the dentry index, 0 if none)
+ *   36-39: index_slots (power of two)
+ *   40-43: generation (bumped on every namespace change)
+ *   44-47: fd_table (first block of the fd table)
+ *   48-51: fd_slots (number of fds, and of open files)
+ *   52-55: file_table (first block of the open file table)
+ *   56-59: group_count (allocation groups)
+ *   60-63: group_blocks (data blocks per allocation group)
+ *   64-67: group_next (picks the home group of the next worker or thread)
+ *   68-71: inode_bitmap (first block of the inode bitmap, 1 = in use)
+ *   72-75: block_state (first block of the block state words)
+ *   76-79: fetch_ring (block of the fetch request ring)
+ *   80-83: dirty_map (first block of the dirty bitmap, 1 = changed)
+ *   84-87: block_refs (first block of the block reference counts)
+ *   88-91: sync_request (bumped by sabfs_sync() to ask for a flush)
+ *   92-95: sync_done (last sync_request flushed to OPFS)
+ *   96-99: persisting (1 while persist() writes the filesystem back)
+ *   128-383: group_free[64] (free block list head of each group)
  *
- * Inode (64 bytes):
+ * The data blocks are split into allocation groups with a free list each.
+ * Every worker and QEMU thread allocates from a home group of its own, so
+ * concurrent writers don't contend on one list head.
+ *
+ * Inode (256 bytes):
  *   0-3:   mode (file type + permissions)
  *   4-7:   size (low 32 bits)
  *   8-11:  size (high 32 bits)
@@ -37,14 +59,66 @@
  *   40-43: direct[6]
  *   44-47: direct[7]
  *   48-51: indirect (single indirect block)
- *   52-55: flags
- *   56-63: reserved
+ *   52-55: generation (bumped after every change of the data)
+ *   56-59: double indirect block
+ *   60-63: triple indirect block
+ *   64-67: flags (1 = inline, the data is in the inode)
+ *   68-71: lock (readers, 0x80000000 = writer, 0x40000000 = waiters)
+ *   72-255: inline data
+ * Regular files of up to 184 bytes keep their data in the inode, so
+ * reading one touches no block, and move it to block 0 as they outgrow
+ * it. Inline bytes past the size are zero.
+ * The lock is taken shared by readers of the data or entries and
+ * exclusively by writers, so that workers and QEMU threads working on
+ * different files run in parallel. The size only changes with it held.
  *
  * Directory Entry (32 bytes):
  *   0-3:   inode
  *   4-5:   name_len
  *   6-7:   type
- *   8-31:  name (24 bytes, null-terminated)
+ *   8-31:  name (first 24 bytes, longer names run on into the following
+ *          entries of the same block)
+ * Entries are packed at the start of each block, the first free entry
+ * ends the scan of a block.
+ *
+ * Dentry Index (16 bytes per slot, hash table with linear probing):
+ *   0-3:   hash (FNV-1a of name and parent, 0 for a free slot)
+ *   4-7:   parent inode
+ *   8-11:  dirent (block * 128 + entry)
+ *   12-15: inode (set last, 0 while the slot is being filled in)
+ * It has twice as many slots as there are inodes, so it never fills.
+ *
+ * Fd Table (4 bytes per fd, fd = slot + 3):
+ *   0-3:   open file index + 1, 0 for a closed fd
+ *
+ * Open File (32 bytes, shared by dup()ed fds):
+ *   0-3:   refcnt (fds plus calls in progress, 0 for a free slot)
+ *   4-7:   inode
+ *   8-11:  flags
+ *   16-23: position
+ *
+ * The tables are shared with QEMU (sabfs_qemu.c), so an fd opened by any
+ * worker or QEMU thread works in all of them.
+ *
+ * Block State (4 bytes per data block):
+ *   0 = present, 1 = missing, 2 = requested from the fetching worker
+ * Files mounted with mountLazy() start out with missing blocks. A reader
+ * that finds one missing queues it on the fetch ring and waits on the
+ * state word until the worker has filled the block from HTTP.
+ *
+ * Fetch Ring (one block of u32):
+ *   0: head (requests queued), 1: tail (requests taken), 2-1023: blocks
+ *
+ * Block References (4 bytes per data block):
+ *   Number of owners beyond the first, for blocks shared by clone().
+ *   Writers copy a shared block before changing it, and freeing one only
+ *   drops a reference. A shared indirect block shares all below it.
+ *
+ * Dirty Bitmap (1 bit per data block):
+ *   Set by every change to a block, and cleared by persist() as it
+ *   writes the block back to OPFS. The superblock, inode table and the
+ *   tables before the bitmap are written back as a whole after any block
+ *   was, the unused block 0 is marked for changes to them.
  */
 
 const SABFS = (function() {
@@ -52,12 +126,34 @@ const SABFS = (function() {
 
     // Constants
     const MAGIC = 0x53414246; // "SABF"
-    const VERSION = 1;
+    const VERSION = 9;
     const BLOCK_SIZE = 4096;
-    const INODE_SIZE = 64;
+    const INODE_SIZE = 256;
+    const INODE_INLINE = 1; // inode flags
+    const LOCK_OFFSET = 68;
+    const LOCK_WRITER = 0x80000000 | 0;
+    const LOCK_WAITING = 0x40000000;
+    const INLINE_OFFSET = 72;
+    const INLINE_MAX = INODE_SIZE - INLINE_OFFSET;
     const DIRENT_SIZE = 32;
     const DIRENTS_PER_BLOCK = Math.floor(BLOCK_SIZE / DIRENT_SIZE);
     const DIRECT_BLOCKS = 8;
+    const NAME_MAX = 255;
+    const INDEX_ENTRY_SIZE = 16;
+    const FILE_SIZE = 32;
+    const MIN_FILES = 1024;
+    const FD_FIRST = 3; // 0,1,2 reserved for stdin/stdout/stderr
+    const MAX_GROUPS = 64;
+    const MIN_GROUP_BLOCKS = 1024;
+    const END_OF_LIST = 0xFFFFFFFF;
+    const BLOCK_PRESENT = 0;
+    const BLOCK_MISSING = 1;
+    const BLOCK_REQUESTED = 2;
+    const RING_SLOTS = (BLOCK_SIZE / 4) - 2;
+    const LAZY_READAHEAD = 64; // blocks fetched with one range request
+    const LAZY_MAX_READAHEAD = 1024; // reached by doubling for sequential reads
+    const LAZY_MAX_FETCHES = 6; // range requests in flight, like a browser per host
+    const CHUNK_CACHE = 'sabfs-chunks'; // Cache Storage of content-addressed chunks
     const PTRS_PER_BLOCK = Math.floor(BLOCK_SIZE / 4);
 
     // File types (matching Linux)
@@ -75,21 +171,56 @@ const SABFS = (function() {
     const SB_FREE_BLOCK = 20;
     const SB_FREE_INODE = 24;
     const SB_ROOT_INODE = 28;
+    const SB_INDEX_BLOCK = 32;
+    const SB_INDEX_SLOTS = 36;
+    const SB_GENERATION = 40;
+    const SB_FD_TABLE = 44;
+    const SB_FD_SLOTS = 48;
+    const SB_FILE_TABLE = 52;
+    const SB_GROUP_COUNT = 56;
+    const SB_GROUP_BLOCKS = 60;
+    const SB_GROUP_NEXT = 64;
+    const SB_INODE_BITMAP = 68;
+    const SB_BLOCK_STATE = 72;
+    const SB_FETCH_RING = 76;
+    const SB_DIRTY_MAP = 80;
+    const SB_BLOCK_REFS = 84;
+    const SB_SYNC_REQUEST = 88;
+    const SB_SYNC_DONE = 92;
+    const SB_PERSISTING = 96;
+    const SB_GROUP_FREE = 128;
 
     // Internal state
     let sab = null;
+    let base = 0;
     let view = null;
     let u8 = null;
     let u32 = null;
+    let i32 = null; // for Atomics.wait and Atomics.notify
+    let u64 = null;
     let inodeTableOffset = 0;
     let dataBlocksOffset = 0;
+    let homeGroup = -1;
+
+    // Where missing blocks come from, see mountLazy() and persist()
+    const lazySources = new Map(); // block number -> [entry, ino, file block]
+    const fetchQueue = []; // [entry, file block, blocks] waiting for a request
+    let fetchesInFlight = 0;
+    const chunkLoads = new Map(); // chunk URL -> Promise of its data
+    let persistHandle = null;
+    let flushedGeneration = -1;
+    let serving = false;
+
+    // Path cache for faster lookups, valid while the generation is unchanged
+    const pathCache = new Map();
+    let cacheGeneration = 0;
 
-    // File descriptor table
-    const fdTable = new Map();
-    let nextFd = 3; // 0,1,2 reserved for stdin/stdout/stderr
+    // Directory inode -> [its generation, first block that may have room].
+    // Entries are never removed, so blocks before that one stay full.
+    const dirFill = new Map();
 
-    // Path cache for faster lookups
-    const pathCache = new Map();
+    const encoder = new TextEncoder();
+    const decoder = new TextDecoder();
 
     /**
      * Initialize the filesystem with a SharedArrayBuffer
@@ -99,14 +230,30 @@ const SABFS = (function() {
      */
     function init(sizeBytes, options = {}) {
         const totalBlocks = Math.floor(sizeBytes / BLOCK_SIZE);
-        const inodeCount = options.inodeCount || Math.min(totalBlocks / 4, 65536);
+        const inodeCount = options.inodeCount || Math.min(Math.floor(totalBlocks / 4), 65536);
         const inodeTableBlocks = Math.ceil((inodeCount * INODE_SIZE) / BLOCK_SIZE);
+        let indexSlots = 1;
+        while (indexSlots < 2 * inodeCount) indexSlots *= 2;
+        const indexBlocks = Math.ceil((indexSlots * INDEX_ENTRY_SIZE) / BLOCK_SIZE);
+        const fdSlots = Math.max(inodeCount, MIN_FILES);
+        const fdBlocks = Math.ceil((fdSlots * 4) / BLOCK_SIZE);
+        const fileBlocks = Math.ceil((fdSlots * FILE_SIZE) / BLOCK_SIZE);
+        const bitmapWords = Math.ceil(inodeCount / 32);
+        const bitmapBlocks = Math.ceil((bitmapWords * 4) / BLOCK_SIZE);
+        const stateBlocks = Math.ceil((totalBlocks * 4) / BLOCK_SIZE);
+        const dirtyBlocks = Math.ceil((Math.ceil(totalBlocks / 32) * 4) / BLOCK_SIZE);
+        const bitmapBlock = 1 + indexBlocks + fdBlocks + fileBlocks;
+        const refsBlock = bitmapBlock + bitmapBlocks;
+        const stateBlock = refsBlock + stateBlocks;
+        const reservedBlocks = stateBlock + stateBlocks + 1 + dirtyBlocks;
 
         // Create SharedArrayBuffer
         sab = new SharedArrayBuffer(sizeBytes);
         view = new DataView(sab);
         u8 = new Uint8Array(sab);
         u32 = new Uint32Array(sab);
+        i32 = new Int32Array(sab);
+        u64 = new BigUint64Array(sab, 0, sizeBytes >>> 3);
 
         // Calculate offsets
         inodeTableOffset = BLOCK_SIZE; // After superblock
@@ -119,19 +266,49 @@ const SABFS = (function() {
         view.setUint32(SB_BLOCK_SIZE, BLOCK_SIZE, true);
         view.setUint32(SB_TOTAL_BLOCKS, totalBlocks, true);
         view.setUint32(SB_INODE_COUNT, inodeCount, true);
-        // Start free list at block 1 (reserve block 0 as "no block" sentinel)
-        view.setUint32(SB_FREE_BLOCK, 1, true);
+        // Block 0 is the "no block" sentinel, the dentry index, fd table,
+        // open file table, inode bitmap, block references, block states,
+        // fetch ring and dirty bitmap follow it
+        view.setUint32(SB_FREE_BLOCK, END_OF_LIST, true);
         view.setUint32(SB_FREE_INODE, 1, true); // Inode 0 is root, 1 is first free
         view.setUint32(SB_ROOT_INODE, 0, true);
+        view.setUint32(SB_INDEX_BLOCK, 1, true);
+        view.setUint32(SB_INDEX_SLOTS, indexSlots, true);
+        view.setUint32(SB_GENERATION, 0, true);
+        view.setUint32(SB_FD_TABLE, 1 + indexBlocks, true);
+        view.setUint32(SB_FD_SLOTS, fdSlots, true);
+        view.setUint32(SB_FILE_TABLE, 1 + indexBlocks + fdBlocks, true);
+        view.setUint32(SB_INODE_BITMAP, bitmapBlock, true);
+        view.setUint32(SB_BLOCK_REFS, refsBlock, true);
+        view.setUint32(SB_BLOCK_STATE, stateBlock, true);
+        view.setUint32(SB_FETCH_RING, stateBlock + stateBlocks, true);
+        view.setUint32(SB_DIRTY_MAP, stateBlock + stateBlocks + 1, true);
+
+        // The new SAB is zeroed, so the index, fd tables and fetch ring start
+        // out empty and every block is present and unshared.
+        // Mark the root and the bits past the last inode as in use.
+        const bitmapOff = blockOffset(bitmapBlock);
+        view.setUint32(bitmapOff, 1, true);
+        if (inodeCount % 32) {
+            const lastOff = bitmapOff + ((bitmapWords - 1) * 4);
+            view.setUint32(lastOff, (view.getUint32(lastOff, true) | (~0 << (inodeCount % 32))) >>> 0, true);
+        }
 
-        // Initialize free block list (each block points to next)
-        // Skip block 0 (reserved as sentinel), start from block 1
-        for (let i = 1; i < dataBlocks - 1; i++) {
-            const blockOffset = dataBlocksOffset + (i * BLOCK_SIZE);
-            view.setUint32(blockOffset, i + 1, true);
+        // Initialize the free block list of each group (each block points to next)
+        const groupCount = Math.min(MAX_GROUPS, Math.max(Math.floor(dataBlocks / MIN_GROUP_BLOCKS), 1));
+        const groupBlocks = Math.ceil(dataBlocks / groupCount);
+        view.setUint32(SB_GROUP_COUNT, groupCount, true);
+        view.setUint32(SB_GROUP_BLOCKS, groupBlocks, true);
+        view.setUint32(SB_GROUP_NEXT, 0, true);
+        for (let g = 0; g < groupCount; g++) {
+            const start = Math.max(g * groupBlocks, reservedBlocks);
+            const end = Math.min((g + 1) * groupBlocks, dataBlocks);
+
+            view.setUint32(SB_GROUP_FREE + (g * 4), start < end ? start : END_OF_LIST, true);
+            for (let i = start; i < end; i++) {
+                view.setUint32(blockOffset(i), i + 1 < end ? i + 1 : END_OF_LIST, true);
+            }
         }
-        // Last block points to -1 (end of list)
-        view.setUint32(dataBlocksOffset + ((dataBlocks - 1) * BLOCK_SIZE), 0xFFFFFFFF, true);
 
         // Initialize root directory (inode 0)
         const rootInodeOffset = inodeTableOffset;
@@ -147,19 +324,31 @@ const SABFS = (function() {
 
     /**
      * Attach to an existing SharedArrayBuffer
+     * QEMU keeps the filesystem in its own memory (sabfs_qemu.c), attach to
+     * it with the wasm memory buffer and the region from sabfs_region_base()
+     * and sabfs_region_size().
      * @param {SharedArrayBuffer} existingSab
+     * @param {number} regionBase - Byte offset of the filesystem in the buffer
+     * @param {number} regionSize - Size of the filesystem in bytes
      */
-    function attach(existingSab) {
+    function attach(existingSab, regionBase = 0, regionSize = existingSab.byteLength - regionBase) {
         sab = existingSab;
-        view = new DataView(sab);
-        u8 = new Uint8Array(sab);
-        u32 = new Uint32Array(sab);
+        base = regionBase;
+        view = new DataView(sab, base, regionSize);
+        u8 = new Uint8Array(sab, base, regionSize);
+        u32 = new Uint32Array(sab, base, regionSize >>> 2);
+        i32 = new Int32Array(sab, base, regionSize >>> 2);
+        u64 = new BigUint64Array(sab, base, regionSize >>> 3);
 
         // Verify magic
         const magic = view.getUint32(SB_MAGIC, true);
         if (magic !== MAGIC) {
             throw new Error(`Invalid SABFS magic: ${magic.toString(16)}`);
         }
+        const version = view.getUint32(SB_VERSION, true);
+        if (version < VERSION) {
+            throw new Error(`SABFS version ${version} is too old`);
+        }
 
         const inodeCount = view.getUint32(SB_INODE_COUNT, true);
         const inodeTableBlocks = Math.ceil((inodeCount * INODE_SIZE) / BLOCK_SIZE);
@@ -170,64 +359,317 @@ const SABFS = (function() {
     }
 
     /**
-     * Allocate a free block
-     * @returns {number} Block number or -1 if full
+     * Pop a block off the free list of an allocation group
+     * @param {number} group
+     * @returns {number} Block number or -1 if the group is full
      */
-    function allocBlock() {
-        const freeBlock = Atomics.load(u32, SB_FREE_BLOCK / 4);
-        if (freeBlock === 0xFFFFFFFF) return -1;
+    function popBlock(group) {
+        const head = (SB_GROUP_FREE / 4) + group;
+
+        while (true) {
+            const blockNum = Atomics.load(u32, head);
+            if (blockNum === END_OF_LIST) return -1;
 
-        const blockOffset = dataBlocksOffset + (freeBlock * BLOCK_SIZE);
-        const nextFree = view.getUint32(blockOffset, true);
+            const nextFree = view.getUint32(blockOffset(blockNum), true);
+            if (Atomics.compareExchange(u32, head, blockNum, nextFree) === blockNum) {
+                return blockNum;
+            }
+        }
+    }
 
-        // CAS to claim the block
-        const result = Atomics.compareExchange(u32, SB_FREE_BLOCK / 4, freeBlock, nextFree);
-        if (result !== freeBlock) {
-            // Contention, retry
-            return allocBlock();
+    /**
+     * Allocate a free block from the home group of this worker, moving on
+     * to the next groups when it is full
+     * @param {boolean} zero - Clear the block, unneeded if it is overwritten
+     * @returns {number} Block number or -1 if full
+     */
+    function allocBlock(zero = true) {
+        const groupCount = view.getUint32(SB_GROUP_COUNT, true);
+        if (homeGroup === -1) {
+            homeGroup = Atomics.add(u32, SB_GROUP_NEXT / 4, 1) % groupCount;
         }
 
-        // Zero the block
-        u8.fill(0, blockOffset, blockOffset + BLOCK_SIZE);
+        for (let i = 0; i < groupCount; i++) {
+            const group = (homeGroup + i) % groupCount;
+            const blockNum = popBlock(group);
+            if (blockNum === -1) continue;
+
+            homeGroup = group;
+            if (zero) {
+                const off = blockOffset(blockNum);
+                u8.fill(0, off, off + BLOCK_SIZE);
+            }
+            markDirty(blockNum);
+            return blockNum;
+        }
 
-        return freeBlock;
+        return -1;
     }
 
     /**
-     * Free a block
+     * Free a block back to its allocation group
      * @param {number} blockNum
      */
     function freeBlock(blockNum) {
-        const blockOffset = dataBlocksOffset + (blockNum * BLOCK_SIZE);
+        const group = Math.floor(blockNum / view.getUint32(SB_GROUP_BLOCKS, true));
+        const head = (SB_GROUP_FREE / 4) + group;
+
+        Atomics.store(u32, blockStateIndex(blockNum), BLOCK_PRESENT);
 
         while (true) {
-            const freeHead = Atomics.load(u32, SB_FREE_BLOCK / 4);
-            view.setUint32(blockOffset, freeHead, true);
+            const freeHead = Atomics.load(u32, head);
+            view.setUint32(blockOffset(blockNum), freeHead, true);
 
-            if (Atomics.compareExchange(u32, SB_FREE_BLOCK / 4, freeHead, blockNum) === freeHead) {
+            if (Atomics.compareExchange(u32, head, freeHead, blockNum) === freeHead) {
                 break;
             }
         }
+        markDirty(blockNum);
     }
 
     /**
-     * Allocate a free inode
-     * @returns {number} Inode number or -1 if full
+     * Record a change to a block, for persist() to write it back
+     * @param {number} blockNum
      */
-    function allocInode() {
-        const inodeCount = view.getUint32(SB_INODE_COUNT, true);
+    function markDirty(blockNum) {
+        const map = blockOffset(view.getUint32(SB_DIRTY_MAP, true)) / 4;
+        Atomics.or(u32, map + (blockNum >>> 5), 1 << (blockNum & 31));
+    }
 
-        while (true) {
-            const freeInode = Atomics.load(u32, SB_FREE_INODE / 4);
-            if (freeInode >= inodeCount) return -1;
+    /**
+     * Record a change at a byte offset, to a data block or the tables
+     * @param {number} off
+     */
+    function markDirtyAt(off) {
+        markDirty(off >= dataBlocksOffset ? Math.floor((off - dataBlocksOffset) / BLOCK_SIZE) : 0);
+    }
+
+    /**
+     * Index of the reference count of a block in u32
+     * @param {number} blockNum
+     * @returns {number}
+     */
+    function blockRefsIndex(blockNum) {
+        return (blockOffset(view.getUint32(SB_BLOCK_REFS, true)) / 4) + blockNum;
+    }
+
+    /**
+     * Drop a reference to a block and, with levels of indirection, to the
+     * blocks below it. The last owner frees them, from the end backwards
+     * so that rewriting the file pops them in their original order.
+     * @param {number} blockNum
+     * @param {number} levels - 0 for a data block
+     */
+    function putTree(blockNum, levels) {
+        const refs = blockRefsIndex(blockNum);
+        for (let r; (r = Atomics.load(u32, refs)) !== 0;) {
+            if (Atomics.compareExchange(u32, refs, r, r - 1) === r) return;
+        }
+
+        if (levels > 0) {
+            const table = blockOffset(blockNum) / 4;
+            for (let i = PTRS_PER_BLOCK - 1; i >= 0; i--) {
+                if (u32[table + i] !== 0) putTree(u32[table + i], levels - 1);
+            }
+        }
+        freeBlock(blockNum);
+    }
+
+    /**
+     * Give the writer its own copy of the block a slot points to, if it is
+     * shared. The pointers of a copied indirect block take a reference to
+     * what they point to before the original is put.
+     * @param {number} slot - Byte offset of the pointer
+     * @param {number} levels - 0 for a data block
+     * @returns {number} Block number to write to or -1 if full
+     */
+    function unshare(slot, levels) {
+        const blockNum = view.getUint32(slot, true);
+        if (Atomics.load(u32, blockRefsIndex(blockNum)) === 0) return blockNum;
+
+        const copy = allocBlock(false);
+        if (copy === -1) return -1;
+
+        ensureBlock(blockNum);
+        const off = blockOffset(blockNum);
+        u8.copyWithin(blockOffset(copy), off, off + BLOCK_SIZE);
+        if (levels > 0) {
+            const table = blockOffset(copy) / 4;
+            for (let i = 0; i < PTRS_PER_BLOCK; i++) {
+                if (u32[table + i] !== 0) Atomics.add(u32, blockRefsIndex(u32[table + i]), 1);
+            }
+        }
+        putTree(blockNum, levels);
+
+        view.setUint32(slot, copy, true);
+        markDirtyAt(slot);
+        return copy;
+    }
+
+    /**
+     * Free the blocks of a file, or drop its references to shared ones
+     * @param {number} ino
+     */
+    function truncateInode(ino) {
+        const inode = readInode(ino);
+
+        const trees = [inode.tindirect, inode.dindirect, inode.indirect];
+        for (let i = 0; i < trees.length; i++) {
+            if (trees[i] !== 0) putTree(trees[i], trees.length - i);
+        }
+        for (let i = DIRECT_BLOCKS - 1; i >= 0; i--) {
+            if (inode.direct[i] !== 0) putTree(inode.direct[i], 0);
+        }
+        writeInode(ino, {
+            size: 0, blocks: 0, direct: [], indirect: 0, dindirect: 0, tindirect: 0,
+            flags: inode.flags & ~INODE_INLINE,
+        });
+        inodeChanged(ino);
+    }
+
+    /**
+     * Move the data of an inline file to block 0 before it grows past
+     * INLINE_MAX. The data stays in the inode for readers that saw the
+     * flag still set.
+     * @param {number} ino
+     * @returns {boolean} false if the filesystem is full
+     */
+    function spillInline(ino) {
+        const inode = readInode(ino);
+        const blockNum = allocBlockForFile(ino, 0);
+        if (blockNum === -1) return false;
+
+        const off = inodeOffset(ino) + INLINE_OFFSET;
+        u8.copyWithin(blockOffset(blockNum), off, off + inode.size);
+        Atomics.and(u32, (inodeOffset(ino) + 64) / 4, ~INODE_INLINE);
+        markDirtyAt(off);
+        return true;
+    }
+
+    /**
+     * Bump the generation of an inode after its data, size or blocks
+     * changed, or it was freed, so that QEMU's read cache (sabfs_cache.c)
+     * drops its block map of the old version
+     * @param {number} ino
+     */
+    function inodeChanged(ino) {
+        Atomics.add(u32, (inodeOffset(ino) + 52) / 4, 1);
+    }
+
+    /**
+     * Wait for the lock word at idx to change from v, after telling the
+     * holder there is a waiter. The browser main thread can't block, so
+     * it spins.
+     * @param {number} idx - Index of the lock in i32
+     * @param {number} v
+     */
+    function lockWait(idx, v) {
+        if (!(v & LOCK_WAITING) &&
+            Atomics.compareExchange(i32, idx, v, v | LOCK_WAITING) !== v) return;
+        if (typeof window === 'undefined') {
+            Atomics.wait(i32, idx, v | LOCK_WAITING);
+        }
+    }
+
+    /**
+     * Lock an inode for reading, shared with other readers. The same lock
+     * as sabfs_rdlock() in sabfs_qemu.c.
+     * @param {number} ino
+     */
+    function rdlock(ino) {
+        const idx = (inodeOffset(ino) + LOCK_OFFSET) / 4;
+        for (;;) {
+            const v = Atomics.load(i32, idx);
+            if (v & LOCK_WRITER) {
+                lockWait(idx, v);
+            } else if (Atomics.compareExchange(i32, idx, v, v + 1) === v) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @param {number} ino
+     */
+    function rdunlock(ino) {
+        const idx = (inodeOffset(ino) + LOCK_OFFSET) / 4;
+        const v = Atomics.sub(i32, idx, 1) - 1;
+        // The last reader wakes the waiters, unless new readers came in
+        if (v === LOCK_WAITING &&
+            Atomics.compareExchange(i32, idx, v, 0) === v) {
+            Atomics.notify(i32, idx);
+        }
+    }
+
+    /**
+     * Lock an inode for writing, excluding readers and other writers
+     * @param {number} ino
+     */
+    function wrlock(ino) {
+        const idx = (inodeOffset(ino) + LOCK_OFFSET) / 4;
+        for (;;) {
+            const v = Atomics.load(i32, idx);
+            if (v & ~LOCK_WAITING) {
+                lockWait(idx, v);
+            } else if (Atomics.compareExchange(i32, idx, v, v | LOCK_WRITER) === v) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @param {number} ino
+     */
+    function wrunlock(ino) {
+        const idx = (inodeOffset(ino) + LOCK_OFFSET) / 4;
+        if (Atomics.exchange(i32, idx, 0) & LOCK_WAITING) {
+            Atomics.notify(i32, idx);
+        }
+    }
 
-            if (Atomics.compareExchange(u32, SB_FREE_INODE / 4, freeInode, freeInode + 1) === freeInode) {
-                // Zero the inode
-                const inodeOffset = inodeTableOffset + (freeInode * INODE_SIZE);
-                u8.fill(0, inodeOffset, inodeOffset + INODE_SIZE);
-                return freeInode;
+    /**
+     * Allocate a free inode from the inode bitmap
+     * @returns {number} Inode number or -1 if full
+     */
+    function allocInode() {
+        const bitmap = blockOffset(view.getUint32(SB_INODE_BITMAP, true)) / 4;
+        const words = Math.ceil(view.getUint32(SB_INODE_COUNT, true) / 32);
+        const start = Math.floor(Atomics.load(u32, SB_FREE_INODE / 4) / 32);
+
+        for (let n = 0; n < words; n++) {
+            const w = (start + n) % words;
+            let bits = Atomics.load(u32, bitmap + w);
+
+            while (bits !== 0xFFFFFFFF) {
+                const bit = 31 - Math.clz32(~bits & (bits + 1));
+                bits = Atomics.or(u32, bitmap + w, 1 << bit);
+                if (bits & (1 << bit)) continue;
+
+                const ino = (w * 32) + bit;
+                Atomics.store(u32, SB_FREE_INODE / 4, ino + 1);
+
+                // Zero the inode, the generation carries on so that a
+                // reused inode is a new one
+                const off = inodeOffset(ino);
+                const generation = Atomics.load(u32, (off + 52) / 4);
+                u8.fill(0, off, off + INODE_SIZE);
+                Atomics.store(u32, (off + 52) / 4, (generation + 1) >>> 0);
+                return ino;
             }
         }
+
+        return -1;
+    }
+
+    /**
+     * Free an inode for reuse
+     * @param {number} ino
+     */
+    function freeInode(ino) {
+        inodeChanged(ino);
+        const bitmap = blockOffset(view.getUint32(SB_INODE_BITMAP, true)) / 4;
+        Atomics.and(u32, bitmap + Math.floor(ino / 32), ~(1 << (ino % 32)));
+        Atomics.store(u32, SB_FREE_INODE / 4, ino);
     }
 
     /**
@@ -259,6 +701,7 @@ const SABFS = (function() {
         const sizeHigh = view.getUint32(off + 8, true);
 
         return {
+            ino,
             mode: view.getUint32(off + 0, true),
             size: sizeLow + (sizeHigh * 0x100000000),
             blocks: view.getUint32(off + 12, true),
@@ -273,7 +716,10 @@ const SABFS = (function() {
                 view.getUint32(off + 44, true),
             ],
             indirect: view.getUint32(off + 48, true),
-            flags: view.getUint32(off + 52, true),
+            generation: view.getUint32(off + 52, true),
+            dindirect: view.getUint32(off + 56, true),
+            tindirect: view.getUint32(off + 60, true),
+            flags: Atomics.load(u32, (off + 64) / 4),
         };
     }
 
@@ -297,69 +743,269 @@ const SABFS = (function() {
             }
         }
         if (data.indirect !== undefined) view.setUint32(off + 48, data.indirect, true);
-        if (data.flags !== undefined) view.setUint32(off + 52, data.flags, true);
+        if (data.dindirect !== undefined) view.setUint32(off + 56, data.dindirect, true);
+        if (data.tindirect !== undefined) view.setUint32(off + 60, data.tindirect, true);
+        if (data.flags !== undefined) Atomics.store(u32, (off + 64) / 4, data.flags);
     }
 
     /**
-     * Get block number for a file offset
-     * @param {Object} inode
+     * Walk the block tree of a file to the slot holding the pointer to a
+     * data block. Past the direct blocks come one single, one double and
+     * one triple indirect tree, like ext2.
+     * @param {number} ino
      * @param {number} fileBlock - Block index within file
-     * @returns {number} Block number or -1
+     * @param {boolean} alloc - Allocate missing indirect blocks and copy
+     *     shared ones, for writing
+     * @returns {number} Byte offset of the slot or -1
      */
-    function getBlockNum(inode, fileBlock) {
+    function blockSlot(ino, fileBlock, alloc) {
+        const off = inodeOffset(ino);
         if (fileBlock < DIRECT_BLOCKS) {
-            const blk = inode.direct[fileBlock];
-            return blk === 0 ? -1 : blk;
+            return off + 16 + (fileBlock * 4);
+        }
+
+        let idx = fileBlock - DIRECT_BLOCKS;
+        let slot = off + 48;
+        let levels = 1;
+        if (idx >= PTRS_PER_BLOCK) {
+            idx -= PTRS_PER_BLOCK;
+            slot = off + 56;
+            levels = 2;
+            if (idx >= PTRS_PER_BLOCK ** 2) {
+                idx -= PTRS_PER_BLOCK ** 2;
+                slot = off + 60;
+                levels = 3;
+                if (idx >= PTRS_PER_BLOCK ** 3) return -1;
+            }
         }
 
-        // Indirect block
-        const indirectIdx = fileBlock - DIRECT_BLOCKS;
-        if (indirectIdx >= PTRS_PER_BLOCK) {
-            return -1; // Would need double indirect
+        for (let l = levels - 1; l >= 0; l--) {
+            let table = view.getUint32(slot, true);
+            if (table === 0) {
+                if (!alloc) return -1;
+                table = allocBlock();
+                if (table === -1) return -1;
+                view.setUint32(slot, table, true);
+                markDirtyAt(slot);
+            } else if (alloc) {
+                table = unshare(slot, l + 1);
+                if (table === -1) return -1;
+            }
+            const digit = Math.floor(idx / (PTRS_PER_BLOCK ** l)) % PTRS_PER_BLOCK;
+            slot = blockOffset(table) + (digit * 4);
         }
+        return slot;
+    }
 
-        if (inode.indirect === 0) return -1;
+    /**
+     * Get block number for a file offset
+     * @param {Object} inode
+     * @param {number} fileBlock - Block index within file
+     * @returns {number} Block number or -1
+     */
+    function getBlockNum(inode, fileBlock) {
+        const slot = blockSlot(inode.ino, fileBlock, false);
+        if (slot === -1) return -1;
 
-        const indirectOff = blockOffset(inode.indirect);
-        return view.getUint32(indirectOff + (indirectIdx * 4), true);
+        const blk = view.getUint32(slot, true);
+        return blk === 0 ? -1 : blk;
     }
 
     /**
      * Allocate a block for a file at given file block index
      * @param {number} ino
      * @param {number} fileBlock
+     * @param {boolean} zero - Clear the block, unneeded if it is overwritten
      * @returns {number} Block number or -1
      */
-    function allocBlockForFile(ino, fileBlock) {
-        const newBlock = allocBlock();
+    function allocBlockForFile(ino, fileBlock, zero = true) {
+        const slot = blockSlot(ino, fileBlock, true);
+        if (slot === -1) return -1;
+
+        const newBlock = allocBlock(zero);
         if (newBlock === -1) return -1;
+        view.setUint32(slot, newBlock, true);
+        markDirtyAt(slot);
 
+        // Update block count
         const off = inodeOffset(ino);
+        const blocks = view.getUint32(off + 12, true);
+        view.setUint32(off + 12, blocks + 1, true);
 
-        if (fileBlock < DIRECT_BLOCKS) {
-            view.setUint32(off + 16 + (fileBlock * 4), newBlock, true);
-        } else {
-            const indirectIdx = fileBlock - DIRECT_BLOCKS;
-            let indirect = view.getUint32(off + 48, true);
-
-            if (indirect === 0) {
-                indirect = allocBlock();
-                if (indirect === -1) {
-                    freeBlock(newBlock);
-                    return -1;
-                }
-                view.setUint32(off + 48, indirect, true);
+        return newBlock;
+    }
+
+    /**
+     * Index of the state word of a block in u32
+     * @param {number} blockNum
+     * @returns {number}
+     */
+    function blockStateIndex(blockNum) {
+        return (blockOffset(view.getUint32(SB_BLOCK_STATE, true)) / 4) + blockNum;
+    }
+
+    /**
+     * Wait for a block of a lazily mounted file to be present, queueing it
+     * on the fetch ring if nobody asked for it yet. Blocks with
+     * Atomics.wait, so it must not run on the browser main thread.
+     * @param {number} blockNum
+     */
+    function ensureBlock(blockNum) {
+        const idx = blockStateIndex(blockNum);
+        let state = Atomics.load(i32, idx);
+        if (state === BLOCK_PRESENT) return;
+
+        if (state === BLOCK_MISSING &&
+            Atomics.compareExchange(i32, idx, BLOCK_MISSING, BLOCK_REQUESTED) === BLOCK_MISSING) {
+            const ring = blockOffset(view.getUint32(SB_FETCH_RING, true)) / 4;
+            const n = Atomics.add(u32, ring, 1);
+            Atomics.store(u32, ring + 2 + (n % RING_SLOTS), blockNum);
+            Atomics.notify(i32, ring);
+        }
+
+        while ((state = Atomics.load(i32, idx)) !== BLOCK_PRESENT) {
+            Atomics.wait(i32, idx, state);
+        }
+    }
+
+    /**
+     * Copy file data at pos into buffer. Runs of physically contiguous
+     * blocks are copied straight from the SAB with a single set().
+     * @param {Object} inode
+     * @param {Uint8Array} buffer
+     * @param {number} bufOff - Offset in buffer
+     * @param {number} count
+     * @param {number} pos - Offset in the file
+     * @returns {number} Bytes read
+     */
+    function readAt(inode, buffer, bufOff, count, pos) {
+        if (pos >= inode.size) return 0;
+
+        const toRead = Math.min(count, inode.size - pos);
+        let bytesRead = 0;
+
+        if (inode.flags & INODE_INLINE) {
+            const off = inodeOffset(inode.ino) + INLINE_OFFSET + pos;
+            buffer.set(u8.subarray(off, off + toRead), bufOff);
+            return toRead;
+        }
+
+        while (bytesRead < toRead) {
+            const fileBlockIdx = Math.floor((pos + bytesRead) / BLOCK_SIZE);
+            const blockOff = (pos + bytesRead) % BLOCK_SIZE;
+            const blockNum = getBlockNum(inode, fileBlockIdx);
+            let chunkSize = Math.min(toRead - bytesRead, BLOCK_SIZE - blockOff);
+
+            if (blockNum === -1) {
+                // Sparse file - return zeros
+                buffer.fill(0, bufOff + bytesRead, bufOff + bytesRead + chunkSize);
+                bytesRead += chunkSize;
+                continue;
+            }
+
+            ensureBlock(blockNum);
+            for (let next = 1; bytesRead + chunkSize < toRead &&
+                     getBlockNum(inode, fileBlockIdx + next) === blockNum + next; next++) {
+                ensureBlock(blockNum + next);
+                chunkSize += Math.min(toRead - bytesRead - chunkSize, BLOCK_SIZE);
             }
 
-            const indirectOff = blockOffset(indirect);
-            view.setUint32(indirectOff + (indirectIdx * 4), newBlock, true);
+            const dataOff = blockOffset(blockNum) + blockOff;
+            buffer.set(u8.subarray(dataOff, dataOff + chunkSize), bufOff + bytesRead);
+            bytesRead += chunkSize;
         }
 
-        // Update block count
-        const blocks = view.getUint32(off + 12, true);
-        view.setUint32(off + 12, blocks + 1, true);
+        return bytesRead;
+    }
 
-        return newBlock;
+    /**
+     * Number of directory entries taken by a name
+     * @param {number} nameLen - Length in bytes
+     * @returns {number}
+     */
+    function direntSlots(nameLen) {
+        return Math.ceil((8 + nameLen) / DIRENT_SIZE);
+    }
+
+    /**
+     * Compare the name of a directory entry
+     * @param {number} entOff
+     * @param {Uint8Array} nameBytes
+     * @returns {boolean}
+     */
+    function direntNameEquals(entOff, nameBytes) {
+        if (view.getUint16(entOff + 4, true) !== nameBytes.length) return false;
+
+        for (let i = 0; i < nameBytes.length; i++) {
+            if (u8[entOff + 8 + i] !== nameBytes[i]) return false;
+        }
+        return true;
+    }
+
+    /**
+     * FNV-1a over the name and then the parent, matches sabfs_name_hash()
+     * @param {number} parent
+     * @param {Uint8Array} nameBytes
+     * @returns {number} Non-zero hash
+     */
+    function nameHash(parent, nameBytes) {
+        let h = 2166136261;
+        for (let i = 0; i < nameBytes.length; i++) {
+            h = Math.imul(h ^ nameBytes[i], 16777619);
+        }
+        h = Math.imul(h ^ parent, 16777619) >>> 0;
+        return h === 0 ? 1 : h;
+    }
+
+    /**
+     * Look up a name in the dentry index
+     * @param {number} dirIno
+     * @param {Uint8Array} nameBytes
+     * @returns {number} Inode number or -1
+     */
+    function indexLookup(dirIno, nameBytes) {
+        const index = blockOffset(view.getUint32(SB_INDEX_BLOCK, true)) / 4;
+        const mask = view.getUint32(SB_INDEX_SLOTS, true) - 1;
+        const hash = nameHash(dirIno, nameBytes);
+
+        for (let i = hash & mask, n = 0; n <= mask; i = (i + 1) & mask, n++) {
+            const slot = index + (i * 4);
+            const h = Atomics.load(u32, slot);
+            if (h === 0) return -1;
+
+            const ino = Atomics.load(u32, slot + 3);
+            if (h !== hash || ino === 0 || u32[slot + 1] !== dirIno) continue;
+
+            const loc = u32[slot + 2];
+            const entOff = blockOffset(Math.floor(loc / DIRENTS_PER_BLOCK)) +
+                           ((loc % DIRENTS_PER_BLOCK) * DIRENT_SIZE);
+            if (direntNameEquals(entOff, nameBytes)) return ino;
+        }
+
+        return -1;
+    }
+
+    /**
+     * Add a link to the dentry index
+     * @param {number} dirIno
+     * @param {Uint8Array} nameBytes
+     * @param {number} loc - block * DIRENTS_PER_BLOCK + entry
+     * @param {number} ino
+     */
+    function indexAdd(dirIno, nameBytes, loc, ino) {
+        const index = blockOffset(view.getUint32(SB_INDEX_BLOCK, true)) / 4;
+        const mask = view.getUint32(SB_INDEX_SLOTS, true) - 1;
+        const hash = nameHash(dirIno, nameBytes);
+
+        for (let i = hash & mask, n = 0; n <= mask; i = (i + 1) & mask, n++) {
+            const slot = index + (i * 4);
+            if (Atomics.compareExchange(u32, slot, 0, hash) === 0) {
+                u32[slot + 1] = dirIno;
+                u32[slot + 2] = loc;
+                Atomics.store(u32, slot + 3, ino);
+                return;
+            }
+        }
     }
 
     /**
@@ -372,6 +1018,14 @@ const SABFS = (function() {
         const dir = readInode(dirIno);
         if ((dir.mode & S_IFMT) !== S_IFDIR) return -1;
 
+        const nameBytes = encoder.encode(name);
+        if (nameBytes.length > NAME_MAX) return -1;
+
+        if (view.getUint32(SB_INDEX_BLOCK, true) !== 0) {
+            return indexLookup(dirIno, nameBytes);
+        }
+
+        // Images from before the index are scanned
         const numBlocks = Math.ceil(dir.size / BLOCK_SIZE);
 
         for (let b = 0; b < numBlocks; b++) {
@@ -380,17 +1034,15 @@ const SABFS = (function() {
 
             const blkOff = blockOffset(blkNum);
 
-            for (let i = 0; i < DIRENTS_PER_BLOCK; i++) {
+            for (let i = 0; i < DIRENTS_PER_BLOCK;) {
                 const entOff = blkOff + (i * DIRENT_SIZE);
-                const entIno = view.getUint32(entOff, true);
-                if (entIno === 0) continue;
+                const entIno = Atomics.load(u32, entOff / 4);
+                if (entIno === 0) break;
 
-                const nameLen = view.getUint16(entOff + 4, true);
-                const entName = new TextDecoder().decode(u8.slice(entOff + 8, entOff + 8 + nameLen));
-
-                if (entName === name) {
+                if (direntNameEquals(entOff, nameBytes)) {
                     return entIno;
                 }
+                i += direntSlots(view.getUint16(entOff + 4, true));
             }
         }
 
@@ -398,7 +1050,9 @@ const SABFS = (function() {
     }
 
     /**
-     * Add entry to directory
+     * Add entry to directory, unless it has one of that name already. The
+     * directory is locked for writing meanwhile, so of two threads adding
+     * the same name one fails.
      * @param {number} dirIno
      * @param {string} name
      * @param {number} ino
@@ -406,16 +1060,35 @@ const SABFS = (function() {
      * @returns {boolean}
      */
     function addDirEntry(dirIno, name, ino, type) {
+        wrlock(dirIno);
+        const added = lookupInDir(dirIno, name) === -1 &&
+            insertDirEntry(dirIno, name, ino, type);
+        wrunlock(dirIno);
+        return added;
+    }
+
+    /**
+     * Add entry to a directory locked for writing
+     * @param {number} dirIno
+     * @param {string} name
+     * @param {number} ino
+     * @param {number} type
+     * @returns {boolean}
+     */
+    function insertDirEntry(dirIno, name, ino, type) {
         const dir = readInode(dirIno);
         if ((dir.mode & S_IFMT) !== S_IFDIR) return false;
 
-        const nameBytes = new TextEncoder().encode(name);
-        if (nameBytes.length > 24) return false;
+        const nameBytes = encoder.encode(name);
+        if (nameBytes.length > NAME_MAX) return false;
 
-        const numBlocks = Math.ceil(dir.size / BLOCK_SIZE) || 1;
+        const slots = direntSlots(nameBytes.length);
+        const numBlocks = Math.ceil(dir.size / BLOCK_SIZE);
+        const fill = dirFill.get(dirIno);
+        let first = fill && fill[0] === dir.generation ? fill[1] : 0;
 
-        // Find free slot
-        for (let b = 0; b < numBlocks; b++) {
+        // Find free slots, the block after the last one is a fresh block
+        for (let b = first; b <= numBlocks; b++) {
             let blkNum = getBlockNum(dir, b);
             if (blkNum === -1) {
                 blkNum = allocBlockForFile(dirIno, b);
@@ -423,43 +1096,200 @@ const SABFS = (function() {
             }
 
             const blkOff = blockOffset(blkNum);
-
-            for (let i = 0; i < DIRENTS_PER_BLOCK; i++) {
-                const entOff = blkOff + (i * DIRENT_SIZE);
-                const entIno = view.getUint32(entOff, true);
-
-                if (entIno === 0) {
-                    // Found free slot
-                    view.setUint32(entOff, ino, true);
-                    view.setUint16(entOff + 4, nameBytes.length, true);
-                    view.setUint16(entOff + 6, type, true);
-                    u8.set(nameBytes, entOff + 8);
-
-                    // Update directory size if needed
-                    const newSize = (b * BLOCK_SIZE) + ((i + 1) * DIRENT_SIZE);
-                    if (newSize > dir.size) {
-                        writeInode(dirIno, { size: newSize });
-                    }
-
-                    return true;
-                }
+            let i = 0;
+            while (i < DIRENTS_PER_BLOCK && view.getUint32(blkOff + (i * DIRENT_SIZE), true) !== 0) {
+                i += direntSlots(view.getUint16(blkOff + (i * DIRENT_SIZE) + 4, true));
+            }
+            if (i >= DIRENTS_PER_BLOCK && b === first) first++;
+            dirFill.set(dirIno, [dir.generation, first]);
+            if (i + slots > DIRENTS_PER_BLOCK) continue;
+
+            // Publish the name before the entry becomes visible to lookups
+            const entOff = blkOff + (i * DIRENT_SIZE);
+            view.setUint16(entOff + 4, nameBytes.length, true);
+            view.setUint16(entOff + 6, type, true);
+            u8.set(nameBytes, entOff + 8);
+            Atomics.store(u32, entOff / 4, ino);
+            markDirty(blkNum);
+
+            // Update directory size if needed
+            const newSize = (b * BLOCK_SIZE) + ((i + slots) * DIRENT_SIZE);
+            if (newSize > dir.size) {
+                writeInode(dirIno, { size: newSize });
             }
-        }
-
-        // Need new block
-        const newBlockIdx = numBlocks;
-        const blkNum = allocBlockForFile(dirIno, newBlockIdx);
-        if (blkNum === -1) return false;
 
-        const blkOff = blockOffset(blkNum);
-        view.setUint32(blkOff, ino, true);
-        view.setUint16(blkOff + 4, nameBytes.length, true);
-        view.setUint16(blkOff + 6, type, true);
-        u8.set(nameBytes, blkOff + 8);
+            if (view.getUint32(SB_INDEX_BLOCK, true) !== 0) {
+                indexAdd(dirIno, nameBytes, (blkNum * DIRENTS_PER_BLOCK) + i, ino);
+            }
+            Atomics.add(u32, SB_GENERATION / 4, 1);
 
-        writeInode(dirIno, { size: (newBlockIdx * BLOCK_SIZE) + DIRENT_SIZE });
+            return true;
+        }
 
-        return true;
+        return false;
+    }
+
+    /**
+     * Byte offset of an open file
+     * @param {number} idx - Open file index
+     * @returns {number}
+     */
+    function fileOffset(idx) {
+        return blockOffset(view.getUint32(SB_FILE_TABLE, true)) + (idx * FILE_SIZE);
+    }
+
+    function fileIno(idx) {
+        return view.getUint32(fileOffset(idx) + 4, true);
+    }
+
+    function fileFlags(idx) {
+        return view.getUint32(fileOffset(idx) + 8, true);
+    }
+
+    function filePos(idx) {
+        return Number(Atomics.load(u64, (fileOffset(idx) + 16) / 8));
+    }
+
+    function setFilePos(idx, pos) {
+        Atomics.store(u64, (fileOffset(idx) + 16) / 8, BigInt(pos));
+    }
+
+    /**
+     * Drop a reference to an open file, it is free once none are left
+     * @param {number} idx - Open file index
+     */
+    function putFile(idx) {
+        Atomics.sub(u32, fileOffset(idx) / 4, 1);
+    }
+
+    /**
+     * Take a reference to the open file of an fd
+     * @param {number} fd
+     * @returns {number} Open file index or -1 if fd is not open
+     */
+    function getFile(fd) {
+        const idx = fd - FD_FIRST;
+        if (!(idx >= 0 && idx < view.getUint32(SB_FD_SLOTS, true))) return -1;
+
+        const fdSlot = blockOffset(view.getUint32(SB_FD_TABLE, true)) / 4 + idx;
+        const slot = Atomics.load(u32, fdSlot);
+        if (slot === 0) return -1;
+
+        const refcnt = fileOffset(slot - 1) / 4;
+        for (;;) {
+            const ref = Atomics.load(u32, refcnt);
+            if (ref === 0) return -1;
+            if (Atomics.compareExchange(u32, refcnt, ref, ref + 1) === ref) break;
+        }
+
+        // The fd may have been closed and the open file reused meanwhile
+        if (Atomics.load(u32, fdSlot) !== slot) {
+            putFile(slot - 1);
+            return -1;
+        }
+        return slot - 1;
+    }
+
+    /**
+     * Allocate an open file with one reference
+     * @param {number} ino
+     * @param {number} flags
+     * @returns {number} Open file index or -1
+     */
+    function allocFile(ino, flags) {
+        const n = view.getUint32(SB_FD_SLOTS, true);
+
+        for (let idx = 0; idx < n; idx++) {
+            const off = fileOffset(idx);
+            if (Atomics.compareExchange(u32, off / 4, 0, 1) === 0) {
+                view.setUint32(off + 4, ino, true);
+                view.setUint32(off + 8, flags, true);
+                setFilePos(idx, 0);
+                return idx;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * Point the lowest free fd at an open file, handing over a reference
+     * @param {number} idx - Open file index
+     * @returns {number} File descriptor or -1
+     */
+    function installFd(idx) {
+        const fds = blockOffset(view.getUint32(SB_FD_TABLE, true)) / 4;
+        const n = view.getUint32(SB_FD_SLOTS, true);
+
+        for (let i = 0; i < n; i++) {
+            if (Atomics.compareExchange(u32, fds + i, 0, idx + 1) === 0) {
+                return i + FD_FIRST;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * Write to an inode at an offset, growing the file as needed
+     * @param {number} ino
+     * @param {Uint8Array} buffer
+     * @param {number} count
+     * @param {number} pos
+     * @returns {number} Bytes written
+     */
+    function writeAt(ino, buffer, count, pos) {
+        let bytesWritten = 0;
+
+        const old = readInode(ino);
+        const inline = (old.flags & INODE_INLINE) !== 0;
+        if (count > 0 && Math.max(old.size, pos + count) <= INLINE_MAX &&
+            (inline || old.blocks === 0)) {
+            const off = inodeOffset(ino) + INLINE_OFFSET;
+            if (!inline) {
+                // Empty, or a hole, so far
+                u8.fill(0, off, off + INLINE_MAX);
+                writeInode(ino, { flags: old.flags | INODE_INLINE });
+            }
+            u8.set(buffer.subarray(0, count), off + pos);
+            writeInode(ino, { size: Math.max(old.size, pos + count) });
+            markDirtyAt(off);
+            inodeChanged(ino);
+            return count;
+        }
+        if (count > 0 && inline && !spillInline(ino)) return 0;
+
+        while (bytesWritten < count) {
+            const fileBlockIdx = Math.floor((pos + bytesWritten) / BLOCK_SIZE);
+            const blockOff = (pos + bytesWritten) % BLOCK_SIZE;
+
+            const slot = blockSlot(ino, fileBlockIdx, true);
+            if (slot === -1) break;
+            let blockNum = view.getUint32(slot, true);
+
+            const chunkSize = Math.min(count - bytesWritten, BLOCK_SIZE - blockOff);
+            if (blockNum === 0) {
+                // A block written in full needs no clearing
+                blockNum = allocBlockForFile(ino, fileBlockIdx, chunkSize < BLOCK_SIZE);
+                if (blockNum === -1) break;
+            } else {
+                blockNum = unshare(slot, 0);
+                if (blockNum === -1) break;
+                ensureBlock(blockNum);
+            }
+
+            const dataOff = blockOffset(blockNum) + blockOff;
+            u8.set(buffer.subarray(bytesWritten, bytesWritten + chunkSize), dataOff);
+            markDirty(blockNum);
+            bytesWritten += chunkSize;
+        }
+
+        // Update file size
+        const inode = readInode(ino);
+        if (pos + bytesWritten > inode.size) {
+            writeInode(ino, { size: pos + bytesWritten });
+        }
+        if (bytesWritten > 0) inodeChanged(ino);
+
+        return bytesWritten;
     }
 
     /**
@@ -490,7 +1320,12 @@ const SABFS = (function() {
         // Normalize path first
         path = normalizePath(path);
 
-        // Check cache
+        // Check cache, dropping it if any worker changed the namespace
+        const generation = Atomics.load(u32, SB_GENERATION / 4);
+        if (generation !== cacheGeneration) {
+            pathCache.clear();
+            cacheGeneration = generation;
+        }
         if (pathCache.has(path)) {
             return pathCache.get(path);
         }
@@ -534,7 +1369,9 @@ const SABFS = (function() {
         const ino = resolvePath(path);
         if (ino === -1) return null;
 
+        rdlock(ino);
         const inode = readInode(ino);
+        rdunlock(ino);
         return {
             ino,
             mode: inode.mode,
@@ -558,7 +1395,7 @@ const SABFS = (function() {
 
         let ino = resolvePath(path);
 
-        if (ino === -1) {
+        while (ino === -1) {
             if (!(flags & O_CREAT)) return -1;
 
             // Create new file
@@ -575,7 +1412,11 @@ const SABFS = (function() {
             });
 
             if (!addDirEntry(parentIno, basename, ino, S_IFREG >> 12)) {
-                return -1;
+                freeInode(ino);
+                // Another thread may have created it first, open that one
+                ino = lookupInDir(parentIno, basename);
+                if (ino === -1) return -1;
+                break;
             }
 
             pathCache.set(path, ino);
@@ -588,17 +1429,16 @@ const SABFS = (function() {
 
         // Truncate if requested
         if (flags & O_TRUNC) {
-            // TODO: free existing blocks
-            writeInode(ino, { size: 0, blocks: 0 });
+            wrlock(ino);
+            truncateInode(ino);
+            wrunlock(ino);
         }
 
-        const fd = nextFd++;
-        fdTable.set(fd, {
-            ino,
-            path,
-            flags,
-            pos: 0,
-        });
+        const idx = allocFile(ino, flags);
+        if (idx === -1) return -1;
+
+        const fd = installFd(idx);
+        if (fd === -1) putFile(idx);
 
         return fd;
     }
@@ -609,8 +1449,14 @@ const SABFS = (function() {
      * @returns {number} 0 on success, -1 on error
      */
     function close(fd) {
-        if (!fdTable.has(fd)) return -1;
-        fdTable.delete(fd);
+        const idx = fd - FD_FIRST;
+        if (!(idx >= 0 && idx < view.getUint32(SB_FD_SLOTS, true))) return -1;
+
+        const fdSlot = blockOffset(view.getUint32(SB_FD_TABLE, true)) / 4 + idx;
+        const slot = Atomics.exchange(u32, fdSlot, 0);
+        if (slot === 0) return -1;
+
+        putFile(slot - 1);
         return 0;
     }
 
@@ -622,34 +1468,16 @@ const SABFS = (function() {
      * @returns {number} Bytes read or -1
      */
     function read(fd, buffer, count) {
-        const file = fdTable.get(fd);
-        if (!file) return -1;
-
-        const inode = readInode(file.ino);
-        if (file.pos >= inode.size) return 0;
-
-        const toRead = Math.min(count, inode.size - file.pos);
-        let bytesRead = 0;
-
-        while (bytesRead < toRead) {
-            const fileBlockIdx = Math.floor((file.pos + bytesRead) / BLOCK_SIZE);
-            const blockOff = (file.pos + bytesRead) % BLOCK_SIZE;
-            const blockNum = getBlockNum(inode, fileBlockIdx);
-
-            if (blockNum === -1) {
-                // Sparse file - return zeros
-                const chunkSize = Math.min(toRead - bytesRead, BLOCK_SIZE - blockOff);
-                buffer.fill(0, bytesRead, bytesRead + chunkSize);
-                bytesRead += chunkSize;
-            } else {
-                const dataOff = blockOffset(blockNum) + blockOff;
-                const chunkSize = Math.min(toRead - bytesRead, BLOCK_SIZE - blockOff);
-                buffer.set(u8.slice(dataOff, dataOff + chunkSize), bytesRead);
-                bytesRead += chunkSize;
-            }
-        }
-
-        file.pos += bytesRead;
+        const idx = getFile(fd);
+        if (idx === -1) return -1;
+
+        const ino = fileIno(idx);
+        rdlock(ino);
+        const pos = filePos(idx);
+        const bytesRead = readAt(readInode(ino), buffer, 0, count, pos);
+        setFilePos(idx, pos + bytesRead);
+        rdunlock(ino);
+        putFile(idx);
         return bytesRead;
     }
 
@@ -661,37 +1489,16 @@ const SABFS = (function() {
      * @returns {number} Bytes written or -1
      */
     function write(fd, buffer, count) {
-        const file = fdTable.get(fd);
-        if (!file) return -1;
-
-        let bytesWritten = 0;
-
-        while (bytesWritten < count) {
-            const fileBlockIdx = Math.floor((file.pos + bytesWritten) / BLOCK_SIZE);
-            const blockOff = (file.pos + bytesWritten) % BLOCK_SIZE;
-
-            const inode = readInode(file.ino);
-            let blockNum = getBlockNum(inode, fileBlockIdx);
-
-            if (blockNum === -1) {
-                blockNum = allocBlockForFile(file.ino, fileBlockIdx);
-                if (blockNum === -1) break;
-            }
-
-            const dataOff = blockOffset(blockNum) + blockOff;
-            const chunkSize = Math.min(count - bytesWritten, BLOCK_SIZE - blockOff);
-            u8.set(buffer.slice(bytesWritten, bytesWritten + chunkSize), dataOff);
-            bytesWritten += chunkSize;
-        }
-
-        file.pos += bytesWritten;
-
-        // Update file size
-        const inode = readInode(file.ino);
-        if (file.pos > inode.size) {
-            writeInode(file.ino, { size: file.pos });
-        }
-
+        const idx = getFile(fd);
+        if (idx === -1) return -1;
+
+        const ino = fileIno(idx);
+        wrlock(ino);
+        const pos = (fileFlags(idx) & 0x400) ? readInode(ino).size : filePos(idx); // O_APPEND
+        const bytesWritten = writeAt(ino, buffer, count, pos);
+        setFilePos(idx, pos + bytesWritten);
+        wrunlock(ino);
+        putFile(idx);
         return bytesWritten;
     }
 
@@ -704,14 +1511,42 @@ const SABFS = (function() {
      * @returns {number}
      */
     function pread(fd, buffer, count, offset) {
-        const file = fdTable.get(fd);
-        if (!file) return -1;
+        const idx = getFile(fd);
+        if (idx === -1) return -1;
+
+        const ino = fileIno(idx);
+        rdlock(ino);
+        const bytesRead = readAt(readInode(ino), buffer, 0, count, offset);
+        rdunlock(ino);
+        putFile(idx);
+        return bytesRead;
+    }
+
+    /**
+     * preadv - read at offset into several buffers without changing position
+     * @param {number} fd
+     * @param {Uint8Array[]} buffers - Filled in order, like an iovec
+     * @param {number} offset
+     * @returns {number} Bytes read or -1
+     */
+    function preadv(fd, buffers, offset) {
+        const idx = getFile(fd);
+        if (idx === -1) return -1;
+
+        const ino = fileIno(idx);
+        rdlock(ino);
+        const inode = readInode(ino);
+        let total = 0;
 
-        const savedPos = file.pos;
-        file.pos = offset;
-        const result = read(fd, buffer, count);
-        file.pos = savedPos;
-        return result;
+        for (const buffer of buffers) {
+            const n = readAt(inode, buffer, 0, buffer.length, offset + total);
+            total += n;
+            if (n < buffer.length) break; // EOF
+        }
+
+        rdunlock(ino);
+        putFile(idx);
+        return total;
     }
 
     /**
@@ -723,14 +1558,15 @@ const SABFS = (function() {
      * @returns {number}
      */
     function pwrite(fd, buffer, count, offset) {
-        const file = fdTable.get(fd);
-        if (!file) return -1;
-
-        const savedPos = file.pos;
-        file.pos = offset;
-        const result = write(fd, buffer, count);
-        file.pos = savedPos;
-        return result;
+        const idx = getFile(fd);
+        if (idx === -1) return -1;
+
+        const ino = fileIno(idx);
+        wrlock(ino);
+        const bytesWritten = writeAt(ino, buffer, count, offset);
+        wrunlock(ino);
+        putFile(idx);
+        return bytesWritten;
     }
 
     /**
@@ -741,27 +1577,31 @@ const SABFS = (function() {
      * @returns {number} New position or -1
      */
     function lseek(fd, offset, whence) {
-        const file = fdTable.get(fd);
-        if (!file) return -1;
-
-        const inode = readInode(file.ino);
+        const idx = getFile(fd);
+        if (idx === -1) return -1;
 
+        let pos;
         switch (whence) {
             case 0: // SEEK_SET
-                file.pos = offset;
+                pos = offset;
                 break;
             case 1: // SEEK_CUR
-                file.pos += offset;
+                pos = filePos(idx) + offset;
                 break;
             case 2: // SEEK_END
-                file.pos = inode.size + offset;
+                rdlock(fileIno(idx));
+                pos = readInode(fileIno(idx)).size + offset;
+                rdunlock(fileIno(idx));
                 break;
             default:
+                putFile(idx);
                 return -1;
         }
 
-        if (file.pos < 0) file.pos = 0;
-        return file.pos;
+        pos = Math.max(pos, 0);
+        setFilePos(idx, pos);
+        putFile(idx);
+        return pos;
     }
 
     /**
@@ -786,6 +1626,7 @@ const SABFS = (function() {
         });
 
         if (!addDirEntry(parentIno, basename, ino, S_IFDIR >> 12)) {
+            freeInode(ino);
             return -1;
         }
 
@@ -793,6 +1634,54 @@ const SABFS = (function() {
         return 0;
     }
 
+    /**
+     * symlink - create a symbolic link, its target stored as the data
+     * @param {string} target
+     * @param {string} path
+     * @returns {number} 0 on success, -1 on error
+     */
+    function symlink(target, path) {
+        if (resolvePath(path) !== -1) return -1;
+
+        const [parentIno, basename] = resolveParent(path);
+        if (parentIno === -1) return -1;
+
+        const ino = allocInode();
+        if (ino === -1) return -1;
+
+        writeInode(ino, { mode: S_IFLNK | 0o777 });
+        const bytes = encoder.encode(target);
+        if (writeAt(ino, bytes, bytes.length, 0) !== bytes.length ||
+            !addDirEntry(parentIno, basename, ino, S_IFLNK >> 12)) {
+            truncateInode(ino);
+            freeInode(ino);
+            return -1;
+        }
+
+        pathCache.set(normalizePath(path), ino);
+        return 0;
+    }
+
+    /**
+     * readlink - read the target of a symbolic link
+     * @param {string} path
+     * @returns {string|null}
+     */
+    function readlink(path) {
+        const ino = resolvePath(path);
+        if (ino === -1) return null;
+
+        rdlock(ino);
+        const inode = readInode(ino);
+        let bytes = null;
+        if ((inode.mode & S_IFMT) === S_IFLNK) {
+            bytes = new Uint8Array(inode.size);
+            readAt(inode, bytes, 0, inode.size, 0);
+        }
+        rdunlock(ino);
+        return bytes && decoder.decode(bytes);
+    }
+
     /**
      * readdir - read directory entries
      * @param {string} path
@@ -802,9 +1691,20 @@ const SABFS = (function() {
         const ino = resolvePath(path);
         if (ino === -1) return null;
 
-        const inode = readInode(ino);
-        if ((inode.mode & S_IFMT) !== S_IFDIR) return null;
+        if ((readInode(ino).mode & S_IFMT) !== S_IFDIR) return null;
 
+        rdlock(ino);
+        const entries = dirEntries(readInode(ino));
+        rdunlock(ino);
+        return entries;
+    }
+
+    /**
+     * List the entries of a directory inode
+     * @param {Object} inode
+     * @returns {Array} [{ name, ino, type }, ...]
+     */
+    function dirEntries(inode) {
         const entries = [];
         const numBlocks = Math.ceil(inode.size / BLOCK_SIZE);
 
@@ -814,22 +1714,89 @@ const SABFS = (function() {
 
             const blkOff = blockOffset(blkNum);
 
-            for (let i = 0; i < DIRENTS_PER_BLOCK; i++) {
+            for (let i = 0; i < DIRENTS_PER_BLOCK;) {
                 const entOff = blkOff + (i * DIRENT_SIZE);
-                const entIno = view.getUint32(entOff, true);
-                if (entIno === 0) continue;
+                const entIno = Atomics.load(u32, entOff / 4);
+                if (entIno === 0) break;
 
                 const nameLen = view.getUint16(entOff + 4, true);
                 const type = view.getUint16(entOff + 6, true);
-                const name = new TextDecoder().decode(u8.slice(entOff + 8, entOff + 8 + nameLen));
+                const name = decoder.decode(u8.slice(entOff + 8, entOff + 8 + nameLen));
 
                 entries.push({ name, ino: entIno, type });
+                i += direntSlots(nameLen);
             }
         }
 
         return entries;
     }
 
+    /**
+     * Copy an inode and what is below it into a directory. File blocks are
+     * shared with the original rather than copied.
+     * @param {number} srcIno
+     * @param {number} parentIno
+     * @param {string} name
+     * @returns {boolean}
+     */
+    function cloneInode(srcIno, parentIno, name) {
+        const ino = allocInode();
+        if (ino === -1) return false;
+
+        // Writers of the source wait until its blocks are shared
+        rdlock(srcIno);
+        const src = readInode(srcIno);
+        const isDir = (src.mode & S_IFMT) === S_IFDIR;
+        const entries = isDir ? dirEntries(src) : null;
+
+        if (isDir) {
+            writeInode(ino, { mode: src.mode, size: 0, blocks: 0 });
+        } else {
+            const off = inodeOffset(srcIno);
+            const generation = readInode(ino).generation;
+            u8.copyWithin(inodeOffset(ino), off, off + INODE_SIZE);
+            Atomics.store(u32, (inodeOffset(ino) + 52) / 4, generation);
+            Atomics.store(u32, (inodeOffset(ino) + LOCK_OFFSET) / 4, 0);
+            for (const blockNum of [...src.direct, src.indirect, src.dindirect, src.tindirect]) {
+                if (blockNum !== 0) Atomics.add(u32, blockRefsIndex(blockNum), 1);
+            }
+        }
+        rdunlock(srcIno);
+
+        if (!addDirEntry(parentIno, name, ino, (src.mode & S_IFMT) >> 12)) {
+            truncateInode(ino);
+            freeInode(ino);
+            return false;
+        }
+
+        if (isDir) {
+            for (const entry of entries) {
+                if (!cloneInode(entry.ino, ino, entry.name)) return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * clone - copy a file or directory tree, sharing the file data with
+     * the original until either side writes to it. Costs one inode per
+     * file and the directory blocks, e.g. for a container layer on top of
+     * a base image. A snapshot is a clone that is left alone.
+     * The source should not change while it is cloned.
+     * @param {string} srcPath
+     * @param {string} dstPath - Must not exist yet
+     * @returns {number} 0 on success, -1 on error
+     */
+    function clone(srcPath, dstPath) {
+        const srcIno = resolvePath(srcPath);
+        if (srcIno === -1 || resolvePath(dstPath) !== -1) return -1;
+
+        const [parentIno, basename] = resolveParent(dstPath);
+        if (parentIno === -1) return -1;
+
+        return cloneInode(srcIno, parentIno, basename) ? 0 : -1;
+    }
+
     /**
      * Import file data from Uint8Array
      * @param {string} path
@@ -865,6 +1832,806 @@ const SABFS = (function() {
         return data;
     }
 
+    /**
+     * Parse an octal or base-256 number field of a tar header
+     * @param {Uint8Array} header
+     * @param {number} off
+     * @param {number} len
+     * @returns {number}
+     */
+    function tarNumber(header, off, len) {
+        if (header[off] & 0x80) {
+            let n = header[off] & 0x7f;
+            for (let i = 1; i < len; i++) n = (n * 256) + header[off + i];
+            return n;
+        }
+        let n = 0;
+        for (let i = 0; i < len; i++) {
+            const c = header[off + i];
+            if (c === 0 || c === 0x20) {
+                if (n > 0) break;
+                continue;
+            }
+            n = (n * 8) + (c - 0x30);
+        }
+        return n;
+    }
+
+    /**
+     * A NUL terminated string field of a tar header
+     * @param {Uint8Array} header
+     * @param {number} off
+     * @param {number} len
+     * @returns {string}
+     */
+    function tarString(header, off, len) {
+        const field = header.subarray(off, off + len);
+        const end = field.indexOf(0);
+        return decoder.decode(end === -1 ? field : field.subarray(0, end));
+    }
+
+    /**
+     * Parse the records of a pax extended header
+     * @param {Uint8Array} data
+     * @returns {Object} key -> value
+     */
+    function paxRecords(data) {
+        const records = {};
+        let off = 0;
+        while (off < data.length) {
+            const space = data.indexOf(0x20, off);
+            if (space === -1) break;
+            const len = parseInt(decoder.decode(data.subarray(off, space)), 10);
+            if (!(len > 0)) break;
+            const record = decoder.decode(data.subarray(space + 1, off + len - 1));
+            const eq = record.indexOf('=');
+            if (eq !== -1) records[record.slice(0, eq)] = record.slice(eq + 1);
+            off += len;
+        }
+        return records;
+    }
+
+    /**
+     * Turn a byte stream into the stream of its decompressed data. Without
+     * a format, gzip and zstd are recognized by their magic number.
+     * @param {ReadableStream} stream
+     * @param {string} compression - DecompressionStream format, 'none' or
+     *     undefined to detect it
+     * @returns {Promise<ReadableStream>}
+     */
+    async function decompressed(stream, compression) {
+        if (compression === undefined) {
+            const reader = stream.getReader();
+            const first = await reader.read();
+            const head = first.done ? new Uint8Array(0) : first.value;
+            if (head[0] === 0x1f && head[1] === 0x8b) {
+                compression = 'gzip';
+            } else if (head[0] === 0x28 && head[1] === 0xb5 && head[2] === 0x2f && head[3] === 0xfd) {
+                compression = 'zstd';
+            }
+            // Put the first chunk back in front of the rest
+            let pending = first;
+            stream = new ReadableStream({
+                async pull(controller) {
+                    const { done, value } = pending || await reader.read();
+                    pending = null;
+                    if (done) {
+                        controller.close();
+                    } else {
+                        controller.enqueue(value);
+                    }
+                },
+                cancel(reason) {
+                    return reader.cancel(reason);
+                },
+            }, { highWaterMark: 0 });
+        }
+        if (!compression || compression === 'none') return stream;
+        return stream.pipeThrough(new DecompressionStream(compression));
+    }
+
+    /**
+     * Import a tar archive, such as an OCI image layer, into a directory
+     * while it streams in. File data is written into SABFS blocks chunk by
+     * chunk as it arrives, so a large layer needs no more memory than a
+     * chunk and the import overlaps the download. Meant for a worker
+     * (sabfs-import-worker.js), before QEMU uses the filesystem.
+     *
+     * Regular files, directories and symbolic links are created with their
+     * permissions, hard links become clones of their target. Whiteouts of
+     * OCI layers are regular files and kept as they are, so each layer
+     * belongs in a directory of its own like an overlay2 diff. Entries
+     * whose path leaves the directory, and devices and FIFOs, are skipped.
+     * @param {ReadableStream|Response} source - Of the tar archive
+     * @param {string} dest - Directory to import into, created if missing
+     * @param {Object} options
+     * @param {string} options.compression - DecompressionStream format of
+     *     the archive, 'none', or detected from the data if left out
+     * @param {Function} options.onProgress - Called with the stats after
+     *     each chunk
+     * @returns {Promise<Object>} { files, dirs, symlinks, links, skipped,
+     *     bytes }, bytes being the size of the uncompressed archive
+     */
+    async function importTar(source, dest, options = {}) {
+        const stream = await decompressed(source.body || source, options.compression);
+        const reader = stream.getReader();
+        const stats = { files: 0, dirs: 0, symlinks: 0, links: 0, skipped: 0, bytes: 0 };
+        const root = normalizePath(dest);
+
+        // The directories made so far, parents are looked up once
+        const dirs = new Map();
+        const ensureDir = (path, mode) => {
+            if (dirs.has(path)) return dirs.get(path);
+            let ino = resolvePath(path);
+            if (ino === -1) {
+                ensureDir(path.slice(0, path.lastIndexOf('/')) || '/', 0o755);
+                if (mkdir(path, mode) !== 0) throw new Error(`SABFS: cannot create ${path}`);
+                ino = resolvePath(path);
+                stats.dirs++;
+            }
+            dirs.set(path, ino);
+            return ino;
+        };
+        const target = (name) => {
+            const parts = [];
+            for (const part of name.split('/')) {
+                if (part === '' || part === '.') continue;
+                if (part === '..') return null;
+                parts.push(part);
+            }
+            return parts.length ? (root === '/' ? '' : root) + '/' + parts.join('/') : null;
+        };
+        ensureDir(root, 0o755);
+
+        const header = new Uint8Array(512);
+        let headerLen = 0;
+        let entry = null; // the entry whose data comes next
+        let pax = {};
+        let longName = null;
+        let longLink = null;
+        let ended = false;
+
+        const startEntry = () => {
+            let sum = 0;
+            for (let i = 0; i < 512; i++) sum += (i >= 148 && i < 156) ? 0x20 : header[i];
+            if (sum === 256) {
+                ended = true; // a zero block ends the archive
+                return;
+            }
+            if (sum !== tarNumber(header, 148, 8)) throw new Error('SABFS: bad tar header');
+
+            const type = String.fromCharCode(header[156] || 0x30);
+            let name = tarString(header, 0, 100);
+            if (header[257] === 0x75 && header[262] === 0) { // "ustar" with a prefix
+                const prefix = tarString(header, 345, 155);
+                if (prefix) name = `${prefix}/${name}`;
+            }
+            name = pax.path || longName || name;
+            const linkName = pax.linkpath || longLink || tarString(header, 157, 100);
+            const size = pax.size !== undefined ? Number(pax.size) : tarNumber(header, 124, 12);
+            const mode = tarNumber(header, 100, 8) & 0o7777;
+
+            entry = { type, size, left: size, pad: (512 - (size % 512)) % 512, fd: -1, data: null };
+            if (type === 'x' || type === 'g' || type === 'L' || type === 'K') {
+                entry.data = new Uint8Array(size);
+                return;
+            }
+            pax = {};
+            longName = longLink = null;
+
+            const path = target(name);
+            if (!path) {
+                stats.skipped++;
+                return;
+            }
+            const parent = path.slice(0, path.lastIndexOf('/')) || '/';
+            if (type === '5') {
+                dirs.delete(path);
+                ensureDir(parent, 0o755);
+                ensureDir(path, mode);
+            } else if (type === '0' || type === '7') {
+                ensureDir(parent, 0o755);
+                entry.fd = open(path, 0x41 | 0x200, mode); // O_CREAT | O_WRONLY | O_TRUNC
+                if (entry.fd === -1) throw new Error(`SABFS: cannot create ${path}`);
+                stats.files++;
+            } else if (type === '2') {
+                ensureDir(parent, 0o755);
+                if (symlink(linkName, path) === 0) {
+                    stats.symlinks++;
+                } else {
+                    stats.skipped++;
+                }
+            } else if (type === '1') {
+                const from = target(linkName);
+                ensureDir(parent, 0o755);
+                if (from && clone(from, path) === 0) {
+                    stats.links++;
+                } else {
+                    stats.skipped++;
+                }
+            } else {
+                stats.skipped++;
+            }
+        };
+
+        const finishEntry = () => {
+            if (entry.fd !== -1) close(entry.fd);
+            if (entry.type === 'x') {
+                pax = paxRecords(entry.data);
+            } else if (entry.type === 'L') {
+                longName = tarString(entry.data, 0, entry.data.length);
+            } else if (entry.type === 'K') {
+                longLink = tarString(entry.data, 0, entry.data.length);
+            }
+            entry = null;
+        };
+
+        try {
+            for (;;) {
+                const { done, value } = await reader.read();
+                if (done) break;
+                const chunk = value instanceof Uint8Array ? value : new Uint8Array(value);
+                stats.bytes += chunk.length;
+
+                let off = 0;
+                while (off < chunk.length && !ended) {
+                    if (entry === null) {
+                        const n = Math.min(512 - headerLen, chunk.length - off);
+                        header.set(chunk.subarray(off, off + n), headerLen);
+                        headerLen += n;
+                        off += n;
+                        if (headerLen === 512) {
+                            headerLen = 0;
+                            startEntry();
+                            if (entry && entry.left === 0 && entry.pad === 0) finishEntry();
+                        }
+                        continue;
+                    }
+                    if (entry.left > 0) {
+                        const n = Math.min(entry.left, chunk.length - off);
+                        const pos = entry.size - entry.left;
+                        if (entry.data) {
+                            entry.data.set(chunk.subarray(off, off + n), pos);
+                        } else if (entry.fd !== -1 &&
+                                   pwrite(entry.fd, chunk.subarray(off, off + n), n, pos) !== n) {
+                            throw new Error('SABFS: no space left for the archive');
+                        }
+                        entry.left -= n;
+                        off += n;
+                    } else {
+                        const n = Math.min(entry.pad, chunk.length - off);
+                        entry.pad -= n;
+                        off += n;
+                    }
+                    if (entry.left === 0 && entry.pad === 0) finishEntry();
+                }
+                if (options.onProgress) options.onProgress(stats);
+                if (ended) {
+                    await reader.cancel();
+                    break;
+                }
+            }
+        } finally {
+            if (entry && entry.fd !== -1) close(entry.fd);
+        }
+        if (entry !== null || headerLen !== 0) throw new Error('SABFS: truncated tar archive');
+        return stats;
+    }
+
+    /**
+     * Fill a run of requested blocks of a file with one HTTP range request,
+     * retrying until it succeeds since readers are waiting for them
+     * @param {Object} entry - Manifest entry of the file
+     * @param {number} fileBlock - Index of the first block in the file
+     * @param {number[]} blocks - Block numbers of the run
+     */
+    async function fetchRun(entry, fileBlock, blocks) {
+        const start = (entry.offset || 0) + (fileBlock * BLOCK_SIZE);
+        const length = Math.min(blocks.length * BLOCK_SIZE, entry.size - (fileBlock * BLOCK_SIZE));
+        let delay = 100;
+
+        for (;;) {
+            try {
+                const resp = await fetch(entry.url, {
+                    headers: { Range: `bytes=${start}-${start + length - 1}` },
+                });
+                if (!resp.ok) throw new Error(`HTTP ${resp.status}`);
+
+                let data = new Uint8Array(await resp.arrayBuffer());
+                if (resp.status === 200) {
+                    // The server ignored the range and sent everything
+                    data = data.subarray(start, start + length);
+                }
+                if (data.length < length) throw new Error('short read');
+
+                for (let i = 0; i < blocks.length; i++) {
+                    const off = blockOffset(blocks[i]);
+                    const chunk = data.subarray(i * BLOCK_SIZE, (i + 1) * BLOCK_SIZE);
+                    u8.set(chunk, off);
+                    u8.fill(0, off + chunk.length, off + BLOCK_SIZE);
+                }
+                blocksFilled(blocks);
+                return;
+            } catch (err) {
+                console.warn(`SABFS: fetching ${entry.url} failed, retrying:`, err);
+                await new Promise(resolve => setTimeout(resolve, delay));
+                delay = Math.min(delay * 2, 30000);
+            }
+        }
+    }
+
+    /**
+     * Data of a content-addressed chunk, from Cache Storage if an earlier
+     * load (of this image or any other one sharing the store) put it there,
+     * else from the network. Chunks are named by the SHA-256 of their data,
+     * which is checked before the chunk is used or cached.
+     * @param {Object} entry - Manifest entry of the file
+     * @param {string} hash - Chunk name
+     * @returns {Promise<Uint8Array>}
+     */
+    function loadChunk(entry, hash) {
+        const url = new URL((entry.store || '') + hash, globalThis.location).href;
+        let load = chunkLoads.get(url);
+        if (load) return load;
+
+        load = (async () => {
+            const cache = typeof caches !== 'undefined' ? await caches.open(CHUNK_CACHE) : null;
+            let resp = cache && await cache.match(url);
+            const cached = !!resp;
+            if (!resp) {
+                resp = await fetch(url);
+                if (!resp.ok) throw new Error(`HTTP ${resp.status}`);
+            }
+
+            const raw = await resp.arrayBuffer();
+            let body = new Response(raw).body;
+            if (entry.compression) body = body.pipeThrough(new DecompressionStream(entry.compression));
+            const data = new Uint8Array(await new Response(body).arrayBuffer());
+
+            const digest = new Uint8Array(await crypto.subtle.digest('SHA-256', data));
+            const name = Array.from(digest, x => x.toString(16).padStart(2, '0')).join('');
+            if (name !== hash) {
+                if (cached) await cache.delete(url);
+                throw new Error(`chunk ${hash} is corrupt`);
+            }
+            if (cache && !cached) await cache.put(url, new Response(raw));
+            return data;
+        })();
+        chunkLoads.set(url, load);
+        load.finally(() => chunkLoads.delete(url)).catch(() => {});
+        return load;
+    }
+
+    /**
+     * Fill the requested blocks of one chunk of a chunked file, retrying
+     * until it succeeds since readers are waiting for them
+     * @param {Object} entry - Manifest entry of the file
+     * @param {number} chunk - Index of the chunk in entry.chunks
+     * @param {number[][]} blocks - [file block, block number] pairs
+     */
+    async function fetchChunk(entry, chunk, blocks) {
+        const hash = entry.chunks[chunk];
+        const first = chunk * (entry.chunkSize / BLOCK_SIZE);
+        let delay = 100;
+
+        for (;;) {
+            try {
+                const data = await loadChunk(entry, hash);
+                for (const [fileBlock, blockNum] of blocks) {
+                    const off = blockOffset(blockNum);
+                    const part = data.subarray((fileBlock - first) * BLOCK_SIZE,
+                                               (fileBlock - first + 1) * BLOCK_SIZE);
+                    u8.set(part, off);
+                    u8.fill(0, off + part.length, off + BLOCK_SIZE);
+                }
+                blocksFilled(blocks.map(([, blockNum]) => blockNum));
+                return;
+            } catch (err) {
+                console.warn(`SABFS: fetching chunk ${hash} of ${entry.path} failed, retrying:`, err);
+                await new Promise(resolve => setTimeout(resolve, delay));
+                delay = Math.min(delay * 2, 30000);
+            }
+        }
+    }
+
+    /**
+     * Queue the chunks of a chunked file from the one holding a requested
+     * block on, as many as fit in the read-ahead window. Zero chunks have
+     * no blocks, a chunk with nothing missing ends the run.
+     * @param {Object} entry - Manifest entry of the file
+     * @param {Object} inode
+     * @param {number} fileBlock - Index of the requested block in the file
+     * @param {number} blockNum - The requested block
+     */
+    function queueChunks(entry, inode, fileBlock, blockNum) {
+        const perChunk = entry.chunkSize / BLOCK_SIZE;
+        const numBlocks = Math.ceil(entry.size / BLOCK_SIZE);
+        let queued = 0;
+        let chunk = Math.floor(fileBlock / perChunk);
+
+        for (; chunk < entry.chunks.length && queued < entry.window; chunk++) {
+            if (!entry.chunks[chunk]) continue;
+
+            const blocks = [];
+            for (let b = chunk * perChunk; b < Math.min((chunk + 1) * perChunk, numBlocks); b++) {
+                const next = getBlockNum(inode, b);
+                if (next === blockNum ||
+                    (next !== -1 && Atomics.compareExchange(i32, blockStateIndex(next),
+                                                            BLOCK_MISSING, BLOCK_REQUESTED) === BLOCK_MISSING)) {
+                    blocks.push([b, next]);
+                }
+            }
+            if (blocks.length === 0) break;
+            fetchQueue.push([entry, chunk, blocks]);
+            queued += perChunk;
+        }
+        entry.nextBlock = chunk * perChunk;
+        startFetches();
+    }
+
+    /**
+     * Start queued fetches while fewer than LAZY_MAX_FETCHES are in flight,
+     * more would only queue up in the browser behind the first ones
+     */
+    function startFetches() {
+        while (fetchesInFlight < LAZY_MAX_FETCHES && fetchQueue.length > 0) {
+            const [entry, first, blocks] = fetchQueue.shift();
+            fetchesInFlight++;
+            (entry.chunks ? fetchChunk : fetchRun)(entry, first, blocks).then(() => {
+                fetchesInFlight--;
+                startFetches();
+            });
+        }
+    }
+
+    /**
+     * Mark blocks present and wake up the readers waiting for them
+     * @param {number[]} blocks
+     */
+    function blocksFilled(blocks) {
+        for (const blockNum of blocks) {
+            const idx = blockStateIndex(blockNum);
+            Atomics.store(i32, idx, BLOCK_PRESENT);
+            Atomics.notify(i32, idx);
+        }
+    }
+
+    /**
+     * Fill a requested block from where it comes from. HTTP fetches take
+     * along the following missing blocks of the file, up to a window that
+     * doubles while misses carry on where the last fetch of the file ended
+     * (a sequential reader) and starts over at a jump. OPFS reads the
+     * following missing blocks of the image.
+     * @param {number} blockNum
+     */
+    function serveBlock(blockNum) {
+        const source = lazySources.get(blockNum);
+        if (source) {
+            const [entry, ino, fileBlock] = source;
+            const inode = readInode(ino);
+            const blocks = [blockNum];
+            entry.window = fileBlock === entry.nextBlock ?
+                Math.min(entry.window * 2, entry.maxReadahead || LAZY_MAX_READAHEAD) :
+                (entry.readahead || LAZY_READAHEAD);
+            if (entry.chunks) {
+                queueChunks(entry, inode, fileBlock, blockNum);
+                return;
+            }
+            for (let b = fileBlock + 1; blocks.length < entry.window && b * BLOCK_SIZE < entry.size; b++) {
+                const next = getBlockNum(inode, b);
+                if (next === -1 ||
+                    Atomics.compareExchange(i32, blockStateIndex(next), BLOCK_MISSING, BLOCK_REQUESTED) !== BLOCK_MISSING) {
+                    break;
+                }
+                blocks.push(next);
+            }
+            entry.nextBlock = fileBlock + blocks.length;
+            fetchQueue.push([entry, fileBlock, blocks]);
+            startFetches();
+            return;
+        }
+
+        let count = 1;
+        if (persistHandle) {
+            const dataBlocks = (u8.length - dataBlocksOffset) / BLOCK_SIZE;
+            while (count < LAZY_READAHEAD && blockNum + count < dataBlocks &&
+                   Atomics.compareExchange(i32, blockStateIndex(blockNum + count),
+                                           BLOCK_MISSING, BLOCK_REQUESTED) === BLOCK_MISSING) {
+                count++;
+            }
+            const off = blockOffset(blockNum);
+            persistHandle.read(u8.subarray(off, off + (count * BLOCK_SIZE)), { at: off });
+        }
+        // Without a source the block was freed and reused, nothing to fill
+        blocksFilled(Array.from({ length: count }, (_, i) => blockNum + i));
+    }
+
+    /**
+     * Take the block requests off the fetch ring and serve them, for good
+     */
+    async function serveFetches() {
+        if (serving) return;
+        serving = true;
+
+        const ring = blockOffset(view.getUint32(SB_FETCH_RING, true)) / 4;
+        let tail = Atomics.load(u32, ring + 1);
+
+        for (;;) {
+            const head = Atomics.load(i32, ring);
+            if ((tail | 0) === head) {
+                const result = Atomics.waitAsync(i32, ring, head);
+                if (result.async) await result.value;
+                continue;
+            }
+
+            // The request is stored right after head is bumped
+            const slot = ring + 2 + ((tail >>> 0) % RING_SLOTS);
+            let blockNum;
+            while ((blockNum = Atomics.exchange(u32, slot, 0)) === 0) {
+                await null;
+            }
+            tail = (tail + 1) >>> 0;
+            Atomics.store(u32, ring + 1, tail);
+
+            serveBlock(blockNum);
+        }
+    }
+
+    /**
+     * mountLazy - create the files of a manifest without their data and
+     * serve the blocks on demand. Readers in any worker or QEMU thread wait
+     * for a missing block while this realm fetches it with a range request,
+     * together with up to readahead following blocks of the file, more for
+     * sequential reads. Up to LAZY_MAX_FETCHES requests run in parallel.
+     *
+     * A file can instead be split into chunks stored by content, as written
+     * by mkchunks.py: chunks is the list of their SHA-256 names, null for a
+     * chunk of zeroes which is left a hole, and each one is fetched whole
+     * from store + name and kept in Cache Storage. Images sharing a store
+     * share their chunks, so a new version only downloads what changed.
+     *
+     * Must run in a realm with an event loop that never reads lazy files
+     * itself, e.g. the main thread or a dedicated fetch worker.
+     * @param {Object} manifest - { files: [{ path, size, url, offset, mode,
+     *     readahead, maxReadahead }] }, offset being where the file starts in
+     *     url (default 0), readahead and maxReadahead the first and largest
+     *     number of blocks per request (default LAZY_READAHEAD and
+     *     LAZY_MAX_READAHEAD), e.g. larger ones for disk images. Chunked
+     *     files have { store, chunkSize, chunks, compression } in place of
+     *     url and offset, compression being a DecompressionStream format
+     * @returns {Promise} Resolves once the files exist, serving goes on
+     */
+    async function mountLazy(manifest) {
+        for (const entry of manifest.files) {
+            const parts = normalizePath(entry.path).split('/').filter(p => p.length > 0);
+            for (let i = 1; i < parts.length; i++) {
+                const dir = '/' + parts.slice(0, i).join('/');
+                if (resolvePath(dir) === -1) mkdir(dir, 0o755);
+            }
+
+            const fd = open(entry.path, 0x40 | 0x200, entry.mode || 0o644); // O_CREAT | O_TRUNC
+            if (fd === -1) throw new Error(`SABFS: cannot create ${entry.path}`);
+            close(fd);
+
+            const ino = resolvePath(entry.path);
+            const numBlocks = Math.ceil(entry.size / BLOCK_SIZE);
+            const perChunk = entry.chunks ? entry.chunkSize / BLOCK_SIZE : 0;
+            if (entry.chunks && (!Number.isInteger(perChunk) || perChunk < 1 ||
+                                 entry.chunks.length !== Math.ceil(numBlocks / perChunk))) {
+                throw new Error(`SABFS: bad chunk list for ${entry.path}`);
+            }
+            for (let b = 0; b < numBlocks; b++) {
+                if (entry.chunks && !entry.chunks[Math.floor(b / perChunk)]) continue;
+
+                const blockNum = allocBlockForFile(ino, b, false);
+                if (blockNum === -1) throw new Error(`SABFS: no space for ${entry.path}`);
+
+                Atomics.store(i32, blockStateIndex(blockNum), BLOCK_MISSING);
+                lazySources.set(blockNum, [entry, ino, b]);
+            }
+            writeInode(ino, { size: entry.size });
+            inodeChanged(ino);
+        }
+
+        serveFetches();
+    }
+
+    /**
+     * Load the filesystem saved in an OPFS image, if it has the geometry
+     * of this one. Metadata, directories and indirect blocks are read
+     * right away, file data is left missing and read on first use.
+     * @param {FileSystemSyncAccessHandle} handle
+     * @returns {boolean} false if there is nothing to restore
+     */
+    function restore(handle) {
+        const saved = new DataView(new ArrayBuffer(SB_GROUP_FREE));
+        if (handle.getSize() !== u8.length) return false;
+
+        handle.read(new Uint8Array(saved.buffer), { at: 0 });
+        for (const field of [SB_MAGIC, SB_VERSION, SB_TOTAL_BLOCKS, SB_INODE_COUNT]) {
+            if (saved.getUint32(field, true) !== view.getUint32(field, true)) return false;
+        }
+
+        const dirtyMap = view.getUint32(SB_DIRTY_MAP, true);
+        handle.read(u8.subarray(0, blockOffset(dirtyMap)), { at: 0 });
+
+        // Open files, block states and fetch requests don't survive a reload
+        const totalBlocks = view.getUint32(SB_TOTAL_BLOCKS, true);
+        const dirtyBlocks = Math.ceil((Math.ceil(totalBlocks / 32) * 4) / BLOCK_SIZE);
+        u8.fill(0, blockOffset(view.getUint32(SB_FD_TABLE, true)),
+                blockOffset(view.getUint32(SB_INODE_BITMAP, true)));
+        u8.fill(0, blockOffset(view.getUint32(SB_BLOCK_STATE, true)),
+                blockOffset(dirtyMap + dirtyBlocks));
+
+        const dataBlocks = (u8.length - dataBlocksOffset) / BLOCK_SIZE;
+        const used = new Uint8Array(dataBlocks);
+        const load = (blockNum, bytes) => {
+            const off = blockOffset(blockNum);
+            handle.read(u8.subarray(off, off + bytes), { at: off });
+        };
+        const walk = (blockNum, levels, lazy) => {
+            // Blocks shared by clones are reached more than once
+            if (blockNum === 0 || used[blockNum]) return;
+            used[blockNum] = 1;
+            if (levels === 0 && lazy) {
+                Atomics.store(i32, blockStateIndex(blockNum), BLOCK_MISSING);
+                return;
+            }
+            load(blockNum, BLOCK_SIZE);
+            if (levels === 0) return;
+            const table = blockOffset(blockNum) / 4;
+            for (let i = 0; i < PTRS_PER_BLOCK; i++) {
+                walk(u32[table + i], levels - 1, lazy);
+            }
+        };
+
+        const bitmap = blockOffset(view.getUint32(SB_INODE_BITMAP, true)) / 4;
+        const inodeCount = view.getUint32(SB_INODE_COUNT, true);
+        for (let ino = 0; ino < inodeCount; ino++) {
+            if (!(u32[bitmap + (ino >>> 5)] & (1 << (ino & 31)))) continue;
+
+            // Nor do the locks held when the image was written
+            Atomics.store(u32, (inodeOffset(ino) + LOCK_OFFSET) / 4, 0);
+
+            const inode = readInode(ino);
+            const lazy = (inode.mode & S_IFMT) === S_IFREG;
+            for (const blockNum of inode.direct) walk(blockNum, 0, lazy);
+            walk(inode.indirect, 1, lazy);
+            walk(inode.dindirect, 2, lazy);
+            walk(inode.tindirect, 3, lazy);
+        }
+
+        // Free blocks only need their free list link
+        for (let blockNum = dirtyMap + dirtyBlocks; blockNum < dataBlocks; blockNum++) {
+            if (!used[blockNum]) load(blockNum, 4);
+        }
+
+        Atomics.add(u32, SB_GENERATION / 4, 1);
+        return true;
+    }
+
+    /**
+     * Write the changed blocks back to the OPFS image, followed by the
+     * metadata if anything changed. Blocks still missing stay dirty.
+     */
+    function flush() {
+        const handle = persistHandle;
+        if (!handle) return;
+
+        const map = blockOffset(view.getUint32(SB_DIRTY_MAP, true)) / 4;
+        const words = Math.ceil(view.getUint32(SB_TOTAL_BLOCKS, true) / 32);
+        let runStart = -1;
+        let runLength = 0;
+        let written = false;
+
+        const writeRun = () => {
+            if (runLength === 0) return;
+            const off = blockOffset(runStart);
+            handle.write(u8.subarray(off, off + (runLength * BLOCK_SIZE)), { at: off });
+            runLength = 0;
+            written = true;
+        };
+
+        for (let w = 0; w < words; w++) {
+            let bits = Atomics.exchange(u32, map + w, 0);
+            while (bits !== 0) {
+                const bit = 31 - Math.clz32(bits & -bits);
+                const blockNum = (w * 32) + bit;
+                bits &= bits - 1;
+
+                if (Atomics.load(i32, blockStateIndex(blockNum)) !== BLOCK_PRESENT) {
+                    Atomics.or(u32, map + w, 1 << bit);
+                    continue;
+                }
+                if (runLength > 0 && runStart + runLength === blockNum) {
+                    runLength++;
+                } else {
+                    writeRun();
+                    runStart = blockNum;
+                    runLength = 1;
+                }
+            }
+        }
+        writeRun();
+
+        const generation = Atomics.load(u32, SB_GENERATION / 4);
+        if (written || generation !== flushedGeneration) {
+            handle.write(u8.subarray(0, blockOffset(view.getUint32(SB_DIRTY_MAP, true))), { at: 0 });
+            handle.flush();
+            flushedGeneration = generation;
+        }
+    }
+
+    /**
+     * Flush whenever sabfs_sync() asks for it, for good. Requests coming in
+     * during a flush are covered by the next one.
+     */
+    async function serveSyncs() {
+        const request = SB_SYNC_REQUEST / 4;
+        const done = SB_SYNC_DONE / 4;
+
+        for (;;) {
+            const pending = Atomics.load(i32, request);
+            if (pending === Atomics.load(i32, done)) {
+                const result = Atomics.waitAsync(i32, request, pending);
+                if (result.async) await result.value;
+                continue;
+            }
+            flush();
+            Atomics.store(i32, done, pending);
+            Atomics.notify(i32, done);
+        }
+    }
+
+    /**
+     * persist - keep the filesystem in an OPFS file across page loads.
+     * A saved image of the same geometry is restored first, its file data
+     * being read in on demand like mountLazy() blocks. Changed blocks are
+     * then written back every interval, and at once when QEMU asks for it
+     * with sabfs_sync(), e.g. on a guest flush of a disk in SABFS.
+     *
+     * Must run in a dedicated worker that never reads SABFS files itself,
+     * as FileSystemSyncAccessHandle is only available there and missing
+     * blocks are served by it. Blocks of mountLazy() files that were never
+     * read are not saved, mount the manifest again after a restore.
+     * @param {string} name - Name of the image in OPFS
+     * @param {Object} options
+     * @param {number} options.interval - Milliseconds between flushes (default 1000)
+     * @returns {Promise<boolean>} Resolves once the filesystem is usable,
+     *     true if a saved image was restored
+     */
+    async function persist(name = 'sabfs.img', options = {}) {
+        const root = await navigator.storage.getDirectory();
+        const file = await root.getFileHandle(name, { create: true });
+        const handle = await file.createSyncAccessHandle();
+
+        const restored = restore(handle);
+        if (!restored) {
+            // Save the fresh filesystem as a whole, changes from now on
+            // are marked again
+            const map = blockOffset(view.getUint32(SB_DIRTY_MAP, true)) / 4;
+            const words = Math.ceil(view.getUint32(SB_TOTAL_BLOCKS, true) / 32);
+            for (let w = 0; w < words; w++) Atomics.store(u32, map + w, 0);
+
+            handle.truncate(u8.length);
+            handle.write(u8, { at: 0 });
+            handle.flush();
+        }
+        clearCache();
+
+        persistHandle = handle;
+        flushedGeneration = Atomics.load(u32, SB_GENERATION / 4);
+        setInterval(flush, options.interval || 1000);
+        serveFetches();
+        // Requests of an earlier page load were flushed then or are lost
+        Atomics.store(u32, SB_SYNC_DONE / 4, Atomics.load(u32, SB_SYNC_REQUEST / 4));
+        Atomics.store(u32, SB_PERSISTING / 4, 1);
+        serveSyncs();
+
+        console.log(`SABFS: ${restored ? 'Restored from' : 'Persisting to'} OPFS ${name}`);
+        return restored;
+    }
+
     /**
      * Get the underlying SharedArrayBuffer
      * @returns {SharedArrayBuffer}
@@ -874,7 +2641,16 @@ const SABFS = (function() {
     }
 
     /**
-     * Clear path cache (call after modifications)
+     * Get the offset of the filesystem in the buffer
+     * @returns {number}
+     */
+    function getBase() {
+        return base;
+    }
+
+    /**
+     * Clear path cache. Namespace changes from any worker clear it on the
+     * next lookup through the superblock generation.
      */
     function clearCache() {
         pathCache.clear();
@@ -884,18 +2660,27 @@ const SABFS = (function() {
         init,
         attach,
         getBuffer,
+        getBase,
         stat,
         open,
         close,
         read,
         write,
         pread,
+        preadv,
         pwrite,
         lseek,
         mkdir,
+        symlink,
+        readlink,
         readdir,
+        clone,
         importFile,
         exportFile,
+        importTar,
+        mountLazy,
+        persist,
+        flush,
         clearCache,
 
         // Constants
@@ -0,0 +1,192 @@
+/*
+ * SABFS read cache for the 9p backend
+ *
+ * An LRU of block maps keyed by (inode, generation), see sabfs_cache.h.
+ * A map entry points into the SABFS memory and is looked up on first use,
+ * so caching a file costs nothing until it is read and never duplicates
+ * its data. The generation is checked on every read: writes, truncation
+ * and reuse of the inode bump it, which drops the map of the old version.
+ * Renames leave the inode alone, so a renamed file keeps its entry.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bitmap.h"
+#include "qemu/queue.h"
+#include "qemu/thread.h"
+#include "sabfs_qemu.h"
+#include "sabfs_cache.h"
+
+/* Larger files are read uncached, so that a few of them can't evict all */
+#define SABFS_CACHE_MAX_FILE (SABFS_CACHE_BUDGET / 4)
+
+typedef struct SABFSCacheEntry {
+    uint64_t ino;
+    uint32_t generation;
+    uint64_t size;
+    uint64_t nblocks;
+    const uint8_t **blocks;  /* data of each block, NULL for a hole */
+    unsigned long *mapped;   /* blocks looked up so far */
+    QTAILQ_ENTRY(SABFSCacheEntry) lru;
+} SABFSCacheEntry;
+
+static QemuMutex sabfs_cache_lock;
+static GHashTable *sabfs_cache_table;
+static QTAILQ_HEAD(, SABFSCacheEntry) sabfs_cache_lru =
+    QTAILQ_HEAD_INITIALIZER(sabfs_cache_lru);
+static uint64_t sabfs_cache_used;
+
+static void __attribute__((__constructor__)) sabfs_cache_init(void)
+{
+    qemu_mutex_init(&sabfs_cache_lock);
+    sabfs_cache_table = g_hash_table_new(g_int64_hash, g_int64_equal);
+}
+
+/* Called with sabfs_cache_lock held */
+static void sabfs_cache_drop(SABFSCacheEntry *e)
+{
+    g_hash_table_remove(sabfs_cache_table, &e->ino);
+    QTAILQ_REMOVE(&sabfs_cache_lru, e, lru);
+    sabfs_cache_used -= e->size;
+    g_free(e->blocks);
+    g_free(e->mapped);
+    g_free(e);
+}
+
+/*
+ * Returns the entry of the current version of a regular file, making room
+ * for it in the budget if it is new. Called with sabfs_cache_lock held.
+ */
+static SABFSCacheEntry *sabfs_cache_get(uint64_t ino)
+{
+    SABFSCacheEntry *e = g_hash_table_lookup(sabfs_cache_table, &ino);
+    uint32_t generation;
+    sabfs_stat_t st;
+
+    if (e) {
+        if (e->generation == sabfs_generation_ino(ino)) {
+            QTAILQ_REMOVE(&sabfs_cache_lru, e, lru);
+            QTAILQ_INSERT_HEAD(&sabfs_cache_lru, e, lru);
+            return e;
+        }
+        sabfs_cache_drop(e);
+    }
+
+    if (sabfs_stat_ino(ino, &st) < 0) {
+        return NULL;
+    }
+    /*
+     * Writers bump the generation after changing the size, so the size read
+     * after it is at least as new and a later change makes the entry stale.
+     */
+    generation = sabfs_generation_ino(ino);
+    if (sabfs_stat_ino(ino, &st) < 0 || !st.is_file || !st.size ||
+        st.size > SABFS_CACHE_MAX_FILE) {
+        return NULL;
+    }
+    while (sabfs_cache_used + st.size > SABFS_CACHE_BUDGET) {
+        sabfs_cache_drop(QTAILQ_LAST(&sabfs_cache_lru));
+    }
+
+    e = g_new0(SABFSCacheEntry, 1);
+    e->ino = ino;
+    e->generation = generation;
+    e->size = st.size;
+    e->nblocks = DIV_ROUND_UP(st.size, SABFS_BLOCK_SIZE);
+    e->blocks = g_new(const uint8_t *, e->nblocks);
+    e->mapped = bitmap_new(e->nblocks);
+    g_hash_table_insert(sabfs_cache_table, &e->ino, e);
+    QTAILQ_INSERT_HEAD(&sabfs_cache_lru, e, lru);
+    sabfs_cache_used += e->size;
+    return e;
+}
+
+static const uint8_t *sabfs_cache_block(SABFSCacheEntry *e, uint64_t idx)
+{
+    if (!test_bit(idx, e->mapped)) {
+        e->blocks[idx] = sabfs_map_block(e->ino, idx);
+        set_bit(idx, e->mapped);
+    }
+    return e->blocks[idx];
+}
+
+/* Blocks that follow each other in the SABFS memory are copied at once */
+static size_t sabfs_cache_copy(SABFSCacheEntry *e, uint8_t *buf, size_t count,
+                               uint64_t off)
+{
+    size_t done = 0;
+
+    if (off >= e->size) {
+        return 0;
+    }
+    count = MIN(count, e->size - off);
+    while (done < count) {
+        uint64_t pos = off + done;
+        uint64_t idx = pos / SABFS_BLOCK_SIZE;
+        size_t boff = pos % SABFS_BLOCK_SIZE;
+        size_t len = MIN(count - done, SABFS_BLOCK_SIZE - boff);
+        const uint8_t *run = sabfs_cache_block(e, idx);
+
+        if (!run) {
+            memset(buf + done, 0, len);
+            done += len;
+            continue;
+        }
+        while (done + len < count &&
+               sabfs_cache_block(e, ++idx) == run + boff + len) {
+            len += MIN(count - done - len, SABFS_BLOCK_SIZE);
+        }
+        memcpy(buf + done, run + boff, len);
+        done += len;
+    }
+    return done;
+}
+
+ssize_t sabfs_cache_preadv(uint64_t ino, const struct iovec *iov, int iovcnt,
+                           uint64_t offset)
+{
+    SABFSCacheEntry *e;
+    size_t total = 0;
+
+    qemu_mutex_lock(&sabfs_cache_lock);
+    e = sabfs_cache_get(ino);
+    if (!e) {
+        qemu_mutex_unlock(&sabfs_cache_lock);
+        return -1;
+    }
+    for (int i = 0; i < iovcnt; i++) {
+        size_t n = sabfs_cache_copy(e, iov[i].iov_base, iov[i].iov_len,
+                                    offset + total);
+
+        total += n;
+        if (n < iov[i].iov_len) {
+            break;
+        }
+    }
+    /*
+     * The file changed while copying, which races like pread(2) does, but
+     * blocks mapped meanwhile may belong to the old version: start over.
+     */
+    if (sabfs_generation_ino(ino) != e->generation) {
+        sabfs_cache_drop(e);
+    }
+    qemu_mutex_unlock(&sabfs_cache_lock);
+    return total;
+}
+
+int sabfs_cache_preload(uint64_t ino)
+{
+    SABFSCacheEntry *e;
+
+    qemu_mutex_lock(&sabfs_cache_lock);
+    e = sabfs_cache_get(ino);
+    if (e) {
+        for (uint64_t idx = 0; idx < e->nblocks; idx++) {
+            sabfs_cache_block(e, idx);
+        }
+    }
+    qemu_mutex_unlock(&sabfs_cache_lock);
+    return e ? 0 : -1;
+}
@@ -0,0 +1,42 @@
+/*
+ * SABFS read cache for the 9p backend
+ *
+ * Keeps the block maps of recently read files, so that a read is one
+ * memcpy per run of contiguous blocks straight out of the SABFS memory,
+ * without walking the indirect blocks or checking the block states again.
+ * Entries are keyed by (inode, generation), so writers and truncation in
+ * C or sabfs.js make them stale without any call into the cache, and the
+ * data itself is never copied: the memory budget only bounds the file
+ * bytes the maps cover, the maps cost a pointer per 4 KiB block.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef SABFS_CACHE_H
+#define SABFS_CACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/* Bytes of files whose block maps are kept, least recently used go first */
+#define SABFS_CACHE_BUDGET (256 * 1024 * 1024)
+
+/*
+ * Reads from a regular file at offset into iov through the cache.
+ * Returns the bytes read, 0 at the end of the file, or -1 if the inode
+ * can't be cached (not a regular file, empty, or too large for the
+ * budget) for the caller to read it uncached.
+ */
+ssize_t sabfs_cache_preadv(uint64_t ino, const struct iovec *iov, int iovcnt,
+                           uint64_t offset);
+
+/*
+ * Maps all blocks of a regular file, fetching the ones still pending, for
+ * files about to be read in full such as executables at execve.
+ * Returns 0 on success, -1 if the inode can't be cached.
+ */
+int sabfs_cache_preload(uint64_t ino);
+
+#endif /* SABFS_CACHE_H */
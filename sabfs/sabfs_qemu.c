@@ -1,282 +1,1770 @@
 /*
  * SABFS - SharedArrayBuffer Filesystem for QEMU-wasm
  *
- * C implementation using EM_JS to call JavaScript SABFS module.
- * All operations run directly in the worker thread without proxying.
+ * Native implementation of the SABFS layout (see sabfs.js) on a region of
+ * the wasm linear memory. The memory is a SharedArrayBuffer visible to all
+ * threads, so every operation is a plain memory access from the calling
+ * thread and never crosses into JS. sabfs.js attaches to the same region
+ * with SABFS.attach(HEAPU8.buffer, base, size) to import and export files.
+ *
+ * Blocks, inodes, fds and open files are allocated with atomics like
+ * sabfs.js does, and the fd table lives in the region too, so an fd can be
+ * used from any thread or worker. Every inode has a reader/writer lock in
+ * the region, shared with sabfs.js: writers of a file and inserts into a
+ * directory hold it exclusively, readers of its data or entries shared,
+ * so threads and workers working on different files never wait for each
+ * other.
  */
 
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/host-utils.h"
+#include "qemu/memalign.h"
 #include "sabfs_qemu.h"
 #include <emscripten.h>
-#include <stdlib.h>
-#include <string.h>
-
-/* Check if SABFS is available */
-EM_JS(int, sabfs_js_is_available, (void), {
-    return (typeof SABFS !== 'undefined' && SABFS.getBuffer() !== null) ? 1 : 0;
-});
-
-/* Initialize SABFS */
-EM_JS(int, sabfs_js_init, (size_t size), {
-    try {
-        if (typeof SABFS === 'undefined') {
-            console.error('SABFS module not loaded');
-            return -1;
+#include <emscripten/threading.h>
+#include <math.h>
+
+#define SABFS_MAGIC          0x53414246 /* "SABF" */
+#define SABFS_VERSION        9
+#define SABFS_INODE_SIZE     256
+#define SABFS_INLINE_MAX     184 /* data bytes that fit in the inode */
+#define SABFS_INODE_INLINE   1   /* flags: the data is in the inode */
+#define SABFS_LOCK_WRITER    0x80000000u
+#define SABFS_LOCK_WAITING   0x40000000u /* someone sleeps on the lock */
+#define SABFS_DIRENT_SIZE    32
+#define SABFS_DIRENTS_PER_BLOCK (SABFS_BLOCK_SIZE / SABFS_DIRENT_SIZE)
+#define SABFS_DIRECT_BLOCKS  8
+#define SABFS_PTRS_PER_BLOCK (SABFS_BLOCK_SIZE / 4)
+#define SABFS_NAME_MAX       255
+#define SABFS_DIRENT_NAME    24 /* name bytes in the first slot of an entry */
+#define SABFS_INDEX_ENTRY_SIZE 16
+#define SABFS_END_OF_LIST    0xffffffff
+#define SABFS_S_IFMT         0170000
+#define SABFS_MAX_DEPTH      64
+#define SABFS_FILE_SIZE      32
+#define SABFS_MIN_FILES      1024
+#define SABFS_FD_FIRST       3 /* 0, 1 and 2 are left to stdio like sabfs.js */
+#define SABFS_MAX_GROUPS     64
+#define SABFS_MIN_GROUP_BLOCKS 1024
+#define SABFS_BLOCK_PRESENT  0
+#define SABFS_BLOCK_MISSING  1
+#define SABFS_BLOCK_REQUESTED 2
+#define SABFS_RING_SLOTS     (SABFS_BLOCK_SIZE / 4 - 2)
+
+typedef struct SABFSSuper {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t total_blocks;
+    uint32_t inode_count;
+    uint32_t free_block;   /* unused, see group_free */
+    uint32_t free_inode;   /* where the next inode search starts */
+    uint32_t root_inode;
+    uint32_t index_block;  /* first block of the dentry index, 0 if none */
+    uint32_t index_slots;  /* a power of two */
+    uint32_t generation;   /* bumped on every namespace change */
+    uint32_t fd_table;     /* first block of the fd table */
+    uint32_t fd_slots;     /* number of fds, and of open files */
+    uint32_t file_table;   /* first block of the open file table */
+    uint32_t group_count;  /* allocation groups */
+    uint32_t group_blocks; /* data blocks per allocation group */
+    uint32_t group_next;   /* picks the home group of the next thread */
+    uint32_t inode_bitmap; /* first block of the inode bitmap, 1 = in use */
+    uint32_t block_state;  /* first block of the block state words */
+    uint32_t fetch_ring;   /* block of the fetch request ring */
+    uint32_t dirty_map;    /* first block of the dirty bitmap, 1 = changed */
+    uint32_t block_refs;   /* first block of the block reference counts */
+    uint32_t sync_request; /* bumped by sabfs_sync() to ask for a flush */
+    uint32_t sync_done;    /* last sync_request flushed to OPFS */
+    uint32_t persisting;   /* 1 while SABFS.persist() writes back */
+    uint32_t reserved[7];
+    uint32_t group_free[SABFS_MAX_GROUPS]; /* free list head per group */
+} SABFSSuper;
+
+typedef struct SABFSInode {
+    uint32_t mode;
+    uint32_t size_lo;
+    uint32_t size_hi;
+    uint32_t blocks;
+    uint32_t direct[SABFS_DIRECT_BLOCKS];
+    uint32_t indirect;     /* single indirect block */
+    uint32_t generation;   /* bumped after every change of the data */
+    uint32_t dindirect;    /* double indirect block */
+    uint32_t tindirect;    /* triple indirect block */
+    uint32_t flags;
+    uint32_t lock;         /* readers, SABFS_LOCK_WRITER and _WAITING */
+    uint8_t data[SABFS_INLINE_MAX]; /* the data, with SABFS_INODE_INLINE */
+} SABFSInode;
+
+/*
+ * Names longer than SABFS_DIRENT_NAME run on into the following slots of
+ * the same block. Entries are packed at the start of each block, so the
+ * first free slot ends the scan of a block.
+ */
+typedef struct SABFSDirent {
+    uint32_t ino;          /* 0 for a free slot, the root is never linked */
+    uint16_t name_len;
+    uint16_t type;
+    char name[SABFS_DIRENT_NAME];
+} SABFSDirent;
+
+/*
+ * The dentry index is an open addressing hash table of all links, shared
+ * by every thread and sabfs.js. It has twice as many slots as there are
+ * inodes and every inode but the root is linked once, so it never fills.
+ * A slot is claimed by setting hash and becomes visible once ino is set.
+ */
+typedef struct SABFSIndexEntry {
+    uint32_t hash;         /* 0 for a free slot */
+    uint32_t parent;
+    uint32_t dirent;       /* block * SABFS_DIRENTS_PER_BLOCK + slot */
+    uint32_t ino;
+} SABFSIndexEntry;
+
+QEMU_BUILD_BUG_ON(offsetof(SABFSSuper, group_free) != 128);
+QEMU_BUILD_BUG_ON(sizeof(SABFSInode) != SABFS_INODE_SIZE);
+QEMU_BUILD_BUG_ON(sizeof(SABFSDirent) != SABFS_DIRENT_SIZE);
+QEMU_BUILD_BUG_ON(sizeof(SABFSIndexEntry) != SABFS_INDEX_ENTRY_SIZE);
+
+/*
+ * An fd slot holds the index of its open file plus one, 0 if the fd is
+ * closed. Fds made by dup share the open file and with it the position.
+ * refcnt counts the fds of an open file and the calls using it right now,
+ * the open file is free again once it drops to 0.
+ */
+typedef struct SABFSFile {
+    uint32_t refcnt;
+    uint32_t ino;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t pos;
+    uint64_t reserved2;
+} SABFSFile;
+
+QEMU_BUILD_BUG_ON(sizeof(SABFSFile) != SABFS_FILE_SIZE);
+
+static bool sabfs_ready;
+static uint8_t *sabfs_base;
+static size_t sabfs_size;
+static SABFSInode *sabfs_inodes;
+static uint8_t *sabfs_data;
+static __thread int sabfs_home_group = -1;
+
+static inline SABFSSuper *sabfs_super(void)
+{
+    return (SABFSSuper *)sabfs_base;
+}
+
+static inline SABFSInode *sabfs_inode(uint32_t ino)
+{
+    return &sabfs_inodes[ino];
+}
+
+static inline uint8_t *sabfs_block(uint32_t blk)
+{
+    return sabfs_data + (size_t)blk * SABFS_BLOCK_SIZE;
+}
+
+/* The size is changed with the inode locked for writing, read with it held */
+static inline uint64_t sabfs_inode_size(SABFSInode *inode)
+{
+    return inode->size_lo | ((uint64_t)inode->size_hi << 32);
+}
+
+static inline void sabfs_inode_set_size(SABFSInode *inode, uint64_t size)
+{
+    inode->size_lo = size;
+    inode->size_hi = size >> 32;
+}
+
+/*
+ * Called after the data, size or blocks of an inode changed, or it was
+ * freed, so that caches of its blocks (sabfs_cache.c) see it. Those copy
+ * without the lock and only catch up on the next read, like pread.
+ */
+static inline void sabfs_inode_changed(SABFSInode *inode)
+{
+    qatomic_inc(&inode->generation);
+}
+
+static inline bool sabfs_is_dir(SABFSInode *inode)
+{
+    return (inode->mode & SABFS_S_IFMT) == SABFS_S_IFDIR;
+}
+
+/*
+ * The lock of an inode is a word of the region, so that sabfs.js takes
+ * the same one. Readers count in the low bits, a writer sets
+ * SABFS_LOCK_WRITER, and whoever has to wait sets SABFS_LOCK_WAITING
+ * first and sleeps on the word until the holder that sees it wakes all.
+ * Inodes are never locked in pairs, except a directory while allocating
+ * an inode, so there is no lock order to keep.
+ */
+static void sabfs_lock_wait(uint32_t *lock, uint32_t v)
+{
+    if ((v & SABFS_LOCK_WAITING) ||
+        qatomic_cmpxchg(lock, v, v | SABFS_LOCK_WAITING) == v) {
+        emscripten_futex_wait(lock, v | SABFS_LOCK_WAITING, INFINITY);
+    }
+}
+
+static void sabfs_rdlock(SABFSInode *inode)
+{
+    for (;;) {
+        uint32_t v = qatomic_read(&inode->lock);
+
+        if (v & SABFS_LOCK_WRITER) {
+            sabfs_lock_wait(&inode->lock, v);
+        } else if (qatomic_cmpxchg(&inode->lock, v, v + 1) == v) {
+            return;
+        }
+    }
+}
+
+static void sabfs_rdunlock(SABFSInode *inode)
+{
+    uint32_t v = qatomic_fetch_dec(&inode->lock) - 1;
+
+    /* the last reader wakes the waiters, unless new readers came in */
+    if (v == SABFS_LOCK_WAITING &&
+        qatomic_cmpxchg(&inode->lock, v, 0) == v) {
+        emscripten_futex_wake(&inode->lock, INT_MAX);
+    }
+}
+
+static void sabfs_wrlock(SABFSInode *inode)
+{
+    for (;;) {
+        uint32_t v = qatomic_read(&inode->lock);
+
+        if (v & ~SABFS_LOCK_WAITING) {
+            sabfs_lock_wait(&inode->lock, v);
+        } else if (qatomic_cmpxchg(&inode->lock, v,
+                                   v | SABFS_LOCK_WRITER) == v) {
+            return;
+        }
+    }
+}
+
+static void sabfs_wrunlock(SABFSInode *inode)
+{
+    if (qatomic_xchg(&inode->lock, 0) & SABFS_LOCK_WAITING) {
+        emscripten_futex_wake(&inode->lock, INT_MAX);
+    }
+}
+
+/*
+ * Small regular files keep their data in the inode until they outgrow it,
+ * so reading one costs a single copy and no block. Bytes of data past the
+ * size are zero. Readers without the lock (sabfs_map_block) load the flag
+ * with acquire semantics, see sabfs_spill_inline().
+ */
+static inline bool sabfs_is_inline(SABFSInode *inode)
+{
+    return qatomic_load_acquire(&inode->flags) & SABFS_INODE_INLINE;
+}
+
+/* Slots taken by an entry with a name of len bytes */
+static inline int sabfs_dirent_slots(size_t len)
+{
+    return DIV_ROUND_UP(offsetof(SABFSDirent, name) + len, SABFS_DIRENT_SIZE);
+}
+
+static inline char *sabfs_dirent_name(SABFSDirent *ent)
+{
+    return (char *)ent + offsetof(SABFSDirent, name);
+}
+
+static inline SABFSIndexEntry *sabfs_index(void)
+{
+    return (SABFSIndexEntry *)sabfs_block(sabfs_super()->index_block);
+}
+
+static inline uint32_t *sabfs_fds(void)
+{
+    return (uint32_t *)sabfs_block(sabfs_super()->fd_table);
+}
+
+static inline SABFSFile *sabfs_files(void)
+{
+    return (SABFSFile *)sabfs_block(sabfs_super()->file_table);
+}
+
+static void sabfs_setup_regions(void)
+{
+    uint32_t inode_count = sabfs_super()->inode_count;
+    size_t table_blocks = DIV_ROUND_UP((size_t)inode_count * SABFS_INODE_SIZE,
+                                       SABFS_BLOCK_SIZE);
+
+    sabfs_inodes = (SABFSInode *)(sabfs_base + SABFS_BLOCK_SIZE);
+    sabfs_data = sabfs_base + SABFS_BLOCK_SIZE + table_blocks * SABFS_BLOCK_SIZE;
+}
+
+static inline uint32_t *sabfs_inode_bitmap(void)
+{
+    return (uint32_t *)sabfs_block(sabfs_super()->inode_bitmap);
+}
+
+/* Owners of a block beyond the first, for blocks shared by clones */
+static inline uint32_t *sabfs_block_refs(uint32_t blk)
+{
+    return (uint32_t *)sabfs_block(sabfs_super()->block_refs) + blk;
+}
+
+static inline uint32_t *sabfs_block_state(uint32_t blk)
+{
+    return (uint32_t *)sabfs_block(sabfs_super()->block_state) + blk;
+}
+
+/*
+ * Every block changed is marked in the dirty bitmap, for the persistence
+ * worker of sabfs.js (SABFS.persist) to write it back to OPFS. The inode
+ * table and the tables before the bitmap are written back as a whole
+ * after any block was, the unused block 0 is marked for changes to them.
+ */
+static void sabfs_mark_dirty(uint32_t blk)
+{
+    uint32_t *map = (uint32_t *)sabfs_block(sabfs_super()->dirty_map);
+
+    qatomic_or(&map[blk / 32], 1u << (blk % 32));
+}
+
+/* Marks the block holding a pointer into the filesystem, or the tables */
+static void sabfs_mark_dirty_ptr(void *ptr)
+{
+    if ((uint8_t *)ptr >= sabfs_data) {
+        sabfs_mark_dirty(((uint8_t *)ptr - sabfs_data) / SABFS_BLOCK_SIZE);
+    } else {
+        sabfs_mark_dirty(0);
+    }
+}
+
+/*
+ * Files mounted on demand by sabfs.js (SABFS.mountLazy) start out with
+ * their blocks missing. The first reader of one queues it on the fetch
+ * ring and everybody waits on its state word until the fetching worker on
+ * the JS side has filled the block from HTTP and woken them up.
+ */
+static void sabfs_ensure_block(uint32_t blk)
+{
+    uint32_t *state = sabfs_block_state(blk);
+    uint32_t s = qatomic_load_acquire(state);
+
+    if (s == SABFS_BLOCK_PRESENT) {
+        return;
+    }
+    if (s == SABFS_BLOCK_MISSING &&
+        qatomic_cmpxchg(state, SABFS_BLOCK_MISSING,
+                        SABFS_BLOCK_REQUESTED) == SABFS_BLOCK_MISSING) {
+        uint32_t *ring = (uint32_t *)sabfs_block(sabfs_super()->fetch_ring);
+        uint32_t n = qatomic_fetch_inc(&ring[0]);
+
+        qatomic_set(&ring[2 + n % SABFS_RING_SLOTS], blk);
+        emscripten_futex_wake(&ring[0], INT_MAX);
+    }
+    while ((s = qatomic_load_acquire(state)) != SABFS_BLOCK_PRESENT) {
+        emscripten_futex_wait(state, s, INFINITY);
+    }
+}
+
+/*
+ * The data blocks are split into allocation groups, each with a free list
+ * of its own. A thread allocates from its home group, picked round robin on
+ * first use so that concurrent writers don't fight over one list head and
+ * each file stays mostly contiguous, and moves on when the group is full.
+ */
+static uint32_t sabfs_pop_block(uint32_t group)
+{
+    uint32_t *head = &sabfs_super()->group_free[group];
+    uint32_t blk, next;
+
+    do {
+        blk = qatomic_read(head);
+        if (blk == SABFS_END_OF_LIST) {
+            return 0;
+        }
+        next = *(uint32_t *)sabfs_block(blk);
+    } while (qatomic_cmpxchg(head, blk, next) != blk);
+    return blk;
+}
+
+/*
+ * Returns 0 if the filesystem is full, block 0 is never handed out. The
+ * block is only cleared with zero set, callers overwriting it all don't.
+ */
+static uint32_t sabfs_alloc_block(bool zero)
+{
+    SABFSSuper *sb = sabfs_super();
+    uint32_t blk = 0;
+    uint32_t group;
+
+    if (sabfs_home_group < 0) {
+        sabfs_home_group = qatomic_fetch_inc(&sb->group_next) % sb->group_count;
+    }
+    for (uint32_t i = 0; i < sb->group_count; i++) {
+        group = (sabfs_home_group + i) % sb->group_count;
+        blk = sabfs_pop_block(group);
+        if (blk) {
+            break;
+        }
+    }
+    if (!blk) {
+        return 0;
+    }
+    sabfs_home_group = group;
+    if (zero) {
+        memset(sabfs_block(blk), 0, SABFS_BLOCK_SIZE);
+    }
+    sabfs_mark_dirty(blk);
+    return blk;
+}
+
+static void sabfs_free_block(uint32_t blk)
+{
+    SABFSSuper *sb = sabfs_super();
+    uint32_t *head = &sb->group_free[blk / sb->group_blocks];
+    uint32_t old;
+
+    qatomic_set(sabfs_block_state(blk), SABFS_BLOCK_PRESENT);
+    do {
+        old = qatomic_read(head);
+        *(uint32_t *)sabfs_block(blk) = old;
+    } while (qatomic_cmpxchg(head, old, blk) != old);
+    sabfs_mark_dirty(blk);
+}
+
+/*
+ * Inodes are taken from a bitmap so that freed ones are reused. The bits
+ * past inode_count and the root's are set when formatting.
+ */
+static int64_t sabfs_alloc_inode(void)
+{
+    SABFSSuper *sb = sabfs_super();
+    uint32_t *map = sabfs_inode_bitmap();
+    uint32_t words = DIV_ROUND_UP(sb->inode_count, 32);
+    uint32_t start = qatomic_read(&sb->free_inode) / 32;
+    SABFSInode *inode;
+    uint32_t generation;
+
+    for (uint32_t n = 0; n < words; n++) {
+        uint32_t w = (start + n) % words;
+        uint32_t bits = qatomic_read(&map[w]);
+
+        while (~bits) {
+            uint32_t bit = 1u << ctz32(~bits);
+            uint32_t ino;
+
+            bits = qatomic_fetch_or(&map[w], bit);
+            if (bits & bit) {
+                continue;
+            }
+            ino = w * 32 + ctz32(bit);
+            qatomic_set(&sb->free_inode, ino + 1);
+            inode = sabfs_inode(ino);
+            /* the generation carries on, so a reused inode is a new one */
+            generation = qatomic_read(&inode->generation);
+            memset(inode, 0, sizeof(SABFSInode));
+            qatomic_set(&inode->generation, generation + 1);
+            return ino;
+        }
+    }
+    return -1;
+}
+
+static void sabfs_free_inode(uint32_t ino)
+{
+    SABFSSuper *sb = sabfs_super();
+
+    sabfs_inode_changed(sabfs_inode(ino));
+    qatomic_and(&sabfs_inode_bitmap()[ino / 32], ~(1u << (ino % 32)));
+    qatomic_set(&sb->free_inode, ino);
+}
+
+/*
+ * Drops a reference to a block and the levels of indirect blocks below
+ * it. Blocks shared by clones (see SABFS.clone in sabfs.js) only lose a
+ * reference, the last owner frees them. Blocks are pushed onto the free
+ * list from the end of the file backwards, so that rewriting the file
+ * pops them in their original order and keeps the runs of contiguous
+ * blocks that reads coalesce.
+ */
+static void sabfs_put_tree(uint32_t blk, int levels)
+{
+    uint32_t *refs = sabfs_block_refs(blk);
+    uint32_t r;
+
+    while ((r = qatomic_read(refs))) {
+        if (qatomic_cmpxchg(refs, r, r - 1) == r) {
+            return;
+        }
+    }
+    if (levels) {
+        uint32_t *ptrs = (uint32_t *)sabfs_block(blk);
+
+        for (int i = SABFS_PTRS_PER_BLOCK - 1; i >= 0; i--) {
+            if (ptrs[i]) {
+                sabfs_put_tree(ptrs[i], levels - 1);
+            }
+        }
+    }
+    sabfs_free_block(blk);
+}
+
+/*
+ * Gives a writer its own copy of the block *slot points to if it is
+ * shared. The pointers of a copied indirect block take a reference to
+ * what they point to before the original is put. Returns the block to
+ * write to, 0 if the filesystem is full.
+ */
+static uint32_t sabfs_unshare(uint32_t *slot, int levels)
+{
+    uint32_t blk = *slot;
+    uint32_t copy;
+
+    if (!qatomic_read(sabfs_block_refs(blk))) {
+        return blk;
+    }
+    copy = sabfs_alloc_block(false);
+    if (!copy) {
+        return 0;
+    }
+    sabfs_ensure_block(blk);
+    memcpy(sabfs_block(copy), sabfs_block(blk), SABFS_BLOCK_SIZE);
+    if (levels) {
+        uint32_t *ptrs = (uint32_t *)sabfs_block(copy);
+
+        for (int i = 0; i < SABFS_PTRS_PER_BLOCK; i++) {
+            if (ptrs[i]) {
+                qatomic_inc(sabfs_block_refs(ptrs[i]));
+            }
+        }
+    }
+    sabfs_put_tree(blk, levels);
+    *slot = copy;
+    sabfs_mark_dirty_ptr(slot);
+    return copy;
+}
+
+/*
+ * Walks the block tree of a file to the slot holding the pointer to data
+ * block idx. Past the direct blocks come one single, one double and one
+ * triple indirect tree, like ext2. Missing indirect blocks are allocated
+ * and shared ones copied if alloc is set, for writing, otherwise NULL is
+ * returned for missing ones.
+ */
+static uint32_t *sabfs_block_slot(SABFSInode *inode, uint64_t idx, bool alloc)
+{
+    const uint64_t ptrs = SABFS_PTRS_PER_BLOCK;
+    uint32_t *slot;
+    int levels;
+
+    if (idx < SABFS_DIRECT_BLOCKS) {
+        return &inode->direct[idx];
+    }
+    idx -= SABFS_DIRECT_BLOCKS;
+    if (idx < ptrs) {
+        slot = &inode->indirect;
+        levels = 1;
+    } else if (idx - ptrs < ptrs * ptrs) {
+        idx -= ptrs;
+        slot = &inode->dindirect;
+        levels = 2;
+    } else if (idx - ptrs - ptrs * ptrs < ptrs * ptrs * ptrs) {
+        idx -= ptrs + ptrs * ptrs;
+        slot = &inode->tindirect;
+        levels = 3;
+    } else {
+        return NULL;
+    }
+
+    for (int l = levels - 1; l >= 0; l--) {
+        uint64_t shift = l * ctz32(SABFS_PTRS_PER_BLOCK);
+
+        if (!*slot) {
+            if (!alloc) {
+                return NULL;
+            }
+            *slot = sabfs_alloc_block(true);
+            if (!*slot) {
+                return NULL;
+            }
+            sabfs_mark_dirty_ptr(slot);
+        } else if (alloc && !sabfs_unshare(slot, l + 1)) {
+            return NULL;
         }
-        SABFS.init(size);
+        slot = (uint32_t *)sabfs_block(*slot) + ((idx >> shift) & (ptrs - 1));
+    }
+    return slot;
+}
+
+/* Maps a block index within a file to its data block, 0 for a hole */
+static uint32_t sabfs_get_block(SABFSInode *inode, uint64_t idx)
+{
+    uint32_t *slot = sabfs_block_slot(inode, idx, false);
+
+    return slot ? *slot : 0;
+}
+
+static uint32_t sabfs_alloc_file_block(SABFSInode *inode, uint64_t idx,
+                                       bool zero)
+{
+    uint32_t *slot = sabfs_block_slot(inode, idx, true);
+    uint32_t blk;
+
+    if (!slot) {
         return 0;
-    } catch (e) {
-        console.error('SABFS init failed:', e);
+    }
+    blk = sabfs_alloc_block(zero);
+    if (!blk) {
+        return 0;
+    }
+    *slot = blk;
+    sabfs_mark_dirty_ptr(slot);
+    inode->blocks++;
+    return blk;
+}
+
+static void sabfs_truncate_inode(SABFSInode *inode)
+{
+    uint32_t *trees[] = { &inode->tindirect, &inode->dindirect,
+                          &inode->indirect };
+
+    for (int i = 0; i < ARRAY_SIZE(trees); i++) {
+        if (*trees[i]) {
+            sabfs_put_tree(*trees[i], ARRAY_SIZE(trees) - i);
+            *trees[i] = 0;
+        }
+    }
+    for (int i = SABFS_DIRECT_BLOCKS - 1; i >= 0; i--) {
+        if (inode->direct[i]) {
+            sabfs_put_tree(inode->direct[i], 0);
+            inode->direct[i] = 0;
+        }
+    }
+    inode->blocks = 0;
+    qatomic_store_release(&inode->flags, inode->flags & ~SABFS_INODE_INLINE);
+    sabfs_inode_set_size(inode, 0);
+    sabfs_inode_changed(inode);
+}
+
+/*
+ * Moves the data of an inline file to block 0, before it grows past
+ * SABFS_INLINE_MAX. The data stays in the inode for readers that saw the
+ * flag still set. Called with the inode locked for writing, returns -1 if
+ * the filesystem is full.
+ */
+static int sabfs_spill_inline(SABFSInode *inode)
+{
+    uint32_t blk = sabfs_alloc_file_block(inode, 0, true);
+
+    if (!blk) {
         return -1;
     }
-});
+    memcpy(sabfs_block(blk), inode->data, sabfs_inode_size(inode));
+    qatomic_store_release(&inode->flags, inode->flags & ~SABFS_INODE_INLINE);
+    sabfs_mark_dirty_ptr(inode);
+    return 0;
+}
+
+/* FNV-1a over the name and then the parent, matches sabfs.js' nameHash */
+static uint32_t sabfs_name_hash(uint32_t parent, const char *name, size_t len)
+{
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)name[i]) * 16777619u;
+    }
+    h = (h ^ parent) * 16777619u;
+    return h ? h : 1;
+}
+
+static int64_t sabfs_index_lookup(uint32_t parent, const char *name,
+                                  size_t len)
+{
+    SABFSIndexEntry *index = sabfs_index();
+    uint32_t mask = sabfs_super()->index_slots - 1;
+    uint32_t hash = sabfs_name_hash(parent, name, len);
 
-/* Attach to existing SABFS */
-EM_JS(int, sabfs_js_attach, (void), {
-    try {
-        if (typeof SABFS === 'undefined') {
+    for (uint32_t i = hash & mask, n = 0; n <= mask; i = (i + 1) & mask, n++) {
+        uint32_t h = qatomic_read(&index[i].hash);
+        uint32_t ino, loc;
+        SABFSDirent *ent;
+
+        if (!h) {
             return -1;
         }
-        // SAB should be passed via Module.sabfsBuffer
-        if (Module.sabfsBuffer) {
-            SABFS.attach(Module.sabfsBuffer);
-            return 0;
+        ino = qatomic_load_acquire(&index[i].ino);
+        if (h != hash || !ino || index[i].parent != parent) {
+            continue;
+        }
+        loc = index[i].dirent;
+        ent = (SABFSDirent *)sabfs_block(loc / SABFS_DIRENTS_PER_BLOCK) +
+              loc % SABFS_DIRENTS_PER_BLOCK;
+        if (ent->name_len == len && !memcmp(sabfs_dirent_name(ent), name, len)) {
+            return ino;
+        }
+    }
+    return -1;
+}
+
+static void sabfs_index_add(uint32_t parent, const char *name, size_t len,
+                            uint32_t loc, uint32_t ino)
+{
+    SABFSIndexEntry *index = sabfs_index();
+    uint32_t mask = sabfs_super()->index_slots - 1;
+    uint32_t hash = sabfs_name_hash(parent, name, len);
+
+    for (uint32_t i = hash & mask, n = 0; n <= mask; i = (i + 1) & mask, n++) {
+        if (qatomic_cmpxchg(&index[i].hash, 0, hash) == 0) {
+            index[i].parent = parent;
+            index[i].dirent = loc;
+            qatomic_store_release(&index[i].ino, ino);
+            return;
+        }
+    }
+}
+
+static int64_t sabfs_lookup(uint32_t dir_ino, const char *name, size_t len)
+{
+    SABFSInode *dir = sabfs_inode(dir_ino);
+    uint64_t nblocks;
+
+    if (!sabfs_is_dir(dir) || len > SABFS_NAME_MAX) {
+        return -1;
+    }
+    if (sabfs_super()->index_block) {
+        return sabfs_index_lookup(dir_ino, name, len);
+    }
+
+    /* images from before the index are scanned */
+    nblocks = DIV_ROUND_UP(sabfs_inode_size(dir), SABFS_BLOCK_SIZE);
+    for (uint64_t b = 0; b < nblocks; b++) {
+        uint32_t blk = sabfs_get_block(dir, b);
+        SABFSDirent *ents;
+
+        if (!blk) {
+            continue;
+        }
+        ents = (SABFSDirent *)sabfs_block(blk);
+        for (int i = 0; i < SABFS_DIRENTS_PER_BLOCK;
+             i += sabfs_dirent_slots(ents[i].name_len)) {
+            uint32_t ino = qatomic_load_acquire(&ents[i].ino);
+
+            if (!ino) {
+                break;
+            }
+            if (ents[i].name_len == len &&
+                !memcmp(sabfs_dirent_name(&ents[i]), name, len)) {
+                return ino;
+            }
+        }
+    }
+    return -1;
+}
+
+/* Called with the directory locked for writing */
+static int sabfs_add_dirent(uint32_t dir_ino, const char *name, size_t len,
+                            uint32_t ino, uint16_t type)
+{
+    SABFSInode *dir = sabfs_inode(dir_ino);
+    int slots = sabfs_dirent_slots(len);
+    uint64_t nblocks;
+
+    if (!sabfs_is_dir(dir) || len > SABFS_NAME_MAX) {
+        return -1;
+    }
+    nblocks = DIV_ROUND_UP(sabfs_inode_size(dir), SABFS_BLOCK_SIZE);
+    /* the slot after the last block is reached with a fresh block */
+    for (uint64_t b = 0; b <= nblocks; b++) {
+        uint32_t blk = sabfs_get_block(dir, b);
+        SABFSDirent *ents;
+        uint64_t end;
+        int i = 0;
+
+        if (!blk) {
+            blk = sabfs_alloc_file_block(dir, b, true);
+            if (!blk) {
+                return -1;
+            }
+        }
+        ents = (SABFSDirent *)sabfs_block(blk);
+        while (i < SABFS_DIRENTS_PER_BLOCK && ents[i].ino) {
+            i += sabfs_dirent_slots(ents[i].name_len);
+        }
+        if (i + slots > SABFS_DIRENTS_PER_BLOCK) {
+            continue;
+        }
+        ents[i].name_len = len;
+        ents[i].type = type;
+        memcpy(sabfs_dirent_name(&ents[i]), name, len);
+        /* publish the name before the slot becomes visible to lookups */
+        qatomic_store_release(&ents[i].ino, ino);
+        sabfs_mark_dirty(blk);
+
+        end = b * SABFS_BLOCK_SIZE + (i + slots) * SABFS_DIRENT_SIZE;
+        if (end > sabfs_inode_size(dir)) {
+            sabfs_inode_set_size(dir, end);
+        }
+        if (sabfs_super()->index_block) {
+            /* block numbers stay below 2^25 in a 4 GiB wasm memory */
+            sabfs_index_add(dir_ino, name, len,
+                            blk * SABFS_DIRENTS_PER_BLOCK + i, ino);
+        }
+        qatomic_inc(&sabfs_super()->generation);
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * Resolves the first len bytes of path. "." and ".." are handled on the
+ * components like sabfs.js' normalizePath, ".." at the root stays there.
+ */
+/*
+ * Resolves path from the directory dir, or from the root if it is absolute.
+ * ".." can't climb above dir as directories don't record their parent.
+ */
+static int64_t sabfs_resolve_len(uint32_t dir, const char *path, size_t len)
+{
+    uint32_t root = sabfs_super()->root_inode;
+    uint32_t stack[SABFS_MAX_DEPTH];
+    int depth = 0;
+    size_t i = 0;
+
+    stack[0] = len && path[0] == '/' ? root : dir;
+    while (i < len) {
+        size_t start, n;
+        int64_t ino;
+
+        while (i < len && path[i] == '/') {
+            i++;
+        }
+        start = i;
+        while (i < len && path[i] != '/') {
+            i++;
+        }
+        n = i - start;
+        if (n == 0 || (n == 1 && path[start] == '.')) {
+            continue;
         }
+        if (n == 2 && path[start] == '.' && path[start + 1] == '.') {
+            if (depth == 0 && stack[0] != root) {
+                return -1;
+            }
+            depth -= depth > 0;
+            continue;
+        }
+        ino = sabfs_lookup(stack[depth], path + start, n);
+        if (ino < 0 || depth == SABFS_MAX_DEPTH - 1) {
+            return -1;
+        }
+        stack[++depth] = ino;
+    }
+    return stack[depth];
+}
+
+static int64_t sabfs_resolve(const char *path)
+{
+    return sabfs_resolve_len(sabfs_super()->root_inode, path, strlen(path));
+}
+
+/* Splits off the last component of path and resolves its parent */
+static int64_t sabfs_resolve_parent(uint32_t dir, const char *path,
+                                    const char **name, size_t *len)
+{
+    size_t end = strlen(path);
+    size_t start;
+
+    while (end > 0 && path[end - 1] == '/') {
+        end--;
+    }
+    start = end;
+    while (start > 0 && path[start - 1] != '/') {
+        start--;
+    }
+    if (start == end) {
         return -1;
-    } catch (e) {
-        console.error('SABFS attach failed:', e);
+    }
+    *name = path + start;
+    *len = end - start;
+    return sabfs_resolve_len(dir, path, start);
+}
+
+/*
+ * Creates path with mode. The parent is locked for writing meanwhile, so
+ * that of two threads creating the same name one finds the other's; it
+ * gets that inode, or -1 if excl.
+ */
+static int64_t sabfs_create(uint32_t dir, const char *path, uint32_t mode,
+                            bool excl)
+{
+    const char *name;
+    size_t len;
+    int64_t parent = sabfs_resolve_parent(dir, path, &name, &len);
+    SABFSInode *pinode;
+    int64_t ino;
+
+    if (parent < 0 || len > SABFS_NAME_MAX) {
         return -1;
     }
-});
+    pinode = sabfs_inode(parent);
+    sabfs_wrlock(pinode);
+    ino = sabfs_lookup(parent, name, len);
+    if (ino >= 0) {
+        ino = excl ? -1 : ino;
+        goto out;
+    }
+    ino = sabfs_alloc_inode();
+    if (ino < 0) {
+        goto out;
+    }
+    sabfs_inode(ino)->mode = mode;
+    if (sabfs_add_dirent(parent, name, len, ino, (mode & SABFS_S_IFMT) >> 12) < 0) {
+        sabfs_free_inode(ino);
+        ino = -1;
+    }
+out:
+    sabfs_wrunlock(pinode);
+    return ino;
+}
+
+static void sabfs_file_put(SABFSFile *file)
+{
+    qatomic_dec(&file->refcnt);
+}
+
+/* Takes a reference to the open file of fd, NULL if fd is not open */
+static SABFSFile *sabfs_file_get(int fd)
+{
+    uint32_t *fds = sabfs_fds();
+    int64_t idx = (int64_t)fd - SABFS_FD_FIRST;
+    uint32_t slot, ref;
+    SABFSFile *file;
+
+    if (idx < 0 || idx >= sabfs_super()->fd_slots) {
+        return NULL;
+    }
+    slot = qatomic_load_acquire(&fds[idx]);
+    if (!slot) {
+        return NULL;
+    }
+    file = &sabfs_files()[slot - 1];
+    do {
+        ref = qatomic_read(&file->refcnt);
+        if (!ref) {
+            return NULL;
+        }
+    } while (qatomic_cmpxchg(&file->refcnt, ref, ref + 1) != ref);
+
+    /* fd may have been closed and the open file reused in the meantime */
+    if (qatomic_load_acquire(&fds[idx]) != slot) {
+        sabfs_file_put(file);
+        return NULL;
+    }
+    return file;
+}
 
-/* Import file */
-EM_JS(int, sabfs_js_import_file, (const char *path, const void *data, size_t size), {
-    try {
-        const pathStr = UTF8ToString(path);
-        const dataArray = new Uint8Array(HEAPU8.buffer, data, size);
-        // Make a copy since SABFS stores the data
-        const dataCopy = new Uint8Array(size);
-        dataCopy.set(dataArray);
-        return SABFS.importFile(pathStr, dataCopy) ? 0 : -1;
-    } catch (e) {
-        console.error('SABFS import failed:', e);
+/* Returns the index of a new open file with one reference, or -1 */
+static int64_t sabfs_file_alloc(uint32_t ino, int flags)
+{
+    SABFSFile *files = sabfs_files();
+    uint32_t n = sabfs_super()->fd_slots;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (qatomic_cmpxchg(&files[i].refcnt, 0, 1) == 0) {
+            files[i].ino = ino;
+            files[i].flags = flags;
+            qatomic_set_u64(&files[i].pos, 0);
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Points the lowest free fd at an open file, handing over a reference.
+ * Returns the fd, or -1 with the reference left to the caller.
+ */
+static int sabfs_fd_install(uint32_t file_idx)
+{
+    uint32_t *fds = sabfs_fds();
+    uint32_t n = sabfs_super()->fd_slots;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (qatomic_cmpxchg(&fds[i], 0, file_idx + 1) == 0) {
+            return i + SABFS_FD_FIRST;
+        }
+    }
+    return -1;
+}
+
+static ssize_t sabfs_read_inode(SABFSInode *inode, uint8_t *buf, size_t count,
+                                uint64_t off)
+{
+    uint64_t size = sabfs_inode_size(inode);
+    size_t done = 0;
+
+    if (sabfs_is_dir(inode)) {
         return -1;
     }
-});
+    if (off >= size) {
+        return 0;
+    }
+    count = MIN(count, size - off);
+    if (sabfs_is_inline(inode)) {
+        memcpy(buf, inode->data + off, count);
+        return count;
+    }
+    while (done < count) {
+        uint64_t pos = off + done;
+        size_t boff = pos % SABFS_BLOCK_SIZE;
+        size_t chunk = MIN(count - done, SABFS_BLOCK_SIZE - boff);
+        uint32_t blk = sabfs_get_block(inode, pos / SABFS_BLOCK_SIZE);
 
-/* Stat */
-EM_JS(int, sabfs_js_stat, (const char *path, uint64_t *ino, uint32_t *mode,
-                           uint64_t *size, uint32_t *blocks, int *is_dir, int *is_file), {
-    try {
-        const pathStr = UTF8ToString(path);
-        const st = SABFS.stat(pathStr);
-        if (!st) return -1;
+        if (blk) {
+            sabfs_ensure_block(blk);
+            memcpy(buf + done, sabfs_block(blk) + boff, chunk);
+        } else {
+            memset(buf + done, 0, chunk);
+        }
+        done += chunk;
+    }
+    return done;
+}
 
-        // Write results to pointers
-        // Use setValue for 64-bit values
-        setValue(ino, st.ino, 'i64');
-        HEAPU32[mode >> 2] = st.mode;
-        setValue(size, st.size, 'i64');
-        HEAPU32[blocks >> 2] = st.blocks;
-        HEAP32[is_dir >> 2] = st.isDirectory ? 1 : 0;
-        HEAP32[is_file >> 2] = st.isFile ? 1 : 0;
+/* Called with the inode locked for writing */
+static ssize_t sabfs_write_inode(SABFSInode *inode, const uint8_t *buf,
+                                 size_t count, uint64_t off)
+{
+    uint64_t size = sabfs_inode_size(inode);
+    size_t done = 0;
 
+    if (sabfs_is_dir(inode)) {
+        return -1;
+    }
+    if (count && MAX(size, off + count) <= SABFS_INLINE_MAX &&
+        (sabfs_is_inline(inode) || !inode->blocks)) {
+        if (!sabfs_is_inline(inode)) {
+            /* empty, or a hole, so far */
+            memset(inode->data, 0, sizeof(inode->data));
+            qatomic_store_release(&inode->flags,
+                                  inode->flags | SABFS_INODE_INLINE);
+        }
+        memcpy(inode->data + off, buf, count);
+        sabfs_inode_set_size(inode, MAX(size, off + count));
+        sabfs_mark_dirty_ptr(inode);
+        sabfs_inode_changed(inode);
+        return count;
+    }
+    if (count && sabfs_is_inline(inode) && sabfs_spill_inline(inode) < 0) {
+        return -1;
+    }
+    while (done < count) {
+        uint64_t pos = off + done;
+        size_t boff = pos % SABFS_BLOCK_SIZE;
+        size_t chunk = MIN(count - done, SABFS_BLOCK_SIZE - boff);
+        uint64_t idx = pos / SABFS_BLOCK_SIZE;
+        uint32_t *slot = sabfs_block_slot(inode, idx, true);
+        uint32_t blk;
+
+        if (!slot) {
+            break;
+        }
+        if (!*slot) {
+            /* a block written in full needs no clearing */
+            blk = sabfs_alloc_file_block(inode, idx,
+                                         chunk < SABFS_BLOCK_SIZE);
+        } else {
+            blk = sabfs_unshare(slot, 0);
+            if (blk) {
+                sabfs_ensure_block(blk);
+            }
+        }
+        if (!blk) {
+            break;
+        }
+        memcpy(sabfs_block(blk) + boff, buf + done, chunk);
+        sabfs_mark_dirty(blk);
+        done += chunk;
+    }
+    if (off + done > sabfs_inode_size(inode)) {
+        sabfs_inode_set_size(inode, off + done);
+    }
+    if (done) {
+        sabfs_inode_changed(inode);
+    }
+    return done ? done : (count ? -1 : 0);
+}
+
+/*
+ * Makes a range read as zeroes: whole blocks are put like on truncation,
+ * partial ones overwritten. The size stays. Called with the inode locked
+ * for writing.
+ */
+static int sabfs_punch_inode(SABFSInode *inode, uint64_t off, uint64_t len)
+{
+    static const uint8_t zeroes[SABFS_BLOCK_SIZE];
+    uint64_t end = MIN(off + len, sabfs_inode_size(inode));
+    int ret = 0;
+
+    if (sabfs_is_dir(inode)) {
+        return -1;
+    }
+    if (sabfs_is_inline(inode)) {
+        end = MIN(end, SABFS_INLINE_MAX);
+        if (off < end) {
+            memset(inode->data + off, 0, end - off);
+            sabfs_mark_dirty_ptr(inode);
+        }
+        sabfs_inode_changed(inode);
         return 0;
-    } catch (e) {
-        console.error('SABFS stat failed:', e);
+    }
+    while (off < end) {
+        uint64_t idx = off / SABFS_BLOCK_SIZE;
+        size_t boff = off % SABFS_BLOCK_SIZE;
+        size_t chunk = MIN(end - off, SABFS_BLOCK_SIZE - boff);
+
+        if (!sabfs_get_block(inode, idx)) {
+            /* a hole already */
+        } else if (chunk == SABFS_BLOCK_SIZE) {
+            /* unshares the indirect blocks above it */
+            uint32_t *slot = sabfs_block_slot(inode, idx, true);
+
+            if (!slot) {
+                ret = -1;
+                break;
+            }
+            sabfs_put_tree(*slot, 0);
+            *slot = 0;
+            sabfs_mark_dirty_ptr(slot);
+            inode->blocks--;
+        } else if (sabfs_write_inode(inode, zeroes, chunk, off) < 0) {
+            ret = -1;
+            break;
+        }
+        off += chunk;
+    }
+    sabfs_inode_changed(inode);
+    return ret;
+}
+
+static void sabfs_fill_stat(uint32_t ino, sabfs_stat_t *st)
+{
+    SABFSInode *inode = sabfs_inode(ino);
+
+    sabfs_rdlock(inode);
+    st->ino = ino;
+    st->mode = inode->mode;
+    st->size = sabfs_inode_size(inode);
+    st->blocks = inode->blocks;
+    st->is_directory = sabfs_is_dir(inode);
+    st->is_file = (inode->mode & SABFS_S_IFMT) == SABFS_S_IFREG;
+    sabfs_rdunlock(inode);
+}
+
+EMSCRIPTEN_KEEPALIVE int sabfs_init(size_t size_bytes)
+{
+    SABFSSuper *sb;
+    uint32_t total_blocks = size_bytes / SABFS_BLOCK_SIZE;
+    uint32_t inode_count = MIN(total_blocks / 4, 65536);
+    uint32_t table_blocks = DIV_ROUND_UP(inode_count * SABFS_INODE_SIZE,
+                                         SABFS_BLOCK_SIZE);
+    uint32_t index_slots = pow2ceil(2 * MAX(inode_count, 1));
+    uint32_t index_blocks = DIV_ROUND_UP(index_slots * SABFS_INDEX_ENTRY_SIZE,
+                                         SABFS_BLOCK_SIZE);
+    uint32_t fd_slots = MAX(inode_count, SABFS_MIN_FILES);
+    uint32_t fd_blocks = DIV_ROUND_UP(fd_slots * 4, SABFS_BLOCK_SIZE);
+    uint32_t file_blocks = DIV_ROUND_UP(fd_slots * SABFS_FILE_SIZE,
+                                        SABFS_BLOCK_SIZE);
+    uint32_t bitmap_words = DIV_ROUND_UP(inode_count, 32);
+    uint32_t bitmap_blocks = DIV_ROUND_UP(bitmap_words * 4, SABFS_BLOCK_SIZE);
+    uint32_t state_blocks = DIV_ROUND_UP(total_blocks * 4, SABFS_BLOCK_SIZE);
+    uint32_t dirty_blocks = DIV_ROUND_UP(DIV_ROUND_UP(total_blocks, 32) * 4,
+                                         SABFS_BLOCK_SIZE);
+    uint32_t reserved_blocks = 1 + index_blocks + fd_blocks + file_blocks +
+                               bitmap_blocks + 2 * state_blocks + 1 +
+                               dirty_blocks;
+    uint32_t data_blocks, group_count, group_blocks;
+    uint32_t *bitmap;
+
+    if (sabfs_base || total_blocks < table_blocks + reserved_blocks + 3) {
         return -1;
     }
-});
+    sabfs_size = (size_t)total_blocks * SABFS_BLOCK_SIZE;
+    sabfs_base = qemu_try_memalign(SABFS_BLOCK_SIZE, sabfs_size);
+    if (!sabfs_base) {
+        return -1;
+    }
+    data_blocks = total_blocks - 1 - table_blocks;
+
+    memset(sabfs_base, 0, SABFS_BLOCK_SIZE);
+    sb = sabfs_super();
+    sb->magic = SABFS_MAGIC;
+    sb->version = SABFS_VERSION;
+    sb->block_size = SABFS_BLOCK_SIZE;
+    sb->total_blocks = total_blocks;
+    sb->inode_count = inode_count;
+    /*
+     * Block 0 is the "no block" sentinel, the dentry index, fd table, open
+     * file table, inode bitmap, block references, block states, fetch ring
+     * and dirty bitmap follow it.
+     */
+    sb->free_inode = 1;
+    sb->root_inode = 0;
+    sb->index_block = 1;
+    sb->index_slots = index_slots;
+    sb->generation = 0;
+    sb->fd_table = 1 + index_blocks;
+    sb->fd_slots = fd_slots;
+    sb->file_table = 1 + index_blocks + fd_blocks;
+    sb->inode_bitmap = 1 + index_blocks + fd_blocks + file_blocks;
+    sb->block_refs = sb->inode_bitmap + bitmap_blocks;
+    sb->block_state = sb->block_refs + state_blocks;
+    sb->fetch_ring = sb->block_state + state_blocks;
+    sb->dirty_map = sb->fetch_ring + 1;
+    sabfs_setup_regions();
+
+    memset(sabfs_block(1), 0, (size_t)(reserved_blocks - 1) * SABFS_BLOCK_SIZE);
+    bitmap = sabfs_inode_bitmap();
+    bitmap[0] = 1; /* the root */
+    if (inode_count % 32) {
+        bitmap[bitmap_words - 1] |= ~0u << (inode_count % 32);
+    }
+
+    group_count = MIN(SABFS_MAX_GROUPS,
+                      MAX(data_blocks / SABFS_MIN_GROUP_BLOCKS, 1));
+    group_blocks = DIV_ROUND_UP(data_blocks, group_count);
+    sb->free_block = SABFS_END_OF_LIST;
+    sb->group_count = group_count;
+    sb->group_blocks = group_blocks;
+    sb->group_next = 0;
+    for (uint32_t g = 0; g < group_count; g++) {
+        uint32_t start = MAX(g * group_blocks, reserved_blocks);
+        uint32_t end = MIN((g + 1) * group_blocks, data_blocks);
+
+        sb->group_free[g] = start < end ? start : SABFS_END_OF_LIST;
+        for (uint32_t i = start; i < end; i++) {
+            *(uint32_t *)sabfs_block(i) = i + 1 < end ? i + 1 : SABFS_END_OF_LIST;
+        }
+    }
+
+    memset(sabfs_inode(0), 0, sizeof(SABFSInode));
+    sabfs_inode(0)->mode = SABFS_S_IFDIR | 0755;
+
+    qatomic_store_release(&sabfs_ready, true);
+    return 0;
+}
+
+int sabfs_attach(void)
+{
+    /* The region is in the shared wasm memory, every thread already sees it */
+    return sabfs_is_available() ? 0 : -1;
+}
+
+EMSCRIPTEN_KEEPALIVE uintptr_t sabfs_region_base(void)
+{
+    return (uintptr_t)sabfs_base;
+}
 
-/* Open */
-EM_JS(int, sabfs_js_open, (const char *path, int flags, int mode), {
-    try {
-        const pathStr = UTF8ToString(path);
-        return SABFS.open(pathStr, flags, mode);
-    } catch (e) {
-        console.error('SABFS open failed:', e);
+EMSCRIPTEN_KEEPALIVE size_t sabfs_region_size(void)
+{
+    return sabfs_size;
+}
+
+int sabfs_import_file(const char *path, const void *data, size_t size)
+{
+    int fd = sabfs_open(path, SABFS_O_WRONLY | SABFS_O_CREAT | SABFS_O_TRUNC, 0644);
+    ssize_t written;
+
+    if (fd < 0) {
         return -1;
     }
-});
+    written = sabfs_write(fd, data, size);
+    sabfs_close(fd);
+    return written == (ssize_t)size ? 0 : -1;
+}
 
-/* Close */
-EM_JS(int, sabfs_js_close, (int fd), {
-    try {
-        return SABFS.close(fd);
-    } catch (e) {
+int sabfs_stat(const char *path, sabfs_stat_t *st)
+{
+    int64_t ino;
+
+    if (!sabfs_is_available()) {
+        return -1;
+    }
+    ino = sabfs_resolve(path);
+    if (ino < 0) {
         return -1;
     }
-});
+    sabfs_fill_stat(ino, st);
+    return 0;
+}
+
+int sabfs_fstat(int fd, sabfs_stat_t *st)
+{
+    SABFSFile *file;
 
-/* Read */
-EM_JS(ssize_t, sabfs_js_read, (int fd, void *buf, size_t count), {
-    try {
-        const buffer = new Uint8Array(HEAPU8.buffer, buf, count);
-        return SABFS.read(fd, buffer, count);
-    } catch (e) {
-        console.error('SABFS read failed:', e);
+    if (!sabfs_is_available()) {
+        return -1;
+    }
+    file = sabfs_file_get(fd);
+    if (!file) {
         return -1;
     }
-});
+    sabfs_fill_stat(file->ino, st);
+    sabfs_file_put(file);
+    return 0;
+}
+
+/*
+ * Opens path relative to the directory dir. Directories can only be opened
+ * for reading, which gives an fd for fstat and the directory position.
+ */
+static int sabfs_open_at(uint32_t dir, const char *path, int flags, int mode)
+{
+    int64_t ino, idx;
+    int fd = -1;
 
-/* Write */
-EM_JS(ssize_t, sabfs_js_write, (int fd, const void *buf, size_t count), {
-    try {
-        const buffer = new Uint8Array(HEAPU8.buffer, buf, count);
-        return SABFS.write(fd, buffer, count);
-    } catch (e) {
-        console.error('SABFS write failed:', e);
+    ino = sabfs_resolve_len(dir, path, strlen(path));
+    if (ino < 0 && (flags & SABFS_O_CREAT)) {
+        ino = sabfs_create(dir, path, SABFS_S_IFREG | (mode & 07777), false);
+    }
+    if (ino < 0 || (sabfs_is_dir(sabfs_inode(ino)) &&
+                    (flags & (SABFS_O_WRONLY | SABFS_O_RDWR |
+                              SABFS_O_CREAT | SABFS_O_TRUNC)))) {
         return -1;
     }
-});
+    idx = sabfs_file_alloc(ino, flags);
+    if (idx < 0) {
+        return -1;
+    }
+    if (flags & SABFS_O_TRUNC) {
+        SABFSInode *inode = sabfs_inode(ino);
 
-/* Pread */
-EM_JS(ssize_t, sabfs_js_pread, (int fd, void *buf, size_t count, double offset), {
-    try {
-        const buffer = new Uint8Array(HEAPU8.buffer, buf, count);
-        return SABFS.pread(fd, buffer, count, offset);
-    } catch (e) {
-        console.error('SABFS pread failed:', e);
+        sabfs_wrlock(inode);
+        sabfs_truncate_inode(inode);
+        sabfs_wrunlock(inode);
+    }
+    fd = sabfs_fd_install(idx);
+    if (fd < 0) {
+        sabfs_file_put(&sabfs_files()[idx]);
+    }
+    return fd;
+}
+
+int sabfs_open(const char *path, int flags, int mode)
+{
+    if (!sabfs_is_available()) {
         return -1;
     }
-});
+    return sabfs_open_at(sabfs_super()->root_inode, path, flags, mode);
+}
+
+int sabfs_openat(int dirfd, const char *path, int flags, int mode)
+{
+    SABFSFile *dir;
+    int fd = -1;
 
-/* Pwrite */
-EM_JS(ssize_t, sabfs_js_pwrite, (int fd, const void *buf, size_t count, double offset), {
-    try {
-        const buffer = new Uint8Array(HEAPU8.buffer, buf, count);
-        return SABFS.pwrite(fd, buffer, count, offset);
-    } catch (e) {
-        console.error('SABFS pwrite failed:', e);
+    if (!sabfs_is_available()) {
         return -1;
     }
-});
+    dir = sabfs_file_get(dirfd);
+    if (!dir) {
+        return -1;
+    }
+    if (sabfs_is_dir(sabfs_inode(dir->ino))) {
+        fd = sabfs_open_at(dir->ino, path, flags, mode);
+    }
+    sabfs_file_put(dir);
+    return fd;
+}
 
-/* Lseek - use double for offset to handle 64-bit values */
-EM_JS(double, sabfs_js_lseek, (int fd, double offset, int whence), {
-    try {
-        return SABFS.lseek(fd, offset, whence);
-    } catch (e) {
+int sabfs_close(int fd)
+{
+    int64_t idx = (int64_t)fd - SABFS_FD_FIRST;
+    uint32_t slot;
+
+    if (!sabfs_is_available() || idx < 0 || idx >= sabfs_super()->fd_slots) {
+        return -1;
+    }
+    slot = qatomic_xchg(&sabfs_fds()[idx], 0);
+    if (!slot) {
         return -1;
     }
-});
+    sabfs_file_put(&sabfs_files()[slot - 1]);
+    return 0;
+}
 
-/* Mkdir */
-EM_JS(int, sabfs_js_mkdir, (const char *path, int mode), {
-    try {
-        const pathStr = UTF8ToString(path);
-        return SABFS.mkdir(pathStr, mode);
-    } catch (e) {
-        console.error('SABFS mkdir failed:', e);
+int sabfs_dup(int fd)
+{
+    SABFSFile *file;
+    int newfd;
+
+    if (!sabfs_is_available()) {
         return -1;
     }
-});
+    file = sabfs_file_get(fd);
+    if (!file) {
+        return -1;
+    }
+    newfd = sabfs_fd_install(file - sabfs_files());
+    if (newfd < 0) {
+        sabfs_file_put(file);
+    }
+    return newfd;
+}
 
-/* Readdir - returns JSON string of entries */
-EM_JS(char*, sabfs_js_readdir, (const char *path), {
-    try {
-        const pathStr = UTF8ToString(path);
-        const entries = SABFS.readdir(pathStr);
-        if (!entries) return 0;
+int sabfs_dup2(int fd, int newfd)
+{
+    int64_t idx = (int64_t)newfd - SABFS_FD_FIRST;
+    SABFSFile *file;
+    uint32_t old;
 
-        const json = JSON.stringify(entries);
-        const len = lengthBytesUTF8(json) + 1;
-        const ptr = _malloc(len);
-        stringToUTF8(json, ptr, len);
-        return ptr;
-    } catch (e) {
-        console.error('SABFS readdir failed:', e);
-        return 0;
+    if (!sabfs_is_available() || idx < 0 || idx >= sabfs_super()->fd_slots) {
+        return -1;
+    }
+    file = sabfs_file_get(fd);
+    if (!file) {
+        return -1;
     }
-});
+    if (fd == newfd) {
+        sabfs_file_put(file);
+        return newfd;
+    }
+    /* the reference moves to newfd, whatever it pointed at loses one */
+    old = qatomic_xchg(&sabfs_fds()[idx], file - sabfs_files() + 1);
+    if (old) {
+        sabfs_file_put(&sabfs_files()[old - 1]);
+    }
+    return newfd;
+}
 
-/* C wrapper functions */
+ssize_t sabfs_read(int fd, void *buf, size_t count)
+{
+    SABFSFile *file;
+    SABFSInode *inode;
+    uint64_t pos;
+    ssize_t ret;
 
-int sabfs_init(size_t size_bytes) {
-    return sabfs_js_init(size_bytes);
+    if (!sabfs_is_available()) {
+        return -1;
+    }
+    file = sabfs_file_get(fd);
+    if (!file) {
+        return -1;
+    }
+    /* threads sharing the open file race on the position, like read(2) */
+    inode = sabfs_inode(file->ino);
+    sabfs_rdlock(inode);
+    pos = qatomic_read_u64(&file->pos);
+    ret = sabfs_read_inode(inode, buf, count, pos);
+    if (ret > 0) {
+        qatomic_set_u64(&file->pos, pos + ret);
+    }
+    sabfs_rdunlock(inode);
+    sabfs_file_put(file);
+    return ret;
 }
 
-int sabfs_attach(void) {
-    return sabfs_js_attach();
+ssize_t sabfs_write(int fd, const void *buf, size_t count)
+{
+    SABFSFile *file;
+    SABFSInode *inode;
+    uint64_t pos;
+    ssize_t ret;
+
+    if (!sabfs_is_available()) {
+        return -1;
+    }
+    file = sabfs_file_get(fd);
+    if (!file) {
+        return -1;
+    }
+    inode = sabfs_inode(file->ino);
+    sabfs_wrlock(inode);
+    pos = file->flags & SABFS_O_APPEND ? sabfs_inode_size(inode)
+                                       : qatomic_read_u64(&file->pos);
+    ret = sabfs_write_inode(inode, buf, count, pos);
+    if (ret > 0) {
+        qatomic_set_u64(&file->pos, pos + ret);
+    }
+    sabfs_wrunlock(inode);
+    sabfs_file_put(file);
+    return ret;
 }
 
-int sabfs_import_file(const char *path, const void *data, size_t size) {
-    return sabfs_js_import_file(path, data, size);
+ssize_t sabfs_pread(int fd, void *buf, size_t count, off_t offset)
+{
+    SABFSFile *file;
+    SABFSInode *inode;
+    ssize_t ret;
+
+    if (!sabfs_is_available() || offset < 0) {
+        return -1;
+    }
+    file = sabfs_file_get(fd);
+    if (!file) {
+        return -1;
+    }
+    /* readers of a file copy in parallel, a writer waits for them */
+    inode = sabfs_inode(file->ino);
+    sabfs_rdlock(inode);
+    ret = sabfs_read_inode(inode, buf, count, offset);
+    sabfs_rdunlock(inode);
+    sabfs_file_put(file);
+    return ret;
 }
 
-int sabfs_stat(const char *path, sabfs_stat_t *st) {
-    uint64_t ino;
-    uint32_t mode;
-    uint64_t size;
-    uint32_t blocks;
-    int is_dir, is_file;
+ssize_t sabfs_pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+    SABFSFile *file;
+    SABFSInode *inode;
+    ssize_t ret;
 
-    int ret = sabfs_js_stat(path, &ino, &mode, &size, &blocks, &is_dir, &is_file);
-    if (ret == 0) {
-        st->ino = ino;
-        st->mode = mode;
-        st->size = size;
-        st->blocks = blocks;
-        st->is_directory = is_dir;
-        st->is_file = is_file;
+    if (!sabfs_is_available() || offset < 0) {
+        return -1;
     }
+    file = sabfs_file_get(fd);
+    if (!file) {
+        return -1;
+    }
+    inode = sabfs_inode(file->ino);
+    sabfs_wrlock(inode);
+    ret = sabfs_write_inode(inode, buf, count, offset);
+    sabfs_wrunlock(inode);
+    sabfs_file_put(file);
     return ret;
 }
 
-int sabfs_open(const char *path, int flags, int mode) {
-    return sabfs_js_open(path, flags, mode);
+int sabfs_punch(int fd, off_t offset, off_t len)
+{
+    SABFSFile *file;
+    SABFSInode *inode;
+    int ret;
+
+    if (!sabfs_is_available() || offset < 0 || len < 0) {
+        return -1;
+    }
+    file = sabfs_file_get(fd);
+    if (!file) {
+        return -1;
+    }
+    inode = sabfs_inode(file->ino);
+    sabfs_wrlock(inode);
+    ret = sabfs_punch_inode(inode, offset, len);
+    sabfs_wrunlock(inode);
+    sabfs_file_put(file);
+    return ret;
 }
 
-int sabfs_close(int fd) {
-    return sabfs_js_close(fd);
+int sabfs_ftruncate(int fd, off_t size)
+{
+    SABFSFile *file;
+    SABFSInode *inode;
+    uint64_t old, end;
+    int ret = 0;
+
+    if (!sabfs_is_available() || size < 0) {
+        return -1;
+    }
+    file = sabfs_file_get(fd);
+    if (!file) {
+        return -1;
+    }
+    inode = sabfs_inode(file->ino);
+    sabfs_wrlock(inode);
+    old = sabfs_inode_size(inode);
+    if (sabfs_is_dir(inode)) {
+        ret = -1;
+    } else if (size < old) {
+        /* up to the end of the last block, so that it is put as well */
+        end = sabfs_is_inline(inode) ? old : ROUND_UP(old, SABFS_BLOCK_SIZE);
+        sabfs_inode_set_size(inode, end);
+        ret = sabfs_punch_inode(inode, size, end - size);
+        sabfs_inode_set_size(inode, size);
+    } else if (size > old) {
+        if (size > SABFS_INLINE_MAX && sabfs_is_inline(inode)) {
+            ret = sabfs_spill_inline(inode);
+        }
+        if (!ret) {
+            sabfs_inode_set_size(inode, size);
+            sabfs_mark_dirty_ptr(inode);
+            sabfs_inode_changed(inode);
+        }
+    }
+    sabfs_wrunlock(inode);
+    sabfs_file_put(file);
+    return ret;
 }
 
-ssize_t sabfs_read(int fd, void *buf, size_t count) {
-    return sabfs_js_read(fd, buf, count);
+/*
+ * SABFS.persist() runs in a worker of its own and writes the changed
+ * blocks back on a timer. A sync asks it for a flush right away and waits
+ * until one that started after the request is done.
+ */
+int sabfs_sync(void)
+{
+    SABFSSuper *sb;
+    uint32_t req, done;
+
+    if (!sabfs_is_available()) {
+        return -1;
+    }
+    sb = sabfs_super();
+    if (!qatomic_read(&sb->persisting)) {
+        return 0;
+    }
+    req = qatomic_fetch_inc(&sb->sync_request) + 1;
+    emscripten_futex_wake(&sb->sync_request, INT_MAX);
+    while ((int32_t)((done = qatomic_load_acquire(&sb->sync_done)) - req) < 0) {
+        emscripten_futex_wait(&sb->sync_done, done, INFINITY);
+    }
+    return 0;
 }
 
-ssize_t sabfs_write(int fd, const void *buf, size_t count) {
-    return sabfs_js_write(fd, buf, count);
+off_t sabfs_lseek(int fd, off_t offset, int whence)
+{
+    SABFSFile *file;
+    off_t ret = -1;
+
+    if (!sabfs_is_available()) {
+        return -1;
+    }
+    file = sabfs_file_get(fd);
+    if (!file) {
+        return -1;
+    }
+    switch (whence) {
+    case SABFS_SEEK_SET:
+        ret = offset;
+        break;
+    case SABFS_SEEK_CUR:
+        ret = qatomic_read_u64(&file->pos) + offset;
+        break;
+    case SABFS_SEEK_END:
+        sabfs_rdlock(sabfs_inode(file->ino));
+        ret = sabfs_inode_size(sabfs_inode(file->ino)) + offset;
+        sabfs_rdunlock(sabfs_inode(file->ino));
+        break;
+    default:
+        goto out;
+    }
+    ret = MAX(ret, 0);
+    qatomic_set_u64(&file->pos, ret);
+out:
+    sabfs_file_put(file);
+    return ret;
 }
 
-ssize_t sabfs_pread(int fd, void *buf, size_t count, off_t offset) {
-    return sabfs_js_pread(fd, buf, count, (double)offset);
+int sabfs_mkdir(const char *path, int mode)
+{
+    int64_t ino;
+
+    if (!sabfs_is_available()) {
+        return -1;
+    }
+    ino = sabfs_create(sabfs_super()->root_inode, path,
+                       SABFS_S_IFDIR | (mode & 07777), true);
+    return ino < 0 ? -1 : 0;
 }
 
-ssize_t sabfs_pwrite(int fd, const void *buf, size_t count, off_t offset) {
-    return sabfs_js_pwrite(fd, buf, count, (double)offset);
+int sabfs_stat_ino(uint64_t ino, sabfs_stat_t *st)
+{
+    if (!sabfs_is_available() || ino >= sabfs_super()->inode_count ||
+        !sabfs_inode(ino)->mode) {
+        return -1;
+    }
+    sabfs_fill_stat(ino, st);
+    return 0;
 }
 
-off_t sabfs_lseek(int fd, off_t offset, int whence) {
-    double result = sabfs_js_lseek(fd, (double)offset, whence);
-    return (off_t)result;
+uint32_t sabfs_generation_ino(uint64_t ino)
+{
+    return qatomic_load_acquire(&sabfs_inode(ino)->generation);
 }
 
-int sabfs_mkdir(const char *path, int mode) {
-    return sabfs_js_mkdir(path, mode);
+const void *sabfs_map_block(uint64_t ino, uint64_t idx)
+{
+    SABFSInode *inode = sabfs_inode(ino);
+    uint32_t blk;
+
+    if (sabfs_is_inline(inode)) {
+        return idx ? NULL : inode->data;
+    }
+    blk = sabfs_get_block(inode, idx);
+    if (!blk) {
+        return NULL;
+    }
+    sabfs_ensure_block(blk);
+    return sabfs_block(blk);
 }
 
-int sabfs_readdir(const char *path, sabfs_dirent_t **entries) {
-    char *json = sabfs_js_readdir(path);
-    if (!json) {
-        *entries = NULL;
+int sabfs_readdir_ino(uint64_t ino, sabfs_dirent_t **entries)
+{
+    SABFSInode *dir;
+    uint64_t nblocks;
+    int n = 0, alloc = 0;
+
+    *entries = NULL;
+    if (!sabfs_is_available() || ino >= sabfs_super()->inode_count) {
+        return -1;
+    }
+    dir = sabfs_inode(ino);
+    if (!sabfs_is_dir(dir)) {
         return -1;
     }
+    sabfs_rdlock(dir);
+    nblocks = DIV_ROUND_UP(sabfs_inode_size(dir), SABFS_BLOCK_SIZE);
+    for (uint64_t b = 0; b < nblocks; b++) {
+        uint32_t blk = sabfs_get_block(dir, b);
+        SABFSDirent *ents;
+
+        if (!blk) {
+            continue;
+        }
+        ents = (SABFSDirent *)sabfs_block(blk);
+        for (int i = 0; i < SABFS_DIRENTS_PER_BLOCK;
+             i += sabfs_dirent_slots(ents[i].name_len)) {
+            if (!ents[i].ino) {
+                break;
+            }
+            if (n == alloc) {
+                alloc = alloc ? alloc * 2 : 16;
+                *entries = g_renew(sabfs_dirent_t, *entries, alloc);
+            }
+            memcpy((*entries)[n].name, sabfs_dirent_name(&ents[i]),
+                   ents[i].name_len);
+            (*entries)[n].name[ents[i].name_len] = '\0';
+            (*entries)[n].ino = ents[i].ino;
+            (*entries)[n].type = ents[i].type;
+            n++;
+        }
+    }
+    sabfs_rdunlock(dir);
+    return n;
+}
 
-    /* Parse JSON - simple parser for array of {name, ino, type} */
-    /* For now, just return the count and let caller parse */
-    /* TODO: implement proper JSON parsing or use different format */
+int sabfs_readdir(const char *path, sabfs_dirent_t **entries)
+{
+    int64_t ino;
 
     *entries = NULL;
-    free(json);
-    return 0;
+    if (!sabfs_is_available()) {
+        return -1;
+    }
+    ino = sabfs_resolve(path);
+    if (ino < 0) {
+        return -1;
+    }
+    return sabfs_readdir_ino(ino, entries);
 }
 
-void sabfs_free_dirents(sabfs_dirent_t *entries) {
-    if (entries) {
-        free(entries);
-    }
+void sabfs_free_dirents(sabfs_dirent_t *entries)
+{
+    g_free(entries);
 }
 
-int sabfs_is_available(void) {
-    return sabfs_js_is_available();
+int sabfs_is_available(void)
+{
+    return qatomic_load_acquire(&sabfs_ready);
 }
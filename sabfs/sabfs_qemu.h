@@ -2,8 +2,9 @@
  * SABFS - SharedArrayBuffer Filesystem for QEMU-wasm
  *
  * This header provides C functions to access SABFS from QEMU.
- * These functions bypass Emscripten's filesystem proxy by using
- * SharedArrayBuffer for direct memory access from worker threads.
+ * The filesystem lives in a region of the shared wasm memory, so these
+ * functions access it directly from any thread without Emscripten's
+ * filesystem proxy or calls into JS.
  */
 
 #ifndef SABFS_QEMU_H
@@ -11,11 +12,14 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/types.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define SABFS_BLOCK_SIZE 4096
+
 /* File types */
 #define SABFS_S_IFDIR  0040000
 #define SABFS_S_IFREG  0100000
@@ -51,18 +55,26 @@ typedef struct {
 } sabfs_dirent_t;
 
 /*
- * Initialize SABFS with given size
- * Must be called from main thread before workers start
+ * Initialize SABFS with given size, allocated from the wasm heap
+ * Exported so that the JS loader can call it before QEMU starts
  * Returns 0 on success, -1 on error
  */
 int sabfs_init(size_t size_bytes);
 
 /*
- * Attach to existing SABFS (for worker threads)
+ * Attach to existing SABFS
+ * All threads share the region, so this only checks that it exists
  * Returns 0 on success, -1 on error
  */
 int sabfs_attach(void);
 
+/*
+ * Address and size of the region in the wasm memory, for SABFS.attach()
+ * in JS. Return 0 before sabfs_init().
+ */
+uintptr_t sabfs_region_base(void);
+size_t sabfs_region_size(void);
+
 /*
  * Import a file from host buffer into SABFS
  * Returns 0 on success, -1 on error
@@ -76,17 +88,64 @@ int sabfs_import_file(const char *path, const void *data, size_t size);
 int sabfs_stat(const char *path, sabfs_stat_t *st);
 
 /*
- * open - open a file
+ * stat_ino - get status of an inode, e.g. the st.ino of an earlier stat
+ * Returns 0 on success, -1 on error
+ */
+int sabfs_stat_ino(uint64_t ino, sabfs_stat_t *st);
+
+/*
+ * generation_ino - counter of an inode, bumped after every change of its
+ * data or size and when it is freed or reused
+ * (inode, generation) names one version of a file, e.g. for caching it
+ */
+uint32_t sabfs_generation_ino(uint64_t ino);
+
+/*
+ * map_block - the data of block idx of an inode, in place in the SABFS
+ * memory and fetched first if that is still pending
+ * Returns NULL for a hole. Block 0 of a small file stored in its inode is
+ * only valid up to the size of the file. The block stays valid until the
+ * generation of the inode changes
+ */
+const void *sabfs_map_block(uint64_t ino, uint64_t idx);
+
+/*
+ * fstat - get status of an open file
+ * Returns 0 on success, -1 on error
+ */
+int sabfs_fstat(int fd, sabfs_stat_t *st);
+
+/*
+ * open - open a file, directories can be opened read-only
  * Returns file descriptor on success, -1 on error
  */
 int sabfs_open(const char *path, int flags, int mode);
 
+/*
+ * openat - open a file relative to the directory open on dirfd
+ * Absolute paths are resolved from the root like with open
+ * Returns file descriptor on success, -1 on error
+ */
+int sabfs_openat(int dirfd, const char *path, int flags, int mode);
+
 /*
  * close - close file descriptor
  * Returns 0 on success, -1 on error
  */
 int sabfs_close(int fd);
 
+/*
+ * dup - new fd sharing the open file (and position) of fd
+ * Returns the lowest free file descriptor, -1 on error
+ */
+int sabfs_dup(int fd);
+
+/*
+ * dup2 - make newfd share the open file of fd, closing newfd first
+ * Returns newfd on success, -1 on error
+ */
+int sabfs_dup2(int fd, int newfd);
+
 /*
  * read - read from file at current position
  * Returns bytes read, 0 on EOF, -1 on error
@@ -111,6 +170,28 @@ ssize_t sabfs_pread(int fd, void *buf, size_t count, off_t offset);
  */
 ssize_t sabfs_pwrite(int fd, const void *buf, size_t count, off_t offset);
 
+/*
+ * punch - make a range read as zeroes, giving its whole blocks back to the
+ * filesystem like fallocate(FALLOC_FL_PUNCH_HOLE); the size stays
+ * Returns 0 on success, -1 on error
+ */
+int sabfs_punch(int fd, off_t offset, off_t len);
+
+/*
+ * ftruncate - set the size of an open file; the blocks past a smaller size
+ * are given back, the bytes up to a larger one read as zeroes
+ * Returns 0 on success, -1 on error
+ */
+int sabfs_ftruncate(int fd, off_t size);
+
+/*
+ * sync - write the filesystem back to OPFS now and wait for it, if it is
+ * persisted (SABFS.persist() in sabfs.js); without persistence there is
+ * nothing to do
+ * Returns 0 on success, -1 on error
+ */
+int sabfs_sync(void);
+
 /*
  * lseek - reposition file offset
  * Returns new position, -1 on error
@@ -130,6 +211,13 @@ int sabfs_mkdir(const char *path, int mode);
  */
 int sabfs_readdir(const char *path, sabfs_dirent_t **entries);
 
+/*
+ * readdir_ino - read the entries of a directory inode, all in one call
+ * Returns number of entries read, -1 on error
+ * Caller must free entries with sabfs_free_dirents()
+ */
+int sabfs_readdir_ino(uint64_t ino, sabfs_dirent_t **entries);
+
 /*
  * Free directory entries
  */
@@ -0,0 +1,1085 @@
+/*
+ * Guest syscall offload to SABFS
+ *
+ * The handlers below implement the Linux file syscalls on SABFS for any
+ * guest architecture; the ABI tables at the end map each architecture's
+ * syscall numbers to them. They run on the vCPU thread at the syscall
+ * instruction, with the vCPU still in user mode, so guest memory is
+ * accessed with the user's permissions.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/thread.h"
+#include "qemu/stats64.h"
+#include "qemu/timer.h"
+#include "qemu/module.h"
+#include "qapi/qmp/qdict.h"
+#include "monitor/monitor.h"
+#include "sysemu/stats.h"
+#include "cpu.h"
+#include "exec/exec-all.h"
+#include "exec/cpu_ldst.h"
+#include "exec/memory.h"
+#include "hw/core/cpu.h"
+#include "sysemu/ram-cold.h"
+#include "sabfs/syscall_offload.h"
+
+#include <emscripten.h>
+
+/*
+ * Linux errno values, the same for all architectures handled here, and
+ * different from the host's (WASI) ones
+ */
+#define GUEST_ENOENT     2
+#define GUEST_EBADF      9
+#define GUEST_EEXIST    17
+#define GUEST_ENODEV    19
+#define GUEST_ENOTDIR   20
+#define GUEST_EISDIR    21
+#define GUEST_EINVAL    22
+#define GUEST_EMFILE    24
+
+/* Linux flags that are the same for all architectures handled here */
+#define GUEST_AT_FDCWD          -100
+#define GUEST_AT_EMPTY_PATH     0x1000
+#define GUEST_O_ACCMODE         0x3
+#define GUEST_O_EXCL            0x80
+#define GUEST_PROT_WRITE        0x2
+#define GUEST_MAP_TYPE          0xf
+#define GUEST_MAP_PRIVATE       0x2
+#define GUEST_MAP_ANONYMOUS     0x20
+#define GUEST_MAP_POPULATE      0x8000
+#define GUEST_DT_DIR            4
+
+/* Largest single read/write, the same cap the kernel applies */
+#define OFFLOAD_MAX_RW_COUNT    0x7ffff000
+
+#define OFFLOAD_PATH_MAX        512
+#define OFFLOAD_MAX_PREFIXES    8
+#define OFFLOAD_MAX_PENDING     8
+
+typedef struct OffloadPrefix {
+    char guest[OFFLOAD_PATH_MAX];
+    size_t guest_len;
+    char sabfs[OFFLOAD_PATH_MAX];
+} OffloadPrefix;
+
+typedef struct OffloadPrefixes {
+    int count;
+    OffloadPrefix prefix[OFFLOAD_MAX_PREFIXES];
+} OffloadPrefixes;
+
+static OffloadPrefixes offload_default_prefixes = {
+    .count = 1,
+    .prefix = { { "/mnt/wasi1/", 11, "/pack/" } },
+};
+
+static OffloadPrefixes *offload_prefixes = &offload_default_prefixes;
+
+/*
+ * An mmap() of an offloaded file, handed to the kernel as an anonymous
+ * mapping and filled from the file when the kernel returns it
+ */
+typedef struct OffloadPending {
+    bool used;
+    uint64_t asid, pc, sp;
+    uint64_t args[6];
+    int fd;
+    uint64_t offset;
+    uint64_t len;
+} OffloadPending;
+
+static QemuSpin offload_pending_lock;
+static OffloadPending offload_pending[OFFLOAD_MAX_PENDING];
+static unsigned offload_pending_next;
+int syscall_offload_pending;
+
+/* fds are unsigned int in the kernel, so only the low 32 bits count */
+static int offload_fd(uint64_t guest_fd)
+{
+    int fd = guest_fd;
+
+    return fd >= SYSCALL_OFFLOAD_FD_BASE ? fd - SYSCALL_OFFLOAD_FD_BASE : -1;
+}
+
+static int64_t offload_guest_fd(int fd)
+{
+    return fd < 0 ? -GUEST_EMFILE : fd + SYSCALL_OFFLOAD_FD_BASE;
+}
+
+/*
+ * Guest memory
+ *
+ * Buffers are probed page by page before a syscall changes anything, which
+ * raises any fault on the vCPU as if the syscall instruction itself had
+ * faulted. Once the kernel has mapped the page the syscall is restarted.
+ * Copies then go through the host address of runs of plain RAM pages, and
+ * byte accesses for the rest (MMIO, code pages tracked for dirtiness).
+ */
+
+static void offload_probe(CPUArchState *env, uint64_t addr, size_t len,
+                          MMUAccessType access)
+{
+    int mmu_idx = cpu_mmu_index(env, false);
+    uint64_t end = addr + len;
+
+    while (addr < end) {
+        probe_access(env, addr, 1, access, mmu_idx, 0);
+        addr = (addr | ~TARGET_PAGE_MASK) + 1;
+    }
+}
+
+/*
+ * Host address of the guest RAM behind [addr, addr + *len), or NULL if the
+ * page at addr isn't plain RAM. *len is trimmed to the run of following
+ * pages that are contiguous in host memory, or to the page if NULL.
+ */
+static void *offload_host_run(CPUArchState *env, uint64_t addr, size_t *len,
+                              MMUAccessType access)
+{
+    int mmu_idx = cpu_mmu_index(env, false);
+    uint8_t *host = tlb_vaddr_to_host(env, addr, access, mmu_idx);
+    size_t run = MIN(*len, -(addr | TARGET_PAGE_MASK));
+
+    if (host) {
+        while (run < *len &&
+               tlb_vaddr_to_host(env, addr + run, access, mmu_idx) ==
+               host + run) {
+            run += MIN(*len - run, TARGET_PAGE_SIZE);
+        }
+    }
+    *len = run;
+    return host;
+}
+
+static void offload_from_guest(CPUArchState *env, void *buf, uint64_t addr,
+                               size_t len)
+{
+    uint8_t *p = buf;
+
+    offload_probe(env, addr, len, MMU_DATA_LOAD);
+    while (len > 0) {
+        size_t run = len;
+        void *host = offload_host_run(env, addr, &run, MMU_DATA_LOAD);
+
+        if (host) {
+            memcpy(p, host, run);
+        } else {
+            for (size_t i = 0; i < run; i++) {
+                p[i] = cpu_ldub_data(env, addr + i);
+            }
+        }
+        addr += run;
+        p += run;
+        len -= run;
+    }
+}
+
+static void offload_to_guest(CPUArchState *env, uint64_t addr,
+                             const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+
+    offload_probe(env, addr, len, MMU_DATA_STORE);
+    while (len > 0) {
+        size_t run = len;
+        void *host = offload_host_run(env, addr, &run, MMU_DATA_STORE);
+
+        if (host) {
+            memcpy(host, p, run);
+        } else {
+            for (size_t i = 0; i < run; i++) {
+                cpu_stb_data(env, addr + i, p[i]);
+            }
+        }
+        addr += run;
+        p += run;
+        len -= run;
+    }
+}
+
+/* Reads a path, false if it doesn't fit in OFFLOAD_PATH_MAX */
+static bool offload_path(CPUArchState *env, uint64_t addr, char *path)
+{
+    for (int i = 0; i < OFFLOAD_PATH_MAX; i++) {
+        path[i] = cpu_ldub_data(env, addr + i);
+        if (!path[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Translates an absolute guest path below one of the prefixes */
+static bool offload_sabfs_path(const char *path, char *out)
+{
+    OffloadPrefixes *prefixes = qatomic_rcu_read(&offload_prefixes);
+
+    for (int i = 0; i < prefixes->count; i++) {
+        OffloadPrefix *prefix = &prefixes->prefix[i];
+
+        if (!strncmp(path, prefix->guest, prefix->guest_len)) {
+            return snprintf(out, OFFLOAD_PATH_MAX, "%s%s", prefix->sabfs,
+                            path + prefix->guest_len) < OFFLOAD_PATH_MAX;
+        }
+    }
+    return false;
+}
+
+/*
+ * Opens the guest's dirfd/path in SABFS. Returns the SABFS fd, -1 if it
+ * can't be found in SABFS, or SYSCALL_OFFLOAD_PASS if it isn't offloaded.
+ */
+static int64_t offload_openat(SyscallOffloadCall *call, uint64_t dirfd,
+                              uint64_t path_addr, int flags, int mode)
+{
+    char path[OFFLOAD_PATH_MAX], sabfs_path[OFFLOAD_PATH_MAX];
+    int dir = offload_fd(dirfd);
+
+    if (!offload_path(cpu_env(call->cpu), path_addr, path)) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    if (path[0] != '/' && dir >= 0) {
+        return sabfs_openat(dir, path, flags, mode);
+    }
+    if (path[0] != '/' || !offload_sabfs_path(path, sabfs_path)) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    return sabfs_open(sabfs_path, flags, mode);
+}
+
+static int64_t offload_do_openat(SyscallOffloadCall *call, uint64_t dirfd,
+                                 uint64_t path_addr, uint64_t flags,
+                                 uint64_t mode)
+{
+    int sflags = flags & (GUEST_O_ACCMODE | SABFS_O_CREAT | SABFS_O_TRUNC |
+                          SABFS_O_APPEND);
+    sabfs_stat_t st;
+    int64_t fd;
+
+    if ((flags & SABFS_O_CREAT) && (flags & GUEST_O_EXCL)) {
+        fd = offload_openat(call, dirfd, path_addr, SABFS_O_RDONLY, 0);
+        if (fd == SYSCALL_OFFLOAD_PASS) {
+            return fd;
+        }
+        if (fd >= 0) {
+            sabfs_close(fd);
+            return -GUEST_EEXIST;
+        }
+    }
+    fd = offload_openat(call, dirfd, path_addr, sflags, mode);
+    if (fd == SYSCALL_OFFLOAD_PASS) {
+        return fd;
+    }
+    if (fd < 0) {
+        return -GUEST_ENOENT;
+    }
+    if ((flags & call->abi->o_directory) &&
+        (sabfs_fstat(fd, &st) < 0 || !st.is_directory)) {
+        sabfs_close(fd);
+        return -GUEST_ENOTDIR;
+    }
+    return offload_guest_fd(fd);
+}
+
+static int64_t offload_open(SyscallOffloadCall *call)
+{
+    return offload_do_openat(call, GUEST_AT_FDCWD, call->args[0],
+                             call->args[1], call->args[2]);
+}
+
+static int64_t offload_openat_call(SyscallOffloadCall *call)
+{
+    return offload_do_openat(call, call->args[0], call->args[1],
+                             call->args[2], call->args[3]);
+}
+
+static int64_t offload_close(SyscallOffloadCall *call)
+{
+    int fd = offload_fd(call->args[0]);
+
+    if (fd < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    return sabfs_close(fd) < 0 ? -GUEST_EBADF : 0;
+}
+
+/*
+ * Reads count bytes from fd straight into the guest's RAM, at offset or
+ * at the file position if offset is negative
+ */
+static int64_t offload_read_at(SyscallOffloadCall *call, int fd,
+                               uint64_t addr, uint64_t count, int64_t offset)
+{
+    CPUArchState *env = cpu_env(call->cpu);
+    uint8_t bounce[4096];
+    sabfs_stat_t st;
+    uint64_t pos;
+    size_t done = 0;
+
+    if (sabfs_fstat(fd, &st) < 0) {
+        return -GUEST_EBADF;
+    }
+    if (st.is_directory) {
+        return -GUEST_EISDIR;
+    }
+    pos = offset < 0 ? sabfs_lseek(fd, 0, SABFS_SEEK_CUR) : offset;
+    count = pos < st.size ? MIN(MIN(count, OFFLOAD_MAX_RW_COUNT),
+                                st.size - pos) : 0;
+    offload_probe(env, addr, count, MMU_DATA_STORE);
+
+    while (done < count) {
+        size_t run = count - done;
+        void *host = offload_host_run(env, addr + done, &run,
+                                      MMU_DATA_STORE);
+        void *buf = host ? host : bounce;
+        ssize_t n;
+
+        if (!host) {
+            run = MIN(run, sizeof(bounce));
+        }
+        n = offset < 0 ? sabfs_read(fd, buf, run)
+                       : sabfs_pread(fd, buf, run, offset + done);
+        if (n > 0 && !host) {
+            offload_to_guest(env, addr + done, bounce, n);
+        }
+        if (n < 0) {
+            return done ? done : -GUEST_EBADF;
+        }
+        done += n;
+        if (n < run) {
+            break;
+        }
+    }
+    return done;
+}
+
+/* Writes count bytes to fd straight from the guest's RAM */
+static int64_t offload_write_at(SyscallOffloadCall *call, int fd,
+                                uint64_t addr, uint64_t count, int64_t offset)
+{
+    CPUArchState *env = cpu_env(call->cpu);
+    uint8_t bounce[4096];
+    size_t done = 0;
+
+    count = MIN(count, OFFLOAD_MAX_RW_COUNT);
+    offload_probe(env, addr, count, MMU_DATA_LOAD);
+
+    while (done < count) {
+        size_t run = count - done;
+        void *host = offload_host_run(env, addr + done, &run, MMU_DATA_LOAD);
+        void *buf = host ? host : bounce;
+        ssize_t n;
+
+        if (!host) {
+            run = MIN(run, sizeof(bounce));
+            offload_from_guest(env, bounce, addr + done, run);
+        }
+        n = offset < 0 ? sabfs_write(fd, buf, run)
+                       : sabfs_pwrite(fd, buf, run, offset + done);
+        if (n < 0) {
+            return done ? done : -GUEST_EBADF;
+        }
+        done += n;
+        if (n < run) {
+            break;
+        }
+    }
+    return done;
+}
+
+static int64_t offload_read(SyscallOffloadCall *call)
+{
+    int fd = offload_fd(call->args[0]);
+
+    if (fd < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    return offload_read_at(call, fd, call->args[1], call->args[2], -1);
+}
+
+static int64_t offload_write(SyscallOffloadCall *call)
+{
+    int fd = offload_fd(call->args[0]);
+
+    if (fd < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    return offload_write_at(call, fd, call->args[1], call->args[2], -1);
+}
+
+static int64_t offload_pread64(SyscallOffloadCall *call)
+{
+    int fd = offload_fd(call->args[0]);
+
+    if (fd < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    if ((int64_t)call->args[3] < 0) {
+        return -GUEST_EINVAL;
+    }
+    return offload_read_at(call, fd, call->args[1], call->args[2],
+                           call->args[3]);
+}
+
+static int64_t offload_pwrite64(SyscallOffloadCall *call)
+{
+    int fd = offload_fd(call->args[0]);
+
+    if (fd < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    if ((int64_t)call->args[3] < 0) {
+        return -GUEST_EINVAL;
+    }
+    return offload_write_at(call, fd, call->args[1], call->args[2],
+                            call->args[3]);
+}
+
+static int64_t offload_lseek(SyscallOffloadCall *call)
+{
+    int fd = offload_fd(call->args[0]);
+    int whence = call->args[2];
+    off_t ret;
+
+    if (fd < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    if (whence != SABFS_SEEK_SET && whence != SABFS_SEEK_CUR &&
+        whence != SABFS_SEEK_END) {
+        return -GUEST_EINVAL;
+    }
+    ret = sabfs_lseek(fd, call->args[1], whence);
+    return ret < 0 ? -GUEST_EBADF : ret;
+}
+
+static int64_t offload_put_stat(SyscallOffloadCall *call, int fd,
+                                uint64_t addr)
+{
+    uint8_t statbuf[144] = { 0 };
+    sabfs_stat_t st;
+
+    assert(call->abi->stat_size <= sizeof(statbuf));
+    if (sabfs_fstat(fd, &st) < 0) {
+        return -GUEST_EBADF;
+    }
+    call->abi->fill_stat(&st, statbuf);
+    offload_to_guest(cpu_env(call->cpu), addr, statbuf, call->abi->stat_size);
+    return 0;
+}
+
+static int64_t offload_do_fstatat(SyscallOffloadCall *call, uint64_t dirfd,
+                                  uint64_t path_addr, uint64_t addr,
+                                  uint64_t flags)
+{
+    int64_t fd, ret;
+
+    if ((flags & GUEST_AT_EMPTY_PATH) &&
+        !cpu_ldub_data(cpu_env(call->cpu), path_addr)) {
+        fd = offload_fd(dirfd);
+        return fd < 0 ? SYSCALL_OFFLOAD_PASS : offload_put_stat(call, fd, addr);
+    }
+    fd = offload_openat(call, dirfd, path_addr, SABFS_O_RDONLY, 0);
+    if (fd == SYSCALL_OFFLOAD_PASS) {
+        return fd;
+    }
+    if (fd < 0) {
+        return -GUEST_ENOENT;
+    }
+    ret = offload_put_stat(call, fd, addr);
+    sabfs_close(fd);
+    return ret;
+}
+
+static int64_t offload_stat(SyscallOffloadCall *call)
+{
+    return offload_do_fstatat(call, GUEST_AT_FDCWD, call->args[0],
+                              call->args[1], 0);
+}
+
+static int64_t offload_newfstatat(SyscallOffloadCall *call)
+{
+    return offload_do_fstatat(call, call->args[0], call->args[1],
+                              call->args[2], call->args[3]);
+}
+
+static int64_t offload_fstat(SyscallOffloadCall *call)
+{
+    int fd = offload_fd(call->args[0]);
+
+    if (fd < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    return offload_put_stat(call, fd, call->args[1]);
+}
+
+static int64_t offload_dup(SyscallOffloadCall *call)
+{
+    int fd = offload_fd(call->args[0]);
+
+    if (fd < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    return offload_guest_fd(sabfs_dup(fd));
+}
+
+static int64_t offload_dup2(SyscallOffloadCall *call)
+{
+    int fd = offload_fd(call->args[0]);
+
+    if (fd < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    if ((uint32_t)call->args[0] == (uint32_t)call->args[1]) {
+        return (uint32_t)call->args[1];
+    }
+    /* newfd must be in the offloaded range, it is closed first if open */
+    if (sabfs_dup2(fd, offload_fd(call->args[1])) < 0) {
+        return -GUEST_EBADF;
+    }
+    return (uint32_t)call->args[1];
+}
+
+static int64_t offload_dup3(SyscallOffloadCall *call)
+{
+    if (offload_fd(call->args[0]) < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    /* O_CLOEXEC is ignored, fds don't reach the kernel's exec */
+    if ((uint32_t)call->args[0] == (uint32_t)call->args[1]) {
+        return -GUEST_EINVAL;
+    }
+    return offload_dup2(call);
+}
+
+/*
+ * getdents64() with the directory position counting entries, "." and ".."
+ * first. SABFS directories don't record their parent, so ".." has the
+ * inode of the directory itself.
+ */
+static int64_t offload_getdents64(SyscallOffloadCall *call)
+{
+    int fd = offload_fd(call->args[0]);
+    size_t size = MIN(call->args[2], 64 * KiB);
+    sabfs_dirent_t *entries;
+    sabfs_stat_t st;
+    uint8_t *buf;
+    size_t len = 0;
+    int64_t pos;
+    int n;
+
+    if (fd < 0) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    if (sabfs_fstat(fd, &st) < 0) {
+        return -GUEST_EBADF;
+    }
+    if (!st.is_directory) {
+        return -GUEST_ENOTDIR;
+    }
+    n = sabfs_readdir_ino(st.ino, &entries);
+    if (n < 0) {
+        return -GUEST_ENOTDIR;
+    }
+    buf = g_malloc0(size);
+    for (pos = sabfs_lseek(fd, 0, SABFS_SEEK_CUR); pos < n + 2; pos++) {
+        const char *name = pos == 0 ? "." : pos == 1 ? ".." :
+                           entries[pos - 2].name;
+        size_t reclen = ROUND_UP(19 + strlen(name) + 1, 8);
+        uint8_t *d = buf + len;
+
+        if (len + reclen > size) {
+            break;
+        }
+        stq_le_p(d, pos < 2 ? st.ino : entries[pos - 2].ino);  /* d_ino */
+        stq_le_p(d + 8, pos + 1);                              /* d_off */
+        stw_le_p(d + 16, reclen);                              /* d_reclen */
+        d[18] = pos < 2 ? GUEST_DT_DIR : entries[pos - 2].type; /* d_type */
+        strcpy((char *)d + 19, name);
+        len += reclen;
+    }
+    sabfs_free_dirents(entries);
+    if (!len && pos < n + 2) {
+        g_free(buf);
+        return -GUEST_EINVAL;
+    }
+    offload_to_guest(cpu_env(call->cpu), call->args[1], buf, len);
+    g_free(buf);
+    sabfs_lseek(fd, pos, SABFS_SEEK_SET);
+    return len;
+}
+
+/*
+ * mmap() of an offloaded file. The kernel can't see the file, so it maps
+ * anonymous memory instead, populated and writable so that the pages are
+ * the mapping's own, and syscall_offload_complete() copies the file's
+ * blocks into them when it returns. That makes the mapping private: shared
+ * writable mappings are refused like for a file that can't be mapped.
+ */
+static int64_t offload_mmap(SyscallOffloadCall *call)
+{
+    uint64_t prot = call->args[2], flags = call->args[3];
+    int fd = offload_fd(call->args[4]);
+    OffloadPending *p = NULL;
+    sabfs_stat_t st;
+    int dup;
+
+    if (fd < 0 || (flags & GUEST_MAP_ANONYMOUS)) {
+        return SYSCALL_OFFLOAD_PASS;
+    }
+    if (!call->args[1] || (call->args[5] & 4095)) {
+        return -GUEST_EINVAL;
+    }
+    if (sabfs_fstat(fd, &st) < 0) {
+        return -GUEST_EBADF;
+    }
+    if (st.is_directory ||
+        ((flags & GUEST_MAP_TYPE) != GUEST_MAP_PRIVATE &&
+         (prot & GUEST_PROT_WRITE))) {
+        return -GUEST_ENODEV;
+    }
+    dup = sabfs_dup(fd);
+    if (dup < 0) {
+        return -GUEST_EMFILE;
+    }
+
+    qemu_spin_lock(&offload_pending_lock);
+    for (int i = 0; i < OFFLOAD_MAX_PENDING && !p; i++) {
+        if (!offload_pending[i].used) {
+            p = &offload_pending[i];
+        }
+    }
+    if (!p) {
+        /* drop the oldest, its process can't have been returned to */
+        p = &offload_pending[offload_pending_next++ % OFFLOAD_MAX_PENDING];
+        sabfs_close(p->fd);
+        qatomic_dec(&syscall_offload_pending);
+    }
+    *p = (OffloadPending) {
+        .used = true,
+        .asid = call->asid,
+        .pc = call->pc,
+        .sp = call->sp,
+        .fd = dup,
+        .offset = call->args[5],
+        .len = call->args[1],
+    };
+    memcpy(p->args, call->args, sizeof(p->args));
+    qatomic_inc(&syscall_offload_pending);
+    qemu_spin_unlock(&offload_pending_lock);
+
+    call->args[2] = prot | GUEST_PROT_WRITE;
+    call->args[3] = (flags & ~GUEST_MAP_TYPE) | GUEST_MAP_PRIVATE |
+                    GUEST_MAP_ANONYMOUS | GUEST_MAP_POPULATE;
+    call->args[4] = -1;
+    call->args[5] = 0;
+    call->rewritten = true;
+    return SYSCALL_OFFLOAD_PASS;
+}
+
+/* Copies len bytes of inode ino at pos from its blocks in place */
+static void offload_copy_blocks(uint64_t ino, uint8_t *dst, size_t len,
+                                uint64_t pos)
+{
+    while (len > 0) {
+        size_t boff = pos % SABFS_BLOCK_SIZE;
+        size_t n = MIN(len, SABFS_BLOCK_SIZE - boff);
+        const uint8_t *blk = sabfs_map_block(ino, pos / SABFS_BLOCK_SIZE);
+
+        if (blk) {
+            memcpy(dst, blk + boff, n);
+        } else {
+            memset(dst, 0, n);
+        }
+        dst += n;
+        pos += n;
+        len -= n;
+    }
+}
+
+/*
+ * Fills the pages the kernel mapped at addr with the file, through the
+ * page tables irrespective of prot. Each page of guest RAM is mapped and
+ * the SABFS blocks are copied straight into it, with no bounce buffer and
+ * no copy of the pages past the end of the file, which stay zero.
+ * Unmapping the page invalidates translated code of its old contents.
+ */
+static void offload_fill_mapping(CPUState *cpu, uint64_t addr, int fd,
+                                 uint64_t offset, uint64_t len)
+{
+    sabfs_stat_t st;
+
+    if (sabfs_fstat(fd, &st) < 0 || offset >= st.size) {
+        return;
+    }
+    len = MIN(len, st.size - offset);
+    for (uint64_t done = 0; done < len; ) {
+        uint64_t va = addr + done;
+        uint64_t page = va & TARGET_PAGE_MASK;
+        hwaddr plen = MIN(len - done, page + TARGET_PAGE_SIZE - va);
+        MemTxAttrs attrs;
+        hwaddr phys = cpu_get_phys_page_attrs_debug(cpu, page, &attrs);
+        AddressSpace *as;
+        void *host;
+
+        if (phys == -1) {
+            break;
+        }
+        as = cpu_get_address_space(cpu, cpu_asidx_from_attrs(cpu, attrs));
+        host = address_space_map(as, phys + (va - page), &plen, true, attrs);
+        if (!host) {
+            break;
+        }
+        ram_cold_access(host, plen, false);
+        offload_copy_blocks(st.ino, host, plen, offset + done);
+        address_space_unmap(as, host, plen, true, plen);
+        done += plen;
+    }
+}
+
+bool syscall_offload_complete(CPUState *cpu, uint64_t asid, uint64_t pc,
+                              uint64_t sp, uint64_t ret, uint64_t *args)
+{
+    OffloadPending p = { 0 };
+
+    qemu_spin_lock(&offload_pending_lock);
+    for (int i = 0; i < OFFLOAD_MAX_PENDING; i++) {
+        if (offload_pending[i].used && offload_pending[i].asid == asid &&
+            offload_pending[i].pc == pc && offload_pending[i].sp == sp) {
+            p = offload_pending[i];
+            offload_pending[i].used = false;
+            qatomic_dec(&syscall_offload_pending);
+            break;
+        }
+    }
+    qemu_spin_unlock(&offload_pending_lock);
+    if (!p.used) {
+        return false;
+    }
+
+    if (ret < -4095ULL) {
+        offload_fill_mapping(cpu, ret, p.fd, p.offset, p.len);
+    }
+    sabfs_close(p.fd);
+    memcpy(args, p.args, sizeof(p.args));
+    return true;
+}
+
+/* For JS to pass a spec string in without a malloc() export */
+EMSCRIPTEN_KEEPALIVE char *syscall_offload_spec_buffer(void)
+{
+    static char buf[OFFLOAD_MAX_PREFIXES * 2 * OFFLOAD_PATH_MAX];
+
+    return buf;
+}
+
+EMSCRIPTEN_KEEPALIVE int syscall_offload_set_prefixes(const char *spec)
+{
+    OffloadPrefixes *prefixes = g_new0(OffloadPrefixes, 1);
+    g_auto(GStrv) pairs = g_strsplit(spec, ",", -1);
+
+    for (int i = 0; pairs[i]; i++) {
+        OffloadPrefix *prefix = &prefixes->prefix[prefixes->count];
+        char *sep = strchr(pairs[i], '=');
+
+        if (!pairs[i][0]) {
+            continue;
+        }
+        if (!sep || pairs[i][0] != '/' || sep[1] != '/' ||
+            prefixes->count == OFFLOAD_MAX_PREFIXES ||
+            sep - pairs[i] >= OFFLOAD_PATH_MAX ||
+            strlen(sep + 1) >= OFFLOAD_PATH_MAX) {
+            g_free(prefixes);
+            return -1;
+        }
+        *sep = '\0';
+        pstrcpy(prefix->guest, sizeof(prefix->guest), pairs[i]);
+        prefix->guest_len = strlen(prefix->guest);
+        pstrcpy(prefix->sabfs, sizeof(prefix->sabfs), sep + 1);
+        prefixes->count++;
+    }
+    /*
+     * vCPUs may be looking at the old list, which is small and replaced
+     * about once, so it is left allocated
+     */
+    qatomic_rcu_set(&offload_prefixes, prefixes);
+    return 0;
+}
+
+/*
+ * Counters
+ *
+ * Per syscall number of the ABI of the target, for "info syscall-offload"
+ * and query-stats: how many calls were served (and how many of them
+ * failed), how many went to the kernel after all, the bytes the served
+ * ones transferred and the time spent in their handlers. vCPUs update
+ * them concurrently, so they are Stat64s.
+ */
+typedef struct OffloadStats {
+    Stat64 served;
+    Stat64 passed;
+    Stat64 errors;
+    Stat64 bytes;
+    Stat64 time_ns;
+} OffloadStats;
+
+#define OFFLOAD_STATS_NR        512
+
+static OffloadStats offload_stats[OFFLOAD_STATS_NR];
+
+bool syscall_offload(SyscallOffloadCall *call, uint64_t nr, int64_t *ret)
+{
+    const SyscallOffloadABI *abi = call->abi;
+    const SyscallOffloadHandler *h;
+    OffloadStats *stats;
+    int64_t start;
+
+    if (nr >= abi->nr_syscalls || !(h = &abi->handlers[nr])->fn ||
+        !sabfs_is_available()) {
+        return false;
+    }
+    stats = &offload_stats[nr];
+    start = get_clock();
+    *ret = h->fn(call);
+    if (*ret == SYSCALL_OFFLOAD_PASS) {
+        stat64_add(&stats->passed, 1);
+        return false;
+    }
+    stat64_add(&stats->time_ns, get_clock() - start);
+    stat64_add(&stats->served, 1);
+    if (*ret < 0) {
+        stat64_add(&stats->errors, 1);
+    } else if (h->counts_bytes) {
+        stat64_add(&stats->bytes, *ret);
+    }
+    return true;
+}
+
+/* struct stat of x86_64 */
+static void offload_fill_stat_x86_64(const sabfs_stat_t *st, uint8_t *buf)
+{
+    stq_le_p(buf + 8, st->ino ? st->ino : 1);           /* st_ino */
+    stq_le_p(buf + 16, 1);                              /* st_nlink */
+    stl_le_p(buf + 24, st->mode);                       /* st_mode */
+    stq_le_p(buf + 48, st->size);                       /* st_size */
+    stq_le_p(buf + 56, 4096);                           /* st_blksize */
+    stq_le_p(buf + 64, DIV_ROUND_UP(st->size, 512));    /* st_blocks */
+}
+
+/* struct stat of asm-generic, timestamps are left as 0 like above */
+static void offload_fill_stat_generic64(const sabfs_stat_t *st, uint8_t *buf)
+{
+    stq_le_p(buf + 8, st->ino ? st->ino : 1);           /* st_ino */
+    stl_le_p(buf + 16, st->mode);                       /* st_mode */
+    stl_le_p(buf + 20, 1);                              /* st_nlink */
+    stq_le_p(buf + 48, st->size);                       /* st_size */
+    stl_le_p(buf + 56, 4096);                           /* st_blksize */
+    stq_le_p(buf + 64, DIV_ROUND_UP(st->size, 512));    /* st_blocks */
+}
+
+static const SyscallOffloadHandler offload_x86_64_handlers[] = {
+    [0] = { "read", offload_read, true },
+    [1] = { "write", offload_write, true },
+    [2] = { "open", offload_open },
+    [3] = { "close", offload_close },
+    [4] = { "stat", offload_stat },
+    [5] = { "fstat", offload_fstat },
+    [6] = { "lstat", offload_stat },    /* SABFS has no symlinks */
+    [8] = { "lseek", offload_lseek },
+    [9] = { "mmap", offload_mmap },
+    [17] = { "pread64", offload_pread64, true },
+    [18] = { "pwrite64", offload_pwrite64, true },
+    [32] = { "dup", offload_dup },
+    [33] = { "dup2", offload_dup2 },
+    [217] = { "getdents64", offload_getdents64, true },
+    [257] = { "openat", offload_openat_call },
+    [262] = { "newfstatat", offload_newfstatat },
+    [292] = { "dup3", offload_dup3 },
+};
+
+const SyscallOffloadABI syscall_offload_x86_64 = {
+    .name = "x86_64",
+    .handlers = offload_x86_64_handlers,
+    .nr_syscalls = ARRAY_SIZE(offload_x86_64_handlers),
+    .stat_size = 144,
+    .fill_stat = offload_fill_stat_x86_64,
+    .o_directory = 0200000,
+};
+
+/* asm-generic/unistd.h, without the legacy path syscalls */
+static const SyscallOffloadHandler offload_generic64_handlers[] = {
+    [23] = { "dup", offload_dup },
+    [24] = { "dup3", offload_dup3 },
+    [56] = { "openat", offload_openat_call },
+    [57] = { "close", offload_close },
+    [61] = { "getdents64", offload_getdents64, true },
+    [62] = { "lseek", offload_lseek },
+    [63] = { "read", offload_read, true },
+    [64] = { "write", offload_write, true },
+    [67] = { "pread64", offload_pread64, true },
+    [68] = { "pwrite64", offload_pwrite64, true },
+    [79] = { "newfstatat", offload_newfstatat },
+    [80] = { "fstat", offload_fstat },
+    [222] = { "mmap", offload_mmap },
+};
+
+const SyscallOffloadABI syscall_offload_aarch64 = {
+    .name = "aarch64",
+    .handlers = offload_generic64_handlers,
+    .nr_syscalls = ARRAY_SIZE(offload_generic64_handlers),
+    .stat_size = 128,
+    .fill_stat = offload_fill_stat_generic64,
+    .o_directory = 040000,
+};
+
+const SyscallOffloadABI syscall_offload_riscv64 = {
+    .name = "riscv64",
+    .handlers = offload_generic64_handlers,
+    .nr_syscalls = ARRAY_SIZE(offload_generic64_handlers),
+    .stat_size = 128,
+    .fill_stat = offload_fill_stat_generic64,
+    .o_directory = 0200000,
+};
+
+QEMU_BUILD_BUG_ON(ARRAY_SIZE(offload_x86_64_handlers) > OFFLOAD_STATS_NR);
+QEMU_BUILD_BUG_ON(ARRAY_SIZE(offload_generic64_handlers) > OFFLOAD_STATS_NR);
+
+#if defined(TARGET_X86_64)
+#define OFFLOAD_TARGET_ABI  (&syscall_offload_x86_64)
+#elif defined(TARGET_AARCH64)
+#define OFFLOAD_TARGET_ABI  (&syscall_offload_aarch64)
+#elif defined(TARGET_RISCV64)
+#define OFFLOAD_TARGET_ABI  (&syscall_offload_riscv64)
+#endif
+
+#ifdef OFFLOAD_TARGET_ABI
+static void hmp_info_syscall_offload(Monitor *mon, const QDict *qdict)
+{
+    const SyscallOffloadABI *abi = OFFLOAD_TARGET_ABI;
+    bool reset = qdict_get_try_bool(qdict, "reset", false);
+
+    monitor_printf(mon, "%-12s %10s %10s %10s %14s %12s\n", "syscall",
+                   "served", "errors", "passed", "bytes", "time/us");
+    for (unsigned nr = 0; nr < abi->nr_syscalls; nr++) {
+        OffloadStats *stats = &offload_stats[nr];
+        uint64_t served = stat64_get(&stats->served);
+        uint64_t passed = stat64_get(&stats->passed);
+
+        if (!abi->handlers[nr].fn || (!served && !passed)) {
+            continue;
+        }
+        monitor_printf(mon, "%-12s %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+                       " %14" PRIu64 " %12" PRIu64 "\n",
+                       abi->handlers[nr].name, served,
+                       stat64_get(&stats->errors), passed,
+                       stat64_get(&stats->bytes),
+                       stat64_get(&stats->time_ns) / SCALE_US);
+    }
+
+    if (reset) {
+        for (unsigned nr = 0; nr < abi->nr_syscalls; nr++) {
+            OffloadStats *stats = &offload_stats[nr];
+
+            stat64_set(&stats->served, 0);
+            stat64_set(&stats->passed, 0);
+            stat64_set(&stats->errors, 0);
+            stat64_set(&stats->bytes, 0);
+            stat64_set(&stats->time_ns, 0);
+        }
+    }
+}
+
+static const struct {
+    const char *suffix;
+    size_t offset;
+    int unit;           /* StatsUnit, -1 for none */
+    int exponent;
+} offload_stats_fields[] = {
+    { "served", offsetof(OffloadStats, served), -1, 0 },
+    { "passed", offsetof(OffloadStats, passed), -1, 0 },
+    { "errors", offsetof(OffloadStats, errors), -1, 0 },
+    { "bytes", offsetof(OffloadStats, bytes), STATS_UNIT_BYTES, 0 },
+    { "time", offsetof(OffloadStats, time_ns), STATS_UNIT_SECONDS, -9 },
+};
+
+/* query-stats names them <syscall>-<field>, e.g. "read-bytes" */
+static void offload_stats_cb(StatsResultList **result, StatsTarget target,
+                             strList *names, strList *targets, Error **errp)
+{
+    const SyscallOffloadABI *abi = OFFLOAD_TARGET_ABI;
+    StatsList *list = NULL;
+
+    if (target != STATS_TARGET_VM) {
+        return;
+    }
+    for (int nr = abi->nr_syscalls - 1; nr >= 0; nr--) {
+        if (!abi->handlers[nr].fn) {
+            continue;
+        }
+        for (int i = ARRAY_SIZE(offload_stats_fields) - 1; i >= 0; i--) {
+            Stats *stats;
+            g_autofree char *name =
+                g_strdup_printf("%s-%s", abi->handlers[nr].name,
+                                offload_stats_fields[i].suffix);
+
+            if (!apply_str_list_filter(name, names)) {
+                continue;
+            }
+            stats = g_new0(Stats, 1);
+            stats->name = g_steal_pointer(&name);
+            stats->value = g_new0(StatsValue, 1);
+            stats->value->type = QTYPE_QNUM;
+            stats->value->u.scalar =
+                stat64_get((Stat64 *)((uint8_t *)&offload_stats[nr] +
+                                      offload_stats_fields[i].offset));
+            QAPI_LIST_PREPEND(list, stats);
+        }
+    }
+    if (list) {
+        add_stats_entry(result, STATS_PROVIDER_SYSCALL_OFFLOAD, NULL, list);
+    }
+}
+
+static void offload_schemas_cb(StatsSchemaList **result, Error **errp)
+{
+    const SyscallOffloadABI *abi = OFFLOAD_TARGET_ABI;
+    StatsSchemaValueList *list = NULL;
+
+    for (int nr = abi->nr_syscalls - 1; nr >= 0; nr--) {
+        if (!abi->handlers[nr].fn) {
+            continue;
+        }
+        for (int i = ARRAY_SIZE(offload_stats_fields) - 1; i >= 0; i--) {
+            StatsSchemaValue *value = g_new0(StatsSchemaValue, 1);
+
+            value->name = g_strdup_printf("%s-%s", abi->handlers[nr].name,
+                                          offload_stats_fields[i].suffix);
+            value->type = STATS_TYPE_CUMULATIVE;
+            if (offload_stats_fields[i].unit >= 0) {
+                value->has_unit = true;
+                value->unit = offload_stats_fields[i].unit;
+            }
+            if (offload_stats_fields[i].exponent) {
+                value->exponent = offload_stats_fields[i].exponent;
+                value->has_base = true;
+                value->base = 10;
+            }
+            QAPI_LIST_PREPEND(list, value);
+        }
+    }
+    add_stats_schema(result, STATS_PROVIDER_SYSCALL_OFFLOAD, STATS_TARGET_VM,
+                     list);
+}
+
+static void syscall_offload_register(void)
+{
+    monitor_register_hmp("syscall-offload", true, hmp_info_syscall_offload);
+    add_stats_callbacks(STATS_PROVIDER_SYSCALL_OFFLOAD, offload_stats_cb,
+                        offload_schemas_cb);
+}
+
+type_init(syscall_offload_register);
+#endif
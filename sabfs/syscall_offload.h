@@ -0,0 +1,135 @@
+/*
+ * Guest syscall offload to SABFS
+ *
+ * A vCPU executing a file syscall in guest user mode can be served
+ * directly from SABFS instead of entering the guest kernel. Each target
+ * has a small adapter at its syscall instruction that gathers the syscall
+ * number and arguments into a SyscallOffloadCall and, if syscall_offload()
+ * handles it, writes the result back and returns to user mode. What is
+ * offloaded and how the guest ABI looks is described by a
+ * SyscallOffloadABI table, with one handler per syscall number.
+ *
+ * Paths are only offloaded below the configured prefixes (by default
+ * /mnt/wasi1/, served from /pack/ in SABFS) and offloaded files get guest
+ * fds from SYSCALL_OFFLOAD_FD_BASE on, which the kernel never hands out.
+ */
+
+#ifndef SABFS_SYSCALL_OFFLOAD_H
+#define SABFS_SYSCALL_OFFLOAD_H
+
+#include "sabfs/sabfs_qemu.h"
+
+/* Guest fds >= SYSCALL_OFFLOAD_FD_BASE are SABFS fds moved up by it */
+#define SYSCALL_OFFLOAD_FD_BASE 10000
+
+/* Handler result asking for the syscall to go to the guest kernel */
+#define SYSCALL_OFFLOAD_PASS INT64_MIN
+
+typedef struct SyscallOffloadCall SyscallOffloadCall;
+typedef int64_t (*SyscallOffloadFn)(SyscallOffloadCall *call);
+
+typedef struct SyscallOffloadHandler {
+    const char *name;
+    SyscallOffloadFn fn;
+    /* a positive result is a byte count, for the counters */
+    bool counts_bytes;
+} SyscallOffloadHandler;
+
+typedef struct SyscallOffloadABI {
+    const char *name;
+    /* handlers indexed by syscall number, NULL ones go to the kernel */
+    const SyscallOffloadHandler *handlers;
+    unsigned nr_syscalls;
+    /* struct stat of the ABI */
+    size_t stat_size;
+    void (*fill_stat)(const sabfs_stat_t *st, uint8_t *buf);
+    /* O_DIRECTORY, which differs between architectures */
+    int o_directory;
+} SyscallOffloadABI;
+
+struct SyscallOffloadCall {
+    CPUState *cpu;
+    const SyscallOffloadABI *abi;
+    uint64_t args[6];
+    /*
+     * Identify the returning syscall for syscall_offload_return(): the
+     * address space (page table base), the user pc after the syscall
+     * instruction and the user stack pointer.
+     */
+    uint64_t asid;
+    uint64_t pc;
+    uint64_t sp;
+    /* set when a handler changed args for the kernel to run instead */
+    bool rewritten;
+};
+
+#if defined(__EMSCRIPTEN__) && !defined(CONFIG_USER_ONLY)
+
+extern const SyscallOffloadABI syscall_offload_x86_64;
+extern const SyscallOffloadABI syscall_offload_aarch64;
+extern const SyscallOffloadABI syscall_offload_riscv64;
+
+extern int syscall_offload_pending;
+
+/*
+ * Runs the handler for syscall nr of call->abi. Serving a file syscall
+ * here, without entering the guest kernel, saves emulating the whole
+ * kernel path. Returns true with the result (or negative errno) in *ret
+ * if the syscall was served and the vCPU should return to user mode,
+ * false if the kernel should run it, with call->args to be written back
+ * first if call->rewritten is set.
+ * Guest memory faults are raised on the vCPU before the syscall has any
+ * effect, so the adapter must leave the pc at the syscall instruction
+ * for the syscall to be restarted once the kernel has handled the fault.
+ */
+bool syscall_offload(SyscallOffloadCall *call, uint64_t nr, int64_t *ret);
+
+bool syscall_offload_complete(CPUState *cpu, uint64_t asid, uint64_t pc,
+                              uint64_t sp, uint64_t ret, uint64_t *args);
+
+/*
+ * Called by the adapter when the vCPU returns to user mode with ret in
+ * the syscall result register. Finishes syscalls that the kernel ran
+ * with rewritten arguments, e.g. mmap() of an offloaded file. Returns
+ * true if that was one, with the original arguments in args for the
+ * adapter to restore, as the kernel preserves argument registers.
+ */
+static inline bool syscall_offload_return(CPUState *cpu, uint64_t asid,
+                                          uint64_t pc, uint64_t sp,
+                                          uint64_t ret, uint64_t *args)
+{
+    if (likely(!qatomic_read(&syscall_offload_pending))) {
+        return false;
+    }
+    return syscall_offload_complete(cpu, asid, pc, sp, ret, args);
+}
+
+/*
+ * Replaces the path prefixes that are offloaded by a comma separated list
+ * of guest=sabfs pairs, e.g. "/mnt/wasi1/=/pack/,/data/=/docker/data/".
+ * Exported to JS so the loader can configure it before the guest runs.
+ * Returns 0 on success, -1 if spec is malformed.
+ */
+int syscall_offload_set_prefixes(const char *spec);
+
+/* A static buffer large enough for any spec, to fill in from JS */
+char *syscall_offload_spec_buffer(void);
+
+#else
+
+static inline bool syscall_offload(SyscallOffloadCall *call, uint64_t nr,
+                                   int64_t *ret)
+{
+    return false;
+}
+
+static inline bool syscall_offload_return(CPUState *cpu, uint64_t asid,
+                                          uint64_t pc, uint64_t sp,
+                                          uint64_t ret, uint64_t *args)
+{
+    return false;
+}
+
+#endif
+
+#endif /* SABFS_SYSCALL_OFFLOAD_H */
@@ -31,6 +31,7 @@
 #include "qemu/main-loop.h"
 #include "qemu/option.h"
 #include "qemu/seqlock.h"
+#include "qemu/stats64.h"
 #include "sysemu/replay.h"
 #include "sysemu/runstate.h"
 #include "hw/core/cpu.h"
@@ -40,6 +41,39 @@
 
 /* clock and ticks */
 
+#ifdef EMSCRIPTEN
+/*
+ * On wasm hosts the ticks are nanoseconds of performance.now(), which is
+ * what the x86 TSC and the counters of other guests are made of. Each
+ * worker has a time origin of its own, so two vCPUs reading the clock in
+ * turn may see it go back by a fraction of a microsecond. Rather than
+ * fixing that up under vm_clock_lock, which every vCPU takes for every
+ * TSC read, readers only go forward from the latest ticks any of them
+ * returned.
+ */
+static Stat64 cpu_ticks_latest;
+
+int64_t cpu_get_ticks(void)
+{
+    int64_t ticks, latest;
+    unsigned start;
+
+    do {
+        start = seqlock_read_begin(&timers_state.vm_clock_seqlock);
+        ticks = timers_state.cpu_ticks_offset;
+        if (timers_state.cpu_ticks_enabled) {
+            ticks += cpu_get_host_ticks();
+        }
+    } while (seqlock_read_retry(&timers_state.vm_clock_seqlock, start));
+
+    latest = stat64_get(&cpu_ticks_latest);
+    if (ticks <= latest) {
+        return latest;
+    }
+    stat64_max(&cpu_ticks_latest, ticks);
+    return ticks;
+}
+#else
 static int64_t cpu_get_ticks_locked(void)
 {
     int64_t ticks = timers_state.cpu_ticks_offset;
@@ -70,6 +104,7 @@ int64_t cpu_get_ticks(void)
     qemu_spin_unlock(&timers_state.vm_clock_lock);
     return ticks;
 }
+#endif
 
 int64_t cpu_get_clock_locked(void)
 {
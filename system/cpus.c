@@ -38,6 +38,12 @@
 #include "qemu/plugin.h"
 #include "sysemu/cpus.h"
 #include "qemu/guest-random.h"
+#ifdef EMSCRIPTEN
+#include <math.h>
+#include <emscripten.h>
+#include <emscripten/threading.h>
+#include "qemu/timer.h"
+#endif
 #include "hw/nmi.h"
 #include "sysemu/replay.h"
 #include "sysemu/runstate.h"
@@ -419,16 +425,76 @@ void qemu_wait_io_event_common(CPUState *cpu)
     process_queued_cpu_work(cpu);
 }
 
+#ifdef EMSCRIPTEN
+void cpu_account_halt(CPUState *cpu, int64_t ns)
+{
+    stat64_add(&cpu->halted_ns, ns);
+    stat64_inc(&cpu->halt_wakeups);
+}
+
+/*
+ * Counters for the page to tell how idle the VM is: since startup, how
+ * long each vCPU was halted and how often its thread woke up from that,
+ * and how often the threads waiting for I/O and timers woke up. Rates are
+ * the difference between two readings divided by that of clock_ns.
+ * The string stays valid until the next call.
+ */
+EMSCRIPTEN_KEEPALIVE const char *qemu_idle_stats_json(void)
+{
+    static char *json;
+    GString *buf = g_string_new(NULL);
+    CPUState *cpu;
+    bool first = true;
+
+    g_string_append_printf(buf, "{\"clock_ns\":%" PRId64
+                           ",\"loop_wakeups\":%" PRIu64 ",\"cpus\":[",
+                           get_clock(), fdmon_wasm_wakeups());
+    WITH_RCU_READ_LOCK_GUARD() {
+        CPU_FOREACH(cpu) {
+            g_string_append_printf(buf, "%s{\"halted_ns\":%" PRIu64
+                                   ",\"wakeups\":%" PRIu64 "}",
+                                   first ? "" : ",",
+                                   stat64_get(&cpu->halted_ns),
+                                   stat64_get(&cpu->halt_wakeups));
+            first = false;
+        }
+    }
+    g_string_append(buf, "]}");
+    g_free(json);
+    json = g_string_free(buf, false);
+    return json;
+}
+#endif
+
 void qemu_wait_io_event(CPUState *cpu)
 {
     bool slept = false;
+#ifdef EMSCRIPTEN
+    /* Read before checking for work so that kicks in between aren't lost */
+    uint32_t seq = qatomic_load_acquire(&cpu->halt_futex);
+#endif
 
     while (cpu_thread_is_idle(cpu)) {
         if (!slept) {
             slept = true;
             qemu_plugin_vcpu_idle_cb(cpu);
         }
+#ifdef EMSCRIPTEN
+        /*
+         * Sleep in Atomics.wait on the vCPU's own word instead of the
+         * emulated condvar, so a kick wakes only this thread and doesn't
+         * have it contend for the BQL inside pthread_cond_wait.
+         */
+        int64_t start = get_clock();
+
+        qemu_mutex_unlock_iothread();
+        emscripten_futex_wait(&cpu->halt_futex, seq, INFINITY);
+        qemu_mutex_lock_iothread();
+        seq = qatomic_load_acquire(&cpu->halt_futex);
+        cpu_account_halt(cpu, get_clock() - start);
+#else
         qemu_cond_wait(cpu->halt_cond, &qemu_global_mutex);
+#endif
     }
     if (slept) {
         qemu_plugin_vcpu_resume_cb(cpu);
@@ -458,6 +524,10 @@ void cpus_kick_thread(CPUState *cpu)
 void qemu_cpu_kick(CPUState *cpu)
 {
     qemu_cond_broadcast(cpu->halt_cond);
+#ifdef EMSCRIPTEN
+    qatomic_inc(&cpu->halt_futex);
+    emscripten_futex_wake(&cpu->halt_futex, INT_MAX);
+#endif
     if (cpus_accel->kick_vcpu_thread) {
         cpus_accel->kick_vcpu_thread(cpu);
     } else { /* default */
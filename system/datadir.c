@@ -26,10 +26,27 @@
 #include "qemu/datadir.h"
 #include "qemu/cutils.h"
 #include "trace.h"
+#ifdef EMSCRIPTEN
+#include "hw/loader.h"
+#endif
 
 static const char *data_dir[16];
 static int data_dir_idx;
 
+/*
+ * Whether the file can be loaded. Files of lazy SABFS mounts aren't
+ * visible to access() but are read directly by the loaders.
+ */
+static bool data_file_readable(const char *path)
+{
+#ifdef EMSCRIPTEN
+    if (image_in_sabfs(path)) {
+        return true;
+    }
+#endif
+    return access(path, R_OK) == 0;
+}
+
 char *qemu_find_file(int type, const char *name)
 {
     int i;
@@ -37,7 +54,7 @@ char *qemu_find_file(int type, const char *name)
     char *buf;
 
     /* Try the name as a straight path first */
-    if (access(name, R_OK) == 0) {
+    if (data_file_readable(name)) {
         trace_load_file(name, name);
         return g_strdup(name);
     }
@@ -55,7 +72,7 @@ char *qemu_find_file(int type, const char *name)
 
     for (i = 0; i < data_dir_idx; i++) {
         buf = g_strdup_printf("%s/%s%s", data_dir[i], subdir, name);
-        if (access(buf, R_OK) == 0) {
+        if (data_file_readable(buf)) {
             trace_load_file(name, buf);
             return buf;
         }
@@ -2786,9 +2786,11 @@ bool memory_region_is_mapped(MemoryRegion *mr)
 
 /* Same as memory_region_find, but it does not add a reference to the
  * returned region.  It must be called from an RCU critical section.
+ * With @clip false, the section is the whole flat range found.
  */
 static MemoryRegionSection memory_region_find_rcu(MemoryRegion *mr,
-                                                  hwaddr addr, uint64_t size)
+                                                  hwaddr addr, uint64_t size,
+                                                  bool clip)
 {
     MemoryRegionSection ret = { .mr = NULL };
     MemoryRegion *root;
@@ -2821,7 +2823,7 @@ static MemoryRegionSection memory_region_find_rcu(MemoryRegion *mr,
 
     ret.mr = fr->mr;
     ret.fv = view;
-    range = addrrange_intersection(range, fr->addr);
+    range = clip ? addrrange_intersection(range, fr->addr) : fr->addr;
     ret.offset_within_region = fr->offset_in_region;
     ret.offset_within_region += int128_get64(int128_sub(range.start,
                                                         fr->addr.start));
@@ -2837,7 +2839,19 @@ MemoryRegionSection memory_region_find(MemoryRegion *mr,
 {
     MemoryRegionSection ret;
     RCU_READ_LOCK_GUARD();
-    ret = memory_region_find_rcu(mr, addr, size);
+    ret = memory_region_find_rcu(mr, addr, size, true);
+    if (ret.mr) {
+        memory_region_ref(ret.mr);
+    }
+    return ret;
+}
+
+MemoryRegionSection memory_region_find_flat_range(MemoryRegion *mr,
+                                                  hwaddr addr)
+{
+    MemoryRegionSection ret;
+    RCU_READ_LOCK_GUARD();
+    ret = memory_region_find_rcu(mr, addr, 1, false);
     if (ret.mr) {
         memory_region_ref(ret.mr);
     }
@@ -2876,7 +2890,7 @@ bool memory_region_present(MemoryRegion *container, hwaddr addr)
     MemoryRegion *mr;
 
     RCU_READ_LOCK_GUARD();
-    mr = memory_region_find_rcu(container, addr, 1).mr;
+    mr = memory_region_find_rcu(container, addr, 1, true).mr;
     return mr && mr != container;
 }
 
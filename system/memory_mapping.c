@@ -203,6 +203,11 @@ static void guest_phys_block_add_section(GuestPhysListener *g,
                          section->offset_within_region;
     GuestPhysBlock *predecessor = NULL;
 
+#ifdef EMSCRIPTEN
+    /* Users such as dump-guest-memory read the blocks directly */
+    ram_cold_access(host_addr, target_end - target_start, false);
+#endif
+
     /* find continuity in guest physical address space */
     if (!QTAILQ_EMPTY(&g->list->head)) {
         hwaddr predecessor_size;
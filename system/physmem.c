@@ -73,6 +73,9 @@
 #ifndef _WIN32
 #include "qemu/mmap-alloc.h"
 #endif
+#ifdef EMSCRIPTEN
+#include "sysemu/ram-cold.h"
+#endif
 
 #include "monitor/monitor.h"
 
@@ -2174,6 +2177,11 @@ void *qemu_map_ram_ptr(RAMBlock *ram_block, ram_addr_t addr)
 
         block->host = xen_map_cache(block->offset, block->max_length, 1, false);
     }
+#ifdef EMSCRIPTEN
+    /* Callers access up to a page, see address_space_read() for more */
+    ram_cold_access(ramblock_ptr(block, addr),
+                    MIN(TARGET_PAGE_SIZE, block->max_length - addr), false);
+#endif
     return ramblock_ptr(block, addr);
 }
 
@@ -2208,6 +2216,10 @@ static void *qemu_ram_ptr_length(RAMBlock *ram_block, ram_addr_t addr,
         block->host = xen_map_cache(block->offset, block->max_length, 1, lock);
     }
 
+#ifdef EMSCRIPTEN
+    /* Mappings that are locked may be used for as long as the caller likes */
+    ram_cold_access(ramblock_ptr(block, addr), *size, lock);
+#endif
     return ramblock_ptr(block, addr);
 }
 
@@ -3198,6 +3210,9 @@ void address_space_unmap(AddressSpace *as, void *buffer, hwaddr len,
         if (xen_enabled()) {
             xen_invalidate_map_cache_entry(buffer);
         }
+#ifdef EMSCRIPTEN
+        ram_cold_unpin(buffer, len);
+#endif
         memory_region_unref(mr);
         return;
     }
@@ -3301,6 +3316,11 @@ void address_space_cache_destroy(MemoryRegionCache *cache)
     if (xen_enabled()) {
         xen_invalidate_map_cache_entry(cache->ptr);
     }
+#ifdef EMSCRIPTEN
+    if (cache->ptr) {
+        ram_cold_unpin(cache->ptr, cache->len);
+    }
+#endif
     memory_region_unref(cache->mrs.mr);
     flatview_unref(cache->fv);
     cache->mrs.mr = NULL;
@@ -3579,7 +3599,11 @@ int ram_block_discard_range(RAMBlock *rb, uint64_t start, size_t length)
              * and to fall back on the file contents (which we just
              * fallocate'd away).
              */
-#if defined(CONFIG_MADVISE)
+#if defined(EMSCRIPTEN)
+            ram_cold_drop(host_startaddr, length);
+            qemu_ram_discard(host_startaddr, length);
+            ret = 0;
+#elif defined(CONFIG_MADVISE)
             if (qemu_ram_is_shared(rb) && rb->fd < 0) {
                 ret = madvise(host_startaddr, length, QEMU_MADV_REMOVE);
             } else {
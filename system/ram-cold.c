@@ -0,0 +1,552 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Compression of cold guest RAM in the wasm memory
+ *
+ * Guest RAM, the code buffer and SABFS share one linear memory, and a
+ * guest that touches all of its RAM once keeps all of it committed. Like
+ * zswap, a scanner thread finds the 64KiB wasm pages of memory backends
+ * that went unused for a while, keeps them deflated on the heap and
+ * hands the pages back to the browser.
+ *
+ * wasm has no page protection, so everything that gets a host pointer
+ * to guest RAM calls ram_cold_access() first: the TLB fill of the vCPUs,
+ * and the RAM block lookups of physmem and virtio that devices use. A
+ * compressed page is inflated back into place right there. Sampling
+ * relies on it too: all TLBs are flushed every scan, so a page that no
+ * one called ram_cold_access() for since then is idle.
+ *
+ * Devices may keep the pointers they map, virtio rings for instance, and
+ * those accesses are not seen. So pages are pinned while a device has
+ * them mapped, counting the mappings, and only compressed once the last
+ * one is unmapped with ram_cold_unpin(). The vrings stay pinned while the
+ * device uses them; buffers only for the time of a request.
+ */
+
+#include "qemu/osdep.h"
+#include "block/block-global-state.h"
+#include "exec/exec-all.h"
+#include "exec/ramblock.h"
+#include "hw/core/cpu.h"
+#include "migration/misc.h"
+#include "qemu/bitmap.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/main-loop.h"
+#include "qemu/mmap-alloc.h"
+#include "qemu/queue.h"
+#include "qemu/rcu.h"
+#include "qemu/rcu_queue.h"
+#include "qemu/stats64.h"
+#include "qemu/thread.h"
+#include "qemu/units.h"
+#include "sysemu/cpus.h"
+#include "sysemu/hostmem.h"
+#include "sysemu/ram-cold.h"
+#include "sysemu/runstate.h"
+
+#include <emscripten.h>
+#include <zlib.h>
+
+/* Pages compressed per scan, the time they are checked with vCPUs stopped */
+#define RAM_COLD_BATCH 512
+
+/* Pages that don't shrink to this are left alone */
+#define RAM_COLD_MAX_PACKED (WASM_PAGE_SIZE * 3 / 4)
+
+typedef struct RamColdRegion {
+    struct rcu_head rcu;
+    uint8_t *host;
+    size_t pages;
+    /* Set by ram_cold_access() without the lock */
+    unsigned long *accessed;
+    /* Mappings of the page that are still in use, changed atomically */
+    uint32_t *pins;
+    /* The rest is protected by ram_cold.lock */
+    unsigned long *packed;
+    /* Scans since the page was last accessed */
+    uint8_t *age;
+    /* Deflated contents of the packed pages */
+    void **data;
+    uint32_t *data_len;
+    QLIST_ENTRY(RamColdRegion) next;
+} RamColdRegion;
+
+static struct {
+    QemuMutex lock;
+    QemuCond cond;
+    QemuThread thread;
+    bool thread_running;
+    /* Idle time before pages are compressed, 0 while stopped */
+    unsigned age_ms;
+    /* RCU list, changed with lock held */
+    QLIST_HEAD(, RamColdRegion) regions;
+    RAMBlockNotifier notifier;
+    /* Changed with lock held */
+    size_t packed_pages;
+    size_t packed_bytes;
+    Stat64 passes;
+    Stat64 faults;
+} ram_cold;
+
+static bool ram_cold_block_ok(void *host)
+{
+    ram_addr_t offset;
+    RAMBlock *rb = qemu_ram_block_from_host(host, false, &offset);
+    Object *owner;
+
+    /* Only anonymous RAM can be handed back and committed again */
+    if (!rb || rb->fd >= 0 || (rb->flags & (RAM_PREALLOC | RAM_SHARED))) {
+        return false;
+    }
+    owner = memory_region_owner(rb->mr);
+    return object_dynamic_cast(owner, TYPE_MEMORY_BACKEND) != NULL;
+}
+
+static void ram_cold_block_added(RAMBlockNotifier *n, void *host,
+                                 size_t size, size_t max_size)
+{
+    uint8_t *start = QEMU_ALIGN_PTR_UP(host, WASM_PAGE_SIZE);
+    uint8_t *end = QEMU_ALIGN_PTR_DOWN((uint8_t *)host + size,
+                                       WASM_PAGE_SIZE);
+    RamColdRegion *r;
+
+    if (start >= end || !ram_cold_block_ok(host)) {
+        return;
+    }
+    r = g_new0(RamColdRegion, 1);
+    r->host = start;
+    r->pages = (end - start) / WASM_PAGE_SIZE;
+    r->accessed = bitmap_new(r->pages);
+    r->pins = g_new0(uint32_t, r->pages);
+    r->packed = bitmap_new(r->pages);
+    r->age = g_new0(uint8_t, r->pages);
+    r->data = g_new0(void *, r->pages);
+    r->data_len = g_new0(uint32_t, r->pages);
+
+    qemu_mutex_lock(&ram_cold.lock);
+    QLIST_INSERT_HEAD_RCU(&ram_cold.regions, r, next);
+    qemu_mutex_unlock(&ram_cold.lock);
+}
+
+static void ram_cold_region_free(RamColdRegion *r)
+{
+    for (size_t i = 0; i < r->pages; i++) {
+        g_free(r->data[i]);
+    }
+    g_free(r->accessed);
+    g_free(r->pins);
+    g_free(r->packed);
+    g_free(r->age);
+    g_free(r->data);
+    g_free(r->data_len);
+    g_free(r);
+}
+
+static void ram_cold_block_removed(RAMBlockNotifier *n, void *host,
+                                   size_t size, size_t max_size)
+{
+    uint8_t *start = QEMU_ALIGN_PTR_UP(host, WASM_PAGE_SIZE);
+    RamColdRegion *r;
+
+    qemu_mutex_lock(&ram_cold.lock);
+    QLIST_FOREACH(r, &ram_cold.regions, next) {
+        if (r->host == start) {
+            QLIST_REMOVE_RCU(r, next);
+            call_rcu(r, ram_cold_region_free, rcu);
+            break;
+        }
+    }
+    qemu_mutex_unlock(&ram_cold.lock);
+}
+
+/* Called with the lock held */
+static void ram_cold_forget(RamColdRegion *r, size_t i)
+{
+    qatomic_set(&ram_cold.packed_pages, ram_cold.packed_pages - 1);
+    qatomic_set(&ram_cold.packed_bytes,
+                ram_cold.packed_bytes - r->data_len[i]);
+    clear_bit(i, r->packed);
+    g_free(r->data[i]);
+    r->data[i] = NULL;
+}
+
+/* Called with the lock held */
+static void ram_cold_unpack(RamColdRegion *r, size_t i)
+{
+    uLongf len = WASM_PAGE_SIZE;
+    int ret;
+
+    ret = uncompress(r->host + i * WASM_PAGE_SIZE, &len, r->data[i],
+                     r->data_len[i]);
+    if (ret != Z_OK || len != WASM_PAGE_SIZE) {
+        error_report("ram-cold: can't inflate guest RAM (%d)", ret);
+        abort();
+    }
+    stat64_inc(&ram_cold.faults);
+    ram_cold_forget(r, i);
+}
+
+void ram_cold_access(void *host, size_t len, bool pin)
+{
+    uint8_t *p = host, *end = p + len;
+    RamColdRegion *r;
+
+    if (!len) {
+        return;
+    }
+    RCU_READ_LOCK_GUARD();
+    QLIST_FOREACH_RCU(r, &ram_cold.regions, next) {
+        uint8_t *rend = r->host + r->pages * WASM_PAGE_SIZE;
+        size_t i, last;
+
+        if (end <= r->host || p >= rend) {
+            continue;
+        }
+        i = (MAX(p, r->host) - r->host) / WASM_PAGE_SIZE;
+        last = (MIN(end, rend) - 1 - r->host) / WASM_PAGE_SIZE;
+        for (; i <= last; i++) {
+            /* Before checking for a packed page, see ram_cold_commit() */
+            if (pin) {
+                qatomic_inc(&r->pins[i]);
+            }
+            if (!test_bit(i, r->accessed)) {
+                set_bit_atomic(i, r->accessed);
+            }
+            smp_mb();
+            if (test_bit(i, r->packed)) {
+                qemu_mutex_lock(&ram_cold.lock);
+                if (test_bit(i, r->packed)) {
+                    ram_cold_unpack(r, i);
+                }
+                qemu_mutex_unlock(&ram_cold.lock);
+            }
+        }
+    }
+}
+
+void ram_cold_unpin(void *host, size_t len)
+{
+    uint8_t *p = host, *end = p + len;
+    RamColdRegion *r;
+
+    if (!len) {
+        return;
+    }
+    RCU_READ_LOCK_GUARD();
+    QLIST_FOREACH_RCU(r, &ram_cold.regions, next) {
+        uint8_t *rend = r->host + r->pages * WASM_PAGE_SIZE;
+        size_t i, last;
+
+        if (end <= r->host || p >= rend) {
+            continue;
+        }
+        i = (MAX(p, r->host) - r->host) / WASM_PAGE_SIZE;
+        last = (MIN(end, rend) - 1 - r->host) / WASM_PAGE_SIZE;
+        for (; i <= last; i++) {
+            /* Ranges mapped before the region was added have no pins */
+            if (qatomic_read(&r->pins[i])) {
+                qatomic_dec(&r->pins[i]);
+            }
+        }
+    }
+}
+
+void ram_cold_drop(void *host, size_t len)
+{
+    uint8_t *p = host, *end = p + len;
+    RamColdRegion *r;
+
+    qemu_mutex_lock(&ram_cold.lock);
+    QLIST_FOREACH(r, &ram_cold.regions, next) {
+        uint8_t *rend = r->host + r->pages * WASM_PAGE_SIZE;
+        size_t i, last;
+
+        if (end <= r->host || p >= rend) {
+            continue;
+        }
+        i = (MAX(p, r->host) - r->host) / WASM_PAGE_SIZE;
+        last = (MIN(end, rend) - 1 - r->host) / WASM_PAGE_SIZE;
+        for (; i <= last; i++) {
+            uint8_t *page = r->host + i * WASM_PAGE_SIZE;
+
+            if (!test_bit(i, r->packed)) {
+                continue;
+            }
+            /* The rest of a partly discarded page is kept */
+            if (page >= p && page + WASM_PAGE_SIZE <= end) {
+                ram_cold_forget(r, i);
+            } else {
+                ram_cold_unpack(r, i);
+            }
+        }
+    }
+    qemu_mutex_unlock(&ram_cold.lock);
+}
+
+void ram_cold_unpack_all(void)
+{
+    RamColdRegion *r;
+
+    qemu_mutex_lock(&ram_cold.lock);
+    QLIST_FOREACH(r, &ram_cold.regions, next) {
+        size_t i;
+
+        for (i = find_first_bit(r->packed, r->pages); i < r->pages;
+             i = find_next_bit(r->packed, r->pages, i + 1)) {
+            ram_cold_unpack(r, i);
+        }
+    }
+    qemu_mutex_unlock(&ram_cold.lock);
+}
+
+/* New entries go through the TLB fill and ram_cold_access() again */
+static void ram_cold_flush_tlbs(void)
+{
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        tlb_flush(cpu);
+    }
+}
+
+/*
+ * Stops the vCPUs, their flushed TLBs and block requests, so that every
+ * access to guest RAM after ram_cold_resume() calls ram_cold_access().
+ */
+static void ram_cold_pause(void)
+{
+    qemu_mutex_lock_iothread();
+    pause_all_vcpus();
+    bdrv_drain_all_begin();
+    ram_cold_flush_tlbs();
+}
+
+static void ram_cold_resume(void)
+{
+    bdrv_drain_all_end();
+    /* The flushes queued run before any guest code */
+    resume_all_vcpus();
+    qemu_mutex_unlock_iothread();
+}
+
+typedef struct RamColdCandidate {
+    RamColdRegion *r;
+    size_t i;
+    void *data;
+    uint32_t len;
+} RamColdCandidate;
+
+/* Ages the pages and picks those idle for long enough */
+static size_t ram_cold_scan(RamColdCandidate *c, unsigned min_age)
+{
+    RamColdRegion *r;
+    size_t n = 0;
+
+    QLIST_FOREACH(r, &ram_cold.regions, next) {
+        for (size_t i = 0; i < r->pages; i++) {
+            if (test_bit(i, r->accessed)) {
+                clear_bit_atomic(i, r->accessed);
+                r->age[i] = 0;
+                continue;
+            }
+            if (r->age[i] < UINT8_MAX) {
+                r->age[i]++;
+            }
+            if (n < RAM_COLD_BATCH && r->age[i] >= min_age &&
+                !test_bit(i, r->packed) && !qatomic_read(&r->pins[i])) {
+                c[n++] = (RamColdCandidate) { .r = r, .i = i };
+            }
+        }
+    }
+    return n;
+}
+
+/* Deflates the candidates while the guest runs */
+static void ram_cold_deflate(RamColdCandidate *c, size_t n)
+{
+    g_autofree Bytef *buf = g_malloc(compressBound(WASM_PAGE_SIZE));
+
+    for (size_t k = 0; k < n; k++) {
+        uint8_t *page = c[k].r->host + c[k].i * WASM_PAGE_SIZE;
+        uLongf len = compressBound(WASM_PAGE_SIZE);
+
+        /* Zero pages are for ram-merge to discard */
+        if (test_bit(c[k].i, c[k].r->accessed) ||
+            buffer_is_zero(page, WASM_PAGE_SIZE)) {
+            continue;
+        }
+        if (compress2(buf, &len, page, WASM_PAGE_SIZE, Z_BEST_SPEED) != Z_OK ||
+            len > RAM_COLD_MAX_PACKED) {
+            /* Don't try again before the page gets idle again */
+            c[k].r->age[c[k].i] = 0;
+            continue;
+        }
+        c[k].data = g_memdup2(buf, len);
+        c[k].len = len;
+    }
+}
+
+/*
+ * Replaces the candidates by their deflated copies, unless they were
+ * accessed since ram_cold_pause() cleared their bits. Everyone that
+ * could have written them since sets the bit before, and is stopped now.
+ * Should anyone still come along, it sets the bit before it checks for
+ * the packed one that is set here before checking the bit, and then
+ * waits for the lock to inflate the page again.
+ * Returns false if the engine can't discard memory.
+ */
+static bool ram_cold_commit(RamColdCandidate *c, size_t n)
+{
+    bool ok = true;
+
+    for (size_t k = 0; k < n; k++) {
+        RamColdRegion *r = c[k].r;
+        size_t i = c[k].i;
+
+        if (!c[k].data || !ok) {
+            g_free(c[k].data);
+            continue;
+        }
+        set_bit(i, r->packed);
+        smp_mb();
+        if (test_bit(i, r->accessed) || qatomic_read(&r->pins[i])) {
+            clear_bit(i, r->packed);
+            g_free(c[k].data);
+            continue;
+        }
+        if (!qemu_ram_decommit(r->host + i * WASM_PAGE_SIZE, WASM_PAGE_SIZE)) {
+            clear_bit(i, r->packed);
+            g_free(c[k].data);
+            ok = false;
+            continue;
+        }
+        r->data[i] = c[k].data;
+        r->data_len[i] = c[k].len;
+        qatomic_set(&ram_cold.packed_pages, ram_cold.packed_pages + 1);
+        qatomic_set(&ram_cold.packed_bytes, ram_cold.packed_bytes + c[k].len);
+    }
+    return ok;
+}
+
+static bool ram_cold_pass(RamColdCandidate *c, unsigned min_age)
+{
+    size_t n;
+    bool ok = true;
+
+    if (!runstate_is_running() || !migration_is_idle()) {
+        return true;
+    }
+
+    /* Age the pages and restart sampling with empty TLBs */
+    qemu_mutex_lock(&ram_cold.lock);
+    n = ram_cold_scan(c, min_age);
+    qemu_mutex_unlock(&ram_cold.lock);
+    if (!n) {
+        WITH_RCU_READ_LOCK_GUARD() {
+            ram_cold_flush_tlbs();
+        }
+        return true;
+    }
+
+    ram_cold_pause();
+    for (size_t k = 0; k < n; k++) {
+        clear_bit_atomic(c[k].i, c[k].r->accessed);
+    }
+    ram_cold_resume();
+
+    ram_cold_deflate(c, n);
+
+    ram_cold_pause();
+    qemu_mutex_lock(&ram_cold.lock);
+    if (runstate_is_running() && migration_is_idle()) {
+        ok = ram_cold_commit(c, n);
+    } else {
+        for (size_t k = 0; k < n; k++) {
+            g_free(c[k].data);
+        }
+    }
+    qemu_mutex_unlock(&ram_cold.lock);
+    ram_cold_resume();
+    return ok;
+}
+
+static void *ram_cold_thread(void *opaque)
+{
+    g_autofree RamColdCandidate *c = g_new(RamColdCandidate, RAM_COLD_BATCH);
+
+    rcu_register_thread();
+    qemu_mutex_lock(&ram_cold.lock);
+    for (;;) {
+        unsigned interval_ms, min_age;
+
+        while (!ram_cold.age_ms) {
+            qemu_cond_wait(&ram_cold.cond, &ram_cold.lock);
+        }
+        /* A page is idle after min_age scans without an access */
+        interval_ms = MAX(ram_cold.age_ms / 4, 1000);
+        min_age = MIN(DIV_ROUND_UP(ram_cold.age_ms, interval_ms), UINT8_MAX);
+        qemu_mutex_unlock(&ram_cold.lock);
+
+        stat64_inc(&ram_cold.passes);
+        memset(c, 0, sizeof(*c) * RAM_COLD_BATCH);
+        if (!ram_cold_pass(c, min_age)) {
+            warn_report("ram-cold: the browser can't discard wasm memory, "
+                        "stopping");
+            qemu_mutex_lock(&ram_cold.lock);
+            ram_cold.age_ms = 0;
+            continue;
+        }
+
+        qemu_mutex_lock(&ram_cold.lock);
+        if (ram_cold.age_ms) {
+            qemu_cond_timedwait(&ram_cold.cond, &ram_cold.lock, interval_ms);
+        }
+    }
+    return NULL;
+}
+
+void ram_cold_init(void)
+{
+    qemu_mutex_init(&ram_cold.lock);
+    qemu_cond_init(&ram_cold.cond);
+    QLIST_INIT(&ram_cold.regions);
+    ram_cold.notifier.ram_block_added = ram_cold_block_added;
+    ram_cold.notifier.ram_block_removed = ram_cold_block_removed;
+    ram_block_notifier_add(&ram_cold.notifier);
+}
+
+/*
+ * Called by the page to compress guest RAM idle for @seconds, or with 0
+ * to stop compressing; pages compressed so far stay so until accessed.
+ */
+EMSCRIPTEN_KEEPALIVE void qemu_ram_cold_set_age(unsigned seconds)
+{
+    qemu_mutex_lock(&ram_cold.lock);
+    ram_cold.age_ms = MIN(seconds, UINT_MAX / 1000) * 1000;
+    if (ram_cold.age_ms && !ram_cold.thread_running) {
+        ram_cold.thread_running = true;
+        qemu_thread_create(&ram_cold.thread, "ram-cold", ram_cold_thread,
+                           NULL, QEMU_THREAD_DETACHED);
+    }
+    qemu_cond_signal(&ram_cold.cond);
+    qemu_mutex_unlock(&ram_cold.lock);
+}
+
+/*
+ * Counters: scans since startup, pages compressed now and their size
+ * compressed, and pages inflated again since startup. The string stays
+ * valid until the next call.
+ */
+EMSCRIPTEN_KEEPALIVE const char *qemu_ram_cold_stats_json(void)
+{
+    static char *json;
+
+    g_free(json);
+    json = g_strdup_printf("{\"passes\":%" PRIu64 ",\"pages\":%zu"
+                           ",\"bytes\":%zu,\"faults\":%" PRIu64 "}",
+                           stat64_get(&ram_cold.passes),
+                           qatomic_read(&ram_cold.packed_pages),
+                           qatomic_read(&ram_cold.packed_bytes),
+                           stat64_get(&ram_cold.faults));
+    return json;
+}
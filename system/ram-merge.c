@@ -0,0 +1,267 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Zero page merging of guest RAM in the wasm memory
+ *
+ * A browser tab has no KSM. Guest RAM is a single allocation in the
+ * linear memory, so a page can't be remapped to share another one's
+ * frame, and the host pointers handed to devices for DMA bypass any
+ * copy-on-write state cputlb could keep. The one frame every guest page
+ * can share without that is the engine's zero page: a wasm page given
+ * back with WebAssembly.Memory.prototype.discard() reads as zeroes and
+ * is committed again on the next write, by the engine.
+ *
+ * A scanner thread walks the RAM of memory backends with merge=on and
+ * notes the wasm pages that are all zero, e.g. freed by a guest that
+ * clears pages on free, or its page-cache dropped. It then stops the
+ * vCPUs and block I/O, checks the pages again and discards them. The
+ * memory goes back to the browser rather than to QEMU's heap, since it
+ * stays inside the RAMBlock.
+ */
+
+#include "qemu/osdep.h"
+#include "block/block-global-state.h"
+#include "exec/ramblock.h"
+#include "qemu/bitmap.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/main-loop.h"
+#include "qemu/mmap-alloc.h"
+#include "qemu/queue.h"
+#include "qemu/stats64.h"
+#include "qemu/thread.h"
+#include "qemu/units.h"
+#include "sysemu/cpus.h"
+#include "sysemu/hostmem.h"
+#include "sysemu/runstate.h"
+
+#include <emscripten.h>
+
+/* Pages discarded with the vCPUs stopped at once, about 1 ms of checking */
+#define RAM_MERGE_BATCH 1024
+
+typedef struct RamMergeRegion {
+    uint8_t *host;
+    size_t pages;
+    /* Pages discarded and not seen written since */
+    unsigned long *merged;
+    /* Zero pages found by the last scan */
+    unsigned long *candidate;
+    QLIST_ENTRY(RamMergeRegion) next;
+} RamMergeRegion;
+
+static struct {
+    QemuMutex lock;
+    QemuCond cond;
+    QemuThread thread;
+    bool thread_running;
+    /* Period of the scans in ms, 0 while stopped; protected by lock */
+    unsigned interval_ms;
+    /* Protected by lock, which the scanner takes after the BQL */
+    QLIST_HEAD(, RamMergeRegion) regions;
+    RAMBlockNotifier notifier;
+    Stat64 passes;
+    Stat64 scanned;
+    Stat64 merged;
+} ram_merge;
+
+static bool ram_merge_block_ok(void *host)
+{
+    ram_addr_t offset;
+    RAMBlock *rb = qemu_ram_block_from_host(host, false, &offset);
+    Object *owner;
+
+    /* Only anonymous RAM is zero filled on first touch again */
+    if (!rb || rb->fd >= 0 || (rb->flags & (RAM_PREALLOC | RAM_SHARED))) {
+        return false;
+    }
+    owner = memory_region_owner(rb->mr);
+    return object_dynamic_cast(owner, TYPE_MEMORY_BACKEND) &&
+           MEMORY_BACKEND(owner)->merge;
+}
+
+static void ram_merge_block_added(RAMBlockNotifier *n, void *host,
+                                  size_t size, size_t max_size)
+{
+    uint8_t *start = QEMU_ALIGN_PTR_UP(host, WASM_PAGE_SIZE);
+    uint8_t *end = QEMU_ALIGN_PTR_DOWN((uint8_t *)host + size,
+                                       WASM_PAGE_SIZE);
+    RamMergeRegion *r;
+
+    if (start >= end || !ram_merge_block_ok(host)) {
+        return;
+    }
+    r = g_new0(RamMergeRegion, 1);
+    r->host = start;
+    r->pages = (end - start) / WASM_PAGE_SIZE;
+    r->merged = bitmap_new(r->pages);
+    r->candidate = bitmap_new(r->pages);
+
+    qemu_mutex_lock(&ram_merge.lock);
+    QLIST_INSERT_HEAD(&ram_merge.regions, r, next);
+    qemu_mutex_unlock(&ram_merge.lock);
+}
+
+static void ram_merge_block_removed(RAMBlockNotifier *n, void *host,
+                                    size_t size, size_t max_size)
+{
+    uint8_t *start = QEMU_ALIGN_PTR_UP(host, WASM_PAGE_SIZE);
+    RamMergeRegion *r;
+
+    qemu_mutex_lock(&ram_merge.lock);
+    QLIST_FOREACH(r, &ram_merge.regions, next) {
+        if (r->host == start) {
+            QLIST_REMOVE(r, next);
+            g_free(r->merged);
+            g_free(r->candidate);
+            g_free(r);
+            break;
+        }
+    }
+    qemu_mutex_unlock(&ram_merge.lock);
+}
+
+/* Looks for zero pages without stopping anyone, returns how many */
+static size_t ram_merge_scan(void)
+{
+    RamMergeRegion *r;
+    size_t found = 0;
+
+    qemu_mutex_lock(&ram_merge.lock);
+    QLIST_FOREACH(r, &ram_merge.regions, next) {
+        for (size_t i = 0; i < r->pages; i++) {
+            uint8_t *p = r->host + i * WASM_PAGE_SIZE;
+
+            if (!buffer_is_zero(p, WASM_PAGE_SIZE)) {
+                clear_bit(i, r->merged);
+            } else if (!test_bit(i, r->merged) && found < RAM_MERGE_BATCH) {
+                set_bit(i, r->candidate);
+                found++;
+            }
+        }
+        stat64_add(&ram_merge.scanned, r->pages * WASM_PAGE_SIZE);
+    }
+    qemu_mutex_unlock(&ram_merge.lock);
+    return found;
+}
+
+/*
+ * Discards the candidates that are still zero. The vCPUs and block
+ * requests are stopped and the BQL held meanwhile, so neither they nor
+ * the devices write to a page between the check and the discard. 9p
+ * reads done in the thread pool aren't waited for, a zero page they
+ * fill right then would be cleared. Returns false if the engine can't
+ * discard memory.
+ */
+static bool ram_merge_commit(void)
+{
+    RamMergeRegion *r;
+    bool ok = true;
+
+    qemu_mutex_lock_iothread();
+    pause_all_vcpus();
+    bdrv_drain_all_begin();
+
+    qemu_mutex_lock(&ram_merge.lock);
+    QLIST_FOREACH(r, &ram_merge.regions, next) {
+        size_t i;
+
+        for (i = find_first_bit(r->candidate, r->pages); i < r->pages;
+             i = find_next_bit(r->candidate, r->pages, i + 1)) {
+            uint8_t *p = r->host + i * WASM_PAGE_SIZE;
+
+            clear_bit(i, r->candidate);
+            if (!ok || !buffer_is_zero(p, WASM_PAGE_SIZE)) {
+                continue;
+            }
+            if (!qemu_ram_decommit(p, WASM_PAGE_SIZE)) {
+                ok = false;
+                continue;
+            }
+            set_bit(i, r->merged);
+            stat64_add(&ram_merge.merged, WASM_PAGE_SIZE);
+        }
+    }
+    qemu_mutex_unlock(&ram_merge.lock);
+
+    bdrv_drain_all_end();
+    /* Does nothing if the VM was stopped meanwhile */
+    resume_all_vcpus();
+    qemu_mutex_unlock_iothread();
+    return ok;
+}
+
+static void *ram_merge_thread(void *opaque)
+{
+    rcu_register_thread();
+    qemu_mutex_lock_iothread();
+    ram_block_notifier_add(&ram_merge.notifier);
+    qemu_mutex_unlock_iothread();
+
+    qemu_mutex_lock(&ram_merge.lock);
+    for (;;) {
+        while (!ram_merge.interval_ms) {
+            qemu_cond_wait(&ram_merge.cond, &ram_merge.lock);
+        }
+        qemu_mutex_unlock(&ram_merge.lock);
+
+        stat64_inc(&ram_merge.passes);
+        if (ram_merge_scan() && !ram_merge_commit()) {
+            warn_report("ram-merge: the browser can't discard wasm memory, "
+                        "stopping");
+            qemu_mutex_lock(&ram_merge.lock);
+            ram_merge.interval_ms = 0;
+            continue;
+        }
+
+        qemu_mutex_lock(&ram_merge.lock);
+        if (ram_merge.interval_ms) {
+            qemu_cond_timedwait(&ram_merge.cond, &ram_merge.lock,
+                                ram_merge.interval_ms);
+        }
+    }
+    return NULL;
+}
+
+static void __attribute__((constructor)) ram_merge_init(void)
+{
+    qemu_mutex_init(&ram_merge.lock);
+    qemu_cond_init(&ram_merge.cond);
+    QLIST_INIT(&ram_merge.regions);
+    ram_merge.notifier.ram_block_added = ram_merge_block_added;
+    ram_merge.notifier.ram_block_removed = ram_merge_block_removed;
+}
+
+/*
+ * Called by the page to scan guest RAM for zero pages every @interval_ms,
+ * or to stop with 0. Scans read all of guest RAM, so every few seconds
+ * is plenty; pages are only discarded after they were found zero.
+ */
+EMSCRIPTEN_KEEPALIVE void qemu_ram_merge_set_interval(unsigned interval_ms)
+{
+    qemu_mutex_lock(&ram_merge.lock);
+    ram_merge.interval_ms = interval_ms;
+    if (interval_ms && !ram_merge.thread_running) {
+        ram_merge.thread_running = true;
+        qemu_thread_create(&ram_merge.thread, "ram-merge", ram_merge_thread,
+                           NULL, QEMU_THREAD_DETACHED);
+    }
+    qemu_cond_signal(&ram_merge.cond);
+    qemu_mutex_unlock(&ram_merge.lock);
+}
+
+/*
+ * Counters since startup: scans, bytes of guest RAM they read, and bytes
+ * discarded. The string stays valid until the next call.
+ */
+EMSCRIPTEN_KEEPALIVE const char *qemu_ram_merge_stats_json(void)
+{
+    static char *json;
+
+    g_free(json);
+    json = g_strdup_printf("{\"passes\":%" PRIu64 ",\"scanned\":%" PRIu64
+                           ",\"merged\":%" PRIu64 "}",
+                           stat64_get(&ram_merge.passes),
+                           stat64_get(&ram_merge.scanned),
+                           stat64_get(&ram_merge.merged));
+    return json;
+}
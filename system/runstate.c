@@ -53,6 +53,9 @@
 #include "qom/object_interfaces.h"
 #include "sysemu/cpus.h"
 #include "sysemu/qtest.h"
+#ifdef EMSCRIPTEN
+#include "sysemu/ram-cold.h"
+#endif
 #include "sysemu/replay.h"
 #include "sysemu/reset.h"
 #include "sysemu/runstate.h"
@@ -820,6 +823,9 @@ void qemu_init_subsystems(void)
     runstate_init();
     precopy_infrastructure_init();
     postcopy_infrastructure_init();
+#ifdef EMSCRIPTEN
+    ram_cold_init();
+#endif
     monitor_init_globals();
 
     if (qcrypto_init(&err) < 0) {
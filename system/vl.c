@@ -3024,10 +3024,12 @@ void qemu_init(int argc, char **argv)
             case QEMU_OPTION_DFILTER:
                 qemu_set_dfilter_ranges(optarg, &error_fatal);
                 break;
-#if defined(CONFIG_TCG) && defined(CONFIG_LINUX)
+#if defined(CONFIG_TCG) && (defined(CONFIG_LINUX) || defined(EMSCRIPTEN))
             case QEMU_OPTION_perfmap:
                 perf_enable_perfmap();
                 break;
+#endif
+#if defined(CONFIG_TCG) && defined(CONFIG_LINUX)
             case QEMU_OPTION_jitdump:
                 perf_enable_jitdump();
                 break;
@@ -30,6 +30,7 @@
 #include "semihosting/common-semi.h"
 #endif
 #include "cpregs.h"
+#include "sabfs/syscall_offload.h"
 
 #define ARM_CPU_FREQ 1000000000 /* FIXME: 1 GHz, should be configurable */
 
@@ -11293,6 +11294,79 @@ static void tcg_handle_semihosting(CPUState *cs)
 }
 #endif
 
+#ifdef TARGET_AARCH64
+/* Page table base of EL0, which identifies the process */
+static uint64_t aarch64_syscall_asid(CPUARMState *env)
+{
+    return env->cp15.ttbr0_el[arm_hcr_el2_eff(env) & HCR_TGE ? 2 : 1];
+}
+
+static void aarch64_syscall_set_args(CPUARMState *env, const uint64_t *args)
+{
+    /* x0 holds the result */
+    for (int i = 1; i < 6; i++) {
+        env->xregs[i] = args[i];
+    }
+}
+
+/* Finishes an offloaded syscall that the kernel ran, see exception_return */
+void aarch64_syscall_offload_return(CPUARMState *env)
+{
+    uint64_t args[6];
+
+    if (syscall_offload_return(env_cpu(env), aarch64_syscall_asid(env),
+                               env->pc, env->xregs[31], env->xregs[0],
+                               args)) {
+        aarch64_syscall_set_args(env, args);
+    }
+}
+#endif
+
+#if defined(__EMSCRIPTEN__) && defined(TARGET_AARCH64)
+/*
+ * Serves an svc from AArch64 EL0 from SABFS if it is offloaded (see
+ * sabfs/syscall_offload.h), in which case no exception is taken.
+ */
+static bool aarch64_syscall_offload(CPUState *cs)
+{
+    CPUARMState *env = cpu_env(cs);
+    SyscallOffloadCall call = {
+        .cpu = cs,
+        .abi = &syscall_offload_aarch64,
+        .args = { env->xregs[0], env->xregs[1], env->xregs[2],
+                  env->xregs[3], env->xregs[4], env->xregs[5] },
+        .asid = aarch64_syscall_asid(env),
+        .pc = env->pc,
+        .sp = env->xregs[31],
+    };
+    uint32_t syndrome = env->exception.syndrome;
+    int64_t ret;
+    bool handled;
+
+    if (!is_a64(env) || arm_current_el(env) != 0) {
+        return false;
+    }
+    /*
+     * The svc is restarted if a guest buffer faults, which is then taken
+     * as a data abort at the svc with the syndrome of a plain access
+     */
+    env->pc -= 4;
+    env->exception.syndrome = 0;
+    handled = syscall_offload(&call, env->xregs[8], &ret);
+    env->pc += 4;
+    env->exception.syndrome = syndrome;
+
+    if (!handled) {
+        if (call.rewritten) {
+            aarch64_syscall_set_args(env, call.args);
+        }
+        return false;
+    }
+    env->xregs[0] = ret;
+    return true;
+}
+#endif
+
 /*
  * Handle a CPU exception for A and R profile CPUs.
  * Do any appropriate logging, handle PSCI calls, and then hand off
@@ -11339,6 +11413,13 @@ void arm_cpu_do_interrupt(CPUState *cs)
     }
 #endif
 
+#if defined(__EMSCRIPTEN__) && defined(TARGET_AARCH64)
+    /* File syscalls on SABFS, see syscall_offload() */
+    if (cs->exception_index == EXCP_SWI && aarch64_syscall_offload(cs)) {
+        return;
+    }
+#endif
+
     /*
      * Hooks may change global state so BQL should be held, also the
      * BQL needs to be held for any modification of
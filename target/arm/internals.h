@@ -235,6 +235,14 @@ static inline void aarch64_restore_sp(CPUARMState *env, int el)
     }
 }
 
+#if defined(TARGET_AARCH64) && !defined(CONFIG_USER_ONLY)
+/*
+ * Called on exception returns to AArch64 EL0 to finish a syscall that
+ * was offloaded to SABFS but run by the kernel (sabfs/syscall_offload.h)
+ */
+void aarch64_syscall_offload_return(CPUARMState *env);
+#endif
+
 static inline void update_spsel(CPUARMState *env, uint32_t imm)
 {
     unsigned int cur_el = arm_current_el(env);
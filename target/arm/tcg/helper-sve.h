@@ -958,18 +958,18 @@ DEF_HELPER_FLAGS_4(sve_umini_h, TCG_CALL_NO_RWG, void, ptr, ptr, i64, i32)
 DEF_HELPER_FLAGS_4(sve_umini_s, TCG_CALL_NO_RWG, void, ptr, ptr, i64, i32)
 DEF_HELPER_FLAGS_4(sve_umini_d, TCG_CALL_NO_RWG, void, ptr, ptr, i64, i32)
 
-DEF_HELPER_FLAGS_5(gvec_recps_h, TCG_CALL_NO_RWG,
+DEF_HELPER_FLAGS_5(gvec_recps_h, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
                    void, ptr, ptr, ptr, ptr, i32)
-DEF_HELPER_FLAGS_5(gvec_recps_s, TCG_CALL_NO_RWG,
+DEF_HELPER_FLAGS_5(gvec_recps_s, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
                    void, ptr, ptr, ptr, ptr, i32)
-DEF_HELPER_FLAGS_5(gvec_recps_d, TCG_CALL_NO_RWG,
+DEF_HELPER_FLAGS_5(gvec_recps_d, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
                    void, ptr, ptr, ptr, ptr, i32)
 
-DEF_HELPER_FLAGS_5(gvec_rsqrts_h, TCG_CALL_NO_RWG,
+DEF_HELPER_FLAGS_5(gvec_rsqrts_h, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
                    void, ptr, ptr, ptr, ptr, i32)
-DEF_HELPER_FLAGS_5(gvec_rsqrts_s, TCG_CALL_NO_RWG,
+DEF_HELPER_FLAGS_5(gvec_rsqrts_s, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
                    void, ptr, ptr, ptr, ptr, i32)
-DEF_HELPER_FLAGS_5(gvec_rsqrts_d, TCG_CALL_NO_RWG,
+DEF_HELPER_FLAGS_5(gvec_rsqrts_d, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
                    void, ptr, ptr, ptr, ptr, i32)
 
 DEF_HELPER_FLAGS_4(sve_faddv_h, TCG_CALL_NO_RWG,
@@ -2225,7 +2225,8 @@ static void handle_sys(DisasContext *s, bool isread,
         } else {
             tcg_rt = clean_data_tbi(s, cpu_reg(s, rt));
         }
-        gen_helper_dc_zva(tcg_env, tcg_rt);
+        tcg_gen_qemu_zero_block(tcg_rt, get_mem_index(s),
+                                s->dcz_blocksize + 2);
         return;
     case ARM_CP_DC_GVA:
         {
@@ -2254,7 +2255,8 @@ static void handle_sys(DisasContext *s, bool isread,
             /* For DC_GZVA, we can rely on DC_ZVA for the proper fault. */
             tcg_rt = cpu_reg(s, rt);
             clean_addr = clean_data_tbi(s, tcg_rt);
-            gen_helper_dc_zva(tcg_env, clean_addr);
+            tcg_gen_qemu_zero_block(clean_addr, get_mem_index(s),
+                                    s->dcz_blocksize + 2);
 
             if (s->ata[0]) {
                 /* Extract the tag from the register to match STZGM.  */
@@ -3746,7 +3748,8 @@ static bool trans_STZGM(DisasContext *s, arg_ldst_tag *a)
      */
     clean_addr = clean_data_tbi(s, addr);
     tcg_gen_andi_i64(clean_addr, clean_addr, -size);
-    gen_helper_dc_zva(tcg_env, clean_addr);
+    tcg_gen_qemu_zero_block(clean_addr, get_mem_index(s),
+                            s->dcz_blocksize + 2);
     return true;
 }
 
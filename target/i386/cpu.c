@@ -6467,6 +6467,17 @@ void cpu_x86_cpuid(CPUX86State *env, uint32_t index, uint32_t count,
          * CPUID code in kvm_arch_init_vcpu() ignores stuff
          * set here, but we restrict to TCG none the less.
          */
+#ifdef EMSCRIPTEN
+        if (tcg_enabled() && cpu->tcg_pvclock) {
+            /* guests look for kvmclock under the KVM signature */
+            memcpy(signature, "KVMKVMKVM\0\0\0", 12);
+            *eax = KVM_CPUID_FEATURES;
+            *ebx = signature[0];
+            *ecx = signature[1];
+            *edx = signature[2];
+            break;
+        }
+#endif
         if (tcg_enabled() && cpu->expose_tcg) {
             memcpy(signature, "TCGTCGTCGTCG", 12);
             *eax = 0x40000001;
@@ -6485,6 +6496,12 @@ void cpu_x86_cpuid(CPUX86State *env, uint32_t index, uint32_t count,
         *ebx = 0;
         *ecx = 0;
         *edx = 0;
+#ifdef EMSCRIPTEN
+        if (tcg_enabled() && cpu->tcg_pvclock) {
+            *eax = (1U << KVM_FEATURE_CLOCKSOURCE2) |
+                   (1U << KVM_FEATURE_CLOCKSOURCE_STABLE_BIT);
+        }
+#endif
         break;
     case 0x80000000:
         *eax = env->cpuid_xlevel;
@@ -7888,6 +7905,9 @@ static Property x86_cpu_properties[] = {
                      false),
     DEFINE_PROP_BOOL("vmware-cpuid-freq", X86CPU, vmware_cpuid_freq, true),
     DEFINE_PROP_BOOL("tcg-cpuid", X86CPU, expose_tcg, true),
+#ifdef EMSCRIPTEN
+    DEFINE_PROP_BOOL("tcg-pvclock", X86CPU, tcg_pvclock, true),
+#endif
     DEFINE_PROP_BOOL("x-migrate-smi-count", X86CPU, migrate_smi_count,
                      true),
     /*
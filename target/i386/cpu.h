@@ -1932,6 +1932,10 @@ struct ArchCPU {
     bool force_features;
     bool expose_kvm;
     bool expose_tcg;
+#ifdef EMSCRIPTEN
+    /* kvmclock for TCG guests, see tcg_pvclock_wrmsr() */
+    bool tcg_pvclock;
+#endif
     bool migratable;
     bool migrate_smi_count;
     bool max_features; /* Enable all supported features automatically */
@@ -2272,6 +2276,7 @@ void x86_stq_phys(CPUState *cs, hwaddr addr, uint64_t val);
 /* will be suppressed */
 void cpu_x86_update_cr0(CPUX86State *env, uint32_t new_cr0);
 void cpu_x86_update_cr3(CPUX86State *env, target_ulong new_cr3);
+void cpu_x86_write_cr3(CPUX86State *env, target_ulong new_cr3);
 void cpu_x86_update_cr4(CPUX86State *env, uint32_t new_cr4);
 void cpu_x86_update_dr7(CPUX86State *env, uint32_t new_dr7);
 
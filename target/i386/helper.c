@@ -175,6 +175,29 @@ void cpu_x86_update_cr3(CPUX86State *env, target_ulong new_cr3)
     }
 }
 
+/*
+ * A CR3 write by the guest: with CR4.PGE set, global pages stay in the
+ * TLB like on hardware, which saves refilling the kernel's mappings on
+ * every context switch. The nested and physical MMU indexes don't depend
+ * on CR3 and are kept as well.
+ */
+void cpu_x86_write_cr3(CPUX86State *env, target_ulong new_cr3)
+{
+    env->cr[3] = new_cr3;
+    if (env->cr[0] & CR0_PG_MASK) {
+        qemu_log_mask(CPU_LOG_MMU,
+                        "CR3 write: CR3=" TARGET_FMT_lx "\n", new_cr3);
+        if (env->cr[4] & CR4_PGE_MASK) {
+            tlb_flush_nonglobal_by_mmuidx(env_cpu(env),
+                                          (1 << MMU_KSMAP_IDX) |
+                                          (1 << MMU_USER_IDX) |
+                                          (1 << MMU_KNOSMAP_IDX));
+        } else {
+            tlb_flush(env_cpu(env));
+        }
+    }
+}
+
 void cpu_x86_update_cr4(CPUX86State *env, uint32_t new_cr4)
 {
     uint32_t hflags;
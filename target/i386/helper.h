@@ -58,6 +58,8 @@ DEF_HELPER_FLAGS_3(raise_interrupt, TCG_CALL_NO_WG, noreturn, env, int, int)
 DEF_HELPER_FLAGS_2(raise_exception, TCG_CALL_NO_WG, noreturn, env, int)
 DEF_HELPER_3(boundw, void, env, tl, int)
 DEF_HELPER_3(boundl, void, env, tl, int)
+DEF_HELPER_FLAGS_4(rep_movs, TCG_CALL_NO_YIELD, i32, env, tl, tl, i32)
+DEF_HELPER_FLAGS_3(rep_stos, TCG_CALL_NO_YIELD, i32, env, tl, i32)
 
 #ifndef CONFIG_USER_ONLY
 DEF_HELPER_1(rsm, void, env)
@@ -68,7 +70,7 @@ DEF_HELPER_FLAGS_1(single_step, TCG_CALL_NO_WG, noreturn, env)
 DEF_HELPER_1(rechecking_single_step, void, env)
 DEF_HELPER_1(cpuid, void, env)
 DEF_HELPER_FLAGS_1(rdpid, TCG_CALL_NO_WG, tl, env)
-DEF_HELPER_1(rdtsc, void, env)
+DEF_HELPER_FLAGS_1(rdtsc, TCG_CALL_NO_WG, i64, env)
 DEF_HELPER_FLAGS_1(rdpmc, TCG_CALL_NO_WG, noreturn, env)
 
 #ifndef CONFIG_USER_ONLY
@@ -127,24 +129,33 @@ DEF_HELPER_2(fmov_FT0_STN, void, env, int)
 DEF_HELPER_2(fmov_ST0_STN, void, env, int)
 DEF_HELPER_2(fmov_STN_ST0, void, env, int)
 DEF_HELPER_2(fxchg_ST0_STN, void, env, int)
-DEF_HELPER_1(fcom_ST0_FT0, void, env)
-DEF_HELPER_1(fucom_ST0_FT0, void, env)
+DEF_HELPER_FLAGS_1(fcom_ST0_FT0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD, void, env)
+DEF_HELPER_FLAGS_1(fucom_ST0_FT0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
+                   void, env)
 DEF_HELPER_1(fcomi_ST0_FT0, void, env)
 DEF_HELPER_1(fucomi_ST0_FT0, void, env)
-DEF_HELPER_1(fadd_ST0_FT0, void, env)
-DEF_HELPER_1(fmul_ST0_FT0, void, env)
-DEF_HELPER_1(fsub_ST0_FT0, void, env)
-DEF_HELPER_1(fsubr_ST0_FT0, void, env)
-DEF_HELPER_1(fdiv_ST0_FT0, void, env)
-DEF_HELPER_1(fdivr_ST0_FT0, void, env)
-DEF_HELPER_2(fadd_STN_ST0, void, env, int)
-DEF_HELPER_2(fmul_STN_ST0, void, env, int)
-DEF_HELPER_2(fsub_STN_ST0, void, env, int)
-DEF_HELPER_2(fsubr_STN_ST0, void, env, int)
-DEF_HELPER_2(fdiv_STN_ST0, void, env, int)
-DEF_HELPER_2(fdivr_STN_ST0, void, env, int)
-DEF_HELPER_1(fchs_ST0, void, env)
-DEF_HELPER_1(fabs_ST0, void, env)
+DEF_HELPER_FLAGS_1(fadd_ST0_FT0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD, void, env)
+DEF_HELPER_FLAGS_1(fmul_ST0_FT0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD, void, env)
+DEF_HELPER_FLAGS_1(fsub_ST0_FT0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD, void, env)
+DEF_HELPER_FLAGS_1(fsubr_ST0_FT0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
+                   void, env)
+DEF_HELPER_FLAGS_1(fdiv_ST0_FT0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD, void, env)
+DEF_HELPER_FLAGS_1(fdivr_ST0_FT0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
+                   void, env)
+DEF_HELPER_FLAGS_2(fadd_STN_ST0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
+                   void, env, int)
+DEF_HELPER_FLAGS_2(fmul_STN_ST0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
+                   void, env, int)
+DEF_HELPER_FLAGS_2(fsub_STN_ST0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
+                   void, env, int)
+DEF_HELPER_FLAGS_2(fsubr_STN_ST0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
+                   void, env, int)
+DEF_HELPER_FLAGS_2(fdiv_STN_ST0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
+                   void, env, int)
+DEF_HELPER_FLAGS_2(fdivr_STN_ST0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD,
+                   void, env, int)
+DEF_HELPER_FLAGS_1(fchs_ST0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD, void, env)
+DEF_HELPER_FLAGS_1(fabs_ST0, TCG_CALL_NO_RWG | TCG_CALL_NO_YIELD, void, env)
 DEF_HELPER_1(fxam_ST0, void, env)
 DEF_HELPER_1(fld1_ST0, void, env)
 DEF_HELPER_1(fldl2t_ST0, void, env)
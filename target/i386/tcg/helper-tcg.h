@@ -99,6 +99,16 @@ G_NORETURN void cpu_vmexit(CPUX86State *nenv, uint32_t exit_code,
 void do_vmexit(CPUX86State *env);
 #endif
 
+/* sysemu/seg_helper.c */
+#ifndef CONFIG_USER_ONLY
+void x86_syscall_offload_return(CPUX86State *env);
+#endif
+
+/* sysemu/misc_helper.c */
+#ifndef CONFIG_USER_ONLY
+void x86_pio_cache_init(void);
+#endif
+
 /* seg_helper.c */
 void do_interrupt_x86_hardirq(CPUX86State *env, int intno, int is_hw);
 void do_interrupt_all(X86CPU *cpu, int intno, int is_int,
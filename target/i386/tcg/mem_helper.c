@@ -55,3 +55,138 @@ void helper_boundl(CPUX86State *env, target_ulong a0, int v)
         raise_exception_ra(env, EXCP05_BOUND, GETPC());
     }
 }
+
+/*
+ * Bulk iterations of rep movs and rep stos. The translator passes the
+ * linear addresses of the first iteration and desc = ot | aflag << 2,
+ * the helper reads ECX, ESI and EDI from env. As many iterations as stay
+ * within a page of RAM for each address, and within the wrap-around of
+ * the address registers, are done at once and the registers advanced.
+ * Returns 0 without doing anything when that is not possible, the
+ * translated code then does one iteration the usual way, which takes the
+ * fault, crosses the page or goes to MMIO.
+ */
+static target_ulong rep_count(CPUX86State *env, int aflag)
+{
+    switch (aflag) {
+    case MO_16:
+        return env->regs[R_ECX] & 0xffff;
+    case MO_32:
+        return (uint32_t)env->regs[R_ECX];
+    default:
+        return env->regs[R_ECX];
+    }
+}
+
+/* Iterations of size 1 << ot from reg and linear address addr */
+static target_ulong rep_room(target_ulong reg, target_ulong addr,
+                             int aflag, int ot)
+{
+    target_ulong n = -(addr | TARGET_PAGE_MASK) >> ot;
+
+    switch (aflag) {
+    case MO_16:
+        return MIN(n, (0x10000 - (reg & 0xffff)) >> ot);
+    case MO_32:
+        return MIN(n, (0x100000000ULL - (uint32_t)reg) >> ot);
+    default:
+        return n;
+    }
+}
+
+static target_ulong rep_reg_add(target_ulong reg, int aflag, target_ulong n)
+{
+    switch (aflag) {
+    case MO_16:
+        return deposit64(reg, 0, 16, reg + n);
+    case MO_32:
+        return (uint32_t)(reg + n);
+    default:
+        return reg + n;
+    }
+}
+
+/* The host address of len bytes of RAM at addr, or NULL */
+static void *rep_probe(CPUX86State *env, target_ulong addr, int len,
+                       MMUAccessType access_type, uintptr_t ra)
+{
+    void *host;
+    int flags = probe_access_flags(env, addr, len, access_type,
+                                   cpu_mmu_index(env, false), true,
+                                   &host, ra);
+
+#ifdef CONFIG_USER_ONLY
+    /* pages with translated code are write protected, leave them to stores */
+    if (access_type == MMU_DATA_STORE && !(page_get_flags(addr) & PAGE_WRITE)) {
+        return NULL;
+    }
+#endif
+    return flags ? NULL : host;
+}
+
+uint32_t helper_rep_movs(CPUX86State *env, target_ulong dst,
+                         target_ulong src, uint32_t desc)
+{
+    int ot = desc & 3, aflag = desc >> 2;
+    target_ulong n, len;
+    uint8_t *d, *s;
+
+    if (env->df != 1) {
+        return 0;
+    }
+    n = rep_count(env, aflag);
+    n = MIN(n, rep_room(env->regs[R_ESI], src, aflag, ot));
+    n = MIN(n, rep_room(env->regs[R_EDI], dst, aflag, ot));
+    if (n == 0) {
+        return 0;
+    }
+    len = n << ot;
+
+    s = rep_probe(env, src, len, MMU_DATA_LOAD, GETPC());
+    d = s ? rep_probe(env, dst, len, MMU_DATA_STORE, GETPC()) : NULL;
+    /* a forward copy onto the part not read yet repeats the data */
+    if (!d || (d > s && d < s + len)) {
+        return 0;
+    }
+    memmove(d, s, len);
+
+    env->regs[R_ESI] = rep_reg_add(env->regs[R_ESI], aflag, len);
+    env->regs[R_EDI] = rep_reg_add(env->regs[R_EDI], aflag, len);
+    env->regs[R_ECX] = rep_reg_add(env->regs[R_ECX], aflag, -n);
+    return 1;
+}
+
+uint32_t helper_rep_stos(CPUX86State *env, target_ulong dst, uint32_t desc)
+{
+    int ot = desc & 3, aflag = desc >> 2;
+    uint64_t val = env->regs[R_EAX];
+    target_ulong n, len;
+    uint8_t *d;
+
+    if (env->df != 1) {
+        return 0;
+    }
+    n = rep_count(env, aflag);
+    n = MIN(n, rep_room(env->regs[R_EDI], dst, aflag, ot));
+    if (n == 0) {
+        return 0;
+    }
+    len = n << ot;
+
+    d = rep_probe(env, dst, len, MMU_DATA_STORE, GETPC());
+    if (!d) {
+        return 0;
+    }
+    val = extract64(val, 0, 8 << ot);
+    if (val == (uint8_t)val * (0x0101010101010101ULL >> (64 - (8 << ot)))) {
+        memset(d, val, len);
+    } else {
+        for (target_ulong i = 0; i < len; i += 1 << ot) {
+            stn_le_p(d + i, 1 << ot, val);
+        }
+    }
+
+    env->regs[R_EDI] = rep_reg_add(env->regs[R_EDI], aflag, len);
+    env->regs[R_ECX] = rep_reg_add(env->regs[R_ECX], aflag, -n);
+    return 1;
+}
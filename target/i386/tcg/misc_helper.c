@@ -61,18 +61,18 @@ void helper_cpuid(CPUX86State *env)
     env->regs[R_EDX] = edx;
 }
 
-void helper_rdtsc(CPUX86State *env)
+/*
+ * Returns the TSC, split into EDX:EAX by the translator: leaving the
+ * registers to it spares reloading all globals after the call.
+ */
+uint64_t helper_rdtsc(CPUX86State *env)
 {
-    uint64_t val;
-
     if ((env->cr[4] & CR4_TSD_MASK) && ((env->hflags & HF_CPL_MASK) != 0)) {
         raise_exception_ra(env, EXCP0D_GPF, GETPC());
     }
     cpu_svm_check_intercept_param(env, SVM_EXIT_RDTSC, 0, GETPC());
 
-    val = cpu_get_tsc(env) + env->tsc_offset;
-    env->regs[R_EAX] = (uint32_t)(val);
-    env->regs[R_EDX] = (uint32_t)(val >> 32);
+    return cpu_get_tsc(env) + env->tsc_offset;
 }
 
 G_NORETURN void helper_rdpmc(CPUX86State *env)
@@ -421,7 +421,7 @@ static int switch_tss_ra(CPUX86State *env, int tss_selector,
     env->tr.flags = e2 & ~DESC_TSS_BUSY_MASK;
 
     if ((type & 8) && (env->cr[0] & CR0_PG_MASK)) {
-        cpu_x86_update_cr3(env, new_cr3);
+        cpu_x86_write_cr3(env, new_cr3);
     }
 
     /* load all registers without an exception, then reload them with
@@ -1018,6 +1018,9 @@ void helper_sysret(CPUX86State *env, int dflag)
                                DESC_G_MASK | DESC_B_MASK | DESC_P_MASK |
                                DESC_S_MASK | (3 << DESC_DPL_SHIFT) |
                                DESC_W_MASK | DESC_A_MASK);
+#ifndef CONFIG_USER_ONLY
+        x86_syscall_offload_return(env);
+#endif
     } else
 #endif
     {
@@ -2144,6 +2147,12 @@ void helper_iret_protected(CPUX86State *env, int shift, int next_eip)
         helper_ret_protected(env, shift, 1, 0, GETPC());
     }
     env->hflags2 &= ~HF2_NMI_MASK;
+#ifndef CONFIG_USER_ONLY
+    /* the kernel returns from syscalls with iret when it can't sysret */
+    if ((env->hflags & HF_CPL_MASK) == 3) {
+        x86_syscall_offload_return(env);
+    }
+#endif
 }
 
 void helper_lret_protected(CPUX86State *env, int shift, int addend)
@@ -36,6 +36,7 @@ typedef struct TranslateResult {
     hwaddr paddr;
     int prot;
     int page_size;
+    bool global;
 } TranslateResult;
 
 typedef enum TranslateFaultStage2 {
@@ -467,6 +468,7 @@ do_check_protect_pse36:
     out->paddr = paddr;
     out->prot = prot;
     out->page_size = page_size;
+    out->global = pte & PG_GLOBAL_MASK;
     return true;
 
  do_fault_rsvd:
@@ -552,6 +554,7 @@ static bool get_physical_address(CPUX86State *env, vaddr addr,
                 err->stage2 = S2_GPA;
                 return false;
             }
+            out->global = false;
             return true;
         }
         break;
@@ -575,7 +578,12 @@ static bool get_physical_address(CPUX86State *env, vaddr addr,
                     return false;
                 }
             }
-            return mmu_translate(env, &in, out, err);
+            if (!mmu_translate(env, &in, out, err)) {
+                return false;
+            }
+            /* Global pages survive CR3 writes only with CR4.PGE */
+            out->global &= !use_stage2 && (env->cr[4] & CR4_PGE_MASK);
+            return true;
         }
         break;
     }
@@ -590,6 +598,7 @@ static bool get_physical_address(CPUX86State *env, vaddr addr,
 #endif
     out->prot = PAGE_READ | PAGE_WRITE | PAGE_EXEC;
     out->page_size = TARGET_PAGE_SIZE;
+    out->global = false;
     return true;
 }
 
@@ -602,15 +611,20 @@ bool x86_cpu_tlb_fill(CPUState *cs, vaddr addr, int size,
     TranslateFault err;
 
     if (get_physical_address(env, addr, access_type, mmu_idx, &out, &err)) {
+        CPUTLBEntryFull full = {
+            .phys_addr = out.paddr & TARGET_PAGE_MASK,
+            .attrs = cpu_get_mem_attrs(env),
+            .prot = out.prot,
+            .lg_page_size = ctz64(out.page_size),
+            .global = out.global,
+        };
+
         /*
          * Even if 4MB pages, we map only one 4KB page in the cache to
          * avoid filling it too fast.
          */
         assert(out.prot & (1 << access_type));
-        tlb_set_page_with_attrs(cs, addr & TARGET_PAGE_MASK,
-                                out.paddr & TARGET_PAGE_MASK,
-                                cpu_get_mem_attrs(env),
-                                out.prot, mmu_idx, out.page_size);
+        tlb_set_page_full(cs, mmu_idx, addr & TARGET_PAGE_MASK, &full);
         return true;
     }
 
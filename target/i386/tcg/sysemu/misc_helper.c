@@ -19,47 +19,171 @@
 
 #include "qemu/osdep.h"
 #include "qemu/main-loop.h"
+#include "qemu/timer.h"
 #include "cpu.h"
 #include "exec/helper-proto.h"
 #include "exec/cpu_ldst.h"
 #include "exec/address-spaces.h"
 #include "exec/exec-all.h"
+#include "exec/memory.h"
 #include "tcg/helper-tcg.h"
+#ifdef EMSCRIPTEN
+#include "standard-headers/asm-x86/kvm_para.h"
+#endif
+
+/*
+ * Port I/O dispatch cache
+ *
+ * Memory accesses to MMIO find their MemoryRegionSection through the TLB,
+ * but every in and out looks the port up in the FlatView of
+ * address_space_io again. Guests hit a few ports in tight loops (serial,
+ * PIT, legacy virtio notify), so each vCPU thread remembers the region
+ * and offset for the ports it used last. A listener on address_space_io
+ * invalidates all entries whenever its FlatView changes. The regions
+ * stay alive for as long as the vCPU is in its RCU critical section, as
+ * they do for the FlatView's own lookup cache.
+ */
+#define X86_PIO_CACHE_BITS 6
+#define X86_PIO_CACHE_SIZE (1 << X86_PIO_CACHE_BITS)
+
+typedef struct X86PIOCacheEntry {
+    MemoryRegion *mr;
+    uint32_t port;      /* first port served by mr */
+    uint32_t len;       /* number of ports from there on */
+    hwaddr xlat;        /* offset of port in mr */
+    unsigned gen;
+} X86PIOCacheEntry;
+
+static unsigned x86_pio_cache_gen = 1;
+static __thread X86PIOCacheEntry x86_pio_cache[X86_PIO_CACHE_SIZE];
+
+static void x86_pio_cache_commit(MemoryListener *listener)
+{
+    qatomic_inc(&x86_pio_cache_gen);
+}
+
+static MemoryListener x86_pio_cache_listener = {
+    .name = "x86-pio-cache",
+    .commit = x86_pio_cache_commit,
+};
+
+void x86_pio_cache_init(void)
+{
+    static bool registered;
+
+    if (!registered) {
+        registered = true;
+        memory_listener_register(&x86_pio_cache_listener, &address_space_io);
+    }
+}
+
+static X86PIOCacheEntry *x86_pio_cache_lookup(uint32_t port, unsigned size,
+                                              MemTxAttrs attrs)
+{
+    X86PIOCacheEntry *e = &x86_pio_cache[port & (X86_PIO_CACHE_SIZE - 1)];
+    unsigned gen = qatomic_read(&x86_pio_cache_gen);
+    hwaddr len = 0x10000 - port;
+
+    if (e->gen == gen && port >= e->port &&
+        port - e->port + size <= e->len) {
+        return e;
+    }
+
+    RCU_READ_LOCK_GUARD();
+    e->mr = address_space_translate(&address_space_io, port, &e->xlat,
+                                    &len, false, attrs);
+    e->port = port;
+    e->len = len;
+    e->gen = e->len >= size ? gen : 0;
+    return e->gen ? e : NULL;
+}
+
+static void x86_pio_write(CPUX86State *env, uint32_t port, uint32_t data,
+                          MemOp op)
+{
+    MemTxAttrs attrs = cpu_get_mem_attrs(env);
+    X86PIOCacheEntry *e = x86_pio_cache_lookup(port, memop_size(op), attrs);
+    bool release_lock = false;
+
+    if (!e) {
+        uint8_t buf[4];
+
+        stn_le_p(buf, memop_size(op), data);
+        address_space_write(&address_space_io, port, attrs, buf,
+                            memop_size(op));
+        return;
+    }
+    if (!qemu_mutex_iothread_locked() && e->mr->global_locking) {
+        qemu_mutex_lock_iothread();
+        release_lock = true;
+    }
+    if (e->mr->flush_coalesced_mmio) {
+        qemu_flush_coalesced_mmio_buffer();
+    }
+    memory_region_dispatch_write(e->mr, e->xlat + port - e->port, data, op,
+                                 attrs);
+    if (release_lock) {
+        qemu_mutex_unlock_iothread();
+    }
+}
+
+static uint32_t x86_pio_read(CPUX86State *env, uint32_t port, MemOp op)
+{
+    MemTxAttrs attrs = cpu_get_mem_attrs(env);
+    X86PIOCacheEntry *e = x86_pio_cache_lookup(port, memop_size(op), attrs);
+    bool release_lock = false;
+    uint64_t val;
+
+    if (!e) {
+        uint8_t buf[4];
+
+        address_space_read(&address_space_io, port, attrs, buf,
+                           memop_size(op));
+        return ldn_le_p(buf, memop_size(op));
+    }
+    if (!qemu_mutex_iothread_locked() && e->mr->global_locking) {
+        qemu_mutex_lock_iothread();
+        release_lock = true;
+    }
+    if (e->mr->flush_coalesced_mmio) {
+        qemu_flush_coalesced_mmio_buffer();
+    }
+    memory_region_dispatch_read(e->mr, e->xlat + port - e->port, &val, op,
+                                attrs);
+    if (release_lock) {
+        qemu_mutex_unlock_iothread();
+    }
+    return val;
+}
 
 void helper_outb(CPUX86State *env, uint32_t port, uint32_t data)
 {
-    address_space_stb(&address_space_io, port, data,
-                      cpu_get_mem_attrs(env), NULL);
+    x86_pio_write(env, port, data, MO_UB);
 }
 
 target_ulong helper_inb(CPUX86State *env, uint32_t port)
 {
-    return address_space_ldub(&address_space_io, port,
-                              cpu_get_mem_attrs(env), NULL);
+    return x86_pio_read(env, port, MO_UB);
 }
 
 void helper_outw(CPUX86State *env, uint32_t port, uint32_t data)
 {
-    address_space_stw(&address_space_io, port, data,
-                      cpu_get_mem_attrs(env), NULL);
+    x86_pio_write(env, port, data, MO_LEUW);
 }
 
 target_ulong helper_inw(CPUX86State *env, uint32_t port)
 {
-    return address_space_lduw(&address_space_io, port,
-                              cpu_get_mem_attrs(env), NULL);
+    return x86_pio_read(env, port, MO_LEUW);
 }
 
 void helper_outl(CPUX86State *env, uint32_t port, uint32_t data)
 {
-    address_space_stl(&address_space_io, port, data,
-                      cpu_get_mem_attrs(env), NULL);
+    x86_pio_write(env, port, data, MO_LEUL);
 }
 
 target_ulong helper_inl(CPUX86State *env, uint32_t port)
 {
-    return address_space_ldl(&address_space_io, port,
-                             cpu_get_mem_attrs(env), NULL);
+    return x86_pio_read(env, port, MO_LEUL);
 }
 
 target_ulong helper_read_crN(CPUX86State *env, int reg)
@@ -104,7 +228,7 @@ void helper_write_crN(CPUX86State *env, int reg, target_ulong t0)
         if (!(env->efer & MSR_EFER_LMA)) {
             t0 &= 0xffffffffUL;
         }
-        cpu_x86_update_cr3(env, t0);
+        cpu_x86_write_cr3(env, t0);
         break;
     case 4:
         if (t0 & cr4_reserved_bits(env)) {
@@ -137,6 +261,74 @@ void helper_write_crN(CPUX86State *env, int reg, target_ulong t0)
     }
 }
 
+#ifdef EMSCRIPTEN
+/*
+ * kvmclock for TCG guests. On wasm hosts cpu_get_host_ticks() counts
+ * nanoseconds, so the guest TSC runs at 1 GHz and stops and starts along
+ * with QEMU_CLOCK_VIRTUAL, migrations included. One reading of both when
+ * the guest enables the clock therefore stays valid as long as it runs,
+ * and the guest takes TSC frequency and loops_per_jiffy from it instead
+ * of calibrating them against the PIT.
+ */
+#define TCG_PVCLOCK_TSC_STABLE_BIT (1 << 0)
+
+static void tcg_pvclock_write(CPUState *cs, hwaddr pa, uint64_t tsc,
+                              int64_t ns)
+{
+    uint32_t version = x86_ldl_phys(cs, pa) | 1;
+
+    /* layout of struct pvclock_vcpu_time_info, odd version while updating */
+    x86_stl_phys(cs, pa, version);
+    smp_wmb();
+    x86_stq_phys(cs, pa + 8, tsc);              /* tsc_timestamp */
+    x86_stq_phys(cs, pa + 16, ns);              /* system_time */
+    x86_stl_phys(cs, pa + 24, 0x80000000);      /* tsc_to_system_mul */
+    x86_stb_phys(cs, pa + 28, 1);               /* tsc_shift */
+    x86_stb_phys(cs, pa + 29, TCG_PVCLOCK_TSC_STABLE_BIT);
+    smp_wmb();
+    x86_stl_phys(cs, pa, version + 1);
+}
+
+static void tcg_pvclock_write_wall_clock(CPUState *cs, hwaddr pa, int64_t ns)
+{
+    int64_t boot = qemu_clock_get_ns(QEMU_CLOCK_HOST) - ns;
+    uint32_t version = x86_ldl_phys(cs, pa) | 1;
+
+    /* struct pvclock_wall_clock, the host time at system_time 0 */
+    x86_stl_phys(cs, pa, version);
+    smp_wmb();
+    x86_stl_phys(cs, pa + 4, boot / NANOSECONDS_PER_SECOND);
+    x86_stl_phys(cs, pa + 8, boot % NANOSECONDS_PER_SECOND);
+    smp_wmb();
+    x86_stl_phys(cs, pa, version + 1);
+}
+
+static bool tcg_pvclock_wrmsr(CPUX86State *env, uint32_t msr, uint64_t val)
+{
+    CPUState *cs = env_cpu(env);
+
+    if (!env_archcpu(env)->tcg_pvclock) {
+        return false;
+    }
+    switch (msr) {
+    case MSR_KVM_SYSTEM_TIME_NEW:
+        env->system_time_msr = val;
+        if (val & 1) {
+            tcg_pvclock_write(cs, val & ~1ULL,
+                              cpu_get_tsc(env) + env->tsc_offset,
+                              qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+        }
+        return true;
+    case MSR_KVM_WALL_CLOCK_NEW:
+        env->wall_clock_msr = val;
+        tcg_pvclock_write_wall_clock(cs, val,
+                                     qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+        return true;
+    }
+    return false;
+}
+#endif
+
 void helper_wrmsr(CPUX86State *env)
 {
     uint64_t val;
@@ -290,6 +482,11 @@ void helper_wrmsr(CPUX86State *env)
         cpu_sync_bndcs_hflags(env);
         break;
     default:
+#ifdef EMSCRIPTEN
+        if (tcg_pvclock_wrmsr(env, (uint32_t)env->regs[R_ECX], val)) {
+            break;
+        }
+#endif
         if ((uint32_t)env->regs[R_ECX] >= MSR_MC0_CTL
             && (uint32_t)env->regs[R_ECX] < MSR_MC0_CTL +
             (4 * env->mcg_cap & 0xff)) {
@@ -455,6 +652,14 @@ void helper_rdmsr(CPUX86State *env)
         val = (cs->nr_threads * cs->nr_cores) | (cs->nr_cores << 16);
         break;
     }
+#ifdef EMSCRIPTEN
+    case MSR_KVM_SYSTEM_TIME_NEW:
+        val = env->system_time_msr;
+        break;
+    case MSR_KVM_WALL_CLOCK_NEW:
+        val = env->wall_clock_msr;
+        break;
+#endif
     default:
         if ((uint32_t)env->regs[R_ECX] >= MSR_MC0_CTL
             && (uint32_t)env->regs[R_ECX] < MSR_MC0_CTL +
@@ -79,5 +79,7 @@ bool tcg_cpu_realizefn(CPUState *cs, Error **errp)
     /* ... SMRAM with higher priority, linked from /machine/smram.  */
     cpu->machine_done.notify = tcg_cpu_machine_done;
     qemu_add_machine_init_done_notifier(&cpu->machine_done);
+
+    x86_pio_cache_init();
     return true;
 }
@@ -1012,6 +1012,9 @@ static CCPrepare gen_prepare_eflags_s(DisasContext *s, TCGv reg)
 /* compute eflags.O to reg */
 static CCPrepare gen_prepare_eflags_o(DisasContext *s, TCGv reg)
 {
+    MemOp size;
+    TCGv t0, t1;
+
     switch (s->cc_op) {
     case CC_OP_ADOX:
     case CC_OP_ADCOX:
@@ -1019,7 +1022,38 @@ static CCPrepare gen_prepare_eflags_o(DisasContext *s, TCGv reg)
                              .mask = -1, .no_setcond = true };
     case CC_OP_CLR:
     case CC_OP_POPCNT:
+    case CC_OP_LOGICB ... CC_OP_LOGICQ:
         return (CCPrepare) { .cond = TCG_COND_NEVER, .mask = -1 };
+    case CC_OP_ADDB ... CC_OP_ADDQ:
+        /* (CC_SRC ^ src2 ^ -1) & (CC_SRC ^ CC_DST), src2 = CC_DST - CC_SRC */
+        size = s->cc_op - CC_OP_ADDB;
+        t0 = tcg_temp_new();
+        t1 = tcg_temp_new();
+        tcg_gen_sub_tl(t0, cpu_cc_dst, cpu_cc_src);
+        tcg_gen_eqv_tl(t0, t0, cpu_cc_src);
+        tcg_gen_xor_tl(t1, cpu_cc_src, cpu_cc_dst);
+        tcg_gen_and_tl(t0, t0, t1);
+        return (CCPrepare) { .cond = TCG_COND_NE, .reg = t0,
+                             .mask = (target_ulong)1 << ((8 << size) - 1) };
+    case CC_OP_SUBB ... CC_OP_SUBQ:
+        /* (src1 ^ CC_SRC) & (src1 ^ CC_DST), src1 = CC_DST + CC_SRC */
+        size = s->cc_op - CC_OP_SUBB;
+        t0 = tcg_temp_new();
+        t1 = tcg_temp_new();
+        tcg_gen_add_tl(t0, cpu_cc_dst, cpu_cc_src);
+        tcg_gen_xor_tl(t1, t0, cpu_cc_dst);
+        tcg_gen_xor_tl(t0, t0, cpu_cc_src);
+        tcg_gen_and_tl(t0, t0, t1);
+        return (CCPrepare) { .cond = TCG_COND_NE, .reg = t0,
+                             .mask = (target_ulong)1 << ((8 << size) - 1) };
+    case CC_OP_INCB ... CC_OP_INCQ:
+    case CC_OP_DECB ... CC_OP_DECQ:
+        /* CC_DST is the most negative (INC) or positive (DEC) value */
+        size = (s->cc_op - CC_OP_ADDB) & 3;
+        t0 = gen_ext_tl(tcg_temp_new(), cpu_cc_dst, size, false);
+        return (CCPrepare) { .cond = TCG_COND_EQ, .reg = t0, .mask = -1,
+                             .imm = ((target_ulong)1 << ((8 << size) - 1)) -
+                                    (s->cc_op >= CC_OP_DECB) };
     default:
         gen_compute_eflags(s);
         return (CCPrepare) { .cond = TCG_COND_NE, .reg = cpu_cc_src,
@@ -1054,6 +1088,85 @@ static CCPrepare gen_prepare_eflags_z(DisasContext *s, TCGv reg)
     }
 }
 
+/* store the 0/1 value of the condition prepared in 'cc' into 'reg' */
+static void gen_setcc_prepared(CCPrepare cc, TCGv reg)
+{
+    if (cc.no_setcond) {
+        if (cc.cond == TCG_COND_EQ) {
+            tcg_gen_xori_tl(reg, cc.reg, 1);
+        } else {
+            tcg_gen_mov_tl(reg, cc.reg);
+        }
+        return;
+    }
+
+    if (cc.cond == TCG_COND_NE && !cc.use_reg2 && cc.imm == 0 &&
+        cc.mask != 0 && (cc.mask & (cc.mask - 1)) == 0) {
+        tcg_gen_shri_tl(reg, cc.reg, ctztl(cc.mask));
+        tcg_gen_andi_tl(reg, reg, 1);
+        return;
+    }
+    if (cc.mask != -1) {
+        tcg_gen_andi_tl(reg, cc.reg, cc.mask);
+        cc.reg = reg;
+    }
+    if (cc.use_reg2) {
+        tcg_gen_setcond_tl(cc.cond, reg, cc.reg, cc.reg2);
+    } else {
+        tcg_gen_setcondi_tl(cc.cond, reg, cc.reg, cc.imm);
+    }
+}
+
+/*
+ * Whether C, Z, S and O can all be computed inline, so that conditions
+ * on several of them don't need the cc_compute_all helper.  For SUB the
+ * relational conditions are optimized separately.
+ */
+static bool cc_op_flags_inline(CCOp cc_op)
+{
+    switch (cc_op) {
+    case CC_OP_ADDB ... CC_OP_ADDQ:
+    case CC_OP_SUBB ... CC_OP_SUBQ:
+    case CC_OP_LOGICB ... CC_OP_LOGICQ:
+    case CC_OP_INCB ... CC_OP_INCQ:
+    case CC_OP_DECB ... CC_OP_DECQ:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* prepare JCC_BE, JCC_L or JCC_LE from the flags each computed inline */
+static CCPrepare gen_prepare_cc_inline(DisasContext *s, int jcc_op)
+{
+    TCGv t0 = tcg_temp_new();
+    TCGv t1 = tcg_temp_new();
+
+    switch (jcc_op) {
+    case JCC_BE:
+        /* C | Z */
+        gen_setcc_prepared(gen_prepare_eflags_c(s, t0), t0);
+        gen_setcc_prepared(gen_prepare_eflags_z(s, t1), t1);
+        tcg_gen_or_tl(t0, t0, t1);
+        break;
+    case JCC_L:
+    case JCC_LE:
+        /* S ^ O, or Z for JCC_LE */
+        gen_setcc_prepared(gen_prepare_eflags_o(s, t0), t0);
+        gen_setcc_prepared(gen_prepare_eflags_s(s, t1), t1);
+        tcg_gen_xor_tl(t0, t0, t1);
+        if (jcc_op == JCC_LE) {
+            gen_setcc_prepared(gen_prepare_eflags_z(s, t1), t1);
+            tcg_gen_or_tl(t0, t0, t1);
+        }
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    return (CCPrepare) { .cond = TCG_COND_NE, .reg = t0, .mask = -1,
+                         .no_setcond = true };
+}
+
 /* perform a conditional store into register 'reg' according to jump opcode
    value 'b'. In the fast case, T0 is guaranteed not to be used. */
 static CCPrepare gen_prepare_cc(DisasContext *s, int b, TCGv reg)
@@ -1111,6 +1224,10 @@ static CCPrepare gen_prepare_cc(DisasContext *s, int b, TCGv reg)
             cc = gen_prepare_eflags_z(s, reg);
             break;
         case JCC_BE:
+            if (cc_op_flags_inline(s->cc_op)) {
+                cc = gen_prepare_cc_inline(s, jcc_op);
+                break;
+            }
             gen_compute_eflags(s);
             cc = (CCPrepare) { .cond = TCG_COND_NE, .reg = cpu_cc_src,
                                .mask = CC_Z | CC_C };
@@ -1122,6 +1239,10 @@ static CCPrepare gen_prepare_cc(DisasContext *s, int b, TCGv reg)
             cc = gen_prepare_eflags_p(s, reg);
             break;
         case JCC_L:
+            if (cc_op_flags_inline(s->cc_op)) {
+                cc = gen_prepare_cc_inline(s, jcc_op);
+                break;
+            }
             gen_compute_eflags(s);
             if (reg == cpu_cc_src) {
                 reg = s->tmp0;
@@ -1133,6 +1254,10 @@ static CCPrepare gen_prepare_cc(DisasContext *s, int b, TCGv reg)
             break;
         default:
         case JCC_LE:
+            if (cc_op_flags_inline(s->cc_op)) {
+                cc = gen_prepare_cc_inline(s, jcc_op);
+                break;
+            }
             gen_compute_eflags(s);
             if (reg == cpu_cc_src) {
                 reg = s->tmp0;
@@ -1154,32 +1279,7 @@ static CCPrepare gen_prepare_cc(DisasContext *s, int b, TCGv reg)
 
 static void gen_setcc1(DisasContext *s, int b, TCGv reg)
 {
-    CCPrepare cc = gen_prepare_cc(s, b, reg);
-
-    if (cc.no_setcond) {
-        if (cc.cond == TCG_COND_EQ) {
-            tcg_gen_xori_tl(reg, cc.reg, 1);
-        } else {
-            tcg_gen_mov_tl(reg, cc.reg);
-        }
-        return;
-    }
-
-    if (cc.cond == TCG_COND_NE && !cc.use_reg2 && cc.imm == 0 &&
-        cc.mask != 0 && (cc.mask & (cc.mask - 1)) == 0) {
-        tcg_gen_shri_tl(reg, cc.reg, ctztl(cc.mask));
-        tcg_gen_andi_tl(reg, reg, 1);
-        return;
-    }
-    if (cc.mask != -1) {
-        tcg_gen_andi_tl(reg, cc.reg, cc.mask);
-        cc.reg = reg;
-    }
-    if (cc.use_reg2) {
-        tcg_gen_setcond_tl(cc.cond, reg, cc.reg, cc.reg2);
-    } else {
-        tcg_gen_setcondi_tl(cc.cond, reg, cc.reg, cc.imm);
-    }
+    gen_setcc_prepared(gen_prepare_cc(s, b, reg), reg);
 }
 
 static inline void gen_compute_eflags_c(DisasContext *s, TCGv reg)
@@ -1342,6 +1442,45 @@ static void gen_repz(DisasContext *s, MemOp ot,
     static inline void gen_repz_ ## op(DisasContext *s, MemOp ot) \
     { gen_repz(s, ot, gen_##op); }
 
+/*
+ * rep movs and rep stos first let a helper do the iterations that stay
+ * within a page of RAM at once, and do a single iteration only if it
+ * can't. Not with icount or when each iteration must end the TB.
+ */
+static void gen_repz_bulk(DisasContext *s, MemOp ot, bool movs)
+{
+    TCGv_i32 desc = tcg_constant_i32(ot | s->aflag << 2);
+    TCGLabel *l2, *done;
+
+    if (!s->jmp_opt || (tb_cflags(s->base.tb) & CF_USE_ICOUNT)) {
+        gen_repz(s, ot, movs ? gen_movs : gen_stos);
+        return;
+    }
+    gen_update_cc_op(s);
+    l2 = gen_jz_ecx_string(s);
+    done = gen_new_label();
+    gen_string_movl_A0_EDI(s);
+    if (movs) {
+        tcg_gen_mov_tl(s->T1, s->A0);
+        gen_string_movl_A0_ESI(s);
+        gen_helper_rep_movs(s->tmp2_i32, tcg_env, s->T1, s->A0, desc);
+    } else {
+        gen_helper_rep_stos(s->tmp2_i32, tcg_env, s->A0, desc);
+    }
+    tcg_gen_brcondi_i32(TCG_COND_NE, s->tmp2_i32, 0, done);
+    if (movs) {
+        gen_movs(s, ot);
+    } else {
+        gen_stos(s, ot);
+    }
+    gen_op_add_reg_im(s, s->aflag, R_ECX, -1);
+    gen_set_label(done);
+    if (s->repz_opt) {
+        gen_op_jz_ecx(s, l2);
+    }
+    gen_jmp_rel_csize(s, -cur_insn_len(s), 0);
+}
+
 static void gen_repz2(DisasContext *s, MemOp ot, int nz,
                       void (*fn)(DisasContext *s, MemOp ot))
 {
@@ -1362,8 +1501,6 @@ static void gen_repz2(DisasContext *s, MemOp ot, int nz,
     static inline void gen_repz_ ## op(DisasContext *s, MemOp ot, int nz) \
     { gen_repz2(s, ot, nz, gen_##op); }
 
-GEN_REPZ(movs)
-GEN_REPZ(stos)
 GEN_REPZ(lods)
 GEN_REPZ(ins)
 GEN_REPZ(outs)
@@ -2893,6 +3030,33 @@ static void gen_jmp_rel_csize(DisasContext *s, int diff, int tb_num)
     gen_jmp_rel(s, CODE32(s) ? MO_32 : MO_16, diff, tb_num);
 }
 
+/*
+ * Translate an unconditional jump to eip+diff by continuing the TB at the
+ * destination, if the jump goes forward within the first page of the TB.
+ * The skipped bytes stay within [pc_first, pc_next), so the TB is still
+ * invalidated by writes to any code it contains.  Only done on the wasm
+ * host, where every TB and every exit to the dispatcher is expensive.
+ */
+static bool gen_jmp_rel_extend(DisasContext *s, MemOp ot, int diff)
+{
+#ifdef EMSCRIPTEN
+    target_ulong mask = CODE64(s) ? -1 : ot == MO_16 ? 0xffff : 0xffffffff;
+    target_ulong new_pc = ((s->pc + diff - s->cs_base) & mask) + s->cs_base;
+
+    if (!CODE64(s)) {
+        new_pc = (uint32_t)new_pc;
+    }
+    if (!s->jmp_opt || diff < 0 || new_pc != s->pc + diff ||
+        !translator_use_goto_tb(&s->base, new_pc)) {
+        return false;
+    }
+    s->pc = new_pc;
+    return true;
+#else
+    return false;
+#endif
+}
+
 static inline void gen_ldq_env_A0(DisasContext *s, int offset)
 {
     tcg_gen_qemu_ld_i64(s->tmp1_i64, s->A0, s->mem_index, MO_LEUQ);
@@ -4921,7 +5085,7 @@ static bool disas_insn(DisasContext *s, CPUState *cpu)
     case 0xa5:
         ot = mo_b_d(b, dflag);
         if (prefixes & (PREFIX_REPZ | PREFIX_REPNZ)) {
-            gen_repz_movs(s, ot);
+            gen_repz_bulk(s, ot, true);
         } else {
             gen_movs(s, ot);
         }
@@ -4931,7 +5095,7 @@ static bool disas_insn(DisasContext *s, CPUState *cpu)
     case 0xab:
         ot = mo_b_d(b, dflag);
         if (prefixes & (PREFIX_REPZ | PREFIX_REPNZ)) {
-            gen_repz_stos(s, ot);
+            gen_repz_bulk(s, ot, false);
         } else {
             gen_stos(s, ot);
         }
@@ -5126,7 +5290,9 @@ static bool disas_insn(DisasContext *s, CPUState *cpu)
                         : (int16_t)insn_get(env, s, MO_16));
             gen_push_v(s, eip_next_tl(s));
             gen_bnd_jmp(s);
-            gen_jmp_rel(s, dflag, diff, 0);
+            if (!gen_jmp_rel_extend(s, dflag, diff)) {
+                gen_jmp_rel(s, dflag, diff, 0);
+            }
         }
         break;
     case 0x9a: /* lcall im */
@@ -5149,7 +5315,9 @@ static bool disas_insn(DisasContext *s, CPUState *cpu)
                         ? (int32_t)insn_get(env, s, MO_32)
                         : (int16_t)insn_get(env, s, MO_16));
             gen_bnd_jmp(s);
-            gen_jmp_rel(s, dflag, diff, 0);
+            if (!gen_jmp_rel_extend(s, dflag, diff)) {
+                gen_jmp_rel(s, dflag, diff, 0);
+            }
         }
         break;
     case 0xea: /* ljmp im */
@@ -5169,7 +5337,9 @@ static bool disas_insn(DisasContext *s, CPUState *cpu)
     case 0xeb: /* jmp Jb */
         {
             int diff = (int8_t)insn_get(env, s, MO_8);
-            gen_jmp_rel(s, dflag, diff, 0);
+            if (!gen_jmp_rel_extend(s, dflag, diff)) {
+                gen_jmp_rel(s, dflag, diff, 0);
+            }
         }
         break;
     case 0x70 ... 0x7f: /* jcc Jb */
@@ -5662,7 +5832,8 @@ static bool disas_insn(DisasContext *s, CPUState *cpu)
         gen_update_cc_op(s);
         gen_update_eip_cur(s);
         translator_io_start(&s->base);
-        gen_helper_rdtsc(tcg_env);
+        gen_helper_rdtsc(s->tmp1_i64, tcg_env);
+        tcg_gen_extr_i64_tl(cpu_regs[R_EAX], cpu_regs[R_EDX], s->tmp1_i64);
         break;
     case 0x133: /* rdpmc */
         gen_update_cc_op(s);
@@ -6126,7 +6297,9 @@ static bool disas_insn(DisasContext *s, CPUState *cpu)
             gen_update_cc_op(s);
             gen_update_eip_cur(s);
             translator_io_start(&s->base);
-            gen_helper_rdtsc(tcg_env);
+            gen_helper_rdtsc(s->tmp1_i64, tcg_env);
+            tcg_gen_extr_i64_tl(cpu_regs[R_EAX], cpu_regs[R_EDX],
+                                s->tmp1_i64);
             gen_helper_rdpid(s->T0, tcg_env);
             gen_op_mov_reg_v(s, dflag, R_ECX, s->T0);
             break;
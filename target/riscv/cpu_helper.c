@@ -32,6 +32,7 @@
 #include "cpu_bits.h"
 #include "debug.h"
 #include "tcg/oversized-guest.h"
+#include "sabfs/syscall_offload.h"
 
 int riscv_cpu_mmu_index(CPURISCVState *env, bool ifetch)
 {
@@ -1620,6 +1621,66 @@ static target_ulong riscv_transformed_insn(CPURISCVState *env,
 
     return xinsn;
 }
+
+#ifdef TARGET_RISCV64
+static void riscv_syscall_set_args(CPURISCVState *env, const uint64_t *args)
+{
+    /* a0 holds the result */
+    for (int i = 1; i < 6; i++) {
+        env->gpr[xA0 + i] = args[i];
+    }
+}
+
+/* Finishes an offloaded syscall that the kernel ran, see helper_sret */
+void riscv_syscall_offload_return(CPURISCVState *env, target_ulong pc)
+{
+    uint64_t args[6];
+
+    if (!env->virt_enabled && riscv_cpu_xlen(env) == 64 &&
+        syscall_offload_return(env_cpu(env), env->satp, pc, env->gpr[xSP],
+                               env->gpr[xA0], args)) {
+        riscv_syscall_set_args(env, args);
+    }
+}
+#else
+void riscv_syscall_offload_return(CPURISCVState *env, target_ulong pc)
+{
+}
+#endif
+
+#if defined(__EMSCRIPTEN__) && defined(TARGET_RISCV64)
+/*
+ * Serves an ecall from RV64 U-mode from SABFS if it is offloaded (see
+ * sabfs/syscall_offload.h), in which case no trap is taken. The pc stays
+ * at the ecall for it to be restarted if a guest buffer faults.
+ */
+static bool riscv_syscall_offload(CPURISCVState *env)
+{
+    SyscallOffloadCall call = {
+        .cpu = env_cpu(env),
+        .abi = &syscall_offload_riscv64,
+        .args = { env->gpr[xA0], env->gpr[xA1], env->gpr[xA2],
+                  env->gpr[xA3], env->gpr[xA4], env->gpr[xA5] },
+        .asid = env->satp,
+        .pc = env->pc + 4,
+        .sp = env->gpr[xSP],
+    };
+    int64_t ret;
+
+    if (env->virt_enabled || riscv_cpu_xlen(env) != 64) {
+        return false;
+    }
+    if (!syscall_offload(&call, env->gpr[xA7], &ret)) {
+        if (call.rewritten) {
+            riscv_syscall_set_args(env, call.args);
+        }
+        return false;
+    }
+    env->gpr[xA0] = ret;
+    env->pc = call.pc;
+    return true;
+}
+#endif
 #endif /* !CONFIG_USER_ONLY */
 
 /*
@@ -1725,6 +1786,14 @@ void riscv_cpu_do_interrupt(CPUState *cs)
                 cause = RISCV_EXCP_U_ECALL;
             }
         }
+
+#if defined(__EMSCRIPTEN__) && defined(TARGET_RISCV64)
+        /* File syscalls on SABFS, see syscall_offload() */
+        if (cause == RISCV_EXCP_U_ECALL && env->priv == PRV_U &&
+            riscv_syscall_offload(env)) {
+            return;
+        }
+#endif
     }
 
     trace_riscv_trap(env->mhartid, async, cause, env->pc, tval,
@@ -72,6 +72,12 @@ target_ulong fclass_d(uint64_t frs1);
 
 #ifndef CONFIG_USER_ONLY
 extern const VMStateDescription vmstate_riscv_cpu;
+
+/*
+ * Called on sret to U-mode at pc to finish a syscall that was offloaded
+ * to SABFS but run by the kernel (sabfs/syscall_offload.h)
+ */
+void riscv_syscall_offload_return(CPURISCVState *env, target_ulong pc);
 #endif
 
 enum {
@@ -312,6 +312,9 @@ target_ulong helper_sret(CPURISCVState *env)
     }
 
     riscv_cpu_set_mode(env, prev_priv);
+    if (prev_priv == PRV_U) {
+        riscv_syscall_offload_return(env, retpc);
+    }
 
     return retpc;
 }
@@ -45,6 +45,13 @@ typedef struct MemCopyInfo {
     TCGType type;
 } MemCopyInfo;
 
+/* A store to env whose bytes nothing may have read yet */
+typedef struct PendingStore {
+    IntervalTreeNode itree;
+    QSIMPLEQ_ENTRY (PendingStore) next;
+    TCGOp *op;
+} PendingStore;
+
 typedef struct TempOptInfo {
     bool is_const;
     TCGTemp *prev_copy;
@@ -63,6 +70,9 @@ typedef struct OptContext {
     IntervalTreeRoot mem_copy;
     QSIMPLEQ_HEAD(, MemCopyInfo) mem_free;
 
+    IntervalTreeRoot st_pending;
+    QSIMPLEQ_HEAD(, PendingStore) st_free;
+
     /* In flight values from optimization. */
     uint64_t a_mask;  /* mask bit is 0 iff value identical to first input */
     uint64_t z_mask;  /* mask bit is 0 iff value bit is 0 */
@@ -210,6 +220,73 @@ static void remove_mem_copy_all(OptContext *ctx)
     tcg_debug_assert(interval_tree_is_empty(&ctx->mem_copy));
 }
 
+/*
+ * Block-local dead store elimination: a store to env is removed when a
+ * later store of the same basic block covers all of its bytes and nothing
+ * in between may have read them. Ending the block, calls and guest memory
+ * accesses, which may raise an exception, and loads that may alias env
+ * forget all pending stores.
+ */
+static void remove_pending_st(OptContext *ctx, PendingStore *ps)
+{
+    interval_tree_remove(&ps->itree, &ctx->st_pending);
+    QSIMPLEQ_INSERT_TAIL(&ctx->st_free, ps, next);
+}
+
+static void remove_pending_st_in(OptContext *ctx, intptr_t s, intptr_t l)
+{
+    IntervalTreeNode *r;
+
+    while ((r = interval_tree_iter_first(&ctx->st_pending, s, l)) != NULL) {
+        remove_pending_st(ctx, container_of(r, PendingStore, itree));
+    }
+}
+
+static void remove_pending_st_all(OptContext *ctx)
+{
+    remove_pending_st_in(ctx, 0, -1);
+    tcg_debug_assert(interval_tree_is_empty(&ctx->st_pending));
+}
+
+static void record_pending_st(OptContext *ctx, TCGOp *op,
+                              intptr_t start, intptr_t last)
+{
+    IntervalTreeNode *r, *r_next;
+    PendingStore *ps;
+
+    for (r = interval_tree_iter_first(&ctx->st_pending, start, last);
+         r; r = r_next) {
+        r_next = interval_tree_iter_next(r, start, last);
+        if (r->start >= start && r->last <= last) {
+            ps = container_of(r, PendingStore, itree);
+            tcg_op_remove(ctx->tcg, ps->op);
+            remove_pending_st(ctx, ps);
+        }
+    }
+
+    ps = QSIMPLEQ_FIRST(&ctx->st_free);
+    if (ps) {
+        QSIMPLEQ_REMOVE_HEAD(&ctx->st_free, next);
+    } else {
+        ps = tcg_malloc(sizeof(*ps));
+    }
+    memset(ps, 0, sizeof(*ps));
+    ps->itree.start = start;
+    ps->itree.last = last;
+    ps->op = op;
+    interval_tree_insert(&ps->itree, &ctx->st_pending);
+}
+
+/* A load at ofs from base reads lm1 + 1 bytes */
+static void observe_tcg_ld(OptContext *ctx, TCGOp *op, intptr_t lm1)
+{
+    if (op->args[1] != tcgv_ptr_arg(tcg_env)) {
+        remove_pending_st_all(ctx);
+    } else {
+        remove_pending_st_in(ctx, op->args[2], op->args[2] + lm1);
+    }
+}
+
 static TCGTemp *find_better_copy(TCGTemp *ts)
 {
     TCGTemp *i, *ret;
@@ -1365,6 +1442,9 @@ static bool fold_call(OptContext *ctx, TCGOp *op)
         remove_mem_copy_all(ctx);
     }
 
+    /* Any helper may read env, or raise an exception which does. */
+    remove_pending_st_all(ctx);
+
     /* Reset temp data for outputs. */
     for (i = 0; i < nb_oargs; i++) {
         reset_temp(ctx, op->args[i]);
@@ -1921,6 +2001,8 @@ static bool fold_qemu_ld(OptContext *ctx, TCGOp *op)
 
     /* Opcodes that touch guest memory stop the mb optimization.  */
     ctx->prev_mb = NULL;
+    /* A fault exits the TB with the stores to env done so far. */
+    remove_pending_st_all(ctx);
     return false;
 }
 
@@ -1928,6 +2010,7 @@ static bool fold_qemu_st(OptContext *ctx, TCGOp *op)
 {
     /* Opcodes that touch guest memory stop the mb optimization.  */
     ctx->prev_mb = NULL;
+    remove_pending_st_all(ctx);
     return false;
 }
 
@@ -2209,24 +2292,30 @@ static bool fold_tcg_ld(OptContext *ctx, TCGOp *op)
     switch (op->opc) {
     CASE_OP_32_64(ld8s):
         ctx->s_mask = MAKE_64BIT_MASK(8, 56);
+        observe_tcg_ld(ctx, op, 0);
         break;
     CASE_OP_32_64(ld8u):
         ctx->z_mask = MAKE_64BIT_MASK(0, 8);
         ctx->s_mask = MAKE_64BIT_MASK(9, 55);
+        observe_tcg_ld(ctx, op, 0);
         break;
     CASE_OP_32_64(ld16s):
         ctx->s_mask = MAKE_64BIT_MASK(16, 48);
+        observe_tcg_ld(ctx, op, 1);
         break;
     CASE_OP_32_64(ld16u):
         ctx->z_mask = MAKE_64BIT_MASK(0, 16);
         ctx->s_mask = MAKE_64BIT_MASK(17, 47);
+        observe_tcg_ld(ctx, op, 1);
         break;
     case INDEX_op_ld32s_i64:
         ctx->s_mask = MAKE_64BIT_MASK(32, 32);
+        observe_tcg_ld(ctx, op, 3);
         break;
     case INDEX_op_ld32u_i64:
         ctx->z_mask = MAKE_64BIT_MASK(0, 32);
         ctx->s_mask = MAKE_64BIT_MASK(33, 31);
+        observe_tcg_ld(ctx, op, 3);
         break;
     default:
         g_assert_not_reached();
@@ -2240,6 +2329,7 @@ static bool fold_tcg_ld_memcopy(OptContext *ctx, TCGOp *op)
     intptr_t ofs;
     TCGType type;
 
+    observe_tcg_ld(ctx, op, tcg_type_size(ctx->type) - 1);
     if (op->args[1] != tcgv_ptr_arg(tcg_env)) {
         return false;
     }
@@ -2288,6 +2378,7 @@ static bool fold_tcg_st(OptContext *ctx, TCGOp *op)
         g_assert_not_reached();
     }
     remove_mem_copy_in(ctx, ofs, ofs + lm1);
+    record_pending_st(ctx, op, ofs, ofs + lm1);
     return false;
 }
 
@@ -2321,6 +2412,7 @@ static bool fold_tcg_st_memcopy(OptContext *ctx, TCGOp *op)
     last = ofs + tcg_type_size(type) - 1;
     remove_mem_copy_in(ctx, ofs, last);
     record_mem_copy(ctx, type, src, ofs, last);
+    record_pending_st(ctx, op, ofs, last);
     return false;
 }
 
@@ -2348,6 +2440,7 @@ void tcg_optimize(TCGContext *s)
     OptContext ctx = { .tcg = s };
 
     QSIMPLEQ_INIT(&ctx.mem_free);
+    QSIMPLEQ_INIT(&ctx.st_free);
 
     /* Array VALS has an element for each temp.
        If this temp holds a constant then its value is kept in VALS' element.
@@ -2371,6 +2464,9 @@ void tcg_optimize(TCGContext *s)
         }
 
         def = &tcg_op_defs[opc];
+        if (def->flags & TCG_OPF_BB_END) {
+            remove_pending_st_all(&ctx);
+        }
         init_arguments(&ctx, op, def->nb_oargs + def->nb_iargs);
         copy_propagate(&ctx, op, def->nb_oargs, def->nb_iargs);
 
@@ -2485,6 +2581,9 @@ void tcg_optimize(TCGContext *s)
         case INDEX_op_st_vec:
             done = fold_tcg_st_memcopy(&ctx, op);
             break;
+        case INDEX_op_dupm_vec:
+            remove_pending_st_all(&ctx);
+            break;
         case INDEX_op_mb:
             done = fold_mb(&ctx, op);
             break;
@@ -29,6 +29,7 @@
 #include "qemu/memalign.h"
 #include "qemu/cacheinfo.h"
 #include "qemu/qtree.h"
+#include "qemu/rcu.h"
 #include "qapi/error.h"
 #include "tcg/tcg.h"
 #include "exec/translation-block.h"
@@ -70,12 +71,37 @@ struct tcg_region_state {
     size_t total_size; /* size of entire buffer, >= n * stride */
 
     /* fields protected by the lock */
-    size_t current; /* current region index */
+    size_t *free; /* ring of regions not in use, in the order they freed up */
+    size_t free_head;
+    size_t free_num;
+    size_t *full; /* ring of full regions, in the order they filled up */
+    size_t full_head;
+    size_t full_num;
+    size_t retiring; /* retired regions waiting for a grace period */
+    unsigned epoch; /* bumped by tcg_region_reset_all */
     size_t agg_size_full; /* aggregate size of full regions */
+
+    /*
+     * Retire the oldest full region once fewer than retire_low regions
+     * are free or on their way, 0 if code is only dropped by tb_flush.
+     */
+    size_t retire_low;
+    bool want_retire;
 };
 
 static struct tcg_region_state region;
 
+/*
+ * Generation of the code in each region: odd while the region is being
+ * retired, and bumped to the next even value once it is reused or the
+ * whole buffer is flushed. Caches keyed by code addresses keep the
+ * generation along with an address and drop the entry once it changed.
+ * tcg_region_gen_changes counts the bumps, so that they needn't look
+ * at each entry before something changed.
+ */
+static uint32_t *region_gens;
+unsigned tcg_region_gen_changes;
+
 /*
  * This is an array of struct tcg_region_tree's, with padding.
  * We use void * to simplify the computation of region_trees[i]; each
@@ -191,10 +217,9 @@ static void tcg_region_trees_init(void)
     }
 }
 
-static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+/* Returns the index of the region of @p or -1 if it isn't in the buffer */
+static ssize_t tc_ptr_to_region_idx(const void *p)
 {
-    size_t region_idx;
-
     /*
      * Like tcg_splitwx_to_rw, with no assert.  The pc may come from
      * a signal handler over which the caller has no control.
@@ -202,24 +227,42 @@ static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
     if (!in_code_gen_buffer(p)) {
         p -= tcg_splitwx_diff;
         if (!in_code_gen_buffer(p)) {
-            return NULL;
+            return -1;
         }
     }
 
     if (p < region.start_aligned) {
-        region_idx = 0;
+        return 0;
     } else {
         ptrdiff_t offset = p - region.start_aligned;
 
         if (offset > region.stride * (region.n - 1)) {
-            region_idx = region.n - 1;
-        } else {
-            region_idx = offset / region.stride;
+            return region.n - 1;
         }
+        return offset / region.stride;
+    }
+}
+
+static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+{
+    ssize_t region_idx = tc_ptr_to_region_idx(p);
+
+    if (region_idx < 0) {
+        return NULL;
     }
     return region_trees + region_idx * tree_size;
 }
 
+uint32_t tcg_region_gen(const void *p)
+{
+    ssize_t region_idx = tc_ptr_to_region_idx(p);
+
+    if (region_idx < 0) {
+        return 0;
+    }
+    return qatomic_read(&region_gens[region_idx]);
+}
+
 void tcg_tb_insert(TranslationBlock *tb)
 {
     struct tcg_region_tree *rt = tc_ptr_to_region_tree(tb->tc.ptr);
@@ -357,13 +400,27 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
     s->code_gen_highwater = end - TCG_HIGHWATER;
 }
 
+static void tcg_region_update_retire__locked(void)
+{
+    qatomic_set(&region.want_retire,
+                region.full_num > 0 &&
+                region.free_num + region.retiring < region.retire_low);
+}
+
+static void tcg_region_free__locked(size_t curr_region)
+{
+    region.free[(region.free_head + region.free_num) % region.n] = curr_region;
+    region.free_num++;
+}
+
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
-    if (region.current == region.n) {
+    if (region.free_num == 0) {
         return true;
     }
-    tcg_region_assign(s, region.current);
-    region.current++;
+    tcg_region_assign(s, region.free[region.free_head]);
+    region.free_head = (region.free_head + 1) % region.n;
+    region.free_num--;
     return false;
 }
 
@@ -376,16 +433,43 @@ bool tcg_region_alloc(TCGContext *s)
     bool err;
     /* read the region size now; alloc__locked will overwrite it on success */
     size_t size_full = s->code_gen_buffer_size;
+    size_t full = tc_ptr_to_region_idx(s->code_gen_buffer);
 
     qemu_mutex_lock(&region.lock);
     err = tcg_region_alloc__locked(s);
     if (!err) {
         region.agg_size_full += size_full - TCG_HIGHWATER;
+        region.full[(region.full_head + region.full_num) % region.n] = full;
+        region.full_num++;
     }
+    tcg_region_update_retire__locked();
     qemu_mutex_unlock(&region.lock);
     return err;
 }
 
+static void tcg_region_queues_reset__locked(void)
+{
+    size_t i;
+
+    region.free_head = 0;
+    region.free_num = 0;
+    for (i = 0; i < region.n; i++) {
+        tcg_region_free__locked(i);
+    }
+    region.full_head = 0;
+    region.full_num = 0;
+    region.retiring = 0;
+    region.epoch++;
+    region.agg_size_full = 0;
+}
+
+static gboolean tcg_region_collect_tb(gpointer key, gpointer value,
+                                      gpointer data)
+{
+    g_ptr_array_add(data, value);
+    return FALSE;
+}
+
 /*
  * Perform a context's first region allocation.
  * This function does _not_ increment region.agg_size_full.
@@ -410,18 +494,103 @@ void tcg_region_reset_all(void)
     unsigned int i;
 
     qemu_mutex_lock(&region.lock);
-    region.current = 0;
-    region.agg_size_full = 0;
+    tcg_region_queues_reset__locked();
 
     for (i = 0; i < n_ctxs; i++) {
         TCGContext *s = qatomic_read(&tcg_ctxs[i]);
         tcg_region_initial_alloc__locked(s);
     }
+    for (i = 0; i < region.n; i++) {
+        qatomic_set(&region_gens[i], (region_gens[i] | 1) + 1);
+    }
+    smp_wmb();
+    qatomic_inc(&tcg_region_gen_changes);
+    tcg_region_update_retire__locked();
     qemu_mutex_unlock(&region.lock);
 
     tcg_region_tree_reset_all();
 }
 
+bool tcg_region_want_retire(void)
+{
+    return qatomic_read(&region.want_retire);
+}
+
+ssize_t tcg_region_retire_begin(GPtrArray *tbs)
+{
+    struct tcg_region_tree *rt;
+    size_t curr_region;
+    void *start, *end;
+
+    qemu_mutex_lock(&region.lock);
+    if (region.full_num == 0) {
+        qemu_mutex_unlock(&region.lock);
+        return -1;
+    }
+    curr_region = region.full[region.full_head];
+    region.full_head = (region.full_head + 1) % region.n;
+    region.full_num--;
+    region.retiring++;
+    tcg_region_bounds(curr_region, &start, &end);
+    region.agg_size_full -= end - start - TCG_HIGHWATER;
+    qatomic_set(&region_gens[curr_region], region_gens[curr_region] + 1);
+    smp_wmb();
+    qatomic_inc(&tcg_region_gen_changes);
+    tcg_region_update_retire__locked();
+    qemu_mutex_unlock(&region.lock);
+
+    /* no TB is added to the region any more, so this is all of them */
+    rt = region_trees + curr_region * tree_size;
+    qemu_mutex_lock(&rt->lock);
+    q_tree_foreach(rt->tree, tcg_region_collect_tb, tbs);
+    qemu_mutex_unlock(&rt->lock);
+    return curr_region;
+}
+
+typedef struct TCGRegionRetired {
+    struct rcu_head rcu;
+    size_t region;
+    unsigned epoch;
+} TCGRegionRetired;
+
+static void tcg_region_reuse(TCGRegionRetired *r)
+{
+    struct tcg_region_tree *rt = region_trees + r->region * tree_size;
+
+    qemu_mutex_lock(&region.lock);
+    /* unless tcg_region_reset_all has already freed it */
+    if (r->epoch == region.epoch) {
+        qemu_mutex_lock(&rt->lock);
+        q_tree_ref(rt->tree);
+        q_tree_destroy(rt->tree);
+        qemu_mutex_unlock(&rt->lock);
+
+        qatomic_set(&region_gens[r->region], region_gens[r->region] + 1);
+        smp_wmb();
+        qatomic_inc(&tcg_region_gen_changes);
+        tcg_region_free__locked(r->region);
+        region.retiring--;
+        tcg_region_update_retire__locked();
+    }
+    qemu_mutex_unlock(&region.lock);
+    g_free(r);
+}
+
+void tcg_region_retire_end(size_t curr_region)
+{
+    TCGRegionRetired *r = g_new(TCGRegionRetired, 1);
+
+    r->region = curr_region;
+    qemu_mutex_lock(&region.lock);
+    r->epoch = region.epoch;
+    qemu_mutex_unlock(&region.lock);
+    call_rcu(r, tcg_region_reuse, rcu);
+}
+
+/* Bounds on the number of regions whose code is retired on wasm hosts */
+#define TCG_REGION_RETIRE_MIN 4
+#define TCG_REGION_RETIRE_MAX 64
+
 static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
 {
 #ifdef CONFIG_USER_ONLY
@@ -435,6 +604,19 @@ static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
      * being of reasonable size. If that's not possible we make do by evenly
      * dividing the code_gen_buffer among the vCPUs.
      */
+#ifdef EMSCRIPTEN
+    /*
+     * Split the buffer even for a single vCPU thread, so that its code can
+     * be retired a region at a time instead of flushed all at once, see
+     * tb_retire_oldest. Regions hold the wasm modules of their TBs too,
+     * make them large enough for a few of the biggest.
+     */
+    n_regions = MIN(tb_size / (2 * MiB), TCG_REGION_RETIRE_MAX);
+    if (qemu_tcg_mttcg_enabled()) {
+        n_regions = MAX(n_regions, max_cpus);
+    }
+    return MAX(n_regions, 1);
+#else
     /* Use a single region if all we have is one vCPU thread */
     if (max_cpus == 1 || !qemu_tcg_mttcg_enabled()) {
         return 1;
@@ -449,6 +631,7 @@ static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
         return max_cpus;
     }
     return MIN(n_regions, max_cpus * 8);
+#endif /* EMSCRIPTEN */
 #endif
 }
 
@@ -550,6 +733,34 @@ static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
 
     return PROT_READ | PROT_WRITE | PROT_EXEC;
 }
+#elif defined(EMSCRIPTEN)
+/*
+ * Not mmap, for the reason given at ram_alloc_lazy() in util/mmap-alloc.c.
+ * Unlike guest RAM the buffer needs no zeroes, so it is taken from the
+ * heap as is and committed as code is generated into it, from the start
+ * of each region. A guest that translates little never pays for the rest
+ * of tb-size, and after a flush the same pages are reused.
+ */
+static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
+{
+    void *buf;
+
+    if (splitwx > 0) {
+        error_setg(errp, "jit split-wx not supported");
+        return -1;
+    }
+
+    buf = qemu_try_memalign(qemu_real_host_page_size(), size);
+    if (buf == NULL) {
+        error_setg(errp, "allocate %zu bytes for jit buffer", size);
+        return -1;
+    }
+
+    region.start_aligned = buf;
+    region.total_size = size;
+
+    return PROT_READ | PROT_WRITE;
+}
 #else
 static int alloc_code_gen_buffer_anon(size_t size, int prot,
                                       int flags, Error **errp)
@@ -721,7 +932,7 @@ static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
 
     return alloc_code_gen_buffer_anon(size, prot, flags, errp);
 }
-#endif /* USE_STATIC_CODE_GEN_BUFFER, WIN32, POSIX */
+#endif /* USE_STATIC_CODE_GEN_BUFFER, WIN32, EMSCRIPTEN, POSIX */
 
 /*
  * Initializes region partitioning.
@@ -810,6 +1021,20 @@ void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
 
     /* init the region struct */
     qemu_mutex_init(&region.lock);
+    region.free = g_new(size_t, region.n);
+    region.full = g_new(size_t, region.n);
+    region_gens = g_new0(uint32_t, region.n);
+    tcg_region_queues_reset__locked();
+#ifdef EMSCRIPTEN
+    /*
+     * Keep an eighth of the regions in reserve, they fill up while a
+     * retired one waits for its grace period. With too few regions for
+     * the contexts to leave one full, tb_flush still does it all.
+     */
+    if (region.n >= TCG_REGION_RETIRE_MIN) {
+        region.retire_low = MAX(region.n / 8, 1);
+    }
+#endif
 
     /*
      * Set guard pages in the rw buffer, as that's the one into which
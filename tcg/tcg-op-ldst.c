@@ -734,6 +734,22 @@ void tcg_gen_qemu_st_i128_chk(TCGv_i128 val, TCGTemp *addr, TCGArg idx,
     tcg_gen_qemu_st_i128_int(val, addr, idx, memop);
 }
 
+void tcg_gen_qemu_zero_block_chk(TCGTemp *addr, TCGArg idx, unsigned log2_len,
+                                 TCGType addr_type)
+{
+    TCGv_i64 a64;
+
+    tcg_debug_assert(addr_type == tcg_ctx->addr_type);
+    tcg_debug_assert(idx <= 0xff);
+    if (tcg_use_softmmu) {
+        tcg_debug_assert(log2_len <= tcg_ctx->page_bits);
+    }
+
+    a64 = maybe_extend_addr64(addr);
+    gen_helper_zero_block(tcg_env, a64, tcg_constant_i32(idx | log2_len << 8));
+    maybe_free_addr64(a64);
+}
+
 void tcg_gen_ext_i32(TCGv_i32 ret, TCGv_i32 val, MemOp opc)
 {
     switch (opc & MO_SSIZE) {
@@ -133,7 +133,8 @@ static void tcg_out_op(TCGContext *s, TCGOpcode opc,
                        const int const_args[TCG_MAX_OP_ARGS]);
 #if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
 static void tcg_out_label_cb(TCGContext *s, TCGLabel *l);
-static void tcg_out_init();
+static void tcg_out_call_last_arg_cb(TCGContext *s, TCGTemp *ts);
+static void tcg_out_init(TCGContext *s);
 #endif
 #if TCG_TARGET_MAYBE_vec
 static bool tcg_out_dup_vec(TCGContext *s, TCGType type, unsigned vece,
@@ -428,56 +429,131 @@ tlb_mask_table_ofs(TCGContext *s, int which)
 
 #if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
 
-#define SUB_BUF_MAX 100000
-__thread uint8_t sub_buf[SUB_BUF_MAX];
+#include "wasm32.h"
+
+/*
+ * Scratch of the wasm module being emitted. Each array of a thread grows
+ * to what the largest TB it translated needed and is kept, so that a TB
+ * only resets the counts and has no fixed limit on its size, labels or
+ * helpers.
+ */
+#define WASM_SCRATCH_MIN 64
+
+__thread size_t wasm_scratch_bytes;
+
+static void *wasm_scratch_grow(void *p, int *cap, int need, size_t elem)
+{
+    int n = MAX(*cap, WASM_SCRATCH_MIN);
+
+    while (n < need) {
+        n *= 2;
+    }
+    p = g_realloc(p, n * elem);
+    wasm_scratch_bytes += (n - *cap) * elem;
+    wasm32_note_scratch(wasm_scratch_bytes);
+    *cap = n;
+    return p;
+}
+
+#define WASM_SCRATCH_RESERVE(arr, need)                                    \
+    do {                                                                   \
+        if (unlikely((need) > arr##_cap)) {                                \
+            arr = wasm_scratch_grow(arr, &arr##_cap, need, sizeof(*arr));  \
+        }                                                                  \
+    } while (0)
+
+__thread uint8_t *sub_buf;
+__thread int sub_buf_cap;
 __thread uint8_t *sub_buf_ptr;
+__thread uint8_t *sub_buf_end;
+
+/* The wasm module is only emitted for TBs retranslated as hot */
+__thread bool sub_buf_enabled;
+
+static void tcg_sub_buf_reset(void)
+{
+    sub_buf_ptr = sub_buf;
+    sub_buf_end = sub_buf + sub_buf_cap;
+}
+
+static void __attribute__((noinline)) tcg_sub_buf_grow(int len)
+{
+    int off = sub_buf_ptr - sub_buf;
+
+    WASM_SCRATCH_RESERVE(sub_buf, off + len);
+    sub_buf_ptr = sub_buf + off;
+    sub_buf_end = sub_buf + sub_buf_cap;
+}
 
 static inline void tcg_sub_out8(TCGContext *s, uint8_t v)
 {
-    *sub_buf_ptr++ = v;
-    if ((sub_buf_ptr - sub_buf) > SUB_BUF_MAX) {
-        printf("buffer too small\n"); fflush(stdout);
-        exit(1);
+    if (!sub_buf_enabled) {
+        return;
     }
+    if (unlikely(sub_buf_ptr == sub_buf_end)) {
+        tcg_sub_buf_grow(1);
+    }
+    *sub_buf_ptr++ = v;
 }
 
 static inline void tcg_sub_out32(TCGContext *s, uint32_t v)
 {
+    if (!sub_buf_enabled) {
+        return;
+    }
+    if (unlikely(sub_buf_end - sub_buf_ptr < 4)) {
+        tcg_sub_buf_grow(4);
+    }
     memcpy(sub_buf_ptr, &v, sizeof(v));
     sub_buf_ptr += 4;
 }
 
-static inline void* cur_sub_buf_ptr()
-{
-    return sub_buf_ptr;
-}
-
+/* An offset, as the buffer moves when it grows */
 static inline int cur_sub_buf_off_rel()
 {
     return (int)sub_buf_ptr - (int)sub_buf;
 }
 
-#define LABEL_MAX 200
-
 struct label_placeholder {
     int label;
-    uintptr_t ptr;
+    int off;
+    int next;   /* the label's previous placeholder, or -1 */
 };
 
 struct label_context {
     int block_idx;
 };
 
-#define WASM_NUM_HELPER_FUNCS_MAX 200
-#define WASM_HELPER_ADDED_TYPES_SECTION_MAX 200
+/* The longest type entry, of a helper with 7 parameters and a result */
+#define WASM_HELPER_TYPE_MAX 16
+
 __thread uint32_t num_helper_funcs;
-__thread uint32_t target_helper_funcs[WASM_NUM_HELPER_FUNCS_MAX];
-__thread uint8_t target_helper_types[WASM_HELPER_ADDED_TYPES_SECTION_MAX];
+__thread uint32_t *target_helper_funcs;
+__thread int target_helper_funcs_cap;
+__thread uint8_t *target_helper_types;
+__thread int target_helper_types_cap;
 __thread int target_helper_types_pos;
+/*
+ * Helpers with the same signature share their type entry, type 0 is the
+ * start function. target_helper_type_ofs[t] is where type t + 1 begins.
+ */
+__thread uint32_t num_helper_types;
+__thread uint16_t *target_helper_type_ofs;
+__thread int target_helper_type_ofs_cap;
+__thread uint8_t *target_helper_typeidx;
+__thread int target_helper_typeidx_cap;
 __thread int wasm_block_idx;
-__thread struct label_placeholder block_ptr_placeholder[LABEL_MAX];
+__thread struct label_placeholder *block_ptr_placeholder;
+__thread int block_ptr_placeholder_cap;
 __thread int block_ptr_placeholder_idx_pos;
-__thread int label_to_block[LABEL_MAX];
+__thread int *label_to_block;
+__thread int label_to_block_cap;
+/* Last placeholder of each label still to be placed, or -1 */
+__thread int *label_fixups;
+__thread int label_fixups_cap;
+__thread int label_fixups_left;
+/* End of the last timed phase of the translation, see wasm32_xlate_time */
+__thread int64_t xlate_clock;
 
 static int wasm_block_current_idx(TCGContext *s)
 {
@@ -500,6 +576,16 @@ static void fill_uint32_leb128(uintptr_t bi, uint32_t v) {
     } while (v != 0);
 }
 
+/* Write the 5-byte LEB128 of v, the width of an operand's placeholder */
+static void put_uint32_leb128_fixed(uint8_t *b, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) {
+        b[i] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    b[4] = v;
+}
+
 static int write_uint32_leb128(uintptr_t bi, uint32_t v) {
     uint8_t *b = (uint8_t *)bi;
     uint32_t low7 = 0x7f;
@@ -516,24 +602,44 @@ static int write_uint32_leb128(uintptr_t bi, uint32_t v) {
 
 static uint8_t * wasm_get_helper_types_begin(TCGContext *s)
 {
+    WASM_SCRATCH_RESERVE(target_helper_types,
+                         target_helper_types_pos + WASM_HELPER_TYPE_MAX);
     return &(target_helper_types[target_helper_types_pos]);
 }
 
+/* Add the type just written for the last registered helper, or reuse one */
 static void wasm_add_helper_types_pos(TCGContext *s, int i)
 {
+    const uint8_t *entry = &target_helper_types[target_helper_types_pos];
+    int helper = num_helper_funcs - 1;
+
+    tcg_debug_assert(i <= WASM_HELPER_TYPE_MAX);
+    for (int t = 0; t < num_helper_types; t++) {
+        int ofs = target_helper_type_ofs[t];
+        if (target_helper_type_ofs[t + 1] - ofs == i &&
+            memcmp(&target_helper_types[ofs], entry, i) == 0) {
+            target_helper_typeidx[helper] = t + 1;
+            return;
+        }
+    }
     target_helper_types_pos += i;
-    tcg_debug_assert(target_helper_types_pos <= WASM_HELPER_ADDED_TYPES_SECTION_MAX);
+    target_helper_typeidx[helper] = ++num_helper_types;
+    target_helper_type_ofs[num_helper_types] = target_helper_types_pos;
 }
 
 static int wasm_register_helper_alloc_num(TCGContext *s)
 {
-    tcg_debug_assert(num_helper_funcs <= WASM_NUM_HELPER_FUNCS_MAX);
+    int n = num_helper_funcs + 1;
+
+    WASM_SCRATCH_RESERVE(target_helper_funcs, n);
+    WASM_SCRATCH_RESERVE(target_helper_typeidx, n);
+    WASM_SCRATCH_RESERVE(target_helper_type_ofs, n + 1);
     return num_helper_funcs++;
 }
 
 static void wasm_register_helper(TCGContext *s, int idx_on_tb, int helper_idx_on_qemu)
 {
-    tcg_debug_assert(idx_on_tb <= WASM_NUM_HELPER_FUNCS_MAX);
+    tcg_debug_assert(idx_on_tb < num_helper_funcs);
     target_helper_funcs[idx_on_tb] = helper_idx_on_qemu;
 }
 
@@ -547,20 +653,57 @@ static int get_wasm_helper_idx(TCGContext *s, int helper_idx_on_qemu)
     return -1;
 }
 
+/* Place a dispatch label, completing the branches emitted before it */
 static void wasm_add_label_context(TCGContext *s, int label, int block)
 {
-    tcg_debug_assert(label <= LABEL_MAX);
+    tcg_debug_assert(label <= s->nb_labels);
     label_to_block[label] = block;
+    for (int i = label_fixups[label]; i >= 0;
+         i = block_ptr_placeholder[i].next) {
+        put_uint32_leb128_fixed(sub_buf + block_ptr_placeholder[i].off, block);
+        label_fixups_left--;
+    }
+    label_fixups[label] = -1;
 }
 
-static void wasm_add_label_block_ptr_placeholder(int label, uintptr_t code_ptr)
+/*
+ * The block of a dispatch label, as a fixed-width operand. Backward
+ * branches know it already, forward ones get it when the label is placed,
+ * so that the body is complete once the last op is emitted.
+ */
+static void wasm_out_label_block_ptr(TCGContext *s, int label)
 {
-    int i = block_ptr_placeholder_idx_pos++;
-    tcg_debug_assert(i <= LABEL_MAX);
+    int off = cur_sub_buf_off_rel();
+    int i;
+
+    tcg_sub_out32(s, 0);
+    tcg_sub_out8(s, 0);
+    if (label_to_block[label] >= 0) {
+        put_uint32_leb128_fixed(sub_buf + off, label_to_block[label]);
+        return;
+    }
+
+    i = block_ptr_placeholder_idx_pos++;
+    WASM_SCRATCH_RESERVE(block_ptr_placeholder, i + 1);
     block_ptr_placeholder[i].label = label;
-    block_ptr_placeholder[i].ptr = code_ptr;
+    block_ptr_placeholder[i].off = off;
+    block_ptr_placeholder[i].next = label_fixups[label];
+    label_fixups[label] = i;
+    label_fixups_left++;
+}
+
+/* Count the time since the end of the previous phase */
+static inline void wasm_xlate_phase_end(enum wasm32_xlate_phase phase)
+{
+    int64_t now = get_clock();
+
+    wasm32_xlate_time(phase, now - xlate_clock);
+    xlate_clock = now;
 }
+#define WASM_XLATE_PHASE_END(phase) wasm_xlate_phase_end(phase)
 
+#else
+#define WASM_XLATE_PHASE_END(phase)
 #endif
 
 /* Signal overflow, starting over with fewer guest insns. */
@@ -5507,6 +5650,10 @@ static void tcg_reg_alloc_call(TCGContext *s, TCGOp *op)
         load_arg_ref(s, 0, ts->mem_base->reg, ts->mem_offset, &allocated_regs);
     }
 
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    tcg_out_call_last_arg_cb(s, nb_iargs ? arg_temp(op->args[nb_oargs + nb_iargs - 1])
+                                          : NULL);
+#endif
     tcg_out_call(s, tcg_call_func(op), info);
 
     /* Assign output registers and emit moves if needed.  */
@@ -5990,16 +6137,24 @@ static const uint8_t mod_header_b[] = {
     0x03, 0x65, 0x6e, 0x76,
     0x06, 0x62, 0x75, 0x66, 0x66, 0x65, 0x72,
     0x02, 0x03, 0x00, 0x80, 0x80, 0x80, 0x80, 0x00,
+    0x03, 0x65, 0x6e, 0x76,
+    0x05, 0x74, 0x61, 0x62, 0x6c, 0x65,
+    0x01, 0x70, 0x00, 0x00, // table used for chaining TBs
+    // globals shared by the TB modules of a vCPU thread
+    0x03, 0x65, 0x6e, 0x76,
+    0x05, 0x61, 0x72, 0x65, 0x67, 0x30, // areg0
+    0x03, 0x7e, 0x01,
+    0x03, 0x65, 0x6e, 0x76,
+    0x05, 0x73, 0x74, 0x61, 0x63, 0x6b, // stack
+    0x03, 0x7e, 0x01,
 };
 
 static const uint8_t mod_header_c[] = {
     // function section
     0x03, 2, 1, 0x00,
     // global section
-    0x06, 0x7e,
-    25,
-    0x7e, 0x01, 0x42, 0x00, 0x0b,
-    0x7e, 0x01, 0x42, 0x00, 0x0b,
+    0x06, 0x74,
+    23,
     0x7e, 0x01, 0x42, 0x00, 0x0b,
     0x7e, 0x01, 0x42, 0x00, 0x0b,
     0x7e, 0x01, 0x42, 0x00, 0x0b,
@@ -6035,36 +6190,47 @@ static const uint8_t mod_header_d[] = {
     0x80, 0x80, 0x80, 0x80, 0x00,
     0x80, 0x80, 0x80, 0x80, 0x00,
 
-    0x2, 0x2, 0x7f, 0x5, 0x7e,
+    // env/tmp i32, tmp i64 x5 + R0-R13 x14, R0-R13 as i32 x14 and env_neg
+    0x3, 0x2, 0x7f, 19, 0x7e, 15, 0x7f,
     
-    // initialize the instance
+    // initialize the instance, env and stack are imported globals
     0x20, 0x0,               // local.get $ctx
     0x28, 0, DO_INIT_OFF,    // i32.load do_init_ptr
     0x41, 0,                 // i32.const 0
     0x47,                    // i32.ne
     0x04, 0x40,              // if
 
-    0x23, 14,                // global.get $env
-    0x50,                    // i64.eqz
-    0x04, 0x40,              // if
-    // fundamental variables
-    0x20, 0x0,               // local.get $ctx
-    0x28, 0, ENV_OFF,        // i32.load env
-    0xad,                    // extend
-    0x24, 14,                // global.set $14
-    0x20, 0x0,               // local.get $ctx
-    0x28, 0, STACK_OFF,      // i32.load stack
-    0xad,                    // extend
-    0x24, 15,                // global.set $15
-    0x0b,                    // end
-
     0x20, 0x0,               // local.get $ctx
     0x41, 0x00,              // i32.const 0
     0x36, 0x00, DO_INIT_OFF, // i32.store do_init
     0x42, 0x00,              // i64.const 0
     0x24, 16,                // global.set $block_ptr
+    0x05,                    // else
+    // rewinding, reload the register locals spilled before returning
+    0x23, 2, 0x21, 8,        // R0
+    0x23, 3, 0x21, 9,        // R1
+    0x23, 4, 0x21, 10,       // R2
+    0x23, 5, 0x21, 11,       // R3
+    0x23, 6, 0x21, 12,       // R4
+    0x23, 7, 0x21, 13,       // R5
+    0x23, 8, 0x21, 14,       // R6
+    0x23, 9, 0x21, 15,       // R7
+    0x23, 10, 0x21, 16,      // R8
+    0x23, 11, 0x21, 17,      // R9
+    0x23, 12, 0x21, 18,      // R10
+    0x23, 13, 0x21, 19,      // R11
+    0x23, 14, 0x21, 20,      // R12
+    0x23, 15, 0x21, 21,      // R13
     0x0b,                    // end
 
+    // env and env_neg, see WASM_ENV_NEG_BIAS
+    0x23, 0x0,               // global.get $env
+    0xa7,                    // i32.wrap_i64
+    0x22, 0x1,               // local.tee $env
+    0x41, 0x80, 0x20,        // i32.const WASM_ENV_NEG_BIAS
+    0x6b,                    // i32.sub
+    0x21, 36,                // local.set $env_neg
+
     0x03, 0x40,              // loop
     0x23, 16,                // global.get $block_ptr
     0x50,                    // i64.eqz
@@ -6074,21 +6240,25 @@ static const uint8_t mod_header_d[] = {
 static void write_wasm_type_section_size(TCGContext *s, void *header_a_ptr, uint32_t added) {
     uint32_t type_section_size = added + 10;
     fill_uint32_leb128((uintptr_t)header_a_ptr + 9, type_section_size);
-    fill_uint32_leb128((uintptr_t)header_a_ptr + 14, num_helper_funcs + 1);
+    fill_uint32_leb128((uintptr_t)header_a_ptr + 14, num_helper_types + 1);
 }
+/*
+ * The maximum of the imported memory must be at least that of wasmMemory,
+ * which is 4GiB when it's allowed to grow with -sMAXIMUM_MEMORY=4GB.
+ */
 static void write_wasm_memory_size(TCGContext *s, void *header_b_ptr) {
-    fill_uint32_leb128((uintptr_t)header_b_ptr + 25, (uint32_t)(~0) / 65536);
+    fill_uint32_leb128((uintptr_t)header_b_ptr + 25, 65536); /* 4GiB in wasm pages */
 }
 static void write_wasm_import_section_size(TCGContext *s, void *header_b_ptr, uint32_t added, uint32_t num_imported_funcs) {
-    uint32_t import_section_size = 35 + added - 11;
+    uint32_t import_section_size = sizeof(mod_header_b) - 6 + added;
     fill_uint32_leb128((uintptr_t)header_b_ptr + 1, import_section_size);
-    fill_uint32_leb128((uintptr_t)header_b_ptr + 6, num_imported_funcs + 1/*buffer+helpers...*/);
+    fill_uint32_leb128((uintptr_t)header_b_ptr + 6, num_imported_funcs + 4/*buffer+table+areg0+stack+helpers...*/);
 }
 static void write_wasm_export_section_size(TCGContext *s, void *header_c_ptr, uint32_t startidx) {
-    fill_uint32_leb128((uintptr_t)header_c_ptr + 142, startidx);
+    fill_uint32_leb128((uintptr_t)header_c_ptr + 132, startidx);
 }
 static void write_wasm_code_size(TCGContext *s, void *header_d_ptr, int code_size, int code_nums) {
-    code_size = code_size + 66;
+    code_size = code_size + sizeof(mod_header_d) - 6;
     fill_uint32_leb128((uintptr_t)header_d_ptr + 1, code_size);
     fill_uint32_leb128((uintptr_t)header_d_ptr + 6, code_nums);
     fill_uint32_leb128((uintptr_t)header_d_ptr + 11, code_size - 10);
@@ -6103,10 +6273,16 @@ uint8_t *tcg_out_import_entry(TCGContext *s, uint8_t* wasm_blob_ptr, int i, int
     *wasm_blob_ptr++ = 0x70;
     *wasm_blob_ptr++ = 0x65;
     *wasm_blob_ptr++ = 0x72;
-    char buf[100];
-    int n = snprintf(buf, sizeof(buf), "%d", i);
-    wasm_blob_ptr += write_uint32_leb128((uintptr_t)wasm_blob_ptr, n);
-    memcpy(wasm_blob_ptr, buf, n);
+    // decimal i, without snprintf on the path of every translation
+    char buf[10];
+    int n = 0;
+    unsigned v = i;
+    do {
+        buf[sizeof(buf) - ++n] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    *wasm_blob_ptr++ = n;
+    memcpy(wasm_blob_ptr, buf + sizeof(buf) - n, n);
     wasm_blob_ptr += n;
     *wasm_blob_ptr++ = 0x00;    //type(0)
     *wasm_blob_ptr++ = typeidx; //typeidx
@@ -6340,7 +6516,11 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
     }
 #endif
 
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+    xlate_clock = get_clock();
+#endif
     tcg_optimize(s);
+    WASM_XLATE_PHASE_END(WASM32_XLATE_OPTIMIZE);
 
     reachable_code_pass(s);
     liveness_pass_0(s);
@@ -6364,6 +6544,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
             liveness_pass_1(s);
         }
     }
+    WASM_XLATE_PHASE_END(WASM32_XLATE_LIVENESS);
 
     if (unlikely(qemu_loglevel_mask(CPU_LOG_TB_OP_OPT)
                  && qemu_log_in_addr_range(pc_start))) {
@@ -6393,32 +6574,49 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
     s->code_ptr = s->code_buf;
 
 #if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
-    sub_buf_ptr = sub_buf;
-    tcg_out_init();
+    tcg_sub_buf_reset();
+    sub_buf_enabled = wasm32_take_hot_tb(tb);
+    tcg_out_init(s);
     num_helper_funcs = 0;
     wasm_block_idx = 0;
     block_ptr_placeholder_idx_pos = 0;
     target_helper_types_pos = 0;
-    memset(label_to_block, -1, LABEL_MAX);
-    memset(target_helper_funcs, -1, WASM_NUM_HELPER_FUNCS_MAX);
+    num_helper_types = 0;
+    WASM_SCRATCH_RESERVE(target_helper_type_ofs, 1);
+    target_helper_type_ofs[0] = 0;
+    /* label_to_block is indexed by the label id + 1 */
+    WASM_SCRATCH_RESERVE(label_to_block, s->nb_labels + 1);
+    memset(label_to_block, -1, (s->nb_labels + 1) * sizeof(*label_to_block));
+    WASM_SCRATCH_RESERVE(label_fixups, s->nb_labels + 1);
+    memset(label_fixups, -1, (s->nb_labels + 1) * sizeof(*label_fixups));
+    label_fixups_left = 0;
+
+    /*
+     * The per-core vectors are taken from the end of the region, moving
+     * the highwater mark down, see TB_VECS_OFF
+     */
+    int cores = get_core_nums();
+    void *vecs = s->code_gen_highwater + TCG_HIGHWATER - cores * 8;
+    if (unlikely(vecs - TCG_HIGHWATER < (void *)s->code_ptr)) {
+        return -1;
+    }
+    s->code_gen_highwater = vecs - TCG_HIGHWATER;
 
     uint32_t *tci_code_off = (uint32_t*)s->code_ptr;
     s->code_ptr += 4;
-    uint32_t *size_base = (uint32_t*)s->code_ptr;
+    *(uint32_t *)s->code_ptr = (uint32_t)vecs;
     s->code_ptr += 4;
-    uint32_t *export_vec_base = (uint32_t*)s->code_ptr;
-    int export_size = get_core_nums() * 4;
-    memset(s->code_ptr, 0, export_size);
-    s->code_ptr += export_size;
-    *size_base = export_size;
 
-    size_base = (uint32_t*)s->code_ptr;
-    s->code_ptr += 4;
-    int counter_size = get_core_nums() * 4;
-    memset(s->code_ptr, 0, counter_size);
-    s->code_ptr += counter_size;
-    *size_base = counter_size;
-    
+    int32_t *export_vec = vecs;
+    int32_t *counter_vec = export_vec + cores;
+    int counter_init = INSTANTIATE_NUM - wasm32_tb_threshold(tb);
+    for (int i = 0; i < cores; i++) {
+        export_vec[i] = 0;
+        // already known to be hot, instantiate on the first execution
+        counter_vec[i] = sub_buf_enabled ? INSTANTIATE_NUM : counter_init;
+    }
+    tb->wasm_gen_time = get_clock();
+
     uint8_t *code_begin = s->code_ptr;
     s->code_ptr += 4; // placeholder for size
     *tci_code_off = s->code_ptr - s->code_buf;
@@ -6524,6 +6722,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
     if (!tcg_resolve_relocs(s)) {
         return -2;
     }
+    WASM_XLATE_PHASE_END(WASM32_XLATE_CODEGEN);
 
 #if !defined(CONFIG_TCG_INTERPRETER) && !defined(EMSCRIPTEN)
     /* flush instruction cache */
@@ -6535,22 +6734,28 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
 #if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
     tcg_sub_out8(s, 0x0b); //end if
     tcg_sub_out8(s, 0x0b); //end loop
+    tcg_wasm_out_tail_call_rewind(s);
     tcg_sub_out8(s, 0x0); // unreachable
     tcg_sub_out8(s, 0x0b); //end func
 
-    // fill blocks
-    for (int i = 0; i < block_ptr_placeholder_idx_pos; i++) {
-        int label = block_ptr_placeholder[i].label;
-        int ph = block_ptr_placeholder[i].ptr;
-        int blk = label_to_block[label];
-        tcg_debug_assert(blk >= 0);
-        *(uint8_t*)ph = 0x80;
-        fill_uint32_leb128(ph, blk);
-    }
+    // every branch got its block when its label was placed
+    tcg_debug_assert(label_fixups_left == 0);
 
     int code_size = (uint32_t)((uintptr_t)s->code_ptr - (uintptr_t)code_begin - 4);
     *(uint32_t *)code_begin = code_size;
 
+    if (!sub_buf_enabled) {
+        // TCI only: empty wasm blob and import vector
+        if (unlikely(((void *)s->code_ptr + 8) > s->code_gen_highwater)) {
+            return -1;
+        }
+        *(uint32_t *)s->code_ptr = 0;
+        s->code_ptr += 4;
+        *(uint32_t *)s->code_ptr = 0;
+        s->code_ptr += 4;
+        return tcg_current_code_size(s);
+    }
+
     int sub_buf_len = sub_buf_ptr - sub_buf;
     int wasm_body_size = sub_buf_len;
 
@@ -6577,7 +6782,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
     wasm_blob_ptr += sizeof(mod_header_b);
     uint8_t *header_b_adding_base = wasm_blob_ptr;
     for (int i = 0; i < num_helper_funcs; i++) {
-        wasm_blob_ptr = tcg_out_import_entry(s, wasm_blob_ptr, i, i+1/*type0=start,1=helpers...*/);
+        wasm_blob_ptr = tcg_out_import_entry(s, wasm_blob_ptr, i, target_helper_typeidx[i]);
     }
     write_wasm_import_section_size(s, header_b_base, (uint32_t)wasm_blob_ptr - (uint32_t)header_b_adding_base, num_helper_funcs);
     write_wasm_memory_size(s, header_b_base);
@@ -6606,18 +6811,25 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
     memcpy(s->code_ptr, sub_buf, sub_buf_len);
     s->code_ptr += sub_buf_len;
 
-    // write blob size
-    if (sub_buf_len > SUB_BUF_MAX) {
-        printf("sub too large sub_buf_len: %d\n", sub_buf_len); fflush(stdout);
-        exit(1);
+    // name section for browser profilers, -perfmap
+    if (perf_wasm_names) {
+        int name_len = perf_wasm_name_section(s->code_ptr,
+                                              (void *)s->code_gen_highwater - (void *)s->code_ptr,
+                                              pc_start, tb, num_helper_funcs);
+        if (unlikely(name_len < 0)) {
+            return -1;
+        }
+        s->code_ptr += name_len;
     }
+
+    // write blob size
     *(uint32_t *)wasm_blob_ptr_base = s->code_ptr - wasm_blob_ptr_base - 4;
 
     // record importing helper functions
     if (unlikely(((void *)s->code_ptr + 4 + num_helper_funcs * 4) > s->code_gen_highwater)) {
         return -1;
     }
-    size_base = (uint32_t*)s->code_ptr;
+    uint32_t *size_base = (uint32_t*)s->code_ptr;
     s->code_ptr += 4;
     memcpy(s->code_ptr, target_helper_funcs, num_helper_funcs * 4);
     s->code_ptr += num_helper_funcs * 4;
@@ -6626,6 +6838,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
     if (unlikely((void *)s->code_ptr > s->code_gen_highwater)) {
         return -1;
     }
+    WASM_XLATE_PHASE_END(WASM32_XLATE_MODULE);
 #endif
 
     return tcg_current_code_size(s);
@@ -25,6 +25,21 @@
 #include "exec/cpu_ldst.h"
 #include "tcg/tcg-op.h"
 #include "tcg/tcg-ldst.h"
+#include "exec/exec-all.h"
+#include "../accel/tcg/tb-context.h"
+#include "../accel/tcg/tb-hash.h"
+#include "qemu/stats64.h"
+#include "qemu/units.h"
+#include "qemu-version.h"
+#include "qemu/timer.h"
+#include "qemu/rcu.h"
+#include "qemu/error-report.h"
+#include "qemu/crc32c.h"
+#include "qapi/error.h"
+#include "exec/memory.h"
+#include "hw/core/cpu.h"
+#include "sysemu/stats.h"
+#include "sysemu/sysemu.h"
 #include <string.h>
 #include <emscripten.h>
 #include <emscripten/threading.h>
@@ -39,225 +54,2314 @@ int print_insn_tci(bfd_vma addr, disassemble_info *info)
 }
 
 EM_JS(int, instantiate_wasm, (), {
-        const memory_v = new DataView(HEAP8.buffer);
+        const memory_v = Module.__wasm32_tb.view();
 
-        const tb_ptr = memory_v.getInt32(Module.__wasm32_tb.tb_ptr_ptr, true);
-        const export_vec_size = memory_v.getInt32(tb_ptr + 4, true);
-        const export_vec_begin = tb_ptr + 4 + 4;
-
-        const counter_vec_size = memory_v.getInt32(export_vec_begin + export_vec_size, true);
-        const counter_vec_begin = export_vec_begin + export_vec_size + 4;
-        
-        const tmp_body_size = memory_v.getInt32(counter_vec_begin + counter_vec_size, true);
-        const tmp_body_begin = counter_vec_begin + counter_vec_size + 4;
+        const tb_ptr = memory_v.getUint32(Module.__wasm32_tb.tb_ptr_ptr, true);
+        const tmp_body_size = memory_v.getInt32(tb_ptr + 8, true); // TB_TCI_SIZE_OFF
+        const tmp_body_begin = tb_ptr + 8 + 4;
         const wasm_size = memory_v.getInt32(tmp_body_begin + tmp_body_size, true);
         const wasm_begin = tmp_body_begin + tmp_body_size + 4;
         const import_vec_size = memory_v.getInt32(wasm_begin + wasm_size, true);
         const import_vec_begin = wasm_begin + wasm_size + 4;
 
-        // Create a full copy of the bytes instead of a subarray view to fix Firefox compatibility
-        // See: https://bugzilla.mozilla.org/show_bug.cgi?id=1965217
-        const wasmBytes = new Uint8Array(HEAP8.slice(wasm_begin, wasm_begin + wasm_size));
-        
+        const wasmBytes = Module.__wasm32_tb.module_bytes(wasm_begin, wasm_size);
+
         var helper = {};
         for (var i = 0; i < import_vec_size / 4; i++) {
-            helper[i] = wasmTable.get(memory_v.getInt32(import_vec_begin + i * 4, true));
+            helper[i] = Module.__wasm32_tb.helper_fn(memory_v.getInt32(import_vec_begin + i * 4, true));
         }
         const mod = new WebAssembly.Module(wasmBytes);
         const inst = new WebAssembly.Instance(mod, {
                 "env": {
                     "buffer": wasmMemory,
+                    "table": wasmTable,
+                    "areg0": Module.__wasm32_tb.areg0,
+                    "stack": Module.__wasm32_tb.stack,
                         },
                     "helper": helper,
                         });
 
-        Module.__wasm32_tb.inst_gc_registry.register(inst, "instance");
+        const fidx = addFunction(inst.exports.start, 'ii');
+        Module.__wasm32_tb.instances.set(fidx, inst);
+
+        return fidx;
+});
+
+/* Instantiate a region of TBs as one module */
+EM_JS(int, instantiate_wasm_region, (const uint32_t *tbs, int n, int *fidxs), {
+        tbs >>>= 0;
+        fidxs >>>= 0;
+        const region = Module.__wasm32_tb.build_region(tbs, n);
+        const mod = new WebAssembly.Module(region.bytes);
+        return Module.__wasm32_tb.instantiate_region(mod, region.helper, n, fidxs);
+});
+
+/*
+ * Compile a batch of TBs in the background. The vCPU keeps running the
+ * TBs on TCI meanwhile and, once the module is ready, the counters of the
+ * TBs are set back to INSTANTIATE_NUM so tcg_qemu_tb_exec picks them up.
+ * The first of them reaching the dispatcher instantiates the whole batch.
+ * The module is also posted to the other vCPU threads, which instantiate
+ * it when the TBs get hot there instead of compiling them again.
+ * Modules are kept by TB address along with the generation of the TBs'
+ * code, and dropped once tb_retire_oldest retires any of them.
+ */
+EM_JS(void, compile_wasm_async, (const uint32_t *tbs, int n, int counter_vec_off, int instantiate_num, const char *cache_name), {
+        tbs >>>= 0;
+        const tbctx = Module.__wasm32_tb;
+        const memory_v = tbctx.view();
+        const flush_count = memory_v.getUint32(tbctx.flush_count_ptr, true);
+        const tb_ptrs = [];
+        const gens = [];
+        for (let k = 0; k < n; k++) {
+            const tb_ptr = memory_v.getUint32(tbs + k * 4, true);
+            tb_ptrs.push(tb_ptr);
+            gens.push(_wasm32_code_gen(tb_ptr));
+        }
+        const region = tbctx.build_region(tbs, n);
+        const start = performance.now();
+        const done = (mod) => {
+            const us = Math.round((performance.now() - start) * 1000);
+            const memory_v = tbctx.view();
+            const v = memory_v.getInt32(tbctx.compiling_ptr, true);
+            memory_v.setInt32(tbctx.compiling_ptr, v - 1, true);
+            if (memory_v.getUint32(tbctx.flush_count_ptr, true) != flush_count) {
+                return; // code_gen_buffer was flushed, the TBs are gone
+            }
+            if (!tbctx.gens_match(tb_ptrs, gens)) {
+                // some were retired, compile the others again once they're hot
+                for (let k = 0; k < tb_ptrs.length; k++) {
+                    _wasm32_tb_rearm(tb_ptrs[k], gens[k], 0);
+                }
+                return;
+            }
+            const c = {mod: mod, helper: region.helper, tbs: tb_ptrs, gens: gens};
+            for (let k = 0; k < tb_ptrs.length; k++) {
+                tbctx.compiled.set(tb_ptrs[k], c);
+                if (_wasm32_tb_rearm(tb_ptrs[k], gens[k], 0)) {
+                    _wasm32_prof_compiled(tb_ptrs[k], us);
+                }
+            }
+            if (mod !== null && tbctx.channel !== null) {
+                try {
+                    tbctx.channel.postMessage({mod: mod, fptrs: region.fptrs, tbs: tb_ptrs,
+                                               gens: gens, flush_count: flush_count});
+                } catch (e) {
+                    // modules cannot be cloned here, compile on each thread
+                    tbctx.channel.close();
+                    tbctx.channel = null;
+                }
+            }
+        };
+        memory_v.setInt32(tbctx.compiling_ptr, memory_v.getInt32(tbctx.compiling_ptr, true) + 1, true);
+        const compiled = cache_name ? tbctx.compile_cached(UTF8ToString(cache_name), region.bytes) :
+            WebAssembly.compile(region.bytes);
+        compiled.then(done, (e) => {
+                console.error("wasm32: failed to compile TB:", e);
+                done(null);
+            });
+});
+
+/*
+ * Instantiate the module compiled by compile_wasm_async for tb_ptr and the
+ * rest of its batch. Returns the number of TBs written to tbs, 0 if nothing
+ * has been compiled for tb_ptr or -1 if compiling its batch failed.
+ */
+EM_JS(int, instantiate_compiled, (const void *tb_ptr, uint32_t *tbs, int *fidxs), {
+        tb_ptr >>>= 0;
+        tbs >>>= 0;
+        fidxs >>>= 0;
+        const tbctx = Module.__wasm32_tb;
+        const memory_v = tbctx.view();
+        const flush_count = memory_v.getUint32(tbctx.flush_count_ptr, true);
+        if (tbctx.compiled_flush_count != flush_count) {
+            tbctx.compiled.clear();
+            tbctx.compiled_flush_count = flush_count;
+        }
+        const c = tbctx.compiled.get(tb_ptr);
+        if (c === undefined) {
+            return 0;
+        }
+        if (!tbctx.gens_match(c.tbs, c.gens)) {
+            for (const p of c.tbs) {
+                tbctx.compiled.delete(p);
+            }
+            return 0;
+        }
+        if (c.mod === null) {
+            tbctx.compiled.delete(tb_ptr);
+            return -1;
+        }
+        for (const p of c.tbs) {
+            tbctx.compiled.delete(p);
+        }
+        for (let k = 0; k < c.tbs.length; k++) {
+            memory_v.setUint32(tbs + k * 4, c.tbs[k], true);
+        }
+        return tbctx.instantiate_region(c.mod, c.helper, c.tbs.length, fidxs);
+});
+
+__thread bool initdone = false;
+__thread int cur_core_num = -1;
+__thread int export_vec_off = -1;
+__thread int counter_vec_off = -1;
+__thread int all_cores_num = -1;
+int cur_core_num_max = 0;
+
+EM_JS(void, remove_module_js, (), {
+        const memory_v = Module.__wasm32_tb.view();
+        const remove_n = memory_v.getInt32(Module.__wasm32_tb.to_remove_instance_idx_ptr, true);
+        for (var i = 0; i < remove_n * 4; i += 4) {
+            const fidx = memory_v.getInt32(Module.__wasm32_tb.to_remove_instance_ptr + i, true);
+            removeFunction(fidx);
+            Module.__wasm32_tb.instances.delete(fidx);
+        }
+        memory_v.setInt32(Module.__wasm32_tb.to_remove_instance_idx_ptr, 0, true);
+    });
+
+/*
+ * Instances are owned by the JS instance table of their thread, indexed
+ * by function table slot, and counted from the moment they are added to
+ * it until remove_module_js drops them.
+ */
+int instance_alive_global = 0;
+__thread int instance_running_local = 0;
+
+__thread struct wasmContext ctx = {
+    .tb_ptr = 0,
+    .stack = NULL,
+    /* .func_ptr = 0, */
+    /* .next_func_ptr = 0, */
+    .do_init = 1,
+    .stack128 = NULL,
+    .chain_epoch = 1,
+};
+
+/*
+ * Instantiated TBs are kept in a clock cache. The ring holds them in the
+ * order they were added and eviction walks it from the oldest entry,
+ * giving entries with the ref bit set a second chance at the end of the ring.
+ * The cache is bounded by the wasm bytes of the instances it holds and by
+ * the number of instances alive.
+ */
+int wasm32_instance_max = WASM_INSTANCE_MAX_DEFAULT;
+int wasm32_instance_bytes = WASM_INSTANCE_BYTES_DEFAULT;
+
+#define MAX_INSTANCE_ALIVE wasm32_instance_max
+#define MAX_INSTANCE_BYTES wasm32_instance_bytes
+#define INSTANCE_RUNNING_LEN MAX_INSTANCE_ALIVE
+#define INSTANCE_RING_SLACK 32 // room for instantiating a whole batch
+__thread struct instance_info *instance_running;
+__thread int instance_running_begin = 0;
+__thread int instance_running_end = 0;
+__thread int instance_running_num = 0; // entries in the ring, including released ones
+int instance_bytes_global = 0;
+
+#define TO_REMOVE_INSTANCE_SIZE (MAX_INSTANCE_ALIVE * 10 / 3)
+__thread static int *to_remove_instance;
+__thread static int to_remove_instance_idx = 0;
+
+/* Cache statistics, folded into the globals from trysleep */
+__thread uint32_t instance_hits_local = 0;
+__thread uint32_t instance_misses_local = 0;
+__thread uint32_t instance_churn_local = 0;
+__thread uint32_t dispatch_hits_local = 0;
+__thread uint32_t dispatch_fills_local = 0;
+static Stat64 instance_hits;
+static Stat64 instance_misses;
+static Stat64 instance_evictions;
+static Stat64 instance_churn;
+static Stat64 instance_invalidated;
+static Stat64 instance_retired;
+static Stat64 dispatch_hits;
+static Stat64 dispatch_fills;
+
+/*
+ * Per-vCPU counters for query-stats. The thread-local counters are added
+ * to those of the vCPU whose TBs the thread ran last, stats_vcpu.
+ */
+#define COMPILE_HIST_BUCKETS 24
+
+struct wasm32_vcpu_stats {
+    Stat64 translated;
+    Stat64 tci_execs;
+    Stat64 wasm_execs;
+    Stat64 instantiated;
+    Stat64 evicted;
+    Stat64 released;
+    Stat64 unwinds;
+    Stat64 compile_us[COMPILE_HIST_BUCKETS];   /* log2 buckets */
+};
+
+static struct wasm32_vcpu_stats *vcpu_stats;
+static unsigned vcpu_stats_num;
+__thread struct wasm32_vcpu_stats *stats_vcpu;
+__thread uint32_t translated_local = 0;
+__thread uint32_t tci_execs_local = 0;
+__thread uint32_t wasm_execs_local = 0;
+__thread uint32_t instantiated_local = 0;
+__thread uint32_t evicted_local = 0;
+__thread uint32_t released_local = 0;
+__thread uint32_t unwinds_local = 0;
+__thread uint32_t compile_us_local[COMPILE_HIST_BUCKETS];
+
+/* Translation times, in ns, and the number of times each phase ran */
+static Stat64 xlate_ns[WASM32_XLATE_PHASES];
+static Stat64 xlate_runs[WASM32_XLATE_PHASES];
+__thread uint64_t xlate_ns_local[WASM32_XLATE_PHASES];
+__thread uint32_t xlate_runs_local[WASM32_XLATE_PHASES];
+
+static bool can_add_instance()
+{
+    return qatomic_read(&instance_alive_global) < MAX_INSTANCE_ALIVE &&
+        qatomic_read(&instance_bytes_global) < MAX_INSTANCE_BYTES &&
+        instance_running_num + INSTANCE_RING_SLACK <= INSTANCE_RUNNING_LEN;
+}
+
+static void fold_instance_stats(void)
+{
+    stat64_add(&instance_hits, instance_hits_local);
+    stat64_add(&instance_misses, instance_misses_local);
+    stat64_add(&instance_churn, instance_churn_local);
+    stat64_add(&dispatch_hits, dispatch_hits_local);
+    stat64_add(&dispatch_fills, dispatch_fills_local);
+    instance_hits_local = 0;
+    instance_misses_local = 0;
+    instance_churn_local = 0;
+    dispatch_hits_local = 0;
+    dispatch_fills_local = 0;
+    for (int i = 0; i < WASM32_XLATE_PHASES; i++) {
+        if (xlate_runs_local[i]) {
+            stat64_add(&xlate_ns[i], xlate_ns_local[i]);
+            stat64_add(&xlate_runs[i], xlate_runs_local[i]);
+            xlate_ns_local[i] = 0;
+            xlate_runs_local[i] = 0;
+        }
+    }
+
+    struct wasm32_vcpu_stats *v = stats_vcpu;
+    if (v != NULL) {
+        stat64_add(&v->translated, translated_local);
+        stat64_add(&v->tci_execs, tci_execs_local);
+        stat64_add(&v->wasm_execs, wasm_execs_local);
+        stat64_add(&v->instantiated, instantiated_local);
+        stat64_add(&v->evicted, evicted_local);
+        stat64_add(&v->released, released_local);
+        stat64_add(&v->unwinds, unwinds_local);
+        for (int i = 0; i < COMPILE_HIST_BUCKETS; i++) {
+            if (compile_us_local[i]) {
+                stat64_add(&v->compile_us[i], compile_us_local[i]);
+                compile_us_local[i] = 0;
+            }
+        }
+    }
+    translated_local = 0;
+    tci_execs_local = 0;
+    wasm_execs_local = 0;
+    instantiated_local = 0;
+    evicted_local = 0;
+    released_local = 0;
+    unwinds_local = 0;
+}
+
+/* Called when the thread starts running the TBs of another vCPU */
+static void switch_stats_vcpu(CPUState *cpu)
+{
+    fold_instance_stats();
+    stats_vcpu = (unsigned)cpu->cpu_index < vcpu_stats_num ?
+        &vcpu_stats[cpu->cpu_index] : NULL;
+}
+
+static void set_instance_running_local(struct instance_info *elm)
+{
+    int tb_export_ptr = wasm32_tb_vecs(elm->tb) + export_vec_off;
+    *(uint32_t*)tb_export_ptr = (uint32_t)elm;
+}
+
+/* Drop the instance without looking at its TB, whose code may be gone */
+static void drop_instance_running_local(struct instance_info *elm)
+{
+    elm->tb = NULL;
+    to_remove_instance[to_remove_instance_idx++] = elm->fidx;
+    instance_running_local--;
+    qatomic_dec(&instance_alive_global);
+    qatomic_sub(&instance_bytes_global, elm->size);
+}
+
+/* Drop the instance from the cache, its ring entry is reclaimed later */
+static void release_instance_running_local(struct instance_info *elm)
+{
+    int tb_export_ptr = wasm32_tb_vecs(elm->tb) + export_vec_off;
+    if (*(uint32_t*)tb_export_ptr == (uint32_t)elm) {
+        *(uint32_t*)tb_export_ptr = 0;
+    }
+    drop_instance_running_local(elm);
+}
+
+/* Evict until a quarter of this thread's share of the budget is free */
+static void remove_instance_running_local()
+{
+    // reclaim the entries of released instances first
+    while (instance_running_num > 0 &&
+           instance_running[instance_running_begin].tb == NULL) {
+        instance_running_begin = (instance_running_begin + 1)%INSTANCE_RUNNING_LEN;
+        instance_running_num--;
+    }
+    int to_remove = instance_running_local / 4;
+    int bytes_to_free = qatomic_read(&instance_bytes_global) -
+        MAX_INSTANCE_BYTES / 4 * 3;
+    int scan = instance_running_num * 2;
+    int removed = 0;
+
+    while ((removed < to_remove || bytes_to_free > 0) && scan-- > 0 &&
+           instance_running_local > 0) {
+        struct instance_info *elm = &instance_running[instance_running_begin];
+        instance_running_begin = (instance_running_begin + 1)%INSTANCE_RUNNING_LEN;
+        if (elm->tb == NULL) {
+            instance_running_num--;
+            continue;
+        }
+        if (elm->ref) {
+            // referenced since the last sweep, move to the end of the ring
+            struct instance_info *dst = &instance_running[instance_running_end];
+            *dst = *elm;
+            dst->ref = 0;
+            elm->tb = NULL;
+            set_instance_running_local(dst);
+            instance_running_end = (instance_running_end + 1)%INSTANCE_RUNNING_LEN;
+            continue;
+        }
+        bytes_to_free -= elm->size;
+        release_instance_running_local(elm);
+        instance_running_num--;
+        removed++;
+    }
+    stat64_add(&instance_evictions, removed);
+    evicted_local += removed;
+    if (to_remove_instance_idx > 0) {
+        remove_module_js();
+    }
+}
+
+/*
+ * TBs invalidated by any thread are queued to each core that has an
+ * instance of them, which releases the instance and its function table
+ * slot at its next dispatch. If the queue is full they are released
+ * lazily when the ring evicts them. Each TB is queued with the generation
+ * of its code, and skipped if its region has been retired since: the
+ * instances of retired TBs are dropped by release_retired_instances.
+ */
+#define INVAL_QUEUE_LEN 256
+#define INVAL_QUEUE_CORES 64
+
+struct inval_queue {
+    QemuSpin lock;
+    int num;
+    uint32_t tbs[INVAL_QUEUE_LEN];
+    uint32_t gens[INVAL_QUEUE_LEN];
+};
+
+__thread struct inval_queue inval_queue;
+static struct inval_queue *inval_queues[INVAL_QUEUE_CORES];
+
+void wasm32_tb_invalidate(const TranslationBlock *tb)
+{
+    uint32_t tb_ptr = (uint32_t)tb->tc.ptr;
+    uint32_t vecs = wasm32_tb_vecs(tb->tc.ptr);
+    uint32_t gen = tcg_region_gen(tb->tc.ptr);
+    int cores = MIN(qatomic_read(&cur_core_num_max), INVAL_QUEUE_CORES);
+
+    if (gen & 1) {
+        return; // the whole region is being retired
+    }
+    for (int i = 0; i < cores; i++) {
+        struct inval_queue *q = qatomic_read(&inval_queues[i]);
+        if (q == NULL || qatomic_read((uint32_t *)(vecs + i * 4)) == 0) {
+            continue;
+        }
+        qemu_spin_lock(&q->lock);
+        if (q->num < INVAL_QUEUE_LEN) {
+            q->tbs[q->num] = tb_ptr;
+            q->gens[q->num] = gen;
+            q->num++;
+        }
+        qemu_spin_unlock(&q->lock);
+    }
+}
+
+static void release_invalidated_instances(void)
+{
+    uint32_t tbs[INVAL_QUEUE_LEN];
+    uint32_t gens[INVAL_QUEUE_LEN];
+    int n;
+
+    qemu_spin_lock(&inval_queue.lock);
+    n = inval_queue.num;
+    memcpy(tbs, inval_queue.tbs, n * sizeof(uint32_t));
+    memcpy(gens, inval_queue.gens, n * sizeof(uint32_t));
+    qatomic_set(&inval_queue.num, 0);
+    qemu_spin_unlock(&inval_queue.lock);
+
+    for (int i = 0; i < n; i++) {
+        if (tcg_region_gen((void *)tbs[i]) != gens[i]) {
+            continue;
+        }
+        int tb_export_ptr = wasm32_tb_vecs((void *)tbs[i]) + export_vec_off;
+        struct instance_info *elm = (struct instance_info *)(*(uint32_t*)tb_export_ptr);
+        if (elm != NULL && elm->tb == (uint8_t *)tbs[i]) {
+            release_instance_running_local(elm);
+            stat64_inc(&instance_invalidated);
+            released_local++;
+        }
+    }
+    if (to_remove_instance_idx > 0) {
+        remove_module_js();
+    }
+}
+
+static uint32_t wasm_body_size(void *tb_ptr);
+
+static void add_instance_running_local(int fidx, void *tb_ptr)
+{
+    struct instance_info *elm = &instance_running[instance_running_end];
+
+    elm->tb = tb_ptr;
+    elm->fidx = fidx;
+    // only the TB entered from tcg_qemu_tb_exec is on the current chain
+    elm->active = (tb_ptr == ctx.tb_ptr) ? ctx.chain_epoch : 0;
+    elm->ref = 0;
+    elm->size = wasm_body_size(tb_ptr);
+    elm->gen = tcg_region_gen(tb_ptr);
+    set_instance_running_local(elm);
+
+    instance_running_end  = (instance_running_end+1)%INSTANCE_RUNNING_LEN;
+    instance_running_num++;
+    instance_running_local++;
+    instantiated_local++;
+    qatomic_inc(&instance_alive_global);
+    qatomic_add(&instance_bytes_global, elm->size);
+}
+
+static uint32_t wasm_body_size(void *tb_ptr)
+{
+    const uint8_t *p = (uint8_t *)tb_ptr + TB_TCI_SIZE_OFF;
+    p += 4 + *(uint32_t *)p;  // tci code
+    return *(uint32_t *)p;
+}
+
+static bool has_wasm_body(void *tb_ptr)
+{
+    return wasm_body_size(tb_ptr) != 0;
+}
+
+struct hot_tb_hint {
+    tb_page_addr_t phys_pc;
+    uint64_t cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+    bool valid;
+};
+
+#define HOT_TB_HINTS_NUM 64
+__thread struct hot_tb_hint hot_tb_hints[HOT_TB_HINTS_NUM];
+__thread int hot_tb_hints_pos = 0;
+
+static bool hot_tb_hint_match(struct hot_tb_hint *h, const TranslationBlock *tb)
+{
+    return h->valid && h->phys_pc == tb_page_addr0(tb) &&
+        h->cs_base == tb->cs_base && h->flags == tb->flags &&
+        h->cflags == (tb_cflags(tb) & ~CF_INVALID);
+}
+
+static void hot_tb_hint_set(struct hot_tb_hint *h, const TranslationBlock *tb)
+{
+    h->phys_pc = tb_page_addr0(tb);
+    h->cs_base = tb->cs_base;
+    h->flags = tb->flags;
+    h->cflags = tb_cflags(tb) & ~CF_INVALID;
+    h->valid = true;
+}
+
+void wasm32_mark_hot_tb(const TranslationBlock *tb)
+{
+    hot_tb_hint_set(&hot_tb_hints[hot_tb_hints_pos], tb);
+    hot_tb_hints_pos = (hot_tb_hints_pos + 1) % HOT_TB_HINTS_NUM;
+}
+
+/*
+ * TBs with a wasm body that a guest write invalidated. They are likely to
+ * be translated again at the same address, e.g. by a JIT patching its own
+ * code, and then get their wasm body right away instead of warming up on
+ * TCI again. Any vCPU may do the write and any other the retranslation,
+ * so the table is shared, one entry per hash of the address.
+ */
+#define SMC_HOT_TBS_NUM 256
+static struct hot_tb_hint smc_hot_tbs[SMC_HOT_TBS_NUM];
+static QemuSpin smc_hot_tbs_lock; // zero, i.e. unlocked
+static Stat64 smc_hot_hits;
+
+static struct hot_tb_hint *smc_hot_tb_slot(tb_page_addr_t phys_pc)
+{
+    return &smc_hot_tbs[(phys_pc ^ (phys_pc >> 12)) % SMC_HOT_TBS_NUM];
+}
+
+void wasm32_tb_written(const TranslationBlock *tb)
+{
+    if (tb_page_addr0(tb) == -1 || !has_wasm_body(tb->tc.ptr)) {
+        return;
+    }
+    qemu_spin_lock(&smc_hot_tbs_lock);
+    hot_tb_hint_set(smc_hot_tb_slot(tb_page_addr0(tb)), tb);
+    qemu_spin_unlock(&smc_hot_tbs_lock);
+}
+
+static bool smc_hot_tb_match(const TranslationBlock *tb)
+{
+    struct hot_tb_hint *h = smc_hot_tb_slot(tb_page_addr0(tb));
+    bool found;
+
+    if (!qatomic_read(&h->valid)) {
+        return false;
+    }
+    qemu_spin_lock(&smc_hot_tbs_lock);
+    found = hot_tb_hint_match(h, tb);
+    if (found) {
+        h->valid = false;
+    }
+    qemu_spin_unlock(&smc_hot_tbs_lock);
+    if (found) {
+        stat64_inc(&smc_hot_hits);
+    }
+    return found;
+}
+
+/*
+ * Warm start profile, -accel tcg,wasm-profile=FILE. It lists the TBs that
+ * had a wasm body when it was saved, and a later translation of one of
+ * them gets its wasm body right away instead of warming up on TCI again.
+ * Entries are keyed by the guest code bytes rather than by the physical
+ * address, which changes between boots for anything in the page cache.
+ */
+char *wasm32_warm_profile;
+bool wasm32_warm_profile_update = true;
+
+#define WARM_PROFILE_MAGIC "QWASMJP"
+#define WARM_PROFILE_MAX (64 * 1024)
+
+struct warm_tb {
+    uint64_t pc;            /* offset in the page for CF_PCREL TBs */
+    uint64_t cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+    uint32_t size;
+    uint32_t crc;           /* crc32c of the guest code */
+};
+
+struct warm_profile_header {
+    char magic[8];
+    char target[16];
+    uint32_t entry_size;
+    uint32_t num;
+};
+
+static GHashTable *warm_tbs;
+static QemuMutex warm_tbs_lock;
+static Notifier warm_profile_exit;
+static Stat64 warm_hits;
+
+static guint warm_tb_hash(gconstpointer key)
+{
+    const struct warm_tb *w = key;
+
+    return w->crc ^ (uint32_t)w->pc ^ w->flags;
+}
+
+static gboolean warm_tb_equal(gconstpointer a, gconstpointer b)
+{
+    return !memcmp(a, b, sizeof(struct warm_tb));
+}
+
+static bool warm_tb_key(const TranslationBlock *tb, struct warm_tb *w)
+{
+#ifdef CONFIG_USER_ONLY
+    return false;
+#else
+    tb_page_addr_t phys0 = tb_page_addr0(tb);
+    tb_page_addr_t phys1 = tb_page_addr1(tb);
+    uint32_t len0;
+
+    if (phys0 == -1 || !tb->size) {
+        return false;
+    }
+    len0 = MIN(tb->size, TARGET_PAGE_SIZE - (phys0 & ~TARGET_PAGE_MASK));
+    if (len0 < tb->size && phys1 == -1) {
+        return false;
+    }
+
+    memset(w, 0, sizeof(*w));
+    w->pc = tb_cflags(tb) & CF_PCREL ? phys0 & ~TARGET_PAGE_MASK : tb->pc;
+    w->cs_base = tb->cs_base;
+    w->flags = tb->flags;
+    w->cflags = tb_cflags(tb) & ~CF_INVALID;
+    w->size = tb->size;
+    w->crc = crc32c(0xffffffff, qemu_map_ram_ptr(NULL, phys0), len0);
+    if (len0 < tb->size) {
+        w->crc = crc32c(w->crc, qemu_map_ram_ptr(NULL, phys1),
+                        tb->size - len0);
+    }
+    return true;
+#endif
+}
+
+static void warm_tb_add_locked(const struct warm_tb *w)
+{
+    if (g_hash_table_size(warm_tbs) < WARM_PROFILE_MAX &&
+        !g_hash_table_contains(warm_tbs, w)) {
+        g_hash_table_add(warm_tbs, g_memdup2(w, sizeof(*w)));
+    }
+}
+
+static bool warm_profile_match(const TranslationBlock *tb)
+{
+    struct warm_tb w;
+    bool found;
+
+    if (!warm_tbs || !warm_tb_key(tb, &w)) {
+        return false;
+    }
+    qemu_mutex_lock(&warm_tbs_lock);
+    found = g_hash_table_contains(warm_tbs, &w);
+    qemu_mutex_unlock(&warm_tbs_lock);
+    if (found) {
+        stat64_add(&warm_hits, 1);
+    }
+    return found;
+}
+
+static gboolean warm_profile_collect(gpointer key, gpointer value,
+                                     gpointer data)
+{
+    const TranslationBlock *tb = value;
+    GArray *tbs = data;
+    struct warm_tb w;
+
+    if (!(tb_cflags(tb) & CF_INVALID) && has_wasm_body(tb->tc.ptr) &&
+        warm_tb_key(tb, &w)) {
+        g_array_append_val(tbs, w);
+    }
+    return false;
+}
+
+bool wasm32_warm_profile_save(const char *path, Error **errp)
+{
+    g_autoptr(GArray) tbs = g_array_new(false, false, sizeof(struct warm_tb));
+    g_autoptr(GByteArray) out = g_byte_array_new();
+    g_autoptr(GError) err = NULL;
+    struct warm_profile_header h = {
+        .magic = WARM_PROFILE_MAGIC,
+        .target = TARGET_NAME,
+        .entry_size = sizeof(struct warm_tb),
+    };
+    GHashTableIter iter;
+    gpointer key;
+
+    if (!warm_tbs) {
+        error_setg(errp, "No wasm-profile file was given to -accel tcg");
+        return false;
+    }
+
+    /* the entries loaded at startup stay, so that the profile accumulates */
+    tcg_tb_foreach(warm_profile_collect, tbs);
+    qemu_mutex_lock(&warm_tbs_lock);
+    for (guint i = 0; i < tbs->len; i++) {
+        warm_tb_add_locked(&g_array_index(tbs, struct warm_tb, i));
+    }
+    h.num = g_hash_table_size(warm_tbs);
+    g_byte_array_append(out, (guint8 *)&h, sizeof(h));
+    g_hash_table_iter_init(&iter, warm_tbs);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        g_byte_array_append(out, key, sizeof(struct warm_tb));
+    }
+    qemu_mutex_unlock(&warm_tbs_lock);
+
+    if (!g_file_set_contents(path, (char *)out->data, out->len, &err)) {
+        error_setg(errp, "Could not save the wasm profile: %s", err->message);
+        return false;
+    }
+    return true;
+}
+
+static void warm_profile_load(const char *path)
+{
+    g_autofree char *buf = NULL;
+    g_autoptr(GError) err = NULL;
+    const struct warm_profile_header *h;
+    const struct warm_tb *w;
+    gsize len;
+
+    if (!g_file_get_contents(path, &buf, &len, &err)) {
+        /* nothing recorded yet on the first boot */
+        if (!g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            warn_report("wasm-profile: %s", err->message);
+        }
+        return;
+    }
+
+    h = (const struct warm_profile_header *)buf;
+    if (len < sizeof(*h) ||
+        memcmp(h->magic, WARM_PROFILE_MAGIC, sizeof(h->magic)) ||
+        strncmp(h->target, TARGET_NAME, sizeof(h->target)) ||
+        h->entry_size != sizeof(*w) ||
+        h->num > (len - sizeof(*h)) / sizeof(*w)) {
+        warn_report("wasm-profile: ignoring %s, it isn't a profile of "
+                    "this guest architecture", path);
+        return;
+    }
+    w = (const struct warm_tb *)(h + 1);
+    qemu_mutex_lock(&warm_tbs_lock);
+    for (uint32_t i = 0; i < h->num; i++) {
+        warm_tb_add_locked(&w[i]);
+    }
+    qemu_mutex_unlock(&warm_tbs_lock);
+}
+
+static void warm_profile_save_at_exit(Notifier *n, void *data)
+{
+    Error *err = NULL;
+
+    if (!wasm32_warm_profile_save(wasm32_warm_profile, &err)) {
+        error_report_err(err);
+    }
+}
+
+void wasm32_warm_profile_init(void)
+{
+    if (!wasm32_warm_profile) {
+        return;
+    }
+    qemu_mutex_init(&warm_tbs_lock);
+    warm_tbs = g_hash_table_new_full(warm_tb_hash, warm_tb_equal,
+                                     g_free, NULL);
+    warm_profile_load(wasm32_warm_profile);
+    if (wasm32_warm_profile_update) {
+        warm_profile_exit.notify = warm_profile_save_at_exit;
+        qemu_add_exit_notifier(&warm_profile_exit);
+    }
+}
+
+bool wasm32_take_hot_tb(const TranslationBlock *tb)
+{
+    translated_local++;
+    for (int i = 0; i < HOT_TB_HINTS_NUM; i++) {
+        if (hot_tb_hint_match(&hot_tb_hints[i], tb)) {
+            hot_tb_hints[i].valid = false;
+            return true;
+        }
+    }
+    return smc_hot_tb_match(tb) || warm_profile_match(tb);
+}
+
+int wasm32_threshold = WASM_THRESHOLD_DEFAULT;
+bool wasm32_persist_cache;
+bool wasm32_tail_call;
+int wasm32_diff_period;
+
+/* Validate a module whose only function does return_call to itself */
+EM_JS(int, wasm_tail_call_supported_js, (void), {
+        return WebAssembly.validate(new Uint8Array([
+            0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+            0x01, 0x04, 0x01, 0x60, 0x00, 0x00,             // type () -> ()
+            0x03, 0x02, 0x01, 0x00,                         // func 0
+            0x0a, 0x06, 0x01, 0x04, 0x00, 0x12, 0x00, 0x0b, // return_call 0
+        ])) ? 1 : 0;
+});
+
+bool wasm32_tail_call_supported(void)
+{
+    return wasm_tail_call_supported_js();
+}
+
+#define CPU_STATE_OFS(field) \
+    ((int)offsetof(CPUState, field) - (int)sizeof(CPUState))
+
+const struct wasm32_tb_lookup_layout *wasm32_tb_lookup_layout(void)
+{
+#if defined(TARGET_I386) && defined(CONFIG_SOFTMMU)
+    /* mirrors cpu_get_tb_cpu_state in target/i386/cpu.h */
+    static const struct wasm32_tb_lookup_layout layout = {
+        .pc_ofs = offsetof(CPUX86State, eip),
+        .pc_64 = sizeof(target_ulong) == 8,
+        .cs_base_ofs = offsetof(CPUX86State, segs[R_CS].base),
+        .flat_mask = HF_CS64_MASK,
+        .flags_ofs = offsetof(CPUX86State, hflags),
+        .flags_or_ofs = offsetof(CPUX86State, eflags),
+        .flags_or_mask = IOPL_MASK | TF_MASK | RF_MASK | VM_MASK | AC_MASK,
+        .jmp_cache_ofs = CPU_STATE_OFS(tb_jmp_cache),
+        .breakpoints_ofs = CPU_STATE_OFS(breakpoints.tqh_first),
+        .hash_shift = TARGET_PAGE_BITS - TB_JMP_PAGE_BITS,
+        .hash_page_mask = TB_JMP_PAGE_MASK,
+        .hash_addr_mask = TB_JMP_ADDR_MASK,
+        .array_ofs = offsetof(CPUJumpCache, array),
+        .entry_shift = 4,
+        .entry_pc_ofs = offsetof(CPUJumpCache, array[0].pc) -
+                        offsetof(CPUJumpCache, array[0]),
+    };
+    QEMU_BUILD_BUG_ON(sizeof(((CPUJumpCache *)0)->array[0]) != 1 << 4);
+    return &layout;
+#else
+    return NULL;
+#endif
+}
+
+/* Name of the Cache Storage of this build, NULL unless wasm-cache=on */
+static const char *wasm32_cache_name(void)
+{
+    return wasm32_persist_cache ? "qemu-wasm32-tb " QEMU_FULL_VERSION : NULL;
+}
+
+/* Number of modules being compiled by compile_wasm_async on this thread */
+__thread int wasm_compiling_num = 0;
+
+/*
+ * Longer TBs gain more from being compiled and are worth it sooner, while
+ * the short TBs that are mostly run once during boot wait longer.
+ */
+int wasm32_tb_threshold(const TranslationBlock *tb)
+{
+    int icount = MIN(tb->icount, 28);
+    return MAX(wasm32_threshold * 8 / (4 + icount), 1);
+}
+
+/* A TB jumping to itself is a loop, count these executions more */
+#define WASM_BACK_EDGE_WEIGHT 16
+
+/* Promotions are deferred while this many modules are being compiled */
+#define WASM_COMPILING_PRESSURE 4
+
+static Stat64 wasm_promoted;
+static Stat64 wasm_deferred;
+static Stat64 wasm_interp_ns;
+static Stat64 diff_compared;
+static Stat64 diff_skipped;
+static Stat64 diff_mismatches;
+static Stat64 wasm_scratch_max;
+
+void wasm32_note_scratch(size_t bytes)
+{
+    stat64_max(&wasm_scratch_max, bytes);
+}
+
+void wasm32_xlate_time(enum wasm32_xlate_phase phase, int64_t ns)
+{
+    xlate_ns_local[phase] += ns;
+    xlate_runs_local[phase]++;
+}
+
+static void xlate_dump_info(GString *buf)
+{
+    static const char *const names[WASM32_XLATE_PHASES] = {
+        [WASM32_XLATE_FRONTEND] = "frontend",
+        [WASM32_XLATE_OPTIMIZE] = "optimize",
+        [WASM32_XLATE_LIVENESS] = "liveness",
+        [WASM32_XLATE_CODEGEN] = "regalloc+emit",
+        [WASM32_XLATE_MODULE] = "wasm module",
+    };
+
+    g_string_append_printf(buf, "\nwasm32 translation:\n");
+    for (int i = 0; i < WASM32_XLATE_PHASES; i++) {
+        uint64_t ns = stat64_get(&xlate_ns[i]);
+        uint64_t runs = stat64_get(&xlate_runs[i]);
+
+        g_string_append_printf(buf, "%-20s%" PRIu64 " ms, %0.1f us x %"
+                               PRIu64 "\n", names[i], ns / SCALE_MS,
+                               runs ? (double)ns / runs / SCALE_US : 0,
+                               runs);
+    }
+}
+
+void wasm32_dump_info(GString *buf)
+{
+    uint64_t promoted = stat64_get(&wasm_promoted);
+    uint64_t interp_ms = stat64_get(&wasm_interp_ns) / SCALE_MS;
+
+    g_string_append_printf(buf, "\nwasm32 tier-up:\n");
+    g_string_append_printf(buf, "wasm threshold      %d\n", wasm32_threshold);
+    g_string_append_printf(buf, "wasm tail calls     %s\n",
+                           wasm32_tail_call ? "on" : "off");
+    g_string_append_printf(buf, "blocking calls      %s\n",
+                           WASM32_ASYNCIFY ? "asyncify" : "jspi");
+    g_string_append_printf(buf, "cpu_loop_exit       %s exceptions\n",
+                           WASM32_WASM_SJLJ ? "wasm" : "JS");
+    g_string_append_printf(buf, "TBs promoted        %" PRIu64 "\n", promoted);
+    g_string_append_printf(buf, "promotions deferred %" PRIu64 "\n",
+                           stat64_get(&wasm_deferred));
+    g_string_append_printf(buf, "rewritten hot TBs   %" PRIu64 "\n",
+                           stat64_get(&smc_hot_hits));
+    g_string_append_printf(buf, "avg time on TCI     %" PRIu64 " ms\n",
+                           promoted ? interp_ms / promoted : 0);
+    g_string_append_printf(buf, "instance cache      %d/%d KiB\n",
+                           qatomic_read(&instance_bytes_global) / KiB,
+                           MAX_INSTANCE_BYTES / KiB);
+    g_string_append_printf(buf, "instance hits       %" PRIu64 "\n",
+                           stat64_get(&instance_hits));
+    g_string_append_printf(buf, "instance misses     %" PRIu64 "\n",
+                           stat64_get(&instance_misses));
+    g_string_append_printf(buf, "instance evictions  %" PRIu64 "\n",
+                           stat64_get(&instance_evictions));
+    g_string_append_printf(buf, "evicted re-entered  %" PRIu64 "\n",
+                           stat64_get(&instance_churn));
+    g_string_append_printf(buf, "instances released  %" PRIu64 "\n",
+                           stat64_get(&instance_invalidated));
+    g_string_append_printf(buf, "instances retired   %" PRIu64 "\n",
+                           stat64_get(&instance_retired));
+    g_string_append_printf(buf, "dispatch hits       %" PRIu64 "\n",
+                           stat64_get(&dispatch_hits));
+    g_string_append_printf(buf, "dispatch fills      %" PRIu64 "\n",
+                           stat64_get(&dispatch_fills));
+    g_string_append_printf(buf, "translation scratch %" PRIu64 " KiB\n",
+                           stat64_get(&wasm_scratch_max) / KiB);
+    if (wasm32_warm_profile) {
+        g_string_append_printf(buf, "warm start hits     %" PRIu64 "\n",
+                               stat64_get(&warm_hits));
+    }
+    if (wasm32_diff_period) {
+        g_string_append_printf(buf, "TBs compared        %" PRIu64 "\n",
+                               stat64_get(&diff_compared));
+        g_string_append_printf(buf, "TBs not compared    %" PRIu64 "\n",
+                               stat64_get(&diff_skipped));
+        g_string_append_printf(buf, "tier mismatches     %" PRIu64 "\n",
+                               stat64_get(&diff_mismatches));
+    }
+    xlate_dump_info(buf);
+}
+
+static StatsList *wasm32_stats_add(StatsList *list, strList *names,
+                                   const char *name, uint64_t val)
+{
+    Stats *stats;
+
+    if (!apply_str_list_filter(name, names)) {
+        return list;
+    }
+    stats = g_new0(Stats, 1);
+    stats->name = g_strdup(name);
+    stats->value = g_new0(StatsValue, 1);
+    stats->value->type = QTYPE_QNUM;
+    stats->value->u.scalar = val;
+    QAPI_LIST_PREPEND(list, stats);
+    return list;
+}
+
+static StatsList *wasm32_stats_add_hist(StatsList *list, strList *names,
+                                        const char *name, Stat64 *buckets,
+                                        int n)
+{
+    uint64List *vals = NULL;
+    Stats *stats;
+
+    if (!apply_str_list_filter(name, names)) {
+        return list;
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        QAPI_LIST_PREPEND(vals, stat64_get(&buckets[i]));
+    }
+    stats = g_new0(Stats, 1);
+    stats->name = g_strdup(name);
+    stats->value = g_new0(StatsValue, 1);
+    stats->value->type = QTYPE_QLIST;
+    stats->value->u.list = vals;
+    QAPI_LIST_PREPEND(list, stats);
+    return list;
+}
+
+static StatsList *wasm32_vcpu_stats_list(struct wasm32_vcpu_stats *v,
+                                         strList *names)
+{
+    StatsList *list = NULL;
+
+    list = wasm32_stats_add(list, names, "tb-translated",
+                            stat64_get(&v->translated));
+    list = wasm32_stats_add(list, names, "tb-exec-tci",
+                            stat64_get(&v->tci_execs));
+    list = wasm32_stats_add(list, names, "tb-exec-wasm",
+                            stat64_get(&v->wasm_execs));
+    list = wasm32_stats_add(list, names, "instances-created",
+                            stat64_get(&v->instantiated));
+    list = wasm32_stats_add(list, names, "instances-evicted",
+                            stat64_get(&v->evicted));
+    list = wasm32_stats_add(list, names, "instances-released",
+                            stat64_get(&v->released));
+    list = wasm32_stats_add(list, names, "unwinds",
+                            stat64_get(&v->unwinds));
+    list = wasm32_stats_add_hist(list, names, "compile-latency",
+                                 v->compile_us, COMPILE_HIST_BUCKETS);
+    return list;
+}
+
+static void wasm32_stats_cb(StatsResultList **result, StatsTarget target,
+                            strList *names, strList *targets, Error **errp)
+{
+    StatsList *list = NULL;
+    CPUState *cpu;
+
+    switch (target) {
+    case STATS_TARGET_VM:
+        list = wasm32_stats_add(list, names, "instance-cache-bytes",
+                                qatomic_read(&instance_bytes_global));
+        list = wasm32_stats_add(list, names, "tb-promoted",
+                                stat64_get(&wasm_promoted));
+        list = wasm32_stats_add(list, names, "promotions-deferred",
+                                stat64_get(&wasm_deferred));
+        list = wasm32_stats_add(list, names, "tci-time-before-promotion",
+                                stat64_get(&wasm_interp_ns));
+        if (list) {
+            add_stats_entry(result, STATS_PROVIDER_TCG, NULL, list);
+        }
+        break;
+    case STATS_TARGET_VCPU:
+        CPU_FOREACH(cpu) {
+            if ((unsigned)cpu->cpu_index >= vcpu_stats_num ||
+                !apply_str_list_filter(cpu->parent_obj.canonical_path,
+                                       targets)) {
+                continue;
+            }
+            list = wasm32_vcpu_stats_list(&vcpu_stats[cpu->cpu_index], names);
+            if (list) {
+                add_stats_entry(result, STATS_PROVIDER_TCG,
+                                cpu->parent_obj.canonical_path, list);
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static StatsSchemaValueList *wasm32_schema_add(StatsSchemaValueList *list,
+                                               const char *name,
+                                               StatsType type, int unit,
+                                               int exponent)
+{
+    StatsSchemaValueList *entry = g_new0(StatsSchemaValueList, 1);
+
+    entry->value = g_new0(StatsSchemaValue, 1);
+    entry->value->name = g_strdup(name);
+    entry->value->type = type;
+    if (unit >= 0) {
+        entry->value->has_unit = true;
+        entry->value->unit = unit;
+    }
+    if (exponent) {
+        entry->value->exponent = exponent;
+        entry->value->has_base = true;
+        entry->value->base = 10;
+    }
+    entry->next = list;
+    return entry;
+}
+
+static void wasm32_schemas_cb(StatsSchemaList **result, Error **errp)
+{
+    StatsSchemaValueList *list = NULL;
+
+    list = wasm32_schema_add(list, "instance-cache-bytes", STATS_TYPE_INSTANT,
+                             STATS_UNIT_BYTES, 0);
+    list = wasm32_schema_add(list, "tb-promoted", STATS_TYPE_CUMULATIVE,
+                             -1, 0);
+    list = wasm32_schema_add(list, "promotions-deferred",
+                             STATS_TYPE_CUMULATIVE, -1, 0);
+    list = wasm32_schema_add(list, "tci-time-before-promotion",
+                             STATS_TYPE_CUMULATIVE, STATS_UNIT_SECONDS, -9);
+    add_stats_schema(result, STATS_PROVIDER_TCG, STATS_TARGET_VM, list);
+
+    list = NULL;
+    list = wasm32_schema_add(list, "tb-translated", STATS_TYPE_CUMULATIVE,
+                             -1, 0);
+    list = wasm32_schema_add(list, "tb-exec-tci", STATS_TYPE_CUMULATIVE,
+                             -1, 0);
+    list = wasm32_schema_add(list, "tb-exec-wasm", STATS_TYPE_CUMULATIVE,
+                             -1, 0);
+    list = wasm32_schema_add(list, "instances-created",
+                             STATS_TYPE_CUMULATIVE, -1, 0);
+    list = wasm32_schema_add(list, "instances-evicted",
+                             STATS_TYPE_CUMULATIVE, -1, 0);
+    list = wasm32_schema_add(list, "instances-released",
+                             STATS_TYPE_CUMULATIVE, -1, 0);
+    list = wasm32_schema_add(list, "unwinds", STATS_TYPE_CUMULATIVE, -1, 0);
+    list = wasm32_schema_add(list, "compile-latency",
+                             STATS_TYPE_LOG2_HISTOGRAM, STATS_UNIT_SECONDS,
+                             -6);
+    add_stats_schema(result, STATS_PROVIDER_TCG, STATS_TARGET_VCPU, list);
+}
+
+uint64_t wasm32_instantiated(void)
+{
+    uint64_t n = 0;
+
+    for (unsigned i = 0; i < vcpu_stats_num; i++) {
+        n += stat64_get(&vcpu_stats[i].instantiated);
+    }
+    return n;
+}
+
+void wasm32_stats_init(unsigned max_cpus)
+{
+    vcpu_stats = g_new0(struct wasm32_vcpu_stats, max_cpus);
+    vcpu_stats_num = max_cpus;
+    add_stats_callbacks(STATS_PROVIDER_TCG, wasm32_stats_cb,
+                        wasm32_schemas_cb);
+}
+
+/*
+ * Sampling profile of the TBs, keyed by guest physical pc so that it
+ * survives retranslation. Every WASM_PROF_PERIOD-th dispatch is counted
+ * for the tier the TB runs on, which includes the time spent in the
+ * helpers it calls and in the TBs it chains to. Unwinds and compile
+ * latencies are counted precisely.
+ */
+#define WASM_PROF_PERIOD 97
+
+struct wasm_prof_entry {
+    uint64_t phys_pc;
+    vaddr pc;
+    uint64_t tci_samples;
+    uint64_t wasm_samples;
+    uint64_t unwinds;
+    uint64_t compiles;
+    uint64_t compile_us;
+};
+
+enum wasm_prof_event {
+    WASM_PROF_TCI,
+    WASM_PROF_WASM,
+    WASM_PROF_UNWIND,
+};
+
+static QemuSpin wasm_prof_lock;
+static GHashTable *wasm_prof;
+__thread int wasm_prof_countdown = WASM_PROF_PERIOD;
+
+static struct wasm_prof_entry *wasm_prof_get(void *tb_ptr)
+{
+    TranslationBlock *tb = tcg_tb_lookup((uintptr_t)tb_ptr);
+    struct wasm_prof_entry *e;
+    uint64_t phys_pc;
+
+    if (tb == NULL || tb_page_addr0(tb) == -1) {
+        return NULL;
+    }
+    phys_pc = tb_page_addr0(tb);
+    if (wasm_prof == NULL) {
+        wasm_prof = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+    }
+    e = g_hash_table_lookup(wasm_prof, &phys_pc);
+    if (e == NULL) {
+        e = g_new0(struct wasm_prof_entry, 1);
+        e->phys_pc = phys_pc;
+        e->pc = (tb_cflags(tb) & CF_PCREL) ? 0 : tb->pc;
+        g_hash_table_insert(wasm_prof, &e->phys_pc, e);
+    }
+    return e;
+}
+
+static void wasm_prof_event(void *tb_ptr, enum wasm_prof_event ev)
+{
+    struct wasm_prof_entry *e;
+
+    qemu_spin_lock(&wasm_prof_lock);
+    e = wasm_prof_get(tb_ptr);
+    if (e != NULL) {
+        switch (ev) {
+        case WASM_PROF_TCI:
+            e->tci_samples++;
+            break;
+        case WASM_PROF_WASM:
+            e->wasm_samples++;
+            break;
+        case WASM_PROF_UNWIND:
+            e->unwinds++;
+            break;
+        }
+    }
+    qemu_spin_unlock(&wasm_prof_lock);
+}
+
+static inline void wasm_prof_sample(void *tb_ptr, bool on_wasm)
+{
+    if (unlikely(--wasm_prof_countdown == 0)) {
+        wasm_prof_countdown = WASM_PROF_PERIOD;
+        wasm_prof_event(tb_ptr, on_wasm ? WASM_PROF_WASM : WASM_PROF_TCI);
+    }
+}
+
+/* Called by compile_wasm_async for each TB of a compiled batch */
+EMSCRIPTEN_KEEPALIVE void wasm32_prof_compiled(void *tb_ptr, uint32_t us)
+{
+    struct wasm_prof_entry *e;
+
+    compile_us_local[us ? MIN(32 - clz32(us), COMPILE_HIST_BUCKETS - 1) : 0]++;
+
+    qemu_spin_lock(&wasm_prof_lock);
+    e = wasm_prof_get(tb_ptr);
+    if (e != NULL) {
+        e->compiles++;
+        e->compile_us += us;
+    }
+    qemu_spin_unlock(&wasm_prof_lock);
+}
+
+static gint wasm_prof_cmp(gconstpointer a, gconstpointer b)
+{
+    const struct wasm_prof_entry *ea = *(struct wasm_prof_entry **)a;
+    const struct wasm_prof_entry *eb = *(struct wasm_prof_entry **)b;
+    uint64_t na = ea->tci_samples + ea->wasm_samples;
+    uint64_t nb = eb->tci_samples + eb->wasm_samples;
+
+    return (na < nb) - (na > nb);
+}
+
+/* The entries sorted by samples, the caller holds wasm_prof_lock */
+static GPtrArray *wasm_prof_sorted(void)
+{
+    GPtrArray *arr = g_ptr_array_new();
+
+    if (wasm_prof != NULL) {
+        GHashTableIter iter;
+        gpointer value;
+
+        g_hash_table_iter_init(&iter, wasm_prof);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            g_ptr_array_add(arr, value);
+        }
+    }
+    g_ptr_array_sort(arr, wasm_prof_cmp);
+    return arr;
+}
+
+#define WASM_PROF_DUMP_MAX 32
+
+void wasm32_dump_profile(GString *buf)
+{
+    uint64_t total = 0;
+    GPtrArray *arr;
+
+    qemu_spin_lock(&wasm_prof_lock);
+    arr = wasm_prof_sorted();
+    for (int i = 0; i < arr->len; i++) {
+        struct wasm_prof_entry *e = g_ptr_array_index(arr, i);
+        total += e->tci_samples + e->wasm_samples;
+    }
+    g_string_append_printf(buf, "%u TBs, %" PRIu64 " samples, 1 per %d dispatches\n",
+                           arr->len, total, WASM_PROF_PERIOD);
+    g_string_append_printf(buf, "%-18s %-18s %6s %8s %8s %7s %8s\n", "phys pc", "pc",
+                           "%", "tci", "wasm", "unwinds", "comp ms");
+    for (int i = 0; i < MIN(arr->len, WASM_PROF_DUMP_MAX); i++) {
+        struct wasm_prof_entry *e = g_ptr_array_index(arr, i);
+        uint64_t n = e->tci_samples + e->wasm_samples;
+        g_string_append_printf(buf, "0x%016" PRIx64 " 0x%016" VADDR_PRIx " %6.2f %8" PRIu64
+                               " %8" PRIu64 " %7" PRIu64 " %8.2f\n",
+                               e->phys_pc, e->pc, total ? n * 100.0 / total : 0.0,
+                               e->tci_samples, e->wasm_samples, e->unwinds,
+                               e->compile_us / 1000.0);
+    }
+    qemu_spin_unlock(&wasm_prof_lock);
+    g_ptr_array_free(arr, true);
+}
+
+/* The whole profile as JSON, to be freed by the caller */
+EMSCRIPTEN_KEEPALIVE char *wasm32_profile_json(void)
+{
+    GString *buf = g_string_new("{\"period\":");
+    GPtrArray *arr;
+
+    g_string_append_printf(buf, "%d,\"tbs\":[", WASM_PROF_PERIOD);
+    qemu_spin_lock(&wasm_prof_lock);
+    arr = wasm_prof_sorted();
+    for (int i = 0; i < arr->len; i++) {
+        struct wasm_prof_entry *e = g_ptr_array_index(arr, i);
+        g_string_append_printf(buf, "%s{\"phys_pc\":%" PRIu64 ",\"pc\":%" PRIu64
+                               ",\"tci\":%" PRIu64 ",\"wasm\":%" PRIu64
+                               ",\"unwinds\":%" PRIu64 ",\"compiles\":%" PRIu64
+                               ",\"compile_us\":%" PRIu64 "}",
+                               i ? "," : "", e->phys_pc, (uint64_t)e->pc,
+                               e->tci_samples, e->wasm_samples, e->unwinds,
+                               e->compiles, e->compile_us);
+    }
+    qemu_spin_unlock(&wasm_prof_lock);
+    g_ptr_array_free(arr, true);
+    g_string_append(buf, "]}");
+    return g_string_free(buf, false);
+}
+
+/* Count an execution of the TB on TCI, true once it has to be compiled */
+static inline bool tci_count_tb(void *tb_ptr, int step)
+{
+    int32_t *tb_counter_ptr = (int32_t *)(wasm32_tb_vecs(tb_ptr) + counter_vec_off);
+    if (*tb_counter_ptr < INSTANTIATE_NUM) {
+        if (*tb_counter_ptr >= 0) { // negative while compiling
+            *tb_counter_ptr += step;
+        }
+        return false;
+    }
+    return true;
+}
+
+/*
+ * The TB reached INSTANTIATE_NUM but has only TCI code. Drop it so that
+ * cpu_exec retranslates it with the wasm module on the next lookup.
+ * Returns the dropped TB, which is still valid memory for the exit.
+ */
+static TranslationBlock *retranslate_hot_tb(void *tb_ptr)
+{
+    TranslationBlock *tb = tcg_tb_lookup((uintptr_t)tb_ptr);
+    if (tb == NULL || tb_page_addr0(tb) == -1) {
+        return NULL;
+    }
+    if (wasm_compiling_num >= WASM_COMPILING_PRESSURE) {
+        // try again later instead of making the compile queue longer
+        int tb_counter_ptr = wasm32_tb_vecs(tb_ptr) + counter_vec_off;
+        *(int32_t*)tb_counter_ptr = INSTANTIATE_NUM - wasm32_tb_threshold(tb) / 4;
+        stat64_inc(&wasm_deferred);
+        return NULL;
+    }
+    stat64_inc(&wasm_promoted);
+    stat64_add(&wasm_interp_ns, get_clock() - tb->wasm_gen_time);
+    wasm32_mark_hot_tb(tb);
+    tb_phys_invalidate(tb, -1);
+    return tb;
+}
+
+static bool has_instance_running_local(void *tb_ptr)
+{
+    int tb_export_ptr = wasm32_tb_vecs(tb_ptr) + export_vec_off;
+    struct instance_info *elm = (struct instance_info *)(*(uint32_t*)tb_export_ptr);
+    return (elm != NULL) && (elm->tb == tb_ptr);
+}
+
+/*
+ * Direct-mapped cache of the instances entered from the dispatcher, so
+ * that dispatching a hot TB reads one entry and the instance instead of
+ * the TB header, its per-core vectors and then the instance. An entry is
+ * checked against the instance like the export vector is, which drops it
+ * once the instance is released or moved in the ring; the whole cache is
+ * dropped when code_gen_buffer is flushed and TB addresses are reused.
+ */
+#define DISPATCH_CACHE_BITS 10
+#define DISPATCH_CACHE_SIZE (1 << DISPATCH_CACHE_BITS)
+
+struct dispatch_cache_entry {
+    void *tb_ptr;
+    struct instance_info *elm;
+};
+
+__thread struct dispatch_cache_entry dispatch_cache[DISPATCH_CACHE_SIZE];
+__thread uint32_t dispatch_cache_flush_count = 0;
 
-        const fidx = addFunction(inst.exports.start, 'ii');
+static inline struct dispatch_cache_entry *dispatch_cache_entry(void *tb_ptr)
+{
+    return &dispatch_cache[((uint32_t)tb_ptr >> 4) & (DISPATCH_CACHE_SIZE - 1)];
+}
 
-        return fidx;
-});
+static int get_instance_running_local(void *tb_ptr)
+{
+    struct dispatch_cache_entry *e = dispatch_cache_entry(tb_ptr);
+    struct instance_info *elm;
 
-__thread bool initdone = false;
-__thread int cur_core_num = -1;
-__thread int export_vec_off = -1;
-__thread int counter_vec_off = -1;
-__thread int all_cores_num = -1;
-int cur_core_num_max = 0;
+    if (unlikely(dispatch_cache_flush_count !=
+                 qatomic_read(&tb_ctx.tb_flush_count))) {
+        memset(dispatch_cache, 0, sizeof(dispatch_cache));
+        dispatch_cache_flush_count = qatomic_read(&tb_ctx.tb_flush_count);
+    }
+    if (likely(e->tb_ptr == tb_ptr && e->elm->tb == tb_ptr)) {
+        elm = e->elm;
+        dispatch_hits_local++;
+        elm->active = ctx.chain_epoch;
+        elm->ref = 1;
+        return elm->fidx;
+    }
 
-EM_JS(void, remove_module_js, (), {
-        const memory_v = new DataView(HEAP8.buffer);
-        const remove_n = memory_v.getInt32(Module.__wasm32_tb.to_remove_instance_idx_ptr, true);
-        for (var i = 0; i < remove_n * 4; i += 4) {
-            removeFunction(memory_v.getInt32(Module.__wasm32_tb.to_remove_instance_ptr + i, true));
-        }
-        memory_v.setInt32(Module.__wasm32_tb.to_remove_instance_idx_ptr, 0, true);
-    });
+    int tb_export_ptr = wasm32_tb_vecs(tb_ptr) + export_vec_off;
+    elm = (struct instance_info *)(*(uint32_t*)tb_export_ptr);
+    if (elm == NULL) {
+        return 0;
+    }
+    if (elm->tb != tb_ptr) {
+        *(uint32_t*)tb_export_ptr = 0;
+        int tb_counter_ptr = wasm32_tb_vecs(tb_ptr) + counter_vec_off;
+        *(uint32_t*)tb_counter_ptr = INSTANTIATE_NUM; // will be instanciated immediately
+        instance_churn_local++;
+        return 0;
+    }
+    e->tb_ptr = tb_ptr;
+    e->elm = elm;
+    dispatch_fills_local++;
+    elm->active = ctx.chain_epoch;
+    elm->ref = 1;
+    return elm->fidx;
+}
 
-int instance_alive_global = 0;
-__thread int instance_alive_local = 0;
-__thread int instance_running_local = 0;
-__thread uint32_t instance_garbage_collected_local = 0;
+/*
+ * Hot TBs reachable through patched goto_tb jumps are instantiated
+ * together with the TB that reached INSTANTIATE_NUM as one region module.
+ */
+#define REGION_MAX_TBS 8
+#define REGION_HOT_NUM (INSTANTIATE_NUM - wasm32_threshold / 2)
 
-struct instance_info {
-    uint8_t *tb;
-    int fidx;
-};
+static int form_region(void *tb_ptr, uint32_t *region)
+{
+    int n = 0;
+    int max = MIN(REGION_MAX_TBS, MAX_INSTANCE_ALIVE - qatomic_read(&instance_alive_global));
 
-#define MAX_INSTANCE_ALIVE 15000
-#define INSTANCE_RUNNING_LEN MAX_INSTANCE_ALIVE
-__thread struct instance_info instance_running[INSTANCE_RUNNING_LEN];
-__thread int instance_running_begin = 0;
-__thread int instance_running_end = 0;
+    region[n++] = (uint32_t)tb_ptr;
+    for (int i = 0; (i < n) && (n < max); i++) {
+        TranslationBlock *tb = tcg_tb_lookup(region[i]);
+        if (tb == NULL) {
+            continue;
+        }
+        for (int j = 0; (j < 2) && (n < max); j++) {
+            uint32_t next = (uint32_t)qatomic_read(&tb->jmp_target_addr[j]);
+            bool found = false;
+            if (next == 0) {
+                continue;
+            }
+            for (int k = 0; k < n; k++) {
+                if (region[k] == next) {
+                    found = true;
+                    break;
+                }
+            }
+            if (found || has_instance_running_local((void *)next) ||
+                !has_wasm_body((void *)next)) {
+                continue;
+            }
+            int tb_counter_ptr = wasm32_tb_vecs((void *)next) + counter_vec_off;
+            if (*(int32_t*)tb_counter_ptr >= REGION_HOT_NUM) {
+                region[n++] = next;
+            }
+        }
+    }
+    return n;
+}
 
-#define TO_REMOVE_INSTANCE_SIZE 50000
-__thread static int to_remove_instance[TO_REMOVE_INSTANCE_SIZE];
-__thread static int to_remove_instance_idx = 0;
+#define WASM_COMPILING -1
 
-static bool can_add_instance()
+/* The generation of the code of a TB, for the modules kept by JS */
+EMSCRIPTEN_KEEPALIVE uint32_t wasm32_code_gen(const void *tb_ptr)
 {
-    return qatomic_read(&instance_alive_global) < MAX_INSTANCE_ALIVE;
+    return tcg_region_gen(tb_ptr);
 }
 
-static void inc_instance_local()
+/*
+ * Set the counter of a TB back to INSTANTIATE_NUM once a compile of it
+ * finished, or if @if_compiling only if it is still being compiled here.
+ * Returns false if the TB has been retired since its generation was
+ * @gen. JS calls this from the event loop, which may run outside
+ * cpu_exec, so the read-side section keeps the region from being reused
+ * while the counter is written.
+ */
+EMSCRIPTEN_KEEPALIVE bool wasm32_tb_rearm(const void *tb_ptr, uint32_t gen,
+                                          bool if_compiling)
 {
-    instance_running_local++;
-    instance_alive_local++;
+    RCU_READ_LOCK_GUARD();
+
+    if (tcg_region_gen(tb_ptr) != gen) {
+        return false;
+    }
+    int32_t *counter = (int32_t *)(wasm32_tb_vecs(tb_ptr) + counter_vec_off);
+    if (!if_compiling || *counter == WASM_COMPILING) {
+        *counter = INSTANTIATE_NUM;
+    }
+    return true;
 }
 
-static int instance_pending_gc_local()
+/*
+ * Hot TBs are not compiled one by one but collected into a batch that is
+ * compiled as one module, sharing the type section and the helper imports.
+ * The batch is compiled once it is full or after WASM_BATCH_WAIT dispatches.
+ */
+#define WASM_BATCH_MAX 16
+#define WASM_BATCH_WAIT 1000
+
+__thread uint32_t wasm_batch[WASM_BATCH_MAX];
+__thread uint32_t wasm_batch_gens[WASM_BATCH_MAX];
+__thread int wasm_batch_num = 0;
+__thread int wasm_batch_wait = 0;
+__thread uint32_t wasm_batch_flush_count = 0;
+
+static void flush_wasm_batch(void)
 {
-    return (instance_alive_local - instance_running_local);
+    if (wasm_batch_num == 0) {
+        return;
+    }
+    if (qatomic_read(&tb_ctx.tb_flush_count) == wasm_batch_flush_count) {
+        compile_wasm_async(wasm_batch, wasm_batch_num, counter_vec_off, INSTANTIATE_NUM,
+                           wasm32_cache_name());
+    } // otherwise code_gen_buffer was flushed and the TBs are gone
+    wasm_batch_num = 0;
 }
 
-static void check_instance_garbage_collected()
+static void add_wasm_batch(const uint32_t *tbs, int n)
 {
-    if (instance_garbage_collected_local > 0) {
-        if (instance_garbage_collected_local > instance_pending_gc_local()) {
-            printf("unexpected number of removed instances %d > %d",
-                   instance_garbage_collected_local, instance_pending_gc_local()); fflush(stdout);
-            exit(1);
+    if (wasm_batch_num > 0 &&
+        qatomic_read(&tb_ctx.tb_flush_count) != wasm_batch_flush_count) {
+        wasm_batch_num = 0;
+    }
+    if (wasm_batch_num + n > WASM_BATCH_MAX) {
+        flush_wasm_batch();
+    }
+    if (wasm_batch_num == 0) {
+        wasm_batch_flush_count = qatomic_read(&tb_ctx.tb_flush_count);
+        wasm_batch_wait = WASM_BATCH_WAIT;
+    }
+    for (int i = 0; i < n; i++) {
+        bool found = false;
+        for (int k = 0; k < wasm_batch_num; k++) {
+            if (wasm_batch[k] == tbs[i]) {
+                found = true;
+                break;
+            }
         }
-        qatomic_sub(&instance_alive_global, instance_garbage_collected_local);
-        instance_alive_local -= instance_garbage_collected_local;
-        instance_garbage_collected_local = 0;
+        if (!found) {
+            int tb_counter_ptr = wasm32_tb_vecs((void *)tbs[i]) + counter_vec_off;
+            *(int32_t*)tb_counter_ptr = WASM_COMPILING;
+            wasm_batch[wasm_batch_num] = tbs[i];
+            wasm_batch_gens[wasm_batch_num] = tcg_region_gen((void *)tbs[i]);
+            wasm_batch_num++;
+        }
+    }
+    if (wasm_batch_num == WASM_BATCH_MAX) {
+        flush_wasm_batch();
     }
 }
 
-static void remove_instance_running_local()
+static inline void tick_wasm_batch(void)
 {
-    if (instance_pending_gc_local() > 0) {
-        return;
+    if ((wasm_batch_num > 0) && (--wasm_batch_wait <= 0)) {
+        flush_wasm_batch();
     }
-    int to_remove = instance_running_local / 2;
-    for (int i = 0; i < to_remove; i++) {
-        instance_running[instance_running_begin].tb = NULL;
-        to_remove_instance[to_remove_instance_idx++] = instance_running[instance_running_begin].fidx;
-        instance_running_local--;
-        instance_running_begin = (instance_running_begin + 1)%INSTANCE_RUNNING_LEN;
+}
+
+/*
+ * Once tb_retire_oldest has taken a region out of use, drop the instances
+ * and the batched TBs whose code is there, before its TB addresses are
+ * reused. Their TBs are left alone, the region may already hold others.
+ * The rest of the cache stays as it is.
+ */
+__thread unsigned gen_changes_seen = 0;
+
+static void release_retired_instances(void)
+{
+    int removed = 0;
+    int i, j;
+
+    gen_changes_seen = qatomic_read(&tcg_region_gen_changes);
+    smp_rmb();
+
+    for (i = 0, j = instance_running_begin; i < instance_running_num;
+         i++, j = (j + 1) % INSTANCE_RUNNING_LEN) {
+        struct instance_info *elm = &instance_running[j];
+        if (elm->tb != NULL && tcg_region_gen(elm->tb) != elm->gen) {
+            drop_instance_running_local(elm);
+            removed++;
+        }
     }
+    stat64_add(&instance_retired, removed);
+    released_local += removed;
+
+    for (i = 0, j = 0; i < wasm_batch_num; i++) {
+        if (tcg_region_gen((void *)wasm_batch[i]) == wasm_batch_gens[i]) {
+            wasm_batch[j] = wasm_batch[i];
+            wasm_batch_gens[j] = wasm_batch_gens[i];
+            j++;
+        }
+    }
+    wasm_batch_num = j;
+
     if (to_remove_instance_idx > 0) {
         remove_module_js();
     }
 }
 
-static void add_instance_running_local(int fidx, void *tb_ptr)
+static int instantiate_hot_tb(void *tb_ptr)
 {
-    instance_running[instance_running_end].tb = tb_ptr;
-    instance_running[instance_running_end].fidx = fidx;
+    uint32_t region[WASM_BATCH_MAX];
+    int fidxs[WASM_BATCH_MAX];
+    int n = instantiate_compiled(tb_ptr, region, fidxs);
+    int ret = 0;
 
-    int tb_export_ptr = (uint32_t)tb_ptr + export_vec_off;
-    *(uint32_t*)tb_export_ptr = (uint32_t)(&(instance_running[instance_running_end]));
+    if (n > 0) {
+        for (int i = 0; i < n; i++) {
+            add_instance_running_local(fidxs[i], (void *)region[i]);
+            if (region[i] == (uint32_t)tb_ptr) {
+                ret = fidxs[i];
+            }
+        }
+        return ret;
+    }
 
-    instance_running_end  = (instance_running_end+1)%INSTANCE_RUNNING_LEN;
-    inc_instance_local();
-    qatomic_inc(&instance_alive_global);
+    // compile in the background unless that already failed
+    bool compile_failed = (n < 0);
+    n = form_region(tb_ptr, region);
+    if (!compile_failed) {
+        add_wasm_batch(region, n);
+        return 0;
+    }
 
+    if (n == 1) {
+        int fidx = instantiate_wasm();
+        add_instance_running_local(fidx, tb_ptr);
+        return fidx;
+    }
+    instantiate_wasm_region(region, n, fidxs);
+    for (int i = 0; i < n; i++) {
+        add_instance_running_local(fidxs[i], (void *)region[i]);
+    }
+    return fidxs[0];
 }
 
-static int get_instance_running_local(void *tb_ptr)
+/*
+ * Dispatches are time sliced. The clock is only read every check_interval
+ * dispatches, which adapts so that this happens about every
+ * SLICE_CHECK_MS. Once the slice expires the thread returns to the browser
+ * event loop if compiles are pending, and on the main browser thread also
+ * every SLICE_MAX_MS so that input and timers are handled. A yield that
+ * let no compile finish doubles the slice, one that did resets it.
+ */
+#define SLICE_CHECK_MS 1.0
+#define SLICE_MIN_MS 4.0
+#define SLICE_MAX_MS 50.0
+#define CHECK_INTERVAL_MIN 64
+#define CHECK_INTERVAL_MAX 65536
+__thread int exec_cnt = CHECK_INTERVAL_MIN;
+__thread int check_interval = CHECK_INTERVAL_MIN;
+__thread double slice_ms = SLICE_MIN_MS;
+__thread double slice_start = 0;
+__thread double last_check = 0;
+
+static void sched_yield_check(void)
 {
-    int tb_export_ptr = (uint32_t)tb_ptr + export_vec_off;
-    struct instance_info *elm = (struct instance_info *)(*(uint32_t*)tb_export_ptr);
-    if (elm == NULL) {
-        return 0;
+    double now = emscripten_get_now();
+    double since_check = now - last_check;
+
+    if (since_check < SLICE_CHECK_MS / 2 && check_interval < CHECK_INTERVAL_MAX) {
+        check_interval *= 2;
+    } else if (since_check > SLICE_CHECK_MS * 2 && check_interval > CHECK_INTERVAL_MIN) {
+        check_interval /= 2;
     }
-    if (elm->tb != tb_ptr) {
-        *(uint32_t*)tb_export_ptr = 0;
-        int tb_counter_ptr = (uint32_t)tb_ptr + counter_vec_off;
-        *(uint32_t*)tb_counter_ptr = INSTANTIATE_NUM; // will be instanciated immediately
-        return 0;
+    last_check = now;
+    fold_instance_stats();
+
+    int compiling = wasm_compiling_num;
+    double elapsed = now - slice_start;
+    if (!(compiling > 0 && elapsed >= slice_ms) &&
+        !(elapsed >= SLICE_MAX_MS && emscripten_is_main_browser_thread())) {
+        return;
     }
-    return elm->fidx;
+    // return to the browser main loop to let compiles finish
+    emscripten_sleep(0);
+    if (compiling > 0) {
+        slice_ms = (wasm_compiling_num < compiling) ? SLICE_MIN_MS
+                                                    : MIN(slice_ms * 2, SLICE_MAX_MS);
+    }
+    slice_start = last_check = emscripten_get_now();
 }
 
-#define MAX_EXEC_NUM 50000
-__thread int exec_cnt = MAX_EXEC_NUM;
 static inline void trysleep()
 {
     if (--exec_cnt == 0) {
-        if (!can_add_instance()) {
-            emscripten_sleep(0); // return to the browser main loop
-            check_instance_garbage_collected();
-        }
-        exec_cnt = MAX_EXEC_NUM;
+        sched_yield_check();
+        exec_cnt = check_interval;
     }
 }
 
-__thread struct wasmContext ctx = {
-    .tb_ptr = 0,
-    .stack = NULL,
-    /* .func_ptr = 0, */
-    /* .next_func_ptr = 0, */
-    .do_init = 1,
-    .stack128 = NULL,
-};
-
-void set_done_flag()
-{
-    ctx.done_flag = 1;
-}
-
 void set_unwinding_flag()
 {
     ctx.unwinding = 1;
+    unwinds_local++;
+    wasm_prof_event(ctx.tb_ptr, WASM_PROF_UNWIND);
 }
 
 typedef uint32_t (*wasm_func_ptr)(struct wasmContext*);
 
+/* Number of TCG threads, set from -smp before any TB is generated */
+static int core_nums;
+
+void set_core_nums(int n)
+{
+    core_nums = n;
+}
+
 int get_core_nums()
 {
-    return emscripten_num_logical_cores();
+    return core_nums ? core_nums : emscripten_num_logical_cores();
 }
 
-EM_JS(void, init_wasm32_js, (int tb_ptr_ptr, int cur_core_num, int to_remove_instance_ptr, int to_remove_instance_idx_ptr, int instance_garbage_collected_ptr), {
+EM_JS(void, init_wasm32_js, (int tb_ptr_ptr, int cur_core_num, int to_remove_instance_ptr, int to_remove_instance_idx_ptr, int compiling_ptr, int flush_count_ptr, int stack, int counter_vec_off, int compiling, int instantiate_num, const char *cache_name, uint32_t channel_id), {
         Module.__wasm32_tb = {
-            tb_ptr_ptr: tb_ptr_ptr,
+            // AREG0 and the call stack imported by all TB modules of this thread
+            areg0: new WebAssembly.Global({value: 'i64', mutable: true}, BigInt(0)),
+            stack: new WebAssembly.Global({value: 'i64', mutable: true}, BigInt(stack >>> 0)),
+            compiling_ptr: compiling_ptr >>> 0,
+            flush_count_ptr: flush_count_ptr >>> 0,
+            /*
+             * DataView of the wasm memory. Growing the memory replaces
+             * wasmMemory.buffer and views made before only cover the old
+             * length, so the view is made again only when that happens.
+             */
+            memory_v: null,
+            view: function () {
+                const buffer = wasmMemory.buffer;
+                if (this.memory_v === null || this.memory_v.buffer !== buffer) {
+                    this.memory_v = new DataView(buffer);
+                }
+                return this.memory_v;
+            },
+            compiled: new Map(),
+            compiled_flush_count: 0,
+            // whether no TB of a compiled batch has been retired since
+            gens_match: function (tbs, gens) {
+                for (let k = 0; k < tbs.length; k++) {
+                    if (_wasm32_code_gen(tbs[k]) != gens[k]) {
+                        return false;
+                    }
+                }
+                return true;
+            },
+            /*
+             * modules compiled by the other vCPU threads; the name is
+             * shared by the whole origin, so it carries an id of this
+             * QEMU for other instances not to install its code
+             */
+            channel: (typeof BroadcastChannel === "undefined") ? null :
+                new BroadcastChannel("qemu-wasm32-tb-" + (channel_id >>> 0)),
+            tb_ptr_ptr: tb_ptr_ptr >>> 0,
             cur_core_num: cur_core_num,
-            to_remove_instance_ptr: to_remove_instance_ptr,
-            to_remove_instance_idx_ptr: to_remove_instance_idx_ptr,
-            instance_garbage_collected_ptr: instance_garbage_collected_ptr,
-            inst_gc_registry: new FinalizationRegistry((i) => {
-                    if (i == "instance") {
-                        const memory_v = new DataView(HEAP8.buffer);
-                        let v = memory_v.getInt32(Module.__wasm32_tb.instance_garbage_collected_ptr, true);
-                        memory_v.setInt32(Module.__wasm32_tb.instance_garbage_collected_ptr, v + 1, true);
+            to_remove_instance_ptr: to_remove_instance_ptr >>> 0,
+            to_remove_instance_idx_ptr: to_remove_instance_idx_ptr >>> 0,
+            /*
+             * Build one module for a region of TBs. The function bodies of
+             * the per-TB modules are copied as they are, only the indices
+             * of the helper functions, types and globals are moved to the
+             * region's index space.
+             */
+            build_region: function (tbs, n) {
+                const memory_v = this.view();
+                const u8 = HEAPU8;
+
+                function read_u32(p) {
+                    let v = 0;
+                    let shift = 0;
+                    let b;
+                    do {
+                        b = u8[p++];
+                        v |= (b & 0x7f) << shift;
+                        shift += 7;
+                    } while (b & 0x80);
+                    return [v >>> 0, p];
+                }
+                function skip_leb(p) {
+                    while (u8[p++] & 0x80);
+                    return p;
+                }
+                function skip_limits(p) {
+                    const flags = u8[p++];
+                    p = skip_leb(p);
+                    if (flags & 1) {
+                        p = skip_leb(p);
+                    }
+                    return p;
+                }
+                function push_u32(out, v) {
+                    do {
+                        let b = v & 0x7f;
+                        v >>>= 7;
+                        if (v != 0) {
+                            b |= 0x80;
+                        }
+                        out.push(b);
+                    } while (v != 0);
+                }
+                function push_section(out, id, content) {
+                    out.push(id);
+                    push_u32(out, content.length);
+                    for (let i = 0; i < content.length; i++) {
+                        out.push(content[i]);
+                    }
+                }
+                function rewrite_body(p, end, out, func_map, type_map, global_base) {
+                    while (p < end) {
+                        const start = p;
+                        const op = u8[p++];
+                        let v;
+                        switch (op) {
+                        case 0x02: case 0x03: case 0x04: // block, loop, if
+                        case 0x3f: case 0x40: // memory.size, memory.grow
+                            p++;
+                            break;
+                        case 0x0c: case 0x0d: // br, br_if
+                        case 0x20: case 0x21: case 0x22: // local.*
+                        case 0x25: case 0x26: // table.get, table.set
+                            p = skip_leb(p);
+                            break;
+                        case 0x0e: // br_table
+                            [v, p] = read_u32(p);
+                            for (let i = 0; i <= v; i++) {
+                                p = skip_leb(p);
+                            }
+                            break;
+                        case 0x10: case 0x12: // call, return_call
+                            [v, p] = read_u32(p);
+                            out.push(op);
+                            push_u32(out, func_map[v]);
+                            continue;
+                        case 0x11: case 0x13: { // call_indirect, return_call_indirect
+                            let t;
+                            [v, p] = read_u32(p);
+                            [t, p] = read_u32(p);
+                            out.push(op);
+                            push_u32(out, type_map[v]);
+                            push_u32(out, t);
+                            continue;
+                        }
+                        case 0x1c: // select t
+                            [v, p] = read_u32(p);
+                            p += v;
+                            break;
+                        case 0x23: case 0x24: // global.get, global.set
+                            [v, p] = read_u32(p);
+                            out.push(op);
+                            push_u32(out, (v < 2) ? v : v + global_base); // areg0 and stack are shared
+                            continue;
+                        case 0x41: case 0x42: // i32.const, i64.const
+                            p = skip_leb(p);
+                            break;
+                        case 0x43:
+                            p += 4;
+                            break;
+                        case 0x44:
+                            p += 8;
+                            break;
+                        case 0xfc:
+                            [v, p] = read_u32(p);
+                            if (v == 8 || v == 12 || v == 14) {
+                                p = skip_leb(skip_leb(p));
+                            } else if (v == 10) {
+                                p += 2;
+                            } else if (v == 11) {
+                                p += 1;
+                            } else if (v >= 9) {
+                                p = skip_leb(p);
+                            }
+                            break;
+                        case 0xfd:
+                            [v, p] = read_u32(p);
+                            if (v <= 11 || v == 92 || v == 93) {
+                                p = skip_leb(skip_leb(p));
+                            } else if (v == 12 || v == 13) {
+                                p += 16;
+                            } else if (v >= 21 && v <= 34) {
+                                p += 1;
+                            } else if (v >= 84 && v <= 91) {
+                                p = skip_leb(skip_leb(p)) + 1;
+                            }
+                            break;
+                        case 0xfe:
+                            [v, p] = read_u32(p);
+                            if (v == 3) {
+                                p += 1;
+                            } else {
+                                p = skip_leb(skip_leb(p));
+                            }
+                            break;
+                        default:
+                            if (op >= 0x28 && op <= 0x3e) { // load/store
+                                p = skip_leb(skip_leb(p));
+                            }
+                            break;
+                        }
+                        for (let i = start; i < p; i++) {
+                            out.push(u8[i]);
+                        }
+                    }
+                }
+
+                const types = [0x60, 0x01, 0x7f, 0x01, 0x7f]; // type of start
+                let types_num = 1;
+                const type_idx = new Map(); // type entry -> type index
+                const imports = [];
+                const env_imports = [];
+                const bodies = [];
+                var helper = {};
+                const fptrs = [];
+                let helpers_num = 0;
+                const helper_idx = new Map(); // helper table index -> function index
+                const names = [];
+
+                for (let k = 0; k < n; k++) {
+                    const tb_ptr = memory_v.getUint32(tbs + k * 4, true);
+                    const tmp_body_size = memory_v.getInt32(tb_ptr + 8, true); // TB_TCI_SIZE_OFF
+                    const tmp_body_begin = tb_ptr + 8 + 4;
+                    const wasm_size = memory_v.getInt32(tmp_body_begin + tmp_body_size, true);
+                    const wasm_begin = tmp_body_begin + tmp_body_size + 4;
+                    const import_vec_size = memory_v.getInt32(wasm_begin + wasm_size, true);
+                    const import_vec_begin = wasm_begin + wasm_size + 4;
+
+                    // helpers and types shared by the TBs are imported/declared once
+                    const func_map = [];
+                    const type_map = [0];
+                    const global_base = k * 23;
+
+                    let p = wasm_begin + 8;
+                    const wasm_end = wasm_begin + wasm_size;
+                    while (p < wasm_end) {
+                        const id = u8[p];
+                        let size, q;
+                        [size, q] = read_u32(p + 1);
+                        const section_end = q + size;
+                        let cnt;
+                        [cnt, q] = read_u32(q);
+                        if (id == 1) { // type
+                            for (let i = 0; i < cnt; i++) {
+                                const entry = q;
+                                let m;
+                                [m, q] = read_u32(q + 1);
+                                q += m;
+                                [m, q] = read_u32(q);
+                                q += m;
+                                if (i > 0) {
+                                    const key = Array.prototype.join.call(u8.subarray(entry, q));
+                                    if (!type_idx.has(key)) {
+                                        for (let j = entry; j < q; j++) {
+                                            types.push(u8[j]);
+                                        }
+                                        type_idx.set(key, types_num++);
+                                    }
+                                    type_map.push(type_idx.get(key));
+                                }
+                            }
+                        } else if (id == 2) { // import
+                            for (let i = 0; i < cnt; i++) {
+                                const entry = q;
+                                let m;
+                                [m, q] = read_u32(q);
+                                q += m;
+                                [m, q] = read_u32(q);
+                                q += m;
+                                const kind = u8[q++];
+                                if (kind == 0) {
+                                    let t;
+                                    [t, q] = read_u32(q);
+                                    const fptr = memory_v.getInt32(import_vec_begin + func_map.length * 4, true);
+                                    if (!helper_idx.has(fptr)) {
+                                        const name = String(helpers_num);
+                                        push_u32(imports, 6);
+                                        for (const c of "helper") {
+                                            imports.push(c.charCodeAt(0));
+                                        }
+                                        push_u32(imports, name.length);
+                                        for (const c of name) {
+                                            imports.push(c.charCodeAt(0));
+                                        }
+                                        imports.push(0x00);
+                                        push_u32(imports, type_map[t]);
+                                        helper[helpers_num] = Module.__wasm32_tb.helper_fn(fptr);
+                                        fptrs.push(fptr);
+                                        helper_idx.set(fptr, helpers_num++);
+                                    }
+                                    func_map.push(helper_idx.get(fptr));
+                                } else {
+                                    if (kind == 3) { // global type and mutability
+                                        q += 2;
+                                    } else {
+                                        if (kind == 1) {
+                                            q++;
+                                        }
+                                        q = skip_limits(q);
+                                    }
+                                    if (k == 0) { // buffer, table and shared globals
+                                        for (let j = entry; j < q; j++) {
+                                            env_imports.push(u8[j]);
+                                        }
+                                    }
+                                }
+                            }
+                        } else if (id == 0 && cnt == 4 &&
+                                   String.fromCharCode(u8[q], u8[q + 1], u8[q + 2], u8[q + 3]) == "name") {
+                            // function name of the TB, -perfmap
+                            q += 4;
+                            while (q < section_end) {
+                                const sub_id = u8[q];
+                                let sub_size, r, m;
+                                [sub_size, q] = read_u32(q + 1);
+                                if (sub_id == 1) {
+                                    [m, r] = read_u32(q);  // count, 1
+                                    [m, r] = read_u32(r);  // function index
+                                    [m, r] = read_u32(r);
+                                    names[k] = String.fromCharCode.apply(null, u8.subarray(r, r + m));
+                                }
+                                q += sub_size;
+                            }
+                        } else if (id == 10) { // code
+                            let body_size;
+                            [body_size, q] = read_u32(q);
+                            const body_end = q + body_size;
+                            const body = [];
+                            let r;
+                            let nlocals;
+                            [nlocals, r] = read_u32(q);
+                            for (let i = 0; i < nlocals; i++) {
+                                r = skip_leb(r) + 1;
+                            }
+                            for (let j = q; j < r; j++) {
+                                body.push(u8[j]);
+                            }
+                            rewrite_body(r, body_end, body, func_map, type_map, global_base);
+                            bodies.push(body);
+                        }
+                        p = section_end;
+                    }
+                }
+
+                const out = [0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00];
+                let sec = [];
+                push_u32(sec, types_num);
+                push_section(out, 0x01, sec.concat(types));
+
+                sec = [];
+                push_u32(sec, helpers_num + 4);
+                push_section(out, 0x02, sec.concat(env_imports, imports));
+
+                sec = [];
+                push_u32(sec, n);
+                for (let k = 0; k < n; k++) {
+                    sec.push(0x00);
+                }
+                push_section(out, 0x03, sec);
+
+                sec = [];
+                push_u32(sec, n * 23);
+                for (let i = 0; i < n * 23; i++) {
+                    sec.push(0x7e, 0x01, 0x42, 0x00, 0x0b);
+                }
+                push_section(out, 0x06, sec);
+
+                sec = [];
+                push_u32(sec, n);
+                for (let k = 0; k < n; k++) {
+                    const name = "f" + k;
+                    push_u32(sec, name.length);
+                    for (const c of name) {
+                        sec.push(c.charCodeAt(0));
+                    }
+                    sec.push(0x00);
+                    push_u32(sec, helpers_num + k);
+                }
+                push_section(out, 0x07, sec);
+
+                sec = [];
+                push_u32(sec, n);
+                for (let k = 0; k < n; k++) {
+                    push_u32(sec, bodies[k].length);
+                    sec = sec.concat(bodies[k]);
+                }
+                push_section(out, 0x0a, sec);
+
+                if (names.length > 0) {
+                    const push_name = (out, name) => {
+                        push_u32(out, name.length);
+                        for (const c of name) {
+                            out.push(c.charCodeAt(0));
+                        }
+                    };
+                    const mod_name = [];
+                    push_name(mod_name, "qemu-tb");
+                    const fn_names = [];
+                    // sparse when only some of the TBs were named
+                    push_u32(fn_names, names.filter(() => true).length);
+                    names.forEach((name, k) => {
+                        push_u32(fn_names, helpers_num + k);
+                        push_name(fn_names, name);
+                    });
+                    sec = [];
+                    push_name(sec, "name");
+                    push_section(sec, 0x00, mod_name);
+                    push_section(sec, 0x01, fn_names);
+                    push_section(out, 0x00, sec);
+                }
+                return {bytes: new Uint8Array(out), helper: helper, fptrs: fptrs};
+            },
+            /*
+             * Compile through Cache Storage so that the engine can reuse the
+             * machine code it cached for the same module on an earlier page
+             * load. Modules are keyed by a hash of their bytes since these
+             * embed host addresses of the TBs.
+             */
+            compile_cached: function (cache_name, bytes) {
+                if (typeof caches === "undefined" || !WebAssembly.compileStreaming) {
+                    return WebAssembly.compile(bytes);
+                }
+                let h1 = 0x811c9dc5;
+                let h2 = 0x01000193;
+                for (let i = 0; i < bytes.length; i++) {
+                    h1 = Math.imul(h1 ^ bytes[i], 0x01000193);
+                    h2 = Math.imul(h2 + bytes[i], 0x5bd1e995) ^ (h2 >>> 15);
+                }
+                const url = "https://wasm32-tb.invalid/" + (h1 >>> 0).toString(16) +
+                    (h2 >>> 0).toString(16) + "-" + bytes.length + ".wasm";
+                return caches.open(cache_name).then(async (cache) => {
+                    let resp = await cache.match(url);
+                    if (resp === undefined) {
+                        await cache.put(url, new Response(bytes, {
+                                    headers: {"Content-Type": "application/wasm"}}));
+                        resp = await cache.match(url);
                     }
-            })
+                    return WebAssembly.compileStreaming(resp);
+                }).catch(() => WebAssembly.compile(bytes));
+            },
+            instantiate_region: function (mod, helper, n, fidxs) {
+                const memory_v = this.view();
+                const inst = new WebAssembly.Instance(mod, {
+                        "env": {
+                            "buffer": wasmMemory,
+                            "table": wasmTable,
+                            "areg0": Module.__wasm32_tb.areg0,
+                            "stack": Module.__wasm32_tb.stack,
+                                },
+                            "helper": helper,
+                                });
+
+                for (let k = 0; k < n; k++) {
+                    const fidx = addFunction(inst.exports["f" + k], 'ii');
+                    Module.__wasm32_tb.instances.set(fidx, inst);
+                    memory_v.setInt32(fidxs + k * 4, fidx, true);
+                }
+                return n;
+            },
+            // instances by function table slot, a region's is dropped with its last slot
+            instances: new Map(),
+            /*
+             * Module bytes are compiled straight from the wasm memory where
+             * the engine accepts a view of a SharedArrayBuffer, and copied
+             * into a staging buffer reused by the thread where it doesn't.
+             * See: https://bugzilla.mozilla.org/show_bug.cgi?id=1965217
+             */
+            shared_bytes_ok: (function () {
+                try {
+                    const sab = new SharedArrayBuffer(8);
+                    new Uint8Array(sab).set([0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00]);
+                    new WebAssembly.Module(new Uint8Array(sab));
+                    return true;
+                } catch (e) {
+                    return false;
+                }
+            })(),
+            staging: null,
+            module_bytes: function (begin, size) {
+                if (this.shared_bytes_ok) {
+                    return HEAPU8.subarray(begin, begin + size);
+                }
+                if (this.staging === null || this.staging.length < size) {
+                    const len = this.staging === null ? 65536 : this.staging.length * 2;
+                    this.staging = new Uint8Array(Math.max(len, size));
+                }
+                this.staging.set(HEAPU8.subarray(begin, begin + size));
+                return this.staging.subarray(0, size);
+            },
+            // helpers are never removed from the table, look each up once
+            helper_fns: new Map(),
+            helper_fn: function (fptr) {
+                let f = this.helper_fns.get(fptr);
+                if (f === undefined) {
+                    f = wasmTable.get(fptr);
+                    this.helper_fns.set(fptr, f);
+                }
+                return f;
+            }
         };
+
+        const tbctx = Module.__wasm32_tb;
+        if (cache_name && cur_core_num == 0 && typeof caches !== "undefined") {
+            // drop the modules cached by other QEMU builds
+            const name = UTF8ToString(cache_name);
+            caches.keys().then((keys) => {
+                    for (const k of keys) {
+                        if (k.startsWith("qemu-wasm32-tb") && k != name) {
+                            caches.delete(k);
+                        }
+                    }
+                }).catch(() => {});
+        }
+        if (tbctx.channel !== null) {
+            tbctx.channel.onmessage = (e) => {
+                const m = e.data;
+                const memory_v = tbctx.view();
+                const flush_count = memory_v.getUint32(tbctx.flush_count_ptr, true);
+                if (m.flush_count != flush_count || !tbctx.gens_match(m.tbs, m.gens)) {
+                    return; // the TBs are gone
+                }
+                if (tbctx.compiled_flush_count != flush_count) {
+                    tbctx.compiled.clear();
+                    tbctx.compiled_flush_count = flush_count;
+                }
+                // helpers are static functions at the same table index on all threads
+                var helper = {};
+                for (let i = 0; i < m.fptrs.length; i++) {
+                    helper[i] = tbctx.helper_fn(m.fptrs[i]);
+                }
+                const c = {mod: m.mod, helper: helper, tbs: m.tbs, gens: m.gens};
+                for (let k = 0; k < m.tbs.length; k++) {
+                    if (tbctx.compiled.has(m.tbs[k])) {
+                        continue;
+                    }
+                    tbctx.compiled.set(m.tbs[k], c);
+                    // compiled here too, but use whichever is ready first
+                    _wasm32_tb_rearm(m.tbs[k], m.gens[k], 1);
+                }
+            };
+        }
+});
+
+EM_JS(void, set_areg0_js, (int env), {
+        Module.__wasm32_tb.areg0.value = BigInt(env >>> 0);
 });
 
+/* Tells the threads of this QEMU from other ones in the same origin */
+static uint32_t wasm32_channel_id;
+
+static uint32_t get_channel_id(void)
+{
+    uint32_t id = qatomic_read(&wasm32_channel_id);
+
+    if (!id) {
+        uint32_t new_id = g_random_int() | 1;
+
+        id = qatomic_cmpxchg(&wasm32_channel_id, 0, new_id) ?: new_id;
+    }
+    return id;
+}
+
 void init_wasm32()
 {
     if (!initdone) {
         cur_core_num = qatomic_fetch_inc(&cur_core_num_max);
         all_cores_num = get_core_nums();
-        export_vec_off = 4 + 4 + cur_core_num * 4;
-        counter_vec_off = 4 + 4 + all_cores_num * 4 + 4 + cur_core_num * 4;
+        g_assert(cur_core_num < all_cores_num);
+        export_vec_off = cur_core_num * 4;
+        counter_vec_off = all_cores_num * 4 + cur_core_num * 4;
         ctx.stack = (uint64_t*)malloc(TCG_STATIC_CALL_ARGS_SIZE + TCG_STATIC_FRAME_SIZE);
         ctx.stack128 = (uint64_t*)malloc(TCG_STATIC_CALL_ARGS_SIZE + TCG_STATIC_FRAME_SIZE);
         ctx.tci_tb_ptr = (uint32_t*)&tci_tb_ptr;
-        init_wasm32_js((int)&ctx.tb_ptr, cur_core_num, (int)to_remove_instance, (int)&to_remove_instance_idx, (int)&instance_garbage_collected_local);
+        ctx.export_vec_off = export_vec_off;
+        instance_running = g_new0(struct instance_info, INSTANCE_RUNNING_LEN);
+        to_remove_instance = g_new(int, TO_REMOVE_INSTANCE_SIZE);
+        qemu_spin_init(&inval_queue.lock);
+        if (cur_core_num < INVAL_QUEUE_CORES) {
+            qatomic_set(&inval_queues[cur_core_num], &inval_queue);
+        }
+        init_wasm32_js((int)&ctx.tb_ptr, cur_core_num, (int)to_remove_instance, (int)&to_remove_instance_idx,
+                       (int)&wasm_compiling_num, (int)&tb_ctx.tb_flush_count, (int)ctx.stack,
+                       counter_vec_off, WASM_COMPILING, INSTANTIATE_NUM, wasm32_cache_name(),
+                       get_channel_id());
         initdone = true;
     }
 }
@@ -277,15 +2381,25 @@ static uint64_t tci_uint64(uint32_t high, uint32_t low)
     return ((uint64_t)high << 32) + low;
 }
 
-static void tci_args_ldst(uint32_t insn, TCGReg *r0, TCGReg *r1, MemOpIdx *m2, const void *tb_ptr, void **l0)
+/* See struct tci_ldst_rec, r2 is only set for MO_128 */
+static void tci_args_ldst(uint32_t insn, TCGReg *r0, TCGReg *r1, TCGReg *r2,
+                          MemOpIdx *m3, uint32_t **tb_ptr, void **l0)
 {
-    int diff = sextract32(insn, 12, 20);
-    *l0 = diff ? (uint8_t *)tb_ptr + diff : NULL;
+    unsigned id = extract32(insn, 18, TCI_LDST_ID_BITS);
+    const struct tci_ldst_rec *rec = &tci_ldst_recs[id];
 
-    uint64_t *data64 = (uint64_t*)*l0;
-    *r0 = (TCGReg)data64[0];
-    *r1 = (TCGReg)data64[1];
-    *m2 = (MemOpIdx)data64[2];
+    *r0 = extract32(insn, 8, 5);
+    *r1 = extract32(insn, 13, 5);
+    if (unlikely(extract32(insn, 30, 1))) {
+        uint32_t ext = *(*tb_ptr)++;
+
+        *r2 = extract32(ext, 0, 5);
+        if (id == 0) {
+            rec = (void *)((uint8_t *)*tb_ptr + sextract32(ext, 12, 20));
+        }
+    }
+    *l0 = (void *)rec;
+    *m3 = rec->oi;
 }
 
 /*
@@ -364,6 +2478,17 @@ static void tci_args_rrbb(uint32_t insn, TCGReg *r0, TCGReg *r1,
     *i3 = extract32(insn, 22, 6);
 }
 
+static void tci_args_rrcl(uint32_t insn, uint32_t **tb_ptr,
+                          TCGReg *r0, TCGReg *r1, TCGCond *c2, void **l3)
+{
+    uint32_t insn2 = *(*tb_ptr)++;
+
+    *r0 = extract32(insn, 8, 4);
+    *r1 = extract32(insn, 12, 4);
+    *c2 = extract32(insn, 16, 4);
+    *l3 = sextract32(insn2, 12, 20) + (void *)*tb_ptr;
+}
+
 static void tci_args_rrrc(uint32_t insn,
                           TCGReg *r0, TCGReg *r1, TCGReg *r2, TCGCond *c3)
 {
@@ -508,71 +2633,154 @@ static bool tci_compare64(uint64_t u0, uint64_t u1, TCGCond condition)
     return result;
 }
 
-static uint64_t tlb_load(CPUArchState *env, uint64_t taddr, MemOp mop, uint64_t* ptr, bool is_ld)
+/*
+ * Differential testing of the two tiers, -accel tcg,wasm-diff=N. Every
+ * Nth dispatch of a compiled TB on a thread runs the TB alone in TCI
+ * first, logging the guest stores and env stores it does. Then the env
+ * snapshot and the old bytes of the stores are put back, the instance
+ * runs from the same state without chaining, and the env, the bytes TCI
+ * stored and the next TB of both runs must match. A TCI run calling a
+ * helper or taking the slow path of a memory access is kept as is and
+ * only counted, running those twice is not harmless. Stores of the
+ * instance to bytes that TCI didn't store to are not seen.
+ */
+#define DIFF_STORES_MAX 256
+#define DIFF_ENV_STORES_MAX 256
+#define DIFF_REPORT_MAX 16
+#define DIFF_REPORT_LINES 8
+
+struct diff_store {
+    uint8_t *host;
+    uint64_t vaddr;
+    uint8_t size;
+    uint8_t old[16];
+    uint8_t tci[16];    // what TCI left there
+};
+
+struct diff_env_store {
+    uint32_t ofs;
+    uint32_t size;
+    const uint32_t *insn;
+};
+
+struct diff_run {
+    const uint32_t *code;   // TCI code of the TB
+    bool impure;
+    int nr_stores;
+    int nr_env_stores;
+    struct diff_store stores[DIFF_STORES_MAX];
+    struct diff_env_store env_stores[DIFF_ENV_STORES_MAX];
+};
+
+/* Set while TCI runs a TB that is being compared */
+static __thread struct diff_run *diff_run;
+static __thread struct diff_run *diff_buf;
+static __thread int diff_countdown;
+static __thread uint8_t *diff_env_in;
+static __thread uint8_t *diff_env_tci;
+
+static inline void diff_set_impure(void)
 {
-    uint64_t *data64 = (uint64_t*)ptr;
-    unsigned a_mask = (unsigned)data64[3];
-    int mask_ofs = (int)data64[4];
-    int8_t page_bits = (int8_t)data64[5];
-    uint64_t page_mask = (uint64_t)data64[6];
-    int table_ofs = (uint64_t)data64[7];
+    if (unlikely(diff_run)) {
+        diff_run->impure = true;
+    }
+}
 
-    unsigned s_bits = mop & MO_SIZE;
-    unsigned s_mask = (1u << s_bits) - 1;
-    tcg_target_long compare_mask;
-    int add_off = offsetof(CPUTLBEntry, addend);
+static inline void diff_note_store(uintptr_t host, uint64_t taddr, int size)
+{
+    struct diff_run *run = diff_run;
+    struct diff_store *s;
 
-    uint64_t tmp0 = taddr >> (page_bits - CPU_TLB_ENTRY_BITS);
-    uint64_t tmp2 = *(uint64_t*)((uint8_t*)env + mask_ofs);
-    uint64_t tmp2_b = *(uint64_t*)((uint8_t*)env + table_ofs);
-    uint64_t tmp3 = (tmp0 & tmp2) + tmp2_b;
-    int off = off = is_ld ? offsetof(CPUTLBEntry, addr_read)
-        : offsetof(CPUTLBEntry, addr_write);
-    uint64_t target = *(uint64_t*)((uint8_t*)tmp3 + off);
-    uint64_t c_addr = taddr;
-    if (a_mask < s_mask) {
-        c_addr += s_mask - a_mask;
+    if (likely(!run)) {
+        return;
+    }
+    if (run->nr_stores == DIFF_STORES_MAX) {
+        run->impure = true;
+        return;
     }
-    compare_mask = page_mask | a_mask;
-    c_addr &= compare_mask;
+    s = &run->stores[run->nr_stores++];
+    s->host = (uint8_t *)host;
+    s->vaddr = taddr;
+    s->size = size;
+    memcpy(s->old, s->host, size);
+}
 
-    if (c_addr == target) {
-        int32_t addend = *(uint32_t*)((uint8_t*)tmp3 + add_off);
-        uint64_t target_addr = taddr + addend;
-        return target_addr;
+static inline void diff_note_env(CPUArchState *env, void *ptr, uint32_t size,
+                                 const uint32_t *insn)
+{
+    struct diff_run *run = diff_run;
+    uintptr_t ofs = (uintptr_t)ptr - (uintptr_t)env;
+
+    if (likely(!run) || ofs >= sizeof(CPUArchState) ||
+        run->nr_env_stores == DIFF_ENV_STORES_MAX) {
+        return;
     }
-    return 0;
+    run->env_stores[run->nr_env_stores++] = (struct diff_env_store) {
+        .ofs = ofs, .size = size, .insn = insn,
+    };
 }
 
-static uint64_t tci_qemu_ld(CPUArchState *env, uint64_t taddr,
-                            MemOpIdx oi, const void *tb_ptr, uint64_t* ptr)
+struct tci_ldst_rec tci_ldst_recs[TCI_LDST_RECS_MAX];
+static unsigned tci_ldst_recs_used = 1;     /* id 0 means "in the pool" */
+static GHashTable *tci_ldst_rec_ids;
+static QemuMutex tci_ldst_recs_lock;
+
+static guint tci_ldst_rec_hash(gconstpointer p)
 {
-    MemOp mop = get_memop(oi);
-    uintptr_t ra = (uintptr_t)tb_ptr;
+    uint64_t w[3];
 
-    uint64_t target_addr = tlb_load(env, taddr, mop, ptr, true);
-    if (target_addr != 0) {
-        switch (mop & MO_SSIZE) {
-        case MO_UB:
-            return *(uint8_t*)target_addr;
-        case MO_SB:
-            return *(int8_t*)target_addr;
-        case MO_UW:
-            return *(uint16_t*)target_addr;
-        case MO_SW:
-            return *(int16_t*)target_addr;
-        case MO_UL:
-            return *(uint32_t*)target_addr;
-        case MO_SL:
-            return *(int32_t*)target_addr;
-        case MO_UQ:
-            return *(uint64_t*)target_addr;
-        default:
-            g_assert_not_reached();
-        }
+    QEMU_BUILD_BUG_ON(sizeof(struct tci_ldst_rec) != sizeof(w));
+    memcpy(w, p, sizeof(w));
+    return qemu_xxhash6(w[0], w[1], w[2], w[2] >> 32);
+}
+
+static gboolean tci_ldst_rec_equal(gconstpointer a, gconstpointer b)
+{
+    return !memcmp(a, b, sizeof(struct tci_ldst_rec));
+}
+
+static void __attribute__((constructor)) tci_ldst_recs_init(void)
+{
+    qemu_mutex_init(&tci_ldst_recs_lock);
+    tci_ldst_rec_ids = g_hash_table_new(tci_ldst_rec_hash, tci_ldst_rec_equal);
+}
+
+unsigned wasm32_tci_ldst_rec_id(const struct tci_ldst_rec *rec)
+{
+    unsigned id;
+
+    qemu_mutex_lock(&tci_ldst_recs_lock);
+    id = GPOINTER_TO_UINT(g_hash_table_lookup(tci_ldst_rec_ids, rec));
+    if (!id && tci_ldst_recs_used < TCI_LDST_RECS_MAX) {
+        id = tci_ldst_recs_used++;
+        tci_ldst_recs[id] = *rec;
+        g_hash_table_insert(tci_ldst_rec_ids, &tci_ldst_recs[id],
+                            GUINT_TO_POINTER(id));
     }
+    qemu_mutex_unlock(&tci_ldst_recs_lock);
+    return id;
+}
+
+/* The host address of a TLB hit, or 0 */
+static inline uintptr_t tlb_load(CPUArchState *env, uint64_t taddr,
+                                 const struct tci_ldst_rec *rec, bool is_ld)
+{
+    uintptr_t mask = *(uintptr_t *)((uint8_t *)env + rec->mask_ofs);
+    uintptr_t table = *(uintptr_t *)((uint8_t *)env + rec->table_ofs);
+    CPUTLBEntry *entry = (CPUTLBEntry *)(((taddr >> rec->tlb_shift) & mask) + table);
+    uint64_t target = is_ld ? entry->addr_read : entry->addr_write;
+
+    if (((taddr + rec->size_adj) & rec->cmp_mask) == target) {
+        return (uintptr_t)taddr + entry->addend;
+    }
+    return 0;
+}
 
-    switch (mop & MO_SSIZE) {
+static __attribute__((noinline)) uint64_t tci_qemu_ld_slow(CPUArchState *env, uint64_t taddr,
+                                                          MemOpIdx oi, uintptr_t ra)
+{
+    diff_set_impure();
+    switch (get_memop(oi) & MO_SSIZE) {
     case MO_UB:
         return helper_ldub_mmu(env, taddr, oi, ra);
     case MO_SB:
@@ -592,34 +2800,57 @@ static uint64_t tci_qemu_ld(CPUArchState *env, uint64_t taddr,
     }
 }
 
-static void tci_qemu_st(CPUArchState *env, uint64_t taddr, uint64_t val,
-                        MemOpIdx oi, const void *tb_ptr, uint64_t* ptr)
+static inline uint64_t tci_qemu_ld(CPUArchState *env, uint64_t taddr,
+                                   MemOpIdx oi, const void *tb_ptr, void *ptr)
 {
-    MemOp mop = get_memop(oi);
-    uintptr_t ra = (uintptr_t)tb_ptr;
+    uintptr_t host = tlb_load(env, taddr, ptr, true);
 
-    uint64_t target_addr = tlb_load(env, taddr, mop, ptr, false);
-    if (target_addr != 0) {
-        switch (mop & MO_SIZE) {
+    if (likely(host != 0)) {
+        MemOp mop = get_memop(oi);
+
+        if (mop & MO_BSWAP) {
+            switch (mop & MO_SSIZE) {
+            case MO_UW:
+                return bswap16(*(uint16_t *)host);
+            case MO_SW:
+                return (int16_t)bswap16(*(uint16_t *)host);
+            case MO_UL:
+                return bswap32(*(uint32_t *)host);
+            case MO_SL:
+                return (int32_t)bswap32(*(uint32_t *)host);
+            case MO_UQ:
+                return bswap64(*(uint64_t *)host);
+            default:
+                g_assert_not_reached();
+            }
+        }
+        switch (mop & MO_SSIZE) {
         case MO_UB:
-            *(uint8_t*)target_addr = (uint8_t)val;
-            break;
+            return *(uint8_t *)host;
+        case MO_SB:
+            return *(int8_t *)host;
         case MO_UW:
-            *(uint16_t*)target_addr = (uint16_t)val;
-            break;
+            return *(uint16_t *)host;
+        case MO_SW:
+            return *(int16_t *)host;
         case MO_UL:
-            *(uint32_t*)target_addr = (uint32_t)val;
-            break;
+            return *(uint32_t *)host;
+        case MO_SL:
+            return *(int32_t *)host;
         case MO_UQ:
-            *(uint64_t*)target_addr = (uint64_t)val;
-            break;
+            return *(uint64_t *)host;
         default:
             g_assert_not_reached();
         }
-        return;
     }
-    
-    switch (mop & MO_SIZE) {
+    return tci_qemu_ld_slow(env, taddr, oi, (uintptr_t)tb_ptr);
+}
+
+static __attribute__((noinline)) void tci_qemu_st_slow(CPUArchState *env, uint64_t taddr,
+                                                        uint64_t val, MemOpIdx oi, uintptr_t ra)
+{
+    diff_set_impure();
+    switch (get_memop(oi) & MO_SIZE) {
     case MO_UB:
         helper_stb_mmu(env, taddr, val, oi, ra);
         break;
@@ -637,6 +2868,81 @@ static void tci_qemu_st(CPUArchState *env, uint64_t taddr, uint64_t val,
     }
 }
 
+static inline void tci_qemu_st(CPUArchState *env, uint64_t taddr, uint64_t val,
+                               MemOpIdx oi, const void *tb_ptr, void *ptr)
+{
+    uintptr_t host = tlb_load(env, taddr, ptr, false);
+
+    if (likely(host != 0)) {
+        MemOp mop = get_memop(oi);
+
+        if (mop & MO_BSWAP) {
+            switch (mop & MO_SIZE) {
+            case MO_16:
+                val = bswap16(val);
+                break;
+            case MO_32:
+                val = bswap32(val);
+                break;
+            case MO_64:
+                val = bswap64(val);
+                break;
+            default:
+                break;
+            }
+        }
+        diff_note_store(host, taddr, memop_size(mop));
+        switch (mop & MO_SIZE) {
+        case MO_UB:
+            *(uint8_t *)host = val;
+            break;
+        case MO_UW:
+            *(uint16_t *)host = val;
+            break;
+        case MO_UL:
+            *(uint32_t *)host = val;
+            break;
+        case MO_UQ:
+            *(uint64_t *)host = val;
+            break;
+        default:
+            g_assert_not_reached();
+        }
+        return;
+    }
+    tci_qemu_st_slow(env, taddr, val, oi, (uintptr_t)tb_ptr);
+}
+
+/* Only used for MO_128, the fast path does two 64-bit accesses */
+static Int128 tci_qemu_ld128(CPUArchState *env, uint64_t taddr, MemOpIdx oi,
+                             bool inline_ok, const void *tb_ptr, void *ptr)
+{
+    uintptr_t ra = (uintptr_t)tb_ptr;
+
+    uintptr_t target_addr = inline_ok ? tlb_load(env, taddr, ptr, true) : 0;
+    if (target_addr != 0) {
+        return int128_make128(*(uint64_t*)target_addr, *(uint64_t*)(target_addr + 8));
+    }
+    diff_set_impure();
+    return helper_ld16_mmu(env, taddr, oi, ra);
+}
+
+static void tci_qemu_st128(CPUArchState *env, uint64_t taddr, Int128 val, MemOpIdx oi,
+                           bool inline_ok, const void *tb_ptr, void *ptr)
+{
+    uintptr_t ra = (uintptr_t)tb_ptr;
+
+    uintptr_t target_addr = inline_ok ? tlb_load(env, taddr, ptr, false) : 0;
+    if (target_addr != 0) {
+        diff_note_store(target_addr, taddr, 16);
+        *(uint64_t*)target_addr = int128_getlo(val);
+        *(uint64_t*)(target_addr + 8) = int128_gethi(val);
+        return;
+    }
+    diff_set_impure();
+    helper_st16_mmu(env, taddr, val, oi, ra);
+}
+
 #if TCG_TARGET_REG_BITS == 64
 # define CASE_32_64(x) \
         case glue(glue(INDEX_op_, x), _i64): \
@@ -649,13 +2955,183 @@ static void tci_qemu_st(CPUArchState *env, uint64_t taddr, uint64_t val,
 # define CASE_64(x)
 #endif
 
-__thread tcg_target_ulong regs[TCG_TARGET_NB_REGS];
+/* Vector registers, see tcg_tci_out_op_vec and tcg_tci_out_ldst_vec */
+static void tci_args_vldst(uint32_t insn, TCGReg *r0, TCGReg *r1,
+                           uint8_t *len, int32_t *ofs)
+{
+    *r0 = extract32(insn, 8, 4);
+    *r1 = extract32(insn, 12, 4);
+    *len = extract32(insn, 16, 1) ? 16 : 8;
+    *ofs = sextract32(insn, 17, 15);
+}
+
+static uint64_t tci_vec_lane(const uint8_t *v, unsigned vece, int i)
+{
+    switch (vece) {
+    case MO_8:
+        return v[i];
+    case MO_16:
+        return lduw_he_p(v + i * 2);
+    case MO_32:
+        return ldl_he_p(v + i * 4);
+    default:
+        return ldq_he_p(v + i * 8);
+    }
+}
+
+static void tci_vec_set_lane(uint8_t *v, unsigned vece, int i, uint64_t x)
+{
+    switch (vece) {
+    case MO_8:
+        v[i] = x;
+        break;
+    case MO_16:
+        stw_he_p(v + i * 2, x);
+        break;
+    case MO_32:
+        stl_he_p(v + i * 4, x);
+        break;
+    default:
+        stq_he_p(v + i * 8, x);
+        break;
+    }
+}
+
+static void tci_vec_dup(uint8_t *d, unsigned vece, uint64_t x)
+{
+    for (int i = 0; i < (16 >> vece); i++) {
+        tci_vec_set_lane(d, vece, i, x);
+    }
+}
+
+/* Lane-wise vector operations, matching the SIMD128 instructions. */
+static void tci_vec_op(TCGOpcode opc, uint32_t insn, const tcg_target_ulong *regs)
+{
+    uint8_t *d = ctx.vec_regs[extract32(insn, 8, 4)];
+    const uint8_t *a = ctx.vec_regs[extract32(insn, 12, 4)];
+    const uint8_t *b = ctx.vec_regs[extract32(insn, 16, 4)];
+    const uint8_t *c = ctx.vec_regs[extract32(insn, 20, 4)];
+    unsigned vece = extract32(insn, 24, 2);
+    unsigned imm = extract32(insn, 26, 6);
+    int bits = 8 << vece;
+    int64_t smax = MAKE_64BIT_MASK(0, bits - 1);
+    int64_t smin = -smax - 1;
+    uint64_t umax = MAKE_64BIT_MASK(0, bits);
+    uint8_t res[16];
+
+    for (int i = 0; i < (16 >> vece); i++) {
+        uint64_t x = tci_vec_lane(a, vece, i);
+        uint64_t y = tci_vec_lane(b, vece, i);
+        int64_t sx = sextract64(x, 0, bits);
+        int64_t sy = sextract64(y, 0, bits);
+        int64_t t;
+        uint64_t r;
+
+        switch (opc) {
+        case INDEX_op_add_vec:
+            r = x + y;
+            break;
+        case INDEX_op_sub_vec:
+            r = x - y;
+            break;
+        case INDEX_op_mul_vec:
+            r = x * y;
+            break;
+        case INDEX_op_and_vec:
+            r = x & y;
+            break;
+        case INDEX_op_or_vec:
+            r = x | y;
+            break;
+        case INDEX_op_xor_vec:
+            r = x ^ y;
+            break;
+        case INDEX_op_andc_vec:
+            r = x & ~y;
+            break;
+        case INDEX_op_not_vec:
+            r = ~x;
+            break;
+        case INDEX_op_neg_vec:
+            r = -x;
+            break;
+        case INDEX_op_abs_vec:
+            r = sx < 0 ? -sx : sx;
+            break;
+        case INDEX_op_ssadd_vec:
+            t = sx + sy;
+            r = MIN(MAX(t, smin), smax);
+            break;
+        case INDEX_op_usadd_vec:
+            r = MIN(x + y, umax);
+            break;
+        case INDEX_op_sssub_vec:
+            t = sx - sy;
+            r = MIN(MAX(t, smin), smax);
+            break;
+        case INDEX_op_ussub_vec:
+            r = x > y ? x - y : 0;
+            break;
+        case INDEX_op_smin_vec:
+            r = MIN(sx, sy);
+            break;
+        case INDEX_op_umin_vec:
+            r = MIN(x, y);
+            break;
+        case INDEX_op_smax_vec:
+            r = MAX(sx, sy);
+            break;
+        case INDEX_op_umax_vec:
+            r = MAX(x, y);
+            break;
+        case INDEX_op_shli_vec:
+            r = x << imm;
+            break;
+        case INDEX_op_shri_vec:
+            r = x >> imm;
+            break;
+        case INDEX_op_sari_vec:
+            r = sx >> imm;
+            break;
+        case INDEX_op_shls_vec: // the count is a register, taken modulo the lane width
+            r = x << (regs[extract32(insn, 16, 4)] & (bits - 1));
+            break;
+        case INDEX_op_shrs_vec:
+            r = x >> (regs[extract32(insn, 16, 4)] & (bits - 1));
+            break;
+        case INDEX_op_sars_vec:
+            r = sx >> (regs[extract32(insn, 16, 4)] & (bits - 1));
+            break;
+        case INDEX_op_cmp_vec:
+            if (is_unsigned_cond(imm)) {
+                r = tci_compare64(x, y, imm) ? -1 : 0;
+            } else {
+                r = tci_compare64(sx, sy, imm) ? -1 : 0;
+            }
+            break;
+        case INDEX_op_bitsel_vec:
+            r = (x & y) | (~x & tci_vec_lane(c, vece, i));
+            break;
+        default:
+            g_assert_not_reached();
+        }
+        tci_vec_set_lane(res, vece, i, r);
+    }
+    memcpy(d, res, sizeof(res));
+}
 
+/*
+ * The registers live in this frame rather than in TLS and their address is
+ * never passed on, so the compiler knows that guest memory accesses and
+ * helpers cannot modify them. Nothing in them is live across TBs.
+ */
 static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
 {
     uint32_t *tb_ptr = (uint8_t*)ctx.tb_ptr + *(uint32_t*)ctx.tb_ptr;
     uint64_t *stack = ctx.stack;
+    tcg_target_ulong regs[TCG_TARGET_NB_REGS];
 
+    tci_execs_local++;
     regs[TCG_AREG0] = (tcg_target_ulong)env;
     regs[TCG_REG_CALL_STACK] = (uintptr_t)stack;
     
@@ -683,6 +3159,7 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
         case INDEX_op_call:
             {
                 void *call_slots[MAX_CALL_IARGS];
+                tcg_target_ulong reg_args[5]; // NUM_OF_IARG_REGS
                 ffi_cif *cif;
                 void *func;
                 unsigned i, s, n;
@@ -697,15 +3174,17 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
                     regs[TCG_REG_R0] = (uint32_t)helper_lookup_tb_ptr((CPUArchState *)regs[reg_iarg_base]);
                     break;
                 }
+                diff_set_impure();
                 
                 int reg_idx = 0;
-                int reg_idx_end = 5; // NUM_OF_IARG_REGS
+                int reg_idx_end = ARRAY_SIZE(reg_args);
                 int stack_idx = 0;
+                memcpy(reg_args, &regs[reg_iarg_base], sizeof(reg_args));
                 n = cif->nargs;
                 for (i = s = 0; i < n; ++i) {
                     ffi_type *t = cif->arg_types[i];
                     if (reg_idx < reg_idx_end) {
-                        call_slots[i] = &regs[reg_iarg_base + reg_idx];
+                        call_slots[i] = &reg_args[reg_idx];
                         reg_idx += DIV_ROUND_UP(t->size, 8);
                     } else {
                         call_slots[i] = &stack[stack_idx];
@@ -756,6 +3235,12 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
             tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
             regs[r0] = tci_compare32(regs[r1], regs[r2], condition);
             break;
+#if TCG_TARGET_HAS_negsetcond_i32
+        case INDEX_op_negsetcond_i32:
+            tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
+            regs[r0] = -tci_compare32(regs[r1], regs[r2], condition);
+            break;
+#endif
         case INDEX_op_movcond_i32:
             tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
             tmp32 = tci_compare32(regs[r1], regs[r2], condition);
@@ -773,6 +3258,12 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
             tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
             regs[r0] = tci_compare64(regs[r1], regs[r2], condition);
             break;
+#if TCG_TARGET_HAS_negsetcond_i64
+        case INDEX_op_negsetcond_i64:
+            tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
+            regs[r0] = -(uint64_t)tci_compare64(regs[r1], regs[r2], condition);
+            break;
+#endif
         case INDEX_op_movcond_i64:
             tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
             tmp32 = tci_compare64(regs[r1], regs[r2], condition);
@@ -823,17 +3314,20 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
         CASE_32_64(st8)
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
+            diff_note_env(env, ptr, 1, savep);
             *(uint8_t *)ptr = regs[r0];
             break;
         CASE_32_64(st16)
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
+            diff_note_env(env, ptr, 2, savep);
             *(uint16_t *)ptr = regs[r0];
             break;
         case INDEX_op_st_i32:
         CASE_64(st32)
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
+            diff_note_env(env, ptr, 4, savep);
             *(uint32_t *)ptr = regs[r0];
             break;
 
@@ -981,6 +3475,12 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
                 tb_ptr = ptr;
             }
             break;
+        case INDEX_op_tci_brcond_i32:
+            tci_args_rrcl(insn, &tb_ptr, &r0, &r1, &condition, &ptr);
+            if (tci_compare32(regs[r0], regs[r1], condition)) {
+                tb_ptr = ptr;
+            }
+            break;
 #if TCG_TARGET_REG_BITS == 32 || TCG_TARGET_HAS_add2_i32
         case INDEX_op_add2_i32:
             tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
@@ -1011,6 +3511,13 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
             tci_write_reg64(regs, r1, r0, tmp64);
             break;
 #endif
+#if TCG_TARGET_HAS_extract2_i32
+        case INDEX_op_extract2_i32:
+            tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
+            tmp64 = ((uint64_t)(uint32_t)regs[r2] << 32) | (uint32_t)regs[r1];
+            regs[r0] = (uint32_t)(tmp64 >> pos);
+            break;
+#endif
 #if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
         CASE_32_64(ext8s)
             tci_args_rr(insn, &r0, &r1);
@@ -1076,6 +3583,7 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
         case INDEX_op_st_i64:
             tci_args_rrs(insn, &r0, &r1, &ofs);
             ptr = (void *)(regs[r1] + ofs);
+            diff_note_env(env, ptr, 8, savep);
             *(uint64_t *)ptr = regs[r0];
             break;
 
@@ -1127,6 +3635,25 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
             muls64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
             break;
 #endif
+#if TCG_TARGET_HAS_muluh_i64
+        case INDEX_op_muluh_i64:
+            tci_args_rrr(insn, &r0, &r1, &r2);
+            mulu64(&tmp64, &regs[r0], regs[r1], regs[r2]);
+            break;
+#endif
+#if TCG_TARGET_HAS_mulsh_i64
+        case INDEX_op_mulsh_i64:
+            tci_args_rrr(insn, &r0, &r1, &r2);
+            muls64(&tmp64, &regs[r0], regs[r1], regs[r2]);
+            break;
+#endif
+#if TCG_TARGET_HAS_extract2_i64
+        case INDEX_op_extract2_i64:
+            /* pos is never 0, tcg_gen_extract2_i64 emits a mov for it */
+            tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
+            regs[r0] = (regs[r1] >> pos) | (regs[r2] << (64 - pos));
+            break;
+#endif
 #if TCG_TARGET_HAS_add2_i64
         case INDEX_op_add2_i64:
             tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
@@ -1194,6 +3721,12 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
                 tb_ptr = ptr;
             }
             break;
+        case INDEX_op_tci_brcond_i64:
+            tci_args_rrcl(insn, &tb_ptr, &r0, &r1, &condition, &ptr);
+            if (tci_compare64(regs[r0], regs[r1], condition)) {
+                tb_ptr = ptr;
+            }
+            break;
         case INDEX_op_ext32s_i64:
         case INDEX_op_ext_i32_i64:
             tci_args_rr(insn, &r0, &r1);
@@ -1223,11 +3756,19 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
             tci_args_l(insn, tb_ptr, &ptr);
             if (*(uint32_t **)ptr != 0) {
                 tb_ptr = *(uint32_t **)ptr;
+                if (unlikely(diff_run)) {
+                    if (tb_ptr != ctx.tb_ptr) {
+                        // return like the instance, run with no chain budget
+                        ctx.tb_ptr = tb_ptr;
+                        return 0;
+                    }
+                    // and loop in the TB as it does
+                    tb_ptr = (uint8_t*)tb_ptr + *(uint32_t*)tb_ptr;
+                    break;
+                }
+                int step = (tb_ptr == ctx.tb_ptr) ? WASM_BACK_EDGE_WEIGHT : 1;
                 ctx.tb_ptr = tb_ptr;
-                int tb_counter_ptr = (uint32_t)tb_ptr + counter_vec_off;
-                if ((*(int32_t*)tb_counter_ptr >= 0) && (*(int32_t*)tb_counter_ptr < INSTANTIATE_NUM)) {
-                    *(int32_t*)tb_counter_ptr += 1;
-                } else {
+                if (tci_count_tb(tb_ptr, step)) {
                     // enter to wasm TB
                     return 0;
                 }
@@ -1243,12 +3784,18 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
                 return 0;
             }
             tb_ptr = ptr;
+            if (unlikely(diff_run)) {
+                if (tb_ptr != ctx.tb_ptr) {
+                    ctx.tb_ptr = tb_ptr;
+                    return 0;
+                }
+                tb_ptr = (uint8_t*)tb_ptr + *(uint32_t*)tb_ptr;
+                break;
+            }
 
+            int step = (tb_ptr == ctx.tb_ptr) ? WASM_BACK_EDGE_WEIGHT : 1;
             ctx.tb_ptr = tb_ptr;
-            int tb_counter_ptr = (uint32_t)tb_ptr + counter_vec_off;
-            if ((*(int32_t*)tb_counter_ptr >= 0) && (*(int32_t*)tb_counter_ptr < INSTANTIATE_NUM)) {
-                *(int32_t*)tb_counter_ptr += 1;
-            } else {
+            if (tci_count_tb(tb_ptr, step)) {
                 // enter to wasm TB
                 return 0;
             }
@@ -1257,22 +3804,22 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
             break;
 
         case INDEX_op_qemu_ld_a32_i32:
-            tci_args_ldst(insn, &r0, &r1, &oi, tb_ptr, &ptr);
+            tci_args_ldst(insn, &r0, &r1, &r2, &oi, &tb_ptr, &ptr);
             taddr = (uint32_t)regs[r1];
             goto do_ld_i32;
         case INDEX_op_qemu_ld_a64_i32:
-            tci_args_ldst(insn, &r0, &r1, &oi, tb_ptr, &ptr);
+            tci_args_ldst(insn, &r0, &r1, &r2, &oi, &tb_ptr, &ptr);
             taddr = regs[r1];
         do_ld_i32:
             regs[r0] = tci_qemu_ld(env, taddr, oi, tb_ptr, ptr);
             break;
 
         case INDEX_op_qemu_ld_a32_i64:
-            tci_args_ldst(insn, &r0, &r1, &oi, tb_ptr, &ptr);
+            tci_args_ldst(insn, &r0, &r1, &r2, &oi, &tb_ptr, &ptr);
             taddr = (uint32_t)regs[r1];
             goto do_ld_i64;
         case INDEX_op_qemu_ld_a64_i64:
-            tci_args_ldst(insn, &r0, &r1, &oi, tb_ptr, &ptr);
+            tci_args_ldst(insn, &r0, &r1, &r2, &oi, &tb_ptr, &ptr);
             taddr = regs[r1];
         do_ld_i64:
             tmp64 = tci_qemu_ld(env, taddr, oi, tb_ptr, ptr);
@@ -1284,63 +3831,369 @@ static inline uintptr_t tcg_qemu_tb_exec_tci(CPUArchState *env)
             break;
 
         case INDEX_op_qemu_st_a32_i32:
-            tci_args_ldst(insn, &r0, &r1, &oi, tb_ptr, &ptr);
+            tci_args_ldst(insn, &r0, &r1, &r2, &oi, &tb_ptr, &ptr);
             taddr = (uint32_t)regs[r1];
             goto do_st_i32;
         case INDEX_op_qemu_st_a64_i32:
-            tci_args_ldst(insn, &r0, &r1, &oi, tb_ptr, &ptr);
+            tci_args_ldst(insn, &r0, &r1, &r2, &oi, &tb_ptr, &ptr);
             taddr = regs[r1];
         do_st_i32:
             tci_qemu_st(env, taddr, regs[r0], oi, tb_ptr, ptr);
             break;
 
         case INDEX_op_qemu_st_a32_i64:
-            tci_args_ldst(insn, &r0, &r1, &oi, tb_ptr, &ptr);
+            tci_args_ldst(insn, &r0, &r1, &r2, &oi, &tb_ptr, &ptr);
             tmp64 = regs[r0];
             taddr = (uint32_t)regs[r1];
             goto do_st_i64;
         case INDEX_op_qemu_st_a64_i64:
-            tci_args_ldst(insn, &r0, &r1, &oi, tb_ptr, &ptr);
+            tci_args_ldst(insn, &r0, &r1, &r2, &oi, &tb_ptr, &ptr);
             tmp64 = regs[r0];
             taddr = regs[r1];
         do_st_i64:
             tci_qemu_st(env, taddr, tmp64, oi, tb_ptr, ptr);
             break;
 
+        case INDEX_op_qemu_ld_a32_i128:
+        case INDEX_op_qemu_ld_a64_i128:
+            tci_args_ldst(insn, &r0, &r1, &r2, &oi, &tb_ptr, &ptr);
+            taddr = regs[r1];
+            if (opc == INDEX_op_qemu_ld_a32_i128) {
+                taddr = (uint32_t)taddr;
+            }
+            {
+                const struct tci_ldst_rec *rec = ptr;
+                Int128 v = tci_qemu_ld128(env, taddr, oi, rec->fast_ok, tb_ptr, ptr);
+                regs[r0] = int128_getlo(v);
+                regs[r2] = int128_gethi(v);
+            }
+            break;
+
+        case INDEX_op_qemu_st_a32_i128:
+        case INDEX_op_qemu_st_a64_i128:
+            tci_args_ldst(insn, &r0, &r1, &r2, &oi, &tb_ptr, &ptr);
+            taddr = regs[r1];
+            if (opc == INDEX_op_qemu_st_a32_i128) {
+                taddr = (uint32_t)taddr;
+            }
+            {
+                const struct tci_ldst_rec *rec = ptr;
+                tci_qemu_st128(env, taddr,
+                               int128_make128(regs[r0], regs[r2]),
+                               oi, rec->fast_ok, tb_ptr, ptr);
+            }
+            break;
+
         case INDEX_op_mb:
             /* Ensure ordering for all kinds */
             smp_mb();
             break;
+
+            /* Vector operations. */
+
+        case INDEX_op_ld_vec:
+            tci_args_vldst(insn, &r0, &r1, &len, &ofs);
+            memcpy(ctx.vec_regs[r0], (void *)(regs[r1] + ofs), len);
+            break;
+        case INDEX_op_st_vec:
+            tci_args_vldst(insn, &r0, &r1, &len, &ofs);
+            diff_note_env(env, (void *)(regs[r1] + ofs), len, savep);
+            memcpy((void *)(regs[r1] + ofs), ctx.vec_regs[r0], len);
+            break;
+        case INDEX_op_mov_vec:
+            tci_args_rr(insn, &r0, &r1);
+            memcpy(ctx.vec_regs[r0], ctx.vec_regs[r1], 16);
+            break;
+        case INDEX_op_dup_vec:
+            tci_args_rr(insn, &r0, &r1);
+            tci_vec_dup(ctx.vec_regs[r0], extract32(insn, 24, 2), regs[r1]);
+            break;
+        case INDEX_op_add_vec:
+        case INDEX_op_sub_vec:
+        case INDEX_op_mul_vec:
+        case INDEX_op_and_vec:
+        case INDEX_op_or_vec:
+        case INDEX_op_xor_vec:
+        case INDEX_op_andc_vec:
+        case INDEX_op_not_vec:
+        case INDEX_op_neg_vec:
+        case INDEX_op_abs_vec:
+        case INDEX_op_ssadd_vec:
+        case INDEX_op_usadd_vec:
+        case INDEX_op_sssub_vec:
+        case INDEX_op_ussub_vec:
+        case INDEX_op_smin_vec:
+        case INDEX_op_umin_vec:
+        case INDEX_op_smax_vec:
+        case INDEX_op_umax_vec:
+        case INDEX_op_shli_vec:
+        case INDEX_op_shri_vec:
+        case INDEX_op_sari_vec:
+        case INDEX_op_shls_vec:
+        case INDEX_op_shrs_vec:
+        case INDEX_op_sars_vec:
+        case INDEX_op_cmp_vec:
+        case INDEX_op_bitsel_vec:
+            tci_vec_op(opc, insn, regs);
+            break;
         default:
             g_assert_not_reached();
         }
     }
 }
 
+static void diff_report_tb(const uint32_t *tb_ptr)
+{
+    TranslationBlock *tb = tcg_tb_lookup((uintptr_t)tb_ptr);
+
+    if (tb == NULL) {
+        error_report("wasm-diff: tiers diverge in TB %p", tb_ptr);
+    } else if (tb_cflags(tb) & CF_PCREL) {
+        error_report("wasm-diff: tiers diverge in TB at phys 0x%" PRIx64
+                     " flags 0x%" PRIx32, (uint64_t)tb_page_addr0(tb),
+                     tb->flags);
+    } else {
+        error_report("wasm-diff: tiers diverge in TB at pc 0x%" PRIx64
+                     " flags 0x%" PRIx32, (uint64_t)tb->pc, tb->flags);
+    }
+}
+
+/* The last TCI op storing to env + ofs, the culprit of a mismatch there */
+static const struct diff_env_store *diff_env_writer(const struct diff_run *run,
+                                                    uint32_t ofs)
+{
+    for (int i = run->nr_env_stores - 1; i >= 0; i--) {
+        const struct diff_env_store *e = &run->env_stores[i];
+
+        if (ofs >= e->ofs && ofs < e->ofs + e->size) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static uint64_t diff_bytes(const uint8_t *p, int size)
+{
+    uint64_t v = 0;
+
+    memcpy(&v, p, MIN(size, 8));
+    return v;
+}
+
+static void diff_check(CPUArchState *env, const uint32_t *tb_ptr,
+                       uint32_t tci_res, uint32_t res,
+                       const uint32_t *tci_next)
+{
+    const struct diff_run *run = diff_buf;
+    const uint8_t *wasm_env = (const uint8_t *)env;
+    int lines = 0;
+
+    if (tci_res == res && tci_next == ctx.tb_ptr &&
+        !memcmp(diff_env_tci, wasm_env, sizeof(CPUArchState))) {
+        int i;
+
+        for (i = 0; i < run->nr_stores; i++) {
+            const struct diff_store *s = &run->stores[i];
+
+            if (memcmp(s->host, s->tci, s->size)) {
+                break;
+            }
+        }
+        if (i == run->nr_stores) {
+            return;
+        }
+    }
+
+    // the first ones are reported, the rest only counted
+    if (stat64_get(&diff_mismatches) >= DIFF_REPORT_MAX) {
+        stat64_inc(&diff_mismatches);
+        return;
+    }
+    stat64_inc(&diff_mismatches);
+    diff_report_tb(tb_ptr);
+
+    if (tci_res != res || tci_next != ctx.tb_ptr) {
+        error_printf("  exit: tci 0x%" PRIx32 " next %p, wasm 0x%" PRIx32
+                     " next %p\n", tci_res, tci_next, res, ctx.tb_ptr);
+    }
+    for (uint32_t ofs = 0; ofs < sizeof(CPUArchState); ofs += 8) {
+        int size = MIN(8, sizeof(CPUArchState) - ofs);
+        const struct diff_env_store *e = NULL;
+
+        if (!memcmp(diff_env_tci + ofs, wasm_env + ofs, size)) {
+            continue;
+        }
+        if (++lines > DIFF_REPORT_LINES) {
+            error_printf("  ...\n");
+            break;
+        }
+        error_printf("  env+0x%" PRIx32 ": tci 0x%016" PRIx64
+                     ", wasm 0x%016" PRIx64, ofs,
+                     diff_bytes(diff_env_tci + ofs, size),
+                     diff_bytes(wasm_env + ofs, size));
+        for (int i = 0; i < size; i++) {
+            if (diff_env_tci[ofs + i] != wasm_env[ofs + i]) {
+                e = diff_env_writer(run, ofs + i);
+                break;
+            }
+        }
+        if (e) {
+            error_printf(", stored by %s at +0x%x of the TCI code\n",
+                         tcg_op_defs[extract32(*e->insn, 0, 8)].name,
+                         (unsigned)((uintptr_t)e->insn -
+                                    (uintptr_t)run->code));
+        } else {
+            error_printf(", not stored by TCI\n");
+        }
+    }
+    for (int i = 0; i < run->nr_stores; i++) {
+        const struct diff_store *s = &run->stores[i];
+
+        if (!memcmp(s->host, s->tci, s->size)) {
+            continue;
+        }
+        if (++lines > DIFF_REPORT_LINES) {
+            error_printf("  ...\n");
+            break;
+        }
+        error_printf("  store %d, %d bytes at 0x%" PRIx64 ": tci 0x%"
+                     PRIx64 ", wasm 0x%" PRIx64 "\n", i, s->size, s->vaddr,
+                     diff_bytes(s->tci, s->size), diff_bytes(s->host, s->size));
+    }
+}
+
+/*
+ * Runs the TB of ctx.tb_ptr in TCI and, if that went without side
+ * effects, again in the instance fidx from the same state. The state
+ * the instance left is kept.
+ */
+static uint32_t diff_exec(CPUArchState *env, int fidx)
+{
+    CPUState *cpu = env_cpu(env);
+    struct diff_run *run = diff_buf;
+    uint32_t *tb_ptr = ctx.tb_ptr;
+    uint16_t icount_low = cpu->neg.icount_decr.u16.low;
+    uint16_t icount_high = qatomic_read(&cpu->neg.icount_decr.u16.high);
+    bool can_do_io = cpu->neg.can_do_io;
+    uint32_t *tci_next;
+    uint32_t tci_res, res;
+
+    if (run == NULL) {
+        run = diff_buf = g_new0(struct diff_run, 1);
+        diff_env_in = g_malloc(sizeof(CPUArchState));
+        diff_env_tci = g_malloc(sizeof(CPUArchState));
+    }
+    run->code = (uint32_t *)((uint8_t *)tb_ptr + *tb_ptr);
+    run->impure = false;
+    run->nr_stores = 0;
+    run->nr_env_stores = 0;
+    memcpy(diff_env_in, env, sizeof(CPUArchState));
+
+    diff_run = run;
+    tci_res = tcg_qemu_tb_exec_tci(env);
+    diff_run = NULL;
+
+    // an exit request in between makes the runs differ
+    if (run->impure ||
+        qatomic_read(&cpu->neg.icount_decr.u16.high) != icount_high) {
+        stat64_inc(&diff_skipped);
+        return tci_res;
+    }
+
+    tci_next = ctx.tb_ptr;
+    memcpy(diff_env_tci, env, sizeof(CPUArchState));
+    for (int i = 0; i < run->nr_stores; i++) {
+        struct diff_store *s = &run->stores[i];
+        memcpy(s->tci, s->host, s->size);
+    }
+    for (int i = run->nr_stores - 1; i >= 0; i--) {
+        struct diff_store *s = &run->stores[i];
+        memcpy(s->host, s->old, s->size);
+    }
+    memcpy(env, diff_env_in, sizeof(CPUArchState));
+    cpu->neg.icount_decr.u16.low = icount_low;
+    cpu->neg.can_do_io = can_do_io;
+
+    ctx.tb_ptr = tb_ptr;
+    ctx.chain_budget = 0;
+    ctx.loop_budget = 0;
+    res = ((wasm_func_ptr)(fidx))(&ctx);
+
+    stat64_inc(&diff_compared);
+    diff_check(env, tb_ptr, tci_res, res, tci_next);
+    return res;
+}
+
 uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
                                             const void *v_tb_ptr)
 {
-    ctx.env = env;
+    if (ctx.env != env) {
+        // only changes when this thread runs several vCPUs round-robin
+        set_areg0_js((int)env);
+        ctx.env = env;
+        switch_stats_vcpu(env_cpu(env));
+    }
     ctx.tb_ptr = (uint32_t*)v_tb_ptr;
     ctx.do_init = 1;
+    // left set if a compared TCI run exited with a longjmp
+    diff_run = NULL;
     while (true) {
         trysleep();
-        int tb_counter_ptr = (uint32_t)ctx.tb_ptr + counter_vec_off;
+        // a new chain of directly called TBs starts at every dispatch
+        if (++ctx.chain_epoch == 0) {
+            ctx.chain_epoch = 1;
+        }
+        ctx.chain_budget = CHAIN_BUDGET_MAX;
+        ctx.loop_budget = LOOP_BUDGET_MAX;
+        if (unlikely(gen_changes_seen !=
+                     qatomic_read(&tcg_region_gen_changes))) {
+            release_retired_instances();
+        }
+        tick_wasm_batch();
+        if (qatomic_read(&inval_queue.num) > 0) {
+            release_invalidated_instances();
+        }
         uint32_t res;
         int fidx = get_instance_running_local(ctx.tb_ptr);
+        wasm_prof_sample(ctx.tb_ptr, fidx > 0);
         if (fidx > 0) {
-            res = ((wasm_func_ptr)(fidx))(&ctx);
-        } else if (*(int32_t*)tb_counter_ptr < INSTANTIATE_NUM) {
-            *(int32_t*)tb_counter_ptr += 1;
+            instance_hits_local++;
+            wasm_execs_local++;
+            if (unlikely(wasm32_diff_period) && --diff_countdown <= 0) {
+                diff_countdown = wasm32_diff_period;
+                res = diff_exec(env, fidx);
+            } else {
+                res = ((wasm_func_ptr)(fidx))(&ctx);
+            }
+        } else if (!tci_count_tb(ctx.tb_ptr, 1)) {
             res = tcg_qemu_tb_exec_tci(env);
         } else if (!can_add_instance()) {
+            instance_misses_local++;
             remove_instance_running_local();
-            check_instance_garbage_collected();
+            res = tcg_qemu_tb_exec_tci(env);
+        } else if (!has_wasm_body(ctx.tb_ptr)) {
+            TranslationBlock *tb = retranslate_hot_tb(ctx.tb_ptr);
+
+            if (tb) {
+                /*
+                 * Chained TBs may have run before it, so stop the chain
+                 * before this one as an exit request at its start does:
+                 * cpu_tb_exec then sets the pc from it.
+                 */
+                qatomic_set(&env_cpu(env)->neg.icount_decr.u16.high, -1);
+                ctx.tb_ptr = 0;
+                return (uintptr_t)tb | TB_EXIT_REQUESTED;
+            }
             res = tcg_qemu_tb_exec_tci(env);
         } else {
-            int fidx = instantiate_wasm();
-            add_instance_running_local(fidx, ctx.tb_ptr);
-            res = ((wasm_func_ptr)(fidx))(&ctx);
+            instance_misses_local++;
+            int fidx = instantiate_hot_tb(ctx.tb_ptr);
+            if (fidx > 0) {
+                wasm_execs_local++;
+                res = ((wasm_func_ptr)(fidx))(&ctx);
+            } else {
+                res = tcg_qemu_tb_exec_tci(env);
+            }
         }
         if ((uint32_t)ctx.tb_ptr == 0) {
             return res;
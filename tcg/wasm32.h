@@ -13,11 +13,19 @@ struct wasmContext {
     // 16
     uint32_t do_init;
     // 20
-    uint32_t done_flag;
+    uint32_t loop_budget;
     // 24
     uint64_t *stack128;
     // 28
     uint32_t unwinding;
+    // 32
+    uint32_t export_vec_off;
+    // 36
+    uint32_t chain_epoch;
+    // 40
+    uint32_t chain_budget;
+    // 48, vector registers shared by the wasm module and TCI
+    uint8_t vec_regs[16][16] QEMU_ALIGNED(16);
 };
 
 #define ENV_OFF 0
@@ -25,18 +33,273 @@ struct wasmContext {
 #define TB_PTR_OFF 8
 #define HELPER_RET_TB_PTR_OFF 12
 #define DO_INIT_OFF 16
-#define DONE_FLAG_OFF 20
+#define LOOP_BUDGET_OFF 20
 #define STACK128_OFF 24
 #define UNWINDING_OFF 28
+#define EXPORT_VEC_OFF_OFF 32
+#define CHAIN_EPOCH_OFF 36
+#define CHAIN_BUDGET_OFF 40
+#define VEC_REGS_OFF 48
 
-void set_done_flag();
+/*
+ * Per-core record of an instantiated TB module, pointed to by the TB's
+ * export vector. "active" holds the chain epoch while the instance is on
+ * the current chain of directly called TBs, so it is never re-entered.
+ * "ref" is the clock bit, set whenever the instance is entered, and
+ * "size" the bytes of the wasm body charged to the cache budget. "gen"
+ * is the tcg_region_gen of the TB when it was instantiated.
+ */
+struct instance_info {
+    uint8_t *tb;
+    int fidx;
+    uint32_t active;
+    uint32_t ref;
+    uint32_t size;
+    uint32_t gen;
+};
+
+#define INSTANCE_TB_OFF 0
+#define INSTANCE_FIDX_OFF 4
+#define INSTANCE_ACTIVE_OFF 8
+#define INSTANCE_REF_OFF 12
+
+/*
+ * The code of a TB starts with a constant-size header: the offset of its
+ * TCI code, the address of its per-core vectors and the size of the TCI
+ * code, which is followed by the wasm blob and the helper import vector.
+ * The vectors are an export vector (the instance_info of each core) and a
+ * counter vector, of get_core_nums() entries each. They are allocated from
+ * the end of the TB's region, away from the code, so counter updates don't
+ * dirty cache lines of code and the header doesn't grow with the cores.
+ */
+#define TB_TCI_CODE_OFF 0
+#define TB_VECS_OFF 4
+#define TB_TCI_SIZE_OFF 8
+
+static inline uint32_t wasm32_tb_vecs(const void *tb_ptr)
+{
+    return *(uint32_t *)((uintptr_t)tb_ptr + TB_VECS_OFF);
+}
+
+/*
+ * Constant operands of a TCI qemu_ld/st. The TLB lookup parameters are
+ * precomputed so that the interpreter's hit path is a load and compare.
+ *
+ * They only depend on the MemOpIdx and the target, so a guest has a few
+ * dozen distinct records. tcg_tci_out_qemu_ldst interns them into
+ * tci_ldst_recs and the op is a single word:
+ *
+ *   opc:8 data_reg:5 addr_reg:5 id:12 ext:1
+ *
+ * With ext set, a second word follows with the data_hi_reg of MO_128 in
+ * its low bits and, for id 0 once the table is full, a PC-relative
+ * pointer to the record in the constant pool in bits 12..31.
+ */
+struct tci_ldst_rec {
+    uint32_t oi;
+    uint8_t fast_ok;    // MO_128 accesses whose atomicity allows the fast path
+    uint8_t tlb_shift;  // page_bits - CPU_TLB_ENTRY_BITS
+    uint8_t size_adj;   // added to the address so that page crossings miss
+    uint8_t pad;
+    int32_t mask_ofs;   // CPUTLBDescFast of the mmu index, relative to env
+    int32_t table_ofs;
+    uint64_t cmp_mask;  // page mask and alignment bits
+};
+
+#define TCI_LDST_ID_BITS 12
+#define TCI_LDST_RECS_MAX (1 << TCI_LDST_ID_BITS)
+
+/*
+ * TBs run on any vCPU thread, so the table is shared by all of them.
+ * Entries are never changed once their id was handed out.
+ */
+extern struct tci_ldst_rec tci_ldst_recs[TCI_LDST_RECS_MAX];
+
+/* The id of rec in tci_ldst_recs, 0 if the table is full */
+unsigned wasm32_tci_ldst_rec_id(const struct tci_ldst_rec *rec);
+
+/*
+ * How the emitted code computes the tb_jmp_cache probe of
+ * helper_lookup_tb_ptr for the guest. All offsets are relative to env.
+ *
+ * flags = [flags_ofs] | ([flags_or_ofs] & flags_or_mask) and if flags has
+ * flat_mask set, or cs_base_ofs is negative, cs_base is 0 and pc = [pc_ofs].
+ * Otherwise pc = (uint32_t)([cs_base_ofs] + [pc_ofs]).
+ */
+struct wasm32_tb_lookup_layout {
+    int pc_ofs;
+    bool pc_64;             // pc and cs_base are 64 bit
+    int cs_base_ofs;
+    uint32_t flat_mask;
+    int flags_ofs;
+    int flags_or_ofs;
+    uint32_t flags_or_mask;
+    int jmp_cache_ofs;      // CPUState fields
+    int breakpoints_ofs;
+    int hash_shift;         // see tb_jmp_cache_hash_func
+    uint32_t hash_page_mask;
+    uint32_t hash_addr_mask;
+    int array_ofs;          // CPUJumpCache fields
+    int entry_shift;        // log2 of the entry size
+    int entry_pc_ofs;
+};
+
+/* NULL if cpu_get_tb_cpu_state of the guest is not a few loads */
+const struct wasm32_tb_lookup_layout *wasm32_tb_lookup_layout(void);
+
+/* Max number of TBs called directly via goto_tb or tail calls per dispatch */
+#define CHAIN_BUDGET_MAX 32
+
+/*
+ * Max number of times a TB jumps back to its own start within the wasm
+ * function per dispatch. Each iteration goes through the TB's check of
+ * icount_decr, so interrupts and exit requests are still seen at once;
+ * the budget only bounds how long the dispatcher (trysleep, instance
+ * cache upkeep) doesn't run.
+ */
+#define LOOP_BUDGET_MAX 4096
+
+/*
+ * Built with -sJSPI and -DWASM_JSPI, blocking calls suspend the whole wasm
+ * stack, TB code included, so nothing is unwound and rewound. The TB code
+ * then needs no unwinding checks and no blocks to rewind into.
+ */
+#ifdef WASM_JSPI
+#define WASM32_ASYNCIFY 0
+#else
+#define WASM32_ASYNCIFY 1
+#endif
+
+/*
+ * Built with -sSUPPORT_LONGJMP=wasm, cpu_loop_exit throws a wasm exception
+ * that sigsetjmp in cpu_exec catches, instead of a JS exception caught by
+ * an invoke_* JS wrapper. TB code has no try blocks and keeps nothing in
+ * wasmContext across a helper call that tcg_qemu_tb_exec doesn't reset
+ * on entry, so the exception just passes through it. Asyncify can't
+ * unwind and rewind through wasm exception handling, this needs JSPI.
+ */
+#ifdef __USING_WASM_SJLJ__
+#define WASM32_WASM_SJLJ 1
+#if WASM32_ASYNCIFY
+#error "-sSUPPORT_LONGJMP=wasm needs -sJSPI and -DWASM_JSPI"
+#endif
+#else
+#define WASM32_WASM_SJLJ 0
+#endif
 
 void set_unwinding_flag();
 
+void set_core_nums(int n);
+
 int get_core_nums();
 
 void init_wasm32();
 
-#define INSTANTIATE_NUM 1500
+/*
+ * A TB is compiled once its per-core counter reaches INSTANTIATE_NUM. The
+ * counter starts below that by the TB's threshold, see wasm32_tb_threshold.
+ */
+#define INSTANTIATE_NUM (1 << 24)
+
+/* Default TCI executions before compiling, -accel tcg,wasm-threshold=N */
+#define WASM_THRESHOLD_DEFAULT 1500
+#define WASM_THRESHOLD_MAX (INSTANTIATE_NUM / 16)
+
+extern int wasm32_threshold;
+
+/*
+ * Bounds of the cache of instantiated TBs, in instances alive and in wasm
+ * bytes, -accel tcg,wasm-instance-max=N,wasm-instance-cache=MiB. The
+ * defaults fit the memory browsers give a page.
+ */
+#define WASM_INSTANCE_MAX_DEFAULT 15000
+#define WASM_INSTANCE_MAX_LIMIT 1000000
+#define WASM_INSTANCE_BYTES_DEFAULT (96 * MiB)
+#define WASM_INSTANCE_BYTES_LIMIT (1024 * MiB)
+
+extern int wasm32_instance_max;
+extern int wasm32_instance_bytes;
+
+/* Keep compiled TB modules in Cache Storage across page loads */
+extern bool wasm32_persist_cache;
+
+/* Jump between TBs with wasm tail calls, -accel tcg,wasm-tail-call=on */
+extern bool wasm32_tail_call;
+
+bool wasm32_tail_call_supported(void);
+
+/*
+ * Run every Nth dispatch of a compiled TB in both tiers and compare them,
+ * -accel tcg,wasm-diff=N. 0 is off.
+ */
+extern int wasm32_diff_period;
+
+int wasm32_tb_threshold(const TranslationBlock *tb);
+
+/* Promotion statistics for "info jit" */
+void wasm32_dump_info(GString *buf);
+
+/*
+ * Phases of a translation whose host time "info jit" reports. Register
+ * allocation and the emission of the TCI code and of the wasm body are
+ * done op by op in one loop, so they are timed together.
+ */
+enum wasm32_xlate_phase {
+    WASM32_XLATE_FRONTEND,  /* gen_intermediate_code */
+    WASM32_XLATE_OPTIMIZE,  /* tcg_optimize */
+    WASM32_XLATE_LIVENESS,  /* reachable code and liveness passes */
+    WASM32_XLATE_CODEGEN,   /* register allocation, TCI code, wasm body */
+    WASM32_XLATE_MODULE,    /* the wasm module around the body */
+    WASM32_XLATE_PHASES,
+};
+
+/* Count @ns of host time of the calling thread in @phase */
+void wasm32_xlate_time(enum wasm32_xlate_phase phase, int64_t ns);
+
+/* Sampled per-TB profile for "info jit-profile" */
+void wasm32_dump_profile(GString *buf);
+
+/* Record the translation scratch of the calling thread, in bytes */
+void wasm32_note_scratch(size_t bytes);
+
+/* Register the per-vCPU counters of the "tcg" query-stats provider */
+void wasm32_stats_init(unsigned max_cpus);
+
+/*
+ * Wasm modules instantiated by all vCPUs so far; with MTTCG each thread
+ * instantiates the modules of the TBs it runs itself.
+ */
+uint64_t wasm32_instantiated(void);
+
+/*
+ * TBs are first translated without the wasm module. Once one gets hot it
+ * is invalidated and marked here so that the retranslation emits it.
+ */
+void wasm32_mark_hot_tb(const TranslationBlock *tb);
+
+bool wasm32_take_hot_tb(const TranslationBlock *tb);
+
+/*
+ * TBs with a wasm body are listed in this file at exit and on
+ * x-jit-profile-save. Loaded at startup, its TBs are compiled on their
+ * first run. -accel tcg,wasm-profile=FILE
+ */
+extern char *wasm32_warm_profile;
+
+/*
+ * Whether the profile is written back at exit, off for a profile shared
+ * by many VMs, -accel tcg,wasm-profile-update=off
+ */
+extern bool wasm32_warm_profile_update;
+
+void wasm32_warm_profile_init(void);
+
+bool wasm32_warm_profile_save(const char *path, Error **errp);
+
+/* Release the wasm instances of an invalidated TB on all cores */
+void wasm32_tb_invalidate(const TranslationBlock *tb);
+
+/* Called for a TB that a guest store is about to invalidate */
+void wasm32_tb_written(const TranslationBlock *tb);
 
 #endif
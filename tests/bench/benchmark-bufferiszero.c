@@ -0,0 +1,46 @@
+/*
+ * buffer_is_zero() speed benchmark
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include "qemu/cutils.h"
+
+static void test_bufferiszero_speed(void)
+{
+    static const size_t sizes[] = { 512, 4096, 65536 };
+    const size_t total = 2 * GiB;
+    uint8_t *buf = g_malloc0(sizes[ARRAY_SIZE(sizes) - 1]);
+    int accel = 0;
+
+    /* From the preferred accelerator down to the integer version */
+    do {
+        for (int i = 0; i < ARRAY_SIZE(sizes); i++) {
+            size_t remain;
+
+            g_test_timer_start();
+            for (remain = total; remain; remain -= sizes[i]) {
+                g_assert(buffer_is_zero(buf, sizes[i]));
+            }
+            g_test_timer_elapsed();
+
+            g_test_message("buffer_is_zero(accel %d): chunk %zu bytes "
+                           "%.2f MB/sec", accel, sizes[i],
+                           total / MiB / g_test_timer_last());
+        }
+        accel++;
+    } while (test_buffer_is_zero_next_accel());
+
+    g_free(buf);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/util/benchmark/bufferiszero", test_bufferiszero_speed);
+
+    return g_test_run();
+}
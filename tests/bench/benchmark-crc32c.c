@@ -0,0 +1,50 @@
+/*
+ * crc32c() speed benchmark
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include "qemu/crc32c.h"
+
+static void test_crc32c_speed(const void *opaque)
+{
+    size_t chunk_size = GPOINTER_TO_SIZE(opaque);
+    const size_t total = 1 * GiB;
+    uint8_t *buf = g_malloc(chunk_size);
+    uint32_t crc = 0xffffffff;
+    size_t remain;
+
+    memset(buf, g_test_rand_int(), chunk_size);
+
+    g_test_timer_start();
+    for (remain = total; remain; remain -= chunk_size) {
+        crc = crc32c(crc, buf, chunk_size);
+    }
+    g_test_timer_elapsed();
+
+    g_test_message("crc32c: chunk %zu bytes %.2f MB/sec (crc %08x)",
+                   chunk_size, total / MiB / g_test_timer_last(), crc);
+
+    g_free(buf);
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t sizes[] = { 64, 512, 4096, 65536 };
+    char name[64];
+    int i;
+
+    g_test_init(&argc, &argv, NULL);
+
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        snprintf(name, sizeof(name), "/util/benchmark/crc32c/bufsize-%zu",
+                 sizes[i]);
+        g_test_add_data_func(name, GSIZE_TO_POINTER(sizes[i]),
+                             test_crc32c_speed);
+    }
+
+    return g_test_run();
+}
@@ -0,0 +1,70 @@
+/*
+ * XBZRLE encoding speed benchmark
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.  See the COPYING file in the
+ * top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include "../migration/xbzrle.h"
+
+#define PAGE_SIZE 4096
+
+/* Encode pages with @nr_changes runs of up to @run_len changed bytes */
+static void test_xbzrle_speed(const void *opaque)
+{
+    const int *params = opaque;
+    int nr_changes = params[0], run_len = params[1];
+    const size_t total = 1 * GiB;
+    uint8_t *old_buf = g_malloc(PAGE_SIZE);
+    uint8_t *new_buf = g_malloc(PAGE_SIZE);
+    uint8_t *dst = g_malloc(PAGE_SIZE);
+    size_t remain;
+    int i, j;
+
+    for (i = 0; i < PAGE_SIZE; i++) {
+        old_buf[i] = g_test_rand_int();
+    }
+    memcpy(new_buf, old_buf, PAGE_SIZE);
+    for (i = 0; i < nr_changes; i++) {
+        int start = g_test_rand_int_range(0, PAGE_SIZE);
+        int len = g_test_rand_int_range(1, run_len + 1);
+
+        for (j = start; j < MIN(start + len, PAGE_SIZE); j++) {
+            new_buf[j] = ~old_buf[j];
+        }
+    }
+
+    g_test_timer_start();
+    for (remain = total; remain; remain -= PAGE_SIZE) {
+        xbzrle_encode_buffer(old_buf, new_buf, PAGE_SIZE, dst, PAGE_SIZE);
+    }
+    g_test_timer_elapsed();
+
+    g_test_message("xbzrle: %d changes of up to %d bytes %.2f MB/sec",
+                   nr_changes, run_len, total / MiB / g_test_timer_last());
+
+    g_free(old_buf);
+    g_free(new_buf);
+    g_free(dst);
+}
+
+int main(int argc, char **argv)
+{
+    static const int params[][2] = {
+        { 0, 0 }, { 8, 4 }, { 8, 256 }, { 64, 16 },
+    };
+    char name[64];
+    int i;
+
+    g_test_init(&argc, &argv, NULL);
+
+    for (i = 0; i < ARRAY_SIZE(params); i++) {
+        snprintf(name, sizeof(name), "/migration/benchmark/xbzrle/%d-%d",
+                 params[i][0], params[i][1]);
+        g_test_add_data_func(name, params[i], test_xbzrle_speed);
+    }
+
+    return g_test_run();
+}
@@ -19,6 +19,7 @@
 #include "qemu/option.h"
 #include "qemu/range.h"
 #include "qemu/sockets.h"
+#include "qemu/units.h"
 #include "chardev/char.h"
 #include "qapi/qapi-visit-sockets.h"
 #include "qapi/qobject-input-visitor.h"
@@ -2124,6 +2125,81 @@ static void test_precopy_file_offset_bad(void)
     test_file_common(&args, false);
 }
 
+static void *test_precopy_file_dedup_start(QTestState *from, QTestState *to)
+{
+    migrate_set_capability(from, "dedup-pages", true);
+    migrate_set_capability(to, "dedup-pages", true);
+
+    return NULL;
+}
+
+static void test_precopy_file_dedup_finish(QTestState *from, QTestState *to,
+                                           void *opaque)
+{
+    g_autofree char *path = g_strdup_printf("%s/%s", tmpfs, FILE_TEST_FILENAME);
+    struct stat st;
+
+    /*
+     * The guest only changes the first byte of its test pages, so there
+     * are few distinct ones: in full, they would take close to 100 MB.
+     */
+    g_assert(stat(path, &st) == 0);
+    g_assert_cmpint(st.st_size, <, 16 * MiB);
+}
+
+static void test_precopy_file_dedup(void)
+{
+    g_autofree char *uri = g_strdup_printf("file:%s/%s", tmpfs,
+                                           FILE_TEST_FILENAME);
+    MigrateCommon args = {
+        .connect_uri = uri,
+        .listen_uri = "defer",
+        .start_hook = test_precopy_file_dedup_start,
+        .finish_hook = test_precopy_file_dedup_finish,
+    };
+
+    /* pages are only deduplicated when the source is stopped */
+    test_file_common(&args, true);
+}
+
+static void test_dedup_incompatible(void)
+{
+    static const char *const caps[] = {
+        "multifd", "postcopy-ram", "xbzrle",
+    };
+    MigrateStart args = {};
+    QTestState *from, *to;
+
+    if (test_migrate_start(&from, &to, "defer", &args)) {
+        return;
+    }
+
+    for (int i = 0; i < ARRAY_SIZE(caps); i++) {
+        QDict *err;
+
+        err = qtest_qmp_assert_failure_ref(
+            from, "{ 'execute': 'migrate-set-capabilities',"
+            "'arguments': { 'capabilities': ["
+            "{ 'capability': 'dedup-pages', 'state': true },"
+            "{ 'capability': %s, 'state': true } ] } }", caps[i]);
+        g_assert(strstr(qdict_get_str(err, "desc"), "dedup-pages"));
+        qobject_unref(err);
+
+        /* either way round */
+        migrate_set_capability(from, caps[i], true);
+        err = qtest_qmp_assert_failure_ref(
+            from, "{ 'execute': 'migrate-set-capabilities',"
+            "'arguments': { 'capabilities': ["
+            "{ 'capability': 'dedup-pages', 'state': true } ] } }");
+        g_assert(strstr(qdict_get_str(err, "desc"), "dedup-pages"));
+        qobject_unref(err);
+        migrate_set_capability(from, caps[i], false);
+    }
+
+    migrate_set_capability(from, "dedup-pages", true);
+    test_migrate_end(from, to, false);
+}
+
 static void *test_mode_reboot_start(QTestState *from, QTestState *to)
 {
     migrate_set_parameter_str(from, "mode", "cpr-reboot");
@@ -3383,6 +3459,9 @@ int main(int argc, char **argv)
                    test_precopy_file_offset);
     qtest_add_func("/migration/precopy/file/offset/bad",
                    test_precopy_file_offset_bad);
+    qtest_add_func("/migration/precopy/file/dedup",
+                   test_precopy_file_dedup);
+    qtest_add_func("/migration/dedup/incompatible", test_dedup_incompatible);
 
     /*
      * Our CI system has problems with shared memory.
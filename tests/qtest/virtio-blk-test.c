@@ -12,6 +12,7 @@
 #include "libqtest-single.h"
 #include "qemu/bswap.h"
 #include "qemu/module.h"
+#include "qapi/qmp/qdict.h"
 #include "standard-headers/linux/virtio_blk.h"
 #include "standard-headers/linux/virtio_pci.h"
 #include "libqos/qgraph.h"
@@ -345,6 +346,28 @@ static void basic(void *obj, void *data, QGuestAllocator *t_alloc)
 
 }
 
+/*
+ * Buffers in guest RAM after the first one are mapped through the RAM range
+ * the device remembers, not address_space_map().
+ */
+static void ram_range(void *obj, void *data, QGuestAllocator *t_alloc)
+{
+    QVirtioBlkPCI *blk = obj;
+    QVirtioDevice *dev = &blk->pci_vdev.vdev;
+    QVirtQueue *vq;
+    QDict *resp;
+
+    vq = test_basic(dev, t_alloc);
+    qvirtqueue_cleanup(dev->bus, vq, t_alloc);
+
+    resp = qmp("{ 'execute': 'qom-get', 'arguments': {"
+               " 'path': '/machine/peripheral/drv0/virtio-backend',"
+               " 'property': 'x-ram-range-hits' } }");
+    g_assert(qdict_haskey(resp, "return"));
+    g_assert_cmpint(qdict_get_int(resp, "return"), >, 0);
+    qobject_unref(resp);
+}
+
 static void indirect(void *obj, void *u_data, QGuestAllocator *t_alloc)
 {
     QVirtQueue *vq;
@@ -802,6 +825,7 @@ static void register_virtio_blk_test(void)
     qos_add_test("nxvirtq", "virtio-blk-pci",
                       test_nonexistent_virtqueue, &opts);
     qos_add_test("hotplug", "virtio-blk-pci", pci_hotplug, &opts);
+    qos_add_test("ram-range", "virtio-blk-pci", ram_range, &opts);
 }
 
 libqos_init(register_virtio_blk_test);
@@ -0,0 +1,181 @@
+/*
+ * TCI vs wasm tier test
+ *
+ * On a wasm32 host a TB first runs on the TCI interpreter and, once it
+ * got hot, as a compiled wasm module. This runs the same kernels with
+ * the same inputs hundreds of times, so that the later runs go through
+ * the compiled TBs, and checks that every run gives what the first one,
+ * done mostly on TCI, gave. The kernels cover ALU ops, shifts by all
+ * counts, flag computations and stores of each width.
+ *
+ * Run it with -accel tcg,wasm-diff=1 to also have QEMU run each compiled
+ * TB on both tiers and report the TCG op where they diverge: then QEMU
+ * must not print any "wasm-diff:" error. On other hosts it is a plain
+ * determinism test.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <minilib.h>
+
+#define ITERATIONS 500
+#define BUF_SIZE 256
+
+/* Inputs the compiler can't fold, with edge values for each width */
+static volatile uint64_t inputs[] = {
+    0, 1, 0x7f, 0x80, 0xff, 0x7fff, 0x8000, 0xffff,
+    0x7fffffff, 0x80000000, 0xffffffff, 0x100000000ULL,
+    0x7fffffffffffffffULL, 0x8000000000000000ULL, 0xffffffffffffffffULL,
+    0x0123456789abcdefULL, 0xfedcba9876543210ULL, 0x5555aaaa5555aaaaULL,
+};
+
+#define NR_INPUTS (sizeof(inputs) / sizeof(inputs[0]))
+
+static uint8_t buf[BUF_SIZE] __attribute__((aligned(8)));
+
+static uint64_t mix(uint64_t h, uint64_t v)
+{
+    h ^= v;
+    h *= 0x100000001b3ULL;
+    return h ^ (h >> 29);
+}
+
+static __attribute__((noinline)) uint64_t alu_kernel(void)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (int i = 0; i < NR_INPUTS; i++) {
+        for (int j = 0; j < NR_INPUTS; j++) {
+            uint64_t a = inputs[i], b = inputs[j];
+            uint32_t a32 = a, b32 = b;
+
+            h = mix(h, a + b);
+            h = mix(h, a - b);
+            h = mix(h, a * b);
+            h = mix(h, (a & b) | (~a ^ b));
+            h = mix(h, (uint32_t)(a32 * b32));
+            h = mix(h, (uint32_t)(a32 - b32));
+            h = mix(h, (int64_t)(int32_t)a32);
+            h = mix(h, (int64_t)(int16_t)a32 + (int64_t)(int8_t)b32);
+            h = mix(h, (uint64_t)a32 * b32);
+            h = mix(h, -a);
+        }
+    }
+    return h;
+}
+
+static __attribute__((noinline)) uint64_t shift_kernel(void)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (int i = 0; i < NR_INPUTS; i++) {
+        uint64_t a = inputs[i];
+        uint32_t a32 = a;
+
+        for (unsigned n = 0; n < 64; n++) {
+            unsigned n32 = n & 31;
+
+            h = mix(h, a << n);
+            h = mix(h, a >> n);
+            h = mix(h, (uint64_t)((int64_t)a >> n));
+            h = mix(h, (a << n) | (a >> ((64 - n) & 63)));
+            h = mix(h, a32 << n32);
+            h = mix(h, a32 >> n32);
+            h = mix(h, (uint32_t)((int32_t)a32 >> n32));
+        }
+    }
+    return h;
+}
+
+static __attribute__((noinline)) uint64_t flag_kernel(void)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (int i = 0; i < NR_INPUTS; i++) {
+        for (int j = 0; j < NR_INPUTS; j++) {
+            uint64_t a = inputs[i], b = inputs[j];
+            uint32_t a32 = a, b32 = b;
+            uint64_t r;
+            uint32_t r32;
+            unsigned f = 0;
+
+            f = (f << 1) | (a < b);
+            f = (f << 1) | ((int64_t)a < (int64_t)b);
+            f = (f << 1) | (a32 <= b32);
+            f = (f << 1) | ((int32_t)a32 >= (int32_t)b32);
+            f = (f << 1) | (a == b);
+            f = (f << 1) | __builtin_add_overflow(a, b, &r);
+            f = (f << 1) | __builtin_sub_overflow((int64_t)a, (int64_t)b,
+                                                  (int64_t *)&r);
+            f = (f << 1) | __builtin_add_overflow(a32, b32, &r32);
+            f = (f << 1) | __builtin_sub_overflow((int32_t)a32, (int32_t)b32,
+                                                  (int32_t *)&r32);
+            h = mix(h, f);
+            h = mix(h, r ^ r32);
+            h = mix(h, a > b ? a : b);
+        }
+    }
+    return h;
+}
+
+static __attribute__((noinline)) uint64_t store_kernel(void)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (int i = 0; i < NR_INPUTS; i++) {
+        uint64_t a = inputs[i];
+
+        for (int off = 0; off < BUF_SIZE; off += 8) {
+            *(uint8_t *)(buf + off) = a >> (off & 7);
+            *(uint16_t *)(buf + off + 2) = a >> 16;
+            *(uint32_t *)(buf + off + 4) = a ^ off;
+        }
+        for (int off = 0; off < BUF_SIZE; off += 16) {
+            *(uint64_t *)(buf + off + 8) = a + off;
+        }
+        for (int off = 0; off < BUF_SIZE; off += 8) {
+            h = mix(h, *(uint64_t *)(buf + off));
+        }
+    }
+    return h;
+}
+
+static const struct {
+    const char *name;
+    uint64_t (*fn)(void);
+} kernels[] = {
+    { "alu", alu_kernel },
+    { "shift", shift_kernel },
+    { "flags", flag_kernel },
+    { "store", store_kernel },
+};
+
+#define NR_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+int main(void)
+{
+    uint64_t expect[NR_KERNELS];
+    bool ok = true;
+
+    for (int k = 0; k < NR_KERNELS; k++) {
+        expect[k] = kernels[k].fn();
+    }
+
+    for (int i = 1; i < ITERATIONS && ok; i++) {
+        for (int k = 0; k < NR_KERNELS; k++) {
+            uint64_t got = kernels[k].fn();
+
+            if (got != expect[k]) {
+                ml_printf("%s, run %d: got %llx, first run %llx\n",
+                          kernels[k].name, i, got, expect[k]);
+                ok = false;
+            }
+        }
+        if (i % 50 == 0) {
+            ml_printf(".");
+        }
+    }
+
+    ml_printf("\nTest complete: %s\n", ok ? "PASSED" : "FAILED");
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,72 @@
+/*
+ * Test that stores to the CPU state that a later store of the same
+ * translation block overwrites are kept where something may observe
+ * them in between: a fault, a helper call or a load from the state.
+ *
+ * The direction flag is one such field, std and cld store it.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#define _GNU_SOURCE
+#include <assert.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <ucontext.h>
+
+#define DF 0x400
+
+uint64_t df_fault(void *bad);
+uint64_t df_helper(void);
+char *df_load(char *p);
+extern char df_fault_resume[];
+
+asm("df_fault:\n"
+    "    std\n"
+    "    movl (%rdi), %eax\n"       /* %rdi is an unmapped address */
+    "df_fault_resume:\n"
+    "    cld\n"
+    "    ret\n"
+    "df_helper:\n"
+    "    std\n"
+    "    pushfq\n"                  /* computes the flags in a helper */
+    "    popq %rax\n"
+    "    cld\n"
+    "    ret\n"
+    "df_load:\n"
+    "    movq %rdi, %rsi\n"
+    "    std\n"
+    "    lodsb\n"                   /* loads the direction from env */
+    "    cld\n"
+    "    movq %rsi, %rax\n"
+    "    ret\n");
+
+static volatile greg_t fault_eflags;
+
+static void sigsegv(int sig, siginfo_t *info, void *puc)
+{
+    ucontext_t *uc = puc;
+
+    fault_eflags = uc->uc_mcontext.gregs[REG_EFL];
+    uc->uc_mcontext.gregs[REG_RIP] = (greg_t)df_fault_resume;
+}
+
+int main(void)
+{
+    struct sigaction act;
+    static char buf[2];
+
+    memset(&act, 0, sizeof(act));
+    act.sa_sigaction = sigsegv;
+    act.sa_flags = SA_SIGINFO;
+    assert(sigaction(SIGSEGV, &act, NULL) == 0);
+
+    df_fault((void *)8);
+    assert(fault_eflags & DF);
+
+    assert(df_helper() & DF);
+
+    assert(df_load(&buf[1]) == &buf[0]);
+
+    return 0;
+}
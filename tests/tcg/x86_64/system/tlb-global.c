@@ -0,0 +1,179 @@
+/*
+ * Test that a CR3 write keeps the global pages in the TLB
+ *
+ * With CR4.PGE set, a CR3 write only drops the translations of pages
+ * without the G bit.  The test maps 4K pages and a 2M page, changes
+ * their page table entries and writes CR3: the non-global page must
+ * then use the new entry, the global ones may keep using the old one
+ * until an INVLPG.  For the 2M page, an INVLPG of any 4K page in it
+ * must flush all of it, so its large page region must have survived
+ * the CR3 write too.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <minilib.h>
+
+#define PG_PRESENT  0x001
+#define PG_RW       0x002
+#define PG_PSE      0x080
+#define PG_GLOBAL   0x100
+#define PG_ADDR     0x000ffffffffff000ULL
+
+#define CR4_PGE     (1 << 7)
+
+/*
+ * In the 1-2 GB range that boot.S maps with 2M pages, away from the
+ * TLB indexes of the kernel pages, which start at 0x100000.
+ */
+#define VA_4K       0x40030000ULL
+#define VA_2M       0x40200000ULL
+#define VA_2M_PAGE  (VA_2M + 0x38000)
+
+/* 2M frames in RAM for VA_2M, after the kernel */
+#define FRAME_2M_OLD 0x200000ULL
+#define FRAME_2M_NEW 0x400000ULL
+
+#define PT_INDEX(va) (((va) >> 12) & 511)
+
+#define ATTEMPTS 3
+
+static uint64_t pt[512] __attribute__((aligned(4096)));
+static uint8_t frames[2][4096] __attribute__((aligned(4096)));
+
+static uint64_t read_cr3(void)
+{
+    uint64_t val;
+
+    asm volatile("mov %%cr3, %0" : "=r" (val));
+    return val;
+}
+
+static void write_cr3(uint64_t val)
+{
+    asm volatile("mov %0, %%cr3" : : "r" (val) : "memory");
+}
+
+static uint64_t read_cr4(void)
+{
+    uint64_t val;
+
+    asm volatile("mov %%cr4, %0" : "=r" (val));
+    return val;
+}
+
+static void write_cr4(uint64_t val)
+{
+    asm volatile("mov %0, %%cr4" : : "r" (val) : "memory");
+}
+
+static void invlpg(uint64_t va)
+{
+    asm volatile("invlpg (%0)" : : "r" (va) : "memory");
+}
+
+static uint8_t peek(uint64_t va)
+{
+    return *(volatile uint8_t *)va;
+}
+
+static void poke(uint64_t pa, uint8_t val)
+{
+    *(volatile uint8_t *)pa = val;
+}
+
+/* The PD entry of @va, boot.S identity maps the page tables */
+static volatile uint64_t *pde(uint64_t va)
+{
+    uint64_t *pml4 = (uint64_t *)(read_cr3() & PG_ADDR);
+    uint64_t *pdp = (uint64_t *)(pml4[(va >> 39) & 511] & PG_ADDR);
+    uint64_t *pd = (uint64_t *)(pdp[(va >> 30) & 511] & PG_ADDR);
+
+    return &pd[(va >> 21) & 511];
+}
+
+static void map(int frame, uint64_t frame_2m)
+{
+    pt[PT_INDEX(VA_4K)] = (uintptr_t)frames[frame] |
+                          PG_PRESENT | PG_RW | PG_GLOBAL;
+    pt[PT_INDEX(VA_4K) + 1] = (uintptr_t)frames[frame] | PG_PRESENT | PG_RW;
+    *pde(VA_2M) = frame_2m | PG_PRESENT | PG_RW | PG_PSE | PG_GLOBAL;
+}
+
+/* Flushes the global pages too */
+static void flush_all(void)
+{
+    uint64_t cr4 = read_cr4();
+
+    write_cr4(cr4 & ~CR4_PGE);
+    write_cr4(cr4);
+}
+
+static int attempt(bool *kept)
+{
+    map(0, FRAME_2M_OLD);
+    flush_all();
+    if (peek(VA_4K) != 1 || peek(VA_4K + 0x1000) != 1 ||
+        peek(VA_2M_PAGE) != 1 || peek(VA_2M_PAGE + 0x1000) != 1) {
+        ml_printf("FAIL: wrong data before the CR3 write\n");
+        return 1;
+    }
+
+    map(1, FRAME_2M_NEW);
+    write_cr3(read_cr3());
+
+    if (peek(VA_4K + 0x1000) != 2) {
+        ml_printf("FAIL: non-global page kept across a CR3 write\n");
+        return 1;
+    }
+    *kept = peek(VA_4K) == 1 && peek(VA_2M_PAGE) == 1 &&
+            peek(VA_2M_PAGE + 0x1000) == 1;
+
+    invlpg(VA_4K);
+    if (peek(VA_4K) != 2) {
+        ml_printf("FAIL: global 4K page kept across INVLPG\n");
+        return 1;
+    }
+    invlpg(VA_2M_PAGE + 0x1000);
+    if (peek(VA_2M_PAGE) != 2) {
+        ml_printf("FAIL: 2M page partly kept across INVLPG\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    bool kept = false;
+
+    ml_printf("TLB global page test\n");
+
+    *pde(VA_4K) = (uintptr_t)pt | PG_PRESENT | PG_RW;
+    frames[0][0] = 1;
+    frames[1][0] = 2;
+    poke(FRAME_2M_OLD + VA_2M_PAGE - VA_2M, 1);
+    poke(FRAME_2M_OLD + VA_2M_PAGE - VA_2M + 0x1000, 1);
+    poke(FRAME_2M_NEW + VA_2M_PAGE - VA_2M, 2);
+    poke(FRAME_2M_NEW + VA_2M_PAGE - VA_2M + 0x1000, 2);
+
+    write_cr4(read_cr4() | CR4_PGE);
+
+    /*
+     * A resize of a softmmu TLB drops all of its entries, and can come
+     * with any flush, so the global pages only need to survive once.
+     */
+    for (int i = 0; i < ATTEMPTS && !kept; i++) {
+        if (attempt(&kept)) {
+            return 1;
+        }
+    }
+    if (!kept) {
+        ml_printf("FAIL: global pages dropped by every CR3 write\n");
+        return 1;
+    }
+
+    ml_printf("PASS\n");
+    return 0;
+}
@@ -17,6 +17,9 @@
 #ifdef CONFIG_TRACE_FTRACE
 #include "trace/ftrace.h"
 #endif
+#ifdef CONFIG_TRACE_SAB
+#include "trace/sab.h"
+#endif
 #ifdef CONFIG_TRACE_LOG
 #include "qemu/log.h"
 #endif
@@ -76,6 +79,9 @@ void trace_event_register_group(TraceEvent **events)
 #ifdef CONFIG_TRACE_SIMPLE
     st_init_group(nevent_groups - 1);
 #endif
+#ifdef CONFIG_TRACE_SAB
+    sab_trace_init_group(nevent_groups - 1);
+#endif
 }
 
 
@@ -271,6 +277,13 @@ bool trace_init_backends(void)
     }
 #endif
 
+#ifdef CONFIG_TRACE_SAB
+    if (!sab_trace_init()) {
+        fprintf(stderr, "failed to initialize sab tracing backend.\n");
+        return false;
+    }
+#endif
+
 #ifdef CONFIG_TRACE_FTRACE
     if (!ftrace_init()) {
         fprintf(stderr, "failed to initialize ftrace backend.\n");
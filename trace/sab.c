@@ -0,0 +1,252 @@
+/*
+ * SharedArrayBuffer ring trace backend
+ *
+ * The other backends write through stdio, which Emscripten proxies to the
+ * browser main thread, so that an enabled tracepoint costs a round trip
+ * to it. This one only copies the record into a ring of the calling
+ * thread in the wasm memory; JavaScript drains the rings whenever it
+ * likes, see examples/x86_64/src/htdocs/sab-trace.js.
+ *
+ * What comes out of the rings is a trace file of the simple backend:
+ * sab_trace_info.meta holds the file header and the event ID mappings,
+ * each ring holds event records, and the result goes to simpletrace.py
+ * as is. The pid of a record is the number of the ring of the thread
+ * that logged it.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/timer.h"
+#include "trace/control.h"
+#include "trace/sab.h"
+
+#include <emscripten.h>
+
+#define HEADER_EVENT_ID     (~(uint64_t)0)
+#define HEADER_MAGIC        0xf2b177cb0aa429b4ULL
+#define HEADER_VERSION      4
+#define DROPPED_EVENT_ID    (~(uint64_t)0 - 1)
+
+#define TRACE_RECORD_TYPE_MAPPING 0
+#define TRACE_RECORD_TYPE_EVENT   1
+
+/* record type and TraceRecord of the simple backend */
+#define RECORD_HDR_LEN  (8 + 8 + 8 + 4 + 4)
+#define DROPPED_LEN     (RECORD_HDR_LEN + 8)
+
+#define SAB_TRACE_RING_SIZE (256 * KiB)
+
+/*
+ * Shared with JavaScript, which reads the fields with Atomics. head and
+ * tail are free-running byte counters: only the thread of the ring moves
+ * head, only the consumer moves tail.
+ */
+struct SabTraceRing {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t size;
+    SabTraceRing *next;
+    uint32_t pid;
+    uint32_t dropped;       /* not reported in a record yet */
+    uint32_t reserved[2];
+    uint8_t data[];
+};
+
+typedef struct SabTraceInfo {
+    uint8_t *meta;
+    uint32_t meta_len;
+    SabTraceRing *rings;
+} SabTraceInfo;
+
+static SabTraceInfo sab_trace_info;
+static GMutex sab_trace_meta_lock;
+static uint32_t sab_trace_meta_size;
+static uint32_t sab_trace_nr_rings;
+static bool sab_trace_enabled;
+static __thread SabTraceRing *sab_trace_ring;
+
+/*
+ * Appends to the meta bytes. A buffer that is outgrown is left in place,
+ * as the consumer may be reading it: it covers the meta_len that was
+ * current when it was replaced.
+ */
+static void sab_trace_meta_append(const void *data, uint32_t len)
+{
+    uint32_t used = sab_trace_info.meta_len;
+
+    if (used + len > sab_trace_meta_size) {
+        uint32_t size = MAX(sab_trace_meta_size * 2, used + len);
+        uint8_t *meta = malloc(size); /* don't use g_malloc when traced */
+
+        if (!meta) {
+            return;
+        }
+        if (used) {
+            memcpy(meta, sab_trace_info.meta, used);
+        }
+        qatomic_store_release(&sab_trace_info.meta, meta);
+        sab_trace_meta_size = size;
+    }
+    memcpy(sab_trace_info.meta + used, data, len);
+    qatomic_store_release(&sab_trace_info.meta_len, used + len);
+}
+
+static void sab_trace_write_mapping(TraceEventIter *iter)
+{
+    TraceEvent *ev;
+
+    g_mutex_lock(&sab_trace_meta_lock);
+    while ((ev = trace_event_iter_next(iter)) != NULL) {
+        uint64_t type = TRACE_RECORD_TYPE_MAPPING;
+        uint64_t id = trace_event_get_id(ev);
+        const char *name = trace_event_get_name(ev);
+        uint32_t len = strlen(name);
+
+        sab_trace_meta_append(&type, sizeof(type));
+        sab_trace_meta_append(&id, sizeof(id));
+        sab_trace_meta_append(&len, sizeof(len));
+        sab_trace_meta_append(name, len);
+    }
+    g_mutex_unlock(&sab_trace_meta_lock);
+}
+
+static SabTraceRing *sab_trace_ring_new(void)
+{
+    SabTraceRing *ring, *old;
+
+    ring = calloc(1, sizeof(*ring) + SAB_TRACE_RING_SIZE);
+    if (!ring) {
+        return NULL;
+    }
+    ring->size = SAB_TRACE_RING_SIZE;
+    ring->pid = qatomic_fetch_inc(&sab_trace_nr_rings) + 1;
+
+    old = qatomic_read(&sab_trace_info.rings);
+    do {
+        ring->next = old;
+    } while ((old = qatomic_cmpxchg(&sab_trace_info.rings, old, ring)) !=
+             ring->next);
+
+    sab_trace_ring = ring;
+    return ring;
+}
+
+static uint32_t sab_trace_put(SabTraceRing *ring, uint32_t off,
+                              const void *data, uint32_t len)
+{
+    uint32_t pos = off & (ring->size - 1);
+    uint32_t first = MIN(len, ring->size - pos);
+
+    memcpy(ring->data + pos, data, first);
+    memcpy(ring->data, (const uint8_t *)data + first, len - first);
+    return off + len;
+}
+
+static uint32_t sab_trace_put_header(SabTraceRing *ring, uint32_t off,
+                                     uint64_t event, uint32_t len)
+{
+    uint64_t type = TRACE_RECORD_TYPE_EVENT;
+    uint64_t timestamp_ns = get_clock();
+
+    off = sab_trace_put(ring, off, &type, sizeof(type));
+    off = sab_trace_put(ring, off, &event, sizeof(event));
+    off = sab_trace_put(ring, off, &timestamp_ns, sizeof(timestamp_ns));
+    off = sab_trace_put(ring, off, &len, sizeof(len));
+    return sab_trace_put(ring, off, &ring->pid, sizeof(ring->pid));
+}
+
+bool sab_trace_record_start(SabTraceRecord *rec, uint32_t id, size_t arglen)
+{
+    SabTraceRing *ring = sab_trace_ring;
+    uint32_t head, space, need;
+
+    if (!ring) {
+        ring = sab_trace_ring_new();
+        if (!ring) {
+            return false;
+        }
+    }
+
+    head = ring->head;
+    space = ring->size - (head - qatomic_load_acquire(&ring->tail));
+    need = RECORD_HDR_LEN + arglen + (ring->dropped ? DROPPED_LEN : 0);
+    if (need > space) {
+        ring->dropped++;
+        return false;
+    }
+
+    if (ring->dropped) {
+        uint64_t count = ring->dropped;
+
+        head = sab_trace_put_header(ring, head, DROPPED_EVENT_ID,
+                                    DROPPED_LEN - 8);
+        head = sab_trace_put(ring, head, &count, sizeof(count));
+        ring->dropped = 0;
+    }
+
+    rec->ring = ring;
+    rec->off = sab_trace_put_header(ring, head, id,
+                                    RECORD_HDR_LEN - 8 + arglen);
+    return true;
+}
+
+void sab_trace_record_write_u64(SabTraceRecord *rec, uint64_t val)
+{
+    rec->off = sab_trace_put(rec->ring, rec->off, &val, sizeof(val));
+}
+
+void sab_trace_record_write_str(SabTraceRecord *rec, const char *s,
+                                uint32_t slen)
+{
+    rec->off = sab_trace_put(rec->ring, rec->off, &slen, sizeof(slen));
+    rec->off = sab_trace_put(rec->ring, rec->off, s, slen);
+}
+
+void sab_trace_record_finish(SabTraceRecord *rec)
+{
+    qatomic_store_release(&rec->ring->head, rec->off);
+}
+
+/*
+ * Address of sab_trace_info, for the consumer: the meta bytes come first
+ * in the trace file, then the records it drains from each ring.
+ */
+EMSCRIPTEN_KEEPALIVE uintptr_t sab_trace_lookup(void)
+{
+    return (uintptr_t)&sab_trace_info;
+}
+
+bool sab_trace_init(void)
+{
+    static const uint64_t header[] = {
+        HEADER_EVENT_ID, HEADER_MAGIC, HEADER_VERSION,
+    };
+    TraceEventIter iter;
+
+    g_mutex_lock(&sab_trace_meta_lock);
+    sab_trace_meta_append(header, sizeof(header));
+    g_mutex_unlock(&sab_trace_meta_lock);
+    if (!sab_trace_info.meta_len) {
+        return false;
+    }
+
+    trace_event_iter_init_all(&iter);
+    sab_trace_write_mapping(&iter);
+    sab_trace_enabled = true;
+    return true;
+}
+
+void sab_trace_init_group(size_t group)
+{
+    TraceEventIter iter;
+
+    if (!sab_trace_enabled) {
+        return;
+    }
+
+    trace_event_iter_init_group(&iter, group);
+    sab_trace_write_mapping(&iter);
+}
@@ -0,0 +1,50 @@
+/*
+ * SharedArrayBuffer ring trace backend
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef TRACE_SAB_H
+#define TRACE_SAB_H
+
+typedef struct SabTraceRing SabTraceRing;
+
+typedef struct {
+    SabTraceRing *ring;
+    uint32_t off;
+} SabTraceRecord;
+
+#define SAB_TRACE_MAX_STRLEN 512
+
+bool sab_trace_init(void);
+void sab_trace_init_group(size_t group);
+
+/**
+ * Claim space for a record in the ring of the calling thread
+ *
+ * @arglen  number of bytes required for arguments
+ *
+ * Returns false if the ring is full and the event was dropped.
+ */
+bool sab_trace_record_start(SabTraceRecord *rec, uint32_t id, size_t arglen);
+
+/**
+ * Append a 64-bit argument to a trace record
+ */
+void sab_trace_record_write_u64(SabTraceRecord *rec, uint64_t val);
+
+/**
+ * Append a string argument to a trace record
+ */
+void sab_trace_record_write_str(SabTraceRecord *rec, const char *s,
+                                uint32_t slen);
+
+/**
+ * Publish a trace record to the consumer
+ *
+ * Don't append any more arguments to the trace record after calling this.
+ */
+void sab_trace_record_finish(SabTraceRecord *rec);
+
+#endif /* TRACE_SAB_H */
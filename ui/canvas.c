@@ -0,0 +1,372 @@
+/*
+ * Display on a canvas of the page
+ *
+ * The pixels of the guest's display surface already live in the
+ * SharedArrayBuffer of the wasm memory, so the page reads them from there:
+ * on every refresh this frontend publishes the surface and the rectangle
+ * that changed since the page last looked, and the page uploads just that
+ * rectangle to a WebGL texture (or a 2D canvas) on its next animation
+ * frame. Nothing is encoded or copied on the QEMU side.
+ *
+ * Keyboard and mouse events come back through a ring in shared memory as
+ * well, which the main loop drains in batches: motion between two button
+ * or key events is merged into a single move before it reaches the guest.
+ *
+ *   -display canvas
+ *
+ * The page finds the published state with canvas_display_info();
+ * canvas-display.js in the x86_64 example draws it.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include <emscripten.h>
+#include <emscripten/threading.h>
+#include <math.h>
+
+#include "qemu/atomic.h"
+#include "qemu/error-report.h"
+#include "qemu/main-loop.h"
+#include "qemu/module.h"
+#include "qemu/thread.h"
+#include "ui/console.h"
+#include "ui/input.h"
+
+/*
+ * Refreshes back off while the guest doesn't draw and return to the
+ * default rate with the next update.
+ */
+#define CANVAS_REFRESH_INTERVAL_BASE GUI_REFRESH_INTERVAL_DEFAULT
+#define CANVAS_REFRESH_INTERVAL_INC  50
+#define CANVAS_REFRESH_INTERVAL_MAX  500
+
+/*
+ * What the page reads. QEMU fills in the fields and sets update, the page
+ * copies the rectangle and clears update; until then QEMU collects further
+ * changes on its side.
+ */
+typedef struct CanvasShared {
+    uint32_t update;
+    uint32_t generation;    /* bumped when the surface is replaced */
+    uint32_t data;          /* address of the pixels */
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;        /* in bytes */
+    uint32_t x0, y0, x1, y1;    /* changed rectangle, x1/y1 exclusive */
+    uint32_t bpp;           /* 32 for x8r8g8b8, 16 for r5g6b5 */
+    uint32_t input;         /* address of the CanvasInputRing */
+    uint32_t absolute;      /* whether the guest takes absolute positions */
+} CanvasShared;
+
+enum {
+    CANVAS_INPUT_KEY = 1,   /* code: Linux key code, x: pressed */
+    CANVAS_INPUT_BTN,       /* code: InputButton, x: pressed */
+    CANVAS_INPUT_ABS,       /* x, y: position in surface pixels */
+    CANVAS_INPUT_REL,       /* x, y: movement, with the pointer locked */
+};
+
+typedef struct CanvasInputEvent {
+    uint32_t type;
+    uint32_t code;
+    int32_t x;
+    int32_t y;
+} CanvasInputEvent;
+
+#define CANVAS_INPUT_EVENTS 256
+
+/*
+ * Written by the page, which drops events while it is full. head and tail
+ * are free-running event counters.
+ */
+typedef struct CanvasInputRing {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t size;
+    uint32_t dropped;
+    CanvasInputEvent ev[CANVAS_INPUT_EVENTS];
+} CanvasInputRing;
+
+typedef struct CanvasDisplay {
+    DisplayChangeListener dcl;
+    DisplaySurface *ds;
+    uint32_t generation;
+    bool dirty;
+    int x0, y0, x1, y1;
+
+    Notifier mouse_mode_notifier;
+    QEMUBH *input_bh;
+    QemuThread input_thread;
+    uint32_t input_seen;
+    bool abs_pending;
+    int abs_x, abs_y;       /* last position from the page */
+    int rel_x, rel_y;       /* where the guest was told the pointer is */
+    int dx, dy;
+} CanvasDisplay;
+
+static CanvasShared canvas_shared;
+static CanvasInputRing canvas_input = {
+    .size = CANVAS_INPUT_EVENTS,
+};
+
+EMSCRIPTEN_KEEPALIVE uintptr_t canvas_display_info(void)
+{
+    return (uintptr_t)&canvas_shared;
+}
+
+static void canvas_add_dirty(CanvasDisplay *c, int x, int y, int w, int h)
+{
+    if (!c->dirty) {
+        c->x0 = x;
+        c->y0 = y;
+        c->x1 = x + w;
+        c->y1 = y + h;
+        c->dirty = true;
+        return;
+    }
+    c->x0 = MIN(c->x0, x);
+    c->y0 = MIN(c->y0, y);
+    c->x1 = MAX(c->x1, x + w);
+    c->y1 = MAX(c->y1, y + h);
+}
+
+static void canvas_gfx_update(DisplayChangeListener *dcl,
+                              int x, int y, int w, int h)
+{
+    CanvasDisplay *c = container_of(dcl, CanvasDisplay, dcl);
+
+    canvas_add_dirty(c, x, y, w, h);
+    if (dcl->update_interval > CANVAS_REFRESH_INTERVAL_BASE) {
+        update_displaychangelistener(dcl, CANVAS_REFRESH_INTERVAL_BASE);
+    }
+}
+
+static void canvas_gfx_switch(DisplayChangeListener *dcl,
+                              DisplaySurface *new_surface)
+{
+    CanvasDisplay *c = container_of(dcl, CanvasDisplay, dcl);
+
+    c->ds = new_surface;
+    c->generation++;
+    c->dirty = false;
+    if (new_surface) {
+        canvas_add_dirty(c, 0, 0, surface_width(new_surface),
+                         surface_height(new_surface));
+    }
+}
+
+static void canvas_refresh(DisplayChangeListener *dcl)
+{
+    CanvasDisplay *c = container_of(dcl, CanvasDisplay, dcl);
+    CanvasShared *sh = &canvas_shared;
+
+    graphic_hw_update(dcl->con);
+
+    if (!c->ds || !c->dirty) {
+        dcl->update_interval = MIN(dcl->update_interval +
+                                   CANVAS_REFRESH_INTERVAL_INC,
+                                   CANVAS_REFRESH_INTERVAL_MAX);
+        return;
+    }
+    dcl->update_interval = CANVAS_REFRESH_INTERVAL_BASE;
+    if (qatomic_load_acquire(&sh->update)) {
+        return;
+    }
+    sh->generation = c->generation;
+    sh->data = (uintptr_t)surface_data(c->ds);
+    sh->width = surface_width(c->ds);
+    sh->height = surface_height(c->ds);
+    sh->stride = surface_stride(c->ds);
+    sh->bpp = surface_bits_per_pixel(c->ds);
+    sh->x0 = MAX(c->x0, 0);
+    sh->y0 = MAX(c->y0, 0);
+    sh->x1 = MIN(c->x1, sh->width);
+    sh->y1 = MIN(c->y1, sh->height);
+    c->dirty = false;
+    qatomic_store_release(&sh->update, 1);
+}
+
+static bool canvas_check_format(DisplayChangeListener *dcl,
+                                pixman_format_code_t format)
+{
+    /*
+     * The page takes these as they are, so that devices such as stdvga
+     * share their framebuffer in these modes instead of converting it.
+     * Others get converted.
+     */
+    return format == PIXMAN_x8r8g8b8 || format == PIXMAN_a8r8g8b8 ||
+           format == PIXMAN_r5g6b5;
+}
+
+static const DisplayChangeListenerOps canvas_ops = {
+    .dpy_name             = "canvas",
+    .dpy_gfx_update       = canvas_gfx_update,
+    .dpy_gfx_switch       = canvas_gfx_switch,
+    .dpy_gfx_check_format = canvas_check_format,
+    .dpy_refresh          = canvas_refresh,
+};
+
+static void canvas_display_init(DisplayState *ds, DisplayOptions *opts)
+{
+    QemuConsole *con;
+    CanvasDisplay *c;
+    int idx;
+
+    /* one canvas, for the first graphic console */
+    for (idx = 0;; idx++) {
+        con = qemu_console_lookup_by_index(idx);
+        if (!con || qemu_console_is_graphic(con)) {
+            break;
+        }
+    }
+    if (!con) {
+        error_report("canvas: no graphic console");
+        return;
+    }
+    c = g_new0(CanvasDisplay, 1);
+    c->dcl.con = con;
+    c->dcl.ops = &canvas_ops;
+    c->dcl.update_interval = CANVAS_REFRESH_INTERVAL_BASE;
+    register_displaychangelistener(&c->dcl);
+
+    canvas_shared.input = (uintptr_t)&canvas_input;
+    c->mouse_mode_notifier.notify = canvas_mouse_mode_change;
+    qemu_add_mouse_mode_change_notifier(&c->mouse_mode_notifier);
+    canvas_mouse_mode_change(&c->mouse_mode_notifier, NULL);
+    c->input_bh = qemu_bh_new(canvas_input_bh, c);
+    qemu_thread_create(&c->input_thread, "canvas-input", canvas_input_thread,
+                       c, QEMU_THREAD_DETACHED);
+}
+
+static void canvas_mouse_mode_change(Notifier *notify, void *data)
+{
+    CanvasDisplay *c = container_of(notify, CanvasDisplay,
+                                    mouse_mode_notifier);
+
+    qatomic_set(&canvas_shared.absolute, qemu_input_is_absolute(c->dcl.con));
+}
+
+/* Sends the motion collected since the last button or key event */
+static void canvas_input_flush_motion(CanvasDisplay *c)
+{
+    QemuConsole *con = c->dcl.con;
+
+    if (c->abs_pending && c->ds) {
+        if (qemu_input_is_absolute(con)) {
+            qemu_input_queue_abs(con, INPUT_AXIS_X, c->abs_x,
+                                 0, surface_width(c->ds));
+            qemu_input_queue_abs(con, INPUT_AXIS_Y, c->abs_y,
+                                 0, surface_height(c->ds));
+        } else {
+            /* relative mouse without pointer lock, follow the page */
+            c->dx += c->abs_x - c->rel_x;
+            c->dy += c->abs_y - c->rel_y;
+        }
+        c->rel_x = c->abs_x;
+        c->rel_y = c->abs_y;
+    }
+    c->abs_pending = false;
+
+    if (c->dx || c->dy) {
+        qemu_input_queue_rel(con, INPUT_AXIS_X, c->dx);
+        qemu_input_queue_rel(con, INPUT_AXIS_Y, c->dy);
+        c->dx = c->dy = 0;
+    }
+}
+
+static void canvas_input_event(CanvasDisplay *c, CanvasInputEvent *ev)
+{
+    QemuConsole *con = c->dcl.con;
+    int qcode;
+
+    switch (ev->type) {
+    case CANVAS_INPUT_ABS:
+        c->abs_x = ev->x;
+        c->abs_y = ev->y;
+        c->abs_pending = true;
+        break;
+    case CANVAS_INPUT_REL:
+        c->dx += ev->x;
+        c->dy += ev->y;
+        break;
+    case CANVAS_INPUT_BTN:
+        if (ev->code >= INPUT_BUTTON__MAX) {
+            break;
+        }
+        canvas_input_flush_motion(c);
+        qemu_input_queue_btn(con, ev->code, ev->x);
+        qemu_input_event_sync();
+        break;
+    case CANVAS_INPUT_KEY:
+        qcode = qemu_input_linux_to_qcode(ev->code);
+        if (!qcode) {
+            break;
+        }
+        canvas_input_flush_motion(c);
+        qemu_input_event_sync();
+        qemu_input_event_send_key_qcode(con, qcode, ev->x);
+        break;
+    }
+}
+
+static void canvas_input_bh(void *opaque)
+{
+    CanvasDisplay *c = opaque;
+    CanvasInputRing *r = &canvas_input;
+    uint32_t tail = r->tail;
+
+    for (;;) {
+        uint32_t head = qatomic_load_acquire(&r->head);
+
+        if (head == tail) {
+            /* pairs with the page's check before it notifies */
+            smp_mb();
+            if (qatomic_read(&r->head) == tail) {
+                break;
+            }
+            continue;
+        }
+        for (; tail != head; tail++) {
+            canvas_input_event(c, &r->ev[tail % CANVAS_INPUT_EVENTS]);
+        }
+        qatomic_store_release(&r->tail, tail);
+    }
+    canvas_input_flush_motion(c);
+    qemu_input_event_sync();
+}
+
+/*
+ * Sleeps until the page makes the input ring non-empty, then leaves the
+ * events to canvas_input_bh() in the main loop.
+ */
+static void *canvas_input_thread(void *opaque)
+{
+    CanvasDisplay *c = opaque;
+    CanvasInputRing *r = &canvas_input;
+
+    for (;;) {
+        uint32_t head = qatomic_load_acquire(&r->head);
+
+        if (head == c->input_seen) {
+            emscripten_futex_wait(&r->head, head, INFINITY);
+            continue;
+        }
+        c->input_seen = head;
+        qemu_bh_schedule(c->input_bh);
+    }
+    return NULL;
+}
+
+static QemuDisplay qemu_display_canvas = {
+    .type       = DISPLAY_TYPE_CANVAS,
+    .init       = canvas_display_init,
+};
+
+static void register_canvas(void)
+{
+    qemu_display_register(&qemu_display_canvas);
+}
+
+type_init(register_canvas);
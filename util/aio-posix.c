@@ -742,6 +742,7 @@ void aio_context_setup(AioContext *ctx)
     }
 
     fdmon_epoll_setup(ctx);
+    fdmon_wasm_setup(ctx);
 }
 
 void aio_context_destroy(AioContext *ctx)
@@ -65,6 +65,14 @@ static inline void fdmon_epoll_disable(AioContext *ctx)
 }
 #endif /* !CONFIG_EPOLL_CREATE1 */
 
+#ifdef EMSCRIPTEN
+void fdmon_wasm_setup(AioContext *ctx);
+#else
+static inline void fdmon_wasm_setup(AioContext *ctx)
+{
+}
+#endif /* !EMSCRIPTEN */
+
 #ifdef CONFIG_LINUX_IO_URING
 bool fdmon_io_uring_setup(AioContext *ctx);
 void fdmon_io_uring_destroy(AioContext *ctx);
@@ -264,6 +264,61 @@ static bool select_accel_fn(const void *buf, size_t len)
     return buffer_zero_int(buf, len);
 }
 
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+
+/* Like the x86 variants, this requires len >= 64.  */
+static bool buffer_zero_simd128(const void *buf, size_t len)
+{
+    v128_t t = wasm_v128_load(buf);
+    const v128_t *p = (v128_t *)(((uintptr_t)buf + 5 * 16) & -16);
+    const v128_t *e = (v128_t *)(((uintptr_t)buf + len) & -16);
+
+    /* Loop over 16-byte aligned blocks of 64.  */
+    while (likely(p <= e)) {
+        if (unlikely(wasm_v128_any_true(t))) {
+            return false;
+        }
+        t = wasm_v128_or(wasm_v128_or(p[-4], p[-3]),
+                         wasm_v128_or(p[-2], p[-1]));
+        p += 4;
+    }
+
+    /* Finish the aligned tail.  */
+    t = wasm_v128_or(t, e[-3]);
+    t = wasm_v128_or(t, e[-2]);
+    t = wasm_v128_or(t, e[-1]);
+
+    /* Finish the unaligned tail.  */
+    t = wasm_v128_or(t, wasm_v128_load(buf + len - 16));
+
+    return !wasm_v128_any_true(t);
+}
+
+/*
+ * A module built with -msimd128 doesn't load without SIMD128 support, so
+ * there is nothing to detect at run time.  Only the integer version is
+ * left to test after the vector one.
+ */
+static bool (*buffer_accel)(const void *, size_t) = buffer_zero_simd128;
+
+bool test_buffer_is_zero_next_accel(void)
+{
+    if (buffer_accel == buffer_zero_int) {
+        return false;
+    }
+    buffer_accel = buffer_zero_int;
+    return true;
+}
+
+static bool select_accel_fn(const void *buf, size_t len)
+{
+    if (likely(len >= 64)) {
+        return buffer_accel(buf, len);
+    }
+    return buffer_zero_int(buf, len);
+}
+
 #else
 #define select_accel_fn  buffer_zero_int
 bool test_buffer_is_zero_next_accel(void)
@@ -43,7 +43,6 @@ typedef struct {
  */
 QEMU_DEFINE_STATIC_CO_TLS(Coroutine *, current);
 QEMU_DEFINE_STATIC_CO_TLS(CoroutineEmscripten *, leader);
-size_t leader_asyncify_stack_size = COROUTINE_STACK_SIZE;
 
 static void coroutine_trampoline(void *co_)
 {
@@ -62,10 +61,10 @@ Coroutine *qemu_coroutine_new(void)
     co = g_malloc0(sizeof(*co));
 
     co->stack_size = COROUTINE_STACK_SIZE;
-    co->stack = qemu_alloc_stack(&co->stack_size);
+    co->stack = qemu_coroutine_stack_alloc();
 
     co->asyncify_stack_size = COROUTINE_STACK_SIZE;
-    co->asyncify_stack = g_malloc0(co->asyncify_stack_size);
+    co->asyncify_stack = qemu_coroutine_stack_alloc();
     emscripten_fiber_init(&co->fiber, coroutine_trampoline, &co->base,
                           co->stack, co->stack_size, co->asyncify_stack, co->asyncify_stack_size);
     
@@ -76,8 +75,8 @@ void qemu_coroutine_delete(Coroutine *co_)
 {
     CoroutineEmscripten *co = DO_UPCAST(CoroutineEmscripten, base, co_);
 
-    qemu_free_stack(co->stack, co->stack_size);
-    g_free(co->asyncify_stack);
+    qemu_coroutine_stack_free(co->stack);
+    qemu_coroutine_stack_free(co->asyncify_stack);
     g_free(co);
 }
 
@@ -89,7 +88,7 @@ CoroutineAction qemu_coroutine_switch(Coroutine *from_, Coroutine *to_,
     CoroutineEmscripten *from = DO_UPCAST(CoroutineEmscripten, base, from_);
     CoroutineEmscripten *to = DO_UPCAST(CoroutineEmscripten, base, to_);
 
-#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER)
+#if defined(EMSCRIPTEN) && !defined(CONFIG_TCG_INTERPRETER) && WASM32_ASYNCIFY
     set_unwinding_flag();
 #endif
     
@@ -107,8 +106,8 @@ Coroutine *qemu_coroutine_self(void)
         CoroutineEmscripten *leaderp = get_leader();
         if (!leaderp) {
             leaderp = g_malloc0(sizeof(*leaderp));
-            leaderp->asyncify_stack = g_malloc0(leader_asyncify_stack_size);
-            leaderp->asyncify_stack_size = leader_asyncify_stack_size;
+            leaderp->asyncify_stack = qemu_coroutine_stack_alloc();
+            leaderp->asyncify_stack_size = COROUTINE_STACK_SIZE;
             emscripten_fiber_init_from_current_context(&leaderp->fiber, leaderp->asyncify_stack, leaderp->asyncify_stack_size);
             leaderp->stack = leaderp->fiber.stack_limit;
             leaderp->stack_size = leaderp->fiber.stack_base - leaderp->fiber.stack_limit;
@@ -0,0 +1,148 @@
+/*
+ * emscripten JSPI coroutine initialization code
+ * based on coroutine-fiber.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Each coroutine runs on a wasm stack of its own, started by calling the
+ * trampoline through WebAssembly.promising. Switching away suspends the
+ * current wasm stack in coroutine_jspi_swap and resumes the target one by
+ * resolving the promise it is suspended on, so nothing is unwound and no
+ * asyncify instrumentation is needed. The C stack pointer is switched
+ * along with the wasm stack. Requires a build with -sJSPI.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/coroutine_int.h"
+#include "qemu/coroutine-tls.h"
+
+#include <emscripten.h>
+#include <emscripten/stack.h>
+
+typedef struct {
+    Coroutine base;
+    void *stack;
+    size_t stack_size;
+
+    CoroutineAction action;
+} CoroutineJSPI;
+
+/**
+ * Per-thread coroutine bookkeeping
+ */
+QEMU_DEFINE_STATIC_CO_TLS(Coroutine *, current);
+QEMU_DEFINE_STATIC_CO_TLS(CoroutineJSPI *, leader);
+
+/*
+ * Suspends the wasm stack of from and switches to to, starting it with
+ * entry on its C stack at sp if it has never run. Returns once from is
+ * switched to again.
+ */
+EM_ASYNC_JS(void, coroutine_jspi_swap, (void *from, void *to, void *sp, void *entry), {
+        const suspended = Module.__coroutine_jspi ??= new Map();
+        const from_sp = stackSave();
+        const resumed = new Promise((resolve) => suspended.set(from, resolve));
+        const resume = suspended.get(to);
+        if (resume) {
+            suspended.delete(to);
+            resume();
+        } else {
+            // runs on a new wasm stack until the coroutine first switches away
+            stackRestore(sp);
+            WebAssembly.promising(wasmTable.get(entry))(to);
+        }
+        await resumed;
+        stackRestore(from_sp);
+});
+
+/* Drops the suspended wasm stack of a deleted coroutine */
+EM_JS(void, coroutine_jspi_forget, (void *co), {
+        Module.__coroutine_jspi?.delete(co);
+});
+
+static void coroutine_jspi_set_limits(CoroutineJSPI *co)
+{
+    emscripten_stack_set_limits((uint8_t *)co->stack + co->stack_size, co->stack);
+}
+
+static void coroutine_trampoline(Coroutine *co)
+{
+    coroutine_jspi_set_limits(DO_UPCAST(CoroutineJSPI, base, co));
+    while (true) {
+        co->entry(co->entry_arg);
+        qemu_coroutine_switch(co, co->caller, COROUTINE_TERMINATE);
+    }
+}
+
+Coroutine *qemu_coroutine_new(void)
+{
+    CoroutineJSPI *co;
+
+    co = g_malloc0(sizeof(*co));
+
+    co->stack_size = COROUTINE_STACK_SIZE;
+    co->stack = qemu_coroutine_stack_alloc();
+
+    return &co->base;
+}
+
+void qemu_coroutine_delete(Coroutine *co_)
+{
+    CoroutineJSPI *co = DO_UPCAST(CoroutineJSPI, base, co_);
+
+    coroutine_jspi_forget(co_);
+    qemu_coroutine_stack_free(co->stack);
+    g_free(co);
+}
+
+CoroutineAction qemu_coroutine_switch(Coroutine *from_, Coroutine *to_,
+                      CoroutineAction action)
+{
+    CoroutineJSPI *from = DO_UPCAST(CoroutineJSPI, base, from_);
+    CoroutineJSPI *to = DO_UPCAST(CoroutineJSPI, base, to_);
+    uint8_t *sp = (uint8_t *)to->stack + to->stack_size;
+
+    set_current(to_);
+    to->action = action;
+    coroutine_jspi_swap(from_, to_, sp, (void *)coroutine_trampoline);
+    coroutine_jspi_set_limits(from);
+    return from->action;
+}
+
+Coroutine *qemu_coroutine_self(void)
+{
+    Coroutine *self = get_current();
+
+    if (!self) {
+        CoroutineJSPI *leaderp = get_leader();
+        if (!leaderp) {
+            leaderp = g_malloc0(sizeof(*leaderp));
+            leaderp->stack = (void *)emscripten_stack_get_end();
+            leaderp->stack_size = emscripten_stack_get_base() - emscripten_stack_get_end();
+            set_leader(leaderp);
+        }
+        self = &leaderp->base;
+        set_current(self);
+    }
+    return self;
+}
+
+bool qemu_in_coroutine(void)
+{
+    Coroutine *self = get_current();
+
+    return self && self->caller;
+}
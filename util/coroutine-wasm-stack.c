@@ -0,0 +1,91 @@
+/*
+ * Stack buffers for the emscripten coroutine backends
+ *
+ * This work is licensed under the terms of the GNU LGPL, version 2 or later.
+ * See the COPYING.LIB file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/queue.h"
+#include "qemu/units.h"
+#include "qemu/coroutine_int.h"
+
+/*
+ * Buffers are carved out of an arena allocated at startup, sized for the
+ * coroutines the block layer and 9p keep alive, and only allocated one by
+ * one once it runs out. Freed buffers go to a global list and are moved in
+ * bulk to the list of the thread allocating next, like the release pool of
+ * qemu-coroutine.c. They are never returned to malloc.
+ */
+#define COROUTINE_STACK_ARENA_NUM 32
+
+typedef struct CoroutineStackBuf {
+    QSLIST_ENTRY(CoroutineStackBuf) next;
+} CoroutineStackBuf;
+
+static QSLIST_HEAD(, CoroutineStackBuf) release_stacks;
+static __thread QSLIST_HEAD(, CoroutineStackBuf) alloc_stacks;
+
+static unsigned int stacks_allocated;
+static unsigned int stacks_in_use;
+static unsigned int stacks_high_water;
+
+static void __attribute__((constructor)) coroutine_stack_arena_init(void)
+{
+    uint8_t *arena = g_malloc(COROUTINE_STACK_ARENA_NUM * COROUTINE_STACK_SIZE);
+
+    for (int i = 0; i < COROUTINE_STACK_ARENA_NUM; i++) {
+        CoroutineStackBuf *buf = (void *)(arena + i * COROUTINE_STACK_SIZE);
+        QSLIST_INSERT_HEAD(&release_stacks, buf, next);
+    }
+    stacks_allocated = COROUTINE_STACK_ARENA_NUM;
+}
+
+void *qemu_coroutine_stack_alloc(void)
+{
+    CoroutineStackBuf *buf = QSLIST_FIRST(&alloc_stacks);
+    unsigned int in_use = qatomic_fetch_inc(&stacks_in_use) + 1;
+    unsigned int high_water = qatomic_read(&stacks_high_water);
+
+    while (in_use > high_water) {
+        unsigned int old = qatomic_cmpxchg(&stacks_high_water, high_water, in_use);
+        if (old == high_water) {
+            break;
+        }
+        high_water = old;
+    }
+
+    if (!buf) {
+        QSLIST_MOVE_ATOMIC(&alloc_stacks, &release_stacks);
+        buf = QSLIST_FIRST(&alloc_stacks);
+    }
+    if (!buf) {
+        qatomic_inc(&stacks_allocated);
+        return g_malloc(COROUTINE_STACK_SIZE);
+    }
+    QSLIST_REMOVE_HEAD(&alloc_stacks, next);
+    return buf;
+}
+
+void qemu_coroutine_stack_free(void *stack)
+{
+    CoroutineStackBuf *buf = stack;
+
+    qatomic_dec(&stacks_in_use);
+    QSLIST_INSERT_HEAD_ATOMIC(&release_stacks, buf, next);
+}
+
+void qemu_coroutine_stack_dump_info(GString *buf)
+{
+    g_string_append_printf(buf, "\ncoroutine stacks:\n");
+    g_string_append_printf(buf, "stacks in use       %u\n",
+                           qatomic_read(&stacks_in_use));
+    g_string_append_printf(buf, "stacks high water   %u\n",
+                           qatomic_read(&stacks_high_water));
+    g_string_append_printf(buf, "stacks allocated    %u, %u in the arena\n",
+                           qatomic_read(&stacks_allocated),
+                           COROUTINE_STACK_ARENA_NUM);
+    g_string_append_printf(buf, "stack size          %d KiB\n",
+                           COROUTINE_STACK_SIZE / KiB);
+}
@@ -26,6 +26,7 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/bswap.h"
 #include "qemu/crc32c.h"
 
 /*
@@ -105,8 +106,43 @@ static const uint32_t crc32c_table[256] = {
 };
 
 
+/*
+ * crc32c_table_8[k][n] is crc32c_table[n] advanced over k + 1 more zero
+ * bytes, which lets crc32c() fold 8 bytes at a time ("slicing-by-8")
+ */
+static uint32_t crc32c_table_8[7][256];
+
+static void __attribute__((constructor)) crc32c_init_tables(void)
+{
+    int k, n;
+
+    for (n = 0; n < 256; n++) {
+        uint32_t crc = crc32c_table[n];
+
+        for (k = 0; k < 7; k++) {
+            crc = crc32c_table[crc & 0xFF] ^ (crc >> 8);
+            crc32c_table_8[k][n] = crc;
+        }
+    }
+}
+
 uint32_t crc32c(uint32_t crc, const uint8_t *data, unsigned int length)
 {
+    while (length >= 8) {
+        uint32_t lo = crc ^ ldl_le_p(data);
+        uint32_t hi = ldl_le_p(data + 4);
+
+        crc = crc32c_table_8[6][lo & 0xFF] ^
+              crc32c_table_8[5][(lo >> 8) & 0xFF] ^
+              crc32c_table_8[4][(lo >> 16) & 0xFF] ^
+              crc32c_table_8[3][lo >> 24] ^
+              crc32c_table_8[2][hi & 0xFF] ^
+              crc32c_table_8[1][(hi >> 8) & 0xFF] ^
+              crc32c_table_8[0][(hi >> 16) & 0xFF] ^
+              crc32c_table[hi >> 24];
+        data += 8;
+        length -= 8;
+    }
     while (length--) {
         crc = crc32c_table[(crc ^ *data++) & 0xFFL] ^ (crc >> 8);
     }
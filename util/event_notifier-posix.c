@@ -19,6 +19,55 @@
 #include <sys/eventfd.h>
 #endif
 
+#ifdef EMSCRIPTEN
+/*
+ * Writing to the pipe of a notifier and polling it are round trips to the
+ * browser main thread, so notifiers are doorbells instead: a bit per read
+ * fd in these words that event_notifier_set() raises before it wakes the
+ * fdmon-wasm sleepers, and that qemu_poll_ns() reports as G_IO_IN. The
+ * pipe stays around only to give the notifier an fd that handlers can be
+ * registered for. A virtio ioeventfd costs the vCPU that kicks the queue
+ * an atomic OR and a futex wake, then the thread of the queue's AioContext
+ * runs the handler while the guest goes on.
+ */
+#define EVENT_NOTIFIER_DOORBELLS 1024
+
+/* read fds of doorbells, and the doorbells that are rung */
+static uint32_t event_notifier_doorbell_fds[EVENT_NOTIFIER_DOORBELLS / 32];
+static uint32_t event_notifier_doorbells[EVENT_NOTIFIER_DOORBELLS / 32];
+
+static bool event_notifier_test_bit(uint32_t *words, int fd)
+{
+    return fd >= 0 && fd < EVENT_NOTIFIER_DOORBELLS &&
+           (qatomic_read(&words[fd / 32]) & (1u << (fd % 32)));
+}
+
+/* Both return whether the bit was set before */
+static bool event_notifier_set_bit(uint32_t *words, int fd)
+{
+    uint32_t bit = 1u << (fd % 32);
+
+    return qatomic_fetch_or(&words[fd / 32], bit) & bit;
+}
+
+static bool event_notifier_clear_bit(uint32_t *words, int fd)
+{
+    uint32_t bit = 1u << (fd % 32);
+
+    return qatomic_fetch_and(&words[fd / 32], ~bit) & bit;
+}
+
+bool event_notifier_doorbell_fd(int fd)
+{
+    return event_notifier_test_bit(event_notifier_doorbell_fds, fd);
+}
+
+bool event_notifier_doorbell_rung(int fd)
+{
+    return event_notifier_test_bit(event_notifier_doorbells, fd);
+}
+#endif
+
 #ifdef CONFIG_EVENTFD
 /*
  * Initialize @e with existing file descriptor @fd.
@@ -29,6 +78,9 @@ void event_notifier_init_fd(EventNotifier *e, int fd)
     e->rfd = fd;
     e->wfd = fd;
     e->initialized = true;
+#ifdef EMSCRIPTEN
+    e->doorbell = false;
+#endif
 }
 #endif
 
@@ -64,6 +116,14 @@ int event_notifier_init(EventNotifier *e, int active)
         e->wfd = fds[1];
     }
     e->initialized = true;
+#ifdef EMSCRIPTEN
+    e->pending = 0;
+    e->doorbell = e->rfd < EVENT_NOTIFIER_DOORBELLS;
+    if (e->doorbell) {
+        event_notifier_clear_bit(event_notifier_doorbells, e->rfd);
+        event_notifier_set_bit(event_notifier_doorbell_fds, e->rfd);
+    }
+#endif
     if (active) {
         event_notifier_set(e);
     }
@@ -81,6 +141,12 @@ void event_notifier_cleanup(EventNotifier *e)
         return;
     }
 
+#ifdef EMSCRIPTEN
+    if (e->doorbell) {
+        event_notifier_clear_bit(event_notifier_doorbell_fds, e->rfd);
+        event_notifier_clear_bit(event_notifier_doorbells, e->rfd);
+    }
+#endif
     if (e->rfd != e->wfd) {
         close(e->rfd);
     }
@@ -110,6 +176,24 @@ int event_notifier_set(EventNotifier *e)
         return -1;
     }
 
+#ifdef EMSCRIPTEN
+    if (e->doorbell) {
+        if (!event_notifier_set_bit(event_notifier_doorbells, e->rfd)) {
+            fdmon_wasm_notify();
+        }
+        return 0;
+    }
+
+    /*
+     * Writing to the pipe is a round trip to the browser main thread, only
+     * do it for the first set after a clear.  Later ones are coalesced into
+     * the pending write.
+     */
+    if (qatomic_xchg(&e->pending, 1)) {
+        return 0;
+    }
+#endif
+
     do {
         ret = write(e->wfd, &value, sizeof(value));
     } while (ret < 0 && errno == EINTR);
@@ -118,6 +202,9 @@ int event_notifier_set(EventNotifier *e)
     if (ret < 0 && errno != EAGAIN) {
         return -errno;
     }
+#ifdef EMSCRIPTEN
+    fdmon_wasm_notify();
+#endif
     return 0;
 }
 
@@ -131,6 +218,12 @@ int event_notifier_test_and_clear(EventNotifier *e)
         return 0;
     }
 
+#ifdef EMSCRIPTEN
+    if (e->doorbell) {
+        return event_notifier_clear_bit(event_notifier_doorbells, e->rfd);
+    }
+#endif
+
     /* Drain the notify pipe.  For eventfd, only 8 bytes will be read.  */
     value = 0;
     do {
@@ -138,5 +231,13 @@ int event_notifier_test_and_clear(EventNotifier *e)
         value |= (len > 0);
     } while ((len == -1 && errno == EINTR) || len == sizeof(buffer));
 
+#ifdef EMSCRIPTEN
+    /*
+     * Clear after draining: a set racing with us either sees pending still
+     * set and is reported here, or writes again after it is cleared.
+     */
+    value |= qatomic_xchg(&e->pending, 0);
+#endif
+
     return value;
 }
@@ -0,0 +1,194 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * emscripten file descriptor monitoring
+ *
+ * poll(2) on emscripten is proxied to the browser main thread and doesn't
+ * sleep for its timeout, so an IOThread blocked in aio_poll() either spins
+ * or hammers the main thread. Instead, poll the fds without blocking and
+ * then wait on a futex word that is bumped by fdmon_wasm_notify() whenever
+ * an EventNotifier is set or a SharedArrayBuffer backed I/O source has data.
+ *
+ * qemu_poll_ns() waits the same way, so the main loop sleeps until the
+ * deadline of its next timer in one futex wait as well.
+ *
+ * EventNotifiers are doorbells that are never written to their pipes (see
+ * util/event_notifier-posix.c). They are checked here rather than polled,
+ * and a thread that only waits for notifiers doesn't poll at all.
+ */
+
+#include "qemu/osdep.h"
+#include "aio-posix.h"
+#include "qemu/atomic.h"
+#include "qemu/event_notifier.h"
+#include "qemu/stats64.h"
+#include "qemu/timer.h"
+
+#include <emscripten.h>
+#include <emscripten/threading.h>
+
+/*
+ * Not every fd is tied to a notifier, e.g. sockets emulated in JS that don't
+ * call fdmon_wasm_notify(). Re-poll at this interval so they still make
+ * progress, just with more latency.
+ */
+#define FDMON_WASM_MAX_SLEEP_MS 10
+
+/*
+ * Nobody types into a hidden page, so stdio and the like can wait that
+ * much longer and an idle VM costs next to no CPU in a background tab.
+ */
+#define FDMON_WASM_HIDDEN_SLEEP_MS 1000
+
+static uint32_t fdmon_wasm_seq;
+static int fdmon_wasm_max_sleep_ms = FDMON_WASM_MAX_SLEEP_MS;
+static Stat64 fdmon_wasm_wakeup_count;
+
+EMSCRIPTEN_KEEPALIVE void fdmon_wasm_notify(void)
+{
+    qatomic_inc(&fdmon_wasm_seq);
+    emscripten_futex_wake(&fdmon_wasm_seq, INT_MAX);
+}
+
+/* Called by the page on visibilitychange with document.hidden */
+EMSCRIPTEN_KEEPALIVE void fdmon_wasm_set_hidden(int hidden)
+{
+    qatomic_set(&fdmon_wasm_max_sleep_ms,
+                hidden ? FDMON_WASM_HIDDEN_SLEEP_MS : FDMON_WASM_MAX_SLEEP_MS);
+    /* sleepers pick up the new interval at once */
+    fdmon_wasm_notify();
+}
+
+uint64_t fdmon_wasm_wakeups(void)
+{
+    return stat64_get(&fdmon_wasm_wakeup_count);
+}
+
+/*
+ * Sleeps until fdmon_wasm_notify() is called after seq was read, or until
+ * deadline (get_clock(), 0 for none). Returns false if the deadline passed.
+ */
+static bool fdmon_wasm_sleep(uint32_t seq, int64_t deadline)
+{
+    double wait_ms = qatomic_read(&fdmon_wasm_max_sleep_ms);
+
+    if (deadline) {
+        int64_t left = deadline - get_clock();
+
+        if (left <= 0) {
+            return false;
+        }
+        wait_ms = MIN(wait_ms, (double)left / SCALE_MS);
+    }
+
+    emscripten_futex_wait(&fdmon_wasm_seq, seq, wait_ms);
+    stat64_inc(&fdmon_wasm_wakeup_count);
+    return true;
+}
+
+/* g_poll() that reports rung doorbells as readable */
+static int fdmon_wasm_poll(GPollFD *fds, guint nfds, int timeout_ms)
+{
+    bool others = false;
+    int ret = 0;
+    guint i;
+
+    for (i = 0; i < nfds; i++) {
+        if (event_notifier_doorbell_rung(fds[i].fd)) {
+            timeout_ms = 0;
+        } else if (!event_notifier_doorbell_fd(fds[i].fd)) {
+            others = true;
+        }
+    }
+    if (others) {
+        ret = g_poll(fds, nfds, timeout_ms);
+        if (ret < 0) {
+            return ret;
+        }
+    } else {
+        for (i = 0; i < nfds; i++) {
+            fds[i].revents = 0;
+        }
+    }
+
+    for (i = 0; i < nfds; i++) {
+        if ((fds[i].events & G_IO_IN) &&
+            event_notifier_doorbell_rung(fds[i].fd)) {
+            ret += !fds[i].revents;
+            fds[i].revents |= G_IO_IN;
+        }
+    }
+    return ret;
+}
+
+static int fdmon_wasm_wait(AioContext *ctx, AioHandlerList *ready_list,
+                           int64_t timeout)
+{
+    int64_t deadline = 0;
+
+    /* Atomics.wait isn't allowed on the browser main thread */
+    if (emscripten_is_main_browser_thread()) {
+        return fdmon_poll_ops.wait(ctx, ready_list, timeout);
+    }
+
+    if (timeout > 0) {
+        deadline = get_clock() + timeout;
+    }
+
+    for (;;) {
+        /* Read the sequence before polling so no notification is missed */
+        uint32_t seq = qatomic_load_acquire(&fdmon_wasm_seq);
+        int ret;
+
+        ret = fdmon_poll_ops.wait(ctx, ready_list, 0);
+        if (ret != 0 || timeout == 0) {
+            return ret;
+        }
+        if (!fdmon_wasm_sleep(seq, deadline)) {
+            return 0;
+        }
+    }
+}
+
+int qemu_poll_ns_wasm(GPollFD *fds, guint nfds, int64_t timeout)
+{
+    int64_t deadline = 0;
+
+    if (emscripten_is_main_browser_thread()) {
+        return fdmon_wasm_poll(fds, nfds, qemu_timeout_ns_to_ms(timeout));
+    }
+
+    if (timeout > 0) {
+        deadline = get_clock() + timeout;
+    }
+
+    for (;;) {
+        uint32_t seq = qatomic_load_acquire(&fdmon_wasm_seq);
+        int ret;
+
+        ret = fdmon_wasm_poll(fds, nfds, 0);
+        if (ret != 0 || timeout == 0) {
+            return ret;
+        }
+        if (!fdmon_wasm_sleep(seq, deadline)) {
+            return 0;
+        }
+    }
+}
+
+static void fdmon_wasm_update(AioContext *ctx,
+                              AioHandler *old_node,
+                              AioHandler *new_node)
+{
+    /* Do nothing, fdmon_poll_wait() walks the handler list itself */
+}
+
+static const FDMonOps fdmon_wasm_ops = {
+    .update = fdmon_wasm_update,
+    .wait = fdmon_wasm_wait,
+    .need_wait = aio_poll_disabled,
+};
+
+void fdmon_wasm_setup(AioContext *ctx)
+{
+    ctx->fdmon_ops = &fdmon_wasm_ops;
+}
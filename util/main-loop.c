@@ -24,6 +24,7 @@
 
 #include "qemu/osdep.h"
 #include "qapi/error.h"
+#include "qapi/visitor.h"
 #include "qemu/cutils.h"
 #include "qemu/timer.h"
 #include "sysemu/cpu-timers.h"
@@ -203,6 +204,21 @@ static void main_loop_update_params(EventLoopBase *base, Error **errp)
 
 MainLoop *mloop;
 
+/*
+ * Wakeups for timers are delayed by up to this many nanoseconds, to the
+ * next multiple of it, so that timers expiring close to each other are
+ * run after a single wakeup. Waking up costs more on wasm hosts, where
+ * poll() can't sleep, and timers that wake the guest many times a second
+ * keep a core of the browser busy.
+ */
+#ifdef EMSCRIPTEN
+#define MAIN_LOOP_TIMER_SLACK_DEFAULT (1 * SCALE_MS)
+#else
+#define MAIN_LOOP_TIMER_SLACK_DEFAULT 0
+#endif
+
+static int64_t main_loop_timer_slack = MAIN_LOOP_TIMER_SLACK_DEFAULT;
+
 static void main_loop_init(EventLoopBase *base, Error **errp)
 {
     MainLoop *m = MAIN_LOOP(base);
@@ -215,9 +231,46 @@ static void main_loop_init(EventLoopBase *base, Error **errp)
     main_loop_update_params(base, errp);
 
     mloop = m;
+    main_loop_timer_slack = m->timer_slack;
     return;
 }
 
+static void main_loop_get_timer_slack(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    MainLoop *m = MAIN_LOOP(obj);
+
+    visit_type_int64(v, name, &m->timer_slack, errp);
+}
+
+static void main_loop_set_timer_slack(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    MainLoop *m = MAIN_LOOP(obj);
+    int64_t value;
+
+    if (!visit_type_int64(v, name, &value, errp)) {
+        return;
+    }
+    if (value < 0) {
+        error_setg(errp, "%s value must be in range [0, %" PRId64 "]",
+                   name, INT64_MAX);
+        return;
+    }
+
+    m->timer_slack = value;
+    if (mloop == m) {
+        qatomic_set(&main_loop_timer_slack, value);
+    }
+}
+
+static void main_loop_instance_init(Object *obj)
+{
+    MAIN_LOOP(obj)->timer_slack = MAIN_LOOP_TIMER_SLACK_DEFAULT;
+}
+
 static bool main_loop_can_be_deleted(EventLoopBase *base)
 {
     return false;
@@ -230,12 +283,18 @@ static void main_loop_class_init(ObjectClass *oc, void *class_data)
     bc->init = main_loop_init;
     bc->update_params = main_loop_update_params;
     bc->can_be_deleted = main_loop_can_be_deleted;
+
+    object_class_property_add(oc, "timer-slack", "int",
+                              main_loop_get_timer_slack,
+                              main_loop_set_timer_slack,
+                              NULL, NULL);
 }
 
 static const TypeInfo main_loop_info = {
     .name = TYPE_MAIN_LOOP,
     .parent = TYPE_EVENT_LOOP_BASE,
     .class_init = main_loop_class_init,
+    .instance_init = main_loop_instance_init,
     .instance_size = sizeof(MainLoop),
 };
 
@@ -560,6 +619,23 @@ void main_loop_poll_remove_notifier(Notifier *notify)
     notifier_remove(notify);
 }
 
+/* Moves the end of a timeout to the next multiple of the timer slack */
+static int64_t main_loop_slack_timeout(int64_t timeout_ns)
+{
+    int64_t slack = qatomic_read(&main_loop_timer_slack);
+    int64_t now, end;
+
+    if (timeout_ns <= 0 || slack <= 0) {
+        return timeout_ns;
+    }
+    now = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    end = now + timeout_ns;
+    if (end < now || end > INT64_MAX - slack) {
+        return timeout_ns;
+    }
+    return QEMU_ALIGN_UP(end, slack) - now;
+}
+
 void main_loop_wait(int nonblocking)
 {
     MainLoopPoll mlpoll = {
@@ -588,6 +664,7 @@ void main_loop_wait(int nonblocking)
     timeout_ns = qemu_soonest_timeout(timeout_ns,
                                       timerlistgroup_deadline_ns(
                                           &main_loop_tlg));
+    timeout_ns = main_loop_slack_timeout(timeout_ns);
 
     ret = os_host_main_loop_wait(timeout_ns);
     mlpoll.state = ret < 0 ? MAIN_LOOP_POLL_ERR : MAIN_LOOP_POLL_OK;
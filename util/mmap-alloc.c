@@ -21,6 +21,7 @@
 #include "qemu/mmap-alloc.h"
 #include "qemu/host-utils.h"
 #include "qemu/cutils.h"
+#include "qemu/units.h"
 #include "qemu/error-report.h"
 
 #define HUGETLBFS_MAGIC       0x958458f6
@@ -30,6 +31,10 @@
 #include <linux/magic.h>
 #endif
 
+#ifdef EMSCRIPTEN
+#include <emscripten.h>
+#endif
+
 QemuFsType qemu_fd_getfs(int fd)
 {
 #ifdef CONFIG_LINUX
@@ -244,6 +249,33 @@ static inline size_t mmap_guard_pagesize(int fd)
 #endif
 }
 
+#if defined(EMSCRIPTEN)
+/*
+ * Emscripten's anonymous mmap is a malloc and a memset of the whole range,
+ * which has the browser commit all of guest RAM at startup. Linear memory
+ * that no one has written yet reads as zeroes without being committed, so
+ * only the pages left dirty by earlier heap users are cleared, and the
+ * rest is committed as the guest touches it.
+ */
+static void *ram_alloc_lazy(size_t size, size_t align)
+{
+    const size_t pagesize = qemu_real_host_page_size();
+    uint8_t *ptr;
+
+    if (posix_memalign((void **)&ptr, MAX(align, sizeof(void *)), size)) {
+        return MAP_FAILED;
+    }
+    for (size_t off = 0; off < size; off += pagesize) {
+        size_t len = MIN(pagesize, size - off);
+
+        if (!buffer_is_zero(ptr + off, len)) {
+            memset(ptr + off, 0, len);
+        }
+    }
+    return ptr;
+}
+#endif
+
 void *qemu_ram_mmap(int fd,
                     size_t size,
                     size_t align,
@@ -252,6 +284,10 @@ void *qemu_ram_mmap(int fd,
 {
 #if defined(EMSCRIPTEN)
     void *ptr;
+
+    if (fd == -1) {
+        return ram_alloc_lazy(size, align);
+    }
     ptr = mmap_activate(0, size + align, fd, qemu_map_flags, map_offset);
     return (void *)QEMU_ALIGN_UP((uintptr_t)ptr, align);
 #else
@@ -300,8 +336,63 @@ void *qemu_ram_mmap(int fd,
 #endif
 }
 
+#if defined(EMSCRIPTEN)
+/*
+ * Decommits whole wasm pages of a range where the engine supports the
+ * memory control proposal; they read as zeroes afterwards.
+ */
+EM_JS(int, ram_discard_js, (void *ptr, size_t size), {
+    if (typeof wasmMemory.discard !== 'function') {
+        return 0;
+    }
+    try {
+        wasmMemory.discard(ptr >>> 0, size >>> 0);
+        return 1;
+    } catch (e) {
+        return 0;
+    }
+});
+
+bool qemu_ram_decommit(void *ptr, size_t size)
+{
+    return ram_discard_js(ptr, size);
+}
+
+/*
+ * Linear memory never shrinks and madvise() is a no-op, so discarding RAM
+ * clears it like MADV_DONTNEED would: the guest reads zeroes and pages
+ * that are zero already are left alone, to not commit them. The aligned
+ * middle of the range is handed back to the engine when it can take it.
+ */
+void qemu_ram_discard(void *ptr, size_t size)
+{
+    const size_t pagesize = qemu_real_host_page_size();
+    uint8_t *start = ptr, *end = start + size;
+    uint8_t *dstart = QEMU_ALIGN_PTR_UP(start, WASM_PAGE_SIZE);
+    uint8_t *dend = QEMU_ALIGN_PTR_DOWN(end, WASM_PAGE_SIZE);
+
+    if (dstart < dend && qemu_ram_decommit(dstart, dend - dstart)) {
+        qemu_ram_discard(start, dstart - start);
+        start = dend;
+    }
+    for (; start < end; start += pagesize) {
+        size_t len = MIN(pagesize, end - start);
+
+        if (!buffer_is_zero(start, len)) {
+            memset(start, 0, len);
+        }
+    }
+}
+#endif
+
 void qemu_ram_munmap(int fd, void *ptr, size_t size)
 {
+#if defined(EMSCRIPTEN)
+    if (fd == -1) {
+        free(ptr);
+        return;
+    }
+#endif
     if (ptr) {
         /* Unmap both the RAM block and the guard page */
         munmap(ptr, size + mmap_guard_pagesize(fd));
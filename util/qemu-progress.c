@@ -25,6 +25,11 @@
 #include "qemu/osdep.h"
 #include "qemu/qemu-progress.h"
 
+#ifdef EMSCRIPTEN
+#include "qemu/atomic.h"
+#include <emscripten.h>
+#endif
+
 struct progress_state {
     float current;
     float last_print;
@@ -36,6 +41,21 @@ struct progress_state {
 static struct progress_state state;
 static volatile sig_atomic_t print_pending;
 
+#ifdef EMSCRIPTEN
+/*
+ * The progress in hundredths of percent, for the page to show without
+ * parsing stdout, which is proxied to the browser main thread. It is
+ * updated on every report, printed or not, and read with Atomics.load at
+ * the address qemu_progress_lookup() returns.
+ */
+static uint32_t progress_shared;
+
+EMSCRIPTEN_KEEPALIVE uintptr_t qemu_progress_lookup(void)
+{
+    return (uintptr_t)&progress_shared;
+}
+#endif
+
 /*
  * Simple progress print function.
  * @percent relative percent of current operation
@@ -152,6 +172,9 @@ void qemu_progress_print(float delta, int max)
         current = 100;
     }
     state.current = current;
+#ifdef EMSCRIPTEN
+    qatomic_set(&progress_shared, (uint32_t)(current * 100));
+#endif
 
     if (current > (state.last_print + state.min_skip) ||
         current < (state.last_print - state.min_skip) ||
@@ -334,7 +334,9 @@ int qemu_timeout_ns_to_ms(int64_t ns)
  */
 int qemu_poll_ns(GPollFD *fds, guint nfds, int64_t timeout)
 {
-#ifdef CONFIG_PPOLL
+#if defined(EMSCRIPTEN)
+    return qemu_poll_ns_wasm(fds, nfds, timeout);
+#elif defined(CONFIG_PPOLL)
     if (timeout < 0) {
         return ppoll((struct pollfd *)fds, nfds, NULL, NULL);
     } else {
@@ -624,10 +624,14 @@ void *qht_lookup(const struct qht *ht, const void *userp, uint32_t hash)
 /*
  * call with head->lock held
  * @ht is const since it is only used for ht->cmp()
+ * If @spare is set, a full chain is extended with *@spare, a zeroed bucket
+ * the caller allocated without holding the lock. If there is none yet,
+ * nothing is inserted and @head is returned so that the caller comes back
+ * with one.
  */
 static void *qht_insert__locked(const struct qht *ht, struct qht_map *map,
                                 struct qht_bucket *head, void *p, uint32_t hash,
-                                bool *needs_resize)
+                                bool *needs_resize, struct qht_bucket **spare)
 {
     struct qht_bucket *b = head;
     struct qht_bucket *prev = NULL;
@@ -649,8 +653,16 @@ static void *qht_insert__locked(const struct qht *ht, struct qht_map *map,
         b = b->next;
     } while (b);
 
-    b = qemu_memalign(QHT_BUCKET_ALIGN, sizeof(*b));
-    memset(b, 0, sizeof(*b));
+    if (spare) {
+        if (*spare == NULL) {
+            return head;
+        }
+        b = *spare;
+        *spare = NULL;
+    } else {
+        b = qemu_memalign(QHT_BUCKET_ALIGN, sizeof(*b));
+        memset(b, 0, sizeof(*b));
+    }
     new = b;
     i = 0;
     qatomic_inc(&map->n_added_buckets);
@@ -694,6 +706,7 @@ static __attribute__((noinline)) void qht_grow_maybe(struct qht *ht)
 
 bool qht_insert(struct qht *ht, void *p, uint32_t hash, void **existing)
 {
+    struct qht_bucket *spare = NULL;
     struct qht_bucket *b;
     struct qht_map *map;
     bool needs_resize = false;
@@ -702,10 +715,25 @@ bool qht_insert(struct qht *ht, void *p, uint32_t hash, void **existing)
     /* NULL pointers are not supported */
     qht_debug_assert(p);
 
-    b = qht_bucket_lock__no_stale(ht, hash, &map);
-    prev = qht_insert__locked(ht, map, b, p, hash, &needs_resize);
-    qht_bucket_debug__locked(b);
-    qht_bucket_unlock(map, b);
+    for (;;) {
+        b = qht_bucket_lock__no_stale(ht, hash, &map);
+        prev = qht_insert__locked(ht, map, b, p, hash, &needs_resize, &spare);
+        qht_bucket_debug__locked(b);
+        qht_bucket_unlock(map, b);
+        if (likely(prev != b)) {
+            break;
+        }
+        /*
+         * The chain is full. Allocate outside of the bucket lock, which
+         * the other threads inserting into the bucket spin on meanwhile.
+         */
+        spare = qemu_memalign(QHT_BUCKET_ALIGN, sizeof(*spare));
+        memset(spare, 0, sizeof(*spare));
+    }
+    if (unlikely(spare)) {
+        /* another thread extended the chain first */
+        qemu_vfree(spare);
+    }
 
     if (unlikely(needs_resize) && ht->mode & QHT_MODE_AUTO_RESIZE) {
         qht_grow_maybe(ht);
@@ -911,7 +939,7 @@ static void qht_map_copy(void *p, uint32_t hash, void *userp)
     struct qht_bucket *b = qht_map_to_bucket(new, hash);
 
     /* no need to acquire b->lock because no thread has seen this map yet */
-    qht_insert__locked(ht, new, b, p, hash, NULL);
+    qht_insert__locked(ht, new, b, p, hash, NULL, NULL);
 }
 
 /*
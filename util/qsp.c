@@ -65,11 +65,16 @@
 #include "qemu/rcu.h"
 #include "qemu/xxhash.h"
 
+#ifdef EMSCRIPTEN
+#include <emscripten.h>
+#endif
+
 enum QSPType {
     QSP_MUTEX,
     QSP_BQL_MUTEX,
     QSP_REC_MUTEX,
     QSP_CONDVAR,
+    QSP_SPIN,
 };
 
 struct QSPCallSite {
@@ -122,6 +127,7 @@ static const char * const qsp_typenames[] = {
     [QSP_BQL_MUTEX] = "BQL mutex",
     [QSP_REC_MUTEX] = "rec_mutex",
     [QSP_CONDVAR]   = "condvar",
+    [QSP_SPIN]      = "spin",
 };
 
 QemuMutexLockFunc qemu_bql_mutex_lock_func = qemu_mutex_lock_impl;
@@ -430,6 +436,23 @@ qsp_cond_timedwait(QemuCond *cond, QemuMutex *mutex, int ms,
     return ret;
 }
 
+/*
+ * Spinlocks are inline and don't go through function pointers like the
+ * above; callers that want theirs profiled call this while it's enabled.
+ */
+void qsp_spin_lock(QemuSpin *spin, const char *file, int line)
+{
+    QSPEntry *e;
+    int64_t t0, t1;
+
+    t0 = get_clock();
+    qemu_spin_lock(spin);
+    t1 = get_clock();
+
+    e = qsp_entry_get(spin, file, line, QSP_SPIN);
+    qsp_entry_record(e, t1 - t0);
+}
+
 bool qsp_is_enabled(void)
 {
     return qatomic_read(&qemu_mutex_lock_func) == qsp_mutex_lock;
@@ -765,26 +788,77 @@ static void report_destroy(QSPReport *rep)
     g_free(rep->entries);
 }
 
-void qsp_report(size_t max, enum QSPSortBy sort_by,
-                bool callsite_coalesce)
+static void report_fill(QSPReport *rep, size_t max, enum QSPSortBy sort_by,
+                        bool callsite_coalesce)
 {
     GTree *tree = g_tree_new_full(qsp_tree_cmp, &sort_by, g_free, NULL);
-    QSPReport rep;
 
     qsp_init();
 
-    rep.entries = g_new0(QSPReportEntry, max);
-    rep.n_entries = 0;
-    rep.max_n_entries = max;
+    rep->entries = g_new0(QSPReportEntry, max);
+    rep->n_entries = 0;
+    rep->max_n_entries = max;
 
     qsp_mktree(tree, callsite_coalesce);
-    g_tree_foreach(tree, qsp_tree_report, &rep);
+    g_tree_foreach(tree, qsp_tree_report, rep);
     g_tree_destroy(tree);
+}
 
+void qsp_report(size_t max, enum QSPSortBy sort_by,
+                bool callsite_coalesce)
+{
+    QSPReport rep;
+
+    report_fill(&rep, max, sort_by, callsite_coalesce);
     pr_report(&rep);
     report_destroy(&rep);
 }
 
+#ifdef EMSCRIPTEN
+/*
+ * Called by the page to start or stop profiling, as with the sync-profile
+ * HMP command; there is no monitor to type it in a browser tab.
+ */
+EMSCRIPTEN_KEEPALIVE void qemu_sync_profile_set(bool enable)
+{
+    if (enable) {
+        qsp_enable();
+    } else {
+        qsp_disable();
+    }
+}
+
+/*
+ * The @max call sites waited on longest since the last qsp_reset(), like
+ * "info sync-profile -n". The string stays valid until the next call.
+ */
+EMSCRIPTEN_KEEPALIVE const char *qemu_sync_profile_json(unsigned max)
+{
+    static char *json;
+    GString *s = g_string_new("[");
+    QSPReport rep;
+    size_t i;
+
+    report_fill(&rep, max, QSP_SORT_BY_TOTAL_WAIT_TIME, true);
+    for (i = 0; i < rep.n_entries; i++) {
+        const QSPReportEntry *e = &rep.entries[i];
+
+        g_string_append_printf(s, "%s{\"type\":\"%s\",\"objs\":%u,"
+                               "\"at\":\"%s\",\"wait_s\":%.6f,"
+                               "\"count\":%" PRIu64 ",\"avg_us\":%.2f}",
+                               i ? "," : "", e->typename, e->n_objs,
+                               e->callsite_at, e->time_s, e->n_acqs,
+                               e->ns_avg * 1e-3);
+    }
+    g_string_append_c(s, ']');
+    report_destroy(&rep);
+
+    g_free(json);
+    json = g_string_free(s, FALSE);
+    return json;
+}
+#endif
+
 static void qsp_snapshot_destroy(QSPSnapshot *snap)
 {
     qht_iter(&snap->ht, qsp_ht_delete, NULL);
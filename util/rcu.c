@@ -35,6 +35,9 @@
 #if defined(CONFIG_MALLOC_TRIM)
 #include <malloc.h>
 #endif
+#ifdef EMSCRIPTEN
+#include <emscripten/threading.h>
+#endif
 
 /*
  * Global grace period counter.  Bit 0 is always one in rcu_gp_ctr.
@@ -71,6 +74,35 @@ QEMU_DEFINE_CO_TLS(struct rcu_reader_data, rcu_reader)
 typedef QLIST_HEAD(, rcu_reader_data) ThreadList;
 static ThreadList registry = QLIST_HEAD_INITIALIZER(registry);
 
+#ifdef EMSCRIPTEN
+/*
+ * Sleeping in qemu_event_wait() and being woken costs a Worker more than
+ * most read-side critical sections last, so first poll the readers left
+ * for a while. The polls get longer while they see readers finish and
+ * shorter while they don't. Called and updated under rcu_registry_lock.
+ */
+#define RCU_GP_POLL_MIN 16
+#define RCU_GP_POLL_MAX 4096
+
+static int rcu_gp_poll = RCU_GP_POLL_MIN;
+
+static bool poll_for_readers(void)
+{
+    struct rcu_reader_data *index;
+
+    for (int i = 0; i < rcu_gp_poll; i++) {
+        QLIST_FOREACH(index, &registry, node) {
+            if (!rcu_gp_ongoing(&index->ctr)) {
+                rcu_gp_poll = MIN(rcu_gp_poll * 2, RCU_GP_POLL_MAX);
+                return true;
+            }
+        }
+    }
+    rcu_gp_poll = MAX(rcu_gp_poll / 2, RCU_GP_POLL_MIN);
+    return false;
+}
+#endif
+
 /* Wait for previous parity/grace period to be empty of readers.  */
 static void wait_for_readers(void)
 {
@@ -115,6 +147,12 @@ static void wait_for_readers(void)
             break;
         }
 
+#ifdef EMSCRIPTEN
+        if (poll_for_readers()) {
+            continue;
+        }
+#endif
+
         /* Wait for one thread to report a quiescent state and try again.
          * Release rcu_registry_lock, so rcu_(un)register_thread() doesn't
          * wait too much time.
@@ -252,6 +290,43 @@ retry:
     return node;
 }
 
+#ifdef EMSCRIPTEN
+/*
+ * The batch of callbacks is collected in one futex wait on rcu_call_count
+ * rather than 10ms sleeps, each of which wakes the Worker. call_rcu1()
+ * ends it early once RCU_CALL_MIN_SIZE callbacks are queued or
+ * drain_call_rcu() waits for them.
+ */
+#define RCU_CALL_MAX_DELAY_MS    50
+
+static int wait_for_callbacks(void)
+{
+    int64_t deadline = g_get_monotonic_time() + RCU_CALL_MAX_DELAY_MS * 1000;
+    int64_t left;
+    int n;
+
+    for (;;) {
+        n = qatomic_read(&rcu_call_count);
+        if (n == 0) {
+            qemu_event_reset(&rcu_call_ready_event);
+            n = qatomic_read(&rcu_call_count);
+            if (n == 0) {
+                qemu_event_wait(&rcu_call_ready_event);
+                deadline = g_get_monotonic_time() +
+                           RCU_CALL_MAX_DELAY_MS * 1000;
+                continue;
+            }
+        }
+        left = deadline - g_get_monotonic_time();
+        if (n >= RCU_CALL_MIN_SIZE || left <= 0 ||
+            qatomic_read(&in_drain_call_rcu)) {
+            return n;
+        }
+        emscripten_futex_wait(&rcu_call_count, n, left / 1000.0);
+    }
+}
+#endif
+
 static void *call_rcu_thread(void *opaque)
 {
     struct rcu_head *node;
@@ -259,6 +334,9 @@ static void *call_rcu_thread(void *opaque)
     rcu_register_thread();
 
     for (;;) {
+#ifdef EMSCRIPTEN
+        int n = wait_for_callbacks();
+#else
         int tries = 0;
         int n = qatomic_read(&rcu_call_count);
 
@@ -280,6 +358,7 @@ static void *call_rcu_thread(void *opaque)
             }
             n = qatomic_read(&rcu_call_count);
         }
+#endif
 
         qatomic_sub(&rcu_call_count, n);
         synchronize_rcu();
@@ -309,7 +388,14 @@ void call_rcu1(struct rcu_head *node, void (*func)(struct rcu_head *node))
 {
     node->func = func;
     enqueue(node);
+#ifdef EMSCRIPTEN
+    if (qatomic_fetch_inc(&rcu_call_count) + 1 == RCU_CALL_MIN_SIZE ||
+        qatomic_read(&in_drain_call_rcu)) {
+        emscripten_futex_wake(&rcu_call_count, 1);
+    }
+#else
     qatomic_inc(&rcu_call_count);
+#endif
     qemu_event_set(&rcu_call_ready_event);
 }
 
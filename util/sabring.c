@@ -0,0 +1,89 @@
+/*
+ * Rings in shared wasm memory
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+
+#include <emscripten/threading.h>
+
+#include "qemu/host-utils.h"
+#include "qemu/sabring.h"
+
+void sab_ring_init(SabRing *r, uint32_t size)
+{
+    assert(is_power_of_2(size));
+    memset(r, 0, sizeof(*r));
+    r->size = size;
+}
+
+void sab_ring_copy_in(SabRing *r, uint32_t pos, const void *buf, size_t len)
+{
+    uint32_t off = pos & (r->size - 1);
+    size_t first = MIN(len, r->size - off);
+
+    memcpy(r->data + off, buf, first);
+    memcpy(r->data, (const uint8_t *)buf + first, len - first);
+}
+
+void sab_ring_copy_out(SabRing *r, uint32_t pos, void *buf, size_t len)
+{
+    uint32_t off = pos & (r->size - 1);
+    size_t first = MIN(len, r->size - off);
+
+    memcpy(buf, r->data + off, first);
+    memcpy((uint8_t *)buf + first, r->data, len - first);
+}
+
+/*
+ * The word is read before notify() looks at what it guards, so that a
+ * change it missed ends the wait right away.
+ */
+static void *sab_ring_waiter_thread(void *opaque)
+{
+    SabRingWaiter *w = opaque;
+
+    while (!qatomic_read(&w->stop)) {
+        uint32_t seen = qatomic_load_acquire(w->word);
+
+        w->notify(w->opaque);
+        emscripten_futex_wait(w->word, seen, INFINITY);
+    }
+    qatomic_set(&w->exited, true);
+    return NULL;
+}
+
+void sab_ring_waiter_start(SabRingWaiter *w, const char *name, uint32_t *word,
+                           void (*notify)(void *opaque), void *opaque)
+{
+    assert(!w->running);
+    w->word = word;
+    w->notify = notify;
+    w->opaque = opaque;
+    w->stop = false;
+    w->exited = false;
+    w->running = true;
+    qemu_thread_create(&w->thread, name, sab_ring_waiter_thread, w,
+                       QEMU_THREAD_JOINABLE);
+}
+
+void sab_ring_waiter_stop(SabRingWaiter *w)
+{
+    if (!w->running) {
+        return;
+    }
+    qatomic_set_mb(&w->stop, true);
+    /*
+     * A wake that comes before the thread is back in the futex wait is
+     * lost, and the other side may never move the word again, so wake it
+     * until it has left.
+     */
+    while (!qatomic_read(&w->exited)) {
+        emscripten_futex_wake(w->word, INT_MAX);
+        g_usleep(1000);
+    }
+    qemu_thread_join(&w->thread);
+    w->running = false;
+}
@@ -74,6 +74,15 @@ struct ThreadPool {
     int max_threads;
 };
 
+#ifdef EMSCRIPTEN
+/*
+ * Each new thread has the browser main thread start a Worker, keep a few
+ * warm so that requests don't wait for that and idle ones aren't torn
+ * down and started again every time the guest pauses its I/O.
+ */
+#define THREAD_POOL_WARM_THREADS 4
+#endif
+
 static void *worker_thread(void *opaque)
 {
     ThreadPool *pool = opaque;
@@ -301,6 +310,10 @@ void thread_pool_update_params(ThreadPool *pool, AioContext *ctx)
 
     pool->min_threads = ctx->thread_pool_min;
     pool->max_threads = ctx->thread_pool_max;
+#ifdef EMSCRIPTEN
+    pool->min_threads = MAX(pool->min_threads,
+                            MIN(THREAD_POOL_WARM_THREADS, pool->max_threads));
+#endif
 
     /*
      * We either have to: